@@ -1,5 +1,36 @@
 #include "app_tcp.h"
 
+#if APP_TCP_CRYPT
+#if !defined(APP_TCP_RX_KEY) || !defined(APP_TCP_TX_KEY)
+#error "APP_TCP_CRYPT needs APP_TCP_RX_KEY and APP_TCP_TX_KEY"
+#endif
+#ifndef LWIP_RAND
+#error "APP_TCP_CRYPT needs LWIP_RAND() for the per-connection salt"
+#endif
+#if APP_TCP_CRYP_ENGINE
+#include "cryp_ctr.h"
+#endif
+
+static struct aes_gcm_key app_tcp_rx_key;
+static struct aes_gcm_key app_tcp_tx_key;
+static u8_t app_tcp_scratch[AES_GCM_CHUNK];     //发送时加密后的数据,由tcp_write()复制走
+
+//一条记录认证通过,把内容追加到接收缓冲区
+static void app_tcp_deliver(void *arg, u8_t *data, u16_t len)
+{
+    struct rcev_buf *buffer = (struct rcev_buf *)arg;
+    u16_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (buffer->length < MAX_STRING)
+        {
+            buffer->bytes[buffer->length++] = data[i];
+        }
+    }
+}
+#endif
+
 static err_t app_tcp_poll(void *arg, struct tcp_pcb *pcb)
 {
     if (pcb != NULL)
@@ -9,10 +40,12 @@ static err_t app_tcp_poll(void *arg, struct tcp_pcb *pcb)
 }
 static err_t app_tcp_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
 {
-    struct pbuf *q;
     struct rcev_buf *buffer = (struct rcev_buf *)arg;
+#if !APP_TCP_CRYPT
+    struct pbuf *q;
     char *c;
     int i;
+#endif
     unsigned char buf_code[4];
     unsigned char dcu_timeover[2];
 
@@ -24,6 +57,16 @@ static err_t app_tcp_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t
             return err;
         }
 
+#if APP_TCP_CRYPT
+        //认证失败说明数据被篡改或密钥不对,断开连接(由app_tcp_conn_err()释放缓冲区)
+        if (aes_rec_input(&((struct app_tcp_conn *)buffer)->rx, p, ((struct app_tcp_conn *)buffer)->stage,
+                          MAX_STRING, app_tcp_deliver, buffer) != ERR_OK)
+        {
+            pbuf_free(p);
+            tcp_abort(pcb);
+            return ERR_ABRT;
+        }
+#else
         for (q = p; q != NULL; q = q->next)
         {
             c = q->payload;
@@ -35,6 +78,7 @@ static err_t app_tcp_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t
                 }
             }
         }
+#endif
     }
     else if (err == ERR_OK)
     {
@@ -57,7 +101,24 @@ static void app_tcp_conn_err(void *arg, err_t err)
 
 static err_t app_tcp_accept(void *arg, struct tcp_pcb *pcb, err_t err)
 {
+#if APP_TCP_CRYPT
+    struct app_tcp_conn *conn;
+    u32_t salt[2];
+
+    conn = mem_calloc(sizeof(struct app_tcp_conn), 1);
+    if (conn != NULL)
+    {
+        salt[0] = LWIP_RAND();
+        salt[1] = LWIP_RAND();
+        //客户端的记录要认证本机这次的盐值,录下的会话不能重放
+        aes_rec_init(&conn->rx, &app_tcp_rx_key, NULL, (u8_t *)salt);
+        aes_rec_init(&conn->tx, &app_tcp_tx_key, (u8_t *)salt, NULL);
+        tcp_write(pcb, salt, sizeof(salt), TCP_WRITE_FLAG_COPY);   //先发送本机方向的盐值
+    }
+    tcp_arg(pcb, conn);
+#else
     tcp_arg(pcb, mem_calloc(sizeof(struct rcev_buf), 1));
+#endif
     tcp_err(pcb, app_tcp_conn_err);
     tcp_recv(pcb, app_tcp_recv);
     tcp_sent(pcb, NULL);
@@ -66,10 +127,79 @@ static err_t app_tcp_accept(void *arg, struct tcp_pcb *pcb, err_t err)
     return err;
 }
 
+//向客户端发送len字节,APP_TCP_CRYPT为1时作为一条加密记录发送
+//返回值:ERR_OK,已放入发送队列;ERR_MEM,发送队列放不下;ERR_ABRT,记录只放入了一部分,
+//连接已被中止(在本连接的回调函数中调用时,回调函数必须返回ERR_ABRT)
+err_t app_tcp_send(struct tcp_pcb *pcb, const u8_t *data, u16_t len)
+{
+#if APP_TCP_CRYPT
+    struct app_tcp_conn *conn = (struct app_tcp_conn *)pcb->callback_arg;
+    u8_t hdr[AES_REC_HDR_SIZE];
+    u8_t tag[AES_GCM_TAG_SIZE];
+    u16_t n;
+    err_t err;
+
+    if (conn == NULL)
+    {
+        return ERR_MEM;
+    }
+    //一条记录必须整条放入发送队列,否则接收方再也无法同步
+    if ((tcp_sndbuf(pcb) < len + AES_REC_OVERHEAD) ||
+        (tcp_sndqueuelen(pcb) + (len + AES_GCM_CHUNK - 1) / AES_GCM_CHUNK + 2 > TCP_SND_QUEUELEN))
+    {
+        return ERR_MEM;
+    }
+    err = aes_rec_seal_start(&conn->tx, len, hdr);
+    if (err == ERR_OK)
+    {
+        err = tcp_write(pcb, hdr, AES_REC_HDR_SIZE, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+    }
+    //每次加密一段到app_tcp_scratch,tcp_write()复制后再加密下一段
+    for (; (err == ERR_OK) && (len != 0); len -= n, data += n)
+    {
+        n = LWIP_MIN(len, AES_GCM_CHUNK);
+        err = aes_rec_seal(&conn->tx, data, app_tcp_scratch, n);
+        if (err == ERR_OK)
+        {
+            err = tcp_write(pcb, app_tcp_scratch, n, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+        }
+    }
+    if (err == ERR_OK)
+    {
+        err = aes_rec_seal_finish(&conn->tx, tag);
+    }
+    if (err == ERR_OK)
+    {
+        err = tcp_write(pcb, tag, AES_GCM_TAG_SIZE, TCP_WRITE_FLAG_COPY);
+    }
+    if (err != ERR_OK)
+    {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+#else
+    return tcp_write(pcb, data, len, TCP_WRITE_FLAG_COPY);
+#endif
+}
+
 s32 app_tcp_init(void)
 {
     struct tcp_pcb *pcb;
     u16_t port = 4090;
+#if APP_TCP_CRYPT
+    static const u8_t rx_key[] = APP_TCP_RX_KEY;
+    static const u8_t tx_key[] = APP_TCP_TX_KEY;
+
+    if ((aes_gcm_setkey(&app_tcp_rx_key, rx_key, sizeof(rx_key)) != ERR_OK) ||
+        (aes_gcm_setkey(&app_tcp_tx_key, tx_key, sizeof(tx_key)) != ERR_OK))
+    {
+        return -1;
+    }
+#if APP_TCP_CRYP_ENGINE
+    CRYP_CTR_Init();
+#endif
+#endif
 
     pcb = tcp_new();
     tcp_bind(pcb, IP_ADDR_ANY, port);
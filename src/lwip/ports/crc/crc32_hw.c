@@ -0,0 +1,84 @@
+#include "crc32_hw.h"
+#include "lwip/sys.h"
+
+#if LWIP_CRC32
+
+#ifndef CRC_REG_MODEL
+#include "stm32f4xx.h"
+
+//CRC寄存器的访问和位反转,主机上的单元测试用寄存器模型替换这些宏
+#define CRC_REG_WR(reg, val)    (CRC->reg = (val))
+#define CRC_REG_RD(reg)         (CRC->reg)
+#define CRC_RBIT(x)             __RBIT(x)
+#endif
+
+#define CRC32_HW_POLY           0x04C11DB7UL
+
+static u8_t CRC_Busy;       //CRC外设正在使用
+
+//数据寄存器写入w时,DR=(DR^w)*x^32 mod P;这里求它的逆运算
+static u32_t CRC32_HW_Unshift(u32_t r)
+{
+    u8_t i;
+
+    for (i = 0; i < 32; i++)
+    {
+        r = (r & 1) ? (((r ^ CRC32_HW_POLY) >> 1) | 0x80000000UL) : (r >> 1);
+    }
+    return r;
+}
+
+//接着crc(上次crc32()的结果)计算len字节,CRC外设被占用时全部由软件计算
+static u32_t CRC32_HW_Update(u32_t crc, const u8_t *data, u32_t len)
+{
+    u32_t head, words;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    //首部不在字边界上的字节
+    head = (4 - ((mem_ptr_t)data & 3)) & 3;
+    if (head > len)
+    {
+        head = len;
+    }
+    crc = crc32_sw(crc, data, head);
+    data += head;
+    len -= head;
+
+    words = len >> 2;
+    if (words != 0)
+    {
+        SYS_ARCH_PROTECT(lev);
+        if (CRC_Busy)
+        {
+            SYS_ARCH_UNPROTECT(lev);
+            return crc32_sw(crc, data, len);
+        }
+        CRC_Busy = 1;
+        SYS_ARCH_UNPROTECT(lev);
+
+        //外设的寄存器值是zlib内部寄存器(~crc)的位反转.DR不能直接写,
+        //复位成0xFFFFFFFF后写入一个字,使计算结果正好等于要继续的值
+        CRC_REG_WR(CR, CRC_CR_RESET);
+        CRC_REG_WR(DR, CRC32_HW_Unshift(CRC_RBIT(~crc)) ^ 0xFFFFFFFFUL);
+        for (; words != 0; words--, data += 4)
+        {
+            CRC_REG_WR(DR, CRC_RBIT(*(const u32_t *)data));
+        }
+        crc = ~CRC_RBIT(CRC_REG_RD(DR));
+        CRC_Busy = 0;
+    }
+    //尾部不足一个字的字节
+    return crc32_sw(crc, data, len & 3);
+}
+
+//打开CRC时钟,并把CRC外设设为crc32()的引擎
+void CRC32_HW_Init(void)
+{
+#ifndef CRC_REG_MODEL
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_CRC, ENABLE);
+#endif
+    CRC_Busy = 0;
+    crc32_set_engine(CRC32_HW_Update, CRC32_HW_MIN);
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __CRC32_HW_H
+#define __CRC32_HW_H
+#include "lwip/opt.h"
+#include "lwip/crc32.h"
+
+//用STM32F4的CRC外设计算lwIP的crc32()(见lwip/crc32.h)
+//F4的CRC只能按32位字,从最高位开始计算,复位值固定为0xFFFFFFFF,没有输入/输出反转:
+//每个字和结果用RBIT指令反转后与zlib的CRC-32一致;不在字边界上的首尾字节由软件计算
+
+#define CRC32_HW_MIN            64      //不少于这么多字节才用CRC外设
+
+void CRC32_HW_Init(void);
+
+#endif
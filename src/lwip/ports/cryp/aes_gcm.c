@@ -0,0 +1,512 @@
+#include "aes_gcm.h"
+#include "lwip/def.h"
+#include <string.h>
+
+#define AES_GET32(p)        (((u32_t)(p)[0] << 24) | ((u32_t)(p)[1] << 16) | ((u32_t)(p)[2] << 8) | (u32_t)(p)[3])
+#define AES_PUT32(p, v)     do { (p)[0] = (u8_t)((v) >> 24); (p)[1] = (u8_t)((v) >> 16); \
+                                 (p)[2] = (u8_t)((v) >> 8); (p)[3] = (u8_t)(v); } while (0)
+#define AES_ROR(x, n)       (((x) >> (n)) | ((x) << (32 - (n))))
+
+const struct aes_ctr_engine *aes_gcm_engine;
+struct aes_gcm_stats aes_gcm_stats;
+
+//AES的S盒
+static const u8_t aes_sbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+//加密轮的T表:S盒乘以列混合矩阵的第一列(2,1,1,3),其余三列由循环移位得到
+static const u32_t aes_te0[256] =
+{
+    0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL, 0xfff2f20dUL, 0xd66b6bbdUL, 0xde6f6fb1UL, 0x91c5c554UL,
+    0x60303050UL, 0x02010103UL, 0xce6767a9UL, 0x562b2b7dUL, 0xe7fefe19UL, 0xb5d7d762UL, 0x4dababe6UL, 0xec76769aUL,
+    0x8fcaca45UL, 0x1f82829dUL, 0x89c9c940UL, 0xfa7d7d87UL, 0xeffafa15UL, 0xb25959ebUL, 0x8e4747c9UL, 0xfbf0f00bUL,
+    0x41adadecUL, 0xb3d4d467UL, 0x5fa2a2fdUL, 0x45afafeaUL, 0x239c9cbfUL, 0x53a4a4f7UL, 0xe4727296UL, 0x9bc0c05bUL,
+    0x75b7b7c2UL, 0xe1fdfd1cUL, 0x3d9393aeUL, 0x4c26266aUL, 0x6c36365aUL, 0x7e3f3f41UL, 0xf5f7f702UL, 0x83cccc4fUL,
+    0x6834345cUL, 0x51a5a5f4UL, 0xd1e5e534UL, 0xf9f1f108UL, 0xe2717193UL, 0xabd8d873UL, 0x62313153UL, 0x2a15153fUL,
+    0x0804040cUL, 0x95c7c752UL, 0x46232365UL, 0x9dc3c35eUL, 0x30181828UL, 0x379696a1UL, 0x0a05050fUL, 0x2f9a9ab5UL,
+    0x0e070709UL, 0x24121236UL, 0x1b80809bUL, 0xdfe2e23dUL, 0xcdebeb26UL, 0x4e272769UL, 0x7fb2b2cdUL, 0xea75759fUL,
+    0x1209091bUL, 0x1d83839eUL, 0x582c2c74UL, 0x341a1a2eUL, 0x361b1b2dUL, 0xdc6e6eb2UL, 0xb45a5aeeUL, 0x5ba0a0fbUL,
+    0xa45252f6UL, 0x763b3b4dUL, 0xb7d6d661UL, 0x7db3b3ceUL, 0x5229297bUL, 0xdde3e33eUL, 0x5e2f2f71UL, 0x13848497UL,
+    0xa65353f5UL, 0xb9d1d168UL, 0x00000000UL, 0xc1eded2cUL, 0x40202060UL, 0xe3fcfc1fUL, 0x79b1b1c8UL, 0xb65b5bedUL,
+    0xd46a6abeUL, 0x8dcbcb46UL, 0x67bebed9UL, 0x7239394bUL, 0x944a4adeUL, 0x984c4cd4UL, 0xb05858e8UL, 0x85cfcf4aUL,
+    0xbbd0d06bUL, 0xc5efef2aUL, 0x4faaaae5UL, 0xedfbfb16UL, 0x864343c5UL, 0x9a4d4dd7UL, 0x66333355UL, 0x11858594UL,
+    0x8a4545cfUL, 0xe9f9f910UL, 0x04020206UL, 0xfe7f7f81UL, 0xa05050f0UL, 0x783c3c44UL, 0x259f9fbaUL, 0x4ba8a8e3UL,
+    0xa25151f3UL, 0x5da3a3feUL, 0x804040c0UL, 0x058f8f8aUL, 0x3f9292adUL, 0x219d9dbcUL, 0x70383848UL, 0xf1f5f504UL,
+    0x63bcbcdfUL, 0x77b6b6c1UL, 0xafdada75UL, 0x42212163UL, 0x20101030UL, 0xe5ffff1aUL, 0xfdf3f30eUL, 0xbfd2d26dUL,
+    0x81cdcd4cUL, 0x180c0c14UL, 0x26131335UL, 0xc3ecec2fUL, 0xbe5f5fe1UL, 0x359797a2UL, 0x884444ccUL, 0x2e171739UL,
+    0x93c4c457UL, 0x55a7a7f2UL, 0xfc7e7e82UL, 0x7a3d3d47UL, 0xc86464acUL, 0xba5d5de7UL, 0x3219192bUL, 0xe6737395UL,
+    0xc06060a0UL, 0x19818198UL, 0x9e4f4fd1UL, 0xa3dcdc7fUL, 0x44222266UL, 0x542a2a7eUL, 0x3b9090abUL, 0x0b888883UL,
+    0x8c4646caUL, 0xc7eeee29UL, 0x6bb8b8d3UL, 0x2814143cUL, 0xa7dede79UL, 0xbc5e5ee2UL, 0x160b0b1dUL, 0xaddbdb76UL,
+    0xdbe0e03bUL, 0x64323256UL, 0x743a3a4eUL, 0x140a0a1eUL, 0x924949dbUL, 0x0c06060aUL, 0x4824246cUL, 0xb85c5ce4UL,
+    0x9fc2c25dUL, 0xbdd3d36eUL, 0x43acacefUL, 0xc46262a6UL, 0x399191a8UL, 0x319595a4UL, 0xd3e4e437UL, 0xf279798bUL,
+    0xd5e7e732UL, 0x8bc8c843UL, 0x6e373759UL, 0xda6d6db7UL, 0x018d8d8cUL, 0xb1d5d564UL, 0x9c4e4ed2UL, 0x49a9a9e0UL,
+    0xd86c6cb4UL, 0xac5656faUL, 0xf3f4f407UL, 0xcfeaea25UL, 0xca6565afUL, 0xf47a7a8eUL, 0x47aeaee9UL, 0x10080818UL,
+    0x6fbabad5UL, 0xf0787888UL, 0x4a25256fUL, 0x5c2e2e72UL, 0x381c1c24UL, 0x57a6a6f1UL, 0x73b4b4c7UL, 0x97c6c651UL,
+    0xcbe8e823UL, 0xa1dddd7cUL, 0xe874749cUL, 0x3e1f1f21UL, 0x964b4bddUL, 0x61bdbddcUL, 0x0d8b8b86UL, 0x0f8a8a85UL,
+    0xe0707090UL, 0x7c3e3e42UL, 0x71b5b5c4UL, 0xcc6666aaUL, 0x904848d8UL, 0x06030305UL, 0xf7f6f601UL, 0x1c0e0e12UL,
+    0xc26161a3UL, 0x6a35355fUL, 0xae5757f9UL, 0x69b9b9d0UL, 0x17868691UL, 0x99c1c158UL, 0x3a1d1d27UL, 0x279e9eb9UL,
+    0xd9e1e138UL, 0xebf8f813UL, 0x2b9898b3UL, 0x22111133UL, 0xd26969bbUL, 0xa9d9d970UL, 0x078e8e89UL, 0x339494a7UL,
+    0x2d9b9bb6UL, 0x3c1e1e22UL, 0x15878792UL, 0xc9e9e920UL, 0x87cece49UL, 0xaa5555ffUL, 0x50282878UL, 0xa5dfdf7aUL,
+    0x038c8c8fUL, 0x59a1a1f8UL, 0x09898980UL, 0x1a0d0d17UL, 0x65bfbfdaUL, 0xd7e6e631UL, 0x844242c6UL, 0xd06868b8UL,
+    0x824141c3UL, 0x299999b0UL, 0x5a2d2d77UL, 0x1e0f0f11UL, 0x7bb0b0cbUL, 0xa85454fcUL, 0x6dbbbbd6UL, 0x2c16163aUL
+};
+
+//GHASH每移出4位需要异或到最高位的约简值
+static const u16_t aes_gcm_last4[16] =
+{
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static const u8_t aes_rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+
+static u32_t aes_subword(u32_t w)
+{
+    return ((u32_t)aes_sbox[w >> 24] << 24) | ((u32_t)aes_sbox[(w >> 16) & 0xff] << 16) |
+           ((u32_t)aes_sbox[(w >> 8) & 0xff] << 8) | aes_sbox[w & 0xff];
+}
+
+//用密钥k加密一个16字节块,in和out可以相同
+void aes_encrypt_block(const struct aes_gcm_key *k, const u8_t *in, u8_t *out)
+{
+    const u32_t *rk = k->rk;
+    u32_t s0, s1, s2, s3, t0, t1, t2, t3;
+    u8_t r;
+
+    s0 = AES_GET32(in) ^ rk[0];
+    s1 = AES_GET32(in + 4) ^ rk[1];
+    s2 = AES_GET32(in + 8) ^ rk[2];
+    s3 = AES_GET32(in + 12) ^ rk[3];
+    for (r = 1; r < k->nr; r++)
+    {
+        rk += 4;
+        t0 = aes_te0[s0 >> 24] ^ AES_ROR(aes_te0[(s1 >> 16) & 0xff], 8) ^
+             AES_ROR(aes_te0[(s2 >> 8) & 0xff], 16) ^ AES_ROR(aes_te0[s3 & 0xff], 24) ^ rk[0];
+        t1 = aes_te0[s1 >> 24] ^ AES_ROR(aes_te0[(s2 >> 16) & 0xff], 8) ^
+             AES_ROR(aes_te0[(s3 >> 8) & 0xff], 16) ^ AES_ROR(aes_te0[s0 & 0xff], 24) ^ rk[1];
+        t2 = aes_te0[s2 >> 24] ^ AES_ROR(aes_te0[(s3 >> 16) & 0xff], 8) ^
+             AES_ROR(aes_te0[(s0 >> 8) & 0xff], 16) ^ AES_ROR(aes_te0[s1 & 0xff], 24) ^ rk[2];
+        t3 = aes_te0[s3 >> 24] ^ AES_ROR(aes_te0[(s0 >> 16) & 0xff], 8) ^
+             AES_ROR(aes_te0[(s1 >> 8) & 0xff], 16) ^ AES_ROR(aes_te0[s2 & 0xff], 24) ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    //最后一轮没有列混合
+    rk += 4;
+    t0 = ((u32_t)aes_sbox[s0 >> 24] << 24) ^ ((u32_t)aes_sbox[(s1 >> 16) & 0xff] << 16) ^
+         ((u32_t)aes_sbox[(s2 >> 8) & 0xff] << 8) ^ aes_sbox[s3 & 0xff] ^ rk[0];
+    t1 = ((u32_t)aes_sbox[s1 >> 24] << 24) ^ ((u32_t)aes_sbox[(s2 >> 16) & 0xff] << 16) ^
+         ((u32_t)aes_sbox[(s3 >> 8) & 0xff] << 8) ^ aes_sbox[s0 & 0xff] ^ rk[1];
+    t2 = ((u32_t)aes_sbox[s2 >> 24] << 24) ^ ((u32_t)aes_sbox[(s3 >> 16) & 0xff] << 16) ^
+         ((u32_t)aes_sbox[(s0 >> 8) & 0xff] << 8) ^ aes_sbox[s1 & 0xff] ^ rk[2];
+    t3 = ((u32_t)aes_sbox[s3 >> 24] << 24) ^ ((u32_t)aes_sbox[(s0 >> 16) & 0xff] << 16) ^
+         ((u32_t)aes_sbox[(s1 >> 8) & 0xff] << 8) ^ aes_sbox[s2 & 0xff] ^ rk[3];
+    AES_PUT32(out, t0);
+    AES_PUT32(out + 4, t1);
+    AES_PUT32(out + 8, t2);
+    AES_PUT32(out + 12, t3);
+}
+
+//展开密钥并生成GHASH表
+//返回值:ERR_OK,成功;ERR_VAL,密钥长度不是16,24或32字节
+err_t aes_gcm_setkey(struct aes_gcm_key *k, const u8_t *key, u8_t keylen)
+{
+    u32_t nk, i, t;
+    u8_t h[16];
+
+    if ((keylen != 16) && (keylen != 24) && (keylen != 32))
+    {
+        return ERR_VAL;
+    }
+    nk = keylen / 4;
+    k->nr = (u8_t)(nk + 6);
+    k->keylen = keylen;
+    MEMCPY(k->key, key, keylen);
+    for (i = 0; i < nk; i++)
+    {
+        k->rk[i] = AES_GET32(key + 4 * i);
+    }
+    for (i = nk; i < 4 * (k->nr + 1U); i++)
+    {
+        t = k->rk[i - 1];
+        if (i % nk == 0)
+        {
+            t = aes_subword((t << 8) | (t >> 24)) ^ ((u32_t)aes_rcon[i / nk - 1] << 24);
+        }
+        else if ((nk > 6) && (i % nk == 4))
+        {
+            t = aes_subword(t);
+        }
+        k->rk[i] = k->rk[i - nk] ^ t;
+    }
+
+    //H=E(K,0),hl[i]是H乘以4位数i(GCM的位序,最高位在前)
+    memset(h, 0, sizeof(h));
+    aes_encrypt_block(k, h, h);
+    memset(k->hl[0], 0, sizeof(k->hl[0]));
+    for (i = 0; i < 4; i++)
+    {
+        k->hl[8][i] = AES_GET32(h + 4 * i);
+    }
+    for (i = 4; i > 0; i >>= 1)
+    {
+        t = (k->hl[2 * i][3] & 1) ? 0xe1000000UL : 0;
+        k->hl[i][3] = (k->hl[2 * i][3] >> 1) | (k->hl[2 * i][2] << 31);
+        k->hl[i][2] = (k->hl[2 * i][2] >> 1) | (k->hl[2 * i][1] << 31);
+        k->hl[i][1] = (k->hl[2 * i][1] >> 1) | (k->hl[2 * i][0] << 31);
+        k->hl[i][0] = (k->hl[2 * i][0] >> 1) ^ t;
+    }
+    for (i = 2; i <= 8; i *= 2)
+    {
+        for (t = 1; t < i; t++)
+        {
+            k->hl[i + t][0] = k->hl[i][0] ^ k->hl[t][0];
+            k->hl[i + t][1] = k->hl[i][1] ^ k->hl[t][1];
+            k->hl[i + t][2] = k->hl[i][2] ^ k->hl[t][2];
+            k->hl[i + t][3] = k->hl[i][3] ^ k->hl[t][3];
+        }
+    }
+    return ERR_OK;
+}
+
+//x=x*H,每次处理4位
+static void aes_gcm_gmul(const struct aes_gcm_key *k, u8_t *x)
+{
+    u32_t z0, z1, z2, z3, rem;
+    u8_t lo, hi;
+    int i;
+
+    lo = x[15] & 0xf;
+    z0 = k->hl[lo][0];
+    z1 = k->hl[lo][1];
+    z2 = k->hl[lo][2];
+    z3 = k->hl[lo][3];
+    for (i = 15; i >= 0; i--)
+    {
+        lo = x[i] & 0xf;
+        hi = x[i] >> 4;
+        if (i != 15)
+        {
+            rem = z3 & 0xf;
+            z3 = (z3 >> 4) | (z2 << 28);
+            z2 = (z2 >> 4) | (z1 << 28);
+            z1 = (z1 >> 4) | (z0 << 28);
+            z0 = (z0 >> 4) ^ ((u32_t)aes_gcm_last4[rem] << 16);
+            z0 ^= k->hl[lo][0];
+            z1 ^= k->hl[lo][1];
+            z2 ^= k->hl[lo][2];
+            z3 ^= k->hl[lo][3];
+        }
+        rem = z3 & 0xf;
+        z3 = (z3 >> 4) | (z2 << 28);
+        z2 = (z2 >> 4) | (z1 << 28);
+        z1 = (z1 >> 4) | (z0 << 28);
+        z0 = (z0 >> 4) ^ ((u32_t)aes_gcm_last4[rem] << 16);
+        z0 ^= k->hl[hi][0];
+        z1 ^= k->hl[hi][1];
+        z2 ^= k->hl[hi][2];
+        z3 ^= k->hl[hi][3];
+    }
+    AES_PUT32(x, z0);
+    AES_PUT32(x + 4, z1);
+    AES_PUT32(x + 8, z2);
+    AES_PUT32(x + 12, z3);
+}
+
+//对整块的数据计算GHASH,len必须是16的倍数
+static void aes_gcm_ghash(struct aes_gcm *ctx, const u8_t *data, u32_t len)
+{
+    u32_t i;
+
+    for (; len >= 16; len -= 16, data += 16)
+    {
+        for (i = 0; i < 16; i++)
+        {
+            ctx->y[i] ^= data[i];
+        }
+        aes_gcm_gmul(ctx->k, ctx->y);
+    }
+}
+
+//计数器块的低32位加n
+static void aes_gcm_inc32(u8_t *ctr, u32_t n)
+{
+    u32_t c = AES_GET32(ctr + 12) + n;
+
+    AES_PUT32(ctr + 12, c);
+}
+
+//用软件AES做len字节(16的倍数)的CTR运算
+static void aes_gcm_ctr_soft(struct aes_gcm *ctx, const u8_t *in, u8_t *out, u32_t len)
+{
+    u8_t ks[16];
+    u32_t i;
+
+    for (; len >= 16; len -= 16, in += 16, out += 16)
+    {
+        aes_encrypt_block(ctx->k, ctx->ctr, ks);
+        aes_gcm_inc32(ctx->ctr, 1);
+        for (i = 0; i < 16; i++)
+        {
+            out[i] = in[i] ^ ks[i];
+        }
+    }
+}
+
+//处理整块的数据:每AES_GCM_CHUNK字节交给CTR引擎一次,引擎工作时CPU计算GHASH
+//解密时先算下一段密文的GHASH(引擎还没碰到它),加密时算上一段已输出密文的GHASH,
+//所以in和out相同时也不会读到引擎正在改写的数据
+static err_t aes_gcm_bulk(struct aes_gcm *ctx, const u8_t *in, u8_t *out, u32_t len)
+{
+    const struct aes_ctr_engine *eng = aes_gcm_engine;
+    const u8_t *pend = NULL;    //加密时还没计算GHASH的上一段密文
+    u32_t pend_len = 0;
+    u32_t done = 0;             //解密时已计算GHASH的密文字节数
+    u32_t off, n;
+    err_t err;
+
+    for (off = 0; off < len; off += n)
+    {
+        n = len - off;
+        if (n > AES_GCM_CHUNK)
+        {
+            n = AES_GCM_CHUNK;
+        }
+        if (!ctx->enc && (done < off + n))
+        {
+            aes_gcm_ghash(ctx, in + off, n);
+            done = off + n;
+        }
+        if ((eng != NULL) && (eng->start(ctx->k->key, ctx->k->keylen, ctx->ctr, in + off, out + off, n) == ERR_OK))
+        {
+            if (ctx->enc)
+            {
+                aes_gcm_ghash(ctx, pend, pend_len);
+                pend_len = 0;
+            }
+            else
+            {
+                pend_len = len - done;
+                if (pend_len > AES_GCM_CHUNK)
+                {
+                    pend_len = AES_GCM_CHUNK;
+                }
+                aes_gcm_ghash(ctx, in + done, pend_len);
+                done += pend_len;
+                pend_len = 0;
+            }
+            err = eng->wait();
+            if (err != ERR_OK)
+            {
+                ctx->err = 1;
+                return err;
+            }
+            aes_gcm_inc32(ctx->ctr, n / 16);
+            aes_gcm_stats.engine_bytes += n;
+        }
+        else
+        {
+            if (eng != NULL)
+            {
+                aes_gcm_stats.fallback++;
+            }
+            aes_gcm_ctr_soft(ctx, in + off, out + off, n);
+            aes_gcm_stats.soft_bytes += n;
+        }
+        if (ctx->enc)
+        {
+            aes_gcm_ghash(ctx, pend, pend_len);
+            pend = out + off;
+            pend_len = n;
+        }
+    }
+    aes_gcm_ghash(ctx, pend, pend_len);
+    return ERR_OK;
+}
+
+//选择CTR引擎,NULL表示只用软件AES
+void aes_gcm_set_engine(const struct aes_ctr_engine *engine)
+{
+    aes_gcm_engine = engine;
+}
+
+//开始一条消息:enc为1加密,0解密;iv为12字节;aad是只认证不加密的附加数据
+err_t aes_gcm_start(struct aes_gcm *ctx, const struct aes_gcm_key *k, u8_t enc,
+                    const u8_t *iv, const u8_t *aad, u32_t aad_len)
+{
+    u32_t i;
+
+    ctx->k = k;
+    ctx->enc = enc;
+    ctx->err = 0;
+    ctx->aad_len = aad_len;
+    ctx->ct_len = 0;
+    memset(ctx->y, 0, sizeof(ctx->y));
+    //J0=IV||0x00000001,数据从inc32(J0)开始加密
+    MEMCPY(ctx->ctr, iv, AES_GCM_IV_SIZE);
+    AES_PUT32(ctx->ctr + 12, 1UL);
+    aes_encrypt_block(k, ctx->ctr, ctx->ek0);
+    aes_gcm_inc32(ctx->ctr, 1);
+
+    for (; aad_len > 0; aad_len -= i, aad += i)
+    {
+        for (i = 0; (i < 16) && (i < aad_len); i++)
+        {
+            ctx->y[i] ^= aad[i];
+        }
+        aes_gcm_gmul(k, ctx->y);
+    }
+    return ERR_OK;
+}
+
+//加密或解密len字节,in和out可以相同,但不能部分重叠
+//返回值:ERR_OK,成功;ERR_IF或ERR_TIMEOUT,CTR引擎出错(这条消息已作废)
+err_t aes_gcm_update(struct aes_gcm *ctx, const u8_t *in, u8_t *out, u32_t len)
+{
+    u32_t pos = ctx->ct_len & 15;
+    u32_t n;
+    err_t err;
+    u8_t c;
+
+    if (ctx->err)
+    {
+        return ERR_IF;
+    }
+    ctx->ct_len += len;
+    //先用完上一次剩下的密钥流
+    for (; (pos != 0) && (len != 0); len--)
+    {
+        c = *in++;
+        *out = c ^ ctx->ks[pos];
+        ctx->y[pos] ^= ctx->enc ? *out : c;
+        out++;
+        pos = (pos + 1) & 15;
+        if (pos == 0)
+        {
+            aes_gcm_gmul(ctx->k, ctx->y);
+        }
+    }
+    n = len & ~15UL;
+    if (n != 0)
+    {
+        err = aes_gcm_bulk(ctx, in, out, n);
+        if (err != ERR_OK)
+        {
+            return err;
+        }
+        in += n;
+        out += n;
+        len -= n;
+    }
+    //不足一块的尾部,剩下的密钥流留给下一次
+    if (len != 0)
+    {
+        aes_encrypt_block(ctx->k, ctx->ctr, ctx->ks);
+        aes_gcm_inc32(ctx->ctr, 1);
+        for (pos = 0; pos < len; pos++)
+        {
+            c = in[pos];
+            out[pos] = c ^ ctx->ks[pos];
+            ctx->y[pos] ^= ctx->enc ? out[pos] : c;
+        }
+    }
+    return ERR_OK;
+}
+
+//就地加密或解密pbuf链中从offset开始的len字节
+//返回值:ERR_OK,成功;ERR_BUF,pbuf链不够长;其他,见aes_gcm_update()
+err_t aes_gcm_update_pbuf(struct aes_gcm *ctx, struct pbuf *p, u16_t offset, u16_t len)
+{
+    u16_t n;
+    err_t err;
+
+    for (; (p != NULL) && (offset >= p->len); p = p->next)
+    {
+        offset -= p->len;
+    }
+    for (; (p != NULL) && (len != 0); p = p->next)
+    {
+        n = p->len - offset;
+        if (n > len)
+        {
+            n = len;
+        }
+        err = aes_gcm_update(ctx, (u8_t *)p->payload + offset, (u8_t *)p->payload + offset, n);
+        if (err != ERR_OK)
+        {
+            return err;
+        }
+        len -= n;
+        offset = 0;
+    }
+    return (len == 0) ? ERR_OK : ERR_BUF;
+}
+
+//结束消息,计算16字节标签
+//返回值:ERR_OK,成功;ERR_IF,CTR引擎出错过,标签无效
+err_t aes_gcm_finish(struct aes_gcm *ctx, u8_t *tag)
+{
+    u8_t i;
+
+    if (ctx->ct_len & 15)
+    {
+        aes_gcm_gmul(ctx->k, ctx->y);
+    }
+    //最后一块是附加数据和密文的位数,各64位大端
+    ctx->y[3] ^= (u8_t)(ctx->aad_len >> 29);
+    ctx->y[4] ^= (u8_t)(ctx->aad_len >> 21);
+    ctx->y[5] ^= (u8_t)(ctx->aad_len >> 13);
+    ctx->y[6] ^= (u8_t)(ctx->aad_len >> 5);
+    ctx->y[7] ^= (u8_t)(ctx->aad_len << 3);
+    ctx->y[11] ^= (u8_t)(ctx->ct_len >> 29);
+    ctx->y[12] ^= (u8_t)(ctx->ct_len >> 21);
+    ctx->y[13] ^= (u8_t)(ctx->ct_len >> 13);
+    ctx->y[14] ^= (u8_t)(ctx->ct_len >> 5);
+    ctx->y[15] ^= (u8_t)(ctx->ct_len << 3);
+    aes_gcm_gmul(ctx->k, ctx->y);
+    for (i = 0; i < AES_GCM_TAG_SIZE; i++)
+    {
+        tag[i] = ctx->y[i] ^ ctx->ek0[i];
+    }
+    return ctx->err ? ERR_IF : ERR_OK;
+}
+
+//结束解密并检查标签,比较时间与标签内容无关
+//返回值:ERR_OK,标签正确;ERR_VAL,标签错误,解密出的数据不能使用;ERR_IF,CTR引擎出错过
+err_t aes_gcm_check(struct aes_gcm *ctx, const u8_t *tag)
+{
+    u8_t t[AES_GCM_TAG_SIZE];
+    u8_t diff = 0;
+    u8_t i;
+    err_t err;
+
+    err = aes_gcm_finish(ctx, t);
+    for (i = 0; i < AES_GCM_TAG_SIZE; i++)
+    {
+        diff |= t[i] ^ tag[i];
+    }
+    if (err != ERR_OK)
+    {
+        return err;
+    }
+    return diff ? ERR_VAL : ERR_OK;
+}
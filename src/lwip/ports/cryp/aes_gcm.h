@@ -0,0 +1,78 @@
+#ifndef __AES_GCM_H
+#define __AES_GCM_H
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/pbuf.h"
+
+//流式AES-GCM(NIST SP 800-38D,96位IV,16字节标签)
+//aes_gcm_start()/aes_gcm_update()/aes_gcm_finish()可以分任意多次送入数据,也可以直接处理pbuf链
+//CTR部分交给可替换的CTR引擎(例如CRYP外设,见cryp_ctr.h),引擎工作时CPU计算GHASH;
+//没有引擎或引擎忙时用软件AES,主机上的单元测试也用软件实现
+
+#ifndef AES_GCM_CHUNK
+#define AES_GCM_CHUNK           256     //每次交给CTR引擎的字节数,必须是16的倍数
+#endif
+
+#define AES_GCM_IV_SIZE         12
+#define AES_GCM_TAG_SIZE        16
+
+//CTR引擎:用key对计数器块ctr开始的len字节(16的倍数)做AES-CTR,计数器只递增低32位(同GCM的inc32)
+//start()返回ERR_OK表示已开始,其他值表示这一段改用软件计算(ERR_INPROGRESS,引擎正忙;ERR_VAL,引擎访问不到数据);
+//wait()等待这一段完成,返回ERR_OK,ERR_TIMEOUT或ERR_IF.start()成功后必须调用wait()
+struct aes_ctr_engine
+{
+    const char *name;
+    err_t (*start)(const u8_t *key, u8_t keylen, const u8_t *ctr, const u8_t *in, u8_t *out, u32_t len);
+    err_t (*wait)(void);
+};
+
+//一个密钥的展开结果和GHASH表,可以被多个记录重复使用
+struct aes_gcm_key
+{
+    u32_t rk[60];           //轮密钥
+    u32_t hl[16][4];        //GHASH的4位乘法表(Shoup),H的各倍数,字0是最高位
+    u8_t  key[32];          //原始密钥,交给CTR引擎
+    u8_t  keylen;           //16,24或32
+    u8_t  nr;               //轮数
+};
+
+//一条消息的GCM状态
+struct aes_gcm
+{
+    const struct aes_gcm_key *k;
+    u8_t  ctr[16];          //下一个要用的计数器块
+    u8_t  ek0[16];          //E(K,J0),与GHASH结果异或得到标签
+    u8_t  y[16];            //GHASH累加值
+    u8_t  ks[16];           //不足一块时剩下的密钥流
+    u32_t aad_len;
+    u32_t ct_len;           //已处理的密文字节数,低4位是未满块中的位置
+    u8_t  enc;              //1,加密;0,解密
+    u8_t  err;              //CTR引擎出错,输出已不可信
+};
+
+//被选用的CTR引擎,NULL表示只用软件
+extern const struct aes_ctr_engine *aes_gcm_engine;
+
+//CTR引擎的使用统计
+struct aes_gcm_stats
+{
+    u32_t engine_bytes;     //由引擎处理的字节数
+    u32_t soft_bytes;       //由软件AES处理的字节数
+    u32_t fallback;         //引擎不能接受而改用软件的次数
+};
+
+extern struct aes_gcm_stats aes_gcm_stats;
+
+void  aes_gcm_set_engine(const struct aes_ctr_engine *engine);
+
+err_t aes_gcm_setkey(struct aes_gcm_key *k, const u8_t *key, u8_t keylen);
+void  aes_encrypt_block(const struct aes_gcm_key *k, const u8_t *in, u8_t *out);
+
+err_t aes_gcm_start(struct aes_gcm *ctx, const struct aes_gcm_key *k, u8_t enc,
+                    const u8_t *iv, const u8_t *aad, u32_t aad_len);
+err_t aes_gcm_update(struct aes_gcm *ctx, const u8_t *in, u8_t *out, u32_t len);
+err_t aes_gcm_update_pbuf(struct aes_gcm *ctx, struct pbuf *p, u16_t offset, u16_t len);
+err_t aes_gcm_finish(struct aes_gcm *ctx, u8_t *tag);
+err_t aes_gcm_check(struct aes_gcm *ctx, const u8_t *tag);
+
+#endif
@@ -0,0 +1,159 @@
+#include "aes_rec.h"
+#include "lwip/def.h"
+#include <string.h>
+
+//接收状态
+#define AES_REC_RX_SALT     0
+#define AES_REC_RX_HDR      1
+#define AES_REC_RX_BODY     2
+#define AES_REC_RX_TAG      3
+
+//记录头放在附加数据的盐值之后
+#define AES_REC_HDR(r)      ((r)->aad + AES_REC_SALT_SIZE)
+
+//初始化一个方向:发送方向给出本连接的盐值,接收方向salt为NULL,盐值从数据流中读出
+//bind不为NULL时,每条记录都认证这个盐值(接收方向给出本机发出的盐值,见aes_rec.h)
+void aes_rec_init(struct aes_rec *r, const struct aes_gcm_key *key, const u8_t *salt, const u8_t *bind)
+{
+    memset(r, 0, sizeof(*r));
+    r->key = key;
+    if (bind != NULL)
+    {
+        MEMCPY(r->aad, bind, AES_REC_SALT_SIZE);
+        r->bind = 1;
+    }
+    if (salt != NULL)
+    {
+        MEMCPY(r->iv + 4, salt, AES_REC_SALT_SIZE);
+        r->state = AES_REC_RX_HDR;
+    }
+    else
+    {
+        r->state = AES_REC_RX_SALT;
+    }
+}
+
+//开始处理第seq条记录
+//返回值:ERR_OK,成功;ERR_VAL,序号已用完,必须换密钥
+static err_t aes_rec_start(struct aes_rec *r, u8_t enc)
+{
+    u8_t iv[AES_GCM_IV_SIZE];
+
+    if (r->seq == 0xffffffffUL)
+    {
+        return ERR_VAL;
+    }
+    MEMCPY(iv, r->iv, AES_GCM_IV_SIZE);
+    iv[8] ^= (u8_t)(r->seq >> 24);
+    iv[9] ^= (u8_t)(r->seq >> 16);
+    iv[10] ^= (u8_t)(r->seq >> 8);
+    iv[11] ^= (u8_t)r->seq;
+    r->seq++;
+    if (r->bind)
+    {
+        return aes_gcm_start(&r->gcm, r->key, enc, iv, r->aad, sizeof(r->aad));
+    }
+    return aes_gcm_start(&r->gcm, r->key, enc, iv, AES_REC_HDR(r), AES_REC_HDR_SIZE);
+}
+
+//开始发送一条len字节的记录,hdr返回要先发送的2字节记录头
+//之后用aes_rec_seal()分段加密内容,最后aes_rec_seal_finish()得到标签
+err_t aes_rec_seal_start(struct aes_rec *r, u16_t len, u8_t *hdr)
+{
+    hdr[0] = AES_REC_HDR(r)[0] = (u8_t)(len >> 8);
+    hdr[1] = AES_REC_HDR(r)[1] = (u8_t)len;
+    return aes_rec_start(r, 1);
+}
+
+err_t aes_rec_seal(struct aes_rec *r, const u8_t *in, u8_t *out, u16_t len)
+{
+    return aes_gcm_update(&r->gcm, in, out, len);
+}
+
+err_t aes_rec_seal_finish(struct aes_rec *r, u8_t *tag)
+{
+    return aes_gcm_finish(&r->gcm, tag);
+}
+
+//处理收到的一个pbuf链(调用者负责释放p).记录内容边收边解密到stage中,
+//标签检查通过后才交给fn,检查失败时stage被清零
+//返回值:ERR_OK,成功;ERR_VAL,记录比size长,标签错误(包括重放的记录)或序号用完;其他,CTR引擎出错.出错后连接必须关闭
+err_t aes_rec_input(struct aes_rec *r, struct pbuf *p, u8_t *stage, u16_t size, aes_rec_fn fn, void *arg)
+{
+    const u8_t *data;
+    u16_t off, n;
+    err_t err;
+
+    for (; p != NULL; p = p->next)
+    {
+        data = (const u8_t *)p->payload;
+        for (off = 0; off < p->len; off += n)
+        {
+            n = p->len - off;
+            switch (r->state)
+            {
+            case AES_REC_RX_SALT:
+                n = LWIP_MIN(n, AES_REC_SALT_SIZE - r->got);
+                MEMCPY(r->iv + 4 + r->got, data + off, n);
+                r->got += n;
+                if (r->got == AES_REC_SALT_SIZE)
+                {
+                    r->got = 0;
+                    r->state = AES_REC_RX_HDR;
+                }
+                break;
+            case AES_REC_RX_HDR:
+                n = 1;
+                AES_REC_HDR(r)[r->got++] = data[off];
+                if (r->got == AES_REC_HDR_SIZE)
+                {
+                    r->len = ((u16_t)AES_REC_HDR(r)[0] << 8) | AES_REC_HDR(r)[1];
+                    if (r->len > size)
+                    {
+                        return ERR_VAL;
+                    }
+                    err = aes_rec_start(r, 0);
+                    if (err != ERR_OK)
+                    {
+                        return err;
+                    }
+                    r->got = 0;
+                    r->state = (r->len != 0) ? AES_REC_RX_BODY : AES_REC_RX_TAG;
+                }
+                break;
+            case AES_REC_RX_BODY:
+                n = LWIP_MIN(n, r->len - r->got);
+                err = aes_gcm_update(&r->gcm, data + off, stage + r->got, n);
+                if (err != ERR_OK)
+                {
+                    return err;
+                }
+                r->got += n;
+                if (r->got == r->len)
+                {
+                    r->got = 0;
+                    r->state = AES_REC_RX_TAG;
+                }
+                break;
+            default:
+                n = LWIP_MIN(n, AES_GCM_TAG_SIZE - r->got);
+                MEMCPY(r->tag + r->got, data + off, n);
+                r->got += n;
+                if (r->got == AES_GCM_TAG_SIZE)
+                {
+                    err = aes_gcm_check(&r->gcm, r->tag);
+                    if (err != ERR_OK)
+                    {
+                        memset(stage, 0, r->len);
+                        return err;
+                    }
+                    r->got = 0;
+                    r->state = AES_REC_RX_HDR;
+                    fn(arg, stage, r->len);
+                }
+                break;
+            }
+        }
+    }
+    return ERR_OK;
+}
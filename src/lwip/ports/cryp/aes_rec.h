@@ -0,0 +1,42 @@
+#ifndef __AES_REC_H
+#define __AES_REC_H
+#include "aes_gcm.h"
+
+//基于AES-GCM的TCP记录层
+//每个方向先发送8字节明文盐值,之后是一条条记录:2字节长度(大端,作为附加数据认证)+密文+16字节标签
+//第n条记录(从0开始)的IV是 4字节0||盐值,后8字节再与n(64位大端)异或.每个方向用不同的密钥,
+//盐值每个连接随机产生,所以同一密钥下IV不会重复
+//密钥是固定的,盐值又由发送方决定,所以接收方必须把记录绑定到自己发出的盐值上:
+//发给绑定方的每条记录,附加数据是 对方盐值||记录头.录下的会话重放到新连接时,
+//接收方的盐值已经换了,第一条记录的标签就通不过.因此对方要先收到绑定方的盐值才能发送记录
+
+#define AES_REC_SALT_SIZE       8
+#define AES_REC_HDR_SIZE        2
+#define AES_REC_OVERHEAD        (AES_REC_HDR_SIZE + AES_GCM_TAG_SIZE)
+
+struct aes_rec
+{
+    const struct aes_gcm_key *key;
+    struct aes_gcm gcm;
+    u8_t  iv[AES_GCM_IV_SIZE];
+    u32_t seq;              //下一条记录的序号
+    u16_t len;              //接收:当前记录的长度
+    u16_t got;              //接收:当前部分已收到的字节数
+    u8_t  state;            //接收:正在接收的部分
+    u8_t  bind;             //1,附加数据前带有绑定的盐值
+    u8_t  aad[AES_REC_SALT_SIZE + AES_REC_HDR_SIZE];   //附加数据:绑定的盐值+记录头
+    u8_t  tag[AES_GCM_TAG_SIZE];
+};
+
+//收到一条认证通过的记录,data是解密后的内容
+typedef void (*aes_rec_fn)(void *arg, u8_t *data, u16_t len);
+
+void  aes_rec_init(struct aes_rec *r, const struct aes_gcm_key *key, const u8_t *salt, const u8_t *bind);
+
+err_t aes_rec_seal_start(struct aes_rec *r, u16_t len, u8_t *hdr);
+err_t aes_rec_seal(struct aes_rec *r, const u8_t *in, u8_t *out, u16_t len);
+err_t aes_rec_seal_finish(struct aes_rec *r, u8_t *tag);
+
+err_t aes_rec_input(struct aes_rec *r, struct pbuf *p, u8_t *stage, u16_t size, aes_rec_fn fn, void *arg);
+
+#endif
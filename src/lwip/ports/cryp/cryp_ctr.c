@@ -0,0 +1,162 @@
+#include "cryp_ctr.h"
+#include "lwip/sys.h"
+
+#ifndef CRYP_REG_MODEL
+#include "stm32f4xx.h"
+
+//CRYP寄存器和DMA的访问,主机上的单元测试用寄存器模型替换这些宏
+#define CRYP_REG_WR(reg, val)               (CRYP->reg = (val))
+#define CRYP_REG_RD(reg)                    (CRYP->reg)
+#define CRYP_KEY_WR(i, val)                 ((&CRYP->K0LR)[i] = (val))
+#define CRYP_IV_WR(i, val)                  ((&CRYP->IV0LR)[i] = (val))
+#define CRYP_DMA_START(in, out, words)      CRYP_DMA_Start((in), (out), (words))
+#define CRYP_DMA_POLL()                     CRYP_DMA_Poll()
+#define CRYP_DMA_STOP()                     CRYP_DMA_Stop()
+#endif
+
+static u8_t CRYP_Busy;      //CRYP外设正在处理一段数据
+
+#define CRYP_GET32(p)       (((u32_t)(p)[0] << 24) | ((u32_t)(p)[1] << 16) | ((u32_t)(p)[2] << 8) | (u32_t)(p)[3])
+
+
+#ifndef CRYP_REG_MODEL
+//用DMA2数据流5和6在CRYP与存储器之间传输words个字
+//in,out:数据地址,不能在CCM RAM中;不是字对齐时存储器端按字节访问,由DMA的FIFO拼成字
+static void CRYP_DMA_Start(const u8_t *in, u8_t *out, u32_t words)
+{
+    u32_t msize;
+
+    DMA2_Stream5->CR = 0;
+    DMA2_Stream6->CR = 0;
+    while ((DMA2_Stream5->CR & DMA_SxCR_EN) || (DMA2_Stream6->CR & DMA_SxCR_EN));   //等待数据流关闭
+    DMA2->HIFCR = DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5 |
+                  DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+
+    //数据流5:CRYP_OUT,外设到存储器;NDTR按外设端(32位)计数
+    msize = (((mem_ptr_t)out & 3) == 0) ? DMA_SxCR_MSIZE_1 : 0;
+    DMA2_Stream5->PAR = (u32_t)&CRYP->DOUT;
+    DMA2_Stream5->M0AR = (u32_t)out;
+    DMA2_Stream5->NDTR = words;
+    DMA2_Stream5->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;
+    //通道2,最高优先级(输出FIFO满会使CRYP停下),存储器地址递增
+    DMA2_Stream5->CR = DMA_SxCR_CHSEL_1 | DMA_SxCR_PL | msize | DMA_SxCR_PSIZE_1 | DMA_SxCR_MINC | DMA_SxCR_EN;
+
+    //数据流6:CRYP_IN,存储器到外设
+    msize = (((mem_ptr_t)in & 3) == 0) ? DMA_SxCR_MSIZE_1 : 0;
+    DMA2_Stream6->PAR = (u32_t)&CRYP->DR;
+    DMA2_Stream6->M0AR = (u32_t)in;
+    DMA2_Stream6->NDTR = words;
+    DMA2_Stream6->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;
+    DMA2_Stream6->CR = DMA_SxCR_CHSEL_1 | DMA_SxCR_PL_1 | msize | DMA_SxCR_PSIZE_1 |
+                       DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_EN;
+}
+
+//返回值:0,传输中;1,输出已全部取回;-1,传输出错
+static int CRYP_DMA_Poll(void)
+{
+    if (DMA2->HISR & (DMA_HISR_TEIF5 | DMA_HISR_TEIF6))
+    {
+        DMA2_Stream5->CR = 0;
+        DMA2_Stream6->CR = 0;
+        return -1;
+    }
+    return (DMA2->HISR & DMA_HISR_TCIF5) ? 1 : 0;
+}
+
+//超时后关闭两个数据流,不再写输出缓冲区
+static void CRYP_DMA_Stop(void)
+{
+    DMA2_Stream5->CR = 0;
+    DMA2_Stream6->CR = 0;
+    while ((DMA2_Stream5->CR & DMA_SxCR_EN) || (DMA2_Stream6->CR & DMA_SxCR_EN));
+}
+#endif
+
+//开始对len字节做AES-CTR,ctr为16字节初始计数器块
+//返回值:ERR_OK,DMA已开始;ERR_INPROGRESS,CRYP正被占用;ERR_VAL,数据在DMA不能访问的CCM RAM中
+static err_t CRYP_CTR_Start(const u8_t *key, u8_t keylen, const u8_t *ctr, const u8_t *in, u8_t *out, u32_t len)
+{
+    u32_t cr, i, nk;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if ((((mem_ptr_t)in & 0xffff0000UL) == 0x10000000UL) || (((mem_ptr_t)out & 0xffff0000UL) == 0x10000000UL))
+    {
+        return ERR_VAL;
+    }
+    SYS_ARCH_PROTECT(lev);
+    if (CRYP_Busy)
+    {
+        SYS_ARCH_UNPROTECT(lev);
+        return ERR_INPROGRESS;
+    }
+    CRYP_Busy = 1;
+    SYS_ARCH_UNPROTECT(lev);
+
+    //AES-CTR,8位数据(按存储器中的字节顺序),CTR模式加解密相同,ALGODIR用加密
+    cr = CRYP_CR_ALGOMODE_AES_CTR | CRYP_CR_DATATYPE_1;
+    if (keylen == 24)
+    {
+        cr |= CRYP_CR_KEYSIZE_0;
+    }
+    else if (keylen == 32)
+    {
+        cr |= CRYP_CR_KEYSIZE_1;
+    }
+    CRYP_REG_WR(CR, cr);
+    //密钥靠右对齐放在K0LR..K3RR中,密钥和计数器都按大端字写入
+    nk = keylen / 4;
+    for (i = 0; i < nk; i++)
+    {
+        CRYP_KEY_WR(8 - nk + i, CRYP_GET32(key + 4 * i));
+    }
+    //CRYP只递增IV1RR,与GCM的inc32相同
+    for (i = 0; i < 4; i++)
+    {
+        CRYP_IV_WR(i, CRYP_GET32(ctr + 4 * i));
+    }
+    CRYP_REG_WR(CR, cr | CRYP_CR_FFLUSH);
+    CRYP_REG_WR(DMACR, CRYP_DMACR_DIEN | CRYP_DMACR_DOEN);
+    CRYP_DMA_START(in, out, len / 4);
+    CRYP_REG_WR(CR, cr | CRYP_CR_CRYPEN);
+    return ERR_OK;
+}
+
+//等待这一段的输出全部由DMA取回,然后释放CRYP
+//返回值:ERR_OK,完成;ERR_TIMEOUT,超时;ERR_IF,DMA出错
+static err_t CRYP_CTR_Wait(void)
+{
+    u32_t i;
+    int st = 0;
+
+    for (i = 0; (i < CRYP_CTR_TIMEOUT) && ((st = CRYP_DMA_POLL()) == 0); i++);
+    if (st == 0)
+    {
+        CRYP_DMA_STOP();
+    }
+    CRYP_REG_WR(DMACR, 0);
+    CRYP_REG_WR(CR, CRYP_REG_RD(CR) & ~CRYP_CR_CRYPEN);
+    CRYP_Busy = 0;
+    if (st == 1)
+    {
+        return ERR_OK;
+    }
+    return (st == 0) ? ERR_TIMEOUT : ERR_IF;
+}
+
+const struct aes_ctr_engine cryp_ctr_engine =
+{
+    "STM32 CRYP",
+    CRYP_CTR_Start,
+    CRYP_CTR_Wait
+};
+
+//打开CRYP和DMA2时钟,并把CRYP设为GCM的CTR引擎
+void CRYP_CTR_Init(void)
+{
+#ifndef CRYP_REG_MODEL
+    RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_CRYP, ENABLE);
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+#endif
+    CRYP_Busy = 0;
+    aes_gcm_set_engine(&cryp_ctr_engine);
+}
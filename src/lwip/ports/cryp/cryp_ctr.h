@@ -0,0 +1,15 @@
+#ifndef __CRYP_CTR_H
+#define __CRYP_CTR_H
+#include "aes_gcm.h"
+
+//用STM32F415/417/43x的CRYP外设做AES-CTR的GCM CTR引擎(见aes_gcm.h)
+//数据由DMA2数据流6(CRYP_IN)送入,数据流5(CRYP_OUT)取出,CPU同时计算GHASH.
+//没有使用CRYP的GCM模式:它只有F437/439才有,而且不能与GHASH并行,换密钥时还要重做H
+
+#define CRYP_CTR_TIMEOUT        0x10000 //等待DMA完成的最大轮询次数
+
+extern const struct aes_ctr_engine cryp_ctr_engine;
+
+void CRYP_CTR_Init(void);
+
+#endif
@@ -0,0 +1,194 @@
+#include "hash_digest.h"
+#include "lwip/sys.h"
+
+#if PPP_SUPPORT && (CHAP_SUPPORT || MD5_SUPPORT)
+
+#ifndef HASH_REG_MODEL
+#include "stm32f4xx.h"
+
+//HASH寄存器和DMA的访问,主机上的单元测试用寄存器模型替换这些宏
+#define HASH_REG_WR(reg, val)       (HASH->reg = (val))
+#define HASH_REG_RD(reg)            (HASH->reg)
+#define HASH_HR_RD(i)               (HASH->HR[i])
+#define HASH_DMA_START(src, words)  HASH_DMA_Start((src), (words))
+#define HASH_DMA_POLL()             HASH_DMA_Poll()
+#endif
+
+static struct digest_ctx *HASH_Owner;   //正在使用HASH外设的摘要上下文
+
+
+#if HASH_DIGEST_DMA && !defined(HASH_REG_MODEL)
+//用DMA2数据流7通道2(HASH_IN)把words个字写入HASH->DIN
+//src:字对齐的数据地址,不能在CCM RAM中
+static void HASH_DMA_Start(const u8_t *src, u32_t words)
+{
+    DMA2_Stream7->CR = 0;
+    while (DMA2_Stream7->CR & DMA_SxCR_EN);     //等待数据流关闭
+    DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+    DMA2_Stream7->PAR = (u32_t)&HASH->DIN;
+    DMA2_Stream7->M0AR = (u32_t)src;
+    DMA2_Stream7->NDTR = words;
+    DMA2_Stream7->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;    //使用FIFO,满阈值
+    //通道2,高优先级,存储器到外设,存储器地址递增,32位传输
+    DMA2_Stream7->CR = DMA_SxCR_CHSEL_1 | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+                       DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_EN;
+}
+
+//返回值:0,传输中;1,传输完成;-1,传输出错
+static int HASH_DMA_Poll(void)
+{
+    if (DMA2->HISR & DMA_HISR_TEIF7)
+    {
+        DMA2_Stream7->CR = 0;
+        return -1;
+    }
+    return (DMA2->HISR & DMA_HISR_TCIF7) ? 1 : 0;
+}
+#endif
+
+//开始一个摘要:占用HASH外设并初始化为MD5
+//返回值:ERR_OK,成功;ERR_VAL,不支持的算法;ERR_INPROGRESS,外设正被其他上下文使用
+static err_t HASH_Digest_Start(struct digest_ctx *ctx, u8_t alg)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (alg != DIGEST_MD5)
+    {
+        return ERR_VAL;
+    }
+    SYS_ARCH_PROTECT(lev);
+    if (HASH_Owner != NULL)
+    {
+        SYS_ARCH_UNPROTECT(lev);
+        return ERR_INPROGRESS;
+    }
+    HASH_Owner = ctx;
+    SYS_ARCH_UNPROTECT(lev);
+
+    ctx->u.fifo.word = 0;
+    ctx->u.fifo.nbytes = 0;
+    ctx->u.fifo.err = 0;
+    //MD5,HASH模式,8位数据(按存储器中的字节顺序计算),复位HASH内核
+    HASH_REG_WR(CR, HASH_CR_ALGO_0 | HASH_CR_DATATYPE_1 | HASH_CR_INIT);
+    return ERR_OK;
+}
+
+//送入数据,不足一个字的字节留在上下文中
+//Cortex-M4是小端模式,字的低字节就是数据中的第一个字节
+static void HASH_Digest_Update(struct digest_ctx *ctx, const u8_t *data, u32_t len)
+{
+    u32_t i;
+
+    //先凑满上次剩下的字
+    while ((ctx->u.fifo.nbytes != 0) && (len != 0))
+    {
+        ctx->u.fifo.word |= (u32_t)*data++ << (8 * ctx->u.fifo.nbytes);
+        len--;
+        if (++ctx->u.fifo.nbytes == 4)
+        {
+            HASH_REG_WR(DIN, ctx->u.fifo.word);
+            ctx->u.fifo.word = 0;
+            ctx->u.fifo.nbytes = 0;
+        }
+    }
+#if HASH_DIGEST_DMA
+    //字对齐的大块数据由DMA送入,MDMAT使DMA传输结束时不自动开始计算摘要
+    if ((len >= HASH_DIGEST_DMA_MIN) && (((mem_ptr_t)data & 3) == 0) && !ctx->u.fifo.err)
+    {
+        int st = 0;
+
+        HASH_REG_WR(CR, HASH_REG_RD(CR) | HASH_CR_DMAE | HASH_CR_MDMAT);
+        HASH_DMA_START(data, len >> 2);
+        for (i = 0; (i < HASH_DIGEST_TIMEOUT) && ((st = HASH_DMA_POLL()) == 0); i++);
+        HASH_REG_WR(CR, HASH_REG_RD(CR) & ~HASH_CR_DMAE);
+        if (st != 1)
+        {
+            ctx->u.fifo.err = 1;    //摘要已不可信,digest_final()返回错误
+        }
+        data += len & ~3UL;
+        len &= 3;
+    }
+#endif
+    //CPU逐字写入,输入FIFO满时由总线等待进行流控
+    if (((mem_ptr_t)data & 3) == 0)
+    {
+        for (; len >= 4; len -= 4, data += 4)
+        {
+            HASH_REG_WR(DIN, *(const u32_t *)data);
+        }
+    }
+    else
+    {
+        for (; len >= 4; len -= 4, data += 4)
+        {
+            HASH_REG_WR(DIN, (u32_t)data[0] | ((u32_t)data[1] << 8) | ((u32_t)data[2] << 16) | ((u32_t)data[3] << 24));
+        }
+    }
+    for (i = 0; i < len; i++)
+    {
+        ctx->u.fifo.word |= (u32_t)data[i] << (8 * ctx->u.fifo.nbytes++);
+    }
+}
+
+//结束摘要,读出16字节MD5并释放HASH外设
+//返回值:ERR_OK,成功;ERR_TIMEOUT,计算超时;ERR_IF,DMA出错
+static err_t HASH_Digest_Finish(struct digest_ctx *ctx, u8_t *out)
+{
+    u32_t i, hr, nblw;
+    err_t err = ERR_OK;
+
+    //最后一个字中的有效位数,0表示32位都有效
+    nblw = 8 * ctx->u.fifo.nbytes;
+    HASH_REG_WR(STR, nblw);
+    if (ctx->u.fifo.nbytes != 0)
+    {
+        HASH_REG_WR(DIN, ctx->u.fifo.word);
+    }
+    HASH_REG_WR(STR, nblw | HASH_STR_DCAL);     //开始计算摘要
+    for (i = 0; (i < HASH_DIGEST_TIMEOUT) && !(HASH_REG_RD(SR) & HASH_SR_DCIS); i++);
+
+    if (ctx->u.fifo.err)
+    {
+        err = ERR_IF;
+    }
+    else if (!(HASH_REG_RD(SR) & HASH_SR_DCIS))
+    {
+        err = ERR_TIMEOUT;
+    }
+    else
+    {
+        for (i = 0; i < DIGEST_MD5_SIZE / 4; i++)   //HR寄存器按大端顺序保存摘要
+        {
+            hr = HASH_HR_RD(i);
+            out[4 * i] = (u8_t)(hr >> 24);
+            out[4 * i + 1] = (u8_t)(hr >> 16);
+            out[4 * i + 2] = (u8_t)(hr >> 8);
+            out[4 * i + 3] = (u8_t)hr;
+        }
+    }
+    HASH_Owner = NULL;
+    return err;
+}
+
+const struct digest_provider hash_digest_provider =
+{
+    "STM32 HASH",
+    HASH_Digest_Start,
+    HASH_Digest_Update,
+    HASH_Digest_Finish
+};
+
+//打开HASH(和DMA2)时钟,并把HASH外设设为lwIP的摘要提供者
+void HASH_Digest_Init(void)
+{
+#ifndef HASH_REG_MODEL
+    RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_HASH, ENABLE);
+#if HASH_DIGEST_DMA
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+#endif
+#endif
+    HASH_Owner = NULL;
+    digest_set_provider(&hash_digest_provider);
+}
+
+#endif
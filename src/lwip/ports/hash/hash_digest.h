@@ -0,0 +1,24 @@
+#ifndef __HASH_DIGEST_H
+#define __HASH_DIGEST_H
+#include "lwip/opt.h"
+#include "digest.h"
+
+//用STM32F415/417/43x的HASH外设计算MD5的lwIP摘要提供者(见netif/ppp/digest.h)
+//HASH外设同一时间只服务一个摘要上下文,外设忙时digest_init()自动改用软件MD5
+
+#ifndef HASH_DIGEST_DMA
+#if defined(STM32F427_437xx) || defined(STM32F429_439xx)
+#define HASH_DIGEST_DMA         1       //大块数据用DMA2数据流7送入HASH
+#else
+#define HASH_DIGEST_DMA         0       //F415/417没有MDMAT位,DMA传输结束会自动开始计算,只能由CPU送数据
+#endif
+#endif
+
+#define HASH_DIGEST_DMA_MIN     256     //一次送入不少于这么多字节才用DMA
+#define HASH_DIGEST_TIMEOUT     0x10000 //等待HASH/DMA完成的最大轮询次数
+
+extern const struct digest_provider hash_digest_provider;
+
+void HASH_Digest_Init(void);
+
+#endif
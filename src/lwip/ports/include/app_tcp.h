@@ -1,15 +1,43 @@
 #ifndef _APP_TCP_H_
 #define _APP_TCP_H_
+#include "lwip/tcp.h"
+#include "lwip/mem.h"
 
 
 #define MAX_STRING      256
 
+#ifndef APP_TCP_CRYPT
+#define APP_TCP_CRYPT           0   //1,端口4090上的数据用AES-GCM记录加密(见cryp/aes_rec.h)
+#endif
+
+#ifndef APP_TCP_CRYP_ENGINE
+#define APP_TCP_CRYP_ENGINE     0   //1,用CRYP外设做AES-CTR(只有STM32F415/417/43x有CRYP)
+#endif
+
+//APP_TCP_CRYPT为1时还必须定义两个方向的AES密钥(16,24或32字节),例如
+//#define APP_TCP_RX_KEY  {0x00, 0x01, ... 0x0f}   //客户端到本机
+//#define APP_TCP_TX_KEY  {0x10, 0x11, ... 0x1f}   //本机到客户端
+
 struct rcev_buf
 {
     u16_t   length;
     u8_t    bytes[MAX_STRING];
 };
 
+#if APP_TCP_CRYPT
+#include "aes_rec.h"
+
+struct app_tcp_conn
+{
+    struct rcev_buf buf;            //解密后的数据,必须是第一个成员
+    struct aes_rec  rx;
+    struct aes_rec  tx;
+    u8_t            stage[MAX_STRING];  //标签检查通过前的明文
+};
+#endif
+
+err_t app_tcp_send(struct tcp_pcb *pcb, const u8_t *data, u16_t len);
+
 
 #endif /* _APP_TCP_H_ */
 
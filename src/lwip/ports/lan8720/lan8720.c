@@ -3,17 +3,20 @@
 #include "usart.h" 
 #include "delay.h"
 #include "malloc.h"
+#include "lwip/crc32.h"
 
 ETH_DMADESCTypeDef *DMARxDscrTab;   //以太网DMA接收描述符数据结构体指针
 ETH_DMADESCTypeDef *DMATxDscrTab;   //以太网DMA发送描述符数据结构体指针
 uint8_t *Rx_Buff;                   //以太网底层驱动接收buffers指针
 uint8_t *Tx_Buff;                   //以太网底层驱动发送buffers指针
 
+static u8 ETH_HashRefCnt[64];       //组播哈希表每一位被多少个组地址引用
+
 
 //初始化ETH MAC层及DMA配置
 u8 ETH_MACDMA_Config(void)
 {
-    u8 rval;
+    u8 rval, i;
     ETH_InitTypeDef ETH_InitStructure;
 
     //使能以太网MAC以及MAC接收和发送时钟
@@ -32,8 +35,8 @@ u8 ETH_MACDMA_Config(void)
     ETH_InitStructure.ETH_ReceiveAll = ETH_ReceiveAll_Disable;                          //关闭接收所有的帧
     ETH_InitStructure.ETH_BroadcastFramesReception = ETH_BroadcastFramesReception_Enable;   //允许接收所有广播帧
     ETH_InitStructure.ETH_PromiscuousMode = ETH_PromiscuousMode_Disable;                //关闭混合模式的地址过滤
-    ETH_InitStructure.ETH_MulticastFramesFilter = ETH_MulticastFramesFilter_Perfect;    //对于组播地址使用完美地址过滤
-    ETH_InitStructure.ETH_UnicastFramesFilter = ETH_UnicastFramesFilter_Perfect         //对单播地址使用完美地址过滤
+    ETH_InitStructure.ETH_MulticastFramesFilter = ETH_MulticastFramesFilter_HashTable;  //组播地址使用64位哈希表过滤,见ETH_MulticastHashAdd()
+    ETH_InitStructure.ETH_UnicastFramesFilter = ETH_UnicastFramesFilter_Perfect;        //对单播地址使用完美地址过滤
 #ifdef CHECKSUM_BY_HARDWARE
     ETH_InitStructure.ETH_ChecksumOffload = ETH_ChecksumOffload_Enable; //开启ipv4和TCP/UDP/ICMP的帧校验和卸载
 #endif
@@ -51,6 +54,12 @@ u8 ETH_MACDMA_Config(void)
     ETH_InitStructure.ETH_RxDMABurstLength = ETH_RxDMABurstLength_32Beat;           //DMA发送的最大突发长度为32个节拍
     ETH_InitStructure.ETH_TxDMABurstLength = ETH_TxDMABurstLength_32Beat;           //DMA接收的最大突发长度为32个节拍
     ETH_InitStructure.ETH_DMAArbitration = ETH_DMAArbitration_RoundRobin_RxTx_2_1;
+    ETH_InitStructure.ETH_HashTableHigh = 0;                    //哈希表清空,不接收任何组播
+    ETH_InitStructure.ETH_HashTableLow = 0;
+    for (i = 0; i < 64; i++)
+    {
+        ETH_HashRefCnt[i] = 0;
+    }
     rval = ETH_Init(&ETH_InitStructure, LAN8720_PHY_ADDRESS);    //配置ETH
     if (rval == ETH_SUCCESS) //配置成功
     {
@@ -240,6 +249,80 @@ u32 ETH_GetCurrentTxBuffer(void)
     return DMATxDescToSet->Buffer1Addr;//返回Tx buffer地址
 }
 
+//计算组播MAC地址在哈希表中的位置
+//MAC对目的地址计算以太网CRC32,位反转后取高6位:
+//最高位选择MACHTHR/MACHTLR,其余5位选择寄存器中的位
+//mac:6字节目的MAC地址
+//返回值:0~63
+static u8 ETH_MulticastHashIndex(const u8 *mac)
+{
+    u32 crc;
+    u8 i, index = 0;
+#if LWIP_CRC32
+    crc = crc32(0, mac, 6);
+#else
+    u8 j;
+
+    crc = 0xFFFFFFFF;
+    for (i = 0; i < 6; i++)
+    {
+        crc ^= mac[i];
+        for (j = 0; j < 8; j++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+    crc = ~crc;
+#endif
+    //位反转后的高6位就是低6位倒序
+    for (i = 0; i < 6; i++)
+    {
+        index = (index << 1) | (crc & 1);
+        crc >>= 1;
+    }
+    return index;
+}
+
+//允许接收一个组播MAC地址
+//多个地址可能落在哈希表同一位,按引用计数置位
+//mac:6字节组播MAC地址
+void ETH_MulticastHashAdd(const u8 *mac)
+{
+    u8 index = ETH_MulticastHashIndex(mac);
+
+    if (ETH_HashRefCnt[index]++ == 0)
+    {
+        if (index & 0x20)
+        {
+            ETH->MACHTHR |= (u32)1 << (index & 0x1F);
+        }
+        else
+        {
+            ETH->MACHTLR |= (u32)1 << (index & 0x1F);
+        }
+    }
+}
+
+//不再接收一个组播MAC地址
+//最后一个使用该位的地址删除后才清除哈希表中的位
+//mac:6字节组播MAC地址
+void ETH_MulticastHashDel(const u8 *mac)
+{
+    u8 index = ETH_MulticastHashIndex(mac);
+
+    if ((ETH_HashRefCnt[index] != 0) && (--ETH_HashRefCnt[index] == 0))
+    {
+        if (index & 0x20)
+        {
+            ETH->MACHTHR &= ~((u32)1 << (index & 0x1F));
+        }
+        else
+        {
+            ETH->MACHTLR &= ~((u32)1 << (index & 0x1F));
+        }
+    }
+}
+
 //为ETH底层驱动申请内存
 //返回值:0,正常
 //    其他,失败
@@ -21,6 +21,8 @@ u8 ETH_MACDMA_Config(void);
 FrameTypeDef ETH_Rx_Packet(void);
 u8 ETH_Tx_Packet(u16 FrameLength);
 u32 ETH_GetCurrentTxBuffer(void);
+void ETH_MulticastHashAdd(const u8 *mac);
+void ETH_MulticastHashDel(const u8 *mac);
 u8 ETH_Mem_Malloc(void);
 void ETH_Mem_Free(void);
 
@@ -1,6 +1,12 @@
 
 #include "lwip_init.h"
 #include "lwip/init.h"
+#if LWIP_RNG
+#include "rng_hw.h"
+#endif
+#if LWIP_BPF
+#include "pcapng.h"
+#endif
 
 struct netif lwip_netif;    //定义一个全局的网络接口
 
@@ -41,12 +47,18 @@ s32_t my_lwip_init(void)
     IP4_ADDR(&gw_addr, buff[0], buff[1], buff[2], buff[3]);     //设置默认网关格式
 
     lwip_init();    //lwip内核初始化
+#if LWIP_RNG
+    RNG_HW_Init();  //TCP的ISN密钥和随机端口取自熵池,要在创建第一个PCB之前
+#endif
     if (NULL == netif_add(&lwip_netif, &ip_addr, &net_mask, &gw_addr, NULL, &ethernetif_init, &ethernet_input))
     {
         return -2;
     }
     netif_set_default(&lwip_netif); //设置默认网口
     netif_set_up(&lwip_netif);      //开启网口
+#if LWIP_BPF && PCAPNG_CAPTURE
+    pcapng_init(&lwip_netif);       //现场抓包,见pcapng.h
+#endif
 
     app_tcp_init();
 
@@ -0,0 +1,309 @@
+#include "pcapng.h"
+#include "lwip/tcp.h"
+#include "lwip/ip.h"
+#include "lwip/def.h"
+#include "netif/etharp.h"
+
+#include <string.h>
+
+#if PCAPNG_CAPTURE && !LWIP_BPF
+#error "PCAPNG_CAPTURE needs LWIP_BPF"
+#endif
+
+#if LWIP_BPF && LWIP_TCP
+
+#if !PCAPNG_SNAPLEN && (PCAPNG_REFS >= PBUF_POOL_SIZE)
+#error "PCAPNG_REFS must be well below PBUF_POOL_SIZE, referenced pbufs are not available for reception"
+#endif
+
+#if PCAPNG_BLOCK_SIZE < PCAPNG_SHB_SIZE + PCAPNG_IDB_SIZE
+#error "PCAPNG_BLOCK_SIZE too small"
+#endif
+
+#define PCAPNG_BT_SHB           0x0A0D0D0A
+#define PCAPNG_BT_IDB           0x00000001
+#define PCAPNG_BT_EPB           0x00000006
+#define PCAPNG_MAGIC            0x1A2B3C4D
+
+#define PCAPNG_OPT_END          0
+#define PCAPNG_OPT_TSRESOL      9       //IDB,时间戳单位10^-n秒
+#define PCAPNG_OPT_EPB_FLAGS    2       //EPB,低2位是方向
+#define PCAPNG_FLAGS_INBOUND    1
+#define PCAPNG_FLAGS_OUTBOUND   2
+
+//"not (ip and tcp port PCAPNG_PORT)",非首个分片没有端口,保留
+static const struct bpf_insn pcapng_filter_insns[] =
+{
+    BPF_STMT(BPF_LD|BPF_H|BPF_ABS, 12),
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, ETHTYPE_IP, 0, 9),
+    BPF_STMT(BPF_LD|BPF_B|BPF_ABS, 23),
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, IP_PROTO_TCP, 0, 7),
+    BPF_STMT(BPF_LD|BPF_H|BPF_ABS, 20),
+    BPF_JUMP(BPF_JMP|BPF_JSET|BPF_K, 0x1fff, 5, 0),
+    BPF_STMT(BPF_LDX|BPF_MSH|BPF_B, 14),
+    BPF_STMT(BPF_LD|BPF_H|BPF_IND, 14),
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, PCAPNG_PORT, 3, 0),
+    BPF_STMT(BPF_LD|BPF_H|BPF_IND, 16),
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, PCAPNG_PORT, 1, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0xffff),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+};
+
+const struct bpf_program pcapng_filter = BPF_PROGRAM(pcapng_filter_insns);
+
+static struct bpf_ring *pcapng_ring;        //正在送出的环形缓冲区
+static struct tcp_pcb *pcapng_client;       //当前客户端,NULL表示没有
+static u8_t  pcapng_blk[PCAPNG_BLOCK_SIZE]; //正在发送的块
+static u16_t pcapng_len;                    //pcapng_blk中块的字节数
+static u16_t pcapng_off;                    //已交给TCP的字节数
+
+//pcap-ng按写入方的字节序,这里固定用小端
+static u8_t *pcapng_put16(u8_t *b, u16_t v)
+{
+    b[0] = (u8_t)v;
+    b[1] = (u8_t)(v >> 8);
+    return b + 2;
+}
+
+static u8_t *pcapng_put32(u8_t *b, u32_t v)
+{
+    b[0] = (u8_t)v;
+    b[1] = (u8_t)(v >> 8);
+    b[2] = (u8_t)(v >> 16);
+    b[3] = (u8_t)(v >> 24);
+    return b + 4;
+}
+
+//节头块,返回值:写入的字节数(PCAPNG_SHB_SIZE)
+u16_t pcapng_shb(u8_t *buf)
+{
+    u8_t *b = buf;
+
+    b = pcapng_put32(b, PCAPNG_BT_SHB);
+    b = pcapng_put32(b, PCAPNG_SHB_SIZE);
+    b = pcapng_put32(b, PCAPNG_MAGIC);
+    b = pcapng_put16(b, 1);                 //版本1.0
+    b = pcapng_put16(b, 0);
+    b = pcapng_put32(b, 0xffffffffUL);      //节长度未知
+    b = pcapng_put32(b, 0xffffffffUL);
+    pcapng_put32(b, PCAPNG_SHB_SIZE);
+    return PCAPNG_SHB_SIZE;
+}
+
+//接口描述块,时间戳单位为毫秒,snaplen为0表示不截短
+//返回值:写入的字节数(PCAPNG_IDB_SIZE)
+u16_t pcapng_idb(u8_t *buf, u16_t linktype, u32_t snaplen)
+{
+    u8_t *b = buf;
+
+    b = pcapng_put32(b, PCAPNG_BT_IDB);
+    b = pcapng_put32(b, PCAPNG_IDB_SIZE);
+    b = pcapng_put16(b, linktype);
+    b = pcapng_put16(b, 0);
+    b = pcapng_put32(b, snaplen);
+    b = pcapng_put16(b, PCAPNG_OPT_TSRESOL);
+    b = pcapng_put16(b, 1);
+    b = pcapng_put32(b, 3);                 //10^-3秒,后3字节是补齐
+    b = pcapng_put32(b, PCAPNG_OPT_END);
+    pcapng_put32(b, PCAPNG_IDB_SIZE);
+    return PCAPNG_IDB_SIZE;
+}
+
+//从环形缓冲区取出最早的一帧,生成增强分组块(EPB)放到buf中,帧数据直接读到块中的位置
+//超过size能放下的部分被截短,块长度不超过0xffff字节
+//返回值:块的字节数,0表示缓冲区为空
+u16_t pcapng_next(struct bpf_ring *ring, u8_t *buf, u32_t size)
+{
+    struct bpf_ring_hdr hdr;
+    u16_t room, caplen, total;
+    u8_t *b;
+
+    if (size < PCAPNG_EPB_OVERHEAD + 4)
+    {
+        return 0;
+    }
+    room = (u16_t)(LWIP_MIN(size, 0xffff) - PCAPNG_EPB_OVERHEAD) & ~3;
+    if (bpf_ring_read(ring, &hdr, buf + 28, room) != ERR_OK)
+    {
+        return 0;
+    }
+    caplen = LWIP_MIN(hdr.caplen, room);
+    total = PCAPNG_EPB_OVERHEAD + ((caplen + 3) & ~3);
+
+    b = pcapng_put32(buf, PCAPNG_BT_EPB);
+    b = pcapng_put32(b, total);
+    b = pcapng_put32(b, 0);                 //接口0
+    b = pcapng_put32(b, 0);                 //时间戳高32位
+    b = pcapng_put32(b, hdr.time);
+    b = pcapng_put32(b, caplen);
+    b = pcapng_put32(b, hdr.len);
+    b += caplen;
+    while (caplen & 3)
+    {
+        *b++ = 0;
+        caplen++;
+    }
+    b = pcapng_put16(b, PCAPNG_OPT_EPB_FLAGS);
+    b = pcapng_put16(b, 4);
+    b = pcapng_put32(b, (hdr.flags & BPF_RING_IN) ? PCAPNG_FLAGS_INBOUND : PCAPNG_FLAGS_OUTBOUND);
+    b = pcapng_put32(b, PCAPNG_OPT_END);
+    pcapng_put32(b, total);
+    return total;
+}
+
+//在发送缓冲区允许的范围内送出块,当前块送完后从环形缓冲区取下一帧
+static void pcapng_pump(struct tcp_pcb *pcb)
+{
+    u16_t n;
+
+    for (;;)
+    {
+        if (pcapng_off == pcapng_len)
+        {
+            pcapng_off = 0;
+            pcapng_len = pcapng_next(pcapng_ring, pcapng_blk, sizeof(pcapng_blk));
+            if (pcapng_len == 0)
+            {
+                break;
+            }
+        }
+        n = LWIP_MIN(tcp_sndbuf(pcb), pcapng_len - pcapng_off);
+        if ((n == 0) || (tcp_write(pcb, pcapng_blk + pcapng_off, n, TCP_WRITE_FLAG_COPY) != ERR_OK))
+        {
+            break;      //发送队列已满,等pcapng_sent()
+        }
+        pcapng_off += n;
+    }
+    tcp_output(pcb);
+}
+
+static err_t pcapng_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(len);
+    pcapng_pump(pcb);
+    return ERR_OK;
+}
+
+//发送队列空闲时靠它送出新抓到的帧
+static err_t pcapng_poll(void *arg, struct tcp_pcb *pcb)
+{
+    LWIP_UNUSED_ARG(arg);
+    pcapng_pump(pcb);
+    return ERR_OK;
+}
+
+static err_t pcapng_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+    if (p != NULL)
+    {
+        tcp_recved(pcb, p->tot_len);    //客户端发来的数据丢弃
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    pcapng_client = NULL;
+    tcp_arg(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    tcp_err(pcb, NULL);
+    if (tcp_close(pcb) != ERR_OK)
+    {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+static void pcapng_err(void *arg, err_t err)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+    pcapng_client = NULL;
+}
+
+static err_t pcapng_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    u32_t snaplen;
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+    if (pcapng_client != NULL)
+    {
+        tcp_abort(pcb);         //已经有客户端了
+        return ERR_ABRT;
+    }
+    pcapng_client = pcb;
+
+    //更长的帧在pcapng_next()中被截短
+    snaplen = (PCAPNG_BLOCK_SIZE - PCAPNG_EPB_OVERHEAD) & ~3;
+    if ((pcapng_ring->snaplen != 0) && (pcapng_ring->snaplen < snaplen))
+    {
+        snaplen = pcapng_ring->snaplen;
+    }
+    pcapng_off = 0;
+    pcapng_len = pcapng_shb(pcapng_blk);
+    pcapng_len += pcapng_idb(pcapng_blk + pcapng_len, PCAPNG_LINKTYPE_ETHERNET, snaplen);
+
+    tcp_err(pcb, pcapng_err);
+    tcp_recv(pcb, pcapng_recv);
+    tcp_sent(pcb, pcapng_sent);
+    tcp_poll(pcb, pcapng_poll, 1);
+    pcapng_pump(pcb);
+    return ERR_OK;
+}
+
+//开始把netif收发的帧记录到ring中,并在port上等待客户端
+//ring由调用者用bpf_ring_init()初始化,过滤程序中应排除port上的连接(见pcapng_filter)
+//返回值:ERR_OK,成功;ERR_MEM,内存不足;其他,tcp_bind()的错误
+err_t pcapng_start(struct netif *netif, struct bpf_ring *ring, u16_t port)
+{
+    struct tcp_pcb *pcb, *lpcb;
+    err_t err;
+
+    pcb = tcp_new();
+    if (pcb == NULL)
+    {
+        return ERR_MEM;
+    }
+    err = tcp_bind(pcb, IP_ADDR_ANY, port);
+    if (err != ERR_OK)
+    {
+        tcp_close(pcb);
+        return err;
+    }
+    lpcb = tcp_listen(pcb);
+    if (lpcb == NULL)
+    {
+        tcp_close(pcb);
+        return ERR_MEM;
+    }
+    tcp_accept(lpcb, pcapng_accept);
+
+    pcapng_ring = ring;
+    netif_set_capture(netif, ring);
+    return ERR_OK;
+}
+
+//用静态的环形缓冲区和pcapng_filter抓取netif的帧,在PCAPNG_PORT上送出
+err_t pcapng_init(struct netif *netif)
+{
+#if PCAPNG_SNAPLEN
+    static u32_t buf[PCAPNG_RING_SIZE / 4];
+#else
+    static u32_t buf[(PCAPNG_REFS * BPF_RING_REF_SIZE + 3) / 4];
+#endif
+    static struct bpf_ring ring;
+    err_t err;
+
+    err = bpf_ring_init(&ring, buf, sizeof(buf), &pcapng_filter, PCAPNG_SNAPLEN);
+    if (err == ERR_OK)
+    {
+        err = pcapng_start(netif, &ring, PCAPNG_PORT);
+    }
+    return err;
+}
+
+#endif /* LWIP_BPF && LWIP_TCP */
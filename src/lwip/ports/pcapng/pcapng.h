@@ -0,0 +1,52 @@
+#ifndef __PCAPNG_H
+#define __PCAPNG_H
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/netif.h"
+#include "lwip/bpf.h"
+
+//现场抓包:网卡收发的帧记录在环形缓冲区中(见netif_set_capture()),以pcap-ng格式从TCP端口送出
+//客户端连接后先收到节头块(SHB)和接口描述块(IDB),然后是缓冲区中已有的帧和之后抓到的帧(EPB),例如
+//  nc 192.168.1.18 2002 | wireshark -k -i -
+//时间戳是sys_now()的毫秒数(上电后的时间),同一时间只服务一个客户端
+
+#ifndef PCAPNG_CAPTURE
+#define PCAPNG_CAPTURE          0       //1,my_lwip_init()中调用pcapng_init()抓取lwip_netif的帧
+#endif
+
+#ifndef PCAPNG_PORT
+#define PCAPNG_PORT             2002
+#endif
+
+#ifndef PCAPNG_SNAPLEN
+#define PCAPNG_SNAPLEN          128     //每帧保存的字节数;0,保存完整的帧(引用pbuf而不复制)
+#endif
+
+#ifndef PCAPNG_RING_SIZE
+#define PCAPNG_RING_SIZE        8192    //PCAPNG_SNAPLEN不为0时环形缓冲区的字节数
+#endif
+
+#ifndef PCAPNG_REFS
+#define PCAPNG_REFS             8       //PCAPNG_SNAPLEN为0时最多引用的帧数,被引用的pbuf不能再用于接收
+#endif
+
+#ifndef PCAPNG_BLOCK_SIZE
+#define PCAPNG_BLOCK_SIZE       1600    //一个EPB的最大字节数,更长的帧被截短
+#endif
+
+#define PCAPNG_LINKTYPE_ETHERNET    1
+#define PCAPNG_SHB_SIZE             28
+#define PCAPNG_IDB_SIZE             32
+#define PCAPNG_EPB_OVERHEAD         44  //EPB中除帧数据(补齐到4字节)以外的字节数
+
+//不抓取本服务自己的TCP连接(端口PCAPNG_PORT),否则发出的每一段都会再被抓到
+extern const struct bpf_program pcapng_filter;
+
+u16_t pcapng_shb(u8_t *buf);
+u16_t pcapng_idb(u8_t *buf, u16_t linktype, u32_t snaplen);
+u16_t pcapng_next(struct bpf_ring *ring, u8_t *buf, u32_t size);
+
+err_t pcapng_start(struct netif *netif, struct bpf_ring *ring, u16_t port);
+err_t pcapng_init(struct netif *netif);
+
+#endif
@@ -0,0 +1,92 @@
+#include "rng_hw.h"
+
+#if LWIP_RNG
+
+#ifndef RNG_REG_MODEL
+#include "stm32f4xx.h"
+
+//RNG寄存器的访问,主机上的单元测试用寄存器模型替换这些宏
+#define RNG_REG_WR(reg, val)    (RNG->reg = (val))
+#define RNG_REG_RD(reg)         (RNG->reg)
+#endif
+
+static u32_t RNG_Last;      //上一个随机数,用于连续性测试
+
+//等待一个随机数就绪
+//返回值:ERR_OK,DR可读;ERR_IF,时钟或种子错误;ERR_TIMEOUT,超时
+static err_t RNG_HW_Wait(void)
+{
+    u32_t sr, n;
+
+    for (n = 0; n < RNG_HW_TIMEOUT; n++)
+    {
+        sr = RNG_REG_RD(SR);
+        if (sr & (RNG_SR_SECS | RNG_SR_CECS))
+        {
+            return ERR_IF;
+        }
+        if (sr & RNG_SR_DRDY)
+        {
+            return ERR_OK;
+        }
+    }
+    return ERR_TIMEOUT;
+}
+
+//清除错误标志并重新启动RNG,启动后的第一个随机数只用于比较,不输出
+static err_t RNG_HW_Restart(void)
+{
+    err_t err;
+
+    RNG_REG_WR(SR, 0);              //SEIS,CEIS写0清除
+    RNG_REG_WR(CR, 0);
+    RNG_REG_WR(CR, RNG_CR_RNGEN);
+    err = RNG_HW_Wait();
+    if (err == ERR_OK)
+    {
+        RNG_Last = RNG_REG_RD(DR);
+    }
+    return err;
+}
+
+//熵源:读一个随机数到*word
+//返回值:ERR_OK,成功;ERR_IF,外设出错;ERR_TIMEOUT,超时;ERR_VAL,与上一个随机数相同
+static err_t RNG_HW_Read(u32_t *word)
+{
+    err_t err;
+    u32_t r;
+
+    err = RNG_HW_Wait();
+    if (err != ERR_OK)
+    {
+        //种子错误需要重新启动;时钟错误在PLL48CLK恢复后自行消失
+        if ((err == ERR_IF) && (RNG_REG_RD(SR) & RNG_SR_SECS))
+        {
+            RNG_HW_Restart();
+        }
+        return err;
+    }
+    r = RNG_REG_RD(DR);
+    if (r == RNG_Last)
+    {
+        return ERR_VAL;
+    }
+    RNG_Last = r;
+    *word = r;
+    return ERR_OK;
+}
+
+//打开RNG时钟并启动RNG,成功后把它设为熵池的熵源并填满熵池
+//要在第一个TCP连接之前调用,TCP的ISN密钥在第一次使用时从熵池取得
+void RNG_HW_Init(void)
+{
+#ifndef RNG_REG_MODEL
+    RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_RNG, ENABLE);
+#endif
+    if (RNG_HW_Restart() == ERR_OK)
+    {
+        rng_set_source(RNG_HW_Read);
+    }
+}
+
+#endif
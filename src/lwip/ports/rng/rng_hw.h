@@ -0,0 +1,14 @@
+#ifndef __RNG_HW_H
+#define __RNG_HW_H
+#include "lwip/opt.h"
+#include "lwip/rng.h"
+
+//用STM32F4的RNG外设(时钟为PLL48CLK)作为lwIP熵池的熵源(见lwip/rng.h)
+//每个随机数都与上一个比较(FIPS 140-2连续性测试),相同则丢弃;
+//种子错误时按参考手册重新启动RNG,出错期间熵池改用确定性的后备生成器
+
+#define RNG_HW_TIMEOUT          1000    //等待DRDY的最大查询次数,正常约40个RNG时钟就绪
+
+void RNG_HW_Init(void);
+
+#endif
@@ -95,6 +95,8 @@ netconn_new_with_proto_and_callback(enum netconn_type t, u8_t proto, netconn_cal
  * Close a netconn 'connection' and free its resources.
  * UDP and RAW connection are completely closed, TCP pcbs might still be in a waitstate
  * after this returns.
+ * netconn_*_async() operations still pending on the netconn complete with
+ * ERR_ABRT (their callbacks are called from tcpip_thread) before this returns.
  *
  * @param conn the netconn to delete
  * @return ERR_OK if the connection was deleted
@@ -652,6 +654,347 @@ netconn_write_partly(struct netconn *conn, const void *dataptr, size_t size,
   return err;
 }
 
+#if LWIP_NETCONN_BATCH
+/**
+ * Prepare an empty batch of netconn operations.
+ *
+ * @param b the batch to initialize
+ */
+void
+netconn_batch_init(struct netconn_batch *b)
+{
+  b->num = 0;
+}
+
+/**
+ * Get the next free operation of a batch, making sure the netconn is not
+ * used by an operation queued earlier (every operation signals the
+ * op_completed semaphore of its netconn).
+ *
+ * @param b the batch
+ * @param conn the netconn the operation is for
+ * @return the api_msg to fill in or NULL if conn can't be added
+ */
+static struct api_msg *
+netconn_batch_next(struct netconn_batch *b, struct netconn *conn)
+{
+  u8_t i;
+
+  if (b->num >= NETCONN_BATCH_MAX) {
+    return NULL;
+  }
+  for (i = 0; i < b->num; i++) {
+    if (b->msgs[i].msg.conn == conn) {
+      return NULL;
+    }
+  }
+  return &b->msgs[b->num];
+}
+
+/**
+ * Queue a netconn_send() into a batch. Nothing is sent until the batch is
+ * committed; buf must stay valid until then.
+ *
+ * @param b the batch
+ * @param conn the UDP or RAW netconn over which to send data
+ * @param buf the netbuf containing the data to send
+ * @return ERR_OK if the operation was queued,
+ *         ERR_ARG if the batch is full or already contains conn
+ */
+err_t
+netconn_batch_send(struct netconn_batch *b, struct netconn *conn, struct netbuf *buf)
+{
+  struct api_msg *msg;
+
+  LWIP_ERROR("netconn_batch_send: invalid conn",  (conn != NULL), return ERR_ARG;);
+  msg = netconn_batch_next(b, conn);
+  if (msg == NULL) {
+    return ERR_ARG;
+  }
+  msg->function = do_send;
+  msg->msg.conn = conn;
+  msg->msg.msg.b = buf;
+  b->num++;
+  return ERR_OK;
+}
+
+/**
+ * Queue a blocking netconn_write() into a batch. Nothing is sent until the
+ * batch is committed; dataptr must stay valid until then.
+ *
+ * @param b the batch
+ * @param conn the TCP netconn over which to send data
+ * @param dataptr pointer to the application buffer that contains the data to send
+ * @param size size of the application data to send
+ * @param apiflags NETCONN_COPY and/or NETCONN_MORE (see netconn_write_partly)
+ * @return ERR_OK if the operation was queued,
+ *         ERR_ARG if the batch is full or already contains conn,
+ *         ERR_VAL if conn is not a blocking TCP netconn
+ */
+err_t
+netconn_batch_write(struct netconn_batch *b, struct netconn *conn,
+                    const void *dataptr, size_t size, u8_t apiflags)
+{
+  struct api_msg *msg;
+
+  LWIP_ERROR("netconn_batch_write: invalid conn",  (conn != NULL), return ERR_ARG;);
+  LWIP_ERROR("netconn_batch_write: invalid conn->type",  (conn->type == NETCONN_TCP), return ERR_VAL;);
+  if (netconn_is_nonblocking(conn) || (apiflags & NETCONN_DONTBLOCK)) {
+    /* like netconn_write(), there is no way to return the bytes written */
+    return ERR_VAL;
+  }
+  msg = netconn_batch_next(b, conn);
+  if (msg == NULL) {
+    return ERR_ARG;
+  }
+  msg->function = do_write;
+  msg->msg.conn = conn;
+  msg->msg.msg.w.dataptr = dataptr;
+  msg->msg.msg.w.apiflags = apiflags;
+  msg->msg.msg.w.len = size;
+#if LWIP_SO_SNDTIMEO
+  if (conn->send_timeout != 0) {
+    msg->msg.msg.w.time_started = sys_now();
+  } else {
+    msg->msg.msg.w.time_started = 0;
+  }
+#endif /* LWIP_SO_SNDTIMEO */
+  b->num++;
+  return ERR_OK;
+}
+
+/**
+ * Execute all operations of a batch in tcpip_thread, using one message
+ * instead of one per operation, and wait for all of them to complete.
+ * The batch is empty afterwards; the result of each operation can still
+ * be read with netconn_batch_err().
+ *
+ * @param b the batch to commit
+ * @return ERR_OK if all operations succeeded, else the error of the first
+ *         operation that failed
+ */
+err_t
+netconn_batch_commit(struct netconn_batch *b)
+{
+  err_t err = ERR_OK;
+  u8_t num = b->num;
+  u8_t i;
+
+  if (num == 0) {
+    return ERR_OK;
+  }
+  b->num = 0;
+#if LWIP_TCPIP_CORE_LOCKING
+  /* with the core locked there is no message to save */
+  for (i = 0; i < num; i++) {
+    TCPIP_APIMSG(&b->msgs[i]);
+  }
+#else /* LWIP_TCPIP_CORE_LOCKING */
+  err = tcpip_apimsg_batch(b->msgs, num);
+  if (err != ERR_OK) {
+    for (i = 0; i < num; i++) {
+      b->msgs[i].msg.err = err;
+    }
+  }
+#endif /* LWIP_TCPIP_CORE_LOCKING */
+  for (i = 0; i < num; i++) {
+    NETCONN_SET_SAFE_ERR(b->msgs[i].msg.conn, b->msgs[i].msg.err);
+    if ((err == ERR_OK) && (b->msgs[i].msg.err != ERR_OK)) {
+      err = b->msgs[i].msg.err;
+    }
+  }
+  return err;
+}
+#endif /* LWIP_NETCONN_BATCH */
+
+#if LWIP_NETCONN_ASYNC
+/**
+ * Prepare a struct netconn_async for use with one of the netconn_*_async()
+ * functions. The same struct can be reused once an operation has completed.
+ *
+ * @param op the operation to initialize
+ * @param callback called in tcpip_thread when an operation completes (may be
+ *        NULL if the application polls op instead)
+ * @param arg argument passed to callback
+ */
+void
+netconn_async_init(struct netconn_async *op, netconn_async_fn callback, void *arg)
+{
+  op->callback = callback;
+  op->arg = arg;
+  op->state = NETCONN_ASYNC_IDLE;
+  op->err = ERR_OK;
+  op->buf = NULL;
+}
+
+/**
+ * Check the state of an async operation without blocking.
+ *
+ * @param op the operation
+ * @return ERR_INPROGRESS while the operation is running,
+ *         else the result of the operation
+ */
+err_t
+netconn_async_poll(struct netconn_async *op)
+{
+  if (op->state == NETCONN_ASYNC_PENDING) {
+    return ERR_INPROGRESS;
+  }
+  return op->err;
+}
+
+/**
+ * Executed in tcpip_thread: start an async operation.
+ *
+ * @param arg the struct netconn_async to start
+ */
+static void
+netconn_async_start(void *arg)
+{
+  struct netconn_async *op = (struct netconn_async *)arg;
+  op->msg.function(&op->msg.msg);
+}
+
+/**
+ * Pass an async operation to tcpip_thread without waiting for it.
+ *
+ * @param op the operation (op->msg is already set up)
+ * @param slot where the pending operation is stored in the netconn
+ *        (only one operation per slot may be pending)
+ * @return ERR_OK if the operation has been started,
+ *         ERR_INPROGRESS if another operation is pending on this slot,
+ *         ERR_MEM if the tcpip_thread mailbox is full
+ */
+static err_t
+netconn_async_submit(struct netconn_async *op, struct netconn_async **slot)
+{
+  err_t err;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_ERROR("netconn_async: op already pending", (op->state != NETCONN_ASYNC_PENDING),
+    return ERR_INPROGRESS;);
+  SYS_ARCH_PROTECT(lev);
+  if (*slot != NULL) {
+    SYS_ARCH_UNPROTECT(lev);
+    return ERR_INPROGRESS;
+  }
+  *slot = op;
+  op->state = NETCONN_ASYNC_PENDING;
+  op->buf = NULL;
+  SYS_ARCH_UNPROTECT(lev);
+
+  err = tcpip_callback_with_block(netconn_async_start, op, 0);
+  if (err != ERR_OK) {
+    SYS_ARCH_PROTECT(lev);
+    *slot = NULL;
+    op->state = NETCONN_ASYNC_IDLE;
+    SYS_ARCH_UNPROTECT(lev);
+  }
+  return err;
+}
+
+/**
+ * Connect a netconn without blocking, see netconn_connect().
+ *
+ * @param conn the netconn to connect (must not be in non-blocking mode)
+ * @param addr the remote IP address to connect to
+ * @param port the remote port to connect to (no used for RAW)
+ * @param op completion state, initialized by netconn_async_init
+ * @return ERR_OK if the operation was started (the result is reported
+ *         through op), another err_t if not (op is not used then)
+ */
+err_t
+netconn_connect_async(struct netconn *conn, ip_addr_t *addr, u16_t port,
+                      struct netconn_async *op)
+{
+  LWIP_ERROR("netconn_connect_async: invalid conn", (conn != NULL), return ERR_ARG;);
+  LWIP_ERROR("netconn_connect_async: non-blocking conn", !netconn_is_nonblocking(conn),
+    return ERR_VAL;);
+
+  op->msg.function = do_connect;
+  op->msg.msg.conn = conn;
+  op->msg.msg.msg.bc.ipaddr = addr;
+  op->msg.msg.msg.bc.port = port;
+  return netconn_async_submit(op, &conn->async_op);
+}
+
+/**
+ * Send data over a TCP netconn without blocking, see netconn_write().
+ * The operation completes when all data has been enqueued for sending;
+ * dataptr must stay valid until then (also with NETCONN_COPY).
+ *
+ * @param conn the TCP netconn over which to send data
+ * @param dataptr pointer to the application buffer that contains the data to send
+ * @param size size of the application data to send
+ * @param apiflags NETCONN_COPY and/or NETCONN_MORE
+ * @param op completion state, initialized by netconn_async_init
+ * @return ERR_OK if the operation was started (the result is reported
+ *         through op, see netconn_async_written), another err_t if not
+ */
+err_t
+netconn_write_async(struct netconn *conn, const void *dataptr, size_t size,
+                    u8_t apiflags, struct netconn_async *op)
+{
+  LWIP_ERROR("netconn_write_async: invalid conn", (conn != NULL), return ERR_ARG;);
+  LWIP_ERROR("netconn_write_async: invalid conn->type", (conn->type == NETCONN_TCP),
+    return ERR_VAL;);
+  LWIP_ERROR("netconn_write_async: non-blocking conn", !netconn_is_nonblocking(conn),
+    return ERR_VAL;);
+  LWIP_ERROR("netconn_write_async: invalid size", (size != 0), return ERR_ARG;);
+
+  op->msg.function = do_write;
+  op->msg.msg.conn = conn;
+  op->msg.msg.msg.w.dataptr = dataptr;
+  op->msg.msg.msg.w.apiflags = apiflags & ~NETCONN_DONTBLOCK;
+  op->msg.msg.msg.w.len = size;
+#if LWIP_SO_SNDTIMEO
+  op->msg.msg.msg.w.time_started = (conn->send_timeout != 0) ? sys_now() : 0;
+#endif /* LWIP_SO_SNDTIMEO */
+  return netconn_async_submit(op, &conn->async_op);
+}
+
+/**
+ * Receive data without blocking, see netconn_recv().
+ * On success, op->buf holds a struct pbuf * (TCP) or struct netbuf * (UDP,
+ * RAW) that the application must free. For TCP, ERR_CLSD is reported once
+ * the remote side has closed the connection.
+ *
+ * @param conn the netconn from which to receive data
+ * @param op completion state, initialized by netconn_async_init
+ * @return ERR_OK if the operation was started (the result is reported
+ *         through op), another err_t if not
+ */
+err_t
+netconn_recv_async(struct netconn *conn, struct netconn_async *op)
+{
+  LWIP_ERROR("netconn_recv_async: invalid conn", (conn != NULL), return ERR_ARG;);
+
+  op->msg.function = do_recv_async;
+  op->msg.msg.conn = conn;
+  return netconn_async_submit(op, &conn->async_recv);
+}
+
+/**
+ * Close a TCP netconn without blocking, see netconn_close().
+ * The netconn still has to be deleted after the operation completed.
+ *
+ * @param conn the TCP netconn to close
+ * @param op completion state, initialized by netconn_async_init
+ * @return ERR_OK if the operation was started (the result is reported
+ *         through op), another err_t if not
+ */
+err_t
+netconn_close_async(struct netconn *conn, struct netconn_async *op)
+{
+  LWIP_ERROR("netconn_close_async: invalid conn", (conn != NULL), return ERR_ARG;);
+
+  op->msg.function = do_close;
+  op->msg.msg.conn = conn;
+  op->msg.msg.msg.sd.shut = NETCONN_SHUT_RDWR;
+  return netconn_async_submit(op, &conn->async_op);
+}
+#endif /* LWIP_NETCONN_ASYNC */
+
 /**
  * Close ot shutdown a TCP netconn (doesn't delete it).
  *
@@ -769,7 +1112,15 @@ netconn_gethostbyname(const char *name, ip_addr_t *addr)
   msg.err = &err;
   msg.sem = &sem;
 
+#if LWIP_TCPIP_CORE_LOCKING
+  /* start the query directly, sem is signalled when it is done (which might
+     already be the case if the name was cached) */
+  LOCK_TCPIP_CORE();
+  do_gethostbyname(&msg);
+  UNLOCK_TCPIP_CORE();
+#else /* LWIP_TCPIP_CORE_LOCKING */
   tcpip_callback(do_gethostbyname, &msg);
+#endif /* LWIP_TCPIP_CORE_LOCKING */
   sys_sem_wait(&sem);
   sys_sem_free(&sem);
 
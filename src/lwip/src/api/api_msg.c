@@ -60,11 +60,24 @@
   (conn)->flags &= ~ NETCONN_FLAG_IN_NONBLOCKING_CONNECT; }} while(0)
 #define IN_NONBLOCKING_CONNECT(conn) (((conn)->flags & NETCONN_FLAG_IN_NONBLOCKING_CONNECT) != 0)
 
+#if LWIP_NETCONN_ASYNC
+#define NETCONN_OP_COMPLETED(msg)     netconn_op_completed(msg)
+#define NETCONN_ASYNC_RECV_CHECK(c)   do { if ((c)->async_recv != NULL) { \
+                                        netconn_async_recv_check(c); }} while(0)
+#else /* LWIP_NETCONN_ASYNC */
+#define NETCONN_OP_COMPLETED(msg)     sys_sem_signal(&(msg)->conn->op_completed)
+#define NETCONN_ASYNC_RECV_CHECK(c)
+#endif /* LWIP_NETCONN_ASYNC */
+
 /* forward declarations */
 #if LWIP_TCP
 static err_t do_writemore(struct netconn *conn);
 static void do_close_internal(struct netconn *conn);
 #endif
+#if LWIP_NETCONN_ASYNC
+static void netconn_async_recv_check(struct netconn *conn);
+static void netconn_async_abort(struct netconn *conn);
+#endif /* LWIP_NETCONN_ASYNC */
 
 #if LWIP_RAW
 /**
@@ -125,6 +138,7 @@ recv_raw(void *arg, struct raw_pcb *pcb, struct pbuf *p,
 #endif /* LWIP_SO_RCVBUF */
         /* Register event with callback */
         API_EVENT(conn, NETCONN_EVT_RCVPLUS, len);
+        NETCONN_ASYNC_RECV_CHECK(conn);
       }
     }
   }
@@ -201,6 +215,7 @@ recv_udp(void *arg, struct udp_pcb *pcb, struct pbuf *p,
 #endif /* LWIP_SO_RCVBUF */
     /* Register event with callback */
     API_EVENT(conn, NETCONN_EVT_RCVPLUS, len);
+    NETCONN_ASYNC_RECV_CHECK(conn);
   }
 }
 #endif /* LWIP_UDP */
@@ -257,6 +272,7 @@ recv_tcp(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
 #endif /* LWIP_SO_RCVBUF */
     /* Register event with callback */
     API_EVENT(conn, NETCONN_EVT_RCVPLUS, len);
+    NETCONN_ASYNC_RECV_CHECK(conn);
   }
 
   return ERR_OK;
@@ -324,6 +340,10 @@ sent_tcp(void *arg, struct tcp_pcb *pcb, u16_t len)
   }
 
   if (conn) {
+#if LWIP_SOCKET_ZEROCOPY
+    /* zero-copy sockets need to know exactly how much data has left the send queue */
+    API_EVENT(conn, NETCONN_EVT_ACKED, len);
+#endif /* LWIP_SOCKET_ZEROCOPY */
     /* If the queued byte- or pbuf-count drops below the configured low-water limit,
        let select mark this pcb as writable again. */
     if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT) &&
@@ -376,6 +396,7 @@ err_tcp(void *arg, err_t err)
   if (sys_mbox_valid(&conn->recvmbox)) {
     /* use trypost to prevent deadlock */
     sys_mbox_trypost(&conn->recvmbox, NULL);
+    NETCONN_ASYNC_RECV_CHECK(conn);
   }
   /* pass NULL-message to acceptmbox to wake up pending accept */
   if (sys_mbox_valid(&conn->acceptmbox)) {
@@ -391,12 +412,13 @@ err_tcp(void *arg, err_t err)
     SET_NONBLOCKING_CONNECT(conn, 0);
 
     if (!was_nonblocking_connect) {
+      struct api_msg_msg *msg = conn->current_msg;
       /* set error return code */
-      LWIP_ASSERT("conn->current_msg != NULL", conn->current_msg != NULL);
-      conn->current_msg->err = err;
+      LWIP_ASSERT("conn->current_msg != NULL", msg != NULL);
+      msg->err = err;
       conn->current_msg = NULL;
       /* wake up the waiting task */
-      sys_sem_signal(&conn->op_completed);
+      NETCONN_OP_COMPLETED(msg);
     }
   } else {
     LWIP_ASSERT("conn->current_msg == NULL", conn->current_msg == NULL);
@@ -630,6 +652,10 @@ netconn_alloc(enum netconn_type t, netconn_callback callback)
   conn->current_msg  = NULL;
   conn->write_offset = 0;
 #endif /* LWIP_TCP */
+#if LWIP_NETCONN_ASYNC
+  conn->async_op     = NULL;
+  conn->async_recv   = NULL;
+#endif /* LWIP_NETCONN_ASYNC */
 #if LWIP_SO_SNDTIMEO
   conn->send_timeout = 0;
 #endif /* LWIP_SO_SNDTIMEO */
@@ -688,6 +714,19 @@ netconn_drain(struct netconn *conn)
 
   /* This runs in tcpip_thread, so we don't need to lock against rx packets */
 
+#if LWIP_NETCONN_ASYNC
+  if (conn->async_recv != NULL) {
+    /* nothing more will be received */
+    struct netconn_async *op = conn->async_recv;
+    conn->async_recv = NULL;
+    op->err = ERR_CLSD;
+    op->state = NETCONN_ASYNC_DONE;
+    if (op->callback != NULL) {
+      op->callback(op, op->arg);
+    }
+  }
+#endif /* LWIP_NETCONN_ASYNC */
+
   /* Delete and drain the recvmbox. */
   if (sys_mbox_valid(&conn->recvmbox)) {
     while (sys_mbox_tryfetch(&conn->recvmbox, &mem) != SYS_MBOX_EMPTY) {
@@ -748,6 +787,7 @@ do_close_internal(struct netconn *conn)
 {
   err_t err;
   u8_t shut, shut_rx, shut_tx, close;
+  struct api_msg_msg *msg;
 
   LWIP_ASSERT("invalid conn", (conn != NULL));
   LWIP_ASSERT("this is for tcp netconns only", (conn->type == NETCONN_TCP));
@@ -789,7 +829,8 @@ do_close_internal(struct netconn *conn)
   }
   if (err == ERR_OK) {
     /* Closing succeeded */
-    conn->current_msg->err = ERR_OK;
+    msg = conn->current_msg;
+    msg->err = ERR_OK;
     conn->current_msg = NULL;
     conn->state = NETCONN_NONE;
     if (close) {
@@ -806,7 +847,7 @@ do_close_internal(struct netconn *conn)
       API_EVENT(conn, NETCONN_EVT_SENDPLUS, 0);
     }
     /* wake up the application task */
-    sys_sem_signal(&conn->op_completed);
+    NETCONN_OP_COMPLETED(msg);
   } else {
     /* Closing failed, restore some of the callbacks */
     /* Closing of listen pcb will never fail! */
@@ -831,6 +872,10 @@ do_close_internal(struct netconn *conn)
 void
 do_delconn(struct api_msg_msg *msg)
 {
+#if LWIP_NETCONN_ASYNC
+  /* async operations would use the netconn after it has been freed */
+  netconn_async_abort(msg->conn);
+#endif /* LWIP_NETCONN_ASYNC */
   /* @todo TCP: abort running write/connect? */
  if ((msg->conn->state != NETCONN_NONE) &&
      (msg->conn->state != NETCONN_LISTEN) &&
@@ -883,7 +928,7 @@ do_delconn(struct api_msg_msg *msg)
     API_EVENT(msg->conn, NETCONN_EVT_SENDPLUS, 0);
   }
   if (sys_sem_valid(&msg->conn->op_completed)) {
-    sys_sem_signal(&msg->conn->op_completed);
+    NETCONN_OP_COMPLETED(msg);
   }
 }
 
@@ -937,6 +982,7 @@ static err_t
 do_connected(void *arg, struct tcp_pcb *pcb, err_t err)
 {
   struct netconn *conn;
+  struct api_msg_msg *msg;
   int was_blocking;
 
   LWIP_UNUSED_ARG(pcb);
@@ -959,6 +1005,7 @@ do_connected(void *arg, struct tcp_pcb *pcb, err_t err)
   }
   was_blocking = !IN_NONBLOCKING_CONNECT(conn);
   SET_NONBLOCKING_CONNECT(conn, 0);
+  msg = conn->current_msg;
   conn->current_msg = NULL;
   conn->state = NETCONN_NONE;
   if (!was_blocking) {
@@ -967,7 +1014,7 @@ do_connected(void *arg, struct tcp_pcb *pcb, err_t err)
   API_EVENT(conn, NETCONN_EVT_SENDPLUS, 0);
 
   if (was_blocking) {
-    sys_sem_signal(&conn->op_completed);
+    NETCONN_OP_COMPLETED(msg);
   }
   return ERR_OK;
 }
@@ -1028,7 +1075,7 @@ do_connect(struct api_msg_msg *msg)
     break;
     }
   }
-  sys_sem_signal(&msg->conn->op_completed);
+  NETCONN_OP_COMPLETED(msg);
 }
 
 /**
@@ -1315,14 +1362,15 @@ err_mem:
   if (write_finished) {
     /* everything was written: set back connection state
        and back to application task */
-    conn->current_msg->err = err;
+    struct api_msg_msg *msg = conn->current_msg;
+    msg->err = err;
     conn->current_msg = NULL;
     conn->state = NETCONN_NONE;
 #if LWIP_TCPIP_CORE_LOCKING
     if ((conn->flags & NETCONN_FLAG_WRITE_DELAYED) != 0)
 #endif
     {
-      sys_sem_signal(&conn->op_completed);
+      NETCONN_OP_COMPLETED(msg);
     }
   }
 #if LWIP_TCPIP_CORE_LOCKING
@@ -1478,7 +1526,7 @@ do_close(struct api_msg_msg *msg)
   {
     msg->err = ERR_VAL;
   }
-  sys_sem_signal(&msg->conn->op_completed);
+  NETCONN_OP_COMPLETED(msg);
 }
 
 #if LWIP_IGMP
@@ -1516,6 +1564,152 @@ do_join_leave_group(struct api_msg_msg *msg)
 }
 #endif /* LWIP_IGMP */
 
+#if LWIP_NETCONN_ASYNC
+/**
+ * Finish an async operation: store the result and call the callback.
+ *
+ * @param op the operation
+ * @param err the result of the operation
+ */
+static void
+netconn_async_complete(struct netconn_async *op, err_t err)
+{
+  op->err = err;
+  op->state = NETCONN_ASYNC_DONE;
+  if (op->callback != NULL) {
+    op->callback(op, op->arg);
+  }
+}
+
+/**
+ * Signal that a netconn operation has finished. This wakes up the
+ * application thread waiting on conn->op_completed or, if msg belongs to a
+ * netconn_*_async() operation, completes that one.
+ * Called instead of sys_sem_signal(&conn->op_completed) in tcpip_thread.
+ *
+ * @param msg the api_msg_msg of the operation that has finished
+ */
+void
+netconn_op_completed(struct api_msg_msg *msg)
+{
+  struct netconn *conn = msg->conn;
+  struct netconn_async *op = conn->async_op;
+
+  if ((op == NULL) || (&op->msg.msg != msg)) {
+    sys_sem_signal(&conn->op_completed);
+    return;
+  }
+  conn->async_op = NULL;
+  NETCONN_SET_SAFE_ERR(conn, msg->err);
+  netconn_async_complete(op, msg->err);
+}
+
+/**
+ * Complete all netconn_*_async() operations pending on a netconn with
+ * ERR_ABRT. A pending connect, write or close is still the netconn's
+ * current_msg: it is dropped, so the pcb can be closed right away.
+ * Called from do_delconn.
+ *
+ * @param conn the netconn that is being deleted
+ */
+static void
+netconn_async_abort(struct netconn *conn)
+{
+  struct netconn_async *op = conn->async_op;
+
+  if (op != NULL) {
+    conn->async_op = NULL;
+    if (conn->current_msg == &op->msg.msg) {
+      conn->current_msg = NULL;
+      conn->write_offset = 0;
+      conn->state = NETCONN_NONE;
+    }
+    netconn_async_complete(op, ERR_ABRT);
+  }
+  op = conn->async_recv;
+  if (op != NULL) {
+    conn->async_recv = NULL;
+    netconn_async_complete(op, ERR_ABRT);
+  }
+}
+
+/**
+ * If a netconn_recv_async() is pending and recvmbox is not empty, take the
+ * next buffer and complete the operation with it. Does the same as
+ * netconn_recv_data(), but in tcpip_thread context.
+ *
+ * @param conn the netconn with conn->async_recv != NULL
+ */
+static void
+netconn_async_recv_check(struct netconn *conn)
+{
+  struct netconn_async *op = conn->async_recv;
+  void *buf;
+  u16_t len;
+
+  if (ERR_IS_FATAL(conn->last_err) || !sys_mbox_valid(&conn->recvmbox)) {
+    conn->async_recv = NULL;
+    netconn_async_complete(op, ERR_IS_FATAL(conn->last_err) ? conn->last_err : ERR_CONN);
+    return;
+  }
+  if (sys_mbox_tryfetch(&conn->recvmbox, &buf) == SYS_MBOX_EMPTY) {
+    /* completed later from the recv callback */
+    return;
+  }
+  conn->async_recv = NULL;
+
+#if LWIP_TCP
+#if (LWIP_UDP || LWIP_RAW)
+  if (conn->type == NETCONN_TCP)
+#endif /* (LWIP_UDP || LWIP_RAW) */
+  {
+    if (buf == NULL) {
+      /* connection closed */
+      API_EVENT(conn, NETCONN_EVT_RCVMINUS, 0);
+      NETCONN_SET_SAFE_ERR(conn, ERR_CLSD);
+      netconn_async_complete(op, ERR_CLSD);
+      return;
+    }
+    len = ((struct pbuf *)buf)->tot_len;
+    if (!netconn_get_noautorecved(conn) && (conn->pcb.tcp != NULL)) {
+      /* we are in tcpip_thread: update the window directly */
+      tcp_recved(conn->pcb.tcp, len);
+    }
+  }
+#endif /* LWIP_TCP */
+#if LWIP_TCP && (LWIP_UDP || LWIP_RAW)
+  else
+#endif /* LWIP_TCP && (LWIP_UDP || LWIP_RAW) */
+#if (LWIP_UDP || LWIP_RAW)
+  {
+    LWIP_ASSERT("buf != NULL", buf != NULL);
+    len = netbuf_len((struct netbuf *)buf);
+  }
+#endif /* (LWIP_UDP || LWIP_RAW) */
+
+#if LWIP_SO_RCVBUF
+  SYS_ARCH_DEC(conn->recv_avail, len);
+#endif /* LWIP_SO_RCVBUF */
+  API_EVENT(conn, NETCONN_EVT_RCVMINUS, len);
+
+  op->buf = buf;
+  netconn_async_complete(op, ERR_OK);
+}
+
+/**
+ * Start a netconn_recv_async() operation (conn->async_recv is already set).
+ * Completes immediately if data is already queued.
+ * Called from netconn_recv_async.
+ *
+ * @param msg the api_msg_msg pointing to the connection
+ */
+void
+do_recv_async(struct api_msg_msg *msg)
+{
+  netconn_async_recv_check(msg->conn);
+}
+#endif /* LWIP_NETCONN_ASYNC */
+
 #if LWIP_DNS
 /**
  * Callback function that is called when DNS name is resolved
@@ -60,6 +60,61 @@
 
 #define NUM_SOCKETS MEMP_NUM_NETCONN
 
+#if LWIP_SOCKET_EPOLL
+struct lwip_epoll;
+
+/** Registration of one socket with one epoll instance */
+struct lwip_epoll_item {
+  /** next registration of the same socket (other epoll instance) */
+  struct lwip_epoll_item *sock_next;
+  /** links in the ready queue of the epoll instance */
+  struct lwip_epoll_item *ready_next;
+  struct lwip_epoll_item *ready_prev;
+  /** the epoll instance this registration belongs to */
+  struct lwip_epoll *ep;
+  /** LWIP_EPOLL* events the application is interested in */
+  u32_t events;
+  /** user data returned by lwip_epoll_wait */
+  lwip_epoll_data_t data;
+  /** != 0 while registered */
+  u8_t used;
+  /** != 0 while on the ready queue */
+  u8_t queued;
+};
+
+/** An epoll instance: one registration slot per socket and a ready queue */
+struct lwip_epoll {
+  /** != 0 if this instance is allocated */
+  u8_t used;
+  /** != 0 while a task is blocked in lwip_epoll_wait */
+  u8_t waiting;
+  /** don't signal the semaphore twice while the waiter wakes up */
+  u8_t signalled;
+  /** semaphore to wake up the waiting task */
+  sys_sem_t sem;
+  /** sockets with pending events, oldest first */
+  struct lwip_epoll_item *ready_head;
+  struct lwip_epoll_item *ready_tail;
+  /** registration slots, indexed by socket */
+  struct lwip_epoll_item items[NUM_SOCKETS];
+};
+#endif /* LWIP_SOCKET_EPOLL */
+
+#if LWIP_SOCKET_ZEROCOPY
+/** A zero-copy send waiting for its last byte to be ACKed */
+struct lwip_zc_pending {
+  /** data passed to lwip_send_zc(), referenced by the TCP send queue */
+  const void *dataptr;
+  /** number of bytes actually enqueued */
+  size_t size;
+  /** value of lwip_sock.zc_queued once this data has been enqueued */
+  u32_t end;
+  /** completion callback and its argument */
+  lwip_zc_sent_fn sent_fn;
+  void *arg;
+};
+#endif /* LWIP_SOCKET_ZEROCOPY */
+
 /** Contains all internal pointers and states used for a socket */
 struct lwip_sock {
   /** sockets currently are built on netconns, each socket has one netconn */
@@ -80,6 +135,20 @@ struct lwip_sock {
   int err;
   /** counter of how many threads are waiting for this socket using select */
   int select_waiting;
+#if LWIP_SOCKET_EPOLL
+  /** epoll instances interested in this socket */
+  struct lwip_epoll_item *epoll_items;
+#endif /* LWIP_SOCKET_EPOLL */
+#if LWIP_SOCKET_ZEROCOPY
+  /** TCP: number of bytes enqueued by lwip_send/lwip_send_zc (wraps) */
+  u32_t zc_queued;
+  /** TCP: number of bytes ACKed by the remote side (wraps) */
+  u32_t zc_acked;
+  /** TCP: ring of zero-copy sends not yet ACKed, oldest at zc_head */
+  struct lwip_zc_pending zc_pending[LWIP_SOCKET_ZEROCOPY_PENDING];
+  u8_t zc_head;
+  u8_t zc_count;
+#endif /* LWIP_SOCKET_ZEROCOPY */
 };
 
 /** Description for a task waiting in select */
@@ -94,6 +163,12 @@ struct lwip_select_cb {
   fd_set *writeset;
   /** unimplemented: exceptset passed to select */
   fd_set *exceptset;
+#if LWIP_SOCKET_POLL
+  /** fds passed to poll, NULL for select */
+  struct pollfd *poll_fds;
+  /** number of entries in poll_fds */
+  nfds_t poll_nfds;
+#endif /* LWIP_SOCKET_POLL */
   /** don't signal the same semaphore twice: set to 1 when signalled */
   int sem_signalled;
   /** semaphore to wake up a task waiting for select */
@@ -124,6 +199,10 @@ struct lwip_setgetsockopt_data {
 
 /** The global array of available sockets */
 static struct lwip_sock sockets[NUM_SOCKETS];
+#if LWIP_SOCKET_EPOLL
+/** The global array of available epoll instances */
+static struct lwip_epoll epolls[LWIP_SOCKET_EPOLL_NUM];
+#endif /* LWIP_SOCKET_EPOLL */
 /** The global list of tasks waiting for select */
 static struct lwip_select_cb *select_cb_list;
 /** This counter is increased from lwip_select when the list is chagned
@@ -171,6 +250,22 @@ static const int err_to_errno_table[] = {
   set_errno(sk->err); \
 } while (0)
 
+#if LWIP_TCPIP_CORE_LOCKING
+/** With the core locked, socket options are processed in the caller's context */
+#define LWIP_SOCKOPT_CALL(fn, data) do { \
+  LOCK_TCPIP_CORE(); \
+  fn(data); \
+  UNLOCK_TCPIP_CORE(); \
+} while (0)
+#define LWIP_SOCKOPT_ACK(sock)
+#else /* LWIP_TCPIP_CORE_LOCKING */
+#define LWIP_SOCKOPT_CALL(fn, data) do { \
+  tcpip_callback(fn, data); \
+  sys_arch_sem_wait(&(data)->sock->conn->op_completed, 0); \
+} while (0)
+#define LWIP_SOCKOPT_ACK(sock) sys_sem_signal(&(sock)->conn->op_completed)
+#endif /* LWIP_TCPIP_CORE_LOCKING */
+
 /* Forward delcaration of some functions */
 static void event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len);
 static void lwip_getsockopt_internal(void *arg);
@@ -231,6 +326,119 @@ tryget_socket(int s)
   return &sockets[s];
 }
 
+#if LWIP_SOCKET_POLL || LWIP_SOCKET_EPOLL
+/** Readiness of a socket as LWIP_SOCK_EV_* bits */
+#define LWIP_SOCK_EV_READ   0x01
+#define LWIP_SOCK_EV_WRITE  0x02
+#define LWIP_SOCK_EV_ERROR  0x04
+
+/**
+ * Get the current readiness of a socket (same tests as lwip_selscan).
+ * Must be called with SYS_ARCH protected.
+ *
+ * @param sock the socket to check
+ * @return LWIP_SOCK_EV_* bits
+ */
+static u8_t
+lwip_sock_events(struct lwip_sock *sock)
+{
+  u8_t ev = 0;
+  if ((sock->lastdata != NULL) || (sock->rcvevent > 0)) {
+    ev |= LWIP_SOCK_EV_READ;
+  }
+  if (sock->sendevent != 0) {
+    ev |= LWIP_SOCK_EV_WRITE;
+  }
+  if (sock->errevent != 0) {
+    ev |= LWIP_SOCK_EV_ERROR;
+  }
+  return ev;
+}
+#endif /* LWIP_SOCKET_POLL || LWIP_SOCKET_EPOLL */
+
+#if LWIP_SOCKET_EPOLL
+/**
+ * Convert the readiness of a socket to the events an epoll registration
+ * has to report (errors are always reported).
+ */
+static u32_t
+lwip_epoll_events(struct lwip_sock *sock, struct lwip_epoll_item *item)
+{
+  u8_t ev = lwip_sock_events(sock);
+  u32_t ret = 0;
+  if ((ev & LWIP_SOCK_EV_READ) && (item->events & LWIP_EPOLLIN)) {
+    ret |= LWIP_EPOLLIN;
+  }
+  if ((ev & LWIP_SOCK_EV_WRITE) && (item->events & LWIP_EPOLLOUT)) {
+    ret |= LWIP_EPOLLOUT;
+  }
+  if (ev & LWIP_SOCK_EV_ERROR) {
+    ret |= LWIP_EPOLLERR;
+  }
+  return ret;
+}
+
+/** Append a registration to the ready queue (SYS_ARCH protected) */
+static void
+lwip_epoll_enqueue(struct lwip_epoll *ep, struct lwip_epoll_item *item)
+{
+  if (item->queued) {
+    return;
+  }
+  item->queued = 1;
+  item->ready_next = NULL;
+  item->ready_prev = ep->ready_tail;
+  if (ep->ready_tail != NULL) {
+    ep->ready_tail->ready_next = item;
+  } else {
+    ep->ready_head = item;
+  }
+  ep->ready_tail = item;
+}
+
+/** Remove a registration from the ready queue (SYS_ARCH protected) */
+static void
+lwip_epoll_unqueue(struct lwip_epoll *ep, struct lwip_epoll_item *item)
+{
+  if (!item->queued) {
+    return;
+  }
+  item->queued = 0;
+  if (item->ready_prev != NULL) {
+    item->ready_prev->ready_next = item->ready_next;
+  } else {
+    ep->ready_head = item->ready_next;
+  }
+  if (item->ready_next != NULL) {
+    item->ready_next->ready_prev = item->ready_prev;
+  } else {
+    ep->ready_tail = item->ready_prev;
+  }
+  item->ready_next = item->ready_prev = NULL;
+}
+
+/**
+ * Called from event_callback (SYS_ARCH protected): put all registrations of
+ * a socket that now have events on their ready queues and wake up waiters.
+ */
+static void
+lwip_epoll_notify(struct lwip_sock *sock)
+{
+  struct lwip_epoll_item *item;
+
+  for (item = sock->epoll_items; item != NULL; item = item->sock_next) {
+    if (lwip_epoll_events(sock, item) != 0) {
+      struct lwip_epoll *ep = item->ep;
+      lwip_epoll_enqueue(ep, item);
+      if (ep->waiting && !ep->signalled) {
+        ep->signalled = 1;
+        sys_sem_signal(&ep->sem);
+      }
+    }
+  }
+}
+#endif /* LWIP_SOCKET_EPOLL */
+
 /**
  * Allocate a new socket for a given netconn.
  *
@@ -263,6 +471,15 @@ alloc_socket(struct netconn *newconn, int accepted)
       sockets[i].errevent   = 0;
       sockets[i].err        = 0;
       sockets[i].select_waiting = 0;
+#if LWIP_SOCKET_EPOLL
+      sockets[i].epoll_items = NULL;
+#endif /* LWIP_SOCKET_EPOLL */
+#if LWIP_SOCKET_ZEROCOPY
+      sockets[i].zc_queued  = 0;
+      sockets[i].zc_acked   = 0;
+      sockets[i].zc_head    = 0;
+      sockets[i].zc_count   = 0;
+#endif /* LWIP_SOCKET_ZEROCOPY */
       return i;
     }
     SYS_ARCH_UNPROTECT(lev);
@@ -289,6 +506,15 @@ free_socket(struct lwip_sock *sock, int is_tcp)
 
   /* Protect socket array */
   SYS_ARCH_PROTECT(lev);
+#if LWIP_SOCKET_EPOLL
+  /* a closed socket is implicitly removed from all epoll instances */
+  while (sock->epoll_items != NULL) {
+    struct lwip_epoll_item *item = sock->epoll_items;
+    sock->epoll_items = item->sock_next;
+    lwip_epoll_unqueue(item->ep, item);
+    item->used = 0;
+  }
+#endif /* LWIP_SOCKET_EPOLL */
   sock->conn       = NULL;
   SYS_ARCH_UNPROTECT(lev);
   /* don't use 'sock' after this line, as another task might have allocated it */
@@ -460,6 +686,17 @@ lwip_close(int s)
     LWIP_ASSERT("sock->lastdata == NULL", sock->lastdata == NULL);
   }
 
+#if LWIP_SOCKET_ZEROCOPY
+  if (sock->zc_count != 0) {
+    /* the TCP send queue still references application memory: closing now
+       would hand that memory back while the pcb lingers in FIN_WAIT */
+    LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_close(%d): %"U16_F" zero-copy sends pending\n",
+      s, (u16_t)sock->zc_count));
+    sock_set_errno(sock, EBUSY);
+    return -1;
+  }
+#endif /* LWIP_SOCKET_ZEROCOPY */
+
   netconn_delete(sock->conn);
 
   free_socket(sock, is_tcp);
@@ -780,6 +1017,14 @@ lwip_send(int s, const void *data, size_t size, int flags)
     ((flags & MSG_DONTWAIT) ? NETCONN_DONTBLOCK : 0);
   written = 0;
   err = netconn_write_partly(sock->conn, data, size, write_flags, &written);
+#if LWIP_SOCKET_ZEROCOPY
+  if (err == ERR_OK) {
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    sock->zc_queued += (u32_t)written;
+    SYS_ARCH_UNPROTECT(lev);
+  }
+#endif /* LWIP_SOCKET_ZEROCOPY */
 
   LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_send(%d) err=%d written=%"SZT_F"\n", s, err, written));
   sock_set_errno(sock, err_to_errno(err));
@@ -795,9 +1040,7 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
   u16_t short_size;
   const struct sockaddr_in *to_in;
   u16_t remote_port;
-#if !LWIP_TCPIP_CORE_LOCKING
   struct netbuf buf;
-#endif
 
   sock = get_socket(s);
   if (!sock) {
@@ -823,75 +1066,6 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
              sock_set_errno(sock, err_to_errno(ERR_ARG)); return -1;);
   to_in = (const struct sockaddr_in *)(void*)to;
 
-#if LWIP_TCPIP_CORE_LOCKING
-  /* Should only be consider like a sample or a simple way to experiment this option (no check of "to" field...) */
-  {
-    struct pbuf* p;
-    ip_addr_t *remote_addr;
-
-#if LWIP_NETIF_TX_SINGLE_PBUF
-    p = pbuf_alloc(PBUF_TRANSPORT, short_size, PBUF_RAM);
-    if (p != NULL) {
-#if LWIP_CHECKSUM_ON_COPY
-      u16_t chksum = 0;
-      if (sock->conn->type != NETCONN_RAW) {
-        chksum = LWIP_CHKSUM_COPY(p->payload, data, short_size);
-      } else
-#endif /* LWIP_CHECKSUM_ON_COPY */
-      MEMCPY(p->payload, data, size);
-#else /* LWIP_NETIF_TX_SINGLE_PBUF */
-    p = pbuf_alloc(PBUF_TRANSPORT, short_size, PBUF_REF);
-    if (p != NULL) {
-      p->payload = (void*)data;
-#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
-
-      if (to_in != NULL) {
-        inet_addr_to_ipaddr_p(remote_addr, &to_in->sin_addr);
-        remote_port = ntohs(to_in->sin_port);
-      } else {
-        remote_addr = &sock->conn->pcb.ip->remote_ip;
-#if LWIP_UDP
-        if (NETCONNTYPE_GROUP(sock->conn->type) == NETCONN_UDP) {
-          remote_port = sock->conn->pcb.udp->remote_port;
-        } else
-#endif /* LWIP_UDP */
-        {
-          remote_port = 0;
-        }
-      }
-
-      LOCK_TCPIP_CORE();
-      if (netconn_type(sock->conn) == NETCONN_RAW) {
-#if LWIP_RAW
-        err = sock->conn->last_err = raw_sendto(sock->conn->pcb.raw, p, remote_addr);
-#else /* LWIP_RAW */
-        err = ERR_ARG;
-#endif /* LWIP_RAW */
-      }
-#if LWIP_UDP && LWIP_RAW
-      else
-#endif /* LWIP_UDP && LWIP_RAW */
-      {
-#if LWIP_UDP
-#if LWIP_CHECKSUM_ON_COPY && LWIP_NETIF_TX_SINGLE_PBUF
-        err = sock->conn->last_err = udp_sendto_chksum(sock->conn->pcb.udp, p,
-          remote_addr, remote_port, 1, chksum);
-#else /* LWIP_CHECKSUM_ON_COPY && LWIP_NETIF_TX_SINGLE_PBUF */
-        err = sock->conn->last_err = udp_sendto(sock->conn->pcb.udp, p,
-          remote_addr, remote_port);
-#endif /* LWIP_CHECKSUM_ON_COPY && LWIP_NETIF_TX_SINGLE_PBUF */
-#else /* LWIP_UDP */
-        err = ERR_ARG;
-#endif /* LWIP_UDP */
-      }
-      UNLOCK_TCPIP_CORE();
-      
-      pbuf_free(p);
-    } else {
-      err = ERR_MEM;
-    }
-  }
-#else /* LWIP_TCPIP_CORE_LOCKING */
   /* initialize a buffer */
   buf.p = buf.ptr = NULL;
 #if LWIP_CHECKSUM_ON_COPY
@@ -939,7 +1113,6 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
 
   /* deallocated the buffer */
   netbuf_free(&buf);
-#endif /* LWIP_TCPIP_CORE_LOCKING */
   sock_set_errno(sock, err_to_errno(err));
   return (err == ERR_OK ? short_size : -1);
 }
@@ -1006,6 +1179,236 @@ lwip_write(int s, const void *data, size_t size)
   return lwip_send(s, data, size, 0);
 }
 
+#if LWIP_SOCKET_ZEROCOPY
+/**
+ * Report finished zero-copy sends of a socket to the application.
+ *
+ * @param s socket index passed to the callbacks
+ * @param sock the socket to check
+ * @param err 0 to complete only the sends that have been ACKed completely,
+ *            an errno value to complete all pending sends (the pcb has been
+ *            freed together with all data it referenced)
+ */
+static void
+lwip_zc_complete(int s, struct lwip_sock *sock, int err)
+{
+  struct lwip_zc_pending done;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  for (;;) {
+    SYS_ARCH_PROTECT(lev);
+    if ((sock->zc_count == 0) || ((err == 0) &&
+        ((s32_t)(sock->zc_acked - sock->zc_pending[sock->zc_head].end) < 0))) {
+      SYS_ARCH_UNPROTECT(lev);
+      return;
+    }
+    done = sock->zc_pending[sock->zc_head];
+    sock->zc_head = (u8_t)((sock->zc_head + 1) % LWIP_SOCKET_ZEROCOPY_PENDING);
+    sock->zc_count--;
+    SYS_ARCH_UNPROTECT(lev);
+
+    LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_zc_complete(%d): %p/%"SZT_F" done, err=%d\n",
+      s, done.dataptr, done.size, err));
+    /* don't call the application with interrupts/tasks locked */
+    if (done.sent_fn != NULL) {
+      done.sent_fn(s, done.dataptr, done.size, err, done.arg);
+    }
+  }
+}
+
+/**
+ * Send data without copying it into the TCP send buffer.
+ *
+ * The data is referenced by the TCP segments until the remote side has ACKed
+ * it, so the application must not modify or free it before 'sent_fn' has been
+ * called for it. Only the first return value bytes are enqueued (as for
+ * lwip_send()), 'sent_fn' is called once for exactly that region.
+ * lwip_close() fails with EBUSY while zero-copy sends are pending.
+ *
+ * UDP and RAW sockets reference the data only during the call (as long as
+ * LWIP_NETIF_TX_SINGLE_PBUF is off), so 'sent_fn' is called before returning.
+ *
+ * @param s the socket to send on
+ * @param data data to send
+ * @param size number of bytes at 'data'
+ * @param flags MSG_MORE/MSG_DONTWAIT as for lwip_send()
+ * @param sent_fn called when 'data' may be reused (may be NULL)
+ * @param arg argument passed to 'sent_fn'
+ * @return number of bytes enqueued or -1 on error (errno set)
+ */
+int
+lwip_send_zc(int s, const void *data, size_t size, int flags,
+             lwip_zc_sent_fn sent_fn, void *arg)
+{
+  struct lwip_sock *sock;
+  struct lwip_zc_pending *zc;
+  err_t err;
+  u8_t write_flags;
+  size_t written;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_send_zc(%d, data=%p, size=%"SZT_F", flags=0x%x)\n",
+                              s, data, size, flags));
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+
+  if (sock->conn->type != NETCONN_TCP) {
+    int ret = lwip_send(s, data, size, flags);
+    if ((ret >= 0) && (sent_fn != NULL)) {
+      sent_fn(s, data, (size_t)ret, 0, arg);
+    }
+    return ret;
+  }
+
+  if (sock->zc_count >= LWIP_SOCKET_ZEROCOPY_PENDING) {
+    LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_send_zc(%d): too many sends pending\n", s));
+    sock_set_errno(sock, ENOBUFS);
+    return -1;
+  }
+
+  write_flags = NETCONN_NOCOPY |
+    ((flags & MSG_MORE)     ? NETCONN_MORE      : 0) |
+    ((flags & MSG_DONTWAIT) ? NETCONN_DONTBLOCK : 0);
+  written = 0;
+  err = netconn_write_partly(sock->conn, data, size, write_flags, &written);
+
+  if ((err == ERR_OK) && (written > 0)) {
+    SYS_ARCH_PROTECT(lev);
+    sock->zc_queued += (u32_t)written;
+    zc = &sock->zc_pending[(sock->zc_head + sock->zc_count) % LWIP_SOCKET_ZEROCOPY_PENDING];
+    zc->dataptr = data;
+    zc->size    = written;
+    zc->end     = sock->zc_queued;
+    zc->sent_fn = sent_fn;
+    zc->arg     = arg;
+    sock->zc_count++;
+    SYS_ARCH_UNPROTECT(lev);
+    /* the ACK might have arrived before we could enqueue the request */
+    lwip_zc_complete(s, sock, 0);
+  }
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_send_zc(%d) err=%d written=%"SZT_F"\n", s, err, written));
+  sock_set_errno(sock, err_to_errno(err));
+  return (err == ERR_OK ? (int)written : -1);
+}
+
+/**
+ * Receive data without copying it: the received pbuf chain is lent to the
+ * application, which must return it with lwip_recv_zc_release() after
+ * processing it (unmodified). For TCP, the receive window is only opened
+ * again when the data is released.
+ *
+ * Data left over from a previous lwip_recv() on a TCP socket is returned
+ * first. MSG_PEEK is not supported.
+ *
+ * @param s the socket to receive from
+ * @param p receives a pointer to the pbuf chain
+ * @param flags MSG_DONTWAIT as for lwip_recv()
+ * @return number of bytes in *p, 0 if the connection has been closed
+ *         or -1 on error (errno set)
+ */
+int
+lwip_recv_zc(int s, struct pbuf **p, int flags)
+{
+  struct lwip_sock *sock;
+  void             *buf;
+  struct pbuf      *q;
+  err_t            err;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recv_zc(%d, 0x%x)\n", s, flags));
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+  LWIP_ERROR("lwip_recv_zc: invalid pbuf pointer", (p != NULL),
+             sock_set_errno(sock, err_to_errno(ERR_ARG)); return -1;);
+  *p = NULL;
+
+  if (sock->lastdata) {
+    buf = sock->lastdata;
+  } else {
+    if (((flags & MSG_DONTWAIT) || netconn_is_nonblocking(sock->conn)) &&
+        (sock->rcvevent <= 0)) {
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recv_zc(%d): returning EWOULDBLOCK\n", s));
+      sock_set_errno(sock, EWOULDBLOCK);
+      return -1;
+    }
+    if (netconn_type(sock->conn) == NETCONN_TCP) {
+      err = netconn_recv_tcp_pbuf(sock->conn, (struct pbuf **)&buf);
+    } else {
+      err = netconn_recv(sock->conn, (struct netbuf **)&buf);
+    }
+    if (err != ERR_OK) {
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recv_zc(%d): error is \"%s\"!\n",
+        s, lwip_strerr(err)));
+      sock_set_errno(sock, err_to_errno(err));
+      return (err == ERR_CLSD) ? 0 : -1;
+    }
+  }
+
+  if (netconn_type(sock->conn) == NETCONN_TCP) {
+    u16_t off = sock->lastoffset;
+    q = (struct pbuf *)buf;
+    /* drop the part lwip_recvfrom() has already copied out */
+    while (off >= q->len) {
+      struct pbuf *next = q->next;
+      LWIP_ASSERT("lastoffset < tot_len", next != NULL);
+      off -= q->len;
+      pbuf_ref(next);
+      pbuf_free(q);
+      q = next;
+    }
+    if (off > 0) {
+      pbuf_header(q, -(s16_t)off);
+    }
+  } else {
+    q = ((struct netbuf *)buf)->p;
+    ((struct netbuf *)buf)->p = NULL;
+    ((struct netbuf *)buf)->ptr = NULL;
+    netbuf_delete((struct netbuf *)buf);
+  }
+  sock->lastdata = NULL;
+  sock->lastoffset = 0;
+
+  *p = q;
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recv_zc(%d): lent %p len=%"U16_F"\n", s, (void *)q, q->tot_len));
+  sock_set_errno(sock, 0);
+  return q->tot_len;
+}
+
+/**
+ * Return a pbuf chain obtained from lwip_recv_zc().
+ *
+ * @param s the socket the chain was received from
+ * @param p the chain returned by lwip_recv_zc()
+ * @return 0 on success, -1 if the socket is not valid any more
+ *         (the chain is freed anyway)
+ */
+int
+lwip_recv_zc_release(int s, struct pbuf *p)
+{
+  struct lwip_sock *sock;
+
+  if (p == NULL) {
+    return 0;
+  }
+  sock = get_socket(s);
+  if ((sock != NULL) && (netconn_type(sock->conn) == NETCONN_TCP)) {
+    /* the data has been consumed: update the receive window */
+    netconn_recved(sock->conn, (u32_t)p->tot_len);
+  }
+  pbuf_free(p);
+  if (sock == NULL) {
+    return -1;
+  }
+  sock_set_errno(sock, 0);
+  return 0;
+}
+#endif /* LWIP_SOCKET_ZEROCOPY */
+
 /**
  * Go through the readset and writeset lists and see which socket of the sockets
  * set in the sets has events. On return, readset, writeset and exceptset have
@@ -1081,6 +1484,55 @@ lwip_selscan(int maxfdp1, fd_set *readset_in, fd_set *writeset_in, fd_set *excep
   return nready;
 }
 
+/**
+ * Put a select_cb on top of select_cb_list so that event_callback
+ * can wake up its task.
+ */
+static void
+lwip_link_select_cb(struct lwip_select_cb *select_cb)
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  /* Protect the select_cb_list */
+  SYS_ARCH_PROTECT(lev);
+
+  /* Put this select_cb on top of list */
+  select_cb->next = select_cb_list;
+  if (select_cb_list != NULL) {
+    select_cb_list->prev = select_cb;
+  }
+  select_cb_list = select_cb;
+  /* Increasing this counter tells even_callback that the list has changed. */
+  select_cb_ctr++;
+
+  /* Now we can safely unprotect */
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+/**
+ * Take a select_cb off select_cb_list again.
+ */
+static void
+lwip_unlink_select_cb(struct lwip_select_cb *select_cb)
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  if (select_cb->next != NULL) {
+    select_cb->next->prev = select_cb->prev;
+  }
+  if (select_cb_list == select_cb) {
+    LWIP_ASSERT("select_cb->prev == NULL", select_cb->prev == NULL);
+    select_cb_list = select_cb->next;
+  } else {
+    LWIP_ASSERT("select_cb->prev != NULL", select_cb->prev != NULL);
+    select_cb->prev->next = select_cb->next;
+  }
+  /* Increasing this counter tells even_callback that the list has changed. */
+  select_cb_ctr++;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
 /**
  * Processing exceptset is not yet implemented.
  */
@@ -1125,6 +1577,10 @@ lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset,
     select_cb.readset = readset;
     select_cb.writeset = writeset;
     select_cb.exceptset = exceptset;
+#if LWIP_SOCKET_POLL
+    select_cb.poll_fds = NULL;
+    select_cb.poll_nfds = 0;
+#endif /* LWIP_SOCKET_POLL */
     select_cb.sem_signalled = 0;
     err = sys_sem_new(&select_cb.sem, 0);
     if (err != ERR_OK) {
@@ -1133,20 +1589,7 @@ lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset,
       return -1;
     }
 
-    /* Protect the select_cb_list */
-    SYS_ARCH_PROTECT(lev);
-
-    /* Put this select_cb on top of list */
-    select_cb.next = select_cb_list;
-    if (select_cb_list != NULL) {
-      select_cb_list->prev = &select_cb;
-    }
-    select_cb_list = &select_cb;
-    /* Increasing this counter tells even_callback that the list has changed. */
-    select_cb_ctr++;
-
-    /* Now we can safely unprotect */
-    SYS_ARCH_UNPROTECT(lev);
+    lwip_link_select_cb(&select_cb);
 
     /* Increase select_waiting for each socket we are interested in */
     for(i = 0; i < maxfdp1; i++) {
@@ -1194,20 +1637,7 @@ lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset,
       }
     }
     /* Take us off the list */
-    SYS_ARCH_PROTECT(lev);
-    if (select_cb.next != NULL) {
-      select_cb.next->prev = select_cb.prev;
-    }
-    if (select_cb_list == &select_cb) {
-      LWIP_ASSERT("select_cb.prev == NULL", select_cb.prev == NULL);
-      select_cb_list = select_cb.next;
-    } else {
-      LWIP_ASSERT("select_cb.prev != NULL", select_cb.prev != NULL);
-      select_cb.prev->next = select_cb.next;
-    }
-    /* Increasing this counter tells even_callback that the list has changed. */
-    select_cb_ctr++;
-    SYS_ARCH_UNPROTECT(lev);
+    lwip_unlink_select_cb(&select_cb);
 
     sys_sem_free(&select_cb.sem);
     if (waitres == SYS_ARCH_TIMEOUT)  {
@@ -1239,6 +1669,435 @@ return_copy_fdsets:
   return nready;
 }
 
+#if LWIP_SOCKET_POLL
+/**
+ * Check the sockets passed to lwip_poll and fill in their revents.
+ *
+ * @param fds the pollfd array passed to lwip_poll
+ * @param nfds number of entries in fds
+ * @return number of entries with revents != 0
+ */
+static int
+lwip_pollscan(struct pollfd *fds, nfds_t nfds)
+{
+  nfds_t i;
+  int nready = 0;
+  struct lwip_sock *sock;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  for (i = 0; i < nfds; i++) {
+    u8_t ev = 0;
+    fds[i].revents = 0;
+    if (fds[i].fd < 0) {
+      /* negative fds are ignored */
+      continue;
+    }
+    SYS_ARCH_PROTECT(lev);
+    sock = tryget_socket(fds[i].fd);
+    if (sock != NULL) {
+      ev = lwip_sock_events(sock);
+    }
+    SYS_ARCH_UNPROTECT(lev);
+    if (sock == NULL) {
+      fds[i].revents = POLLNVAL;
+    } else {
+      if ((fds[i].events & POLLIN) && (ev & LWIP_SOCK_EV_READ)) {
+        fds[i].revents |= POLLIN;
+      }
+      if ((fds[i].events & POLLOUT) && (ev & LWIP_SOCK_EV_WRITE)) {
+        fds[i].revents |= POLLOUT;
+      }
+      if (ev & LWIP_SOCK_EV_ERROR) {
+        fds[i].revents |= POLLERR;
+      }
+    }
+    if (fds[i].revents != 0) {
+      nready++;
+    }
+  }
+  return nready;
+}
+
+/**
+ * Adjust select_waiting of all sockets in a pollfd array.
+ */
+static void
+lwip_poll_inc_waiting(struct pollfd *fds, nfds_t nfds, int inc)
+{
+  nfds_t i;
+  struct lwip_sock *sock;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  for (i = 0; i < nfds; i++) {
+    SYS_ARCH_PROTECT(lev);
+    sock = tryget_socket(fds[i].fd);
+    if (sock != NULL) {
+      sock->select_waiting += inc;
+      LWIP_ASSERT("sock->select_waiting >= 0", sock->select_waiting >= 0);
+    }
+    SYS_ARCH_UNPROTECT(lev);
+  }
+}
+
+/**
+ * Called from event_callback (SYS_ARCH protected): check whether a task
+ * waiting in lwip_poll is interested in socket 's'.
+ */
+static int
+lwip_poll_should_wake(struct lwip_select_cb *scb, int s, struct lwip_sock *sock)
+{
+  nfds_t i;
+  u8_t ev = lwip_sock_events(sock);
+
+  for (i = 0; i < scb->poll_nfds; i++) {
+    if (scb->poll_fds[i].fd == s) {
+      if (((scb->poll_fds[i].events & POLLIN) && (ev & LWIP_SOCK_EV_READ)) ||
+          ((scb->poll_fds[i].events & POLLOUT) && (ev & LWIP_SOCK_EV_WRITE)) ||
+          (ev & LWIP_SOCK_EV_ERROR)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * poll() for lwIP sockets: cost is O(nfds) instead of O(maxfdp1).
+ *
+ * @param fds sockets and the POLLIN/POLLOUT events to wait for
+ * @param nfds number of entries in fds
+ * @param timeout milliseconds to wait, 0 to return immediately,
+ *        negative to wait forever
+ * @return number of entries with revents set, 0 on timeout, -1 on error
+ */
+int
+lwip_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  u32_t waitres = 0;
+  int nready;
+  struct lwip_select_cb select_cb;
+  err_t err;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_poll(%p, %d, %d)\n", (void*)fds, (int)nfds, timeout));
+  LWIP_ERROR("lwip_poll: invalid fds", ((fds != NULL) || (nfds == 0)),
+             set_errno(EINVAL); return -1;);
+
+  nready = lwip_pollscan(fds, nfds);
+  if ((nready != 0) || (timeout == 0)) {
+    set_errno(0);
+    return nready;
+  }
+
+  select_cb.next = NULL;
+  select_cb.prev = NULL;
+  select_cb.readset = NULL;
+  select_cb.writeset = NULL;
+  select_cb.exceptset = NULL;
+  select_cb.poll_fds = fds;
+  select_cb.poll_nfds = nfds;
+  select_cb.sem_signalled = 0;
+  err = sys_sem_new(&select_cb.sem, 0);
+  if (err != ERR_OK) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  lwip_link_select_cb(&select_cb);
+  lwip_poll_inc_waiting(fds, nfds, 1);
+
+  /* scan again: there could have been events before we were on the list */
+  nready = lwip_pollscan(fds, nfds);
+  if (!nready) {
+    waitres = sys_arch_sem_wait(&select_cb.sem, (timeout < 0) ? 0 : (u32_t)timeout);
+  }
+
+  lwip_poll_inc_waiting(fds, nfds, -1);
+  lwip_unlink_select_cb(&select_cb);
+  sys_sem_free(&select_cb.sem);
+
+  if (!nready && (waitres != SYS_ARCH_TIMEOUT)) {
+    nready = lwip_pollscan(fds, nfds);
+  }
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_poll: nready=%d\n", nready));
+  set_errno(0);
+  return nready;
+}
+#endif /* LWIP_SOCKET_POLL */
+
+#if LWIP_SOCKET_EPOLL
+/**
+ * Map an epoll handle to its instance.
+ */
+static struct lwip_epoll *
+get_epoll(int epfd)
+{
+  if ((epfd < 0) || (epfd >= LWIP_SOCKET_EPOLL_NUM) || !epolls[epfd].used) {
+    LWIP_DEBUGF(SOCKETS_DEBUG, ("get_epoll(%d): invalid\n", epfd));
+    set_errno(EBADF);
+    return NULL;
+  }
+  return &epolls[epfd];
+}
+
+/**
+ * Create an epoll instance. Epoll handles are not socket indices: they
+ * can only be passed to the lwip_epoll_* functions.
+ *
+ * @return the new epoll handle or -1 on error
+ */
+int
+lwip_epoll_create(void)
+{
+  int i;
+  struct lwip_epoll *ep;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  for (i = 0; i < LWIP_SOCKET_EPOLL_NUM; i++) {
+    SYS_ARCH_PROTECT(lev);
+    if (!epolls[i].used) {
+      epolls[i].used = 1;
+      SYS_ARCH_UNPROTECT(lev);
+      ep = &epolls[i];
+      if (sys_sem_new(&ep->sem, 0) != ERR_OK) {
+        ep->used = 0;
+        set_errno(ENOMEM);
+        return -1;
+      }
+      ep->waiting = 0;
+      ep->signalled = 0;
+      ep->ready_head = NULL;
+      ep->ready_tail = NULL;
+      memset(ep->items, 0, sizeof(ep->items));
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_epoll_create() = %d\n", i));
+      set_errno(0);
+      return i;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+  }
+  set_errno(EMFILE);
+  return -1;
+}
+
+/**
+ * Add, modify or remove the registration of a socket with an epoll instance.
+ *
+ * @param epfd epoll handle returned by lwip_epoll_create
+ * @param op LWIP_EPOLL_CTL_ADD, LWIP_EPOLL_CTL_MOD or LWIP_EPOLL_CTL_DEL
+ * @param s the socket
+ * @param event events to wait for and user data (ignored for DEL)
+ * @return 0 on success, -1 on error
+ */
+int
+lwip_epoll_ctl(int epfd, int op, int s, struct lwip_epoll_event *event)
+{
+  struct lwip_epoll *ep;
+  struct lwip_epoll_item *item, **pitem;
+  struct lwip_sock *sock;
+  int ret = 0;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_epoll_ctl(%d, %d, %d)\n", epfd, op, s));
+  ep = get_epoll(epfd);
+  if (ep == NULL) {
+    return -1;
+  }
+  if ((op != LWIP_EPOLL_CTL_DEL) && (event == NULL)) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  SYS_ARCH_PROTECT(lev);
+  sock = tryget_socket(s);
+  if (sock == NULL) {
+    SYS_ARCH_UNPROTECT(lev);
+    set_errno(EBADF);
+    return -1;
+  }
+  item = &ep->items[s];
+  switch (op) {
+    case LWIP_EPOLL_CTL_ADD:
+      if (item->used) {
+        ret = EEXIST;
+        break;
+      }
+      item->used = 1;
+      item->queued = 0;
+      item->ep = ep;
+      item->sock_next = sock->epoll_items;
+      sock->epoll_items = item;
+      /* fall through */
+    case LWIP_EPOLL_CTL_MOD:
+      if (!item->used) {
+        ret = ENOENT;
+        break;
+      }
+      item->events = event->events;
+      item->data = event->data;
+      /* events that are already pending must be reported, too */
+      lwip_epoll_unqueue(ep, item);
+      if (lwip_epoll_events(sock, item) != 0) {
+        lwip_epoll_enqueue(ep, item);
+        if (ep->waiting && !ep->signalled) {
+          ep->signalled = 1;
+          sys_sem_signal(&ep->sem);
+        }
+      }
+      break;
+    case LWIP_EPOLL_CTL_DEL:
+      if (!item->used) {
+        ret = ENOENT;
+        break;
+      }
+      for (pitem = &sock->epoll_items; *pitem != NULL; pitem = &(*pitem)->sock_next) {
+        if (*pitem == item) {
+          *pitem = item->sock_next;
+          break;
+        }
+      }
+      lwip_epoll_unqueue(ep, item);
+      item->used = 0;
+      break;
+    default:
+      ret = EINVAL;
+      break;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+
+  set_errno(ret);
+  return (ret == 0) ? 0 : -1;
+}
+
+/**
+ * Take up to 'maxevents' events off the ready queue (SYS_ARCH protected).
+ * Level-triggered registrations that are still ready are put back at the
+ * tail so that they are reported again by the next call.
+ */
+static int
+lwip_epoll_collect(struct lwip_epoll *ep, struct lwip_epoll_event *events, int maxevents)
+{
+  int n = 0;
+  struct lwip_epoll_item *item, *last;
+
+  /* only look at the items that were queued on entry */
+  last = ep->ready_tail;
+  while ((n < maxevents) && ((item = ep->ready_head) != NULL)) {
+    struct lwip_sock *sock = &sockets[item - ep->items];
+    u32_t ev = lwip_epoll_events(sock, item);
+    lwip_epoll_unqueue(ep, item);
+    if (ev != 0) {
+      events[n].events = ev;
+      events[n].data = item->data;
+      n++;
+      if (!(item->events & LWIP_EPOLLET)) {
+        lwip_epoll_enqueue(ep, item);
+      }
+    }
+    if (item == last) {
+      break;
+    }
+  }
+  return n;
+}
+
+/**
+ * Wait for events on the sockets registered with an epoll instance.
+ * Only one task may wait on an epoll instance at a time.
+ *
+ * @param epfd epoll handle returned by lwip_epoll_create
+ * @param events array receiving the events
+ * @param maxevents number of entries in 'events'
+ * @param timeout milliseconds to wait, 0 to return immediately,
+ *        negative to wait forever
+ * @return number of events returned, 0 on timeout, -1 on error
+ */
+int
+lwip_epoll_wait(int epfd, struct lwip_epoll_event *events, int maxevents, int timeout)
+{
+  struct lwip_epoll *ep;
+  int n;
+  u32_t waited;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  ep = get_epoll(epfd);
+  if (ep == NULL) {
+    return -1;
+  }
+  if ((events == NULL) || (maxevents <= 0)) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  for (;;) {
+    SYS_ARCH_PROTECT(lev);
+    n = lwip_epoll_collect(ep, events, maxevents);
+    if ((n == 0) && (timeout != 0)) {
+      LWIP_ASSERT("only one task may wait on an epoll instance", !ep->waiting);
+      ep->waiting = 1;
+      ep->signalled = 0;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+    if ((n != 0) || (timeout == 0)) {
+      break;
+    }
+
+    waited = sys_arch_sem_wait(&ep->sem, (timeout < 0) ? 0 : (u32_t)timeout);
+    SYS_ARCH_PROTECT(lev);
+    ep->waiting = 0;
+    SYS_ARCH_UNPROTECT(lev);
+    if (waited == SYS_ARCH_TIMEOUT) {
+      timeout = 0;
+    } else if (timeout > 0) {
+      /* woken up by an event that may have gone again: wait for the rest */
+      timeout = ((u32_t)timeout > waited) ? (int)(timeout - waited) : 0;
+    }
+  }
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_epoll_wait(%d) = %d\n", epfd, n));
+  set_errno(0);
+  return n;
+}
+
+/**
+ * Destroy an epoll instance, unregistering all its sockets.
+ *
+ * @param epfd epoll handle returned by lwip_epoll_create
+ * @return 0 on success, -1 on error
+ */
+int
+lwip_epoll_close(int epfd)
+{
+  struct lwip_epoll *ep;
+  struct lwip_epoll_item **pitem;
+  int i;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  ep = get_epoll(epfd);
+  if (ep == NULL) {
+    return -1;
+  }
+  LWIP_ERROR("lwip_epoll_close: task waiting", !ep->waiting, set_errno(EBUSY); return -1;);
+
+  for (i = 0; i < NUM_SOCKETS; i++) {
+    SYS_ARCH_PROTECT(lev);
+    if (ep->items[i].used) {
+      for (pitem = &sockets[i].epoll_items; *pitem != NULL; pitem = &(*pitem)->sock_next) {
+        if (*pitem == &ep->items[i]) {
+          *pitem = ep->items[i].sock_next;
+          break;
+        }
+      }
+      ep->items[i].used = 0;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+  }
+  ep->ready_head = NULL;
+  ep->ready_tail = NULL;
+  sys_sem_free(&ep->sem);
+  ep->used = 0;
+  set_errno(0);
+  return 0;
+}
+#endif /* LWIP_SOCKET_EPOLL */
+
 /**
  * Callback registered in the netconn layer for each socket-netconn.
  * Processes recvevent (data available) and wakes up tasks waiting for select.
@@ -1283,6 +2142,21 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
     return;
   }
 
+#if LWIP_SOCKET_ZEROCOPY
+  if (evt == NETCONN_EVT_ACKED) {
+    SYS_ARCH_PROTECT(lev);
+    sock->zc_acked += len;
+    SYS_ARCH_UNPROTECT(lev);
+    lwip_zc_complete(s, sock, 0);
+    return;
+  }
+  if ((evt == NETCONN_EVT_ERROR) && (sock->zc_count != 0) &&
+      (netconn_type(conn) == NETCONN_TCP) && (conn->pcb.tcp == NULL)) {
+    /* the pcb is gone and with it all segments referencing application data */
+    lwip_zc_complete(s, sock, err_to_errno(conn->last_err));
+  }
+#endif /* LWIP_SOCKET_ZEROCOPY */
+
   SYS_ARCH_PROTECT(lev);
   /* Set event as required */
   switch (evt) {
@@ -1306,6 +2180,12 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
       break;
   }
 
+#if LWIP_SOCKET_EPOLL
+  if (sock->epoll_items != NULL) {
+    lwip_epoll_notify(sock);
+  }
+#endif /* LWIP_SOCKET_EPOLL */
+
   if (sock->select_waiting == 0) {
     /* noone is waiting for this socket, no need to check select_cb_list */
     SYS_ARCH_UNPROTECT(lev);
@@ -1339,6 +2219,11 @@ again:
           do_signal = 1;
         }
       }
+#if LWIP_SOCKET_POLL
+      if (!do_signal && (scb->poll_fds != NULL)) {
+        do_signal = lwip_poll_should_wake(scb, s, sock);
+      }
+#endif /* LWIP_SOCKET_POLL */
       if (do_signal) {
         scb->sem_signalled = 1;
         /* Don't call SYS_ARCH_UNPROTECT() before signaling the semaphore, as this might
@@ -1642,8 +2527,7 @@ lwip_getsockopt(int s, int level, int optname, void *optval, socklen_t *optlen)
   data.optval = optval;
   data.optlen = optlen;
   data.err = err;
-  tcpip_callback(lwip_getsockopt_internal, &data);
-  sys_arch_sem_wait(&sock->conn->op_completed, 0);
+  LWIP_SOCKOPT_CALL(lwip_getsockopt_internal, &data);
   /* maybe lwip_getsockopt_internal has changed err */
   err = data.err;
 
@@ -1856,7 +2740,7 @@ lwip_getsockopt_internal(void *arg)
     LWIP_ASSERT("unhandled level", 0);
     break;
   } /* switch (level) */
-  sys_sem_signal(&sock->conn->op_completed);
+  LWIP_SOCKOPT_ACK(sock);
 }
 
 int
@@ -2059,8 +2943,7 @@ lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t opt
   data.optval = (void*)optval;
   data.optlen = &optlen;
   data.err = err;
-  tcpip_callback(lwip_setsockopt_internal, &data);
-  sys_arch_sem_wait(&sock->conn->op_completed, 0);
+  LWIP_SOCKOPT_CALL(lwip_setsockopt_internal, &data);
   /* maybe lwip_setsockopt_internal has changed err */
   err = data.err;
 
@@ -2274,7 +3157,7 @@ lwip_setsockopt_internal(void *arg)
     LWIP_ASSERT("unhandled level", 0);
     break;
   }  /* switch (level) */
-  sys_sem_signal(&sock->conn->op_completed);
+  LWIP_SOCKOPT_ACK(sock);
 }
 
 int
@@ -44,6 +44,7 @@
 #include "lwip/memp.h"
 #include "lwip/mem.h"
 #include "lwip/pbuf.h"
+#include "lwip/stats.h"
 #include "lwip/tcpip.h"
 #include "lwip/init.h"
 #include "netif/etharp.h"
@@ -57,9 +58,181 @@ static sys_mbox_t mbox;
 #if LWIP_TCPIP_CORE_LOCKING
 /** The global semaphore to lock the stack. */
 sys_mutex_t lock_tcpip_core;
+#if LOCK_STATS
+/** Set while lock_tcpip_core is held, used to detect contention */
+static volatile u8_t tcpip_core_locked;
+/** LOCK_STATS_NOW() when lock_tcpip_core was taken */
+static u32_t tcpip_core_lock_time;
+
+/**
+ * Take the core lock and count hold time and contention in
+ * lwip_stats.core_lock (LOCK_TCPIP_CORE with LOCK_STATS enabled).
+ */
+void
+tcpip_core_lock(void)
+{
+  u32_t start = LOCK_STATS_NOW();
+  u8_t contended = tcpip_core_locked;
+
+  sys_mutex_lock(&lock_tcpip_core);
+  tcpip_core_locked = 1;
+  tcpip_core_lock_time = LOCK_STATS_NOW();
+  /* the stats are protected by the lock itself */
+  LOCK_STATS_INC(core_lock.acquired);
+  if (contended) {
+    LOCK_STATS_INC(core_lock.contended);
+    LOCK_STATS_TIME(core_lock.wait, tcpip_core_lock_time - start);
+  }
+}
+
+/**
+ * Release the core lock taken by tcpip_core_lock().
+ */
+void
+tcpip_core_unlock(void)
+{
+  u32_t held = LOCK_STATS_NOW() - tcpip_core_lock_time;
+
+  LOCK_STATS_TIME(core_lock.hold, held);
+  tcpip_core_locked = 0;
+  sys_mutex_unlock(&lock_tcpip_core);
+}
+#endif /* LOCK_STATS */
 #endif /* LWIP_TCPIP_CORE_LOCKING */
 
 
+/**
+ * Feed one received packet into the stack (tcpip_thread context, core locked)
+ *
+ * @param p the received packet
+ * @param inp the network interface on which the packet was received
+ * @return the return value of ethernet_input/ip_input
+ */
+static err_t
+tcpip_input_pkt(struct pbuf *p, struct netif *inp)
+{
+#if LWIP_ETHERNET
+  if (inp->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
+    return ethernet_input(p, inp);
+  } else
+#endif /* LWIP_ETHERNET */
+  {
+    return ip_input(p, inp);
+  }
+}
+
+/**
+ * Process one message received by tcpip_thread.
+ *
+ * @param msg the message to process
+ */
+static void
+tcpip_thread_handle_msg(struct tcpip_msg *msg)
+{
+  switch (msg->type) {
+#if LWIP_NETCONN
+  case TCPIP_MSG_API:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: API message %p\n", (void *)msg));
+    msg->msg.apimsg->function(&(msg->msg.apimsg->msg));
+    break;
+#if LWIP_NETCONN_BATCH
+  case TCPIP_MSG_API_BATCH:
+    {
+      /* 'msg' lives on the caller's stack and is gone as soon as the last
+         operation has signalled its netconn: don't touch it after that */
+      struct api_msg *apimsgs = msg->msg.apibatch.apimsgs;
+      u8_t num = msg->msg.apibatch.num;
+      u8_t i;
+      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: API batch %p (%"U16_F")\n", (void *)msg, (u16_t)num));
+      for (i = 0; i < num; i++) {
+        apimsgs[i].function(&apimsgs[i].msg);
+      }
+    }
+    break;
+#endif /* LWIP_NETCONN_BATCH */
+#endif /* LWIP_NETCONN */
+
+#if !LWIP_TCPIP_CORE_LOCKING_INPUT
+  case TCPIP_MSG_INPKT:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: PACKET %p\n", (void *)msg));
+    tcpip_input_pkt(msg->msg.inp.p, msg->msg.inp.netif);
+    memp_free(MEMP_TCPIP_MSG_INPKT, msg);
+    break;
+#if LWIP_TCPIP_INPUT_BATCH
+  case TCPIP_MSG_INPKT_BATCH:
+    {
+      struct tcpip_inpkt_batch *batch = (struct tcpip_inpkt_batch *)msg;
+      u8_t i;
+      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: PACKET batch %p (%"U16_F")\n",
+        (void *)msg, (u16_t)batch->num));
+      for (i = 0; i < batch->num; i++) {
+        tcpip_input_pkt(batch->p[i], msg->msg.inp.netif);
+      }
+      memp_free(MEMP_TCPIP_MSG_INPKT_BATCH, batch);
+    }
+    break;
+#endif /* LWIP_TCPIP_INPUT_BATCH */
+#endif /* LWIP_TCPIP_CORE_LOCKING_INPUT */
+
+#if LWIP_NETIF_API
+  case TCPIP_MSG_NETIFAPI:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: Netif API message %p\n", (void *)msg));
+    msg->msg.netifapimsg->function(&(msg->msg.netifapimsg->msg));
+    break;
+#endif /* LWIP_NETIF_API */
+
+#if LWIP_TCPIP_TIMEOUT
+  case TCPIP_MSG_TIMEOUT:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: TIMEOUT %p\n", (void *)msg));
+    sys_timeout(msg->msg.tmo.msecs, msg->msg.tmo.h, msg->msg.tmo.arg);
+    memp_free(MEMP_TCPIP_MSG_API, msg);
+    break;
+  case TCPIP_MSG_UNTIMEOUT:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: UNTIMEOUT %p\n", (void *)msg));
+    sys_untimeout(msg->msg.tmo.h, msg->msg.tmo.arg);
+    memp_free(MEMP_TCPIP_MSG_API, msg);
+    break;
+#endif /* LWIP_TCPIP_TIMEOUT */
+
+  case TCPIP_MSG_CALLBACK:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: CALLBACK %p\n", (void *)msg));
+    msg->msg.cb.function(msg->msg.cb.ctx);
+    memp_free(MEMP_TCPIP_MSG_API, msg);
+    break;
+
+  case TCPIP_MSG_CALLBACK_STATIC:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: CALLBACK_STATIC %p\n", (void *)msg));
+    msg->msg.cb.function(msg->msg.cb.ctx);
+    break;
+
+  default:
+    LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: invalid message: %d\n", msg->type));
+    LWIP_ASSERT("tcpip_thread: invalid message", 0);
+    break;
+  }
+}
+
+/**
+ * Process a message fetched by tcpip_thread, then up to TCPIP_MBOX_BATCH - 1
+ * more that are already waiting (core locked).
+ *
+ * @param msg the message that ended the wait
+ * @return the number of messages processed
+ */
+static u16_t
+tcpip_thread_handle_msgs(struct tcpip_msg *msg)
+{
+  u16_t num;
+
+  for (num = 1; ; num++) {
+    tcpip_thread_handle_msg(msg);
+    if ((num >= TCPIP_MBOX_BATCH) ||
+        (sys_mbox_tryfetch(&mbox, (void **)&msg) == SYS_MBOX_EMPTY)) {
+      return num;
+    }
+  }
+}
+
 /**
  * The main lwIP thread. This thread has exclusive access to lwIP core functions
  * (unless access to them is not locked). Other threads communicate with this
@@ -87,67 +260,33 @@ tcpip_thread(void *arg)
     /* wait for a message, timeouts are processed while waiting */
     sys_timeouts_mbox_fetch(&mbox, (void **)&msg);
     LOCK_TCPIP_CORE();
-    switch (msg->type) {
-#if LWIP_NETCONN
-    case TCPIP_MSG_API:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: API message %p\n", (void *)msg));
-      msg->msg.apimsg->function(&(msg->msg.apimsg->msg));
-      break;
-#endif /* LWIP_NETCONN */
-
-#if !LWIP_TCPIP_CORE_LOCKING_INPUT
-    case TCPIP_MSG_INPKT:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: PACKET %p\n", (void *)msg));
-#if LWIP_ETHERNET
-      if (msg->msg.inp.netif->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
-        ethernet_input(msg->msg.inp.p, msg->msg.inp.netif);
-      } else
-#endif /* LWIP_ETHERNET */
-      {
-        ip_input(msg->msg.inp.p, msg->msg.inp.netif);
-      }
-      memp_free(MEMP_TCPIP_MSG_INPKT, msg);
-      break;
-#endif /* LWIP_TCPIP_CORE_LOCKING_INPUT */
-
-#if LWIP_NETIF_API
-    case TCPIP_MSG_NETIFAPI:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: Netif API message %p\n", (void *)msg));
-      msg->msg.netifapimsg->function(&(msg->msg.netifapimsg->msg));
-      break;
-#endif /* LWIP_NETIF_API */
+    /* drain up to TCPIP_MBOX_BATCH messages before going back to the timers */
+    tcpip_thread_handle_msgs(msg);
+  }
+}
 
-#if LWIP_TCPIP_TIMEOUT
-    case TCPIP_MSG_TIMEOUT:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: TIMEOUT %p\n", (void *)msg));
-      sys_timeout(msg->msg.tmo.msecs, msg->msg.tmo.h, msg->msg.tmo.arg);
-      memp_free(MEMP_TCPIP_MSG_API, msg);
-      break;
-    case TCPIP_MSG_UNTIMEOUT:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: UNTIMEOUT %p\n", (void *)msg));
-      sys_untimeout(msg->msg.tmo.h, msg->msg.tmo.arg);
-      memp_free(MEMP_TCPIP_MSG_API, msg);
-      break;
-#endif /* LWIP_TCPIP_TIMEOUT */
+#ifdef TCPIP_THREAD_TEST
+/**
+ * Do what tcpip_thread does on one wakeup, without waiting. For tests that
+ * run without threads: tcpip_thread is never started then.
+ *
+ * @return the number of messages processed (0 if there were none)
+ */
+int
+tcpip_thread_poll_one(void)
+{
+  struct tcpip_msg *msg;
+  u16_t num;
 
-    case TCPIP_MSG_CALLBACK:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: CALLBACK %p\n", (void *)msg));
-      msg->msg.cb.function(msg->msg.cb.ctx);
-      memp_free(MEMP_TCPIP_MSG_API, msg);
-      break;
-
-    case TCPIP_MSG_CALLBACK_STATIC:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: CALLBACK_STATIC %p\n", (void *)msg));
-      msg->msg.cb.function(msg->msg.cb.ctx);
-      break;
-
-    default:
-      LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_thread: invalid message: %d\n", msg->type));
-      LWIP_ASSERT("tcpip_thread: invalid message", 0);
-      break;
-    }
+  if (sys_mbox_tryfetch(&mbox, (void **)&msg) == SYS_MBOX_EMPTY) {
+    return 0;
   }
+  LOCK_TCPIP_CORE();
+  num = tcpip_thread_handle_msgs(msg);
+  UNLOCK_TCPIP_CORE();
+  return num;
 }
+#endif /* TCPIP_THREAD_TEST */
 
 /**
  * Pass a received packet to tcpip_thread for input processing
@@ -164,14 +303,7 @@ tcpip_input(struct pbuf *p, struct netif *inp)
   err_t ret;
   LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_input: PACKET %p/%p\n", (void *)p, (void *)inp));
   LOCK_TCPIP_CORE();
-#if LWIP_ETHERNET
-  if (inp->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
-    ret = ethernet_input(p, inp);
-  } else
-#endif /* LWIP_ETHERNET */
-  {
-    ret = ip_input(p, inp);
-  }
+  ret = tcpip_input_pkt(p, inp);
   UNLOCK_TCPIP_CORE();
   return ret;
 #else /* LWIP_TCPIP_CORE_LOCKING_INPUT */
@@ -196,6 +328,58 @@ tcpip_input(struct pbuf *p, struct netif *inp)
 #endif /* LWIP_TCPIP_CORE_LOCKING_INPUT */
 }
 
+#if LWIP_TCPIP_INPUT_BATCH
+/**
+ * Pass several received packets to tcpip_thread with one message.
+ * Saves a mailbox post and a context switch per packet when a driver
+ * drains more than one frame from its receive ring at a time.
+ *
+ * @param p array of received packets (see tcpip_input), the array itself
+ *          may be reused when this function returns
+ * @param num number of packets in p (1..TCPIP_INPUT_BATCH_SIZE)
+ * @param inp the network interface on which the packets were received
+ * @return ERR_OK if all packets were passed on (they are freed by the stack),
+ *         another err_t if none were (the caller still owns them)
+ */
+err_t
+tcpip_input_batch(struct pbuf **p, u8_t num, struct netif *inp)
+{
+#if LWIP_TCPIP_CORE_LOCKING_INPUT
+  u8_t i;
+  LWIP_DEBUGF(TCPIP_DEBUG, ("tcpip_input_batch: %"U16_F" packets/%p\n", (u16_t)num, (void *)inp));
+  LOCK_TCPIP_CORE();
+  for (i = 0; i < num; i++) {
+    tcpip_input_pkt(p[i], inp);
+  }
+  UNLOCK_TCPIP_CORE();
+  return ERR_OK;
+#else /* LWIP_TCPIP_CORE_LOCKING_INPUT */
+  struct tcpip_inpkt_batch *batch;
+
+  LWIP_ERROR("tcpip_input_batch: invalid num", (num > 0) && (num <= TCPIP_INPUT_BATCH_SIZE),
+    return ERR_ARG;);
+  if (!sys_mbox_valid(&mbox)) {
+    return ERR_VAL;
+  }
+  batch = (struct tcpip_inpkt_batch *)memp_malloc(MEMP_TCPIP_MSG_INPKT_BATCH);
+  if (batch == NULL) {
+    return ERR_MEM;
+  }
+
+  batch->msg.type = TCPIP_MSG_INPKT_BATCH;
+  batch->msg.msg.inp.p = NULL;
+  batch->msg.msg.inp.netif = inp;
+  batch->num = num;
+  MEMCPY(batch->p, p, num * sizeof(struct pbuf *));
+  if (sys_mbox_trypost(&mbox, &batch->msg) != ERR_OK) {
+    memp_free(MEMP_TCPIP_MSG_INPKT_BATCH, batch);
+    return ERR_MEM;
+  }
+  return ERR_OK;
+#endif /* LWIP_TCPIP_CORE_LOCKING_INPUT */
+}
+#endif /* LWIP_TCPIP_INPUT_BATCH */
+
 /**
  * Call a specific function in the thread context of
  * tcpip_thread for easy access synchronization.
@@ -321,6 +505,48 @@ tcpip_apimsg(struct api_msg *apimsg)
   return ERR_VAL;
 }
 
+#if LWIP_NETCONN_BATCH
+/**
+ * Call the lower parts of several netconn_* functions with one message.
+ * The operations are executed in order in tcpip_thread. Each of them must
+ * be on a different netconn, since every operation signals the op_completed
+ * semaphore of its own netconn when it is finished.
+ *
+ * @param apimsgs array of structs containing the functions to call
+ * @param num number of entries in apimsgs
+ * @return ERR_OK if the functions were called (check apimsgs[i].msg.err
+ *         for their results), another err_t if not
+ */
+err_t
+tcpip_apimsg_batch(struct api_msg *apimsgs, u8_t num)
+{
+  struct tcpip_msg msg;
+  u8_t i;
+
+  if (num == 0) {
+    return ERR_OK;
+  }
+#ifdef LWIP_DEBUG
+  /* catch functions that don't set err */
+  for (i = 0; i < num; i++) {
+    apimsgs[i].msg.err = ERR_VAL;
+  }
+#endif
+
+  if (sys_mbox_valid(&mbox)) {
+    msg.type = TCPIP_MSG_API_BATCH;
+    msg.msg.apibatch.apimsgs = apimsgs;
+    msg.msg.apibatch.num = num;
+    sys_mbox_post(&mbox, &msg);
+    for (i = 0; i < num; i++) {
+      sys_arch_sem_wait(&apimsgs[i].msg.conn->op_completed, 0);
+    }
+    return ERR_OK;
+  }
+  return ERR_VAL;
+}
+#endif /* LWIP_NETCONN_BATCH */
+
 #if LWIP_TCPIP_CORE_LOCKING
 /**
  * Call the lower part of a netconn_* function
@@ -462,7 +688,7 @@ tcpip_init(tcpip_init_done_fn initfunc, void *arg)
     LWIP_ASSERT("failed to create tcpip_thread mbox", 0);
   }
 #if LWIP_TCPIP_CORE_LOCKING
-  if(sys_mutex_new(&lock_tcpip_core) != ERR_OK) {
+  if(LWIP_TCPIP_CORE_MUTEX_NEW(&lock_tcpip_core) != ERR_OK) {
     LWIP_ASSERT("failed to create lock_tcpip_core", 0);
   }
 #endif /* LWIP_TCPIP_CORE_LOCKING */
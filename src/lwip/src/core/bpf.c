@@ -0,0 +1,630 @@
+/**
+ * @file
+ * Packet filter module
+ *
+ * Runs filter programs in a subset of classic BPF (all loads, stores,
+ * ALU and jump instructions, no extensions) over a pbuf chain without
+ * copying it. Programs are checked once by bpf_validate() when they are
+ * attached: jumps only go forward and stay inside the program, which
+ * ends in a return, so bpf_filter() needs no checks of its own and
+ * always terminates. A raw pcb sees the IP packet (see raw_filter()), a
+ * capture ring on a netif the Ethernet frames it receives and sends.
+ *
+ */
+
+/*
+ * Copyright (c) 2001-2004 Swedish Institute of Computer Science.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT 
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING 
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#include "lwip/opt.h"
+
+#if LWIP_BPF /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/bpf.h"
+#include "lwip/def.h"
+#include "lwip/sys.h"
+
+#include <string.h>
+
+/**
+ * Check that a program is one bpf_filter() can run safely.
+ *
+ * @param prog the program
+ * @return ERR_OK if it can be used, ERR_VAL otherwise
+ */
+err_t
+bpf_validate(const struct bpf_program *prog)
+{
+  const struct bpf_insn *insn;
+  u16_t pc, left;
+
+  if ((prog == NULL) || (prog->bf_len == 0) || (prog->bf_len > BPF_MAXINSNS)) {
+    return ERR_VAL;
+  }
+  for (pc = 0; pc < prog->bf_len; pc++) {
+    insn = &prog->bf_insns[pc];
+    /* instructions after this one */
+    left = prog->bf_len - pc - 1;
+    switch (insn->code) {
+    case BPF_LD|BPF_W|BPF_ABS:
+    case BPF_LD|BPF_H|BPF_ABS:
+    case BPF_LD|BPF_B|BPF_ABS:
+    case BPF_LD|BPF_W|BPF_IND:
+    case BPF_LD|BPF_H|BPF_IND:
+    case BPF_LD|BPF_B|BPF_IND:
+    case BPF_LD|BPF_W|BPF_LEN:
+    case BPF_LD|BPF_IMM:
+    case BPF_LDX|BPF_W|BPF_LEN:
+    case BPF_LDX|BPF_IMM:
+    case BPF_LDX|BPF_MSH|BPF_B:
+    case BPF_ALU|BPF_ADD|BPF_K:
+    case BPF_ALU|BPF_SUB|BPF_K:
+    case BPF_ALU|BPF_MUL|BPF_K:
+    case BPF_ALU|BPF_OR|BPF_K:
+    case BPF_ALU|BPF_AND|BPF_K:
+    case BPF_ALU|BPF_XOR|BPF_K:
+    case BPF_ALU|BPF_LSH|BPF_K:
+    case BPF_ALU|BPF_RSH|BPF_K:
+    case BPF_ALU|BPF_ADD|BPF_X:
+    case BPF_ALU|BPF_SUB|BPF_X:
+    case BPF_ALU|BPF_MUL|BPF_X:
+    case BPF_ALU|BPF_DIV|BPF_X:
+    case BPF_ALU|BPF_MOD|BPF_X:
+    case BPF_ALU|BPF_OR|BPF_X:
+    case BPF_ALU|BPF_AND|BPF_X:
+    case BPF_ALU|BPF_XOR|BPF_X:
+    case BPF_ALU|BPF_LSH|BPF_X:
+    case BPF_ALU|BPF_RSH|BPF_X:
+    case BPF_ALU|BPF_NEG:
+    case BPF_MISC|BPF_TAX:
+    case BPF_MISC|BPF_TXA:
+    case BPF_RET|BPF_K:
+    case BPF_RET|BPF_A:
+      break;
+    case BPF_ALU|BPF_DIV|BPF_K:
+    case BPF_ALU|BPF_MOD|BPF_K:
+      if (insn->k == 0) {
+        return ERR_VAL;
+      }
+      break;
+    case BPF_LD|BPF_MEM:
+    case BPF_LDX|BPF_MEM:
+    case BPF_ST:
+    case BPF_STX:
+      if (insn->k >= BPF_MEMWORDS) {
+        return ERR_VAL;
+      }
+      break;
+    case BPF_JMP|BPF_JA:
+      if (insn->k >= left) {
+        return ERR_VAL;
+      }
+      break;
+    case BPF_JMP|BPF_JEQ|BPF_K:
+    case BPF_JMP|BPF_JGT|BPF_K:
+    case BPF_JMP|BPF_JGE|BPF_K:
+    case BPF_JMP|BPF_JSET|BPF_K:
+    case BPF_JMP|BPF_JEQ|BPF_X:
+    case BPF_JMP|BPF_JGT|BPF_X:
+    case BPF_JMP|BPF_JGE|BPF_X:
+    case BPF_JMP|BPF_JSET|BPF_X:
+      if ((insn->jt >= left) || (insn->jf >= left)) {
+        return ERR_VAL;
+      }
+      break;
+    default:
+      return ERR_VAL;
+    }
+  }
+  /* the last instruction must not fall off the end */
+  if (BPF_CLASS(prog->bf_insns[prog->bf_len - 1].code) != BPF_RET) {
+    return ERR_VAL;
+  }
+  return ERR_OK;
+}
+
+/**
+ * Load 'size' (1, 2 or 4) bytes in network order from offset 'off' of a
+ * pbuf chain. The first pbuf is read directly, the chain only walked for
+ * bytes beyond it.
+ *
+ * @return 1 if the bytes are there, 0 if the packet is too short
+ */
+static u8_t
+bpf_load(struct pbuf *p, u32_t off, u8_t size, u32_t *val)
+{
+  const u8_t *b;
+  u32_t v;
+  u16_t q_off;
+
+  if ((off < p->len) && ((u32_t)(p->len - off) >= size)) {
+    b = (const u8_t *)p->payload + off;
+    switch (size) {
+    case 4:
+      *val = ((u32_t)b[0] << 24) | ((u32_t)b[1] << 16) | ((u32_t)b[2] << 8) | b[3];
+      break;
+    case 2:
+      *val = ((u32_t)b[0] << 8) | b[1];
+      break;
+    default:
+      *val = b[0];
+      break;
+    }
+    return 1;
+  }
+  if ((off >= p->tot_len) || ((u32_t)(p->tot_len - off) < size)) {
+    return 0;
+  }
+  while (off >= p->len) {
+    off -= p->len;
+    p = p->next;
+  }
+  q_off = (u16_t)off;
+  v = 0;
+  while (size-- > 0) {
+    /* skip empty pbufs as well */
+    while (q_off >= p->len) {
+      q_off = 0;
+      p = p->next;
+    }
+    v = (v << 8) | ((const u8_t *)p->payload)[q_off++];
+  }
+  *val = v;
+  return 1;
+}
+
+/**
+ * Run a program over a packet. The program must have passed
+ * bpf_validate(). Loads past the end of the packet reject it, as does a
+ * division by zero.
+ *
+ * @param prog the program
+ * @param p the packet, from the header the program expects
+ * @return what the program returned: 0 to reject the packet, otherwise
+ *         the number of bytes to keep
+ */
+u32_t
+bpf_filter(const struct bpf_program *prog, struct pbuf *p)
+{
+  const struct bpf_insn *pc = prog->bf_insns;
+  u32_t A = 0, X = 0, k;
+  u32_t mem[BPF_MEMWORDS];
+
+  memset(mem, 0, sizeof(mem));
+  for (;; pc++) {
+    k = pc->k;
+    switch (pc->code) {
+    case BPF_RET|BPF_K:
+      return k;
+    case BPF_RET|BPF_A:
+      return A;
+
+    case BPF_LD|BPF_W|BPF_ABS:
+      if (!bpf_load(p, k, 4, &A)) {
+        return 0;
+      }
+      break;
+    case BPF_LD|BPF_H|BPF_ABS:
+      if (!bpf_load(p, k, 2, &A)) {
+        return 0;
+      }
+      break;
+    case BPF_LD|BPF_B|BPF_ABS:
+      if (!bpf_load(p, k, 1, &A)) {
+        return 0;
+      }
+      break;
+    case BPF_LD|BPF_W|BPF_IND:
+      if (((u32_t)(X + k) < X) || !bpf_load(p, X + k, 4, &A)) {
+        return 0;
+      }
+      break;
+    case BPF_LD|BPF_H|BPF_IND:
+      if (((u32_t)(X + k) < X) || !bpf_load(p, X + k, 2, &A)) {
+        return 0;
+      }
+      break;
+    case BPF_LD|BPF_B|BPF_IND:
+      if (((u32_t)(X + k) < X) || !bpf_load(p, X + k, 1, &A)) {
+        return 0;
+      }
+      break;
+    case BPF_LDX|BPF_MSH|BPF_B:
+      /* IP header length: 4 * (byte & 0xf) */
+      if (!bpf_load(p, k, 1, &X)) {
+        return 0;
+      }
+      X = (X & 0xf) << 2;
+      break;
+    case BPF_LD|BPF_W|BPF_LEN:
+      A = p->tot_len;
+      break;
+    case BPF_LDX|BPF_W|BPF_LEN:
+      X = p->tot_len;
+      break;
+    case BPF_LD|BPF_IMM:
+      A = k;
+      break;
+    case BPF_LDX|BPF_IMM:
+      X = k;
+      break;
+    case BPF_LD|BPF_MEM:
+      A = mem[k];
+      break;
+    case BPF_LDX|BPF_MEM:
+      X = mem[k];
+      break;
+    case BPF_ST:
+      mem[k] = A;
+      break;
+    case BPF_STX:
+      mem[k] = X;
+      break;
+
+    case BPF_JMP|BPF_JA:
+      pc += k;
+      break;
+    case BPF_JMP|BPF_JEQ|BPF_K:
+      pc += (A == k) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JGT|BPF_K:
+      pc += (A > k) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JGE|BPF_K:
+      pc += (A >= k) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JSET|BPF_K:
+      pc += (A & k) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JEQ|BPF_X:
+      pc += (A == X) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JGT|BPF_X:
+      pc += (A > X) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JGE|BPF_X:
+      pc += (A >= X) ? pc->jt : pc->jf;
+      break;
+    case BPF_JMP|BPF_JSET|BPF_X:
+      pc += (A & X) ? pc->jt : pc->jf;
+      break;
+
+    case BPF_ALU|BPF_ADD|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_ADD|BPF_K:
+      A += k;
+      break;
+    case BPF_ALU|BPF_SUB|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_SUB|BPF_K:
+      A -= k;
+      break;
+    case BPF_ALU|BPF_MUL|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_MUL|BPF_K:
+      A *= k;
+      break;
+    case BPF_ALU|BPF_DIV|BPF_X:
+      if (X == 0) {
+        return 0;
+      }
+      k = X; /* fall through */
+    case BPF_ALU|BPF_DIV|BPF_K:
+      A /= k;
+      break;
+    case BPF_ALU|BPF_MOD|BPF_X:
+      if (X == 0) {
+        return 0;
+      }
+      k = X; /* fall through */
+    case BPF_ALU|BPF_MOD|BPF_K:
+      A %= k;
+      break;
+    case BPF_ALU|BPF_OR|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_OR|BPF_K:
+      A |= k;
+      break;
+    case BPF_ALU|BPF_AND|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_AND|BPF_K:
+      A &= k;
+      break;
+    case BPF_ALU|BPF_XOR|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_XOR|BPF_K:
+      A ^= k;
+      break;
+    case BPF_ALU|BPF_LSH|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_LSH|BPF_K:
+      A = (k < 32) ? (A << k) : 0;
+      break;
+    case BPF_ALU|BPF_RSH|BPF_X:
+      k = X; /* fall through */
+    case BPF_ALU|BPF_RSH|BPF_K:
+      A = (k < 32) ? (A >> k) : 0;
+      break;
+    case BPF_ALU|BPF_NEG:
+      A = (u32_t)0 - A;
+      break;
+
+    case BPF_MISC|BPF_TAX:
+      X = A;
+      break;
+    case BPF_MISC|BPF_TXA:
+      A = X;
+      break;
+
+    default:
+      /* not reached for validated programs */
+      return 0;
+    }
+  }
+}
+
+/** What a record of a ring with snaplen 0 holds instead of the data */
+struct bpf_ring_ref {
+  struct pbuf *p;
+  /* where the frame started: p may have headers hidden later */
+  const u8_t *payload;
+};
+
+#define BPF_RING_HDR            ((u32_t)sizeof(struct bpf_ring_hdr))
+/** Bytes a record with 'caplen' bytes of data takes, kept word aligned */
+#define BPF_RING_REC(caplen)    (BPF_RING_HDR + (((u32_t)(caplen) + 3) & ~(u32_t)3))
+#define BPF_RING_AT(r, off)     ((struct bpf_ring_hdr *)(void *)((r)->buf + (off)))
+
+/**
+ * Set up a capture ring.
+ *
+ * @param r the ring
+ * @param buf memory for the records (aligned to a word internally)
+ * @param size bytes at buf
+ * @param filter program selecting the packets, NULL for all
+ * @param snaplen at most this many bytes are kept per packet, 0 to keep
+ *        a reference to each pbuf instead (see struct bpf_ring)
+ * @return ERR_OK, or ERR_VAL if the filter is invalid or a packet of
+ *         snaplen bytes would not fit
+ */
+err_t
+bpf_ring_init(struct bpf_ring *r, void *buf, u32_t size,
+              const struct bpf_program *filter, u16_t snaplen)
+{
+  u32_t skip = (4 - ((mem_ptr_t)buf & 3)) & 3;
+  u32_t need = (snaplen != 0) ? BPF_RING_REC(snaplen) : (u32_t)BPF_RING_REF_SIZE;
+
+  if ((filter != NULL) && (bpf_validate(filter) != ERR_OK)) {
+    return ERR_VAL;
+  }
+  if ((size < skip) || (((size - skip) & ~(u32_t)3) < need)) {
+    return ERR_VAL;
+  }
+  memset(r, 0, sizeof(struct bpf_ring));
+  r->filter = filter;
+  r->buf = (u8_t *)buf + skip;
+  r->size = (size - skip) & ~(u32_t)3;
+  r->snaplen = snaplen;
+  return ERR_OK;
+}
+
+/** Bytes a record takes in the ring */
+static u32_t
+bpf_ring_recsize(const struct bpf_ring_hdr *hdr)
+{
+  if (hdr->flags & BPF_RING_REF) {
+    return (u32_t)BPF_RING_REF_SIZE;
+  }
+  return BPF_RING_REC(hdr->caplen);
+}
+
+/** Take the oldest record off the ring, releasing its pbuf */
+static void
+bpf_ring_pop(struct bpf_ring *r)
+{
+  struct bpf_ring_hdr *hdr = BPF_RING_AT(r, r->tail);
+  struct bpf_ring_ref ref;
+
+  if (hdr->flags & BPF_RING_REF) {
+    MEMCPY(&ref, hdr + 1, sizeof(ref));
+    pbuf_free(ref.p);
+  }
+  r->tail += bpf_ring_recsize(hdr);
+  r->count--;
+  if (r->count != 0) {
+    /* the next record is at the start if the rest is too short for one
+       or the writer left a wrap mark (len 0) */
+    if ((r->size - r->tail < BPF_RING_HDR) || (BPF_RING_AT(r, r->tail)->len == 0)) {
+      r->tail = 0;
+    }
+  }
+}
+
+/**
+ * Run the ring's filter over a packet and store it (the first bytes of
+ * it, or a reference to it) with a timestamp, overwriting the oldest
+ * records if needed.
+ *
+ * @param r the ring
+ * @param p the packet, it is not changed
+ * @param flags BPF_RING_IN or BPF_RING_OUT
+ */
+void
+bpf_ring_add(struct bpf_ring *r, struct pbuf *p, u32_t flags)
+{
+  struct bpf_ring_hdr *hdr;
+  struct bpf_ring_ref ref;
+  u32_t caplen, keep, need, space;
+
+  caplen = (r->snaplen != 0) ? r->snaplen : p->tot_len;
+  if (r->filter != NULL) {
+    keep = bpf_filter(r->filter, p);
+    if (keep == 0) {
+      r->rejected++;
+      return;
+    }
+    if (keep < caplen) {
+      caplen = keep;
+    }
+  }
+  if (caplen > p->tot_len) {
+    caplen = p->tot_len;
+  }
+  if (caplen == 0) {
+    /* an empty record would look like a wrap mark */
+    r->rejected++;
+    return;
+  }
+  flags &= ~BPF_RING_REF;
+  if (r->snaplen == 0) {
+    flags |= BPF_RING_REF;
+    need = (u32_t)BPF_RING_REF_SIZE;
+  } else {
+    need = BPF_RING_REC(caplen);
+  }
+
+  for (;;) {
+    if (r->count == 0) {
+      r->head = r->tail = 0;
+      break;
+    }
+    if (r->head > r->tail) {
+      /* free: from head to the end, then from the start to tail */
+      space = r->size - r->head;
+      if (space >= need) {
+        break;
+      }
+      if (space >= BPF_RING_HDR) {
+        BPF_RING_AT(r, r->head)->len = 0;
+      }
+      r->head = 0;
+    }
+    /* free: from head to tail (nothing if the ring is full) */
+    if ((r->head < r->tail) && (r->tail - r->head >= need)) {
+      break;
+    }
+    bpf_ring_pop(r);
+    r->overwritten++;
+  }
+
+  hdr = BPF_RING_AT(r, r->head);
+  hdr->time = sys_now();
+  hdr->len = p->tot_len;
+  hdr->caplen = (u16_t)caplen;
+  hdr->flags = flags;
+  if (flags & BPF_RING_REF) {
+    pbuf_ref(p);
+    ref.p = p;
+    ref.payload = (const u8_t *)p->payload;
+    MEMCPY(hdr + 1, &ref, sizeof(ref));
+  } else {
+    pbuf_copy_partial(p, hdr + 1, (u16_t)caplen, 0);
+  }
+  r->head += need;
+  r->count++;
+  r->captured++;
+}
+
+/**
+ * Copy up to 'len' bytes of a referenced packet.
+ *
+ * @return how many of its first 'caplen' bytes are still in the pbuf
+ *         (a pbuf_realloc() may have cut some off since)
+ */
+static u16_t
+bpf_ring_ref_copy(const struct bpf_ring_ref *ref, u16_t caplen, u8_t *data, u16_t len)
+{
+  struct pbuf *q = ref->p;
+  const u8_t *src = ref->payload;
+  const u8_t *end = (const u8_t *)q->payload + q->len;
+  u16_t n, got = 0;
+
+  for (;;) {
+    n = (end > src) ? (u16_t)(end - src) : 0;
+    if (n > caplen - got) {
+      n = caplen - got;
+    }
+    if (got < len) {
+      MEMCPY(data + got, src, LWIP_MIN(n, len - got));
+    }
+    got += n;
+    q = q->next;
+    if ((q == NULL) || (got == caplen)) {
+      return got;
+    }
+    src = (const u8_t *)q->payload;
+    end = src + q->len;
+  }
+}
+
+/**
+ * Take the oldest record out of the ring.
+ *
+ * @param r the ring
+ * @param hdr receives the record's header, caplen is the number of bytes
+ *        the record holds (data gets at most len of them)
+ * @param data receives the captured bytes
+ * @param len size of data
+ * @return ERR_OK, or ERR_BUF if the ring is empty
+ */
+err_t
+bpf_ring_read(struct bpf_ring *r, struct bpf_ring_hdr *hdr, void *data, u16_t len)
+{
+  struct bpf_ring_hdr *rec;
+  struct bpf_ring_ref ref;
+
+  if (r->count == 0) {
+    return ERR_BUF;
+  }
+  rec = BPF_RING_AT(r, r->tail);
+  *hdr = *rec;
+  hdr->flags &= ~BPF_RING_REF;
+  if (rec->flags & BPF_RING_REF) {
+    MEMCPY(&ref, rec + 1, sizeof(ref));
+    hdr->caplen = bpf_ring_ref_copy(&ref, rec->caplen, (u8_t *)data, len);
+  } else {
+    MEMCPY(data, rec + 1, LWIP_MIN(len, rec->caplen));
+  }
+  bpf_ring_pop(r);
+  return ERR_OK;
+}
+
+/**
+ * Drop all records, releasing the pbufs a ring with snaplen 0 holds.
+ *
+ * @param r the ring
+ */
+void
+bpf_ring_flush(struct bpf_ring *r)
+{
+  while (r->count != 0) {
+    bpf_ring_pop(r);
+  }
+}
+
+#endif /* LWIP_BPF */
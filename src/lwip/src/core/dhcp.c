@@ -121,7 +121,8 @@
 #define DHCP_OPTION_IDX_T2          5
 #define DHCP_OPTION_IDX_SUBNET_MASK 6
 #define DHCP_OPTION_IDX_ROUTER      7
-#define DHCP_OPTION_IDX_DNS_SERVER  8
+#define DHCP_OPTION_IDX_RAPID_COMMIT 8
+#define DHCP_OPTION_IDX_DNS_SERVER  9
 #define DHCP_OPTION_IDX_MAX         (DHCP_OPTION_IDX_DNS_SERVER + DNS_MAX_SERVERS)
 
 /** Holds the decoded option values, only valid while in dhcp_recv.
@@ -132,6 +133,12 @@ u32_t dhcp_rx_options_val[DHCP_OPTION_IDX_MAX];
     @todo: move this into struct dhcp? */
 u8_t  dhcp_rx_options_given[DHCP_OPTION_IDX_MAX];
 
+#if LWIP_DHCP_LEASE_STORE
+/** application callbacks to keep the lease across reboots */
+static dhcp_lease_load_fn dhcp_lease_load;
+static dhcp_lease_save_fn dhcp_lease_save;
+#endif /* LWIP_DHCP_LEASE_STORE */
+
 #ifdef DHCP_GLOBAL_XID
 static u32_t xid;
 static u8_t xid_initialised;
@@ -144,6 +151,58 @@ static u8_t xid_initialised;
 #define dhcp_get_option_value(dhcp, idx)      (dhcp_rx_options_val[idx])
 #define dhcp_set_option_value(dhcp, idx, val) (dhcp_rx_options_val[idx] = (val))
 
+/** Malformed options come from the network: drop the message without
+ * asserting (LWIP_ERROR would) */
+#define DHCP_INPUT_ERROR(message, expression, handler) do { if (!(expression)) { \
+  LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_LEVEL_WARNING, ("dhcp_parse_options: " message "\n")); \
+  handler;}} while(0)
+
+/** Describes how dhcp_parse_reply() decodes an option into dhcp_rx_options_val */
+struct dhcp_option_desc {
+  /** option code */
+  u8_t code;
+  /** DHCP_OPTION_IDX_* of the (first) value */
+  u8_t idx;
+  /** accepted option length */
+  u8_t min_len;
+  u8_t max_len;
+  /** length of one value: 0 (flag only), 1 or 4 (network order u32_t) */
+  u8_t val_len;
+  /** maximum number of values decoded (to consecutive indices) */
+  u8_t max_vals;
+};
+
+/** Options decoded by the client, all other options are skipped (or passed
+ * to the application, see dhcp_set_option_callback()) */
+static const struct dhcp_option_desc dhcp_option_descs[] = {
+  /* code                       idx                            min max  val  vals */
+  {DHCP_OPTION_MESSAGE_TYPE,  DHCP_OPTION_IDX_MSG_TYPE,       1,   1,  1, 1},
+  {DHCP_OPTION_SERVER_ID,     DHCP_OPTION_IDX_SERVER_ID,      4,   4,  4, 1},
+  {DHCP_OPTION_LEASE_TIME,    DHCP_OPTION_IDX_LEASE_TIME,     4,   4,  4, 1},
+  {DHCP_OPTION_T1,            DHCP_OPTION_IDX_T1,             4,   4,  4, 1},
+  {DHCP_OPTION_T2,            DHCP_OPTION_IDX_T2,             4,   4,  4, 1},
+  {DHCP_OPTION_SUBNET_MASK,   DHCP_OPTION_IDX_SUBNET_MASK,    4,   4,  4, 1},
+  /* only the first given router is used */
+  {DHCP_OPTION_ROUTER,        DHCP_OPTION_IDX_ROUTER,         4, 255,  4, 1},
+  {DHCP_OPTION_DNS_SERVER,    DHCP_OPTION_IDX_DNS_SERVER,     4, 252,  4, DNS_MAX_SERVERS},
+  {DHCP_OPTION_OVERLOAD,      DHCP_OPTION_IDX_OVERLOAD,       1,   1,  1, 1},
+  {DHCP_OPTION_RAPID_COMMIT,  DHCP_OPTION_IDX_RAPID_COMMIT,   0,   0,  0, 1}
+};
+#define DHCP_OPTION_DESCS_NUM (sizeof(dhcp_option_descs) / sizeof(dhcp_option_descs[0]))
+
+/** Options requested from the server in DISCOVER, REQUEST and INFORM */
+static const u8_t dhcp_request_options[] = {
+  DHCP_OPTION_SUBNET_MASK,
+  DHCP_OPTION_ROUTER,
+  DHCP_OPTION_BROADCAST,
+  DHCP_OPTION_DNS_SERVER
+};
+
+#if LWIP_DHCP_OPTION_CALLBACK
+/** application callback for options not decoded by the client */
+static dhcp_option_fn dhcp_option_callback;
+#endif /* LWIP_DHCP_OPTION_CALLBACK */
+
 
 /* DHCP client state machine functions */
 static err_t dhcp_discover(struct netif *netif);
@@ -175,6 +234,8 @@ static void dhcp_option(struct dhcp *dhcp, u8_t option_type, u8_t option_len);
 static void dhcp_option_byte(struct dhcp *dhcp, u8_t value);
 static void dhcp_option_short(struct dhcp *dhcp, u16_t value);
 static void dhcp_option_long(struct dhcp *dhcp, u32_t value);
+static void dhcp_option_bytes(struct dhcp *dhcp, const u8_t *data, u8_t len);
+static void dhcp_option_request_list(struct dhcp *dhcp);
 #if LWIP_NETIF_HOSTNAME
 static void dhcp_option_hostname(struct dhcp *dhcp, struct netif *netif);
 #endif /* LWIP_NETIF_HOSTNAME */
@@ -205,6 +266,12 @@ dhcp_handle_nak(struct netif *netif)
   netif_set_ipaddr(netif, IP_ADDR_ANY);
   netif_set_gw(netif, IP_ADDR_ANY);
   netif_set_netmask(netif, IP_ADDR_ANY); 
+#if LWIP_DHCP_LEASE_STORE
+  /* the stored lease is no longer valid */
+  if (dhcp_lease_save != NULL) {
+    dhcp_lease_save(netif, NULL);
+  }
+#endif /* LWIP_DHCP_LEASE_STORE */
   /* Change to a defined state */
   dhcp_set_state(dhcp, DHCP_BACKING_OFF);
   /* We can immediately restart discovery */
@@ -302,11 +369,7 @@ dhcp_select(struct netif *netif)
     dhcp_option(dhcp, DHCP_OPTION_SERVER_ID, 4);
     dhcp_option_long(dhcp, ntohl(ip4_addr_get_u32(&dhcp->server_ip_addr)));
 
-    dhcp_option(dhcp, DHCP_OPTION_PARAMETER_REQUEST_LIST, 4/*num options*/);
-    dhcp_option_byte(dhcp, DHCP_OPTION_SUBNET_MASK);
-    dhcp_option_byte(dhcp, DHCP_OPTION_ROUTER);
-    dhcp_option_byte(dhcp, DHCP_OPTION_BROADCAST);
-    dhcp_option_byte(dhcp, DHCP_OPTION_DNS_SERVER);
+    dhcp_option_request_list(dhcp);
 
 #if LWIP_NETIF_HOSTNAME
     dhcp_option_hostname(dhcp, netif);
@@ -542,6 +605,11 @@ dhcp_handle_ack(struct netif *netif)
     dhcp->offered_t2_rebind = dhcp->offered_t0_lease;
   }
 
+  /* server identifier given? (needed after INIT-REBOOT or rapid commit) */
+  if (dhcp_option_given(dhcp, DHCP_OPTION_IDX_SERVER_ID)) {
+    ip4_addr_set_u32(&dhcp->server_ip_addr, htonl(dhcp_get_option_value(dhcp, DHCP_OPTION_IDX_SERVER_ID)));
+  }
+
   /* (y)our internet address */
   ip_addr_copy(dhcp->offered_ip_addr, dhcp->msg_in->yiaddr);
 
@@ -568,7 +636,7 @@ dhcp_handle_ack(struct netif *netif)
 #if LWIP_DNS
   /* DNS servers */
   n = 0;
-  while(dhcp_option_given(dhcp, DHCP_OPTION_IDX_DNS_SERVER + n) && (n < DNS_MAX_SERVERS)) {
+  while((n < DNS_MAX_SERVERS) && dhcp_option_given(dhcp, DHCP_OPTION_IDX_DNS_SERVER + n)) {
     ip_addr_t dns_addr;
     ip4_addr_set_u32(&dns_addr, htonl(dhcp_get_option_value(dhcp, DHCP_OPTION_IDX_DNS_SERVER + n)));
     dns_setserver(n, &dns_addr);
@@ -577,6 +645,62 @@ dhcp_handle_ack(struct netif *netif)
 #endif /* LWIP_DNS */
 }
 
+#if LWIP_DHCP_LEASE_STORE
+/**
+ * Set the callbacks used to keep the DHCP lease across reboots (e.g. in
+ * flash or battery backed RAM). The lease is saved when a new lease is bound
+ * and invalidated when it is released or refused by the server.
+ *
+ * @param load function to load a stored lease, NULL to disable INIT-REBOOT
+ * @param save function to store or invalidate a lease, NULL to disable
+ */
+void
+dhcp_set_lease_store(dhcp_lease_load_fn load, dhcp_lease_save_fn save)
+{
+  dhcp_lease_load = load;
+  dhcp_lease_save = save;
+}
+
+/**
+ * Load the stored lease of a netif to verify it with INIT-REBOOT.
+ *
+ * @param netif the netif under DHCP control
+ * @return 1 if a valid lease was loaded, 0 otherwise
+ */
+static u8_t
+dhcp_load_lease(struct netif *netif)
+{
+  struct dhcp *dhcp = netif->dhcp;
+  struct dhcp_lease lease;
+
+  if ((dhcp_lease_load == NULL) || (dhcp_lease_load(netif, &lease) != ERR_OK) ||
+      ip_addr_isany(&lease.ipaddr)) {
+    return 0;
+  }
+  LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_STATE, ("dhcp_load_lease(): stored lease for 0x%08"X32_F"\n",
+    ip4_addr_get_u32(&lease.ipaddr)));
+  ip_addr_copy(dhcp->offered_ip_addr, lease.ipaddr);
+  ip_addr_copy(dhcp->server_ip_addr, lease.server_ip_addr);
+  dhcp->offered_t0_lease = lease.lease_time;
+  return 1;
+}
+#endif /* LWIP_DHCP_LEASE_STORE */
+
+#if LWIP_DHCP_OPTION_CALLBACK
+/**
+ * Set the callback receiving the options of DHCP replies that the client does
+ * not decode itself, e.g. vendor specific information (43) or site specific
+ * options (224..254).
+ *
+ * @param fn the callback, NULL to disable
+ */
+void
+dhcp_set_option_callback(dhcp_option_fn fn)
+{
+  dhcp_option_callback = fn;
+}
+#endif /* LWIP_DHCP_OPTION_CALLBACK */
+
 /** Set a statically allocated struct dhcp to work with.
  * Using this prevents dhcp_start to allocate it using mem_malloc.
  *
@@ -687,8 +811,16 @@ dhcp_start(struct netif *netif)
   /* set up the recv callback and argument */
   udp_recv(dhcp->pcb, dhcp_recv, netif);
   LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("dhcp_start(): starting DHCP configuration\n"));
-  /* (re)start the DHCP negotiation */
-  result = dhcp_discover(netif);
+#if LWIP_DHCP_LEASE_STORE
+  if (dhcp_load_lease(netif)) {
+    /* verify the stored lease (INIT-REBOOT) */
+    result = dhcp_reboot(netif);
+  } else
+#endif /* LWIP_DHCP_LEASE_STORE */
+  {
+    /* (re)start the DHCP negotiation */
+    result = dhcp_discover(netif);
+  }
   if (result != ERR_OK) {
     /* free resources allocated above */
     dhcp_stop(netif);
@@ -788,6 +920,13 @@ dhcp_network_changed(struct netif *netif)
       dhcp->autoip_coop_state = DHCP_AUTOIP_COOP_STATE_OFF;
     }
 #endif /* LWIP_DHCP_AUTOIP_COOP */
+#if LWIP_DHCP_LEASE_STORE
+    if (dhcp_load_lease(netif)) {
+      /* verify the stored lease (INIT-REBOOT) */
+      dhcp_reboot(netif);
+      break;
+    }
+#endif /* LWIP_DHCP_LEASE_STORE */
     dhcp_discover(netif);
     break;
   }
@@ -885,11 +1024,12 @@ dhcp_discover(struct netif *netif)
     dhcp_option(dhcp, DHCP_OPTION_MAX_MSG_SIZE, DHCP_OPTION_MAX_MSG_SIZE_LEN);
     dhcp_option_short(dhcp, DHCP_MAX_MSG_LEN(netif));
 
-    dhcp_option(dhcp, DHCP_OPTION_PARAMETER_REQUEST_LIST, 4/*num options*/);
-    dhcp_option_byte(dhcp, DHCP_OPTION_SUBNET_MASK);
-    dhcp_option_byte(dhcp, DHCP_OPTION_ROUTER);
-    dhcp_option_byte(dhcp, DHCP_OPTION_BROADCAST);
-    dhcp_option_byte(dhcp, DHCP_OPTION_DNS_SERVER);
+    dhcp_option_request_list(dhcp);
+
+#if LWIP_DHCP_RAPID_COMMIT
+    /* accept an ACK right away */
+    dhcp_option(dhcp, DHCP_OPTION_RAPID_COMMIT, 0);
+#endif /* LWIP_DHCP_RAPID_COMMIT */
 
     dhcp_option_trailer(dhcp);
 
@@ -1009,6 +1149,17 @@ dhcp_bind(struct netif *netif)
   netif_set_gw(netif, &gw_addr);
   /* bring the interface up */
   netif_set_up(netif);
+#if LWIP_DHCP_LEASE_STORE
+  /* store a new lease (renewing or rebinding keeps the address) */
+  if ((dhcp_lease_save != NULL) &&
+      (dhcp->state != DHCP_RENEWING) && (dhcp->state != DHCP_REBINDING)) {
+    struct dhcp_lease lease;
+    ip_addr_copy(lease.ipaddr, dhcp->offered_ip_addr);
+    ip_addr_copy(lease.server_ip_addr, dhcp->server_ip_addr);
+    lease.lease_time = dhcp->offered_t0_lease;
+    dhcp_lease_save(netif, &lease);
+  }
+#endif /* LWIP_DHCP_LEASE_STORE */
   /* netif is now bound to DHCP leased address */
   dhcp_set_state(dhcp, DHCP_BOUND);
 }
@@ -1174,6 +1325,12 @@ dhcp_release(struct netif *netif)
 
   /* idle DHCP client */
   dhcp_set_state(dhcp, DHCP_OFF);
+#if LWIP_DHCP_LEASE_STORE
+  /* the stored lease is no longer valid */
+  if (dhcp_lease_save != NULL) {
+    dhcp_lease_save(netif, NULL);
+  }
+#endif /* LWIP_DHCP_LEASE_STORE */
   /* clean old DHCP offer */
   ip_addr_set_zero(&dhcp->server_ip_addr);
   ip_addr_set_zero(&dhcp->offered_ip_addr);
@@ -1293,11 +1450,30 @@ dhcp_option_short(struct dhcp *dhcp, u16_t value)
 static void
 dhcp_option_long(struct dhcp *dhcp, u32_t value)
 {
+  u8_t *out = &dhcp->msg_out->options[dhcp->options_out_len];
   LWIP_ASSERT("dhcp_option_long: dhcp->options_out_len + 4 <= DHCP_OPTIONS_LEN", dhcp->options_out_len + 4U <= DHCP_OPTIONS_LEN);
-  dhcp->msg_out->options[dhcp->options_out_len++] = (u8_t)((value & 0xff000000UL) >> 24);
-  dhcp->msg_out->options[dhcp->options_out_len++] = (u8_t)((value & 0x00ff0000UL) >> 16);
-  dhcp->msg_out->options[dhcp->options_out_len++] = (u8_t)((value & 0x0000ff00UL) >> 8);
-  dhcp->msg_out->options[dhcp->options_out_len++] = (u8_t)((value & 0x000000ffUL));
+  out[0] = (u8_t)((value & 0xff000000UL) >> 24);
+  out[1] = (u8_t)((value & 0x00ff0000UL) >> 16);
+  out[2] = (u8_t)((value & 0x0000ff00UL) >> 8);
+  out[3] = (u8_t)((value & 0x000000ffUL));
+  dhcp->options_out_len += 4;
+}
+
+/** Append 'len' option value bytes at once */
+static void
+dhcp_option_bytes(struct dhcp *dhcp, const u8_t *data, u8_t len)
+{
+  LWIP_ASSERT("dhcp_option_bytes: dhcp->options_out_len + len <= DHCP_OPTIONS_LEN", dhcp->options_out_len + (u16_t)len <= DHCP_OPTIONS_LEN);
+  MEMCPY(&dhcp->msg_out->options[dhcp->options_out_len], data, len);
+  dhcp->options_out_len += len;
+}
+
+/** Append the parameter request list (dhcp_request_options) */
+static void
+dhcp_option_request_list(struct dhcp *dhcp)
+{
+  dhcp_option(dhcp, DHCP_OPTION_PARAMETER_REQUEST_LIST, (u8_t)sizeof(dhcp_request_options));
+  dhcp_option_bytes(dhcp, dhcp_request_options, (u8_t)sizeof(dhcp_request_options));
 }
 
 #if LWIP_NETIF_HOSTNAME
@@ -1308,42 +1484,182 @@ dhcp_option_hostname(struct dhcp *dhcp, struct netif *netif)
     size_t namelen = strlen(netif->hostname);
     if (namelen > 0) {
       u8_t len;
-      const char *p = netif->hostname;
       /* Shrink len to available bytes (need 2 bytes for OPTION_HOSTNAME
          and 1 byte for trailer) */
       size_t available = DHCP_OPTIONS_LEN - dhcp->options_out_len - 3;
       LWIP_ASSERT("DHCP: hostname is too long!", namelen <= available);
       len = LWIP_MIN(namelen, available);
       dhcp_option(dhcp, DHCP_OPTION_HOSTNAME, len);
-      while (len--) {
-        dhcp_option_byte(dhcp, *p++);
-      }
+      dhcp_option_bytes(dhcp, (const u8_t *)netif->hostname, len);
     }
   }
 }
 #endif /* LWIP_NETIF_HOSTNAME */
 
+/** Read position in the options of a received message, which may span a
+ * pbuf chain: options are decoded in place, without copying the message */
+struct dhcp_option_cursor {
+  /** pbuf holding the next byte */
+  struct pbuf *q;
+  /** offset of the next byte in q */
+  u16_t ofs;
+  /** bytes left in the options field being parsed */
+  u16_t left;
+};
+
+/**
+ * Set an option cursor to 'len' bytes at offset 'start' of a message.
+ *
+ * @return ERR_OK or ERR_BUF if the message is shorter than that
+ */
+static err_t
+dhcp_option_cursor_init(struct dhcp_option_cursor *cur, struct pbuf *p, u16_t start, u16_t len)
+{
+  if (p->tot_len < start) {
+    return ERR_BUF;
+  }
+  cur->q = p;
+  cur->ofs = start;
+  cur->left = LWIP_MIN(len, (u16_t)(p->tot_len - start));
+  while ((cur->q != NULL) && (cur->ofs >= cur->q->len)) {
+    cur->ofs -= cur->q->len;
+    cur->q = cur->q->next;
+  }
+  if ((cur->q == NULL) && (cur->left > 0)) {
+    return ERR_BUF;
+  }
+  return ERR_OK;
+}
+
+/** Read the next byte, the caller checks cur->left */
+static u8_t
+dhcp_option_cursor_byte(struct dhcp_option_cursor *cur)
+{
+  u8_t b = ((u8_t*)cur->q->payload)[cur->ofs++];
+  cur->left--;
+  /* step to the next pbuf now: the cursor always points to a valid byte */
+  while ((cur->ofs >= cur->q->len) && (cur->q->next != NULL)) {
+    cur->ofs -= cur->q->len;
+    cur->q = cur->q->next;
+  }
+  return b;
+}
+
+/** Skip 'len' bytes, the caller checks cur->left */
+static void
+dhcp_option_cursor_skip(struct dhcp_option_cursor *cur, u16_t len)
+{
+  cur->left -= len;
+  cur->ofs += len;
+  while ((cur->ofs >= cur->q->len) && (cur->q->next != NULL)) {
+    cur->ofs -= cur->q->len;
+    cur->q = cur->q->next;
+  }
+}
+
+/** Find the descriptor of an option decoded by the client */
+static const struct dhcp_option_desc *
+dhcp_option_find(u8_t code)
+{
+  u8_t i;
+  for (i = 0; i < DHCP_OPTION_DESCS_NUM; i++) {
+    if (dhcp_option_descs[i].code == code) {
+      return &dhcp_option_descs[i];
+    }
+  }
+  return NULL;
+}
+
 /**
- * Extract the DHCP message and the DHCP options.
+ * Decode the options in one field of a received message (the options field
+ * or an overloaded sname/file field) in a single pass.
  *
- * Extract the DHCP message and the DHCP options, each into a contiguous
- * piece of memory. As a DHCP message is variable sized by its options,
- * and also allows overriding some fields for options, the easy approach
- * is to first unfold the options into a conitguous piece of memory, and
- * use that further on.
+ * Options described in dhcp_option_descs are stored in dhcp_rx_options_val
+ * (only the first occurrence counts), all others are skipped or passed to the
+ * application.
  *
+ * @return ERR_OK, ERR_VAL for a malformed option or ERR_BUF if an option
+ *         exceeds the field
  */
 static err_t
-dhcp_parse_reply(struct dhcp *dhcp, struct pbuf *p)
+dhcp_parse_options(struct netif *netif, struct pbuf *p, u16_t start, u16_t len)
 {
-  u8_t *options;
-  u16_t offset;
-  u16_t offset_max;
-  u16_t options_idx;
-  u16_t options_idx_max;
-  struct pbuf *q;
-  int parse_file_as_options = 0;
-  int parse_sname_as_options = 0;
+  struct dhcp_option_cursor cur;
+  const struct dhcp_option_desc *desc;
+  u8_t code, optlen, n, i;
+  u32_t value;
+
+  LWIP_UNUSED_ARG(netif);
+  if (dhcp_option_cursor_init(&cur, p, start, len) != ERR_OK) {
+    return ERR_BUF;
+  }
+  while (cur.left > 0) {
+    code = dhcp_option_cursor_byte(&cur);
+    if (code == DHCP_OPTION_END) {
+      break;
+    }
+    if (code == DHCP_OPTION_PAD) {
+      /* special option: no len encoded */
+      continue;
+    }
+    DHCP_INPUT_ERROR("option length missing", cur.left > 0, return ERR_BUF;);
+    optlen = dhcp_option_cursor_byte(&cur);
+    DHCP_INPUT_ERROR("option exceeds message", optlen <= cur.left, return ERR_BUF;);
+
+    desc = dhcp_option_find(code);
+    if (desc != NULL) {
+      DHCP_INPUT_ERROR("invalid option length", (optlen >= desc->min_len) && (optlen <= desc->max_len) &&
+        ((desc->max_vals == 1) || (optlen % desc->val_len == 0)), return ERR_VAL;);
+      if (desc->val_len == 0) {
+        n = 1;
+      } else {
+        n = (u8_t)LWIP_MIN(optlen / desc->val_len, desc->max_vals);
+      }
+      for (i = 0; i < n; i++) {
+        LWIP_ASSERT("check decode_idx", desc->idx + i < DHCP_OPTION_IDX_MAX);
+        if (desc->val_len == 0) {
+          value = 1;
+        } else if (desc->val_len == 1) {
+          value = dhcp_option_cursor_byte(&cur);
+        } else {
+          value = (u32_t)dhcp_option_cursor_byte(&cur) << 24;
+          value |= (u32_t)dhcp_option_cursor_byte(&cur) << 16;
+          value |= (u32_t)dhcp_option_cursor_byte(&cur) << 8;
+          value |= dhcp_option_cursor_byte(&cur);
+        }
+        if (!dhcp_option_given(dhcp, desc->idx + i)) {
+          dhcp_got_option(dhcp, desc->idx + i);
+          dhcp_set_option_value(dhcp, desc->idx + i, value);
+        }
+      }
+      optlen = (u8_t)(optlen - n * desc->val_len);
+    } else {
+      LWIP_DEBUGF(DHCP_DEBUG, ("skipping option %"U16_F" in options\n", (u16_t)code));
+#if LWIP_DHCP_OPTION_CALLBACK
+      if (dhcp_option_callback != NULL) {
+        dhcp_option_callback(netif, code, optlen, cur.q, cur.ofs);
+      }
+#endif /* LWIP_DHCP_OPTION_CALLBACK */
+    }
+    dhcp_option_cursor_skip(&cur, optlen);
+  }
+  return ERR_OK;
+}
+
+/**
+ * Extract the DHCP options of a received message into dhcp_rx_options_val.
+ * The options field is parsed first, then (if overloaded) the file and the
+ * sname field (RFC 2131 ch. 4.1).
+ *
+ * @param netif the netif the message was received on
+ * @param p the message, the fixed part up to and including chaddr must be
+ *          in the first pbuf
+ */
+static err_t
+dhcp_parse_reply(struct netif *netif, struct pbuf *p)
+{
+  struct dhcp *dhcp = netif->dhcp;
+  err_t err;
 
   /* clear received options */
   dhcp_clear_all_options(dhcp);
@@ -1357,138 +1673,16 @@ dhcp_parse_reply(struct dhcp *dhcp, struct pbuf *p)
   dhcp->boot_file_name[0] = 0;
 #endif /* LWIP_DHCP_BOOTP_FILE */
 
-  /* parse options */
-
-  /* start with options field */
-  options_idx = DHCP_OPTIONS_OFS;
   /* parse options to the end of the received packet */
-  options_idx_max = p->tot_len;
-again:
-  q = p;
-  while((q != NULL) && (options_idx >= q->len)) {
-    options_idx -= q->len;
-    options_idx_max -= q->len;
-    q = q->next;
-  }
-  if (q == NULL) {
-    return ERR_BUF;
-  }
-  offset = options_idx;
-  offset_max = options_idx_max;
-  options = (u8_t*)q->payload;
-  /* at least 1 byte to read and no end marker, then at least 3 bytes to read? */
-  while((q != NULL) && (options[offset] != DHCP_OPTION_END) && (offset < offset_max)) {
-    u8_t op = options[offset];
-    u8_t len;
-    u8_t decode_len = 0;
-    int decode_idx = -1;
-    u16_t val_offset = offset + 2;
-    /* len byte might be in the next pbuf */
-    if (offset + 1 < q->len) {
-      len = options[offset + 1];
-    } else {
-      len = (q->next != NULL ? ((u8_t*)q->next->payload)[0] : 0);
-    }
-    /* LWIP_DEBUGF(DHCP_DEBUG, ("msg_offset=%"U16_F", q->len=%"U16_F, msg_offset, q->len)); */
-    decode_len = len;
-    switch(op) {
-      /* case(DHCP_OPTION_END): handled above */
-      case(DHCP_OPTION_PAD):
-        /* special option: no len encoded */
-        decode_len = len = 0;
-        /* will be increased below */
-        offset--;
-        break;
-      case(DHCP_OPTION_SUBNET_MASK):
-        LWIP_ERROR("len == 4", len == 4, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_SUBNET_MASK;
-        break;
-      case(DHCP_OPTION_ROUTER):
-        decode_len = 4; /* only copy the first given router */
-        LWIP_ERROR("len >= decode_len", len >= decode_len, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_ROUTER;
-        break;
-      case(DHCP_OPTION_DNS_SERVER):
-        /* special case: there might be more than one server */
-        LWIP_ERROR("len % 4 == 0", len % 4 == 0, return ERR_VAL;);
-        /* limit number of DNS servers */
-        decode_len = LWIP_MIN(len, 4 * DNS_MAX_SERVERS);
-        LWIP_ERROR("len >= decode_len", len >= decode_len, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_DNS_SERVER;
-        break;
-      case(DHCP_OPTION_LEASE_TIME):
-        LWIP_ERROR("len == 4", len == 4, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_LEASE_TIME;
-        break;
-      case(DHCP_OPTION_OVERLOAD):
-        LWIP_ERROR("len == 1", len == 1, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_OVERLOAD;
-        break;
-      case(DHCP_OPTION_MESSAGE_TYPE):
-        LWIP_ERROR("len == 1", len == 1, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_MSG_TYPE;
-        break;
-      case(DHCP_OPTION_SERVER_ID):
-        LWIP_ERROR("len == 4", len == 4, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_SERVER_ID;
-        break;
-      case(DHCP_OPTION_T1):
-        LWIP_ERROR("len == 4", len == 4, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_T1;
-        break;
-      case(DHCP_OPTION_T2):
-        LWIP_ERROR("len == 4", len == 4, return ERR_VAL;);
-        decode_idx = DHCP_OPTION_IDX_T2;
-        break;
-      default:
-        decode_len = 0;
-        LWIP_DEBUGF(DHCP_DEBUG, ("skipping option %"U16_F" in options\n", op));
-        break;
-    }
-    offset += len + 2;
-    if (decode_len > 0) {
-      u32_t value = 0;
-      u16_t copy_len;
-decode_next:
-      LWIP_ASSERT("check decode_idx", decode_idx >= 0 && decode_idx < DHCP_OPTION_IDX_MAX);
-      if (!dhcp_option_given(dhcp, decode_idx)) {
-        copy_len = LWIP_MIN(decode_len, 4);
-        pbuf_copy_partial(q, &value, copy_len, val_offset);
-        if (decode_len > 4) {
-          /* decode more than one u32_t */
-          LWIP_ERROR("decode_len % 4 == 0", decode_len % 4 == 0, return ERR_VAL;);
-          dhcp_got_option(dhcp, decode_idx);
-          dhcp_set_option_value(dhcp, decode_idx, htonl(value));
-          decode_len -= 4;
-          val_offset += 4;
-          decode_idx++;
-          goto decode_next;
-        } else if (decode_len == 4) {
-          value = ntohl(value);
-        } else {
-          LWIP_ERROR("invalid decode_len", decode_len == 1, return ERR_VAL;);
-          value = ((u8_t*)&value)[0];
-        }
-        dhcp_got_option(dhcp, decode_idx);
-        dhcp_set_option_value(dhcp, decode_idx, value);
-      }
-    }
-    if (offset >= q->len) {
-      offset -= q->len;
-      offset_max -= q->len;
-      if ((offset < offset_max) && offset_max) {
-        q = q->next;
-        LWIP_ASSERT("next pbuf was null", q);
-        options = (u8_t*)q->payload;
-      } else {
-        // We've run out of bytes, probably no end marker. Don't proceed.
-        break;
-      }
-    }
+  err = dhcp_parse_options(netif, p, DHCP_OPTIONS_OFS, (u16_t)(p->tot_len - LWIP_MIN(p->tot_len, DHCP_OPTIONS_OFS)));
+  if (err != ERR_OK) {
+    return err;
   }
   /* is this an overloaded message? */
   if (dhcp_option_given(dhcp, DHCP_OPTION_IDX_OVERLOAD)) {
     u32_t overload = dhcp_get_option_value(dhcp, DHCP_OPTION_IDX_OVERLOAD);
+    u8_t parse_file_as_options = 0;
+    u8_t parse_sname_as_options = 0;
     dhcp_clear_option(dhcp, DHCP_OPTION_IDX_OVERLOAD);
     if (overload == DHCP_OVERLOAD_FILE) {
       parse_file_as_options = 1;
@@ -1514,20 +1708,18 @@ decode_next:
       dhcp->boot_file_name[DHCP_FILE_LEN-1] = 0;
     }
 #endif /* LWIP_DHCP_BOOTP_FILE */
+    /* if both are overloaded, parse file first and then sname */
+    if (parse_file_as_options) {
+      err = dhcp_parse_options(netif, p, DHCP_FILE_OFS, DHCP_FILE_LEN);
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    if (parse_sname_as_options) {
+      err = dhcp_parse_options(netif, p, DHCP_SNAME_OFS, DHCP_SNAME_LEN);
+    }
   }
-  if (parse_file_as_options) {
-    /* if both are overloaded, parse file first and then sname (RFC 2131 ch. 4.1) */
-    parse_file_as_options = 0;
-    options_idx = DHCP_FILE_OFS;
-    options_idx_max = DHCP_FILE_OFS + DHCP_FILE_LEN;
-    goto again;
-  } else if (parse_sname_as_options) {
-    parse_sname_as_options = 0;
-    options_idx = DHCP_SNAME_OFS;
-    options_idx_max = DHCP_SNAME_OFS + DHCP_SNAME_LEN;
-    goto again;
-  }
-  return ERR_OK;
+  return err;
 }
 
 /**
@@ -1577,7 +1769,7 @@ dhcp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     goto free_pbuf_and_return;
   }
   /* option fields could be unfold? */
-  if (dhcp_parse_reply(dhcp, p) != ERR_OK) {
+  if (dhcp_parse_reply(netif, p) != ERR_OK) {
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_LEVEL_SERIOUS,
       ("problem unfolding DHCP message - too short on memory?\n"));
     goto free_pbuf_and_return;
@@ -1595,8 +1787,14 @@ dhcp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
   /* message type is DHCP ACK? */
   if (msg_type == DHCP_ACK) {
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("DHCP_ACK received\n"));
-    /* in requesting state? */
-    if (dhcp->state == DHCP_REQUESTING) {
+    /* in requesting state, or a rapid commit ACK (RFC 4039) while selecting? */
+    if ((dhcp->state == DHCP_REQUESTING)
+#if LWIP_DHCP_RAPID_COMMIT
+        || ((dhcp->state == DHCP_SELECTING) &&
+            dhcp_option_given(dhcp, DHCP_OPTION_IDX_RAPID_COMMIT))
+#endif /* LWIP_DHCP_RAPID_COMMIT */
+       ) {
+      dhcp->request_timeout = 0;
       dhcp_handle_ack(netif);
 #if DHCP_DOES_ARP_CHECK
       /* check if the acknowledged lease address is already in use */
@@ -1608,6 +1806,8 @@ dhcp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     }
     /* already bound to the given lease address? */
     else if ((dhcp->state == DHCP_REBOOTING) || (dhcp->state == DHCP_REBINDING) || (dhcp->state == DHCP_RENEWING)) {
+      /* take over the (possibly changed) lease times and configuration */
+      dhcp_handle_ack(netif);
       dhcp_bind(netif);
     }
   }
@@ -80,6 +80,9 @@
 #include "lwip/mem.h"
 #include "lwip/memp.h"
 #include "lwip/dns.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+#include "lwip/timers.h"
 
 #include <string.h>
 
@@ -121,6 +124,18 @@
 #define DNS_STATE_NEW             1
 #define DNS_STATE_ASKING          2
 #define DNS_STATE_DONE            3
+#define DNS_STATE_NEGATIVE        4
+
+/* DNS table entry flags */
+/** a DONE entry is being refreshed ahead of its expiry */
+#define DNS_ENTRY_FLAG_PREFETCH   0x01
+/** the callbacks of requests waiting for the entry are being called */
+#define DNS_ENTRY_FLAG_CALLBACK   0x02
+/** the remaining servers still have to be queried (DNS_RACE_SERVERS) */
+#define DNS_ENTRY_FLAG_HEDGE      0x04
+
+/** smoothed RTT of a server that did not answer at all (ms) */
+#define DNS_SERVER_RTT_TIMEOUT    (DNS_MAX_RETRIES * DNS_TMR_INTERVAL)
 
 #ifdef PACK_STRUCT_USE_INCLUDES
 #  include "arch/bpstruct.h"
@@ -172,12 +187,34 @@ struct dns_table_entry {
   u8_t  retries;
   u8_t  seqno;
   u8_t  err;
+  u8_t  flags;
+  /* number of cache hits since the entry was (re-)resolved */
+  u8_t  hits;
+  /* index + 1 of the next entry in the same hash bucket, 0 for none */
+  u8_t  hnext;
   u32_t ttl;
+  /* hash of name, see dns_hash_name() */
+  u32_t hash;
+  /* bit n set: a query to dns_servers[n] has not been answered yet */
+  u8_t  asked;
+  /* sys_now() when the last query was sent to each server */
+  u32_t stime[DNS_MAX_SERVERS];
+#if DNS_STATS
+  /* sys_now() when the first query for this entry was sent */
+  u32_t qtime;
+#endif /* DNS_STATS */
   char name[DNS_MAX_NAME_LENGTH];
   ip_addr_t ipaddr;
-  /* pointer to callback on DNS query done */
+};
+
+/** A dns_gethostbyname() call waiting for its answer. Several requests can
+ * wait for the same dns_table entry. */
+struct dns_req_entry {
+  /* pointer to callback on DNS query done, NULL if this request is unused */
   dns_found_callback found;
   void *arg;
+  /* index of the dns_table entry this request waits for */
+  u8_t dns_table_idx;
 };
 
 #if DNS_LOCAL_HOSTLIST
@@ -219,7 +256,17 @@ static void dns_check_entries(void);
 static struct udp_pcb        *dns_pcb;
 static u8_t                   dns_seqno;
 static struct dns_table_entry dns_table[DNS_TABLE_SIZE];
+static struct dns_req_entry   dns_requests[DNS_MAX_REQUESTS];
+/** Hash buckets of dns_table: index + 1 of the first entry, 0 for none */
+static u8_t                   dns_hash_table[DNS_HASH_SIZE];
 static ip_addr_t              dns_servers[DNS_MAX_SERVERS];
+static struct dns_server_stats dns_server_stats[DNS_MAX_SERVERS];
+/** dns_servers indices, fastest server first */
+static u8_t                   dns_server_order[DNS_MAX_SERVERS];
+#if DNS_RACE_SERVERS && LWIP_TIMERS
+/** the hedge timer is scheduled */
+static u8_t                   dns_hedge_pending;
+#endif /* DNS_RACE_SERVERS && LWIP_TIMERS */
 /** Contiguous buffer for processing responses */
 static u8_t                   dns_payload_buffer[LWIP_MEM_ALIGN_BUFFER(DNS_MSG_SIZE)];
 static u8_t*                  dns_payload;
@@ -263,18 +310,110 @@ dns_init()
 #endif
 }
 
+/**
+ * Sort dns_server_order by smoothed RTT. Servers without any statistics yet
+ * come first (so that they are measured), unconfigured servers last.
+ */
+static void
+dns_server_sort(void)
+{
+  u8_t n, m, j;
+  u32_t key[DNS_MAX_SERVERS];
+  struct dns_server_stats *st;
+
+  for (j = 0; j < DNS_MAX_SERVERS; ++j) {
+    st = &dns_server_stats[j];
+    if (ip_addr_isany(&dns_servers[j])) {
+      key[j] = 0xffffffffUL;
+    } else if ((st->answers == 0) && (st->lost == 0) && (st->timeouts == 0)) {
+      key[j] = 0;
+    } else {
+      key[j] = st->srtt + 1;
+    }
+  }
+  /* insertion sort, stable: equal servers stay in configuration order */
+  for (n = 0; n < DNS_MAX_SERVERS; ++n) {
+    dns_server_order[n] = n;
+    for (m = n; (m > 0) && (key[dns_server_order[m - 1]] > key[n]); --m) {
+      dns_server_order[m] = dns_server_order[m - 1];
+    }
+    dns_server_order[m] = n;
+  }
+}
+
+/**
+ * Add a round trip time sample to the statistics of a server.
+ *
+ * @param numdns the index of the DNS server
+ * @param rtt round trip time in milliseconds
+ */
+static void
+dns_server_rtt(u8_t numdns, u32_t rtt)
+{
+  struct dns_server_stats *st = &dns_server_stats[numdns];
+
+  if ((st->answers == 0) && (st->lost == 0) && (st->timeouts == 0)) {
+    st->srtt = rtt;
+  } else {
+    /* srtt = 7/8 srtt + 1/8 rtt, as TCP does (RFC 6298) */
+    st->srtt = st->srtt - (st->srtt >> 3) + (rtt >> 3);
+  }
+}
+
+/**
+ * Update the statistics of the servers a query was sent to but that did not
+ * answer (yet) and forget about these queries.
+ *
+ * @param i index of the dns_table entry
+ * @param timeout 1 if the query timed out, 0 if another server answered first
+ * @param rtt round trip time of the answer (timeout == 0 only)
+ */
+static void
+dns_server_settle(u8_t i, u8_t timeout, u32_t rtt)
+{
+  u8_t j;
+  u32_t now = sys_now();
+  struct dns_server_stats *st;
+
+  for (j = 0; j < DNS_MAX_SERVERS; ++j) {
+    if ((dns_table[i].asked & (1 << j)) != 0) {
+      st = &dns_server_stats[j];
+      if (timeout) {
+        dns_server_rtt(j, DNS_SERVER_RTT_TIMEOUT);
+        if (st->timeouts < 0xffff) {
+          st->timeouts++;
+        }
+      } else {
+        /* this server is at least as slow as the one that answered */
+        dns_server_rtt(j, LWIP_MAX(now - dns_table[i].stime[j], rtt) + 1);
+        if (st->lost < 0xffff) {
+          st->lost++;
+        }
+      }
+    }
+  }
+  dns_table[i].asked = 0;
+  dns_server_sort();
+}
+
 /**
  * Initialize one of the DNS servers.
  *
  * @param numdns the index of the DNS server to set must be < DNS_MAX_SERVERS
- * @param dnsserver IP address of the DNS server to set
+ * @param dnsserver IP address of the DNS server to set, NULL or IP_ADDR_ANY
+ *        to remove the server
  */
 void
 dns_setserver(u8_t numdns, ip_addr_t *dnsserver)
 {
-  if ((numdns < DNS_MAX_SERVERS) && (dns_pcb != NULL) &&
-      (dnsserver != NULL) && !ip_addr_isany(dnsserver)) {
-    dns_servers[numdns] = (*dnsserver);
+  if ((numdns < DNS_MAX_SERVERS) && (dns_pcb != NULL)) {
+    if (dnsserver != NULL) {
+      dns_servers[numdns] = (*dnsserver);
+    } else {
+      dns_servers[numdns] = *IP_ADDR_ANY;
+    }
+    memset(&dns_server_stats[numdns], 0, sizeof(struct dns_server_stats));
+    dns_server_sort();
   }
 }
 
@@ -295,6 +434,21 @@ dns_getserver(u8_t numdns)
   }
 }
 
+/**
+ * Obtain the round trip statistics of one of the DNS servers.
+ *
+ * @param numdns the index of the DNS server
+ * @return statistics of the indexed DNS server or NULL if numdns is invalid
+ */
+const struct dns_server_stats *
+dns_getserver_stats(u8_t numdns)
+{
+  if (numdns < DNS_MAX_SERVERS) {
+    return &dns_server_stats[numdns];
+  }
+  return NULL;
+}
+
 /**
  * The DNS resolver client timer - handle retries and timeouts and should
  * be called every DNS_TMR_INTERVAL milliseconds (every second by default).
@@ -433,6 +587,142 @@ dns_local_addhost(const char *hostname, const ip_addr_t *addr)
 #endif /* DNS_LOCAL_HOSTLIST_IS_DYNAMIC*/
 #endif /* DNS_LOCAL_HOSTLIST */
 
+/**
+ * Calculate the hash of a hostname (32 bit FNV-1a).
+ *
+ * @param name the hostname
+ * @return hash of name
+ */
+static u32_t
+dns_hash_name(const char *name)
+{
+  u32_t hash = 2166136261UL;
+
+  while (*name != 0) {
+    hash = (hash ^ (u8_t)*name++) * 16777619UL;
+  }
+  return hash;
+}
+
+/**
+ * Find the dns_table entry of a hostname in its hash bucket.
+ *
+ * @param name the hostname to look up
+ * @param hash hash of name
+ * @return index of the entry (in any state) or DNS_TABLE_SIZE if not found
+ */
+static u8_t
+dns_find_entry(const char *name, u32_t hash)
+{
+  u8_t i;
+
+  for (i = dns_hash_table[hash % DNS_HASH_SIZE]; i != 0; i = dns_table[i - 1].hnext) {
+    if ((dns_table[i - 1].hash == hash) && (strcmp(name, dns_table[i - 1].name) == 0)) {
+      return i - 1;
+    }
+  }
+  return DNS_TABLE_SIZE;
+}
+
+/**
+ * Insert a dns_table entry into its hash bucket.
+ *
+ * @param i index of the entry, its hash must be set
+ */
+static void
+dns_hash_insert(u8_t i)
+{
+  u8_t *bucket = &dns_hash_table[dns_table[i].hash % DNS_HASH_SIZE];
+
+  dns_table[i].hnext = *bucket;
+  *bucket = i + 1;
+}
+
+/**
+ * Remove a dns_table entry from its hash bucket: it can't be found by name
+ * any more.
+ *
+ * @param i index of the entry
+ */
+static void
+dns_hash_remove(u8_t i)
+{
+  u8_t *link = &dns_hash_table[dns_table[i].hash % DNS_HASH_SIZE];
+
+  while (*link != 0) {
+    if (*link == i + 1) {
+      *link = dns_table[i].hnext;
+      return;
+    }
+    link = &dns_table[*link - 1].hnext;
+  }
+}
+
+/**
+ * Flush a dns_table entry.
+ *
+ * @param i index of the entry
+ */
+static void
+dns_free_entry(u8_t i)
+{
+  dns_hash_remove(i);
+  dns_table[i].state = DNS_STATE_UNUSED;
+  dns_table[i].flags = 0;
+  dns_table[i].asked = 0;
+}
+
+/**
+ * Call the callbacks of all requests waiting for a dns_table entry and free
+ * these requests.
+ *
+ * @param i index of the entry
+ * @param addr the resolved address or NULL if the name could not be resolved
+ */
+static void
+dns_call_found(u8_t i, ip_addr_t *addr)
+{
+  u8_t r;
+  dns_found_callback found;
+  void *arg;
+
+  /* callbacks may call dns_gethostbyname(), don't let them reuse this entry */
+  dns_table[i].flags |= DNS_ENTRY_FLAG_CALLBACK;
+  for (r = 0; r < DNS_MAX_REQUESTS; ++r) {
+    if ((dns_requests[r].found != NULL) && (dns_requests[r].dns_table_idx == i)) {
+      found = dns_requests[r].found;
+      arg = dns_requests[r].arg;
+      dns_requests[r].found = NULL;
+      (*found)(dns_table[i].name, addr, arg);
+    }
+  }
+  dns_table[i].flags &= ~DNS_ENTRY_FLAG_CALLBACK;
+}
+
+/**
+ * A hostname could not be resolved: inform all requests waiting for it and
+ * remember the failure for 'ttl' seconds (negative caching).
+ *
+ * @param i index of the dns_table entry
+ * @param ttl time in seconds to keep the failure, 0 to flush the entry
+ */
+static void
+dns_fail_entry(u8_t i, u32_t ttl)
+{
+  struct dns_table_entry *pEntry = &dns_table[i];
+
+  pEntry->flags = 0;
+  if (ttl > 0) {
+    pEntry->state = DNS_STATE_NEGATIVE;
+    pEntry->ttl   = ttl;
+    dns_call_found(i, NULL);
+  } else {
+    dns_hash_remove(i);
+    dns_call_found(i, NULL);
+    pEntry->state = DNS_STATE_UNUSED;
+  }
+}
+
 /**
  * Look up a hostname in the array of known hostnames.
  *
@@ -442,12 +732,13 @@ dns_local_addhost(const char *hostname, const ip_addr_t *addr)
  * for a hostname.
  *
  * @param name the hostname to look up
+ * @param hash hash of name
  * @return the hostname's IP address, as u32_t (instead of ip_addr_t to
  *         better check for failure: != IPADDR_NONE) or IPADDR_NONE if the hostname
  *         was not found in the cached dns_table.
  */
 static u32_t
-dns_lookup(const char *name)
+dns_lookup(const char *name, u32_t hash)
 {
   u8_t i;
 #if DNS_LOCAL_HOSTLIST || defined(DNS_LOOKUP_LOCAL_EXTERN)
@@ -464,15 +755,18 @@ dns_lookup(const char *name)
   }
 #endif /* DNS_LOOKUP_LOCAL_EXTERN */
 
-  /* Walk through name list, return entry if found. If not, return NULL. */
-  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
-    if ((dns_table[i].state == DNS_STATE_DONE) &&
-        (strcmp(name, dns_table[i].name) == 0)) {
-      LWIP_DEBUGF(DNS_DEBUG, ("dns_lookup: \"%s\": found = ", name));
-      ip_addr_debug_print(DNS_DEBUG, &(dns_table[i].ipaddr));
-      LWIP_DEBUGF(DNS_DEBUG, ("\n"));
-      return ip4_addr_get_u32(&dns_table[i].ipaddr);
+  i = dns_find_entry(name, hash);
+  if ((i < DNS_TABLE_SIZE) && (dns_table[i].state == DNS_STATE_DONE)) {
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_lookup: \"%s\": found = ", name));
+    ip_addr_debug_print(DNS_DEBUG, &(dns_table[i].ipaddr));
+    LWIP_DEBUGF(DNS_DEBUG, ("\n"));
+    if (dns_table[i].hits < 0xff) {
+      dns_table[i].hits++;
     }
+    /* keep hot entries from being reused for other names */
+    dns_table[i].seqno = dns_seqno++;
+    DNS_STATS_INC(dns.hit);
+    return ip4_addr_get_u32(&dns_table[i].ipaddr);
   }
 
   return IPADDR_NONE;
@@ -609,8 +903,12 @@ dns_send(u8_t numdns, const char* name, u8_t id)
     /* resize pbuf to the exact dns query */
     pbuf_realloc(p, (u16_t)((query + SIZEOF_DNS_QUERY) - ((char*)(p->payload))));
 
+#if !DNS_RACE_SERVERS
     /* connect to the server for faster receiving */
     udp_connect(dns_pcb, &dns_servers[numdns], DNS_SERVER_PORT);
+#endif /* !DNS_RACE_SERVERS */
+    dns_table[id].asked |= (u8_t)(1 << numdns);
+    dns_table[id].stime[numdns] = sys_now();
     /* send dns packet */
     err = udp_sendto(dns_pcb, p, &dns_servers[numdns], DNS_SERVER_PORT);
 
@@ -623,19 +921,221 @@ dns_send(u8_t numdns, const char* name, u8_t id)
   return err;
 }
 
+#if DNS_RACE_SERVERS
+/**
+ * Time to wait for an answer of the fastest server before also querying the
+ * other servers: twice its smoothed RTT, but at least a quarter of and at most
+ * DNS_HEDGE_DELAY (a server answering in no time does not justify flooding
+ * the others).
+ *
+ * @param numdns the index of the DNS server queried first
+ * @return delay in milliseconds
+ */
+static u32_t
+dns_hedge_delay(u8_t numdns)
+{
+  struct dns_server_stats *st = &dns_server_stats[numdns];
+
+  if (st->answers == 0) {
+    return DNS_HEDGE_DELAY;
+  }
+  return LWIP_MIN(LWIP_MAX(2 * st->srtt, DNS_HEDGE_DELAY / 4), DNS_HEDGE_DELAY);
+}
+
+/**
+ * Query the servers that have not been queried yet for a dns_table entry.
+ *
+ * @param i index of the dns_table entry
+ */
+static void
+dns_hedge_send(u8_t i)
+{
+  u8_t n, j;
+  err_t err;
+  struct dns_table_entry *pEntry = &dns_table[i];
+
+  pEntry->flags &= ~DNS_ENTRY_FLAG_HEDGE;
+  for (n = 0; n < DNS_MAX_SERVERS; ++n) {
+    j = dns_server_order[n];
+    if (((pEntry->asked & (1 << j)) == 0) && (j != pEntry->numdns) &&
+        !ip_addr_isany(&dns_servers[j])) {
+      err = dns_send(j, pEntry->name, i);
+      if (err != ERR_OK) {
+        LWIP_DEBUGF(DNS_DEBUG | LWIP_DBG_LEVEL_WARNING,
+                    ("dns_send returned error: %s\n", lwip_strerr(err)));
+      }
+    }
+  }
+}
+
+#if LWIP_TIMERS
+/**
+ * Hedge timer: query the remaining servers for all entries whose fastest
+ * server did not answer in time.
+ *
+ * @param arg unused
+ */
+static void
+dns_hedge_timeout(void *arg)
+{
+  u8_t i;
+  u32_t now = sys_now();
+  u32_t delay, elapsed, next = 0;
+  struct dns_table_entry *pEntry;
+
+  LWIP_UNUSED_ARG(arg);
+  dns_hedge_pending = 0;
+  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
+    pEntry = &dns_table[i];
+    if ((pEntry->flags & DNS_ENTRY_FLAG_HEDGE) != 0) {
+      delay = dns_hedge_delay(pEntry->numdns);
+      elapsed = now - pEntry->stime[pEntry->numdns];
+      if (elapsed >= delay) {
+        dns_hedge_send(i);
+      } else if ((next == 0) || (delay - elapsed < next)) {
+        next = delay - elapsed;
+      }
+    }
+  }
+  if (next != 0) {
+    dns_hedge_pending = 1;
+    sys_timeout(next, dns_hedge_timeout, NULL);
+  }
+}
+#endif /* LWIP_TIMERS */
+
+/**
+ * Start racing the servers for a dns_table entry after its query has been
+ * sent to the fastest one.
+ *
+ * @param i index of the dns_table entry
+ */
+static void
+dns_hedge_start(u8_t i)
+{
+  u32_t delay = dns_hedge_delay(dns_table[i].numdns);
+
+  if (delay == 0) {
+    dns_hedge_send(i);
+    return;
+  }
+  dns_table[i].flags |= DNS_ENTRY_FLAG_HEDGE;
+#if LWIP_TIMERS
+  if (!dns_hedge_pending) {
+    dns_hedge_pending = 1;
+    sys_timeout(delay, dns_hedge_timeout, NULL);
+  }
+#endif /* LWIP_TIMERS */
+  /* without timers, dns_tmr() queries the other servers */
+}
+#endif /* DNS_RACE_SERVERS */
+
+/**
+ * Send the first query for a dns_table entry (new name or prefetch).
+ * With DNS_RACE_SERVERS, this goes to the fastest server and the others are
+ * queried if it does not answer within dns_hedge_delay().
+ *
+ * @param i index of the dns_table entry
+ */
+static void
+dns_start_query(u8_t i)
+{
+  err_t err;
+  struct dns_table_entry *pEntry = &dns_table[i];
+
+#if DNS_RACE_SERVERS
+  pEntry->numdns  = dns_server_order[0];
+#else /* DNS_RACE_SERVERS */
+  pEntry->numdns  = 0;
+#endif /* DNS_RACE_SERVERS */
+  pEntry->tmr     = 1;
+  pEntry->retries = 0;
+  pEntry->asked   = 0;
+#if DNS_STATS
+  pEntry->qtime   = sys_now();
+#endif /* DNS_STATS */
+
+  /* send DNS packet for this entry */
+  err = dns_send(pEntry->numdns, pEntry->name, i);
+  if (err != ERR_OK) {
+    LWIP_DEBUGF(DNS_DEBUG | LWIP_DBG_LEVEL_WARNING,
+                ("dns_send returned error: %s\n", lwip_strerr(err)));
+  }
+#if DNS_RACE_SERVERS
+  dns_hedge_start(i);
+#endif /* DNS_RACE_SERVERS */
+}
+
+/**
+ * Retry the query of a dns_table entry waiting for an answer when its timer
+ * expires. Without DNS_RACE_SERVERS, change to the next server after
+ * DNS_MAX_RETRIES, with DNS_RACE_SERVERS all servers are retried together.
+ *
+ * @param i index of the dns_table entry
+ * @return 1 if no server answered, 0 otherwise
+ */
+static u8_t
+dns_retry_query(u8_t i)
+{
+  err_t err;
+  u8_t j;
+  struct dns_table_entry *pEntry = &dns_table[i];
+
+  if (--pEntry->tmr == 0) {
+#if DNS_RACE_SERVERS
+    if ((pEntry->flags & DNS_ENTRY_FLAG_HEDGE) != 0) {
+      /* the hedge timer did not fire yet (or there are no timers): query
+         the other servers now and give them time to answer */
+      dns_hedge_send(i);
+      pEntry->tmr = 1;
+      return 0;
+    }
+#endif /* DNS_RACE_SERVERS */
+    if (++pEntry->retries == DNS_MAX_RETRIES) {
+#if !DNS_RACE_SERVERS
+      if ((pEntry->numdns+1<DNS_MAX_SERVERS) && !ip_addr_isany(&dns_servers[pEntry->numdns+1])) {
+        /* this server did not answer */
+        dns_server_settle(i, 1, 0);
+        /* change of server */
+        pEntry->numdns++;
+        pEntry->tmr     = 1;
+        pEntry->retries = 0;
+        return 0;
+      }
+#endif /* !DNS_RACE_SERVERS */
+      return 1;
+    }
+
+    /* wait longer for the next retry */
+    pEntry->tmr = pEntry->retries;
+
+    /* send DNS packet for this entry, to all servers still waited for */
+    for (j = 0; j < DNS_MAX_SERVERS; ++j) {
+      if (((pEntry->asked & (1 << j)) != 0) || (j == pEntry->numdns)) {
+        err = dns_send(j, pEntry->name, i);
+        if (err != ERR_OK) {
+          LWIP_DEBUGF(DNS_DEBUG | LWIP_DBG_LEVEL_WARNING,
+                      ("dns_send returned error: %s\n", lwip_strerr(err)));
+        }
+      }
+    }
+  }
+  return 0;
+}
+
 /**
  * dns_check_entry() - see if pEntry has not yet been queried and, if so, sends out a query.
  * Check an entry in the dns_table:
  * - send out query for new entries
  * - retry old pending entries on timeout (also with different servers)
- * - remove completed entries from the table if their TTL has expired
+ * - refresh hot completed entries shortly before their TTL expires
+ * - remove completed and negative entries from the table if their TTL has expired
  *
  * @param i index of the dns_table entry to check
  */
 static void
 dns_check_entry(u8_t i)
 {
-  err_t err;
   struct dns_table_entry *pEntry = &dns_table[i];
 
   LWIP_ASSERT("array index out of bounds", i < DNS_TABLE_SIZE);
@@ -645,49 +1145,17 @@ dns_check_entry(u8_t i)
     case DNS_STATE_NEW: {
       /* initialize new entry */
       pEntry->state   = DNS_STATE_ASKING;
-      pEntry->numdns  = 0;
-      pEntry->tmr     = 1;
-      pEntry->retries = 0;
-      
-      /* send DNS packet for this entry */
-      err = dns_send(pEntry->numdns, pEntry->name, i);
-      if (err != ERR_OK) {
-        LWIP_DEBUGF(DNS_DEBUG | LWIP_DBG_LEVEL_WARNING,
-                    ("dns_send returned error: %s\n", lwip_strerr(err)));
-      }
+      dns_start_query(i);
       break;
     }
 
     case DNS_STATE_ASKING: {
-      if (--pEntry->tmr == 0) {
-        if (++pEntry->retries == DNS_MAX_RETRIES) {
-          if ((pEntry->numdns+1<DNS_MAX_SERVERS) && !ip_addr_isany(&dns_servers[pEntry->numdns+1])) {
-            /* change of server */
-            pEntry->numdns++;
-            pEntry->tmr     = 1;
-            pEntry->retries = 0;
-            break;
-          } else {
-            LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": timeout\n", pEntry->name));
-            /* call specified callback function if provided */
-            if (pEntry->found)
-              (*pEntry->found)(pEntry->name, NULL, pEntry->arg);
-            /* flush this entry */
-            pEntry->state   = DNS_STATE_UNUSED;
-            pEntry->found   = NULL;
-            break;
-          }
-        }
-
-        /* wait longer for the next retry */
-        pEntry->tmr = pEntry->retries;
-
-        /* send DNS packet for this entry */
-        err = dns_send(pEntry->numdns, pEntry->name, i);
-        if (err != ERR_OK) {
-          LWIP_DEBUGF(DNS_DEBUG | LWIP_DBG_LEVEL_WARNING,
-                      ("dns_send returned error: %s\n", lwip_strerr(err)));
-        }
+      if (dns_retry_query(i)) {
+        LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": timeout\n", pEntry->name));
+        DNS_STATS_INC(dns.timeout);
+        dns_server_settle(i, 1, 0);
+        /* call specified callback functions and remember the failure */
+        dns_fail_entry(i, DNS_TIMEOUT_NEG_TTL);
       }
       break;
     }
@@ -696,12 +1164,34 @@ dns_check_entry(u8_t i)
       /* if the time to live is nul */
       if (--pEntry->ttl == 0) {
         LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": flush\n", pEntry->name));
+        DNS_STATS_INC(dns.expired);
         /* flush this entry */
-        pEntry->state = DNS_STATE_UNUSED;
-        pEntry->found = NULL;
+        dns_free_entry(i);
+      } else if ((pEntry->flags & DNS_ENTRY_FLAG_PREFETCH) != 0) {
+        if (dns_retry_query(i)) {
+          /* refresh failed, keep the address until the entry expires */
+          pEntry->flags &= ~(DNS_ENTRY_FLAG_PREFETCH | DNS_ENTRY_FLAG_HEDGE);
+          dns_server_settle(i, 1, 0);
+        }
+#if DNS_PREFETCH_TIME
+      } else if ((pEntry->ttl <= DNS_PREFETCH_TIME) && (pEntry->hits >= DNS_PREFETCH_MIN_HITS)) {
+        /* hot entry about to expire: refresh it while still answering
+           lookups from the cache */
+        LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": prefetch\n", pEntry->name));
+        DNS_STATS_INC(dns.prefetch);
+        pEntry->flags |= DNS_ENTRY_FLAG_PREFETCH;
+        pEntry->hits = 0;
+        dns_start_query(i);
+#endif /* DNS_PREFETCH_TIME */
       }
       break;
     }
+    case DNS_STATE_NEGATIVE:
+      if (--pEntry->ttl == 0) {
+        LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": flush negative\n", pEntry->name));
+        dns_free_entry(i);
+      }
+      break;
     case DNS_STATE_UNUSED:
       /* nothing to do */
       break;
@@ -738,10 +1228,12 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
   struct dns_answer ans;
   struct dns_table_entry *pEntry;
   u16_t nquestions, nanswers;
+  u8_t prefetch;
+  u8_t j;
+  u32_t rtt = 0;
 
   LWIP_UNUSED_ARG(arg);
   LWIP_UNUSED_ARG(pcb);
-  LWIP_UNUSED_ARG(addr);
   LWIP_UNUSED_ARG(port);
 
   /* is the dns message too big ? */
@@ -765,9 +1257,21 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     i = htons(hdr->id);
     if (i < DNS_TABLE_SIZE) {
       pEntry = &dns_table[i];
-      if(pEntry->state == DNS_STATE_ASKING) {
-        /* This entry is now completed. */
-        pEntry->state = DNS_STATE_DONE;
+      prefetch = (pEntry->state == DNS_STATE_DONE) &&
+                 ((pEntry->flags & DNS_ENTRY_FLAG_PREFETCH) != 0);
+      /* find the server that answered, drop answers nobody was asked for */
+      for (j = 0; j < DNS_MAX_SERVERS; ++j) {
+        if (((pEntry->asked & (1 << j)) != 0) && ip_addr_cmp(addr, &dns_servers[j])) {
+          break;
+        }
+      }
+      if(((pEntry->state == DNS_STATE_ASKING) || prefetch) && (j < DNS_MAX_SERVERS)) {
+        rtt = sys_now() - pEntry->stime[j];
+        pEntry->asked &= (u8_t)~(1 << j);
+        dns_server_rtt(j, rtt);
+        if (dns_server_stats[j].answers < 0xffff) {
+          dns_server_stats[j].answers++;
+        }
         pEntry->err   = hdr->flags2 & DNS_FLAG2_ERR_MASK;
 
         /* We only care about the question(s) and the answers. The authrr
@@ -775,8 +1279,8 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
         nquestions = htons(hdr->numquestions);
         nanswers   = htons(hdr->numanswers);
 
-        /* Check for error. If so, call callback to inform. */
-        if (((hdr->flags1 & DNS_FLAG1_RESPONSE) == 0) || (pEntry->err != 0) || (nquestions != 1)) {
+        /* Check for a malformed answer: might not even be meant for us */
+        if (((hdr->flags1 & DNS_FLAG1_RESPONSE) == 0) || (nquestions != 1)) {
           LWIP_DEBUGF(DNS_DEBUG, ("dns_recv: \"%s\": error in flags\n", pEntry->name));
           /* call callback to indicate error, clean up memory and return */
           goto responseerr;
@@ -791,6 +1295,13 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
         }
 #endif /* DNS_DOES_NAME_CHECK */
 
+        /* Check for error. If so, call callback to inform. */
+        if (pEntry->err != 0) {
+          LWIP_DEBUGF(DNS_DEBUG, ("dns_recv: \"%s\": error %"U16_F" in response\n",
+                                  pEntry->name, (u16_t)pEntry->err));
+          goto responseerr;
+        }
+
         /* Skip the name in the "question" part */
         pHostname = (char *) dns_parse_name((unsigned char *)dns_payload + SIZEOF_DNS_HDR) + SIZEOF_DNS_QUERY;
 
@@ -812,9 +1323,22 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
             LWIP_DEBUGF(DNS_DEBUG, ("dns_recv: \"%s\": response = ", pEntry->name));
             ip_addr_debug_print(DNS_DEBUG, (&(pEntry->ipaddr)));
             LWIP_DEBUGF(DNS_DEBUG, ("\n"));
-            /* call specified callback function if provided */
-            if (pEntry->found) {
-              (*pEntry->found)(pEntry->name, &pEntry->ipaddr, pEntry->arg);
+            DNS_STATS_RTT(sys_now() - pEntry->qtime);
+            /* the other servers lost the race */
+            dns_server_settle((u8_t)i, 0, rtt);
+            /* This entry is now completed. */
+            pEntry->flags = 0;
+            pEntry->hits  = 0;
+            if (pEntry->ttl == 0) {
+              /* the answer must not be cached: use it for the waiting
+                 requests only */
+              dns_hash_remove((u8_t)i);
+              dns_call_found((u8_t)i, &pEntry->ipaddr);
+              pEntry->state = DNS_STATE_UNUSED;
+            } else {
+              pEntry->state = DNS_STATE_DONE;
+              /* call specified callback functions */
+              dns_call_found((u8_t)i, &pEntry->ipaddr);
             }
             /* deallocate memory and return */
             goto memerr;
@@ -834,13 +1358,24 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
   goto memerr;
 
 responseerr:
-  /* ERROR: call specified callback function with NULL as name to indicate an error */
-  if (pEntry->found) {
-    (*pEntry->found)(pEntry->name, NULL, pEntry->arg);
+  if ((pEntry->err != DNS_FLAG2_ERR_NAME) &&
+      ((pEntry->asked != 0) || ((pEntry->flags & DNS_ENTRY_FLAG_HEDGE) != 0))) {
+    /* other servers may still answer */
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_recv: \"%s\": waiting for other servers\n", pEntry->name));
+  } else if (prefetch) {
+    /* refresh failed, keep the address until the entry expires */
+    pEntry->flags &= ~DNS_ENTRY_FLAG_PREFETCH;
+    dns_server_settle((u8_t)i, 0, rtt);
+  } else if (pEntry->err == DNS_FLAG2_ERR_NAME) {
+    /* the name does not exist: remember that for a while */
+    DNS_STATS_INC(dns.nxdomain);
+    dns_server_settle((u8_t)i, 0, rtt);
+    dns_fail_entry((u8_t)i, DNS_NEG_TTL);
+  } else {
+    /* ERROR: call specified callback functions with NULL as address to
+       indicate an error, and flush this entry */
+    dns_fail_entry((u8_t)i, 0);
   }
-  /* flush this entry */
-  pEntry->state = DNS_STATE_UNUSED;
-  pEntry->found = NULL;
 
 memerr:
   /* free pbuf */
@@ -849,32 +1384,90 @@ memerr:
 }
 
 /**
- * Queues a new hostname to resolve and sends out a DNS query for that hostname
+ * Allocate a request waiting for the answer for a dns_table entry.
+ *
+ * @param i index of the dns_table entry (may not be filled in yet)
+ * @param found a callback founction to be called on success, failure or timeout
+ * @param callback_arg argument to pass to the callback function
+ * @return ERR_OK if a request could be allocated or no callback is needed,
+ *         ERR_MEM if all DNS_MAX_REQUESTS requests are in use
+ */
+static err_t
+dns_alloc_request(u8_t i, dns_found_callback found, void *callback_arg)
+{
+  u8_t r;
+
+  if (found == NULL) {
+    /* nobody to inform, only fill the cache */
+    return ERR_OK;
+  }
+  for (r = 0; r < DNS_MAX_REQUESTS; ++r) {
+    if (dns_requests[r].found == NULL) {
+      dns_requests[r].found = found;
+      dns_requests[r].arg   = callback_arg;
+      dns_requests[r].dns_table_idx = i;
+      return ERR_OK;
+    }
+  }
+  LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: all DNS requests are in use\n"));
+  return ERR_MEM;
+}
+
+/**
+ * Queues a new hostname to resolve and sends out a DNS query for that hostname.
+ * If a query for that hostname is already pending, the request only waits for
+ * its answer.
  *
  * @param name the hostname that is to be queried
+ * @param hash hash of name
  * @param found a callback founction to be called on success, failure or timeout
  * @param callback_arg argument to pass to the callback function
  * @return @return a err_t return code.
  */
 static err_t
-dns_enqueue(const char *name, dns_found_callback found, void *callback_arg)
+dns_enqueue(const char *name, u32_t hash, dns_found_callback found, void *callback_arg)
 {
   u8_t i;
   u8_t lseq, lseqi;
   struct dns_table_entry *pEntry = NULL;
   size_t namelen;
+  err_t err;
+
+  i = dns_find_entry(name, hash);
+  if (i < DNS_TABLE_SIZE) {
+    pEntry = &dns_table[i];
+    if (pEntry->state == DNS_STATE_NEGATIVE) {
+      /* the name was recently found not to exist */
+      LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": negative cache hit\n", name));
+      DNS_STATS_INC(dns.neghit);
+      return ERR_VAL;
+    }
+    if ((pEntry->state == DNS_STATE_NEW) || (pEntry->state == DNS_STATE_ASKING)) {
+      /* a query is already pending: wait for its answer */
+      err = dns_alloc_request(i, found, callback_arg);
+      if (err != ERR_OK) {
+        return err;
+      }
+      LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": query pending in DNS entry %"U16_F"\n", name, (u16_t)(i)));
+      DNS_STATS_INC(dns.coalesced);
+      return ERR_INPROGRESS;
+    }
+  }
 
   /* search an unused entry, or the oldest one */
-  lseq = lseqi = 0;
+  lseq = 0;
+  lseqi = DNS_TABLE_SIZE;
   for (i = 0; i < DNS_TABLE_SIZE; ++i) {
     pEntry = &dns_table[i];
     /* is it an unused entry ? */
     if (pEntry->state == DNS_STATE_UNUSED)
       break;
 
-    /* check if this is the oldest completed entry */
-    if (pEntry->state == DNS_STATE_DONE) {
-      if ((dns_seqno - pEntry->seqno) > lseq) {
+    /* check if this is the oldest completed entry (prefetching entries and
+       entries whose callbacks are running are kept) */
+    if (((pEntry->state == DNS_STATE_DONE) || (pEntry->state == DNS_STATE_NEGATIVE)) &&
+        (pEntry->flags == 0)) {
+      if ((u8_t)(dns_seqno - pEntry->seqno) >= lseq) {
         lseq = dns_seqno - pEntry->seqno;
         lseqi = i;
       }
@@ -883,28 +1476,38 @@ dns_enqueue(const char *name, dns_found_callback found, void *callback_arg)
 
   /* if we don't have found an unused entry, use the oldest completed one */
   if (i == DNS_TABLE_SIZE) {
-    if ((lseqi >= DNS_TABLE_SIZE) || (dns_table[lseqi].state != DNS_STATE_DONE)) {
+    if (lseqi >= DNS_TABLE_SIZE) {
       /* no entry can't be used now, table is full */
       LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": DNS entries table is full\n", name));
       return ERR_MEM;
-    } else {
-      /* use the oldest completed one */
-      i = lseqi;
-      pEntry = &dns_table[i];
     }
+    i = lseqi;
+  }
+
+  err = dns_alloc_request(i, found, callback_arg);
+  if (err != ERR_OK) {
+    return err;
   }
 
   /* use this entry */
   LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": use DNS entry %"U16_F"\n", name, (u16_t)(i)));
+  pEntry = &dns_table[i];
+  if (pEntry->state != DNS_STATE_UNUSED) {
+    /* flush the oldest completed one */
+    dns_free_entry(i);
+  }
 
   /* fill the entry */
   pEntry->state = DNS_STATE_NEW;
   pEntry->seqno = dns_seqno++;
-  pEntry->found = found;
-  pEntry->arg   = callback_arg;
+  pEntry->flags = 0;
+  pEntry->hits  = 0;
+  pEntry->hash  = hash;
   namelen = LWIP_MIN(strlen(name), DNS_MAX_NAME_LENGTH-1);
   MEMCPY(pEntry->name, name, namelen);
   pEntry->name[namelen] = 0;
+  dns_hash_insert(i);
+  DNS_STATS_INC(dns.miss);
 
   /* force to send query without waiting timer */
   dns_check_entry(i);
@@ -923,6 +1526,9 @@ dns_enqueue(const char *name, dns_found_callback found, void *callback_arg)
  * - ERR_INPROGRESS enqueue a request to be sent to the DNS server
  *   for resolution if no errors are present.
  * - ERR_ARG: dns client not initialized or invalid hostname
+ * - ERR_VAL: the hostname was recently found not to exist or could not be
+ *   resolved (negative cache, see DNS_NEG_TTL and DNS_TIMEOUT_NEG_TTL)
+ * - ERR_MEM: no free dns_table entry or request (see DNS_MAX_REQUESTS)
  *
  * @param hostname the hostname that is to be queried
  * @param addr pointer to a ip_addr_t where to store the address if it is already
@@ -937,6 +1543,7 @@ dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback foun
                   void *callback_arg)
 {
   u32_t ipaddr;
+  u32_t hash = 0;
   /* not initialized or no valid server yet, or invalid addr pointer
    * or invalid hostname or invalid hostname length */
   if ((dns_pcb == NULL) || (addr == NULL) ||
@@ -956,7 +1563,8 @@ dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback foun
   ipaddr = ipaddr_addr(hostname);
   if (ipaddr == IPADDR_NONE) {
     /* already have this address cached? */
-    ipaddr = dns_lookup(hostname);
+    hash = dns_hash_name(hostname);
+    ipaddr = dns_lookup(hostname, hash);
   }
   if (ipaddr != IPADDR_NONE) {
     ip4_addr_set_u32(addr, ipaddr);
@@ -964,7 +1572,7 @@ dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback foun
   }
 
   /* queue query with specified callback */
-  return dns_enqueue(hostname, found, callback_arg);
+  return dns_enqueue(hostname, hash, found, callback_arg);
 }
 
 #endif /* LWIP_DNS */
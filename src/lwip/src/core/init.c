@@ -101,11 +101,14 @@
 #if (LWIP_IGMP && (MEMP_NUM_IGMP_GROUP<=1))
   #error "If you want to use IGMP, you have to define MEMP_NUM_IGMP_GROUP>1 in your lwipopts.h"
 #endif
+#if (LWIP_IGMP && ((IGMP_GROUP_HASH_SIZE < 1) || ((IGMP_GROUP_HASH_SIZE & (IGMP_GROUP_HASH_SIZE - 1)) != 0)))
+  #error "IGMP_GROUP_HASH_SIZE must be a power of 2 in your lwipopts.h"
+#endif
 #if ((LWIP_NETCONN || LWIP_SOCKET) && (MEMP_NUM_TCPIP_MSG_API<=0))
   #error "If you want to use Sequential API, you have to define MEMP_NUM_TCPIP_MSG_API>=1 in your lwipopts.h"
 #endif
 /* There must be sufficient timeouts, taking into account requirements of the subsystems. */
-#if LWIP_TIMERS && (MEMP_NUM_SYS_TIMEOUT < (LWIP_TCP + IP_REASSEMBLY + LWIP_ARP + (2*LWIP_DHCP) + LWIP_AUTOIP + LWIP_IGMP + LWIP_DNS + PPP_SUPPORT))
+#if LWIP_TIMERS && (MEMP_NUM_SYS_TIMEOUT < (LWIP_TCP + IP_REASSEMBLY + LWIP_ARP + (2*LWIP_DHCP) + LWIP_AUTOIP + LWIP_IGMP + LWIP_DNS + (LWIP_DNS && DNS_RACE_SERVERS) + PPP_SUPPORT))
   #error "MEMP_NUM_SYS_TIMEOUT is too low to accomodate all required timeouts"
 #endif
 #if (IP_REASSEMBLY && (MEMP_NUM_REASSDATA > IP_REASS_MAX_PBUFS))
@@ -163,26 +166,68 @@
 #if (PBUF_POOL_BUFSIZE <= MEM_ALIGNMENT)
   #error "PBUF_POOL_BUFSIZE must be greater than MEM_ALIGNMENT or the offset may take the full first pbuf"
 #endif
+#if LWIP_DNS && (DNS_TABLE_SIZE > 254)
+  #error "DNS_TABLE_SIZE must be <= 254, entries are linked by u8_t index"
+#endif
+#if LWIP_DNS && (DNS_MAX_SERVERS > 8)
+  #error "DNS_MAX_SERVERS must be <= 8, pending queries are kept in an u8_t bitmask"
+#endif
+#if LWIP_DNS && ((DNS_MAX_REQUESTS < 1) || (DNS_HASH_SIZE < 1))
+  #error "DNS_MAX_REQUESTS and DNS_HASH_SIZE must be at least 1"
+#endif
 #if (DNS_LOCAL_HOSTLIST && !DNS_LOCAL_HOSTLIST_IS_DYNAMIC && !(defined(DNS_LOCAL_HOSTLIST_INIT)))
   #error "you have to define define DNS_LOCAL_HOSTLIST_INIT {{'host1', 0x123}, {'host2', 0x234}} to initialize DNS_LOCAL_HOSTLIST"
 #endif
 #if PPP_SUPPORT && !PPPOS_SUPPORT & !PPPOE_SUPPORT
   #error "PPP_SUPPORT needs either PPPOS_SUPPORT or PPPOE_SUPPORT turned on"
 #endif
+#if PPP_SUPPORT && PPPOS_SUPPORT && PPPOS_TX_RING_SIZE && ((PPPOS_TX_RING_SIZE < 2 * (PPP_MAXMTU + 6) + 2) || (PPPOS_TX_RING_SIZE > 0xffff))
+  #error "PPPOS_TX_RING_SIZE must hold a worst-case escaped frame of PPP_MAXMTU and fit in an u16_t"
+#endif
+#if PPP_SUPPORT && VJ_SUPPORT && ((VJ_MAX_SLOTS < 3) || (VJ_MAX_SLOTS > 256))
+  #error "VJ_MAX_SLOTS must be in the range 3..256"
+#endif
 #if !LWIP_ETHERNET && (LWIP_ARP || PPPOE_SUPPORT)
   #error "LWIP_ETHERNET needs to be turned on for LWIP_ARP or PPPOE_SUPPORT"
 #endif
 #if LWIP_IGMP && !defined(LWIP_RAND)
   #error "When using IGMP, LWIP_RAND() needs to be defined to a random-function returning an u32_t random value"
 #endif
+#if LWIP_TCP && (TCP_ISN_RFC6528 || TCP_RANDOM_LOCAL_PORTS) && !LWIP_RNG
+  #error "TCP_ISN_RFC6528 and TCP_RANDOM_LOCAL_PORTS need the entropy pool, turn on LWIP_RNG in your lwipopts.h"
+#endif
+#if LWIP_RNG && (RNG_POOL_SIZE < 1)
+  #error "RNG_POOL_SIZE must be at least 1"
+#endif
+#if LWIP_BPF && ((BPF_MAXINSNS < 1) || (BPF_MAXINSNS > 0xffff))
+  #error "BPF_MAXINSNS must be between 1 and 65535"
+#endif
+#if LWIP_STATS_EXPORT && (!LWIP_STATS_SNAPSHOT || !LWIP_UDP)
+  #error "LWIP_STATS_EXPORT needs LWIP_STATS_SNAPSHOT and LWIP_UDP turned on"
+#endif
+#if LWIP_STATS_SNAPSHOT && (LWIP_STATS_SNAPSHOT_TRIES < 1)
+  #error "LWIP_STATS_SNAPSHOT_TRIES must be at least 1"
+#endif
+#if (LWIP_STATS_SHARDS > 1) && !LWIP_STATS_SNAPSHOT
+  #error "LWIP_STATS_SHARDS > 1 needs LWIP_STATS_SNAPSHOT turned on"
+#endif
 #if LWIP_TCPIP_CORE_LOCKING_INPUT && !LWIP_TCPIP_CORE_LOCKING
   #error "When using LWIP_TCPIP_CORE_LOCKING_INPUT, LWIP_TCPIP_CORE_LOCKING must be enabled, too"
 #endif
+#if LWIP_NETCONN_ASYNC && LWIP_TCPIP_CORE_LOCKING
+  #error "LWIP_NETCONN_ASYNC needs all netconn operations to run in tcpip_thread, disable LWIP_TCPIP_CORE_LOCKING"
+#endif
 #if LWIP_TCP && LWIP_NETIF_TX_SINGLE_PBUF && !TCP_OVERSIZE
   #error "LWIP_NETIF_TX_SINGLE_PBUF needs TCP_OVERSIZE enabled to create single-pbuf TCP packets"
 #endif
-#if IP_FRAG && IP_FRAG_USES_STATIC_BUF && LWIP_NETIF_TX_SINGLE_PBUF
-  #error "LWIP_NETIF_TX_SINGLE_PBUF does not work with IP_FRAG_USES_STATIC_BUF==1 as that creates pbuf queues"
+#if defined(IP_FRAG_USES_STATIC_BUF) && IP_FRAG_USES_STATIC_BUF
+  #error "IP_FRAG_USES_STATIC_BUF has been removed, fragments always reference the original packet"
+#endif
+#if IP_FRAG && ((IP_FRAG_BATCH_SIZE < 1) || (IP_FRAG_BATCH_SIZE > 255))
+  #error "IP_FRAG_BATCH_SIZE must be in the range 1..255"
+#endif
+#if IP_FRAG && !LWIP_NETIF_TX_SINGLE_PBUF && (MEMP_NUM_FRAG_PBUF < IP_FRAG_BATCH_SIZE)
+  #error "MEMP_NUM_FRAG_PBUF must be at least IP_FRAG_BATCH_SIZE, each fragment of a batch needs at least one"
 #endif
 #if LWIP_NETCONN && LWIP_TCP
 #if NETCONN_COPY != TCP_WRITE_FLAG_COPY
@@ -302,5 +347,8 @@ void lwip_init(void)
     raw_init();
     udp_init();
     tcp_init();
+#if LWIP_IGMP
+    igmp_init();
+#endif /* LWIP_IGMP */
 }
 
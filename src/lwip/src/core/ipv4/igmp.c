@@ -143,12 +143,28 @@ static void   igmp_delaying_member(struct igmp_group *group, u8_t maxresp);
 static err_t  igmp_ip_output_if(struct pbuf *p, ip_addr_t *src, ip_addr_t *dest, struct netif *netif);
 static void   igmp_send(struct igmp_group *group, u8_t type);
 
+/** Bucket of a group address in netif->igmp_groups[] */
+#define IGMP_GROUP_BUCKET(netif, addr) (&(netif)->igmp_groups[igmp_group_hash(addr)])
+
 
-static struct igmp_group* igmp_group_list;
 static ip_addr_t     allsystems;
 static ip_addr_t     allrouters;
 
 
+/**
+ * Hash a group address to one of the IGMP_GROUP_HASH_SIZE buckets.
+ * Folds all octets so groups differing in any of them spread out.
+ */
+static u16_t
+igmp_group_hash(ip_addr_t *addr)
+{
+  u32_t h = ip4_addr_get_u32(addr);
+
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return (u16_t)(h & (IGMP_GROUP_HASH_SIZE - 1));
+}
+
 /**
  * Initialize the IGMP module
  */
@@ -163,18 +179,23 @@ igmp_init(void)
 
 #ifdef LWIP_DEBUG
 /**
- * Dump global IGMP groups list
+ * Dump the IGMP groups of all interfaces
  */
 void
 igmp_dump_group_list()
 { 
-  struct igmp_group *group = igmp_group_list;
+  struct netif *netif;
+  struct igmp_group *group;
+  u16_t i;
 
-  while (group != NULL) {
-    LWIP_DEBUGF(IGMP_DEBUG, ("igmp_dump_group_list: [%"U32_F"] ", (u32_t)(group->group_state)));
-    ip_addr_debug_print(IGMP_DEBUG, &group->group_address);
-    LWIP_DEBUGF(IGMP_DEBUG, (" on if %p\n", group->netif));
-    group = group->next;
+  for (netif = netif_list; netif != NULL; netif = netif->next) {
+    for (i = 0; i < IGMP_GROUP_HASH_SIZE; i++) {
+      for (group = netif->igmp_groups[i]; group != NULL; group = group->next) {
+        LWIP_DEBUGF(IGMP_DEBUG, ("igmp_dump_group_list: [%"U32_F"] ", (u32_t)(group->group_state)));
+        ip_addr_debug_print(IGMP_DEBUG, &group->group_address);
+        LWIP_DEBUGF(IGMP_DEBUG, (" on if %p\n", group->netif));
+      }
+    }
   }
   LWIP_DEBUGF(IGMP_DEBUG, ("\n"));
 }
@@ -222,23 +243,16 @@ igmp_start(struct netif *netif)
 err_t
 igmp_stop(struct netif *netif)
 {
-  struct igmp_group *group = igmp_group_list;
-  struct igmp_group *prev  = NULL;
+  struct igmp_group *group;
   struct igmp_group *next;
-
-  /* look for groups joined on this interface further down the list */
-  while (group != NULL) {
-    next = group->next;
-    /* is it a group joined on this interface? */
-    if (group->netif == netif) {
-      /* is it the first group of the list? */
-      if (group == igmp_group_list) {
-        igmp_group_list = next;
-      }
-      /* is there a "previous" group defined? */
-      if (prev != NULL) {
-        prev->next = next;
-      }
+  u16_t i;
+
+  /* all groups of this interface are in its own table */
+  for (i = 0; i < IGMP_GROUP_HASH_SIZE; i++) {
+    group = netif->igmp_groups[i];
+    netif->igmp_groups[i] = NULL;
+    while (group != NULL) {
+      next = group->next;
       /* disable the group at the MAC level */
       if (netif->igmp_mac_filter != NULL) {
         LWIP_DEBUGF(IGMP_DEBUG, ("igmp_stop: igmp_mac_filter(DEL "));
@@ -248,12 +262,8 @@ igmp_stop(struct netif *netif)
       }
       /* free group */
       memp_free(MEMP_IGMP_GROUP, group);
-    } else {
-      /* change the "previous" */
-      prev = group;
+      group = next;
     }
-    /* move to "next" */
-    group = next;
   }
   return ERR_OK;
 }
@@ -266,20 +276,20 @@ igmp_stop(struct netif *netif)
 void
 igmp_report_groups(struct netif *netif)
 {
-  struct igmp_group *group = igmp_group_list;
+  struct igmp_group *group;
+  u16_t i;
 
   LWIP_DEBUGF(IGMP_DEBUG, ("igmp_report_groups: sending IGMP reports on if %p\n", netif));
 
-  while (group != NULL) {
-    if (group->netif == netif) {
+  for (i = 0; i < IGMP_GROUP_HASH_SIZE; i++) {
+    for (group = netif->igmp_groups[i]; group != NULL; group = group->next) {
       igmp_delaying_member(group, IGMP_JOIN_DELAYING_MEMBER_TMR);
     }
-    group = group->next;
   }
 }
 
 /**
- * Search for a group in the global igmp_group_list
+ * Search for a group in the group table of an interface
  *
  * @param ifp the network interface for which to look
  * @param addr the group ip address to search for
@@ -289,10 +299,10 @@ igmp_report_groups(struct netif *netif)
 struct igmp_group *
 igmp_lookfor_group(struct netif *ifp, ip_addr_t *addr)
 {
-  struct igmp_group *group = igmp_group_list;
+  struct igmp_group *group = *IGMP_GROUP_BUCKET(ifp, addr);
 
   while (group != NULL) {
-    if ((group->netif == ifp) && (ip_addr_cmp(&(group->group_address), addr))) {
+    if (ip_addr_cmp(&(group->group_address), addr)) {
       return group;
     }
     group = group->next;
@@ -315,7 +325,8 @@ igmp_lookfor_group(struct netif *ifp, ip_addr_t *addr)
 struct igmp_group *
 igmp_lookup_group(struct netif *ifp, ip_addr_t *addr)
 {
-  struct igmp_group *group = igmp_group_list;
+  struct igmp_group *group;
+  struct igmp_group **bucket;
   
   /* Search if the group already exists */
   group = igmp_lookfor_group(ifp, addr);
@@ -333,9 +344,10 @@ igmp_lookup_group(struct netif *ifp, ip_addr_t *addr)
     group->group_state        = IGMP_GROUP_NON_MEMBER;
     group->last_reporter_flag = 0;
     group->use                = 0;
-    group->next               = igmp_group_list;
+    bucket                    = IGMP_GROUP_BUCKET(ifp, addr);
+    group->next               = *bucket;
     
-    igmp_group_list = group;
+    *bucket = group;
   }
 
   LWIP_DEBUGF(IGMP_DEBUG, ("igmp_lookup_group: %sallocated a new group with address ", (group?"":"impossible to ")));
@@ -346,29 +358,30 @@ igmp_lookup_group(struct netif *ifp, ip_addr_t *addr)
 }
 
 /**
- * Remove a group in the global igmp_group_list
+ * Remove a group from the group table of its interface
  *
- * @param group the group to remove from the global igmp_group_list
- * @return ERR_OK if group was removed from the list, an err_t otherwise
+ * @param group the group to remove from its netif's group table
+ * @return ERR_OK if group was removed from the table, an err_t otherwise
  */
 static err_t
 igmp_remove_group(struct igmp_group *group)
 {
   err_t err = ERR_OK;
+  struct igmp_group **bucket = IGMP_GROUP_BUCKET(group->netif, &group->group_address);
 
   /* Is it the first group? */
-  if (igmp_group_list == group) {
-    igmp_group_list = group->next;
+  if (*bucket == group) {
+    *bucket = group->next;
   } else {
-    /* look for group further down the list */
+    /* look for group further down the bucket */
     struct igmp_group *tmpGroup;
-    for (tmpGroup = igmp_group_list; tmpGroup != NULL; tmpGroup = tmpGroup->next) {
+    for (tmpGroup = *bucket; tmpGroup != NULL; tmpGroup = tmpGroup->next) {
       if (tmpGroup->next == group) {
         tmpGroup->next = group->next;
         break;
       }
     }
-    /* Group not found in the global igmp_group_list */
+    /* Group not found in the group table */
     if (tmpGroup == NULL)
       err = ERR_ARG;
   }
@@ -392,6 +405,7 @@ igmp_input(struct pbuf *p, struct netif *inp, ip_addr_t *dest)
   struct igmp_msg*   igmp;
   struct igmp_group* group;
   struct igmp_group* groupref;
+  u16_t i;
 
   IGMP_STATS_INC(igmp.recv);
 
@@ -446,13 +460,13 @@ igmp_input(struct pbuf *p, struct netif *inp, ip_addr_t *dest)
          IGMP_STATS_INC(igmp.rx_general);
        }
 
-       groupref = igmp_group_list;
-       while (groupref) {
-         /* Do not send messages on the all systems group address! */
-         if ((groupref->netif == inp) && (!(ip_addr_cmp(&(groupref->group_address), &allsystems)))) {
-           igmp_delaying_member(groupref, igmp->igmp_maxresp);
+       for (i = 0; i < IGMP_GROUP_HASH_SIZE; i++) {
+         for (groupref = inp->igmp_groups[i]; groupref != NULL; groupref = groupref->next) {
+           /* Do not send messages on the all systems group address! */
+           if (!(ip_addr_cmp(&(groupref->group_address), &allsystems))) {
+             igmp_delaying_member(groupref, igmp->igmp_maxresp);
+           }
          }
-         groupref = groupref->next;
        }
      } else {
        /* IGMP_MEMB_QUERY to a specific group ? */
@@ -654,16 +668,21 @@ igmp_leavegroup(ip_addr_t *ifaddr, ip_addr_t *groupaddr)
 void
 igmp_tmr(void)
 {
-  struct igmp_group *group = igmp_group_list;
-
-  while (group != NULL) {
-    if (group->timer > 0) {
-      group->timer--;
-      if (group->timer == 0) {
-        igmp_timeout(group);
+  struct netif *netif;
+  struct igmp_group *group;
+  u16_t i;
+
+  for (netif = netif_list; netif != NULL; netif = netif->next) {
+    for (i = 0; i < IGMP_GROUP_HASH_SIZE; i++) {
+      for (group = netif->igmp_groups[i]; group != NULL; group = group->next) {
+        if (group->timer > 0) {
+          group->timer--;
+          if (group->timer == 0) {
+            igmp_timeout(group);
+          }
+        }
       }
     }
-    group = group->next;
   }
 }
 
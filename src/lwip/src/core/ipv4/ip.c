@@ -349,37 +349,68 @@ err_t ip_input(struct pbuf *p, struct netif *inp)
     ip_addr_copy(current_iphdr_dest, iphdr->dest);
     ip_addr_copy(current_iphdr_src, iphdr->src);
 
-    /* 开始尝试inp.
-    如果那是不可接受的,请开始遍历已配置的netif列表.
-    "first"用作布尔值,用于标记我们是否开始遍历列表. */
-    int first = 1;
-    netif = inp;
-    do
+#if LWIP_IGMP
+    /* 组播只投递到inp上已加入的组(按组地址哈希查找) */
+    if (ip_addr_ismulticast(&current_iphdr_dest))
     {
-        /* 接口已启动并已配置? */
-        if ((netif_is_up(netif)) && (!ip_addr_isany(&(netif->ip_addr))))
+        if ((inp->flags & NETIF_FLAG_IGMP) && (igmp_lookfor_group(inp, &current_iphdr_dest)))
         {
-            /* 单播到该地址或在该接口上广播 */
-            if (ip_addr_cmp(&current_iphdr_dest, &(netif->ip_addr)) ||
-                ip_addr_isbroadcast(&current_iphdr_dest, netif))
-            {
-                break;
-            }
-        }
-        if (first)
-        {
-            first = 0;
-            netif = netif_list;
+            netif = inp;
         }
         else
         {
-            netif = netif->next;
+            netif = NULL;
         }
-        if (netif == inp)
+    }
+    else
+#endif /* LWIP_IGMP */
+    {
+        /* 开始尝试inp.
+        如果那是不可接受的,请开始遍历已配置的netif列表.
+        "first"用作布尔值,用于标记我们是否开始遍历列表. */
+        int first = 1;
+        netif = inp;
+        do
         {
-            netif = netif->next;
+            /* 接口已启动并已配置? */
+            if ((netif_is_up(netif)) && (!ip_addr_isany(&(netif->ip_addr))))
+            {
+                /* 单播到该地址或在该接口上广播 */
+                if (ip_addr_cmp(&current_iphdr_dest, &(netif->ip_addr)) ||
+                    ip_addr_isbroadcast(&current_iphdr_dest, netif))
+                {
+                    break;
+                }
+            }
+            if (first)
+            {
+                first = 0;
+                netif = netif_list;
+            }
+            else
+            {
+                netif = netif->next;
+            }
+            if (netif == inp)
+            {
+                netif = netif->next;
+            }
+        } while(netif != NULL);
+    }
+
+#if IP_ACCEPT_LINK_LAYER_ADDRESSING
+    /* DHCP报文按链路层地址投递,不能按IP地址过滤(接口可能还没有地址),
+       见RFC 1542 3.1.1. 其他端口可用LWIP_IP_ACCEPT_UDP_PORT(dst_port)放行 */
+    if ((netif == NULL) && (IPH_PROTO(iphdr) == IP_PROTO_UDP) &&
+        (iphdr_len >= iphdr_hlen + UDP_HLEN))
+    {
+        struct udp_hdr *udphdr = (struct udp_hdr *)((u8_t *)iphdr + iphdr_hlen);
+        if (IP_ACCEPT_LINK_LAYER_ADDRESSED_PORT(udphdr->dest))
+        {
+            netif = inp;
         }
-    } while(netif != NULL);
+    }
+#endif /* IP_ACCEPT_LINK_LAYER_ADDRESSING */
 
     /* 广播还是组播数据包的源地址? 符合RFC 1122：3.2.1.3 */
     if ((ip_addr_isbroadcast(&current_iphdr_src, inp)) || (ip_addr_ismulticast(&current_iphdr_src)))
@@ -430,6 +461,12 @@ err_t ip_input(struct pbuf *p, struct netif *inp)
             icmp_input(p, inp);
             break;
 
+#if LWIP_IGMP
+            case IP_PROTO_IGMP:
+            igmp_input(p, inp, &current_iphdr_dest);
+            break;
+#endif /* LWIP_IGMP */
+
             default:
             /* 发送ICMP目标协议不可达,除非是广播 */
             if (!ip_addr_isbroadcast(&current_iphdr_dest, inp) &&
@@ -52,21 +52,20 @@
 #if IP_REASSEMBLY
 /**
  * The IP reassembly code currently has the following limitations:
- * - IP header options are not supported
  * - fragments must not overlap (e.g. due to different routes),
- *   currently, overlapping or duplicate fragments are thrown away
- *   if IP_REASS_CHECK_OVERLAP=1 (the default)!
+ *   overlapping or duplicate fragments are thrown away
  *
- * @todo: work with IP header options
+ * Datagrams being reassembled are kept in a hash table keyed on
+ * (src, dest, id, proto). Their fragments are indexed in an array sorted
+ * by offset: fragments arriving in order are appended in constant time,
+ * others are placed by a binary search (O(log n)), and only their two
+ * neighbours need to be checked for overlaps. Inserting shifts the index
+ * entries behind the new one, at most IP_REASS_MAX_PBUFS pointers; no
+ * fragment is touched for that. Since overlapping fragments are never
+ * enqueued, a datagram is complete as soon as the last fragment was seen
+ * and the number of bytes received equals the datagram length.
  */
 
-/** Setting this to 0, you can turn off checking the fragments for overlapping
- * regions. The code gets a little smaller. Only use this if you know that
- * overlapping won't occur on your network! */
-#ifndef IP_REASS_CHECK_OVERLAP
-#define IP_REASS_CHECK_OVERLAP 1
-#endif /* IP_REASS_CHECK_OVERLAP */
-
 /** Set to 0 to prevent freeing the oldest datagram when the reassembly buffer is
  * full (IP_REASS_MAX_PBUFS pbufs are enqueued). The code gets a little smaller.
  * Datagrams will be freed by timeout only. Especially useful when MEMP_NUM_REASSDATA
@@ -78,8 +77,7 @@
 #define IP_REASS_FLAG_LASTFRAG 0x01
 
 /** This is a helper struct which holds the starting
- * offset and the ending offset of this fragment to
- * easily chain the fragments.
+ * offset and the ending offset of this fragment.
  * It has the same packing requirements as the IP header, since it replaces
  * the IP header in memory in incoming fragments (after copying it) to keep
  * track of the various fragments. (-> If the IP header doesn't need packing,
@@ -90,28 +88,50 @@
 #endif
 PACK_STRUCT_BEGIN
 struct ip_reass_helper {
-  PACK_STRUCT_FIELD(struct pbuf *next_pbuf);
   PACK_STRUCT_FIELD(u16_t start);
   PACK_STRUCT_FIELD(u16_t end);
+  /* length of the IP header (including options) of this fragment */
+  PACK_STRUCT_FIELD(u8_t hlen);
 } PACK_STRUCT_STRUCT;
 PACK_STRUCT_END
 #ifdef PACK_STRUCT_USE_INCLUDES
 #  include "arch/epstruct.h"
 #endif
 
-#define IP_ADDRESSES_AND_ID_MATCH(iphdrA, iphdrB)  \
+#define IP_REASS_KEY_MATCH(iphdrA, iphdrB)  \
   (ip_addr_cmp(&(iphdrA)->src, &(iphdrB)->src) && \
    ip_addr_cmp(&(iphdrA)->dest, &(iphdrB)->dest) && \
-   IPH_ID(iphdrA) == IPH_ID(iphdrB)) ? 1 : 0
+   IPH_ID(iphdrA) == IPH_ID(iphdrB) && \
+   IPH_PROTO(iphdrA) == IPH_PROTO(iphdrB)) ? 1 : 0
+
+#define IP_REASS_HELPER(p) ((struct ip_reass_helper*)(p)->payload)
+/** The fragment with the highest offset received so far */
+#define IP_REASS_LAST(ipr) ((ipr)->frags[(ipr)->nfrags - 1])
 
 /* global variables */
-static struct ip_reassdata *reassdatagrams;
+static struct ip_reassdata *reassdatagrams[IP_REASS_HASH_SIZE];
 static u16_t ip_reass_pbufcount;
 
 /* function prototypes */
 static void ip_reass_dequeue_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev);
 static int ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev);
 
+/**
+ * Calculate the hash table index of a datagram.
+ *
+ * @param iphdr IP header of the datagram or of one of its fragments
+ * @return index into reassdatagrams
+ */
+static u8_t
+ip_reass_hash(struct ip_hdr *iphdr)
+{
+  u32_t h = ip4_addr_get_u32(&iphdr->src) ^ ip4_addr_get_u32(&iphdr->dest) ^
+            ((u32_t)IPH_ID(iphdr) << 8) ^ IPH_PROTO(iphdr);
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return (u8_t)(h % IP_REASS_HASH_SIZE);
+}
+
 /**
  * Reassembly timer base function
  * for both NO_SYS == 0 and 1 (!).
@@ -121,28 +141,32 @@ static int ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_r
 void
 ip_reass_tmr(void)
 {
-  struct ip_reassdata *r, *prev = NULL;
-
-  r = reassdatagrams;
-  while (r != NULL) {
-    /* Decrement the timer. Once it reaches 0,
-     * clean up the incomplete fragment assembly */
-    if (r->timer > 0) {
-      r->timer--;
-      LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_tmr: timer dec %"U16_F"\n",(u16_t)r->timer));
-      prev = r;
-      r = r->next;
-    } else {
-      /* reassembly timed out */
-      struct ip_reassdata *tmp;
-      LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_tmr: timer timed out\n"));
-      tmp = r;
-      /* get the next pointer before freeing */
-      r = r->next;
-      /* free the helper struct and all enqueued pbufs */
-      ip_reass_free_complete_datagram(tmp, prev);
-     }
-   }
+  struct ip_reassdata *r, *prev;
+  u8_t i;
+
+  for (i = 0; i < IP_REASS_HASH_SIZE; i++) {
+    prev = NULL;
+    r = reassdatagrams[i];
+    while (r != NULL) {
+      /* Decrement the timer. Once it reaches 0,
+       * clean up the incomplete fragment assembly */
+      if (r->timer > 0) {
+        r->timer--;
+        LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_tmr: timer dec %"U16_F"\n",(u16_t)r->timer));
+        prev = r;
+        r = r->next;
+      } else {
+        /* reassembly timed out */
+        struct ip_reassdata *tmp;
+        LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_tmr: timer timed out\n"));
+        tmp = r;
+        /* get the next pointer before freeing */
+        r = r->next;
+        /* free the helper struct and all enqueued pbufs */
+        ip_reass_free_complete_datagram(tmp, prev);
+      }
+    }
+  }
 }
 
 /**
@@ -151,16 +175,16 @@ ip_reass_tmr(void)
  * SNMP counters and sends an ICMP time exceeded packet.
  *
  * @param ipr datagram to free
- * @param prev the previous datagram in the linked list
+ * @param prev the previous datagram in the hash bucket
  * @return the number of pbufs freed
  */
 static int
 ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev)
 {
   u16_t pbufs_freed = 0;
+  u16_t i = 0;
   u8_t clen;
   struct pbuf *p;
-  struct ip_reass_helper *iprh;
 
   LWIP_ASSERT("prev != ipr", prev != ipr);
   if (prev != NULL) {
@@ -169,13 +193,11 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
 
   snmp_inc_ipreasmfails();
 #if LWIP_ICMP
-  iprh = (struct ip_reass_helper *)ipr->p->payload;
-  if (iprh->start == 0) {
+  if (IP_REASS_HELPER(ipr->frags[0])->start == 0) {
     /* The first fragment was received, send ICMP time exceeded. */
-    /* First, de-queue the first pbuf from r->p. */
-    p = ipr->p;
-    ipr->p = iprh->next_pbuf;
-    /* Then, copy the original header into it. */
+    p = ipr->frags[0];
+    i = 1;
+    /* Copy the original header into it (options are still there). */
     SMEMCPY(p->payload, &ipr->iphdr, IP_HLEN);
     icmp_time_exceeded(p, ICMP_TE_FRAG);
     clen = pbuf_clen(p);
@@ -187,17 +209,12 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
 
   /* First, free all received pbufs.  The individual pbufs need to be released 
      separately as they have not yet been chained */
-  p = ipr->p;
-  while (p != NULL) {
-    struct pbuf *pcur;
-    iprh = (struct ip_reass_helper *)p->payload;
-    pcur = p;
-    /* get the next pointer before freeing */
-    p = iprh->next_pbuf;
-    clen = pbuf_clen(pcur);
+  for (; i < ipr->nfrags; i++) {
+    p = ipr->frags[i];
+    clen = pbuf_clen(p);
     LWIP_ASSERT("pbufs_freed + clen <= 0xffff", pbufs_freed + clen <= 0xffff);
     pbufs_freed += clen;
-    pbuf_free(pcur);
+    pbuf_free(p);
   }
   /* Then, unchain the struct ip_reassdata from the list and free it. */
   ip_reass_dequeue_datagram(ipr, prev);
@@ -220,38 +237,34 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
 static int
 ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed)
 {
-  /* @todo Can't we simply remove the last datagram in the
-   *       linked list behind reassdatagrams?
-   */
-  struct ip_reassdata *r, *oldest, *prev;
+  struct ip_reassdata *r, *prev, *oldest, *oldest_prev;
   int pbufs_freed = 0, pbufs_freed_current;
   int other_datagrams;
+  u8_t i;
 
   /* Free datagrams until being allowed to enqueue 'pbufs_needed' pbufs,
    * but don't free the datagram that 'fraghdr' belongs to! */
   do {
     oldest = NULL;
-    prev = NULL;
+    oldest_prev = NULL;
     other_datagrams = 0;
-    r = reassdatagrams;
-    while (r != NULL) {
-      if (!IP_ADDRESSES_AND_ID_MATCH(&r->iphdr, fraghdr)) {
-        /* Not the same datagram as fraghdr */
-        other_datagrams++;
-        if (oldest == NULL) {
-          oldest = r;
-        } else if (r->timer <= oldest->timer) {
-          /* older than the previous oldest */
-          oldest = r;
+    for (i = 0; i < IP_REASS_HASH_SIZE; i++) {
+      prev = NULL;
+      for (r = reassdatagrams[i]; r != NULL; r = r->next) {
+        if (!IP_REASS_KEY_MATCH(&r->iphdr, fraghdr)) {
+          /* Not the same datagram as fraghdr */
+          other_datagrams++;
+          if ((oldest == NULL) || (r->timer <= oldest->timer)) {
+            /* older than the previous oldest */
+            oldest = r;
+            oldest_prev = prev;
+          }
         }
-      }
-      if (r->next != NULL) {
         prev = r;
       }
-      r = r->next;
     }
     if (oldest != NULL) {
-      pbufs_freed_current = ip_reass_free_complete_datagram(oldest, prev);
+      pbufs_freed_current = ip_reass_free_complete_datagram(oldest, oldest_prev);
       pbufs_freed += pbufs_freed_current;
     }
   } while ((pbufs_freed < pbufs_needed) && (other_datagrams > 1));
@@ -269,6 +282,7 @@ static struct ip_reassdata*
 ip_reass_enqueue_new_datagram(struct ip_hdr *fraghdr, int clen)
 {
   struct ip_reassdata* ipr;
+  u8_t idx;
   /* No matching previous fragment found, allocate a new reassdata struct */
   ipr = (struct ip_reassdata *)memp_malloc(MEMP_REASSDATA);
   if (ipr == NULL) {
@@ -284,14 +298,19 @@ ip_reass_enqueue_new_datagram(struct ip_hdr *fraghdr, int clen)
       return NULL;
     }
   }
-  memset(ipr, 0, sizeof(struct ip_reassdata));
+  /* no memset: frags[] is only read up to nfrags */
+  ipr->datagram_len = 0;
+  ipr->recv_len = 0;
+  ipr->nfrags = 0;
+  ipr->flags = 0;
   ipr->timer = IP_REASS_MAXAGE;
 
-  /* enqueue the new structure to the front of the list */
-  ipr->next = reassdatagrams;
-  reassdatagrams = ipr;
-  /* copy the ip header for later tests and input */
-  /* @todo: no ip options supported? */
+  /* enqueue the new structure to the front of its hash bucket */
+  idx = ip_reass_hash(fraghdr);
+  ipr->next = reassdatagrams[idx];
+  reassdatagrams[idx] = ipr;
+  /* copy the ip header for later tests and input (the options of the first
+     fragment stay in its pbuf) */
   SMEMCPY(&(ipr->iphdr), fraghdr, IP_HLEN);
   return ipr;
 }
@@ -299,15 +318,17 @@ ip_reass_enqueue_new_datagram(struct ip_hdr *fraghdr, int clen)
 /**
  * Dequeues a datagram from the datagram queue. Doesn't deallocate the pbufs.
  * @param ipr points to the queue entry to dequeue
+ * @param prev the previous datagram in the hash bucket (NULL if ipr is the first)
  */
 static void
 ip_reass_dequeue_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev)
 {
-  
+  u8_t idx = ip_reass_hash(&ipr->iphdr);
+
   /* dequeue the reass struct  */
-  if (reassdatagrams == ipr) {
-    /* it was the first in the list */
-    reassdatagrams = ipr->next;
+  if (reassdatagrams[idx] == ipr) {
+    /* it was the first in the bucket */
+    reassdatagrams[idx] = ipr->next;
   } else {
     /* it wasn't the first, so it must have a valid 'prev' */
     LWIP_ASSERT("sanity check linked list", prev != NULL);
@@ -319,151 +340,113 @@ ip_reass_dequeue_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev)
 }
 
 /**
- * Chain a new pbuf into the pbuf list that composes the datagram.  The pbuf list
- * will grow over time as  new pbufs are rx.
- * Also checks that the datagram passes basic continuity checks (if the last
- * fragment was received at least once).
- * @param root_p points to the 'root' pbuf for the current datagram being assembled.
+ * Insert a new fragment into the sorted index of the datagram's fragments.
+ * Also checks whether the datagram is complete (if the last fragment was
+ * received at least once).
+ * The datagram's header, end and 'last fragment seen' flag are only taken
+ * from a fragment once it has been inserted, so a dropped duplicate or
+ * overlapping fragment leaves the datagram unchanged.
+ * @param ipr points to the datagram the fragment belongs to
  * @param new_p points to the pbuf for the current fragment
- * @return 0 if invalid, >0 otherwise
+ * @return 0 if invalid or not yet complete, >0 otherwise
  */
 static int
 ip_reass_chain_frag_into_datagram_and_validate(struct ip_reassdata *ipr, struct pbuf *new_p)
 {
-  struct ip_reass_helper *iprh, *iprh_tmp, *iprh_prev=NULL;
-  struct pbuf *q;
-  u16_t offset,len;
+  struct ip_reass_helper *iprh;
+  u16_t offset, len, end;
+  u16_t lo, hi, mid;
+  u8_t hlen;
   struct ip_hdr *fraghdr;
-  int valid = 1;
 
   /* Extract length and fragment offset from current fragment */
   fraghdr = (struct ip_hdr*)new_p->payload; 
-  len = ntohs(IPH_LEN(fraghdr)) - IPH_HL(fraghdr) * 4;
+  hlen = (u8_t)(IPH_HL(fraghdr) * 4);
+  len = ntohs(IPH_LEN(fraghdr)) - hlen;
   offset = (ntohs(IPH_OFFSET(fraghdr)) & IP_OFFMASK) * 8;
+  end = offset + len;
+  /* every fragment holds at least one of the IP_REASS_MAX_PBUFS pbufs */
+  LWIP_ASSERT("too many fragments", ipr->nfrags < IP_REASS_MAX_PBUFS);
+
+  /* find the place to insert the fragment, without touching the datagram */
+  lo = ipr->nfrags;
+  if ((lo > 0) && (offset < IP_REASS_HELPER(IP_REASS_LAST(ipr))->end)) {
+    /* not in order: binary search for the first fragment starting at or
+     * behind the new one */
+    lo = 0;
+    hi = ipr->nfrags;
+    while (lo < hi) {
+      mid = (u16_t)((lo + hi) / 2);
+      if (IP_REASS_HELPER(ipr->frags[mid])->start < offset) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    /* the enqueued fragments don't overlap, so only the neighbours can
+     * overlap the new one */
+    if (((lo > 0) && (IP_REASS_HELPER(ipr->frags[lo - 1])->end > offset)) ||
+        ((lo < ipr->nfrags) && (IP_REASS_HELPER(ipr->frags[lo])->start < end))) {
+      /* duplicate or overlapping fragment: throw it away */
+      goto freepbuf;
+    }
+  }
+  /* else: first fragment or in-order arrival, append it */
+
+  /* the fragment is accepted: now it may update the datagram */
+  if ((offset == 0) && (ipr->nfrags > 0)) {
+    /* ipr->iphdr is not the header from the first fragment, but fraghdr is
+     * -> copy fraghdr into ipr->iphdr since we want to have the header
+     * of the first fragment (for ICMP time exceeded and later, for copying
+     * all options, if supported)*/
+    SMEMCPY(&ipr->iphdr, fraghdr, IP_HLEN);
+  }
+  /* check for 'no more fragments', and update queue entry*/
+  if ((IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0) {
+    ipr->flags |= IP_REASS_FLAG_LASTFRAG;
+    ipr->datagram_len = end;
+    LWIP_DEBUGF(IP_REASS_DEBUG,
+     ("ip_reass: last fragment seen, total len %"S16_F"\n",
+      ipr->datagram_len));
+  }
 
   /* overwrite the fragment's ip header from the pbuf with our helper struct,
    * and setup the embedded helper structure. */
   /* make sure the struct ip_reass_helper fits into the IP header */
   LWIP_ASSERT("sizeof(struct ip_reass_helper) <= IP_HLEN",
               sizeof(struct ip_reass_helper) <= IP_HLEN);
-  iprh = (struct ip_reass_helper*)new_p->payload;
-  iprh->next_pbuf = NULL;
+  iprh = IP_REASS_HELPER(new_p);
   iprh->start = offset;
-  iprh->end = offset + len;
-
-  /* Iterate through until we either get to the end of the list (append),
-   * or we find on with a larger offset (insert). */
-  for (q = ipr->p; q != NULL;) {
-    iprh_tmp = (struct ip_reass_helper*)q->payload;
-    if (iprh->start < iprh_tmp->start) {
-      /* the new pbuf should be inserted before this */
-      iprh->next_pbuf = q;
-      if (iprh_prev != NULL) {
-        /* not the fragment with the lowest offset */
-#if IP_REASS_CHECK_OVERLAP
-        if ((iprh->start < iprh_prev->end) || (iprh->end > iprh_tmp->start)) {
-          /* fragment overlaps with previous or following, throw away */
-          goto freepbuf;
-        }
-#endif /* IP_REASS_CHECK_OVERLAP */
-        iprh_prev->next_pbuf = new_p;
-      } else {
-        /* fragment with the lowest offset */
-        ipr->p = new_p;
-      }
-      break;
-    } else if(iprh->start == iprh_tmp->start) {
-      /* received the same datagram twice: no need to keep the datagram */
-      goto freepbuf;
-#if IP_REASS_CHECK_OVERLAP
-    } else if(iprh->start < iprh_tmp->end) {
-      /* overlap: no need to keep the new datagram */
-      goto freepbuf;
-#endif /* IP_REASS_CHECK_OVERLAP */
-    } else {
-      /* Check if the fragments received so far have no wholes. */
-      if (iprh_prev != NULL) {
-        if (iprh_prev->end != iprh_tmp->start) {
-          /* There is a fragment missing between the current
-           * and the previous fragment */
-          valid = 0;
-        }
-      }
-    }
-    q = iprh_tmp->next_pbuf;
-    iprh_prev = iprh_tmp;
-  }
+  iprh->end = end;
+  iprh->hlen = hlen;
 
-  /* If q is NULL, then we made it to the end of the list. Determine what to do now */
-  if (q == NULL) {
-    if (iprh_prev != NULL) {
-      /* this is (for now), the fragment with the highest offset:
-       * chain it to the last fragment */
-#if IP_REASS_CHECK_OVERLAP
-      LWIP_ASSERT("check fragments don't overlap", iprh_prev->end <= iprh->start);
-#endif /* IP_REASS_CHECK_OVERLAP */
-      iprh_prev->next_pbuf = new_p;
-      if (iprh_prev->end != iprh->start) {
-        valid = 0;
-      }
-    } else {
-#if IP_REASS_CHECK_OVERLAP
-      LWIP_ASSERT("no previous fragment, this must be the first fragment!",
-        ipr->p == NULL);
-#endif /* IP_REASS_CHECK_OVERLAP */
-      /* this is the first fragment we ever received for this ip datagram */
-      ipr->p = new_p;
-    }
+  if (lo < ipr->nfrags) {
+    memmove(&ipr->frags[lo + 1], &ipr->frags[lo],
+      (ipr->nfrags - lo) * sizeof(ipr->frags[0]));
   }
-
-  /* At this point, the validation part begins: */
-  /* If we already received the last fragment */
-  if ((ipr->flags & IP_REASS_FLAG_LASTFRAG) != 0) {
-    /* and had no wholes so far */
-    if (valid) {
-      /* then check if the rest of the fragments is here */
-      /* Check if the queue starts with the first datagram */
-      if (((struct ip_reass_helper*)ipr->p->payload)->start != 0) {
-        valid = 0;
-      } else {
-        /* and check that there are no wholes after this datagram */
-        iprh_prev = iprh;
-        q = iprh->next_pbuf;
-        while (q != NULL) {
-          iprh = (struct ip_reass_helper*)q->payload;
-          if (iprh_prev->end != iprh->start) {
-            valid = 0;
-            break;
-          }
-          iprh_prev = iprh;
-          q = iprh->next_pbuf;
-        }
-        /* if still valid, all fragments are received
-         * (because to the MF==0 already arrived */
-        if (valid) {
-          LWIP_ASSERT("sanity check", ipr->p != NULL);
-          LWIP_ASSERT("sanity check",
-            ((struct ip_reass_helper*)ipr->p->payload) != iprh);
-          LWIP_ASSERT("validate_datagram:next_pbuf!=NULL",
-            iprh->next_pbuf == NULL);
-          LWIP_ASSERT("validate_datagram:datagram end!=datagram len",
-            iprh->end == ipr->datagram_len);
-        }
-      }
-    }
-    /* If valid is 0 here, there are some fragments missing in the middle
-     * (since MF == 0 has already arrived). Such datagrams simply time out if
-     * no more fragments are received... */
-    return valid;
+  ipr->frags[lo] = new_p;
+  ipr->nfrags++;
+  ipr->recv_len += len;
+
+  /* At this point, the validation part begins: if we already received the
+   * last fragment and all bytes up to it, there can't be any holes since
+   * fragments never overlap */
+  if (((ipr->flags & IP_REASS_FLAG_LASTFRAG) != 0) &&
+      (ipr->recv_len == ipr->datagram_len)) {
+    LWIP_ASSERT("validate_datagram:first fragment missing",
+      IP_REASS_HELPER(ipr->frags[0])->start == 0);
+    LWIP_ASSERT("validate_datagram:datagram end!=datagram len",
+      IP_REASS_HELPER(IP_REASS_LAST(ipr))->end == ipr->datagram_len);
+    return 1;
   }
-  /* If we come here, not all fragments were received, yet! */
-  return 0; /* not yet valid! */
-#if IP_REASS_CHECK_OVERLAP
+  /* If we come here, not all fragments were received, yet! Such datagrams
+   * simply time out if no more fragments are received... */
+  return 0;
+
 freepbuf:
   ip_reass_pbufcount -= pbuf_clen(new_p);
   pbuf_free(new_p);
   return 0;
-#endif /* IP_REASS_CHECK_OVERLAP */
 }
 
 /**
@@ -475,27 +458,33 @@ freepbuf:
 struct pbuf *
 ip_reass(struct pbuf *p)
 {
-  struct pbuf *r;
+  struct pbuf *r, *q;
   struct ip_hdr *fraghdr;
   struct ip_reassdata *ipr;
   struct ip_reass_helper *iprh;
-  u16_t offset, len;
-  u8_t clen;
+  u16_t offset, len, i;
+  u8_t clen, hlen;
   struct ip_reassdata *ipr_prev = NULL;
 
   IPFRAG_STATS_INC(ip_frag.recv);
   snmp_inc_ipreasmreqds();
 
   fraghdr = (struct ip_hdr*)p->payload;
+  hlen = (u8_t)(IPH_HL(fraghdr) * 4);
 
-  if ((IPH_HL(fraghdr) * 4) != IP_HLEN) {
-    LWIP_DEBUGF(IP_REASS_DEBUG,("ip_reass: IP options currently not supported!\n"));
-    IPFRAG_STATS_INC(ip_frag.err);
+  if ((hlen < IP_HLEN) || (hlen > p->len) || (ntohs(IPH_LEN(fraghdr)) < hlen)) {
+    LWIP_DEBUGF(IP_REASS_DEBUG,("ip_reass: invalid IP header length\n"));
+    IPFRAG_STATS_INC(ip_frag.lenerr);
     goto nullreturn;
   }
 
   offset = (ntohs(IPH_OFFSET(fraghdr)) & IP_OFFMASK) * 8;
-  len = ntohs(IPH_LEN(fraghdr)) - IPH_HL(fraghdr) * 4;
+  len = ntohs(IPH_LEN(fraghdr)) - hlen;
+  if ((u32_t)offset + len > 0xffff) {
+    LWIP_DEBUGF(IP_REASS_DEBUG,("ip_reass: fragment exceeds maximum datagram size\n"));
+    IPFRAG_STATS_INC(ip_frag.lenerr);
+    goto nullreturn;
+  }
 
   /* Check if we are allowed to enqueue more datagrams. */
   clen = pbuf_clen(p);
@@ -515,13 +504,13 @@ ip_reass(struct pbuf *p)
     }
   }
 
-  /* Look for the datagram the fragment belongs to in the current datagram queue,
-   * remembering the previous in the queue for later dequeueing. */
-  for (ipr = reassdatagrams; ipr != NULL; ipr = ipr->next) {
+  /* Look for the datagram the fragment belongs to in its hash bucket,
+   * remembering the previous in the bucket for later dequeueing. */
+  for (ipr = reassdatagrams[ip_reass_hash(fraghdr)]; ipr != NULL; ipr = ipr->next) {
     /* Check if the incoming fragment matches the one currently present
        in the reassembly buffer. If so, we proceed with copying the
        fragment into the buffer. */
-    if (IP_ADDRESSES_AND_ID_MATCH(&ipr->iphdr, fraghdr)) {
+    if (IP_REASS_KEY_MATCH(&ipr->iphdr, fraghdr)) {
       LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass: matching previous fragment ID=%"X16_F"\n",
         ntohs(IPH_ID(fraghdr))));
       IPFRAG_STATS_INC(ip_frag.cachehit);
@@ -538,13 +527,18 @@ ip_reass(struct pbuf *p)
       goto nullreturn;
     }
   } else {
-    if (((ntohs(IPH_OFFSET(fraghdr)) & IP_OFFMASK) == 0) && 
-      ((ntohs(IPH_OFFSET(&ipr->iphdr)) & IP_OFFMASK) != 0)) {
-      /* ipr->iphdr is not the header from the first fragment, but fraghdr is
-       * -> copy fraghdr into ipr->iphdr since we want to have the header
-       * of the first fragment (for ICMP time exceeded and later, for copying
-       * all options, if supported)*/
-      SMEMCPY(&ipr->iphdr, fraghdr, IP_HLEN);
+    /* a fragment past the end of the datagram or a second, different end
+       of the datagram can't be valid */
+    if ((ipr->flags & IP_REASS_FLAG_LASTFRAG) != 0) {
+      if (((offset + len) > ipr->datagram_len) ||
+          (((IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0) && ((offset + len) != ipr->datagram_len))) {
+        IPFRAG_STATS_INC(ip_frag.proterr);
+        goto nullreturn;
+      }
+    } else if (((IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0) &&
+               ((offset + len) < IP_REASS_HELPER(IP_REASS_LAST(ipr))->end)) {
+      IPFRAG_STATS_INC(ip_frag.proterr);
+      goto nullreturn;
     }
   }
   /* Track the current number of pbufs current 'in-flight', in order to limit 
@@ -554,43 +548,45 @@ ip_reass(struct pbuf *p)
   /* At this point, we have either created a new entry or pointing 
    * to an existing one */
 
-  /* check for 'no more fragments', and update queue entry*/
-  if ((IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0) {
-    ipr->flags |= IP_REASS_FLAG_LASTFRAG;
-    ipr->datagram_len = offset + len;
-    LWIP_DEBUGF(IP_REASS_DEBUG,
-     ("ip_reass: last fragment seen, total len %"S16_F"\n",
-      ipr->datagram_len));
-  }
   /* find the right place to insert this pbuf */
-  /* @todo: trim pbufs if fragments are overlapping */
   if (ip_reass_chain_frag_into_datagram_and_validate(ipr, p)) {
     /* the totally last fragment (flag more fragments = 0) was received at least
      * once AND all fragments are received */
-    ipr->datagram_len += IP_HLEN;
 
-    /* save the second pbuf before copying the header over the pointer */
-    r = ((struct ip_reass_helper*)ipr->p->payload)->next_pbuf;
+    iprh = IP_REASS_HELPER(ipr->frags[0]);
+    hlen = iprh->hlen;
+    LWIP_ASSERT("first fragment header", hlen == IPH_HL(&ipr->iphdr) * 4);
+    if ((u32_t)ipr->datagram_len + hlen > 0xffff) {
+      /* doesn't fit into an IP datagram */
+      IPFRAG_STATS_INC(ip_frag.lenerr);
+      ip_reass_free_complete_datagram(ipr, ipr_prev);
+      return NULL;
+    }
+
+    /* chain together the other fragments, hiding their ip headers; from
+       the back, so that pbuf_cat() only walks each fragment once */
+    r = NULL;
+    for (i = ipr->nfrags - 1; i > 0; i--) {
+      q = ipr->frags[i];
+      pbuf_header(q, -(s16_t)IP_REASS_HELPER(q)->hlen);
+      if (r != NULL) {
+        pbuf_cat(q, r);
+      }
+      r = q;
+    }
 
-    /* copy the original ip header back to the first pbuf */
-    fraghdr = (struct ip_hdr*)(ipr->p->payload);
+    /* copy the original ip header back to the first pbuf, the options
+       following it were never overwritten */
+    p = ipr->frags[0];
+    fraghdr = (struct ip_hdr*)(p->payload);
     SMEMCPY(fraghdr, &ipr->iphdr, IP_HLEN);
-    IPH_LEN_SET(fraghdr, htons(ipr->datagram_len));
+    IPH_LEN_SET(fraghdr, htons(ipr->datagram_len + hlen));
     IPH_OFFSET_SET(fraghdr, 0);
     IPH_CHKSUM_SET(fraghdr, 0);
     /* @todo: do we need to set calculate the correct checksum? */
-    IPH_CHKSUM_SET(fraghdr, inet_chksum(fraghdr, IP_HLEN));
-
-    p = ipr->p;
-
-    /* chain together the pbufs contained within the reass_data list. */
-    while(r != NULL) {
-      iprh = (struct ip_reass_helper*)r->payload;
-
-      /* hide the ip header for every succeding fragment */
-      pbuf_header(r, -IP_HLEN);
+    IPH_CHKSUM_SET(fraghdr, inet_chksum(fraghdr, hlen));
+    if (r != NULL) {
       pbuf_cat(p, r);
-      r = iprh->next_pbuf;
     }
     /* release the sources allocate for the fragment queue entry */
     ip_reass_dequeue_datagram(ipr, ipr_prev);
@@ -614,9 +610,13 @@ nullreturn:
 #endif /* IP_REASSEMBLY */
 
 #if IP_FRAG
-#if IP_FRAG_USES_STATIC_BUF
-static u8_t buf[LWIP_MEM_ALIGN_SIZE(IP_FRAG_MAX_MTU + MEM_ALIGNMENT - 1)];
-#else /* IP_FRAG_USES_STATIC_BUF */
+/** Maximum length of an IP header (including options) */
+#define IP_HLEN_MAX     60
+/** IP option types handled when copying options to fragments */
+#define IP_OPT_EOL      0
+#define IP_OPT_NOP      1
+/** Option type flag: copy this option into all fragments */
+#define IP_OPT_COPIED   0x80
 
 #if !LWIP_NETIF_TX_SINGLE_PBUF
 /** Allocate a new struct pbuf_custom_ref */
@@ -647,15 +647,162 @@ ipfrag_free_pbuf_custom(struct pbuf *p)
   }
   ip_frag_free_pbuf_custom_ref(pcr);
 }
+
+/**
+ * Chain PBUF_REFs to 'len' bytes of the original packet to a fragment.
+ * The slices reference the original pbufs, no data is copied.
+ *
+ * @param rambuf the fragment (holding the link and IP header)
+ * @param q current pbuf of the original packet, updated on return
+ * @param qoff offset into *q of the first byte to reference, updated on return
+ * @param len number of bytes to reference
+ * @return ERR_OK or ERR_MEM (rambuf is not freed in that case)
+ */
+static err_t
+ip_frag_chain_slices(struct pbuf *rambuf, struct pbuf **q, u16_t *qoff, u16_t len)
+{
+  struct pbuf_custom_ref *pcr;
+  struct pbuf *newpbuf;
+  u16_t newpbuflen;
+
+  while (len) {
+    /* Is this pbuf already used up? */
+    if (*qoff >= (*q)->len) {
+      *qoff = 0;
+      *q = (*q)->next;
+      LWIP_ASSERT("ip_frag: packet shorter than tot_len", *q != NULL);
+      continue;
+    }
+    newpbuflen = LWIP_MIN(len, (*q)->len - *qoff);
+    pcr = ip_frag_alloc_pbuf_custom_ref();
+    if (pcr == NULL) {
+      return ERR_MEM;
+    }
+    newpbuf = pbuf_alloced_custom(PBUF_RAW, newpbuflen, PBUF_REF, &pcr->pc,
+      (u8_t *)(*q)->payload + *qoff, newpbuflen);
+    if (newpbuf == NULL) {
+      ip_frag_free_pbuf_custom_ref(pcr);
+      return ERR_MEM;
+    }
+    pbuf_ref(*q);
+    pcr->original = *q;
+    pcr->pc.custom_free_function = ipfrag_free_pbuf_custom;
+
+    /* Add it to end of rambuf's chain, but using pbuf_cat, not pbuf_chain
+     * so that it is removed when pbuf_dechain is later called on rambuf.
+     */
+    pbuf_cat(rambuf, newpbuf);
+    *qoff += newpbuflen;
+    len -= newpbuflen;
+  }
+  return ERR_OK;
+}
 #endif /* !LWIP_NETIF_TX_SINGLE_PBUF */
-#endif /* IP_FRAG_USES_STATIC_BUF */
+
+#if CHECKSUM_GEN_IP
+/**
+ * Incrementally update an IP header checksum after one 16-bit header field
+ * changed from 'oldval' to 'newval' (RFC 1624, eqn. 3). All values are
+ * used as stored in the header, so byte order does not matter.
+ */
+static u16_t
+ip_frag_chksum_adjust(u16_t chksum, u16_t oldval, u16_t newval)
+{
+  u32_t acc;
+
+  acc = (u32_t)(u16_t)~chksum + (u16_t)~oldval + newval;
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)~acc;
+}
+#endif /* CHECKSUM_GEN_IP */
+
+/**
+ * Build the IP header of all but the first fragment: only options having
+ * the 'copied' flag set are kept (RFC 791), padded with EOL.
+ *
+ * @param dst buffer for the new header (at least 'hlen' bytes)
+ * @param src IP header of the original packet
+ * @param hlen length of the original header (including options)
+ * @return length of the new header
+ */
+static u16_t
+ip_frag_copy_options(u8_t *dst, const u8_t *src, u16_t hlen)
+{
+  u16_t i, len, optlen;
+
+  SMEMCPY(dst, src, IP_HLEN);
+  len = IP_HLEN;
+  i = IP_HLEN;
+  while (i < hlen) {
+    if (src[i] == IP_OPT_EOL) {
+      break;
+    }
+    if (src[i] == IP_OPT_NOP) {
+      i++;
+      continue;
+    }
+    optlen = (i + 1 < hlen) ? src[i + 1] : 0;
+    if ((optlen < 2) || (i + optlen > hlen)) {
+      /* malformed option: stop here */
+      break;
+    }
+    if (src[i] & IP_OPT_COPIED) {
+      MEMCPY(dst + len, src + i, optlen);
+      len += optlen;
+    }
+    i += optlen;
+  }
+  while (len & 3) {
+    dst[len++] = IP_OPT_EOL;
+  }
+  IPH_VHL_SET((struct ip_hdr *)dst, 4, len / 4);
+  return len;
+}
+
+/**
+ * Pass a batch of fragments to the netif and free them.
+ * netif->output_batch gets all of them in one call if the netif has one.
+ */
+static void
+ip_frag_output(struct netif *netif, struct pbuf **frags, u8_t num, ip_addr_t *dest)
+{
+  u8_t i;
+
+#if LWIP_NETIF_OUTPUT_BATCH
+  if (netif->output_batch != NULL) {
+    netif->output_batch(netif, frags, num, dest);
+  } else
+#endif /* LWIP_NETIF_OUTPUT_BATCH */
+  {
+    for (i = 0; i < num; i++) {
+      netif->output(netif, frags[i], dest);
+    }
+  }
+  /* Unfortunately we can't reuse the fragments - the hardware may still be
+   * using the buffers. Instead we free them (and the ensuing chains). If
+   * we're lucky the hardware will have already sent the packets, the free
+   * will really free, and there will be zero memory penalty.
+   */
+  for (i = 0; i < num; i++) {
+    IPFRAG_STATS_INC(ip_frag.xmit);
+    snmp_inc_ipfragcreates();
+    pbuf_free(frags[i]);
+  }
+}
 
 /**
  * Fragment an IP datagram if too large for the netif.
  *
- * Chop the datagram in MTU sized chunks and send them in order
- * by using a fixed size static memory buffer (PBUF_REF) or
- * point PBUF_REFs into p (depending on IP_FRAG_USES_STATIC_BUF).
+ * Chop the datagram in MTU sized chunks. Each fragment is a RAM pbuf
+ * holding only the link and IP header, followed by PBUF_REFs pointing into
+ * p (with LWIP_NETIF_TX_SINGLE_PBUF, the data is copied behind the header
+ * instead). The first fragment carries all IP options of p, the others
+ * only those with the 'copied' flag set. Fragment header checksums are
+ * derived incrementally from the first fragment's checksum.
+ *
+ * Fragments are passed to the netif in batches of IP_FRAG_BATCH_SIZE. A
+ * batch is sent early if memory for the next fragment runs out.
  *
  * @param p ip packet to send
  * @param netif the netif on which to send
@@ -666,61 +813,53 @@ ipfrag_free_pbuf_custom(struct pbuf *p)
 err_t 
 ip_frag(struct pbuf *p, struct netif *netif, ip_addr_t *dest)
 {
+  struct pbuf *frags[IP_FRAG_BATCH_SIZE];
   struct pbuf *rambuf;
-#if IP_FRAG_USES_STATIC_BUF
-  struct pbuf *header;
-#else
-#if !LWIP_NETIF_TX_SINGLE_PBUF
-  struct pbuf *newpbuf;
-#endif
-  struct ip_hdr *original_iphdr;
-#endif
   struct ip_hdr *iphdr;
-  u16_t nfb;
+  const u8_t *hdr;
+  /* header of all but the first fragment, aligned for struct ip_hdr */
+  u32_t later_hdr[IP_HLEN_MAX / 4];
+  u16_t hlen, thlen;
   u16_t left, cop;
   u16_t mtu = netif->mtu;
   u16_t ofo, omf;
-  u16_t last;
-  u16_t poff = IP_HLEN;
   u16_t tmp;
-#if !IP_FRAG_USES_STATIC_BUF && !LWIP_NETIF_TX_SINGLE_PBUF
-  u16_t newpbuflen = 0;
-  u16_t left_to_copy;
-#endif
-
-  /* Get a RAM based MTU sized pbuf */
-#if IP_FRAG_USES_STATIC_BUF
-  /* When using a static buffer, we use a PBUF_REF, which we will
-   * use to reference the packet (without link header).
-   * Layer and length is irrelevant.
-   */
-  rambuf = pbuf_alloc(PBUF_LINK, 0, PBUF_REF);
-  if (rambuf == NULL) {
-    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_frag: pbuf_alloc(PBUF_LINK, 0, PBUF_REF) failed\n"));
-    return ERR_MEM;
-  }
-  rambuf->tot_len = rambuf->len = mtu;
-  rambuf->payload = LWIP_MEM_ALIGN((void *)buf);
+  u8_t last, num = 0;
+#if CHECKSUM_GEN_IP
+  u16_t chk_base = 0, len_base = 0, off_base = 0;
+  u8_t chk_valid = 0;
+#endif /* CHECKSUM_GEN_IP */
+#if LWIP_NETIF_TX_SINGLE_PBUF
+  u16_t poff;
+#else /* LWIP_NETIF_TX_SINGLE_PBUF */
+  struct pbuf *q, *qstart;
+  u16_t qoff, qoffstart;
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
-  /* Copy the IP header in it */
-  iphdr = (struct ip_hdr *)rambuf->payload;
-  SMEMCPY(iphdr, p->payload, IP_HLEN);
-#else /* IP_FRAG_USES_STATIC_BUF */
-  original_iphdr = (struct ip_hdr *)p->payload;
-  iphdr = original_iphdr;
-#endif /* IP_FRAG_USES_STATIC_BUF */
+  iphdr = (struct ip_hdr *)p->payload;
+  hlen = IPH_HL(iphdr) * 4;
+  LWIP_ERROR("ip_frag: IP header must be in one piece",
+    (hlen >= IP_HLEN) && (p->len >= hlen), return ERR_VAL;);
+  LWIP_ERROR("ip_frag: MTU too small", mtu >= hlen + 8, return ERR_VAL;);
 
   /* Save original offset */
   tmp = ntohs(IPH_OFFSET(iphdr));
   ofo = tmp & IP_OFFMASK;
   omf = tmp & IP_MF;
 
-  left = p->tot_len - IP_HLEN;
-
-  nfb = (mtu - IP_HLEN) / 8;
+  left = p->tot_len - hlen;
+  /* the first fragment uses the original header */
+  hdr = (const u8_t *)p->payload;
+  thlen = hlen;
+#if LWIP_NETIF_TX_SINGLE_PBUF
+  poff = hlen;
+#else /* LWIP_NETIF_TX_SINGLE_PBUF */
+  q = p;
+  qoff = hlen;
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
   while (left) {
-    last = (left <= mtu - IP_HLEN);
+    last = (left <= mtu - thlen);
 
     /* Set new offset and MF flag */
     tmp = omf | (IP_OFFMASK & (ofo));
@@ -729,135 +868,97 @@ ip_frag(struct pbuf *p, struct netif *netif, ip_addr_t *dest)
     }
 
     /* Fill this fragment */
-    cop = last ? left : nfb * 8;
+    cop = last ? left : (u16_t)((mtu - thlen) & ~7);
 
-#if IP_FRAG_USES_STATIC_BUF
-    poff += pbuf_copy_partial(p, (u8_t*)iphdr + IP_HLEN, cop, poff);
-#else /* IP_FRAG_USES_STATIC_BUF */
 #if LWIP_NETIF_TX_SINGLE_PBUF
-    rambuf = pbuf_alloc(PBUF_IP, cop, PBUF_RAM);
-    if (rambuf == NULL) {
-      return ERR_MEM;
+    /* One PBUF_RAM for the IP header (options included) and the data. A
+     * PBUF_IP pbuf would only have room for IP_HLEN bytes of header. */
+    rambuf = pbuf_alloc(PBUF_LINK, thlen + cop, PBUF_RAM);
+    if (rambuf != NULL) {
+      LWIP_ASSERT("this needs a pbuf in one piece!",
+        (rambuf->len == rambuf->tot_len) && (rambuf->next == NULL));
+      SMEMCPY(rambuf->payload, hdr, thlen);
+      pbuf_copy_partial(p, (u8_t *)rambuf->payload + thlen, cop, poff);
+      poff += cop;
     }
-    LWIP_ASSERT("this needs a pbuf in one piece!",
-      (rambuf->len == rambuf->tot_len) && (rambuf->next == NULL));
-    poff += pbuf_copy_partial(p, rambuf->payload, cop, poff);
-    /* make room for the IP header */
-    if(pbuf_header(rambuf, IP_HLEN)) {
-      pbuf_free(rambuf);
-      return ERR_MEM;
-    }
-    /* fill in the IP header */
-    SMEMCPY(rambuf->payload, original_iphdr, IP_HLEN);
-    iphdr = rambuf->payload;
 #else /* LWIP_NETIF_TX_SINGLE_PBUF */
-    /* When not using a static buffer, create a chain of pbufs.
-     * The first will be a PBUF_RAM holding the link and IP header.
-     * The rest will be PBUF_REFs mirroring the pbuf chain to be fragged,
-     * but limited to the size of an mtu.
-     */
-    rambuf = pbuf_alloc(PBUF_LINK, IP_HLEN, PBUF_RAM);
-    if (rambuf == NULL) {
-      return ERR_MEM;
-    }
-    LWIP_ASSERT("this needs a pbuf in one piece!",
-                (p->len >= (IP_HLEN)));
-    SMEMCPY(rambuf->payload, original_iphdr, IP_HLEN);
-    iphdr = (struct ip_hdr *)rambuf->payload;
-
-    /* Can just adjust p directly for needed offset. */
-    p->payload = (u8_t *)p->payload + poff;
-    p->len -= poff;
-
-    left_to_copy = cop;
-    while (left_to_copy) {
-      struct pbuf_custom_ref *pcr;
-      newpbuflen = (left_to_copy < p->len) ? left_to_copy : p->len;
-      /* Is this pbuf already empty? */
-      if (!newpbuflen) {
-        p = p->next;
-        continue;
-      }
-      pcr = ip_frag_alloc_pbuf_custom_ref();
-      if (pcr == NULL) {
+    /* The first pbuf is a PBUF_RAM holding the link and IP header only,
+     * the rest are PBUF_REFs mirroring the slice of the original chain. */
+    rambuf = pbuf_alloc(PBUF_LINK, thlen, PBUF_RAM);
+    if (rambuf != NULL) {
+      SMEMCPY(rambuf->payload, hdr, thlen);
+      qstart = q;
+      qoffstart = qoff;
+      if (ip_frag_chain_slices(rambuf, &q, &qoff, cop) != ERR_OK) {
         pbuf_free(rambuf);
-        return ERR_MEM;
-      }
-      /* Mirror this pbuf, although we might not need all of it. */
-      newpbuf = pbuf_alloced_custom(PBUF_RAW, newpbuflen, PBUF_REF, &pcr->pc, p->payload, newpbuflen);
-      if (newpbuf == NULL) {
-        ip_frag_free_pbuf_custom_ref(pcr);
-        pbuf_free(rambuf);
-        return ERR_MEM;
-      }
-      pbuf_ref(p);
-      pcr->original = p;
-      pcr->pc.custom_free_function = ipfrag_free_pbuf_custom;
-
-      /* Add it to end of rambuf's chain, but using pbuf_cat, not pbuf_chain
-       * so that it is removed when pbuf_dechain is later called on rambuf.
-       */
-      pbuf_cat(rambuf, newpbuf);
-      left_to_copy -= newpbuflen;
-      if (left_to_copy) {
-        p = p->next;
+        rambuf = NULL;
+        q = qstart;
+        qoff = qoffstart;
       }
     }
-    poff = newpbuflen;
 #endif /* LWIP_NETIF_TX_SINGLE_PBUF */
-#endif /* IP_FRAG_USES_STATIC_BUF */
+    if (rambuf == NULL) {
+      if (num == 0) {
+        goto memerr;
+      }
+      /* A fragment needs one FRAG_PBUF per pbuf of p it spans, so a batch
+       * can run out before it is full: send the fragments built so far to
+       * release their memory, then build this fragment again. */
+      ip_frag_output(netif, frags, num, dest);
+      num = 0;
+      continue;
+    }
+    iphdr = (struct ip_hdr *)rambuf->payload;
 
     /* Correct header */
     IPH_OFFSET_SET(iphdr, htons(tmp));
-    IPH_LEN_SET(iphdr, htons(cop + IP_HLEN));
-    IPH_CHKSUM_SET(iphdr, 0);
-    IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
-
-#if IP_FRAG_USES_STATIC_BUF
-    if (last) {
-      pbuf_realloc(rambuf, left + IP_HLEN);
+    IPH_LEN_SET(iphdr, htons(cop + thlen));
+#if CHECKSUM_GEN_IP
+    if (!chk_valid) {
+      /* first fragment with this header: full checksum, the others only
+         differ in offset and length */
+      IPH_CHKSUM_SET(iphdr, 0);
+      chk_base = inet_chksum(iphdr, thlen);
+      len_base = IPH_LEN(iphdr);
+      off_base = IPH_OFFSET(iphdr);
+      chk_valid = 1;
+      IPH_CHKSUM_SET(iphdr, chk_base);
+    } else {
+      IPH_CHKSUM_SET(iphdr, ip_frag_chksum_adjust(
+        ip_frag_chksum_adjust(chk_base, len_base, IPH_LEN(iphdr)),
+        off_base, IPH_OFFSET(iphdr)));
     }
+#else /* CHECKSUM_GEN_IP */
+    IPH_CHKSUM_SET(iphdr, 0);
+#endif /* CHECKSUM_GEN_IP */
 
-    /* This part is ugly: we alloc a RAM based pbuf for 
-     * the link level header for each chunk and then 
-     * free it.A PBUF_ROM style pbuf for which pbuf_header
-     * worked would make things simpler.
-     */
-    header = pbuf_alloc(PBUF_LINK, 0, PBUF_RAM);
-    if (header != NULL) {
-      pbuf_chain(header, rambuf);
-      netif->output(netif, header, dest);
-      IPFRAG_STATS_INC(ip_frag.xmit);
-      snmp_inc_ipfragcreates();
-      pbuf_free(header);
-    } else {
-      LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_frag: pbuf_alloc() for header failed\n"));
-      pbuf_free(rambuf);
-      return ERR_MEM;
+    frags[num++] = rambuf;
+    if ((num == IP_FRAG_BATCH_SIZE) || last) {
+      ip_frag_output(netif, frags, num, dest);
+      num = 0;
     }
-#else /* IP_FRAG_USES_STATIC_BUF */
-    /* No need for separate header pbuf - we allowed room for it in rambuf
-     * when allocated.
-     */
-    netif->output(netif, rambuf, dest);
-    IPFRAG_STATS_INC(ip_frag.xmit);
 
-    /* Unfortunately we can't reuse rambuf - the hardware may still be
-     * using the buffer. Instead we free it (and the ensuing chain) and
-     * recreate it next time round the loop. If we're lucky the hardware
-     * will have already sent the packet, the free will really free, and
-     * there will be zero memory penalty.
-     */
-    
-    pbuf_free(rambuf);
-#endif /* IP_FRAG_USES_STATIC_BUF */
     left -= cop;
-    ofo += nfb;
+    ofo += cop / 8;
+
+    if ((hdr == (const u8_t *)p->payload) && (hlen > IP_HLEN)) {
+      /* the following fragments only carry the copied options */
+      thlen = ip_frag_copy_options((u8_t *)later_hdr, hdr, hlen);
+      hdr = (const u8_t *)later_hdr;
+#if CHECKSUM_GEN_IP
+      chk_valid = 0;
+#endif /* CHECKSUM_GEN_IP */
+    }
   }
-#if IP_FRAG_USES_STATIC_BUF
-  pbuf_free(rambuf);
-#endif /* IP_FRAG_USES_STATIC_BUF */
   snmp_inc_ipfragoks();
   return ERR_OK;
+
+memerr:
+  /* Not even one fragment could be built with all earlier ones sent, so
+   * there is nothing left to free: the datagram just ends here. */
+  LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_frag: out of memory\n"));
+  IPFRAG_STATS_INC(ip_frag.memerr);
+  snmp_inc_ipfragfails();
+  return ERR_MEM;
 }
 #endif /* IP_FRAG */
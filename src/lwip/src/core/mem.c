@@ -211,6 +211,11 @@ void mem_init(void)
 
     /* 初始化最低可用指针以指向堆的开始 */
     lfree = (struct mem *)(void *)ram;
+
+    if (sys_mutex_new(&mem_mutex) != ERR_OK)
+    {
+        LWIP_ASSERT("failed to create mem_mutex", 0);
+    }
 }
 
 /**
@@ -117,6 +117,7 @@ void memp_init(void)
     struct memp *memp;
     u16_t i, j;
 
+    memp = (struct memp *)LWIP_MEM_ALIGN(memp_memory);
     /* for every pool: */
     for (i = 0; i < MEMP_MAX; ++i)
     {
@@ -60,6 +60,8 @@
 #include "lwip/dhcp.h"
 #endif /* LWIP_DHCP */
 
+#include <string.h>
+
 #if LWIP_NETIF_STATUS_CALLBACK
 #define NETIF_STATUS_CALLBACK(n) do{ if (n->status_callback) { (n->status_callback)(n); }}while(0)
 #else
@@ -135,6 +137,17 @@ struct netif *netif_add(struct netif *netif, ip_addr_t *ipaddr, ip_addr_t *netma
     netif->state = state;
     netif->num = netif_num++;
     netif->input = input;
+#if LWIP_DHCP
+    /* netif not under DHCP control by default */
+    netif->dhcp = NULL;
+#endif /* LWIP_DHCP */
+#if LWIP_NETIF_OUTPUT_BATCH
+    netif->output_batch = NULL;
+#endif /* LWIP_NETIF_OUTPUT_BATCH */
+#if LWIP_IGMP
+    netif->igmp_mac_filter = NULL;
+    memset(netif->igmp_groups, 0, sizeof(netif->igmp_groups));
+#endif /* LWIP_IGMP */
     NETIF_SET_HWADDRHINT(netif, NULL);
 
     netif_set_addr(netif, ipaddr, netmask, gw);
@@ -150,6 +163,14 @@ struct netif *netif_add(struct netif *netif, ip_addr_t *ipaddr, ip_addr_t *netma
     netif_list = netif;
     snmp_inc_iflist();
 
+#if LWIP_IGMP
+    /* start IGMP processing */
+    if (netif->flags & NETIF_FLAG_IGMP)
+    {
+        igmp_start(netif);
+    }
+#endif /* LWIP_IGMP */
+
     return netif;
 }
 
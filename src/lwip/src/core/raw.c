@@ -48,6 +48,7 @@
 #include "lwip/netif.h"
 #include "lwip/raw.h"
 #include "lwip/stats.h"
+#include "lwip/bpf.h"
 #include "arch/perf.h"
 
 #include <string.h>
@@ -97,6 +98,10 @@ raw_input(struct pbuf *p, struct netif *inp)
       /* broadcast filter? */
       if (ip_get_option(pcb, SOF_BROADCAST) || !ip_addr_isbroadcast(&current_iphdr_dest, inp))
 #endif /* IP_SOF_BROADCAST_RECV */
+#if LWIP_BPF
+      /* packet filter? */
+      if ((pcb->filter == NULL) || (bpf_filter(pcb->filter, p) != 0))
+#endif /* LWIP_BPF */
       {
         /* receive callback function available? */
         if (pcb->recv != NULL) {
@@ -187,6 +192,29 @@ raw_recv(struct raw_pcb *pcb, raw_recv_fn recv, void *recv_arg)
   pcb->recv_arg = recv_arg;
 }
 
+#if LWIP_BPF
+/**
+ * Attach a packet filter to a raw pcb. The program is run over each
+ * packet (from the IP header on) that matches the pcb's protocol and
+ * address, and only if it returns non-zero is the packet passed to the
+ * receive callback. Rejected packets are left for other pcbs.
+ *
+ * @param pcb the raw pcb
+ * @param prog the program, NULL to remove the filter. It is not copied.
+ * @return ERR_OK, or ERR_VAL if the program is invalid (the previous
+ *         filter is kept then)
+ */
+err_t
+raw_filter(struct raw_pcb *pcb, const struct bpf_program *prog)
+{
+  if ((prog != NULL) && (bpf_validate(prog) != ERR_OK)) {
+    return ERR_VAL;
+  }
+  pcb->filter = prog;
+  return ERR_OK;
+}
+#endif /* LWIP_BPF */
+
 /**
  * Send the raw IP packet to the given address. Note that actually you cannot
  * modify the IP headers (this is inconsistent with the receive callback where
@@ -0,0 +1,246 @@
+/**
+ * @file
+ * Entropy pool module
+ *
+ * Random words are taken from a pool that rng_refill() tops up from an
+ * entropy source (a hardware RNG, see rng_set_source()), so a caller on
+ * the connection path only pays for a copy. When the pool is empty and
+ * the source can't deliver, a deterministic xorshift generator steps in;
+ * it is also what the host unit tests run on (see rng_seed()). It is not
+ * unpredictable by itself: the fallback counter in rng_stats shows how
+ * often it had to be used.
+ *
+ */
+
+/*
+ * Copyright (c) 2001-2004 Swedish Institute of Computer Science.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT 
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING 
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#include "lwip/opt.h"
+
+#if LWIP_RNG /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/rng.h"
+#include "lwip/sys.h"
+
+struct rng_stats rng_stats;
+
+static rng_source_fn rng_source;
+static u32_t rng_pool[RNG_POOL_SIZE];
+static u16_t rng_avail;
+/** xorshift128 state of the deterministic generator, never all zero */
+static u32_t rng_state[4] = { 123456789UL, 362436069UL, 521288629UL, 88675123UL };
+
+/**
+ * Select the entropy source that refills the pool and fill it.
+ *
+ * @param source function delivering one random word, NULL to use the
+ *        deterministic generator only
+ */
+void
+rng_set_source(rng_source_fn source)
+{
+  rng_source = source;
+  rng_refill();
+}
+
+/**
+ * Top the pool up from the entropy source. Can be called from an idle
+ * loop so that rng_u32() never has to wait for the source.
+ *
+ * @return number of words in the pool
+ */
+u16_t
+rng_refill(void)
+{
+  u32_t word;
+  u16_t avail;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if (rng_source == NULL) {
+    return rng_avail;
+  }
+  for (;;) {
+    SYS_ARCH_PROTECT(lev);
+    avail = rng_avail;
+    SYS_ARCH_UNPROTECT(lev);
+    if (avail >= RNG_POOL_SIZE) {
+      break;
+    }
+    if (rng_source(&word) != ERR_OK) {
+      rng_stats.errors++;
+      break;
+    }
+    SYS_ARCH_PROTECT(lev);
+    if (rng_avail < RNG_POOL_SIZE) {
+      rng_pool[rng_avail++] = word;
+    }
+    /* stir the source into the fallback generator as well */
+    rng_state[0] ^= word;
+    if ((rng_state[0] | rng_state[1] | rng_state[2] | rng_state[3]) == 0) {
+      rng_state[0] = 1;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+    rng_stats.refills++;
+  }
+  return avail;
+}
+
+/**
+ * Reseed the deterministic generator and drop the pooled words. The host
+ * unit tests use this to make port and ISN choices repeatable.
+ */
+void
+rng_seed(u32_t seed)
+{
+  u8_t i;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  for (i = 0; i < 4; i++) {
+    /* one LCG step per word, the low bit keeps the state non-zero */
+    seed = seed * 1664525UL + 1013904223UL;
+    rng_state[i] = seed | 1;
+  }
+  rng_avail = 0;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+/** Next word of the xorshift128 generator, called with the pool protected */
+static u32_t
+rng_xorshift(void)
+{
+  u32_t t = rng_state[0] ^ (rng_state[0] << 11);
+
+  rng_state[0] = rng_state[1];
+  rng_state[1] = rng_state[2];
+  rng_state[2] = rng_state[3];
+  rng_state[3] = rng_state[3] ^ (rng_state[3] >> 19) ^ t ^ (t >> 8);
+  return rng_state[3];
+}
+
+/**
+ * Get a random word: from the pool if possible, otherwise from the
+ * deterministic generator (counted in rng_stats.fallback).
+ */
+u32_t
+rng_u32(void)
+{
+  u32_t r;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if (rng_avail == 0) {
+    rng_refill();
+  }
+  SYS_ARCH_PROTECT(lev);
+  if (rng_avail != 0) {
+    r = rng_pool[--rng_avail];
+    /* don't leave handed out words behind */
+    rng_pool[rng_avail] = 0;
+  } else {
+    r = rng_xorshift();
+    rng_stats.fallback++;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+  return r;
+}
+
+/** Fill 'len' bytes at 'buf' with random data */
+void
+rng_bytes(void *buf, u16_t len)
+{
+  u8_t *p = (u8_t *)buf;
+  u32_t r = 0;
+  u16_t i;
+
+  for (i = 0; i < len; i++) {
+    if ((i & 3) == 0) {
+      r = rng_u32();
+    }
+    p[i] = (u8_t)r;
+    r >>= 8;
+  }
+}
+
+#define RNG_ROTL(x, b) (u32_t)(((x) << (b)) | ((x) >> (32 - (b))))
+
+#define RNG_SIPROUND(v0, v1, v2, v3)                     \
+  do {                                                    \
+    v0 += v1; v1 = RNG_ROTL(v1, 5);  v1 ^= v0; v0 = RNG_ROTL(v0, 16); \
+    v2 += v3; v3 = RNG_ROTL(v3, 8);  v3 ^= v2;            \
+    v0 += v3; v3 = RNG_ROTL(v3, 7);  v3 ^= v0;            \
+    v2 += v1; v1 = RNG_ROTL(v1, 13); v1 ^= v2; v2 = RNG_ROTL(v2, 16); \
+  } while (0)
+
+/**
+ * HalfSipHash-2-4 (32 bit output): a keyed pseudo random function built
+ * on 32 bit additions and rotations only, used for the RFC 6528 ISNs.
+ *
+ * @param key the secret 64 bit key (key[0] holds the first four key bytes,
+ *        little endian)
+ * @param data the bytes to hash
+ * @param len number of bytes
+ * @return the 32 bit hash
+ */
+u32_t
+rng_hash(const u32_t key[2], const void *data, u16_t len)
+{
+  const u8_t *in = (const u8_t *)data;
+  u32_t v0 = key[0];
+  u32_t v1 = key[1];
+  u32_t v2 = 0x6c796765UL ^ key[0];
+  u32_t v3 = 0x74656462UL ^ key[1];
+  u32_t b = (u32_t)len << 24;
+  u32_t m;
+
+  for (; len >= 4; len -= 4, in += 4) {
+    m = in[0] | ((u32_t)in[1] << 8) | ((u32_t)in[2] << 16) | ((u32_t)in[3] << 24);
+    v3 ^= m;
+    RNG_SIPROUND(v0, v1, v2, v3);
+    RNG_SIPROUND(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+  switch (len) {
+  case 3: b |= (u32_t)in[2] << 16; /* fall through */
+  case 2: b |= (u32_t)in[1] << 8;  /* fall through */
+  case 1: b |= in[0];
+  default: break;
+  }
+  v3 ^= b;
+  RNG_SIPROUND(v0, v1, v2, v3);
+  RNG_SIPROUND(v0, v1, v2, v3);
+  v0 ^= b;
+  v2 ^= 0xff;
+  RNG_SIPROUND(v0, v1, v2, v3);
+  RNG_SIPROUND(v0, v1, v2, v3);
+  RNG_SIPROUND(v0, v1, v2, v3);
+  RNG_SIPROUND(v0, v1, v2, v3);
+  return v1 ^ v3;
+}
+
+#endif /* LWIP_RNG */
@@ -141,7 +141,7 @@ snmp_asn1_enc_s32t_cnt(s32_t value, u16_t *octets_needed)
 void
 snmp_asn1_enc_oid_cnt(u8_t ident_len, s32_t *ident, u16_t *octets_needed)
 {
-  s32_t sub_id;
+  u32_t sub_id;
   u8_t cnt;
 
   cnt = 0;
@@ -155,7 +155,7 @@ snmp_asn1_enc_oid_cnt(u8_t ident_len, s32_t *ident, u16_t *octets_needed)
   while(ident_len > 0)
   {
     ident_len--;
-    sub_id = *ident;
+    sub_id = (u32_t)*ident;
 
     sub_id >>= 7;
     cnt++;
@@ -170,127 +170,293 @@ snmp_asn1_enc_oid_cnt(u8_t ident_len, s32_t *ident, u16_t *octets_needed)
 }
 
 /**
- * Encodes ASN type field into a pbuf chained ASN1 msg.
+ * Positions an encoding stream at an offset within a pbuf chain.
  *
- * @param p points to output pbuf to encode value into
+ * @param st points to the stream to initialize
+ * @param p points to output pbuf chain
  * @param ofs points to the offset within the pbuf chain
+ * @return ERR_OK if successfull, ERR_ARG if ofs is beyond the chain
+ */
+err_t
+snmp_asn1_stream_init(struct snmp_asn1_stream *st, struct pbuf *p, u16_t ofs)
+{
+  while ((p != NULL) && (ofs >= p->len))
+  {
+    ofs -= p->len;
+    p = p->next;
+  }
+  st->p = p;
+  st->ofs = ofs;
+  return (p != NULL) ? ERR_OK : ERR_ARG;
+}
+
+/**
+ * Writes one octet at the stream position and advances it.
+ */
+static err_t
+snmp_asn1_stream_put(struct snmp_asn1_stream *st, u8_t octet)
+{
+  while ((st->p != NULL) && (st->ofs >= st->p->len))
+  {
+    /* next octet in next pbuf */
+    st->p = st->p->next;
+    st->ofs = 0;
+  }
+  if (st->p == NULL)
+  {
+    return ERR_ARG;
+  }
+  ((u8_t*)st->p->payload)[st->ofs] = octet;
+  st->ofs++;
+  return ERR_OK;
+}
+
+/**
+ * Encodes ASN type field at the stream position.
+ *
+ * @param st points to the output stream
  * @param type input ASN1 type
  * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
  */
 err_t
-snmp_asn1_enc_type(struct pbuf *p, u16_t ofs, u8_t type)
+snmp_asn1_stream_enc_type(struct snmp_asn1_stream *st, u8_t type)
+{
+  return snmp_asn1_stream_put(st, type);
+}
+
+/**
+ * Encodes host order length field at the stream position.
+ *
+ * @param st points to the output stream
+ * @param length is the host order length to be encoded
+ * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ */
+err_t
+snmp_asn1_stream_enc_length(struct snmp_asn1_stream *st, u16_t length)
 {
-  u16_t plen, base;
-  u8_t *msg_ptr;
+  err_t err;
 
-  plen = 0;
-  while (p != NULL)
+  if (length < 0x80)
+  {
+    return snmp_asn1_stream_put(st, (u8_t)length);
+  }
+  else if (length < 0x100)
+  {
+    err = snmp_asn1_stream_put(st, 0x81);
+  }
+  else
   {
-    base = plen;
-    plen += p->len;
-    if (ofs < plen)
+    /* length >= 0x100 && length <= 0xFFFF */
+    err = snmp_asn1_stream_put(st, 0x82);
+    if (err == ERR_OK)
     {
-      msg_ptr = (u8_t*)p->payload;
-      msg_ptr += ofs - base;
-      *msg_ptr = type;
-      return ERR_OK;
+      /* most significant length octet */
+      err = snmp_asn1_stream_put(st, (u8_t)(length >> 8));
     }
-    p = p->next;
   }
-  /* p == NULL, ofs >= plen */
-  return ERR_ARG;
+  if (err == ERR_OK)
+  {
+    /* least significant length octet */
+    err = snmp_asn1_stream_put(st, (u8_t)length);
+  }
+  return err;
 }
 
 /**
- * Encodes host order length field into a pbuf chained ASN1 msg.
+ * Encodes u32_t (counter, gauge, timeticks) at the stream position.
  *
- * @param p points to output pbuf to encode length into
- * @param ofs points to the offset within the pbuf chain
- * @param length is the host order length to be encoded
+ * @param st points to the output stream
+ * @param octets_needed encoding length (from snmp_asn1_enc_u32t_cnt())
+ * @param value is the host order u32_t value to be encoded
  * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ *
+ * @see snmp_asn1_enc_u32t_cnt()
  */
 err_t
-snmp_asn1_enc_length(struct pbuf *p, u16_t ofs, u16_t length)
+snmp_asn1_stream_enc_u32t(struct snmp_asn1_stream *st, u16_t octets_needed, u32_t value)
+{
+  if (octets_needed == 5)
+  {
+    /* not enough bits in 'value' add leading 0x00 */
+    octets_needed--;
+    if (snmp_asn1_stream_put(st, 0x00) != ERR_OK)
+    {
+      return ERR_ARG;
+    }
+  }
+  while (octets_needed > 0)
+  {
+    octets_needed--;
+    if (snmp_asn1_stream_put(st, (u8_t)(value >> (octets_needed << 3))) != ERR_OK)
+    {
+      return ERR_ARG;
+    }
+  }
+  return ERR_OK;
+}
+
+/**
+ * Encodes s32_t integer at the stream position.
+ *
+ * @param st points to the output stream
+ * @param octets_needed encoding length (from snmp_asn1_enc_s32t_cnt())
+ * @param value is the host order s32_t value to be encoded
+ * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ *
+ * @see snmp_asn1_enc_s32t_cnt()
+ */
+err_t
+snmp_asn1_stream_enc_s32t(struct snmp_asn1_stream *st, u16_t octets_needed, s32_t value)
+{
+  while (octets_needed > 0)
+  {
+    octets_needed--;
+    if (snmp_asn1_stream_put(st, (u8_t)(value >> (octets_needed << 3))) != ERR_OK)
+    {
+      return ERR_ARG;
+    }
+  }
+  return ERR_OK;
+}
+
+/**
+ * Encodes object identifier at the stream position.
+ *
+ * @param st points to the output stream
+ * @param ident_len object identifier array length
+ * @param ident points to object identifier array
+ * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ */
+err_t
+snmp_asn1_stream_enc_oid(struct snmp_asn1_stream *st, u8_t ident_len, s32_t *ident)
 {
-  u16_t plen, base;
-  u8_t *msg_ptr;
+  u8_t prefix;
 
-  plen = 0;
-  while (p != NULL)
+  if (ident_len > 1)
+  {
+    if ((ident[0] == 1) && (ident[1] == 3))
+    {
+      /* compressed (most common) prefix .iso.org */
+      prefix = 0x2b;
+    }
+    else
+    {
+      /* calculate prefix */
+      prefix = (u8_t)((ident[0] * 40) + ident[1]);
+    }
+    if (snmp_asn1_stream_put(st, prefix) != ERR_OK)
+    {
+      return ERR_ARG;
+    }
+    ident_len -= 2;
+    ident += 2;
+  }
+  else
   {
-    base = plen;
-    plen += p->len;
-    if (ofs < plen)
+/* @bug:  allow empty varbinds for symmetry (we must decode them for getnext), allow partial compression??  */
+    /* ident_len <= 1, at least we need zeroDotZero (0.0) (ident_len == 2) */
+    return ERR_ARG;
+  }
+  while (ident_len > 0)
+  {
+    u32_t sub_id;
+    u8_t shift, tail;
+
+    ident_len--;
+    sub_id = (u32_t)*ident;
+    tail = 0;
+    shift = 28;
+    while(shift > 0)
     {
-      msg_ptr = (u8_t*)p->payload;
-      msg_ptr += ofs - base;
+      u8_t code;
 
-      if (length < 0x80)
-      {
-        *msg_ptr = (u8_t)length;
-        return ERR_OK;
-      }
-      else if (length < 0x100)
+      code = (u8_t)((sub_id >> shift) & 0x7F);
+      if ((code != 0) || (tail != 0))
       {
-        *msg_ptr = 0x81;
-        ofs += 1;
-        if (ofs >= plen)
+        tail = 1;
+        if (snmp_asn1_stream_put(st, code | 0x80) != ERR_OK)
         {
-          /* next octet in next pbuf */
-          p = p->next;
-          if (p == NULL) { return ERR_ARG; }
-          msg_ptr = (u8_t*)p->payload;
+          return ERR_ARG;
         }
-        else
-        {
-          /* next octet in same pbuf */
-          msg_ptr++;
-        }
-        *msg_ptr = (u8_t)length;
-        return ERR_OK;
       }
-      else
-      {
-        u8_t i;
+      shift -= 7;
+    }
+    if (snmp_asn1_stream_put(st, (u8_t)sub_id & 0x7F) != ERR_OK)
+    {
+      return ERR_ARG;
+    }
+    /* proceed to next sub-identifier */
+    ident++;
+  }
+  return ERR_OK;
+}
 
-        /* length >= 0x100 && length <= 0xFFFF */
-        *msg_ptr = 0x82;
-        i = 2;
-        while (i > 0)
-        {
-          i--;
-          ofs += 1;
-          if (ofs >= plen)
-          {
-            /* next octet in next pbuf */
-            p = p->next;
-            if (p == NULL) { return ERR_ARG; }
-            msg_ptr = (u8_t*)p->payload;
-            plen += p->len;
-          }
-          else
-          {
-            /* next octet in same pbuf */
-            msg_ptr++;
-          }
-          if (i == 0)
-          {
-            /* least significant length octet */
-            *msg_ptr = (u8_t)length;
-          }
-          else
-          {
-            /* most significant length octet */
-            *msg_ptr = (u8_t)(length >> 8);
-          }
-        }
-        return ERR_OK;
-      }
+/**
+ * Encodes raw data (octet string, opaque) at the stream position.
+ *
+ * @param st points to the output stream
+ * @param raw_len raw data length
+ * @param raw points raw data
+ * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ */
+err_t
+snmp_asn1_stream_enc_raw(struct snmp_asn1_stream *st, u16_t raw_len, u8_t *raw)
+{
+  u16_t chunk;
+
+  while (raw_len > 0)
+  {
+    while ((st->p != NULL) && (st->ofs >= st->p->len))
+    {
+      st->p = st->p->next;
+      st->ofs = 0;
     }
-    p = p->next;
+    if (st->p == NULL)
+    {
+      return ERR_ARG;
+    }
+    /* copy as much as fits into this pbuf */
+    chunk = LWIP_MIN(raw_len, st->p->len - st->ofs);
+    MEMCPY((u8_t*)st->p->payload + st->ofs, raw, chunk);
+    st->ofs += chunk;
+    raw += chunk;
+    raw_len -= chunk;
   }
-  /* p == NULL, ofs >= plen */
-  return ERR_ARG;
+  return ERR_OK;
+}
+
+/**
+ * Encodes ASN type field into a pbuf chained ASN1 msg.
+ *
+ * @param p points to output pbuf to encode value into
+ * @param ofs points to the offset within the pbuf chain
+ * @param type input ASN1 type
+ * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ */
+err_t
+snmp_asn1_enc_type(struct pbuf *p, u16_t ofs, u8_t type)
+{
+  struct snmp_asn1_stream st;
+
+  snmp_asn1_stream_init(&st, p, ofs);
+  return snmp_asn1_stream_enc_type(&st, type);
+}
+
+/**
+ * Encodes host order length field into a pbuf chained ASN1 msg.
+ *
+ * @param p points to output pbuf to encode length into
+ * @param ofs points to the offset within the pbuf chain
+ * @param length is the host order length to be encoded
+ * @return ERR_OK if successfull, ERR_ARG if we can't (or won't) encode
+ */
+err_t
+snmp_asn1_enc_length(struct pbuf *p, u16_t ofs, u16_t length)
+{
+  struct snmp_asn1_stream st;
+
+  snmp_asn1_stream_init(&st, p, ofs);
+  return snmp_asn1_stream_enc_length(&st, length);
 }
 
 /**
@@ -307,66 +473,10 @@ snmp_asn1_enc_length(struct pbuf *p, u16_t ofs, u16_t length)
 err_t
 snmp_asn1_enc_u32t(struct pbuf *p, u16_t ofs, u16_t octets_needed, u32_t value)
 {
-  u16_t plen, base;
-  u8_t *msg_ptr;
-
-  plen = 0;
-  while (p != NULL)
-  {
-    base = plen;
-    plen += p->len;
-    if (ofs < plen)
-    {
-      msg_ptr = (u8_t*)p->payload;
-      msg_ptr += ofs - base;
+  struct snmp_asn1_stream st;
 
-      if (octets_needed == 5)
-      {
-        /* not enough bits in 'value' add leading 0x00 */
-        octets_needed--;
-        *msg_ptr = 0x00;
-        ofs += 1;
-        if (ofs >= plen)
-        {
-          /* next octet in next pbuf */
-          p = p->next;
-          if (p == NULL) { return ERR_ARG; }
-          msg_ptr = (u8_t*)p->payload;
-          plen += p->len;
-        }
-        else
-        {
-          /* next octet in same pbuf */
-          msg_ptr++;
-        }
-      }
-      while (octets_needed > 1)
-      {
-        octets_needed--;
-        *msg_ptr = (u8_t)(value >> (octets_needed << 3));
-        ofs += 1;
-        if (ofs >= plen)
-        {
-          /* next octet in next pbuf */
-          p = p->next;
-          if (p == NULL) { return ERR_ARG; }
-          msg_ptr = (u8_t*)p->payload;
-          plen += p->len;
-        }
-        else
-        {
-          /* next octet in same pbuf */
-          msg_ptr++;
-        }
-      }
-      /* (only) one least significant octet */
-      *msg_ptr = (u8_t)value;
-      return ERR_OK;
-    }
-    p = p->next;
-  }
-  /* p == NULL, ofs >= plen */
-  return ERR_ARG;
+  snmp_asn1_stream_init(&st, p, ofs);
+  return snmp_asn1_stream_enc_u32t(&st, octets_needed, value);
 }
 
 /**
@@ -383,46 +493,10 @@ snmp_asn1_enc_u32t(struct pbuf *p, u16_t ofs, u16_t octets_needed, u32_t value)
 err_t
 snmp_asn1_enc_s32t(struct pbuf *p, u16_t ofs, u16_t octets_needed, s32_t value)
 {
-  u16_t plen, base;
-  u8_t *msg_ptr;
-
-  plen = 0;
-  while (p != NULL)
-  {
-    base = plen;
-    plen += p->len;
-    if (ofs < plen)
-    {
-      msg_ptr = (u8_t*)p->payload;
-      msg_ptr += ofs - base;
+  struct snmp_asn1_stream st;
 
-      while (octets_needed > 1)
-      {
-        octets_needed--;
-        *msg_ptr = (u8_t)(value >> (octets_needed << 3));
-        ofs += 1;
-        if (ofs >= plen)
-        {
-          /* next octet in next pbuf */
-          p = p->next;
-          if (p == NULL) { return ERR_ARG; }
-          msg_ptr = (u8_t*)p->payload;
-          plen += p->len;
-        }
-        else
-        {
-          /* next octet in same pbuf */
-          msg_ptr++;
-        }
-      }
-      /* (only) one least significant octet */
-      *msg_ptr = (u8_t)value;
-      return ERR_OK;
-    }
-    p = p->next;
-  }
-  /* p == NULL, ofs >= plen */
-  return ERR_ARG;
+  snmp_asn1_stream_init(&st, p, ofs);
+  return snmp_asn1_stream_enc_s32t(&st, octets_needed, value);
 }
 
 /**
@@ -437,116 +511,10 @@ snmp_asn1_enc_s32t(struct pbuf *p, u16_t ofs, u16_t octets_needed, s32_t value)
 err_t
 snmp_asn1_enc_oid(struct pbuf *p, u16_t ofs, u8_t ident_len, s32_t *ident)
 {
-  u16_t plen, base;
-  u8_t *msg_ptr;
+  struct snmp_asn1_stream st;
 
-  plen = 0;
-  while (p != NULL)
-  {
-    base = plen;
-    plen += p->len;
-    if (ofs < plen)
-    {
-      msg_ptr = (u8_t*)p->payload;
-      msg_ptr += ofs - base;
-
-      if (ident_len > 1)
-      {
-        if ((ident[0] == 1) && (ident[1] == 3))
-        {
-          /* compressed (most common) prefix .iso.org */
-          *msg_ptr = 0x2b;
-        }
-        else
-        {
-          /* calculate prefix */
-          *msg_ptr = (u8_t)((ident[0] * 40) + ident[1]);
-        }
-        ofs += 1;
-        if (ofs >= plen)
-        {
-          /* next octet in next pbuf */
-          p = p->next;
-          if (p == NULL) { return ERR_ARG; }
-          msg_ptr = (u8_t*)p->payload;
-          plen += p->len;
-        }
-        else
-        {
-          /* next octet in same pbuf */
-          msg_ptr++;
-        }
-        ident_len -= 2;
-        ident += 2;
-      }
-      else
-      {
-/* @bug:  allow empty varbinds for symmetry (we must decode them for getnext), allow partial compression??  */
-        /* ident_len <= 1, at least we need zeroDotZero (0.0) (ident_len == 2) */
-        return ERR_ARG;
-      }
-      while (ident_len > 0)
-      {
-        s32_t sub_id;
-        u8_t shift, tail;
-
-        ident_len--;
-        sub_id = *ident;
-        tail = 0;
-        shift = 28;
-        while(shift > 0)
-        {
-          u8_t code;
-
-          code = (u8_t)(sub_id >> shift);
-          if ((code != 0) || (tail != 0))
-          {
-            tail = 1;
-            *msg_ptr = code | 0x80;
-            ofs += 1;
-            if (ofs >= plen)
-            {
-              /* next octet in next pbuf */
-              p = p->next;
-              if (p == NULL) { return ERR_ARG; }
-              msg_ptr = (u8_t*)p->payload;
-              plen += p->len;
-            }
-            else
-            {
-              /* next octet in same pbuf */
-              msg_ptr++;
-            }
-          }
-          shift -= 7;
-        }
-        *msg_ptr = (u8_t)sub_id & 0x7F;
-        if (ident_len > 0)
-        {
-          ofs += 1;
-          if (ofs >= plen)
-          {
-            /* next octet in next pbuf */
-            p = p->next;
-            if (p == NULL) { return ERR_ARG; }
-            msg_ptr = (u8_t*)p->payload;
-            plen += p->len;
-          }
-          else
-          {
-            /* next octet in same pbuf */
-            msg_ptr++;
-          }
-        }
-        /* proceed to next sub-identifier */
-        ident++;
-      }
-      return ERR_OK;
-    }
-    p = p->next;
-  }
-  /* p == NULL, ofs >= plen */
-  return ERR_ARG;
+  snmp_asn1_stream_init(&st, p, ofs);
+  return snmp_asn1_stream_enc_oid(&st, ident_len, ident);
 }
 
 /**
@@ -561,51 +529,10 @@ snmp_asn1_enc_oid(struct pbuf *p, u16_t ofs, u8_t ident_len, s32_t *ident)
 err_t
 snmp_asn1_enc_raw(struct pbuf *p, u16_t ofs, u16_t raw_len, u8_t *raw)
 {
-  u16_t plen, base;
-  u8_t *msg_ptr;
+  struct snmp_asn1_stream st;
 
-  plen = 0;
-  while (p != NULL)
-  {
-    base = plen;
-    plen += p->len;
-    if (ofs < plen)
-    {
-      msg_ptr = (u8_t*)p->payload;
-      msg_ptr += ofs - base;
-
-      while (raw_len > 1)
-      {
-        /* copy raw_len - 1 octets */
-        raw_len--;
-        *msg_ptr = *raw;
-        raw++;
-        ofs += 1;
-        if (ofs >= plen)
-        {
-          /* next octet in next pbuf */
-          p = p->next;
-          if (p == NULL) { return ERR_ARG; }
-          msg_ptr = (u8_t*)p->payload;
-          plen += p->len;
-        }
-        else
-        {
-          /* next octet in same pbuf */
-          msg_ptr++;
-        }
-      }
-      if (raw_len > 0)
-      {
-        /* copy last or single octet */
-        *msg_ptr = *raw;
-      }
-      return ERR_OK;
-    }
-    p = p->next;
-  }
-  /* p == NULL, ofs >= plen */
-  return ERR_ARG;
+  snmp_asn1_stream_init(&st, p, ofs);
+  return snmp_asn1_stream_enc_raw(&st, raw_len, raw);
 }
 
 #endif /* LWIP_SNMP */
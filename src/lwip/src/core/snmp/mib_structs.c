@@ -40,6 +40,8 @@
 #include "lwip/memp.h"
 #include "lwip/netif.h"
 
+#include <string.h>
+
 /** .iso.org.dod.internet address prefix, @see snmp_iso_*() */
 const s32_t prefix[4] = {1, 3, 6, 1};
 
@@ -57,6 +59,43 @@ struct nse
 static u8_t node_stack_cnt;
 static struct nse node_stack[NODE_STACK_SIZE];
 
+#if SNMP_GETNEXT_CACHE
+/** tree position of a resumable snmp_expand_tree() result */
+struct expand_cache
+{
+  /** tree root the expansion started from, NULL if invalid */
+  struct mib_node *root;
+  /** leaf container node returned */
+  struct mib_node *node;
+  /** list node of the returned sub identifier (list containers only) */
+  struct mib_list_node *ln;
+  /** oidret->len on entry (prefix already in oidret) */
+  u8_t base_len;
+  /** saved node stack */
+  u8_t stack_cnt;
+  struct nse stack[NODE_STACK_SIZE];
+  /** returned object identifier */
+  struct snmp_obj_id oid;
+};
+static struct expand_cache expand_cache[SNMP_GETNEXT_CACHE];
+/** next expand_cache entry to replace */
+static u8_t expand_cache_next;
+/** last expansion descended along the ident only (node stack complete) */
+static u8_t expand_resumable;
+/** list node of the returned sub identifier, if any */
+static struct mib_list_node *expand_ln;
+
+static void expand_cache_invalidate(void);
+
+#define EXPAND_CACHE_INVALIDATE() expand_cache_invalidate()
+#define EXPAND_NOT_RESUMABLE()    expand_resumable = 0
+#define EXPAND_LIST_NODE(ln)      expand_ln = (ln)
+#else /* SNMP_GETNEXT_CACHE */
+#define EXPAND_CACHE_INVALIDATE()
+#define EXPAND_NOT_RESUMABLE()
+#define EXPAND_LIST_NODE(ln)
+#endif /* SNMP_GETNEXT_CACHE */
+
 /**
  * Pushes nse struct onto stack.
  */
@@ -220,6 +259,8 @@ snmp_mib_node_insert(struct mib_list_rootnode *rn, s32_t objid, struct mib_list_
 
   LWIP_ASSERT("rn != NULL",rn != NULL);
 
+  /* list changes, cached tree positions may be stale */
+  EXPAND_CACHE_INVALIDATE();
   /* -1 = malloc failure, 0 = not inserted, 1 = inserted, 2 = was present */
   insert = 0;
   if (rn->head == NULL)
@@ -399,6 +440,7 @@ snmp_mib_node_delete(struct mib_list_rootnode *rn, struct mib_list_node *n)
   LWIP_ASSERT("rn != NULL",rn != NULL);
   LWIP_ASSERT("n != NULL",n != NULL);
 
+  EXPAND_CACHE_INVALIDATE();
   /* caller must remove this sub-tree */
   next = (struct mib_list_rootnode*)(n->nptr);
   rn->count -= 1;
@@ -677,16 +719,14 @@ empty_table(struct mib_node *node)
 }
 
 /**
- * Tree expansion.
+ * Tree expansion from node, continues with the current node stack.
  */
-struct mib_node *
-snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snmp_obj_id *oidret)
+static struct mib_node *
+expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snmp_obj_id *oidret)
 {
   u8_t node_type, ext_level, climb_tree;
 
   ext_level = 0;
-  /* reset node stack */
-  node_stack_cnt = 0;
   while (node != NULL)
   {
     climb_tree = 0;
@@ -783,6 +823,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
       {
         u8_t j;
         /* ident_len == 0, complete with leftmost '.thing' */
+        EXPAND_NOT_RESUMABLE();
         j = 0;
         while ((j < an->maxlength) && empty_table(an->nptr[j]))
         {
@@ -836,6 +877,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
             /* leaf node */
             if (ln->objid > *ident)
             {
+              EXPAND_LIST_NODE(ln);
               return (struct mib_node*)lrn;
             }
             else if (ln->next != NULL)
@@ -844,6 +886,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
               (oidret->len)--;
               oidret->id[oidret->len] = ln->next->objid;
               (oidret->len)++;
+              EXPAND_LIST_NODE(ln->next);
               return (struct mib_node*)lrn;
             }
             else
@@ -900,6 +943,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
       {
         struct mib_list_node *jn;
         /* ident_len == 0, complete with leftmost '.thing' */
+        EXPAND_NOT_RESUMABLE();
         jn = lrn->head;
         while ((jn != NULL) && empty_table(jn->nptr))
         {
@@ -1022,6 +1066,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
       else
       {
         /* ident_len == 0, complete with leftmost '.thing' */
+        EXPAND_NOT_RESUMABLE();
         en->get_objid(en->addr_inf,ext_level,0,&ex_id);
         LWIP_DEBUGF(SNMP_MIB_DEBUG,("left en->objid==%"S32_F"\n",ex_id));
         oidret->id[oidret->len] = ex_id;
@@ -1053,6 +1098,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
       else
       {
         /* ident_len == 0, complete object identifier */
+        EXPAND_NOT_RESUMABLE();
         oidret->id[oidret->len] = 0;
         (oidret->len)++;
         /* leaf node */
@@ -1085,6 +1131,7 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
       {
         /* incoming ident is useless beyond this point */
         ident_len = 0;
+        EXPAND_NOT_RESUMABLE();
         oidret->id[oidret->len] = child.r_id;
         oidret->len++;
         node = child.r_ptr;
@@ -1103,6 +1150,151 @@ snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snm
   return NULL;
 }
 
+#if SNMP_GETNEXT_CACHE
+/**
+ * Forgets all cached tree positions (the tree changed).
+ */
+static void
+expand_cache_invalidate(void)
+{
+  u8_t i;
+
+  for (i = 0; i < SNMP_GETNEXT_CACHE; i++)
+  {
+    expand_cache[i].root = NULL;
+  }
+}
+
+/**
+ * Saves the position of a successful expansion in ec if a following
+ * expansion of the returned object identifier can resume there.
+ *
+ * @return 1 if saved, 0 if not resumable
+ */
+static u8_t
+expand_cache_store(struct expand_cache *ec, struct mib_node *root, u8_t base_len, struct mib_node *mn, struct snmp_obj_id *oid)
+{
+  u8_t i;
+
+  ec->root = NULL;
+  if ((mn == NULL) || !expand_resumable || (mn->node_type == MIB_NODE_EX))
+  {
+    return 0;
+  }
+  for (i = 0; i < node_stack_cnt; i++)
+  {
+    if ((node_stack[i].r_ptr != NULL) && (node_stack[i].r_ptr->node_type == MIB_NODE_EX))
+    {
+      /* external levels can't be restored */
+      return 0;
+    }
+  }
+  ec->node = mn;
+  ec->ln = expand_ln;
+  ec->base_len = base_len;
+  ec->stack_cnt = node_stack_cnt;
+  MEMCPY(ec->stack, node_stack, node_stack_cnt * sizeof(struct nse));
+  MEMCPY(&ec->oid, oid, sizeof(struct snmp_obj_id));
+  ec->root = root;
+  return 1;
+}
+
+/**
+ * Resumes expansion at a cached position if oidret + ident equals
+ * a previously returned object identifier (a MIB walk).
+ *
+ * @return 1 if resumed (*mn is the result), 0 if expansion must start at root
+ */
+static u8_t
+expand_cache_resume(struct mib_node *root, u8_t ident_len, s32_t *ident, struct snmp_obj_id *oidret, struct mib_node **mn)
+{
+  struct expand_cache *ec;
+  struct mib_list_node *ln;
+  u8_t base_len, i;
+  s32_t last;
+
+  base_len = oidret->len;
+  if (ident_len == 0)
+  {
+    return 0;
+  }
+  for (i = 0; i < SNMP_GETNEXT_CACHE; i++)
+  {
+    ec = &expand_cache[i];
+    if ((ec->root == root) && (ec->base_len == base_len) &&
+        (ec->oid.len == (base_len + ident_len)) &&
+        (ec->oid.id[ec->oid.len - 1] == ident[ident_len - 1]) &&
+        (memcmp(ident, &ec->oid.id[base_len], ident_len * sizeof(s32_t)) == 0) &&
+        (memcmp(oidret->id, ec->oid.id, base_len * sizeof(s32_t)) == 0))
+    {
+      break;
+    }
+  }
+  if (i == SNMP_GETNEXT_CACHE)
+  {
+    return 0;
+  }
+  MEMCPY(oidret, &ec->oid, sizeof(struct snmp_obj_id));
+  ln = ec->ln;
+  if ((ln != NULL) && (ln->next != NULL))
+  {
+    /* next list entry, node stack is unchanged */
+    ln = ln->next;
+    oidret->id[oidret->len - 1] = ln->objid;
+    ec->oid.id[oidret->len - 1] = ln->objid;
+    ec->ln = ln;
+    *mn = ec->node;
+    return 1;
+  }
+  /* continue in the leaf container with the node stack of that search */
+  (oidret->len)--;
+  last = oidret->id[oidret->len];
+  node_stack_cnt = ec->stack_cnt;
+  MEMCPY(node_stack, ec->stack, node_stack_cnt * sizeof(struct nse));
+  expand_resumable = 1;
+  expand_ln = NULL;
+  *mn = expand_tree(ec->node, 1, &last, oidret);
+  expand_cache_store(ec, root, base_len, *mn, oidret);
+  return 1;
+}
+#endif /* SNMP_GETNEXT_CACHE */
+
+/**
+ * Tree expansion.
+ *
+ * @param node points to the root of the tree ('.internet')
+ * @param ident_len the length of the supplied object identifier
+ * @param ident points to the array of sub identifiers
+ * @param oidret points to the prefix on entry, returns the successor
+ * @return pointer to the leaf container node of the successor, NULL if none
+ */
+struct mib_node *
+snmp_expand_tree(struct mib_node *node, u8_t ident_len, s32_t *ident, struct snmp_obj_id *oidret)
+{
+  struct mib_node *mn;
+#if SNMP_GETNEXT_CACHE
+  u8_t base_len;
+
+  if (expand_cache_resume(node, ident_len, ident, oidret, &mn))
+  {
+    return mn;
+  }
+  base_len = oidret->len;
+  expand_resumable = 1;
+  expand_ln = NULL;
+#endif /* SNMP_GETNEXT_CACHE */
+  /* reset node stack */
+  node_stack_cnt = 0;
+  mn = expand_tree(node, ident_len, ident, oidret);
+#if SNMP_GETNEXT_CACHE
+  if (expand_cache_store(&expand_cache[expand_cache_next], node, base_len, mn, oidret))
+  {
+    expand_cache_next = (expand_cache_next + 1) % SNMP_GETNEXT_CACHE;
+  }
+#endif /* SNMP_GETNEXT_CACHE */
+  return mn;
+}
+
 /**
  * Test object identifier for the iso.org.dod.internet prefix.
  *
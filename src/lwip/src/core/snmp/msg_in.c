@@ -109,7 +109,7 @@ snmp_error_response(struct snmp_msg_pstat *msg_ps, u8_t error)
   int v;
   struct snmp_varbind *vbi = msg_ps->invb.head;
   struct snmp_varbind *vbo = msg_ps->outvb.head;
-  for (v=0; v<msg_ps->vb_idx; v++) {
+  for (v=0; (v<msg_ps->vb_idx) && (vbi != NULL); v++) {
     vbi->ident_len = vbo->ident_len;
     vbo->ident_len = 0;
     vbi->ident = vbo->ident;
@@ -383,6 +383,55 @@ snmp_msg_get_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
   }
 }
 
+#if SNMP_V2C
+/**
+ * Appends an endOfMibView exception for the current input name to outvb.
+ * A GetBulk request ends when all repeaters reached the end of the MIB.
+ *
+ * @param msg_ps points to the assosicated message process state
+ */
+static void
+snmp_msg_end_of_mib_view(struct snmp_msg_pstat *msg_ps)
+{
+  struct snmp_varbind *vb;
+  struct snmp_obj_id oid;
+  u8_t i;
+
+  /* copy, the name may also be part of the previous GetBulk row */
+  oid.len = msg_ps->vb_ptr->ident_len;
+  for (i = 0; i < oid.len; i++)
+  {
+    oid.id[i] = msg_ps->vb_ptr->ident[i];
+  }
+  vb = snmp_varbind_alloc(&oid, (SNMP_ASN1_CONTXT | SNMP_ASN1_PRIMIT | SNMP_ASN1_END_OF_MIB_VIEW), 0);
+  if (vb != NULL)
+  {
+    snmp_varbind_tail_add(&msg_ps->outvb, vb);
+    msg_ps->vb_idx += 1;
+    if (msg_ps->vb_idx > msg_ps->non_repeaters)
+    {
+      msg_ps->eom_cnt += 1;
+      if ((msg_ps->eom_cnt >= msg_ps->repeaters) &&
+          (((msg_ps->vb_idx - msg_ps->non_repeaters) % msg_ps->repeaters) == 0))
+      {
+        /* a complete row of endOfMibView, further repetitions are useless */
+        msg_ps->vb_count = msg_ps->vb_idx;
+      }
+    }
+  }
+  else if (msg_ps->vb_idx >= msg_ps->invb.count)
+  {
+    /* truncate GetBulk repetitions */
+    msg_ps->vb_count = msg_ps->vb_idx;
+  }
+  else
+  {
+    LWIP_DEBUGF(SNMP_MSG_DEBUG, ("snmp_msg_end_of_mib_view: couldn't allocate outvb space\n"));
+    snmp_error_response(msg_ps,SNMP_ES_TOOBIG);
+  }
+}
+#endif /* SNMP_V2C */
+
 /**
  * Service an internal or external event for SNMP GETNEXT.
  *
@@ -433,6 +482,9 @@ snmp_msg_getnext_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
       snmp_varbind_tail_add(&msg_ps->outvb, vb);
       msg_ps->state = SNMP_MSG_SEARCH_OBJ;
       msg_ps->vb_idx += 1;
+#if SNMP_V2C
+      msg_ps->eom_cnt = 0;
+#endif /* SNMP_V2C */
     }
     else
     {
@@ -443,7 +495,7 @@ snmp_msg_getnext_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
   }
 
   while ((msg_ps->state == SNMP_MSG_SEARCH_OBJ) &&
-         (msg_ps->vb_idx < msg_ps->invb.count))
+         (msg_ps->vb_idx < msg_ps->vb_count))
   {
     struct mib_node *mn;
     struct snmp_obj_id oid;
@@ -452,6 +504,19 @@ snmp_msg_getnext_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
     {
       msg_ps->vb_ptr = msg_ps->invb.head;
     }
+#if SNMP_V2C
+    else if (msg_ps->vb_idx == msg_ps->invb.count)
+    {
+      /* GetBulk repetition: continue from the previous row of repeaters */
+      u8_t i;
+
+      msg_ps->vb_ptr = msg_ps->outvb.head;
+      for (i = msg_ps->repeaters; i < msg_ps->vb_idx; i++)
+      {
+        msg_ps->vb_ptr = msg_ps->vb_ptr->next;
+      }
+    }
+#endif /* SNMP_V2C */
     else
     {
       msg_ps->vb_ptr = msg_ps->vb_ptr->next;
@@ -507,7 +572,19 @@ snmp_msg_getnext_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
           snmp_varbind_tail_add(&msg_ps->outvb, vb);
           msg_ps->state = SNMP_MSG_SEARCH_OBJ;
           msg_ps->vb_idx += 1;
+#if SNMP_V2C
+          msg_ps->eom_cnt = 0;
+#endif /* SNMP_V2C */
+        }
+#if SNMP_V2C
+        else if (msg_ps->vb_idx >= msg_ps->invb.count)
+        {
+          /* GetBulk repetitions may be truncated, answer what we have */
+          LWIP_DEBUGF(SNMP_MSG_DEBUG, ("snmp_msg_getnext_event: outvb full, bulk truncated\n"));
+          msg_ps->state = SNMP_MSG_SEARCH_OBJ;
+          msg_ps->vb_count = msg_ps->vb_idx;
         }
+#endif /* SNMP_V2C */
         else
         {
           LWIP_DEBUGF(SNMP_MSG_DEBUG, ("snmp_recv couldn't allocate outvb space\n"));
@@ -515,6 +592,14 @@ snmp_msg_getnext_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
         }
       }
     }
+#if SNMP_V2C
+    else if (msg_ps->version == SNMP_VERSION_2c)
+    {
+      /* v2c: no successor, return the name with endOfMibView */
+      snmp_msg_end_of_mib_view(msg_ps);
+      mn = (struct mib_node*)&internet;
+    }
+#endif /* SNMP_V2C */
     if (mn == NULL)
     {
       /* mn == NULL, noSuchName */
@@ -522,7 +607,7 @@ snmp_msg_getnext_event(u8_t request_id, struct snmp_msg_pstat *msg_ps)
     }
   }
   if ((msg_ps->state == SNMP_MSG_SEARCH_OBJ) &&
-      (msg_ps->vb_idx == msg_ps->invb.count))
+      (msg_ps->vb_idx == msg_ps->vb_count))
   {
     snmp_ok_response(msg_ps);
   }
@@ -801,7 +886,8 @@ snmp_msg_event(u8_t request_id)
   if (request_id < SNMP_CONCURRENT_REQUESTS)
   {
     msg_ps = &msg_input_list[request_id];
-    if (msg_ps->rt == SNMP_ASN1_PDU_GET_NEXT_REQ)
+    if ((msg_ps->rt == SNMP_ASN1_PDU_GET_NEXT_REQ) ||
+        (msg_ps->rt == SNMP_ASN1_PDU_GET_BULK_REQ))
     {
       snmp_msg_getnext_event(request_id, msg_ps);
     }
@@ -862,9 +948,11 @@ snmp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
   if ((err_ret != ERR_OK) ||
       ((msg_ps->rt != SNMP_ASN1_PDU_GET_REQ) &&
        (msg_ps->rt != SNMP_ASN1_PDU_GET_NEXT_REQ) &&
-       (msg_ps->rt != SNMP_ASN1_PDU_SET_REQ)) ||
-      ((msg_ps->error_status != SNMP_ES_NOERROR) ||
-       (msg_ps->error_index != 0)) )
+       (msg_ps->rt != SNMP_ASN1_PDU_SET_REQ) &&
+       (msg_ps->rt != SNMP_ASN1_PDU_GET_BULK_REQ)) ||
+      (((msg_ps->error_status != SNMP_ES_NOERROR) ||
+        (msg_ps->error_index != 0)) &&
+       (msg_ps->rt != SNMP_ASN1_PDU_GET_BULK_REQ)))
   {
     /* header check failed drop request silently, do not return error! */
     pbuf_free(p);
@@ -887,6 +975,33 @@ snmp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     return;
   }
 
+  msg_ps->vb_count = msg_ps->invb.count;
+#if SNMP_V2C
+  msg_ps->non_repeaters = msg_ps->invb.count;
+  msg_ps->repeaters = 0;
+  msg_ps->eom_cnt = 0;
+  if (msg_ps->rt == SNMP_ASN1_PDU_GET_BULK_REQ)
+  {
+    u16_t vb_count;
+    s32_t non_repeaters, max_repetitions;
+
+    /* non-repeaters and max-repetitions are passed as error-status and error-index,
+       negative values are taken as 0 (RFC 3416, 4.2.3) */
+    non_repeaters = LWIP_MAX(msg_ps->error_status, 0);
+    max_repetitions = LWIP_MIN(LWIP_MAX(msg_ps->error_index, 0), 0xff);
+    if (non_repeaters < msg_ps->invb.count)
+    {
+      msg_ps->non_repeaters = (u8_t)non_repeaters;
+    }
+    msg_ps->repeaters = msg_ps->invb.count - msg_ps->non_repeaters;
+    vb_count = msg_ps->non_repeaters;
+    if (msg_ps->repeaters > 0)
+    {
+      vb_count += msg_ps->repeaters * (u16_t)max_repetitions;
+    }
+    msg_ps->vb_count = (u8_t)LWIP_MIN(vb_count, 0xff);
+  }
+#endif /* SNMP_V2C */
   msg_ps->error_status = SNMP_ES_NOERROR;
   msg_ps->error_index = 0;
   /* find object for each variable binding */
@@ -947,12 +1062,17 @@ snmp_pdu_header_check(struct pbuf *p, u16_t ofs, u16_t pdu_len, u16_t *ofs_ret,
     snmp_inc_snmpinasnparseerrs();
     return ERR_ARG;
   }
-  if (version != 0)
+#if SNMP_V2C
+  if ((version != SNMP_VERSION_1) && (version != SNMP_VERSION_2c))
+#else /* SNMP_V2C */
+  if (version != SNMP_VERSION_1)
+#endif /* SNMP_V2C */
   {
-    /* not version 1 */
+    /* not version 1 (or 2c) */
     snmp_inc_snmpinbadversions();
     return ERR_ARG;
   }
+  m_stat->version = version;
   ofs += (1 + len_octets + len);
   snmp_asn1_dec_type(p, ofs, &type);
   derr = snmp_asn1_dec_length(p, ofs+1, &len_octets, &len);
@@ -1014,6 +1134,12 @@ snmp_pdu_header_check(struct pbuf *p, u16_t ofs, u16_t pdu_len, u16_t *ofs_ret,
       snmp_inc_snmpintraps();
       derr = ERR_ARG;
       break;
+#if SNMP_V2C
+    case (SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | SNMP_ASN1_PDU_GET_BULK_REQ):
+      /* GetBulkRequest PDU (SNMPv2c only) */
+      derr = (version == SNMP_VERSION_2c) ? ERR_OK : ERR_ARG;
+      break;
+#endif /* SNMP_V2C */
     default:
       snmp_inc_snmpinasnparseerrs();
       derr = ERR_ARG;
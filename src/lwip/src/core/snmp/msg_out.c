@@ -68,9 +68,9 @@ static u16_t snmp_resp_header_sum(struct snmp_msg_pstat *m_stat, u16_t vb_len);
 static u16_t snmp_trap_header_sum(struct snmp_msg_trap *m_trap, u16_t vb_len);
 static u16_t snmp_varbind_list_sum(struct snmp_varbind_root *root);
 
-static u16_t snmp_resp_header_enc(struct snmp_msg_pstat *m_stat, struct pbuf *p);
-static u16_t snmp_trap_header_enc(struct snmp_msg_trap *m_trap, struct pbuf *p);
-static u16_t snmp_varbind_list_enc(struct snmp_varbind_root *root, struct pbuf *p, u16_t ofs);
+static void snmp_resp_header_enc(struct snmp_msg_pstat *m_stat, struct snmp_asn1_stream *st);
+static void snmp_trap_header_enc(struct snmp_msg_trap *m_trap, struct snmp_asn1_stream *st);
+static void snmp_varbind_list_enc(struct snmp_varbind_root *root, struct snmp_asn1_stream *st);
 
 /**
  * Sets enable switch for this trap destination.
@@ -123,6 +123,23 @@ snmp_send_response(struct snmp_msg_pstat *m_stat)
 
   /* try allocating pbuf(s) for complete response */
   p = pbuf_alloc(PBUF_TRANSPORT, tot_len, PBUF_POOL);
+#if SNMP_V2C
+  /* GetBulk: drop trailing varbinds until the response fits */
+  while ((m_stat->rt == SNMP_ASN1_PDU_GET_BULK_REQ) &&
+         (m_stat->error_status == SNMP_ES_NOERROR) &&
+         ((p == NULL) || (tot_len > SNMP_MAX_BULK_LEN)) &&
+         (m_stat->outvb.count > 1))
+  {
+    if (p != NULL)
+    {
+      pbuf_free(p);
+    }
+    snmp_varbind_free(snmp_varbind_tail_remove(&m_stat->outvb));
+    tot_len = snmp_varbind_list_sum(&m_stat->outvb);
+    tot_len = snmp_resp_header_sum(m_stat, tot_len);
+    p = pbuf_alloc(PBUF_TRANSPORT, tot_len, PBUF_POOL);
+  }
+#endif /* SNMP_V2C */
   if (p == NULL)
   {
     LWIP_DEBUGF(SNMP_MSG_DEBUG, ("snmp_snd_response() tooBig\n"));
@@ -139,13 +156,14 @@ snmp_send_response(struct snmp_msg_pstat *m_stat)
   if (p != NULL)
   {
     /* first pbuf alloc try or retry alloc success */
-    u16_t ofs;
+    struct snmp_asn1_stream st;
 
     LWIP_DEBUGF(SNMP_MSG_DEBUG, ("snmp_snd_response() p != NULL\n"));
 
     /* pass 1, size error, encode packet ino the pbuf(s) */
-    ofs = snmp_resp_header_enc(m_stat, p);
-    snmp_varbind_list_enc(&m_stat->outvb, p, ofs);
+    snmp_asn1_stream_init(&st, p, 0);
+    snmp_resp_header_enc(m_stat, &st);
+    snmp_varbind_list_enc(&m_stat->outvb, &st);
 
     switch (m_stat->error_status)
     {
@@ -254,11 +272,12 @@ snmp_send_trap(s8_t generic_trap, struct snmp_obj_id *eoid, s32_t specific_trap)
       p = pbuf_alloc(PBUF_TRANSPORT, tot_len, PBUF_POOL);
       if (p != NULL)
       {
-        u16_t ofs;
+        struct snmp_asn1_stream st;
 
         /* pass 1, encode packet ino the pbuf(s) */
-        ofs = snmp_trap_header_enc(&trap_msg, p);
-        snmp_varbind_list_enc(&trap_msg.outvb, p, ofs);
+        snmp_asn1_stream_init(&st, p, 0);
+        snmp_trap_header_enc(&trap_msg, &st);
+        snmp_varbind_list_enc(&trap_msg.outvb, &st);
 
         snmp_inc_snmpouttraps();
         snmp_inc_snmpoutpkts();
@@ -336,7 +355,7 @@ snmp_resp_header_sum(struct snmp_msg_pstat *m_stat, u16_t vb_len)
   snmp_asn1_enc_length_cnt(rhl->comlen, &rhl->comlenlen);
   tot_len += 1 + rhl->comlenlen + rhl->comlen;
 
-  snmp_asn1_enc_s32t_cnt(snmp_version, &rhl->verlen);
+  snmp_asn1_enc_s32t_cnt(m_stat->version, &rhl->verlen);
   snmp_asn1_enc_length_cnt(rhl->verlen, &rhl->verlenlen);
   tot_len += 1 + rhl->verlen + rhl->verlenlen;
 
@@ -437,6 +456,7 @@ snmp_varbind_list_sum(struct snmp_varbind_root *root)
         break;
       case (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR):
       case (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_NUL):
+      case (SNMP_ASN1_CONTXT | SNMP_ASN1_PRIMIT | SNMP_ASN1_END_OF_MIB_VIEW):
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_IPADDR):
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_OPAQUE):
         vb->vlen = vb->value_len;
@@ -476,199 +496,135 @@ snmp_varbind_list_sum(struct snmp_varbind_root *root)
 /**
  * Encodes response header from head to tail.
  */
-static u16_t
-snmp_resp_header_enc(struct snmp_msg_pstat *m_stat, struct pbuf *p)
+static void
+snmp_resp_header_enc(struct snmp_msg_pstat *m_stat, struct snmp_asn1_stream *st)
 {
-  u16_t ofs;
-
-  ofs = 0;
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.seqlen);
-  ofs += m_stat->rhl.seqlenlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.verlen);
-  ofs += m_stat->rhl.verlenlen;
-  snmp_asn1_enc_s32t(p, ofs, m_stat->rhl.verlen, snmp_version);
-  ofs += m_stat->rhl.verlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.comlen);
-  ofs += m_stat->rhl.comlenlen;
-  snmp_asn1_enc_raw(p, ofs, m_stat->rhl.comlen, m_stat->community);
-  ofs += m_stat->rhl.comlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | SNMP_ASN1_PDU_GET_RESP));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.pdulen);
-  ofs += m_stat->rhl.pdulenlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.ridlen);
-  ofs += m_stat->rhl.ridlenlen;
-  snmp_asn1_enc_s32t(p, ofs, m_stat->rhl.ridlen, m_stat->rid);
-  ofs += m_stat->rhl.ridlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.errstatlen);
-  ofs += m_stat->rhl.errstatlenlen;
-  snmp_asn1_enc_s32t(p, ofs, m_stat->rhl.errstatlen, m_stat->error_status);
-  ofs += m_stat->rhl.errstatlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_stat->rhl.erridxlen);
-  ofs += m_stat->rhl.erridxlenlen;
-  snmp_asn1_enc_s32t(p, ofs, m_stat->rhl.erridxlen, m_stat->error_index);
-  ofs += m_stat->rhl.erridxlen;
-
-  return ofs;
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.seqlen);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.verlen);
+  snmp_asn1_stream_enc_s32t(st, m_stat->rhl.verlen, m_stat->version);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.comlen);
+  snmp_asn1_stream_enc_raw(st, m_stat->rhl.comlen, m_stat->community);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | SNMP_ASN1_PDU_GET_RESP));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.pdulen);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.ridlen);
+  snmp_asn1_stream_enc_s32t(st, m_stat->rhl.ridlen, m_stat->rid);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.errstatlen);
+  snmp_asn1_stream_enc_s32t(st, m_stat->rhl.errstatlen, m_stat->error_status);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_stat->rhl.erridxlen);
+  snmp_asn1_stream_enc_s32t(st, m_stat->rhl.erridxlen, m_stat->error_index);
 }
 
 /**
  * Encodes trap header from head to tail.
  */
-static u16_t
-snmp_trap_header_enc(struct snmp_msg_trap *m_trap, struct pbuf *p)
+static void
+snmp_trap_header_enc(struct snmp_msg_trap *m_trap, struct snmp_asn1_stream *st)
 {
-  u16_t ofs;
-
-  ofs = 0;
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.seqlen);
-  ofs += m_trap->thl.seqlenlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.verlen);
-  ofs += m_trap->thl.verlenlen;
-  snmp_asn1_enc_s32t(p, ofs, m_trap->thl.verlen, snmp_version);
-  ofs += m_trap->thl.verlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.comlen);
-  ofs += m_trap->thl.comlenlen;
-  snmp_asn1_enc_raw(p, ofs, m_trap->thl.comlen, (u8_t *)&snmp_publiccommunity[0]);
-  ofs += m_trap->thl.comlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | SNMP_ASN1_PDU_TRAP));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.pdulen);
-  ofs += m_trap->thl.pdulenlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.eidlen);
-  ofs += m_trap->thl.eidlenlen;
-  snmp_asn1_enc_oid(p, ofs, m_trap->enterprise->len, &m_trap->enterprise->id[0]);
-  ofs += m_trap->thl.eidlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_IPADDR));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.aaddrlen);
-  ofs += m_trap->thl.aaddrlenlen;
-  snmp_asn1_enc_raw(p, ofs, m_trap->thl.aaddrlen, &m_trap->sip_raw[0]);
-  ofs += m_trap->thl.aaddrlen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.gtrplen);
-  ofs += m_trap->thl.gtrplenlen;
-  snmp_asn1_enc_u32t(p, ofs, m_trap->thl.gtrplen, m_trap->gen_trap);
-  ofs += m_trap->thl.gtrplen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.strplen);
-  ofs += m_trap->thl.strplenlen;
-  snmp_asn1_enc_u32t(p, ofs, m_trap->thl.strplen, m_trap->spc_trap);
-  ofs += m_trap->thl.strplen;
-
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_TIMETICKS));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, m_trap->thl.tslen);
-  ofs += m_trap->thl.tslenlen;
-  snmp_asn1_enc_u32t(p, ofs, m_trap->thl.tslen, m_trap->ts);
-  ofs += m_trap->thl.tslen;
-
-  return ofs;
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.seqlen);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.verlen);
+  snmp_asn1_stream_enc_s32t(st, m_trap->thl.verlen, snmp_version);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.comlen);
+  snmp_asn1_stream_enc_raw(st, m_trap->thl.comlen, (u8_t *)&snmp_publiccommunity[0]);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | SNMP_ASN1_PDU_TRAP));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.pdulen);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.eidlen);
+  snmp_asn1_stream_enc_oid(st, m_trap->enterprise->len, &m_trap->enterprise->id[0]);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_IPADDR));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.aaddrlen);
+  snmp_asn1_stream_enc_raw(st, m_trap->thl.aaddrlen, &m_trap->sip_raw[0]);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.gtrplen);
+  snmp_asn1_stream_enc_u32t(st, m_trap->thl.gtrplen, m_trap->gen_trap);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.strplen);
+  snmp_asn1_stream_enc_u32t(st, m_trap->thl.strplen, m_trap->spc_trap);
+
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_TIMETICKS));
+  snmp_asn1_stream_enc_length(st, m_trap->thl.tslen);
+  snmp_asn1_stream_enc_u32t(st, m_trap->thl.tslen, m_trap->ts);
 }
 
 /**
  * Encodes varbind list from head to tail.
  */
-static u16_t
-snmp_varbind_list_enc(struct snmp_varbind_root *root, struct pbuf *p, u16_t ofs)
+static void
+snmp_varbind_list_enc(struct snmp_varbind_root *root, struct snmp_asn1_stream *st)
 {
   struct snmp_varbind *vb;
   s32_t *sint_ptr;
   u32_t *uint_ptr;
   u8_t *raw_ptr;
 
-  snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
-  ofs += 1;
-  snmp_asn1_enc_length(p, ofs, root->seqlen);
-  ofs += root->seqlenlen;
+  snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
+  snmp_asn1_stream_enc_length(st, root->seqlen);
 
   vb = root->head;
   while ( vb != NULL )
   {
-    snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
-    ofs += 1;
-    snmp_asn1_enc_length(p, ofs, vb->seqlen);
-    ofs += vb->seqlenlen;
-
-    snmp_asn1_enc_type(p, ofs, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID));
-    ofs += 1;
-    snmp_asn1_enc_length(p, ofs, vb->olen);
-    ofs += vb->olenlen;
-    snmp_asn1_enc_oid(p, ofs, vb->ident_len, &vb->ident[0]);
-    ofs += vb->olen;
-
-    snmp_asn1_enc_type(p, ofs, vb->value_type);
-    ofs += 1;
-    snmp_asn1_enc_length(p, ofs, vb->vlen);
-    ofs += vb->vlenlen;
+    snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ));
+    snmp_asn1_stream_enc_length(st, vb->seqlen);
+
+    snmp_asn1_stream_enc_type(st, (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID));
+    snmp_asn1_stream_enc_length(st, vb->olen);
+    snmp_asn1_stream_enc_oid(st, vb->ident_len, &vb->ident[0]);
+
+    snmp_asn1_stream_enc_type(st, vb->value_type);
+    snmp_asn1_stream_enc_length(st, vb->vlen);
 
     switch (vb->value_type)
     {
       case (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG):
         sint_ptr = (s32_t*)vb->value;
-        snmp_asn1_enc_s32t(p, ofs, vb->vlen, *sint_ptr);
+        snmp_asn1_stream_enc_s32t(st, vb->vlen, *sint_ptr);
         break;
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_COUNTER):
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_GAUGE):
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_TIMETICKS):
         uint_ptr = (u32_t*)vb->value;
-        snmp_asn1_enc_u32t(p, ofs, vb->vlen, *uint_ptr);
+        snmp_asn1_stream_enc_u32t(st, vb->vlen, *uint_ptr);
         break;
       case (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR):
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_IPADDR):
       case (SNMP_ASN1_APPLIC | SNMP_ASN1_PRIMIT | SNMP_ASN1_OPAQUE):
         raw_ptr = (u8_t*)vb->value;
-        snmp_asn1_enc_raw(p, ofs, vb->vlen, raw_ptr);
+        snmp_asn1_stream_enc_raw(st, vb->vlen, raw_ptr);
         break;
       case (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_NUL):
+      case (SNMP_ASN1_CONTXT | SNMP_ASN1_PRIMIT | SNMP_ASN1_END_OF_MIB_VIEW):
         break;
       case (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID):
         sint_ptr = (s32_t*)vb->value;
-        snmp_asn1_enc_oid(p, ofs, vb->value_len / sizeof(s32_t), sint_ptr);
+        snmp_asn1_stream_enc_oid(st, vb->value_len / sizeof(s32_t), sint_ptr);
         break;
       default:
         /* unsupported type */
         break;
     };
-    ofs += vb->vlen;
     vb = vb->next;
   }
-  return ofs;
 }
 
 #endif /* LWIP_SNMP */
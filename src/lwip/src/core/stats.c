@@ -43,11 +43,21 @@
 #include "lwip/def.h"
 #include "lwip/stats.h"
 #include "lwip/mem.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/sys.h"
 
 #include <string.h>
 
 struct stats_ lwip_stats;
 
+#if LWIP_STATS_SNAPSHOT
+volatile u32_t lwip_stats_seq;
+#if LWIP_STATS_SHARDS > 1
+struct stats_ lwip_stats_shards[LWIP_STATS_SHARDS - 1];
+#endif /* LWIP_STATS_SHARDS > 1 */
+#endif /* LWIP_STATS_SNAPSHOT */
+
 void stats_init(void)
 {
 #ifdef LWIP_DEBUG
@@ -67,6 +77,466 @@ void stats_init(void)
 #endif /* LWIP_DEBUG */
 }
 
+#if LOCK_STATS
+/**
+ * Count a lock hold/wait time in a LOCK_STATS histogram.
+ *
+ * @param hist the histogram (LOCK_STATS_HIST_SIZE buckets)
+ * @param ticks the time to count, in LOCK_STATS_NOW() ticks
+ */
+void
+stats_lock_hist(STAT_COUNTER *hist, u32_t ticks)
+{
+  u8_t i = 0;
+
+  while ((ticks != 0) && (i < LOCK_STATS_HIST_SIZE - 1)) {
+    ticks >>= 1;
+    i++;
+  }
+  hist[i]++;
+}
+#endif /* LOCK_STATS */
+
+#if LWIP_STATS_SNAPSHOT
+#if LWIP_STATS_SHARDS > 1
+/** Add a struct made only of STAT_COUNTERs (stats_proto, stats_igmp) of a
+ * shard to the sum. Every counter is read at once, a shard is not copied
+ * in one go: its writer may preempt us, but never tears a counter. */
+static void
+stats_add_counters(void *sum, const volatile void *shard, u16_t size)
+{
+  STAT_COUNTER *s = (STAT_COUNTER *)sum;
+  const volatile STAT_COUNTER *c = (const volatile STAT_COUNTER *)shard;
+  u16_t i;
+
+  for (i = 0; i < size / sizeof(STAT_COUNTER); i++) {
+    s[i] += c[i];
+  }
+}
+
+/** Add the packet counters of a shard (see STATS_SHARD_ADD) to snap */
+static void
+stats_add_shard(struct stats_ *snap, const volatile struct stats_ *shard)
+{
+#if LINK_STATS
+  stats_add_counters(&snap->link, &shard->link, sizeof(snap->link));
+  snap->link_octets.recv += shard->link_octets.recv;
+  snap->link_octets.xmit += shard->link_octets.xmit;
+#endif /* LINK_STATS */
+#if ETHARP_STATS
+  stats_add_counters(&snap->etharp, &shard->etharp, sizeof(snap->etharp));
+#endif
+#if IPFRAG_STATS
+  stats_add_counters(&snap->ip_frag, &shard->ip_frag, sizeof(snap->ip_frag));
+#endif
+#if IP_STATS
+  stats_add_counters(&snap->ip, &shard->ip, sizeof(snap->ip));
+#endif
+#if ICMP_STATS
+  stats_add_counters(&snap->icmp, &shard->icmp, sizeof(snap->icmp));
+#endif
+#if IGMP_STATS
+  stats_add_counters(&snap->igmp, &shard->igmp, sizeof(snap->igmp));
+#endif
+#if UDP_STATS
+  stats_add_counters(&snap->udp, &shard->udp, sizeof(snap->udp));
+#endif
+#if TCP_STATS
+  stats_add_counters(&snap->tcp, &shard->tcp, sizeof(snap->tcp));
+#endif
+#if DNS_STATS
+  /* the counters in front of rtt_sum, DNS_STATS_RTT() is sequenced */
+  stats_add_counters(&snap->dns, &shard->dns,
+    (u16_t)((u8_t *)&snap->dns.rtt_sum - (u8_t *)&snap->dns));
+#endif
+}
+#endif /* LWIP_STATS_SHARDS > 1 */
+
+/**
+ * Copy lwip_stats without tearing: the copy is retried whenever a sequenced
+ * update (e.g. from the ethernet RX interrupt) ran while copying. The packet
+ * counters of the other shards (LWIP_STATS_SHARDS) are added to it.
+ *
+ * @param snap where to store the copy
+ * @return ERR_OK if snap holds a consistent copy,
+ *         ERR_WOULDBLOCK if an update was in progress for
+ *         LWIP_STATS_SNAPSHOT_TRIES attempts (the caller preempted it)
+ */
+err_t
+stats_snapshot(struct stats_ *snap)
+{
+  const volatile u8_t *src = (const volatile u8_t *)&lwip_stats;
+  u8_t *dst = (u8_t *)snap;
+  u32_t seq;
+  u16_t i;
+  u8_t tries;
+
+  for (tries = 0; tries < LWIP_STATS_SNAPSHOT_TRIES; tries++) {
+    seq = lwip_stats_seq;
+    if (seq & 1) {
+      continue;
+    }
+    for (i = 0; i < sizeof(struct stats_); i++) {
+      dst[i] = src[i];
+    }
+    if (lwip_stats_seq == seq) {
+#if LWIP_STATS_SHARDS > 1
+      for (i = 0; i < LWIP_STATS_SHARDS - 1; i++) {
+        stats_add_shard(snap, &lwip_stats_shards[i]);
+      }
+#endif /* LWIP_STATS_SHARDS > 1 */
+      return ERR_OK;
+    }
+  }
+  return ERR_WOULDBLOCK;
+}
+
+/** The counters stats_sample() looks at, read in one go. */
+struct stats_sample_ {
+  STAT_COUNTER recv;
+  STAT_COUNTER xmit;
+  u32_t octets_recv;
+  u32_t octets_xmit;
+  STAT_COUNTER drop[STATS_SAMPLER_DROPS];
+};
+
+/** Add the counters stats_sample() looks at of one shard to 'cur' */
+static void
+stats_sample_add(struct stats_sample_ *cur, const volatile struct stats_ *shard)
+{
+  u8_t n = 0;
+
+#if LINK_STATS
+  cur->recv += shard->link.recv;
+  cur->xmit += shard->link.xmit;
+  cur->octets_recv += shard->link_octets.recv;
+  cur->octets_xmit += shard->link_octets.xmit;
+  cur->drop[n++] += shard->link.drop;
+#endif /* LINK_STATS */
+#if ETHARP_STATS
+  cur->drop[n++] += shard->etharp.drop;
+#endif
+#if IPFRAG_STATS
+  cur->drop[n++] += shard->ip_frag.drop;
+#endif
+#if IP_STATS
+  cur->drop[n++] += shard->ip.drop;
+#endif
+#if ICMP_STATS
+  cur->drop[n++] += shard->icmp.drop;
+#endif
+#if IGMP_STATS
+  cur->drop[n++] += shard->igmp.drop;
+#endif
+#if UDP_STATS
+  cur->drop[n++] += shard->udp.drop;
+#endif
+#if TCP_STATS
+  cur->drop[n++] += shard->tcp.drop;
+#endif
+  LWIP_UNUSED_ARG(n);
+}
+
+/** Scale a counter difference over 'ms' milliseconds to a per second rate */
+static u32_t
+stats_per_sec(u32_t diff, u32_t ms)
+{
+  return (diff / ms) * 1000 + ((diff % ms) * 1000) / ms;
+}
+
+/**
+ * Rate sampler: call this periodically (e.g. once a second) to update
+ * sampler->rate from the link and drop counters. Only the handful of
+ * counters needed are read (and added up over the shards); they are packet
+ * counters, so no sequence lock is needed. Counter wrap-around between two
+ * samples is handled.
+ *
+ * @param sampler sampler state, zeroed before the first call
+ * @param now current time in milliseconds (e.g. sys_now())
+ * @return ERR_OK if sampler->rate has been updated,
+ *         ERR_INPROGRESS if this was the first sample (or no time passed)
+ */
+err_t
+stats_sample(struct stats_sampler *sampler, u32_t now)
+{
+  struct stats_sample_ cur;
+  u32_t ms;
+  u32_t drops;
+  u8_t i;
+
+  memset(&cur, 0, sizeof(cur));
+  stats_sample_add(&cur, &lwip_stats);
+#if LWIP_STATS_SHARDS > 1
+  for (i = 0; i < LWIP_STATS_SHARDS - 1; i++) {
+    stats_sample_add(&cur, &lwip_stats_shards[i]);
+  }
+#endif /* LWIP_STATS_SHARDS > 1 */
+
+  ms = now - sampler->time;
+  if (sampler->valid && (ms != 0)) {
+    sampler->rate.pps_recv = stats_per_sec((STAT_COUNTER)(cur.recv - sampler->recv), ms);
+    sampler->rate.pps_xmit = stats_per_sec((STAT_COUNTER)(cur.xmit - sampler->xmit), ms);
+    sampler->rate.bps_recv = stats_per_sec(cur.octets_recv - sampler->octets_recv, ms) * 8;
+    sampler->rate.bps_xmit = stats_per_sec(cur.octets_xmit - sampler->octets_xmit, ms) * 8;
+    drops = 0;
+    for (i = 0; i < STATS_SAMPLER_DROPS; i++) {
+      drops += (STAT_COUNTER)(cur.drop[i] - sampler->drop[i]);
+    }
+    sampler->rate.drops = stats_per_sec(drops, ms);
+  } else if (sampler->valid) {
+    return ERR_INPROGRESS;
+  }
+
+  sampler->time = now;
+  sampler->recv = cur.recv;
+  sampler->xmit = cur.xmit;
+  sampler->octets_recv = cur.octets_recv;
+  sampler->octets_xmit = cur.octets_xmit;
+  MEMCPY(sampler->drop, cur.drop, sizeof(cur.drop));
+  if (!sampler->valid) {
+    sampler->valid = 1;
+    return ERR_INPROGRESS;
+  }
+  return ERR_OK;
+}
+#endif /* LWIP_STATS_SNAPSHOT */
+
+#if LWIP_STATS_EXPORT
+/**
+ * stats_export() wire format, all multi-byte header fields in network order:
+ *
+ *  u8  STATS_EXPORT_VERSION
+ *  u8  number of sections
+ *  u16 export sequence number
+ *  u32 time of the snapshot (ms)
+ *  sections: u8 id (STATS_EXPORT_xxx), varint value count, varint values
+ *
+ * Varints are unsigned LEB128 (7 bits per byte, least significant first,
+ * high bit set on all but the last byte), so idle counters take one byte.
+ */
+struct stats_export_writer {
+  u8_t *buf;                     /* NULL to only count the length */
+  u16_t len;
+  u16_t pos;
+  u8_t sections;
+  u8_t overflow;
+};
+
+static void
+stats_export_byte(struct stats_export_writer *w, u8_t b)
+{
+  if (w->pos >= w->len) {
+    w->overflow = 1;
+    return;
+  }
+  if (w->buf != NULL) {
+    w->buf[w->pos] = b;
+  }
+  w->pos++;
+}
+
+static void
+stats_export_varint(struct stats_export_writer *w, u32_t v)
+{
+  while (v >= 0x80) {
+    stats_export_byte(w, (u8_t)(v | 0x80));
+    v >>= 7;
+  }
+  stats_export_byte(w, (u8_t)v);
+}
+
+static void
+stats_export_section(struct stats_export_writer *w, u8_t id, u16_t count)
+{
+  stats_export_byte(w, id);
+  stats_export_varint(w, count);
+  w->sections++;
+}
+
+/** Export a struct made only of STAT_COUNTERs (stats_proto, stats_igmp) */
+static void
+stats_export_counters(struct stats_export_writer *w, u8_t id,
+                      const void *counters, u16_t size)
+{
+  const STAT_COUNTER *c = (const STAT_COUNTER *)counters;
+  u16_t count = size / sizeof(STAT_COUNTER);
+  u16_t i;
+
+  stats_export_section(w, id, count);
+  for (i = 0; i < count; i++) {
+    stats_export_varint(w, c[i]);
+  }
+}
+
+#if MEM_STATS || MEMP_STATS
+static void
+stats_export_mem(struct stats_export_writer *w, const struct stats_mem *mem)
+{
+  stats_export_varint(w, (u32_t)mem->avail);
+  stats_export_varint(w, (u32_t)mem->used);
+  stats_export_varint(w, (u32_t)mem->max);
+  stats_export_varint(w, mem->err);
+  stats_export_varint(w, mem->illegal);
+}
+#endif /* MEM_STATS || MEMP_STATS */
+
+/**
+ * Encode a snapshot of lwip_stats in the stats_export() wire format.
+ *
+ * @param snap the snapshot to encode (see stats_snapshot())
+ * @param seqno export sequence number to put in the header
+ * @param now time of the snapshot (ms)
+ * @param buf where to encode to, NULL to only compute the length
+ * @param len size of buf
+ * @return the encoded length, 0 if buf was too small
+ */
+u16_t
+stats_export_encode(const struct stats_ *snap, u16_t seqno, u32_t now,
+                    u8_t *buf, u16_t len)
+{
+  struct stats_export_writer w;
+#if MEMP_STATS || SYS_STATS || LOCK_STATS
+  u16_t i;
+#endif
+
+  LWIP_UNUSED_ARG(snap);
+  w.buf = buf;
+  w.len = (buf != NULL) ? len : 0xffff;
+  w.pos = 8;
+  w.sections = 0;
+  w.overflow = (buf != NULL) && (len < 8);
+
+#if LINK_STATS
+  stats_export_counters(&w, STATS_EXPORT_LINK, &snap->link, sizeof(snap->link));
+  stats_export_section(&w, STATS_EXPORT_LINK_OCTETS, 2);
+  stats_export_varint(&w, snap->link_octets.recv);
+  stats_export_varint(&w, snap->link_octets.xmit);
+#endif /* LINK_STATS */
+#if ETHARP_STATS
+  stats_export_counters(&w, STATS_EXPORT_ETHARP, &snap->etharp, sizeof(snap->etharp));
+#endif
+#if IPFRAG_STATS
+  stats_export_counters(&w, STATS_EXPORT_IPFRAG, &snap->ip_frag, sizeof(snap->ip_frag));
+#endif
+#if IP_STATS
+  stats_export_counters(&w, STATS_EXPORT_IP, &snap->ip, sizeof(snap->ip));
+#endif
+#if ICMP_STATS
+  stats_export_counters(&w, STATS_EXPORT_ICMP, &snap->icmp, sizeof(snap->icmp));
+#endif
+#if IGMP_STATS
+  stats_export_counters(&w, STATS_EXPORT_IGMP, &snap->igmp, sizeof(snap->igmp));
+#endif
+#if UDP_STATS
+  stats_export_counters(&w, STATS_EXPORT_UDP, &snap->udp, sizeof(snap->udp));
+#endif
+#if TCP_STATS
+  stats_export_counters(&w, STATS_EXPORT_TCP, &snap->tcp, sizeof(snap->tcp));
+#endif
+#if DNS_STATS
+  stats_export_section(&w, STATS_EXPORT_DNS, 11);
+  stats_export_varint(&w, snap->dns.hit);
+  stats_export_varint(&w, snap->dns.neghit);
+  stats_export_varint(&w, snap->dns.miss);
+  stats_export_varint(&w, snap->dns.coalesced);
+  stats_export_varint(&w, snap->dns.prefetch);
+  stats_export_varint(&w, snap->dns.expired);
+  stats_export_varint(&w, snap->dns.timeout);
+  stats_export_varint(&w, snap->dns.nxdomain);
+  stats_export_varint(&w, snap->dns.answers);
+  stats_export_varint(&w, snap->dns.rtt_sum);
+  stats_export_varint(&w, snap->dns.rtt_max);
+#endif /* DNS_STATS */
+#if MEM_STATS
+  stats_export_section(&w, STATS_EXPORT_MEM, 5);
+  stats_export_mem(&w, &snap->mem);
+#endif
+#if MEMP_STATS
+  stats_export_section(&w, STATS_EXPORT_MEMP, MEMP_MAX * 5);
+  for (i = 0; i < MEMP_MAX; i++) {
+    stats_export_mem(&w, &snap->memp[i]);
+  }
+#endif /* MEMP_STATS */
+#if SYS_STATS
+  stats_export_section(&w, STATS_EXPORT_SYS, 9);
+  stats_export_varint(&w, snap->sys.sem.used);
+  stats_export_varint(&w, snap->sys.sem.max);
+  stats_export_varint(&w, snap->sys.sem.err);
+  stats_export_varint(&w, snap->sys.mutex.used);
+  stats_export_varint(&w, snap->sys.mutex.max);
+  stats_export_varint(&w, snap->sys.mutex.err);
+  stats_export_varint(&w, snap->sys.mbox.used);
+  stats_export_varint(&w, snap->sys.mbox.max);
+  stats_export_varint(&w, snap->sys.mbox.err);
+#endif /* SYS_STATS */
+#if LOCK_STATS
+  stats_export_section(&w, STATS_EXPORT_LOCK, 4 + 2 * LOCK_STATS_HIST_SIZE);
+  stats_export_varint(&w, snap->core_lock.acquired);
+  stats_export_varint(&w, snap->core_lock.contended);
+  stats_export_varint(&w, snap->core_lock.hold_max);
+  stats_export_varint(&w, snap->core_lock.wait_max);
+  for (i = 0; i < LOCK_STATS_HIST_SIZE; i++) {
+    stats_export_varint(&w, snap->core_lock.hold[i]);
+    stats_export_varint(&w, snap->core_lock.wait[i]);
+  }
+#endif /* LOCK_STATS */
+
+  if (w.overflow) {
+    return 0;
+  }
+  if (buf != NULL) {
+    buf[0] = STATS_EXPORT_VERSION;
+    buf[1] = w.sections;
+    buf[2] = (u8_t)(seqno >> 8);
+    buf[3] = (u8_t)seqno;
+    buf[4] = (u8_t)(now >> 24);
+    buf[5] = (u8_t)(now >> 16);
+    buf[6] = (u8_t)(now >> 8);
+    buf[7] = (u8_t)now;
+  }
+  return w.pos;
+}
+
+/**
+ * Send a snapshot of lwip_stats to a collector in one UDP datagram
+ * (see stats_export_encode() for the format).
+ *
+ * @param pcb the UDP pcb to send from
+ * @param dst_ip collector address
+ * @param dst_port collector port
+ * @return ERR_OK if sent, ERR_WOULDBLOCK if no consistent snapshot could be
+ *         taken, ERR_MEM if out of memory, or any udp_sendto() error
+ */
+err_t
+stats_export(struct udp_pcb *pcb, ip_addr_t *dst_ip, u16_t dst_port)
+{
+  static struct stats_ snap;
+  static u16_t seqno;
+  struct pbuf *p;
+  u32_t now;
+  u16_t len;
+  err_t err;
+
+  err = stats_snapshot(&snap);
+  if (err != ERR_OK) {
+    return err;
+  }
+  now = sys_now();
+  len = stats_export_encode(&snap, seqno, now, NULL, 0);
+  p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  stats_export_encode(&snap, seqno, now, (u8_t *)p->payload, len);
+  err = udp_sendto(pcb, p, dst_ip, dst_port);
+  pbuf_free(p);
+  if (err == ERR_OK) {
+    seqno++;
+  }
+  return err;
+}
+#endif /* LWIP_STATS_EXPORT */
+
 #if LWIP_STATS_DISPLAY
 void
 stats_display_proto(struct stats_proto *proto, const char *name)
@@ -86,6 +556,16 @@ stats_display_proto(struct stats_proto *proto, const char *name)
   LWIP_PLATFORM_DIAG(("cachehit: %"STAT_COUNTER_F"\n", proto->cachehit)); 
 }
 
+#if LINK_STATS
+void
+stats_display_octets(struct stats_octets *octets, const char *name)
+{
+  LWIP_PLATFORM_DIAG(("\n%s OCTETS\n\t", name));
+  LWIP_PLATFORM_DIAG(("recv: %"U32_F"\n\t", octets->recv));
+  LWIP_PLATFORM_DIAG(("xmit: %"U32_F"\n", octets->xmit));
+}
+#endif /* LINK_STATS */
+
 #if IGMP_STATS
 void
 stats_display_igmp(struct stats_igmp *igmp)
@@ -108,6 +588,30 @@ stats_display_igmp(struct stats_igmp *igmp)
 }
 #endif /* IGMP_STATS */
 
+#if DNS_STATS
+void
+stats_display_dns(struct stats_dns *dns)
+{
+  STAT_COUNTER lookups = dns->hit + dns->neghit + dns->miss + dns->coalesced;
+
+  LWIP_PLATFORM_DIAG(("\nDNS\n\t"));
+  LWIP_PLATFORM_DIAG(("hit: %"STAT_COUNTER_F"\n\t", dns->hit));
+  LWIP_PLATFORM_DIAG(("neghit: %"STAT_COUNTER_F"\n\t", dns->neghit));
+  LWIP_PLATFORM_DIAG(("miss: %"STAT_COUNTER_F"\n\t", dns->miss));
+  LWIP_PLATFORM_DIAG(("coalesced: %"STAT_COUNTER_F"\n\t", dns->coalesced));
+  LWIP_PLATFORM_DIAG(("prefetch: %"STAT_COUNTER_F"\n\t", dns->prefetch));
+  LWIP_PLATFORM_DIAG(("expired: %"STAT_COUNTER_F"\n\t", dns->expired));
+  LWIP_PLATFORM_DIAG(("timeout: %"STAT_COUNTER_F"\n\t", dns->timeout));
+  LWIP_PLATFORM_DIAG(("nxdomain: %"STAT_COUNTER_F"\n\t", dns->nxdomain));
+  LWIP_PLATFORM_DIAG(("answers: %"STAT_COUNTER_F"\n\t", dns->answers));
+  LWIP_PLATFORM_DIAG(("hit ratio: %"U32_F"%%\n\t",
+    lookups ? (u32_t)(((u32_t)dns->hit + dns->neghit) * 100 / lookups) : 0));
+  LWIP_PLATFORM_DIAG(("rtt avg: %"U32_F" ms\n\t",
+    dns->answers ? dns->rtt_sum / dns->answers : 0));
+  LWIP_PLATFORM_DIAG(("rtt max: %"U32_F" ms\n", dns->rtt_max));
+}
+#endif /* DNS_STATS */
+
 #if MEM_STATS || MEMP_STATS
 void
 stats_display_mem(struct stats_mem *mem, const char *name)
@@ -151,6 +655,26 @@ stats_display_sys(struct stats_sys *sys)
 }
 #endif /* SYS_STATS */
 
+#if LOCK_STATS
+void
+stats_display_lock(struct stats_lock *lock, const char *name)
+{
+  int i;
+
+  LWIP_PLATFORM_DIAG(("\nLOCK %s\n\t", name));
+  LWIP_PLATFORM_DIAG(("acquired:  %"STAT_COUNTER_F"\n\t", lock->acquired));
+  LWIP_PLATFORM_DIAG(("contended: %"STAT_COUNTER_F"\n\t", lock->contended));
+  LWIP_PLATFORM_DIAG(("hold_max:  %"U32_F"\n\t", lock->hold_max));
+  LWIP_PLATFORM_DIAG(("wait_max:  %"U32_F"\n", lock->wait_max));
+  for (i = 0; i < LOCK_STATS_HIST_SIZE - 1; i++) {
+    LWIP_PLATFORM_DIAG(("\t<%"U32_F": hold %"STAT_COUNTER_F" wait %"STAT_COUNTER_F"\n",
+      (u32_t)1 << i, lock->hold[i], lock->wait[i]));
+  }
+  LWIP_PLATFORM_DIAG(("\t>=%"U32_F": hold %"STAT_COUNTER_F" wait %"STAT_COUNTER_F"\n",
+    (u32_t)1 << (i - 1), lock->hold[i], lock->wait[i]));
+}
+#endif /* LOCK_STATS */
+
 void
 stats_display(void)
 {
@@ -164,11 +688,13 @@ stats_display(void)
   ICMP_STATS_DISPLAY();
   UDP_STATS_DISPLAY();
   TCP_STATS_DISPLAY();
+  DNS_STATS_DISPLAY();
   MEM_STATS_DISPLAY();
   for (i = 0; i < MEMP_MAX; i++) {
     MEMP_STATS_DISPLAY(i);
   }
   SYS_STATS_DISPLAY();
+  LOCK_STATS_DISPLAY();
 }
 #endif /* LWIP_STATS_DISPLAY */
 
@@ -52,6 +52,8 @@
 #include "lwip/tcp_impl.h"
 #include "lwip/debug.h"
 #include "lwip/stats.h"
+#include "lwip/sys.h"
+#include "lwip/rng.h"
 
 #include <string.h>
 
@@ -85,8 +87,30 @@ const char * const tcp_state_str[] = {
   "TIME_WAIT"   
 };
 
+#if TCP_RANDOM_LOCAL_PORTS
+#define TCP_PORT_RANGE_SIZE     ((u32_t)TCP_LOCAL_PORT_RANGE_END - TCP_LOCAL_PORT_RANGE_START + 1)
+#define TCP_PORT_MAP_WORDS      ((TCP_PORT_RANGE_SIZE + 31) / 32)
+#if TCP_LOCAL_PORT_RANGE_END < 0xffff
+#define TCP_PORT_IN_RANGE(port) (((port) >= TCP_LOCAL_PORT_RANGE_START) && \
+                                 ((port) <= TCP_LOCAL_PORT_RANGE_END))
+#else /* TCP_LOCAL_PORT_RANGE_END < 0xffff */
+/* no u16_t lies above the end of the range, only check the start */
+#define TCP_PORT_IN_RANGE(port) ((port) >= TCP_LOCAL_PORT_RANGE_START)
+#endif /* TCP_LOCAL_PORT_RANGE_END < 0xffff */
+/** One bit per port of the local port range: some pcb on the lists uses it */
+static u32_t tcp_port_used[TCP_PORT_MAP_WORDS];
+/** ... and more than one pcb does (SO_REUSE, or connections accepted on a
+ * listener bound inside the range), so releasing it needs a list walk */
+static u32_t tcp_port_shared[TCP_PORT_MAP_WORDS];
+/** A bound port might collide: only those in the range can be ruled out */
+#define TCP_PORT_MAYBE_USED(port) (!TCP_PORT_IN_RANGE(port) || \
+  (tcp_port_used[((port) - TCP_LOCAL_PORT_RANGE_START) >> 5] & \
+   (1UL << (((port) - TCP_LOCAL_PORT_RANGE_START) & 31))))
+#else /* TCP_RANDOM_LOCAL_PORTS */
 /* last local TCP port */
 static u16_t tcp_port = TCP_LOCAL_PORT_RANGE_START;
+#define TCP_PORT_MAYBE_USED(port) 1
+#endif /* TCP_RANDOM_LOCAL_PORTS */
 
 /* Incremented every coarse grained timer shot (typically every 500 ms). */
 u32_t tcp_ticks;
@@ -432,25 +456,28 @@ err_t tcp_bind(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port)
 
     if (port == 0)
     {
+        /* tcp_new_port()返回的端口不在任何列表中,不用再检查 */
         port = tcp_new_port();
         if (port == 0)
         {
             return ERR_BUF;
         }
     }
-
-    /* 检查地址是否已被使用(在所有列表中) */
-    for (i = 0; i < max_pcb_list; i++)
+    else if (TCP_PORT_MAYBE_USED(port))
     {
-        for (cpcb = *tcp_pcb_lists[i]; cpcb != NULL; cpcb = cpcb->next)
+        /* 检查地址是否已被使用(在所有列表中) */
+        for (i = 0; i < max_pcb_list; i++)
         {
-            if (cpcb->local_port == port)
+            for (cpcb = *tcp_pcb_lists[i]; cpcb != NULL; cpcb = cpcb->next)
             {
-                if (ip_addr_isany(&(cpcb->local_ip)) ||
-                    ip_addr_isany(ipaddr) ||
-                    ip_addr_cmp(&(cpcb->local_ip), ipaddr))
+                if (cpcb->local_port == port)
                 {
-                    return ERR_USE;
+                    if (ip_addr_isany(&(cpcb->local_ip)) ||
+                        ip_addr_isany(ipaddr) ||
+                        ip_addr_cmp(&(cpcb->local_ip), ipaddr))
+                    {
+                        return ERR_USE;
+                    }
                 }
             }
         }
@@ -598,6 +625,114 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
          len, pcb->rcv_wnd, TCP_WND - pcb->rcv_wnd));
 }
 
+#if TCP_RANDOM_LOCAL_PORTS
+/**
+ * Note that a pcb using 'port' has been put on one of the PCB lists.
+ * Called from TCP_REG.
+ */
+void
+tcp_port_ref(u16_t port)
+{
+  u32_t idx, bit;
+
+  if (!TCP_PORT_IN_RANGE(port)) {
+    return;
+  }
+  idx = port - TCP_LOCAL_PORT_RANGE_START;
+  bit = 1UL << (idx & 31);
+  idx >>= 5;
+  if (tcp_port_used[idx] & bit) {
+    tcp_port_shared[idx] |= bit;
+  } else {
+    tcp_port_used[idx] |= bit;
+  }
+}
+
+/**
+ * Note that a pcb using 'port' has been taken off the PCB lists (it must
+ * already be unlinked). Called from TCP_RMV and for the pcbs tcp_slowtmr()
+ * unlinks itself. Only a shared port needs to look at the lists.
+ */
+void
+tcp_port_unref(u16_t port)
+{
+  u32_t idx, bit;
+  u8_t i, n;
+  struct tcp_pcb *pcb;
+
+  if (!TCP_PORT_IN_RANGE(port)) {
+    return;
+  }
+  idx = port - TCP_LOCAL_PORT_RANGE_START;
+  bit = 1UL << (idx & 31);
+  idx >>= 5;
+  if ((tcp_port_shared[idx] & bit) == 0) {
+    tcp_port_used[idx] &= ~bit;
+    return;
+  }
+  /* count the remaining users, two are enough to stay shared */
+  n = 0;
+  for (i = 0; (i < NUM_TCP_PCB_LISTS) && (n < 2); i++) {
+    for (pcb = *tcp_pcb_lists[i]; (pcb != NULL) && (n < 2); pcb = pcb->next) {
+      if (pcb->local_port == port) {
+        n++;
+      }
+    }
+  }
+  if (n < 2) {
+    tcp_port_shared[idx] &= ~bit;
+  }
+  if (n == 0) {
+    tcp_port_used[idx] &= ~bit;
+  }
+}
+
+/** Index of the lowest bit set in 'x' (x != 0) */
+static u8_t
+tcp_port_lowbit(u32_t x)
+{
+  u8_t n = 0;
+
+  if ((x & 0xffff) == 0) { n += 16; x >>= 16; }
+  if ((x & 0xff) == 0)   { n += 8;  x >>= 8; }
+  if ((x & 0xf) == 0)    { n += 4;  x >>= 4; }
+  if ((x & 0x3) == 0)    { n += 2;  x >>= 2; }
+  if ((x & 0x1) == 0)    { n += 1; }
+  return n;
+}
+
+/**
+ * Allocate a new local TCP port: a random port of the range, or the next
+ * free one after it (RFC 6056, algorithm 1). The bitmap is searched a
+ * word at a time, the PCB lists aren't walked.
+ *
+ * @return a new (free) local TCP port number, 0 if all are in use
+ */
+static u16_t
+tcp_new_port(void)
+{
+  u32_t idx, w, avail;
+  u16_t n;
+
+  idx = rng_u32() % TCP_PORT_RANGE_SIZE;
+  w = idx >> 5;
+  /* free ports from idx to the end of its word first */
+  avail = ~tcp_port_used[w] & (0xffffffffUL << (idx & 31));
+  /* then the following words, wrapping around to the start of the first */
+  for (n = 0; n <= TCP_PORT_MAP_WORDS; n++) {
+    if (avail != 0) {
+      idx = (w << 5) + tcp_port_lowbit(avail);
+      /* bits past the end of the range read as free in the last word */
+      if (idx < TCP_PORT_RANGE_SIZE) {
+        return (u16_t)(TCP_LOCAL_PORT_RANGE_START + idx);
+      }
+    }
+    w = (w + 1 < TCP_PORT_MAP_WORDS) ? w + 1 : 0;
+    avail = ~tcp_port_used[w];
+  }
+  return 0;
+}
+#else /* TCP_RANDOM_LOCAL_PORTS */
 /**
  * Allocate a new local TCP port.
  *
@@ -627,6 +762,7 @@ again:
   }
   return tcp_port;
 }
+#endif /* TCP_RANDOM_LOCAL_PORTS */
 
 /**
  * Connects to another host. The function given as the "connected"
@@ -698,7 +834,7 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
     }
   }
 #endif /* SO_REUSE */
-  iss = tcp_next_iss();
+  iss = tcp_next_iss(pcb);
   pcb->rcv_nxt = 0;
   pcb->snd_nxt = iss;
   pcb->lastack = iss - 1;
@@ -918,6 +1054,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_active_pcbs", tcp_active_pcbs == pcb);
         tcp_active_pcbs = pcb->next;
       }
+      TCP_PORT_UNREF(pcb);
 
       if (pcb_reset) {
         tcp_rst(pcb->snd_nxt, pcb->rcv_nxt, &pcb->local_ip, &pcb->remote_ip,
@@ -986,6 +1123,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_tw_pcbs", tcp_tw_pcbs == pcb);
         tcp_tw_pcbs = pcb->next;
       }
+      TCP_PORT_UNREF(pcb);
       pcb2 = pcb;
       pcb = pcb->next;
       memp_free(MEMP_TCP_PCB, pcb2);
@@ -1285,7 +1423,7 @@ struct tcp_pcb *tcp_alloc(u8_t prio)
         pcb->sv = 3000 / TCP_SLOW_INTERVAL;
         pcb->rtime = -1;
         pcb->cwnd = 1;
-        iss = tcp_next_iss();
+        iss = tcp_next_iss(pcb);
         pcb->snd_wl2 = iss;
         pcb->snd_nxt = iss;
         pcb->lastack = iss;
@@ -1511,16 +1649,57 @@ tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
 /**
  * Calculates a new initial sequence number for new connections.
  *
+ * @param pcb the connection, its addresses and ports are used with
+ *        TCP_ISN_RFC6528 (set them before calling this)
  * @return u32_t pseudo random sequence number
  */
 u32_t
-tcp_next_iss(void)
+tcp_next_iss(struct tcp_pcb *pcb)
 {
+#if TCP_ISN_RFC6528
+  LWIP_ASSERT("tcp_next_iss: invalid pcb", pcb != NULL);
+  return tcp_isn_rfc6528(&pcb->local_ip, pcb->local_port,
+                         &pcb->remote_ip, pcb->remote_port);
+#else /* TCP_ISN_RFC6528 */
   static u32_t iss = 6510;
-  
+
+  LWIP_UNUSED_ARG(pcb);
   iss += tcp_ticks;       /* XXX */
   return iss;
+#endif /* TCP_ISN_RFC6528 */
+}
+
+#if LWIP_RNG
+/**
+ * Initial sequence number as in RFC 6528: ISN = M + F(localip, localport,
+ * remoteip, remoteport, secretkey). M is a 4 us clock derived from
+ * sys_now(), F is HalfSipHash-2-4 under a key drawn from the entropy pool
+ * on first use, so rng_set_source() should come before the first
+ * connection. Successive connections of the same 4-tuple still get
+ * increasing ISNs; other connections reveal nothing about them.
+ */
+u32_t
+tcp_isn_rfc6528(ip_addr_t *local_ip, u16_t local_port,
+       ip_addr_t *remote_ip, u16_t remote_port)
+{
+  static u32_t isn_key[2];
+  static u8_t isn_key_set;
+  u8_t tuple[12];
+
+  if (!isn_key_set) {
+    isn_key[0] = rng_u32();
+    isn_key[1] = rng_u32();
+    isn_key_set = 1;
+  }
+  SMEMCPY(&tuple[0], &local_ip->addr, 4);
+  SMEMCPY(&tuple[4], &remote_ip->addr, 4);
+  tuple[8]  = (u8_t)(local_port >> 8);
+  tuple[9]  = (u8_t)local_port;
+  tuple[10] = (u8_t)(remote_port >> 8);
+  tuple[11] = (u8_t)remote_port;
+  return sys_now() * 250 + rng_hash(isn_key, tuple, sizeof(tuple));
 }
+#endif /* LWIP_RNG */
 
 #if TCP_CALCULATE_EFF_SEND_MSS
 /**
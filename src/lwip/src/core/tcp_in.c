@@ -408,6 +408,10 @@ static err_t tcp_listen_input(struct tcp_pcb_listen *pcb)
         npcb->local_port = pcb->local_port;
         ip_addr_copy(npcb->remote_ip, current_iphdr_src);
         npcb->remote_port = tcphdr->src;
+#if TCP_ISN_RFC6528
+        /* tcp_alloc()时还不知道地址和端口,重新计算ISN */
+        npcb->snd_wl2 = npcb->snd_nxt = npcb->lastack = npcb->snd_lbb = tcp_next_iss(npcb);
+#endif /* TCP_ISN_RFC6528 */
         npcb->state = SYN_RCVD;
         npcb->rcv_nxt = seqno + 1;
         npcb->rcv_ann_right_edge = npcb->rcv_nxt;
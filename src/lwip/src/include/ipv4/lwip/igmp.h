@@ -70,7 +70,7 @@ extern "C" {
  * from all the other groups
  */
 struct igmp_group {
-  /** next link */
+  /** next group in the same bucket of netif->igmp_groups */
   struct igmp_group *next;
   /** interface on which the group is active */
   struct netif      *netif;
@@ -52,10 +52,17 @@ extern "C" {
  * This is exported because memp needs to know the size.
  */
 struct ip_reassdata {
+  /** next datagram in the same hash bucket */
   struct ip_reassdata *next;
-  struct pbuf *p;
+  /** fragments received so far, sorted by offset (a datagram can't have
+      more: every fragment takes at least one of the IP_REASS_MAX_PBUFS) */
+  struct pbuf *frags[IP_REASS_MAX_PBUFS];
   struct ip_hdr iphdr;
   u16_t datagram_len;
+  /** payload bytes received so far */
+  u16_t recv_len;
+  /** number of fragments in frags */
+  u16_t nfrags;
   u8_t flags;
   u8_t timer;
 };
@@ -66,7 +73,7 @@ struct pbuf * ip_reass(struct pbuf *p);
 #endif /* IP_REASSEMBLY */
 
 #if IP_FRAG
-#if !IP_FRAG_USES_STATIC_BUF && !LWIP_NETIF_TX_SINGLE_PBUF
+#if !LWIP_NETIF_TX_SINGLE_PBUF
 /** A custom pbuf that holds a reference to another pbuf, which is freed
  * when this custom pbuf is freed. This is used to create a custom PBUF_REF
  * that points into the original pbuf. */
@@ -76,7 +83,7 @@ struct pbuf_custom_ref {
   /** pointer to the original pbuf that is referenced */
   struct pbuf *original;
 };
-#endif /* !IP_FRAG_USES_STATIC_BUF && !LWIP_NETIF_TX_SINGLE_PBUF */
+#endif /* !LWIP_NETIF_TX_SINGLE_PBUF */
 
 err_t ip_frag(struct pbuf *p, struct netif *netif, ip_addr_t *dest);
 #endif /* IP_FRAG */
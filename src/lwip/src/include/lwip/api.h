@@ -108,7 +108,9 @@ enum netconn_evt {
   NETCONN_EVT_RCVMINUS,
   NETCONN_EVT_SENDPLUS,
   NETCONN_EVT_SENDMINUS,
-  NETCONN_EVT_ERROR
+  NETCONN_EVT_ERROR,
+  /** TCP: 'len' bytes of sent data have been ACKed by the remote side */
+  NETCONN_EVT_ACKED
 };
 
 #if LWIP_IGMP
@@ -189,6 +191,12 @@ struct netconn {
       Also used during connect and close. */
   struct api_msg_msg *current_msg;
 #endif /* LWIP_TCP */
+#if LWIP_NETCONN_ASYNC
+  /** pending netconn_connect/write/close_async operation */
+  struct netconn_async *async_op;
+  /** pending netconn_recv_async operation */
+  struct netconn_async *async_recv;
+#endif /* LWIP_NETCONN_ASYNC */
   /** A callback function that is informed about events for this netconn */
   netconn_callback callback;
 };
@@ -239,6 +247,30 @@ err_t   netconn_write_partly(struct netconn *conn, const void *dataptr, size_t s
                              u8_t apiflags, size_t *bytes_written);
 #define netconn_write(conn, dataptr, size, apiflags) \
           netconn_write_partly(conn, dataptr, size, apiflags, NULL)
+#if LWIP_NETCONN_BATCH
+struct netconn_batch;
+void    netconn_batch_init(struct netconn_batch *b);
+err_t   netconn_batch_send(struct netconn_batch *b, struct netconn *conn, struct netbuf *buf);
+err_t   netconn_batch_write(struct netconn_batch *b, struct netconn *conn,
+                            const void *dataptr, size_t size, u8_t apiflags);
+err_t   netconn_batch_commit(struct netconn_batch *b);
+/** Result of the i-th operation of a committed batch */
+#define netconn_batch_err(b, i)         ((b)->msgs[i].msg.err)
+#endif /* LWIP_NETCONN_BATCH */
+#if LWIP_NETCONN_ASYNC
+struct netconn_async;
+/** Completion callback of a netconn_*_async() operation,
+    called from tcpip_thread context: must not block */
+typedef void (*netconn_async_fn)(struct netconn_async *op, void *arg);
+void    netconn_async_init(struct netconn_async *op, netconn_async_fn callback, void *arg);
+err_t   netconn_async_poll(struct netconn_async *op);
+err_t   netconn_connect_async(struct netconn *conn, ip_addr_t *addr, u16_t port,
+                              struct netconn_async *op);
+err_t   netconn_write_async(struct netconn *conn, const void *dataptr, size_t size,
+                            u8_t apiflags, struct netconn_async *op);
+err_t   netconn_recv_async(struct netconn *conn, struct netconn_async *op);
+err_t   netconn_close_async(struct netconn *conn, struct netconn_async *op);
+#endif /* LWIP_NETCONN_ASYNC */
 err_t   netconn_close(struct netconn *conn);
 err_t   netconn_shutdown(struct netconn *conn, u8_t shut_rx, u8_t shut_tx);
 
@@ -127,6 +127,47 @@ struct api_msg {
   struct api_msg_msg msg;
 };
 
+#if LWIP_NETCONN_BATCH
+/** A set of netconn operations submitted to tcpip_thread with one message
+    (see netconn_batch_commit). Every operation must be on a different
+    netconn. */
+struct netconn_batch {
+  /** number of operations queued */
+  u8_t num;
+  /** the queued operations, msgs[i].msg.err holds the result after commit */
+  struct api_msg msgs[NETCONN_BATCH_MAX];
+};
+#endif /* LWIP_NETCONN_BATCH */
+
+#if LWIP_NETCONN_ASYNC
+#define NETCONN_ASYNC_IDLE     0
+#define NETCONN_ASYNC_PENDING  1
+#define NETCONN_ASYNC_DONE     2
+
+/** A netconn operation running in the background (see netconn_*_async).
+    Must stay valid until the operation has completed. */
+struct netconn_async {
+  /** called in tcpip_thread when the operation has completed (may be NULL) */
+  netconn_async_fn callback;
+  /** argument passed to callback */
+  void *arg;
+  /** NETCONN_ASYNC_IDLE, NETCONN_ASYNC_PENDING or NETCONN_ASYNC_DONE */
+  volatile u8_t state;
+  /** result of the operation, valid when state is NETCONN_ASYNC_DONE */
+  err_t err;
+  /** netconn_recv_async: the data received (struct pbuf * for TCP,
+      struct netbuf * for UDP and RAW), owned by the application */
+  void *buf;
+  /** the lower-level operation executed in tcpip_thread */
+  struct api_msg msg;
+};
+
+/** Check whether an async operation has completed */
+#define netconn_async_done(op)    ((op)->state == NETCONN_ASYNC_DONE)
+/** netconn_write_async: number of bytes written */
+#define netconn_async_written(op) ((op)->msg.msg.msg.w.len)
+#endif /* LWIP_NETCONN_ASYNC */
+
 #if LWIP_DNS
 /** As do_gethostbyname requires more arguments but doesn't require a netconn,
     it has its own struct (to avoid struct api_msg getting bigger than necessary).
@@ -164,6 +205,10 @@ void do_join_leave_group( struct api_msg_msg *msg);
 #if LWIP_DNS
 void do_gethostbyname(void *arg);
 #endif /* LWIP_DNS */
+#if LWIP_NETCONN_ASYNC
+void do_recv_async      ( struct api_msg_msg *msg);
+void netconn_op_completed(struct api_msg_msg *msg);
+#endif /* LWIP_NETCONN_ASYNC */
 
 struct netconn* netconn_alloc(enum netconn_type t, netconn_callback callback);
 void netconn_free(struct netconn *conn);
@@ -0,0 +1,180 @@
+/**
+ * @file
+ * Packet filter programs (a subset of classic BPF) and a capture ring
+ *
+ */
+
+/*
+ * Copyright (c) 2001-2004 Swedish Institute of Computer Science.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT 
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING 
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#ifndef __LWIP_BPF_H__
+#define __LWIP_BPF_H__
+
+#include "lwip/opt.h"
+
+#if LWIP_BPF /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/pbuf.h"
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** One instruction, laid out as in classic BPF so that the output of
+ * "tcpdump -dd <expression>" can be pasted into an array */
+struct bpf_insn {
+  u16_t code;
+  u8_t  jt;
+  u8_t  jf;
+  u32_t k;
+};
+
+struct bpf_program {
+  u16_t bf_len;
+  const struct bpf_insn *bf_insns;
+};
+
+/* Instruction classes */
+#define BPF_CLASS(code) ((code) & 0x07)
+#define BPF_LD          0x00
+#define BPF_LDX         0x01
+#define BPF_ST          0x02
+#define BPF_STX         0x03
+#define BPF_ALU         0x04
+#define BPF_JMP         0x05
+#define BPF_RET         0x06
+#define BPF_MISC        0x07
+
+/* ld/ldx fields */
+#define BPF_W           0x00
+#define BPF_H           0x08
+#define BPF_B           0x10
+#define BPF_IMM         0x00
+#define BPF_ABS         0x20
+#define BPF_IND         0x40
+#define BPF_MEM         0x60
+#define BPF_LEN         0x80
+#define BPF_MSH         0xa0
+
+/* alu/jmp fields */
+#define BPF_ADD         0x00
+#define BPF_SUB         0x10
+#define BPF_MUL         0x20
+#define BPF_DIV         0x30
+#define BPF_OR          0x40
+#define BPF_AND         0x50
+#define BPF_LSH         0x60
+#define BPF_RSH         0x70
+#define BPF_NEG         0x80
+#define BPF_MOD         0x90
+#define BPF_XOR         0xa0
+
+#define BPF_JA          0x00
+#define BPF_JEQ         0x10
+#define BPF_JGT         0x20
+#define BPF_JGE         0x30
+#define BPF_JSET        0x40
+#define BPF_K           0x00
+#define BPF_X           0x08
+
+/* ret and misc fields */
+#define BPF_A           0x10
+#define BPF_TAX         0x00
+#define BPF_TXA         0x80
+
+/** Number of scratch memory words */
+#define BPF_MEMWORDS    16
+
+#define BPF_STMT(code, k)         { (u16_t)(code), 0, 0, k }
+#define BPF_JUMP(code, k, jt, jf) { (u16_t)(code), jt, jf, k }
+
+/** Initializer for a struct bpf_program from an array of instructions */
+#define BPF_PROGRAM(insns) { (u16_t)(sizeof(insns) / sizeof((insns)[0])), insns }
+
+err_t bpf_validate(const struct bpf_program *prog);
+/* Run a validated program over the packet, 0 means reject, otherwise the
+ * number of bytes to keep */
+u32_t bpf_filter(const struct bpf_program *prog, struct pbuf *p);
+
+/** Header of a record in a capture ring */
+struct bpf_ring_hdr {
+  u32_t time;     /* sys_now() when captured */
+  u16_t len;      /* length of the packet */
+  u16_t caplen;   /* bytes kept */
+  u32_t flags;    /* BPF_RING_IN or BPF_RING_OUT */
+};
+
+/* bpf_ring_hdr flags */
+#define BPF_RING_IN     0x01  /* received */
+#define BPF_RING_OUT    0x02  /* sent */
+#define BPF_RING_REF    0x80  /* data is a pbuf reference (internal) */
+
+/** Bytes a packet takes in a ring with snaplen 0 */
+#define BPF_RING_REF_SIZE (sizeof(struct bpf_ring_hdr) + 2 * sizeof(void *))
+
+/** A ring of captured packets in a caller-supplied buffer. When it is
+ * full, the oldest records are overwritten.
+ *
+ * With a snaplen of 0 the ring keeps a reference to each pbuf instead
+ * of a copy of it. Nothing is copied until the record is read, but:
+ * - the pbufs stay allocated while in the ring, so a ring for received
+ *   frames must hold far fewer of them than PBUF_POOL_SIZE;
+ * - what is read is the pbuf as it is then: the stack changes some in
+ *   place (an echo request becomes the reply, a TCP header is rewritten
+ *   for a retransmission) and data of PBUF_REF/ROM pbufs belongs to
+ *   the application.
+ */
+struct bpf_ring {
+  const struct bpf_program *filter; /* NULL: keep every packet */
+  u8_t *buf;
+  u32_t size;
+  u32_t head;         /* where the next record goes */
+  u32_t tail;         /* oldest record */
+  u32_t count;        /* records in the ring */
+  u16_t snaplen;      /* at most this many bytes per packet, 0: references */
+  /* counters */
+  u32_t captured;
+  u32_t rejected;     /* by the filter */
+  u32_t overwritten;  /* oldest records dropped for new ones */
+};
+
+err_t bpf_ring_init(struct bpf_ring *r, void *buf, u32_t size,
+                    const struct bpf_program *filter, u16_t snaplen);
+void  bpf_ring_add(struct bpf_ring *r, struct pbuf *p, u32_t flags);
+err_t bpf_ring_read(struct bpf_ring *r, struct bpf_ring_hdr *hdr, void *data, u16_t len);
+void  bpf_ring_flush(struct bpf_ring *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_BPF */
+
+#endif /* __LWIP_BPF_H__ */
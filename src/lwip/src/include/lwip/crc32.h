@@ -0,0 +1,69 @@
+/**
+ * @file
+ * CRC-32 (IEEE 802.3, as computed by zlib) over buffers and pbuf chains
+ *
+ */
+
+/*
+ * Copyright (c) 2001-2004 Swedish Institute of Computer Science.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT 
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING 
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#ifndef __LWIP_CRC32_H__
+#define __LWIP_CRC32_H__
+
+#include "lwip/opt.h"
+
+#if LWIP_CRC32 /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/pbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A CRC-32 engine (e.g. a CRC peripheral): continues 'crc' over 'len'
+ * bytes at 'data' exactly like crc32_sw() does. It has to cope with any
+ * alignment and length and must fall back to crc32_sw() itself when the
+ * hardware is in use. */
+typedef u32_t (*crc32_engine_fn)(u32_t crc, const u8_t *data, u32_t len);
+
+/* Select the engine for runs of at least 'min_len' bytes, NULL for software */
+void  crc32_set_engine(crc32_engine_fn engine, u32_t min_len);
+
+/* 'crc' is 0 to start and the previous result to continue */
+u32_t crc32(u32_t crc, const void *data, u32_t len);
+u32_t crc32_sw(u32_t crc, const void *data, u32_t len);
+u32_t crc32_pbuf(u32_t crc, struct pbuf *p, u16_t offset, u16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_CRC32 */
+
+#endif /* __LWIP_CRC32_H__ */
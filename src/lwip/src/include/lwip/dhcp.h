@@ -105,6 +105,43 @@ PACK_STRUCT_END
 #  include "arch/epstruct.h"
 #endif
 
+#if LWIP_DHCP_LEASE_STORE
+/** A DHCP lease as kept across reboots, see dhcp_set_lease_store() */
+struct dhcp_lease
+{
+  /** leased address */
+  ip_addr_t ipaddr;
+  /** address of the server that granted the lease */
+  ip_addr_t server_ip_addr;
+  /** lease period (in seconds) granted by the server */
+  u32_t lease_time;
+};
+
+/** Function prototype to load the stored lease of a netif.
+ * Return ERR_OK if a lease that is still valid (as far as the application
+ * can tell, e.g. using an RTC) was copied to 'lease', any other value if not.
+ */
+typedef err_t (*dhcp_lease_load_fn)(struct netif *netif, struct dhcp_lease *lease);
+/** Function prototype to store the lease of a netif.
+ * 'lease' is NULL if the stored lease must be invalidated (on release or if
+ * the server refused it). */
+typedef void (*dhcp_lease_save_fn)(struct netif *netif, const struct dhcp_lease *lease);
+
+void dhcp_set_lease_store(dhcp_lease_load_fn load, dhcp_lease_save_fn save);
+#endif /* LWIP_DHCP_LEASE_STORE */
+
+#if LWIP_DHCP_OPTION_CALLBACK
+/** Function prototype for the option callback, see dhcp_set_option_callback().
+ * The 'len' bytes of option data start at 'offset' in pbuf 'p' and may
+ * continue in p->next, use pbuf_copy_partial() to read them.
+ * Called from the receive path for every matching reply, before the message
+ * is processed by the client.
+ */
+typedef void (*dhcp_option_fn)(struct netif *netif, u8_t code, u8_t len, struct pbuf *p, u16_t offset);
+
+void dhcp_set_option_callback(dhcp_option_fn fn);
+#endif /* LWIP_DHCP_OPTION_CALLBACK */
+
 void dhcp_set_struct(struct netif *netif, struct dhcp *dhcp);
 /** Remove a struct dhcp previously set to the netif using dhcp_set_struct() */
 #define dhcp_remove_struct(netif) do { (netif)->dhcp = NULL; } while(0)
@@ -204,6 +241,7 @@ void dhcp_fine_tmr(void);
 #define DHCP_OPTION_MTU 26
 #define DHCP_OPTION_BROADCAST 28
 #define DHCP_OPTION_TCP_TTL 37
+#define DHCP_OPTION_VENDOR_SPECIFIC 43 /* RFC 2132 8.4 */
 #define DHCP_OPTION_END 255
 
 /** DHCP options */
@@ -226,6 +264,7 @@ void dhcp_fine_tmr(void);
 #define DHCP_OPTION_CLIENT_ID 61
 #define DHCP_OPTION_TFTP_SERVERNAME 66
 #define DHCP_OPTION_BOOTFILE 67
+#define DHCP_OPTION_RAPID_COMMIT 80 /* RFC 4039, no data */
 
 /** possible combinations of overloading the file and sname fields with options */
 #define DHCP_OVERLOAD_NONE 0
@@ -103,10 +103,23 @@ struct local_hostlist_entry {
 */
 typedef void (*dns_found_callback)(const char *name, ip_addr_t *ipaddr, void *callback_arg);
 
+/** Round trip statistics of a DNS server, see dns_getserver_stats() */
+struct dns_server_stats {
+  /** smoothed round trip time in milliseconds */
+  u32_t srtt;
+  /** number of answers received */
+  u16_t answers;
+  /** number of queries another server answered first */
+  u16_t lost;
+  /** number of queries not answered at all */
+  u16_t timeouts;
+};
+
 void           dns_init(void);
 void           dns_tmr(void);
 void           dns_setserver(u8_t numdns, ip_addr_t *dnsserver);
 ip_addr_t      dns_getserver(u8_t numdns);
+const struct dns_server_stats *dns_getserver_stats(u8_t numdns);
 err_t          dns_gethostbyname(const char *hostname, ip_addr_t *addr,
                                  dns_found_callback found, void *callback_arg);
 
@@ -119,6 +119,19 @@ typedef err_t (*netif_input_fn)(struct pbuf *p, struct netif *inp);
  */
 typedef err_t (*netif_output_fn)(struct netif *netif, struct pbuf *p,
        ip_addr_t *ipaddr);
+#if LWIP_NETIF_OUTPUT_BATCH
+/** Function prototype for netif->output_batch functions. Called by lwIP when
+ * several packets shall be sent to the same address, e.g. the fragments of
+ * a datagram. The packets are freed by the caller after this returns.
+ *
+ * @param netif The netif which shall send the packets
+ * @param p Array of packets to send (p[i]->payload points to IP header)
+ * @param num Number of packets in p
+ * @param ipaddr The IP address to which the packets shall be sent
+ */
+typedef err_t (*netif_output_batch_fn)(struct netif *netif, struct pbuf **p,
+       u8_t num, ip_addr_t *ipaddr);
+#endif /* LWIP_NETIF_OUTPUT_BATCH */
 /** Function prototype for netif->linkoutput functions. Only used for ethernet
  * netifs. This function is called by ARP when a packet shall be sent.
  *
@@ -148,6 +161,11 @@ struct netif {
     /** 当IP模块要在接口上发送数据包时,将调用此功能.
     此功能通常首先解析硬件地址,然后发送数据包.*/
     netif_output_fn output;
+#if LWIP_NETIF_OUTPUT_BATCH
+    /** Optional: send several packets to the same address in one call.
+    If this is NULL, output is called for each packet instead. */
+    netif_output_batch_fn output_batch;
+#endif /* LWIP_NETIF_OUTPUT_BATCH */
 
     /** ARP模块要在接口上发送数据包时会调用此功能.
     此功能按原样在链接介质上输出pbuf.*/
@@ -156,6 +174,10 @@ struct netif {
     /** This field can be set by the device driver and could point
     *  to state information for the device. */
     void *state;
+#if LWIP_DHCP
+    /** the DHCP client state information for this netif */
+    struct dhcp *dhcp;
+#endif /* LWIP_DHCP */
 
     /** maximum transfer unit (in bytes) */
     u16_t mtu;
@@ -175,6 +197,34 @@ struct netif {
     /** number of this interface */
     u8_t num;
 
+#if LWIP_SNMP
+    /** link type (from "snmp_ifType" enum from snmp.h) */
+    u8_t link_type;
+    /** (estimate) link speed */
+    u32_t link_speed;
+    /** timestamp at last change made (up/down) */
+    u32_t ts;
+    /** counters */
+    u32_t ifinoctets;
+    u32_t ifinucastpkts;
+    u32_t ifinnucastpkts;
+    u32_t ifindiscards;
+    u32_t ifoutoctets;
+    u32_t ifoutucastpkts;
+    u32_t ifoutnucastpkts;
+    u32_t ifoutdiscards;
+#endif /* LWIP_SNMP */
+#if LWIP_IGMP
+    /** This function could be called to add or delete a entry in the multicast
+        filter table of the ethernet MAC.*/
+    netif_igmp_mac_filter_fn igmp_mac_filter;
+    /** IGMP groups joined on this interface, hashed by group address */
+    struct igmp_group *igmp_groups[IGMP_GROUP_HASH_SIZE];
+#endif /* LWIP_IGMP */
+#if LWIP_BPF
+    /** received and sent frames are recorded in this ring (if its filter accepts them) */
+    struct bpf_ring *capture;
+#endif /* LWIP_BPF */
 };
 
 #if LWIP_SNMP
@@ -255,6 +305,13 @@ void netif_set_link_callback(struct netif *netif, netif_status_callback_fn link_
 #define netif_get_igmp_mac_filter(netif) (((netif) != NULL) ? ((netif)->igmp_mac_filter) : NULL)
 #endif /* LWIP_IGMP */
 
+#if LWIP_BPF
+/** Capture the Ethernet frames received and sent into a ring set up with
+ * bpf_ring_init(), NULL to stop (bpf_ring_flush() then releases the pbufs
+ * a ring with snaplen 0 still holds) */
+#define netif_set_capture(netif, ring) do { if((netif) != NULL) { (netif)->capture = ring; }}while(0)
+#endif /* LWIP_BPF */
+
 #if ENABLE_LOOPBACK
 err_t netif_loop_output(struct netif *netif, struct pbuf *p, ip_addr_t *dest_ip);
 void netif_poll(struct netif *netif);
@@ -278,9 +278,11 @@
 /**
  * MEMP_NUM_FRAG_PBUF: the number of IP fragments simultaneously sent
  * (fragments, not whole packets!).
- * This is only used with IP_FRAG_USES_STATIC_BUF==0 and
- * LWIP_NETIF_TX_SINGLE_PBUF==0 and only has to be > 1 with DMA-enabled MACs
- * where the packet is not yet sent when netif->output returns.
+ * This is only used with LWIP_NETIF_TX_SINGLE_PBUF==0. A fragment needs one
+ * of these for every pbuf of the original packet it spans. It has to be at
+ * least IP_FRAG_BATCH_SIZE since all fragments of a batch are built before
+ * they are passed to the netif; if a batch runs out anyway, it is sent
+ * before it is full.
  */
 #ifndef MEMP_NUM_FRAG_PBUF
 #define MEMP_NUM_FRAG_PBUF              15
@@ -313,7 +315,7 @@
  * The formula expects settings to be either '0' or '1'.
  */
 #ifndef MEMP_NUM_SYS_TIMEOUT
-#define MEMP_NUM_SYS_TIMEOUT            (LWIP_TCP + IP_REASSEMBLY + LWIP_ARP + (2*LWIP_DHCP) + LWIP_AUTOIP + LWIP_IGMP + LWIP_DNS + PPP_SUPPORT)
+#define MEMP_NUM_SYS_TIMEOUT            (LWIP_TCP + IP_REASSEMBLY + LWIP_ARP + (2*LWIP_DHCP) + LWIP_AUTOIP + LWIP_IGMP + LWIP_DNS + (LWIP_DNS && DNS_RACE_SERVERS) + PPP_SUPPORT)
 #endif
 
 /**
@@ -350,6 +352,14 @@
 #define MEMP_NUM_TCPIP_MSG_INPKT        8
 #endif
 
+/**
+ * MEMP_NUM_TCPIP_MSG_INPKT_BATCH: the number of packet batches that can be
+ * queued for tcpip_thread at the same time (used by tcpip_input_batch()).
+ */
+#ifndef MEMP_NUM_TCPIP_MSG_INPKT_BATCH
+#define MEMP_NUM_TCPIP_MSG_INPKT_BATCH  2
+#endif
+
 /**
  * MEMP_NUM_SNMP_NODE: the number of leafs in the SNMP tree.
  */
@@ -548,28 +558,36 @@
  * Since the received pbufs are enqueued, be sure to configure
  * PBUF_POOL_SIZE > IP_REASS_MAX_PBUFS so that the stack is still able to receive
  * packets even if the maximum amount of fragments is enqueued for reassembly!
+ * It also limits the fragments of one datagram: every struct ip_reassdata
+ * indexes up to IP_REASS_MAX_PBUFS of them (one pointer each, so this costs
+ * MEMP_NUM_REASSDATA * IP_REASS_MAX_PBUFS pointers of RAM).
  */
 #ifndef IP_REASS_MAX_PBUFS
 #define IP_REASS_MAX_PBUFS              10
 #endif
 
 /**
- * IP_FRAG_USES_STATIC_BUF==1: Use a static MTU-sized buffer for IP
- * fragmentation. Otherwise pbufs are allocated and reference the original
- * packet data to be fragmented (or with LWIP_NETIF_TX_SINGLE_PBUF==1,
- * new PBUF_RAM pbufs are used for fragments).
- * ATTENTION: IP_FRAG_USES_STATIC_BUF==1 may not be used for DMA-enabled MACs!
+ * IP_REASS_HASH_SIZE: Number of hash buckets used to look up the datagram
+ * an incoming fragment belongs to. There's no need to go beyond
+ * MEMP_NUM_REASSDATA.
  */
-#ifndef IP_FRAG_USES_STATIC_BUF
-#define IP_FRAG_USES_STATIC_BUF         0
+#ifndef IP_REASS_HASH_SIZE
+#define IP_REASS_HASH_SIZE              4
 #endif
 
 /**
- * IP_FRAG_MAX_MTU: Assumed max MTU on any interface for IP frag buffer
- * (requires IP_FRAG_USES_STATIC_BUF==1)
+ * IP_FRAG_BATCH_SIZE: the number of fragments of a datagram built before
+ * they are passed to the netif together (see LWIP_NETIF_OUTPUT_BATCH).
+ * Fragments consist of a header pbuf followed by PBUF_REFs pointing into
+ * the original packet (or with LWIP_NETIF_TX_SINGLE_PBUF==1, new PBUF_RAM
+ * pbufs are used for fragments), so a batch holds at least this many
+ * MEMP_FRAG_PBUFs. A batch running out of them is sent early.
+ * The default uses all MEMP_FRAG_PBUFs: with an MTU of 1500, a datagram of
+ * up to MEMP_NUM_FRAG_PBUF * 1480 bytes (22 KB) goes out in one batch.
+ * The batch is an array of pointers on the stack of ip_frag().
  */
-#if IP_FRAG_USES_STATIC_BUF && !defined(IP_FRAG_MAX_MTU)
-#define IP_FRAG_MAX_MTU                 1500
+#ifndef IP_FRAG_BATCH_SIZE
+#define IP_FRAG_BATCH_SIZE              MEMP_NUM_FRAG_PBUF
 #endif
 
 /**
@@ -688,6 +706,34 @@
 #define DHCP_DOES_ARP_CHECK             ((LWIP_DHCP) && (LWIP_ARP))
 #endif
 
+/**
+ * LWIP_DHCP_RAPID_COMMIT==1: Send the Rapid Commit option (RFC 4039) in
+ * DISCOVER messages: a server supporting it answers with an ACK right away,
+ * saving the OFFER/REQUEST round trip. Other servers answer with an OFFER.
+ */
+#ifndef LWIP_DHCP_RAPID_COMMIT
+#define LWIP_DHCP_RAPID_COMMIT          0
+#endif
+
+/**
+ * LWIP_DHCP_LEASE_STORE==1: Keep the lease across reboots using the callbacks
+ * set with dhcp_set_lease_store(). If a lease is stored, dhcp_start() and a
+ * link-up verify it with INIT-REBOOT (a single REQUEST/ACK exchange) instead
+ * of discovering a server.
+ */
+#ifndef LWIP_DHCP_LEASE_STORE
+#define LWIP_DHCP_LEASE_STORE           0
+#endif
+
+/**
+ * LWIP_DHCP_OPTION_CALLBACK==1: Pass the options of received DHCP messages
+ * that the client does not use itself (e.g. vendor specific information) to
+ * the callback set with dhcp_set_option_callback().
+ */
+#ifndef LWIP_DHCP_OPTION_CALLBACK
+#define LWIP_DHCP_OPTION_CALLBACK       0
+#endif
+
 /*
    ------------------------------------
    ---------- AUTOIP options ----------
@@ -792,6 +838,37 @@
 #define SNMP_MAX_VALUE_SIZE             LWIP_MAX((SNMP_MAX_OCTET_STRING_LEN)+1, sizeof(s32_t)*(SNMP_MAX_TREE_DEPTH))
 #endif
 
+/**
+ * SNMP_V2C==1: Accept SNMPv2c requests (including GetBulkRequest) besides
+ * SNMPv1. GetNext/GetBulk past the end of the MIB return endOfMibView for
+ * v2c, other errors are reported with SNMPv1 error codes.
+ * GetBulk responses need MEMP_NUM_SNMP_VARBIND and MEMP_NUM_SNMP_VALUE to be
+ * sized for the number of varbinds to be returned at once.
+ */
+#ifndef SNMP_V2C
+#define SNMP_V2C                        0
+#endif
+
+/**
+ * SNMP_MAX_BULK_LEN: Maximum length of a GetBulk response (UDP payload).
+ * Trailing varbinds are dropped until the response fits. The default fits
+ * into one Ethernet frame.
+ */
+#ifndef SNMP_MAX_BULK_LEN
+#define SNMP_MAX_BULK_LEN               1472
+#endif
+
+/**
+ * SNMP_GETNEXT_CACHE: Number of MIB tree positions of GetNext results to
+ * remember (0 disables the cache). A walk (GetNext/GetBulk on a previously
+ * returned name) continues from there instead of descending from the root
+ * again. Use at least the number of columns walked in one request.
+ * Each position costs about 16 * LWIP_SNMP_OBJ_ID_LEN bytes of RAM.
+ */
+#ifndef SNMP_GETNEXT_CACHE
+#define SNMP_GETNEXT_CACHE              0
+#endif
+
 /*
    ----------------------------------
    ---------- IGMP options ----------
@@ -804,6 +881,16 @@
 #define LWIP_IGMP                       0
 #endif
 
+/**
+ * IGMP_GROUP_HASH_SIZE: Number of hash buckets each netif keeps its IGMP
+ * groups in (a power of 2). Received multicast datagrams and queries only
+ * search the bucket of their group address. Each bucket costs a pointer
+ * per netif; 1 keeps one list per netif.
+ */
+#ifndef IGMP_GROUP_HASH_SIZE
+#define IGMP_GROUP_HASH_SIZE            8
+#endif
+
 /*
    ----------------------------------
    ---------- DNS options -----------
@@ -832,6 +919,59 @@
 #define DNS_MAX_SERVERS                 2
 #endif
 
+/** DNS maximum number of dns_gethostbyname() requests waiting for an answer.
+ * Requests for a name already being queried share its dns_table entry. */
+#ifndef DNS_MAX_REQUESTS
+#define DNS_MAX_REQUESTS                4
+#endif
+
+/** DNS number of hash buckets used to look up names in the dns_table. */
+#ifndef DNS_HASH_SIZE
+#define DNS_HASH_SIZE                   8
+#endif
+
+/** DNS time in seconds to remember that a name does not exist (NXDOMAIN),
+ * 0 to disable negative caching. Lookups of such a name return ERR_VAL
+ * without sending a query. */
+#ifndef DNS_NEG_TTL
+#define DNS_NEG_TTL                     60
+#endif
+
+/** DNS time in seconds to remember that no server answered for a name,
+ * 0 to disable. */
+#ifndef DNS_TIMEOUT_NEG_TTL
+#define DNS_TIMEOUT_NEG_TTL             10
+#endif
+
+/** DNS time in seconds before the expiry of an entry to refresh it in the
+ * background (the cached address is still returned meanwhile), 0 to disable
+ * prefetching. */
+#ifndef DNS_PREFETCH_TIME
+#define DNS_PREFETCH_TIME               10
+#endif
+
+/** DNS number of lookups an entry must have had since it was resolved to be
+ * prefetched. */
+#ifndef DNS_PREFETCH_MIN_HITS
+#define DNS_PREFETCH_MIN_HITS           2
+#endif
+
+/** DNS_RACE_SERVERS==1: Query the fastest DNS server (by smoothed round trip
+ * time) first and the other servers too if it does not answer within
+ * DNS_HEDGE_DELAY. The first valid answer is used. If this is 0, the servers
+ * are tried one after the other, each DNS_MAX_RETRIES times. */
+#ifndef DNS_RACE_SERVERS
+#define DNS_RACE_SERVERS                0
+#endif
+
+/** DNS_HEDGE_DELAY: Maximum time in milliseconds to wait for the fastest
+ * server before also querying the other servers (DNS_RACE_SERVERS==1). The
+ * delay is shortened to twice the server's smoothed round trip time, but not
+ * below DNS_HEDGE_DELAY/4. 0 queries all servers at once. */
+#ifndef DNS_HEDGE_DELAY
+#define DNS_HEDGE_DELAY                 200
+#endif
+
 /** DNS do a name checking between the query and the response. */
 #ifndef DNS_DOES_NAME_CHECK
 #define DNS_DOES_NAME_CHECK             1
@@ -1060,6 +1200,27 @@
 #define TCP_WND_UPDATE_THRESHOLD   (TCP_WND / 4)
 #endif
 
+/**
+ * TCP_ISN_RFC6528==1: Generate initial sequence numbers as in RFC 6528:
+ * a 4 us clock (derived from sys_now()) plus a keyed hash of the
+ * connection's addresses and ports, so ISNs can't be predicted from
+ * other connections. Requires LWIP_RNG for the secret key.
+ */
+#ifndef TCP_ISN_RFC6528
+#define TCP_ISN_RFC6528                 0
+#endif
+
+/**
+ * TCP_RANDOM_LOCAL_PORTS==1: Pick ephemeral local ports at random
+ * (RFC 6056, algorithm 1) and track the ports in use in a bitmap so that
+ * finding a free port doesn't walk the PCB lists. The bitmap costs
+ * 2 * (TCP_LOCAL_PORT_RANGE_END - TCP_LOCAL_PORT_RANGE_START + 1) bits of
+ * RAM, 4 KB for the default range. Requires LWIP_RNG.
+ */
+#ifndef TCP_RANDOM_LOCAL_PORTS
+#define TCP_RANDOM_LOCAL_PORTS          0
+#endif
+
 /**
  * LWIP_EVENT_API and LWIP_CALLBACK_API: Only one of these should be set to 1.
  *     LWIP_EVENT_API==1: The user defines lwip_tcp_event() to receive all
@@ -1150,6 +1311,15 @@
 #define LWIP_NETIF_HWADDRHINT           0
 #endif
 
+/**
+ * LWIP_NETIF_OUTPUT_BATCH==1: Support the netif->output_batch callback that
+ * gets several packets to the same destination (e.g. the fragments of a
+ * datagram) in one call.
+ */
+#ifndef LWIP_NETIF_OUTPUT_BATCH
+#define LWIP_NETIF_OUTPUT_BATCH         0
+#endif
+
 /**
  * LWIP_NETIF_LOOPBACK==1: Support sending packets with a destination IP
  * address equal to the netif IP address, looping them back up the stack.
@@ -1259,6 +1429,16 @@
 #define TCPIP_MBOX_SIZE                 0
 #endif
 
+/**
+ * TCPIP_MBOX_BATCH: Maximum number of messages tcpip_thread processes per
+ * wakeup. After the first message, further pending messages are fetched
+ * without blocking (and without checking timers) until the mailbox is empty
+ * or this limit is reached. 1 processes exactly one message per wakeup.
+ */
+#ifndef TCPIP_MBOX_BATCH
+#define TCPIP_MBOX_BATCH                1
+#endif
+
 /**
  * SLIPIF_THREAD_NAME: The name assigned to the slipif_loop thread.
  */
@@ -1370,27 +1550,60 @@
 #define DEFAULT_ACCEPTMBOX_SIZE         0
 #endif
 
+/**
+ * LWIP_TCPIP_INPUT_BATCH==1: Enable tcpip_input_batch() to pass several
+ * received packets to tcpip_thread with one message.
+ */
+#ifndef LWIP_TCPIP_INPUT_BATCH
+#define LWIP_TCPIP_INPUT_BATCH          0
+#endif
+
+/**
+ * TCPIP_INPUT_BATCH_SIZE: Maximum number of packets per tcpip_input_batch()
+ */
+#ifndef TCPIP_INPUT_BATCH_SIZE
+#define TCPIP_INPUT_BATCH_SIZE          8
+#endif
+
 /*
    ----------------------------------------------
    ---------- Sequential layer options ----------
    ----------------------------------------------
 */
 /**
- * LWIP_TCPIP_CORE_LOCKING: (EXPERIMENTAL!)
- * Don't use it if you're not an active lwIP project member
+ * LWIP_TCPIP_CORE_LOCKING==1: netconn and socket calls take the core mutex
+ * and run in the calling thread instead of posting a message to
+ * tcpip_thread and waiting for it. The port must supply a priority-
+ * inheriting mutex for this (see LWIP_TCPIP_CORE_MUTEX_NEW).
+ * Not available with LWIP_NETCONN_ASYNC.
  */
 #ifndef LWIP_TCPIP_CORE_LOCKING
 #define LWIP_TCPIP_CORE_LOCKING         0
 #endif
 
 /**
- * LWIP_TCPIP_CORE_LOCKING_INPUT: (EXPERIMENTAL!)
- * Don't use it if you're not an active lwIP project member
+ * LWIP_TCPIP_CORE_LOCKING_INPUT==1: tcpip_input() and tcpip_input_batch()
+ * process received packets under the core mutex in the calling thread
+ * instead of passing them to tcpip_thread, so they must not be called from
+ * an interrupt. Needs LWIP_TCPIP_CORE_LOCKING.
  */
 #ifndef LWIP_TCPIP_CORE_LOCKING_INPUT
 #define LWIP_TCPIP_CORE_LOCKING_INPUT   0
 #endif
 
+/**
+ * LWIP_TCPIP_CORE_MUTEX_NEW(m): create the mutex that serializes access to
+ * the core with LWIP_TCPIP_CORE_LOCKING. Threads of all priorities block on
+ * it, so it must be priority-inheriting (see sys_arch.txt). The port must
+ * supply it: lwIP has no such mutex of its own, and the default is only
+ * right if the port's sys_mutex_new() creates one. The board port in this
+ * tree runs with NO_SYS==1 and has no sys_arch at all; the unit tests use
+ * test_sys_mutex_new_pi() from their emulated sys_arch.
+ */
+#ifndef LWIP_TCPIP_CORE_MUTEX_NEW
+#define LWIP_TCPIP_CORE_MUTEX_NEW(m)    sys_mutex_new(m)
+#endif
+
 /**
  * LWIP_NETCONN==1: Enable Netconn API (require to use api_lib.c)
  */
@@ -1398,6 +1611,31 @@
 #define LWIP_NETCONN                    1
 #endif
 
+/**
+ * LWIP_NETCONN_BATCH==1: Enable struct netconn_batch to submit operations on
+ * several netconns to tcpip_thread with one message before waiting for them.
+ */
+#ifndef LWIP_NETCONN_BATCH
+#define LWIP_NETCONN_BATCH              0
+#endif
+
+/**
+ * NETCONN_BATCH_MAX: Maximum number of operations in a struct netconn_batch
+ */
+#ifndef NETCONN_BATCH_MAX
+#define NETCONN_BATCH_MAX               4
+#endif
+
+/**
+ * LWIP_NETCONN_ASYNC==1: Enable netconn_*_async() functions that return
+ * immediately and report completion through a callback (called from
+ * tcpip_thread) and/or a pollable struct netconn_async.
+ * Not available with LWIP_TCPIP_CORE_LOCKING.
+ */
+#ifndef LWIP_NETCONN_ASYNC
+#define LWIP_NETCONN_ASYNC              0
+#endif
+
 /** LWIP_TCPIP_TIMEOUT==1: Enable tcpip_timeout/tcpip_untimeout tod create
  * timers running in tcpip_thread from another thread.
  */
@@ -1473,6 +1711,51 @@
 #define RECV_BUFSIZE_DEFAULT            INT_MAX
 #endif
 
+/**
+ * LWIP_SOCKET_ZEROCOPY==1: Enable lwip_send_zc(), lwip_recv_zc() and
+ * lwip_recv_zc_release(). TCP data passed to lwip_send_zc() is referenced
+ * (not copied) until the remote side has ACKed it, and received pbufs are
+ * lent to the application instead of being copied out.
+ */
+#ifndef LWIP_SOCKET_ZEROCOPY
+#define LWIP_SOCKET_ZEROCOPY            0
+#endif
+
+/**
+ * LWIP_SOCKET_ZEROCOPY_PENDING: Number of zero-copy sends per TCP socket that
+ * may wait for their ACK at the same time. Each one costs ~20 bytes of RAM in
+ * every socket.
+ */
+#ifndef LWIP_SOCKET_ZEROCOPY_PENDING
+#define LWIP_SOCKET_ZEROCOPY_PENDING    4
+#endif
+
+/**
+ * LWIP_SOCKET_POLL==1: Enable lwip_poll(). Unlike lwip_select(), it only
+ * looks at the sockets passed in instead of every index up to maxfdp1.
+ */
+#ifndef LWIP_SOCKET_POLL
+#define LWIP_SOCKET_POLL                0
+#endif
+
+/**
+ * LWIP_SOCKET_EPOLL==1: Enable the epoll-like interface lwip_epoll_create(),
+ * lwip_epoll_ctl(), lwip_epoll_wait() and lwip_epoll_close(). Sockets keep a
+ * list of the epoll instances interested in them and events are put on a
+ * ready queue, so waking up a waiter only costs O(ready sockets).
+ */
+#ifndef LWIP_SOCKET_EPOLL
+#define LWIP_SOCKET_EPOLL               0
+#endif
+
+/**
+ * LWIP_SOCKET_EPOLL_NUM: Number of epoll instances that can exist at the same
+ * time. Each one reserves one registration slot per socket.
+ */
+#ifndef LWIP_SOCKET_EPOLL_NUM
+#define LWIP_SOCKET_EPOLL_NUM           1
+#endif
+
 /**
  * SO_REUSE==1: Enable SO_REUSEADDR option.
  */
@@ -1569,6 +1852,13 @@
 #define TCP_STATS                       (LWIP_TCP)
 #endif
 
+/**
+ * DNS_STATS==1: Enable DNS cache stats (hits, misses, round trip times).
+ */
+#ifndef DNS_STATS
+#define DNS_STATS                       (LWIP_DNS)
+#endif
+
 /**
  * MEM_STATS==1: Enable mem.c stats.
  */
@@ -1590,6 +1880,84 @@
 #define SYS_STATS                       (NO_SYS == 0)
 #endif
 
+/**
+ * LOCK_STATS==1: Enable hold time and contention histograms of the core lock
+ * (LWIP_TCPIP_CORE_LOCKING only).
+ */
+#ifndef LOCK_STATS
+#define LOCK_STATS                      0
+#endif
+
+/**
+ * LOCK_STATS_HIST_SIZE: Number of buckets of the LOCK_STATS histograms.
+ * Bucket 0 counts times of 0 ticks, bucket n times of [2^(n-1), 2^n) ticks
+ * and the last bucket everything longer.
+ */
+#ifndef LOCK_STATS_HIST_SIZE
+#define LOCK_STATS_HIST_SIZE            12
+#endif
+
+/**
+ * LOCK_STATS_NOW(): Timestamp used by LOCK_STATS, returning u32_t ticks.
+ * sys_now() is too coarse to see most lock hold times, so better map this
+ * to a free running cycle counter (e.g. DWT->CYCCNT on Cortex-M).
+ */
+#ifndef LOCK_STATS_NOW
+#define LOCK_STATS_NOW()                sys_now()
+#endif
+
+/**
+ * LWIP_STATS_SNAPSHOT==1: Compile in stats_snapshot() and the rate sampler
+ * (stats_sample()), which never see a half updated set of statistics, even
+ * when the ethernet RX interrupt updates them while the main loop is copying.
+ * The memory, sys and lock statistics are updated inside a sequence lock,
+ * the packet counters per context (see LWIP_STATS_SHARDS). Readers must run
+ * in main loop context.
+ */
+#ifndef LWIP_STATS_SNAPSHOT
+#define LWIP_STATS_SNAPSHOT             0
+#endif
+
+/**
+ * LWIP_STATS_SNAPSHOT_TRIES: Number of copies stats_snapshot() attempts
+ * before giving up with ERR_WOULDBLOCK (e.g. when called from an interrupt
+ * that preempted a counter update).
+ */
+#ifndef LWIP_STATS_SNAPSHOT_TRIES
+#define LWIP_STATS_SNAPSHOT_TRIES       4
+#endif
+
+/**
+ * LWIP_STATS_SHARDS: Number of copies of the packet counters (the protocol
+ * and link counters) with LWIP_STATS_SNAPSHOT. Every context that bumps them
+ * and can preempt another one (the main loop, the ethernet interrupt, ...)
+ * gets its own, so no count is lost even without a lock. Shard 0 is
+ * lwip_stats, every other one costs a struct stats_. stats_snapshot() and
+ * stats_sample() add them up, lwip_stats alone has the main loop's counts.
+ */
+#ifndef LWIP_STATS_SHARDS
+#define LWIP_STATS_SHARDS               1
+#endif
+
+/**
+ * LWIP_STATS_SHARD(): Shard (0..LWIP_STATS_SHARDS-1) of the calling context,
+ * e.g. ((__get_IPSR() != 0) ? 1 : 0) on Cortex-M. It is evaluated on every
+ * packet counter update, so keep it cheap. What it uses can be declared in
+ * sys_arch.h.
+ */
+#ifndef LWIP_STATS_SHARD
+#define LWIP_STATS_SHARD()              0
+#endif
+
+/**
+ * LWIP_STATS_EXPORT==1: Compile in stats_export(), sending a snapshot of
+ * lwip_stats in a compact binary format over UDP (requires
+ * LWIP_STATS_SNAPSHOT and LWIP_UDP).
+ */
+#ifndef LWIP_STATS_EXPORT
+#define LWIP_STATS_EXPORT               0
+#endif
+
 #else
 
 #define LINK_STATS                      0
@@ -1599,10 +1967,14 @@
 #define IGMP_STATS                      0
 #define UDP_STATS                       0
 #define TCP_STATS                       0
+#define DNS_STATS                       0
 #define MEM_STATS                       0
 #define MEMP_STATS                      0
 #define SYS_STATS                       0
+#define LOCK_STATS                      0
 #define LWIP_STATS_DISPLAY              0
+#define LWIP_STATS_SNAPSHOT             0
+#define LWIP_STATS_EXPORT               0
 
 #endif /* LWIP_STATS */
 
@@ -1641,6 +2013,28 @@
 #define NUM_PPP                         1
 #endif
 
+/**
+ * PPPOS_RX_BULK==1: Decode received PPPoS data a run at a time: octets
+ * needing no unescaping are found a word at a time, block copied into the
+ * packet and added to the FCS four at a time. Costs 1.5k of ROM for the
+ * additional FCS tables. 0 decodes octet by octet.
+ */
+#ifndef PPPOS_RX_BULK
+#define PPPOS_RX_BULK                   1
+#endif
+
+/**
+ * PPPOS_TX_RING_SIZE: Size of a per-session ring that outgoing PPPoS frames
+ * are escaped into in one pass over the packet, then handed to the serial
+ * layer with a single sio_writev() call (the port must implement it).
+ * Must hold a frame escaped worst-case, 2 * (PPP_MAXMTU + 6) + 2 octets;
+ * twice that lets the port send one frame by DMA while the next is built.
+ * 0 builds frames into pbufs octet by octet and sends them with sio_write().
+ */
+#ifndef PPPOS_TX_RING_SIZE
+#define PPPOS_TX_RING_SIZE              0
+#endif
+
 /**
  * PAP_SUPPORT==1: Support PAP.
  */
@@ -1683,6 +2077,15 @@
 #define VJ_SUPPORT                      0
 #endif
 
+/**
+ * VJ_MAX_SLOTS: Number of TCP connection states VJ header compression keeps
+ * per direction (3..256). Each costs about 140 bytes in each direction;
+ * flows beyond this count are sent with uncompressed headers.
+ */
+#ifndef VJ_MAX_SLOTS
+#define VJ_MAX_SLOTS                    16
+#endif
+
 /**
  * MD5_SUPPORT==1: Support MD5 (see also CHAP).
  */
@@ -1832,6 +2235,55 @@
 #define LWIP_CHECKSUM_ON_COPY           0
 #endif
 
+/**
+ * LWIP_CRC32==1: Provide crc32() and crc32_pbuf() (the CRC-32 of zlib)
+ * for integrity checks on data carried over the stack.
+ */
+#ifndef LWIP_CRC32
+#define LWIP_CRC32                      0
+#endif
+
+/**
+ * LWIP_CRC32_SLICE8==1: Compute the software CRC-32 eight bytes at a time
+ * with 8 KB of tables instead of byte by byte with 1 KB.
+ */
+#ifndef LWIP_CRC32_SLICE8
+#define LWIP_CRC32_SLICE8               1
+#endif
+
+/**
+ * LWIP_RNG==1: Provide the entropy pool rng_u32()/rng_bytes(), refilled
+ * from a source set with rng_set_source() (e.g. a hardware RNG). Without
+ * a source, or when it fails, a deterministic generator is used. Defining
+ * LWIP_RAND() to rng_u32() makes the rest of the stack use the pool too.
+ */
+#ifndef LWIP_RNG
+#define LWIP_RNG                        0
+#endif
+
+/**
+ * RNG_POOL_SIZE: Number of random words kept ready in the pool.
+ */
+#ifndef RNG_POOL_SIZE
+#define RNG_POOL_SIZE                   16
+#endif
+
+/**
+ * LWIP_BPF==1: Enable packet filter programs (a subset of classic BPF):
+ * raw_filter() on raw pcbs and capture rings on netifs (see
+ * netif_set_capture()).
+ */
+#ifndef LWIP_BPF
+#define LWIP_BPF                        0
+#endif
+
+/**
+ * BPF_MAXINSNS: Maximum number of instructions in a filter program.
+ */
+#ifndef BPF_MAXINSNS
+#define BPF_MAXINSNS                    256
+#endif
+
 /*
    ---------------------------------------
    ---------- Hook options ---------------
@@ -40,6 +40,7 @@
 #include "lwip/def.h"
 #include "lwip/ip.h"
 #include "lwip/ip_addr.h"
+#include "lwip/bpf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -72,6 +73,10 @@ struct raw_pcb {
   raw_recv_fn recv;
   /* user-supplied argument for the recv callback */
   void *recv_arg;
+#if LWIP_BPF
+  /** only packets this program accepts are passed to recv */
+  const struct bpf_program *filter;
+#endif /* LWIP_BPF */
 };
 
 /* The following functions is the application layer interface to the
@@ -84,6 +89,9 @@ err_t            raw_connect    (struct raw_pcb *pcb, ip_addr_t *ipaddr);
 void             raw_recv       (struct raw_pcb *pcb, raw_recv_fn recv, void *recv_arg);
 err_t            raw_sendto     (struct raw_pcb *pcb, struct pbuf *p, ip_addr_t *ipaddr);
 err_t            raw_send       (struct raw_pcb *pcb, struct pbuf *p);
+#if LWIP_BPF
+err_t            raw_filter     (struct raw_pcb *pcb, const struct bpf_program *prog);
+#endif /* LWIP_BPF */
 
 /* The following functions are the lower layer interface to RAW. */
 u8_t             raw_input      (struct pbuf *p, struct netif *inp);
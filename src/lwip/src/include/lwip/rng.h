@@ -0,0 +1,82 @@
+/**
+ * @file
+ * Entropy pool and keyed hash for the stack (TCP ISNs, ephemeral ports)
+ *
+ */
+
+/*
+ * Copyright (c) 2001-2004 Swedish Institute of Computer Science.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT 
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING 
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#ifndef __LWIP_RNG_H__
+#define __LWIP_RNG_H__
+
+#include "lwip/opt.h"
+
+#if LWIP_RNG /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** An entropy source (e.g. a hardware RNG): stores one random word in
+ * '*word' and returns ERR_OK, or returns another err_t if no word can be
+ * delivered right now (the pool then stops refilling). */
+typedef err_t (*rng_source_fn)(u32_t *word);
+
+/** Counters of the entropy pool */
+struct rng_stats {
+  u32_t refills;    /* words taken from the source */
+  u32_t errors;     /* source failures */
+  u32_t fallback;   /* words delivered by the deterministic generator */
+};
+
+extern struct rng_stats rng_stats;
+
+/* Select the entropy source, NULL for the deterministic generator only */
+void  rng_set_source(rng_source_fn source);
+/* Top the pool up from the source, returns the number of pooled words */
+u16_t rng_refill(void);
+/* Reseed the deterministic generator and drop pooled words (host tests) */
+void  rng_seed(u32_t seed);
+
+u32_t rng_u32(void);
+void  rng_bytes(void *buf, u16_t len);
+
+/* HalfSipHash-2-4 of 'len' bytes under the 64 bit key 'key' */
+u32_t rng_hash(const u32_t key[2], const void *data, u16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_RNG */
+
+#endif /* __LWIP_RNG_H__ */
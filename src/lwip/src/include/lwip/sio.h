@@ -125,6 +125,30 @@ u32_t sio_tryread(sio_fd_t fd, u8_t *data, u32_t len);
 u32_t sio_write(sio_fd_t fd, u8_t *data, u32_t len);
 #endif
 
+/** One segment of a vectored write (see sio_writev()). */
+struct sio_iovec {
+  u8_t *data;
+  u32_t len;
+};
+
+#ifndef sio_writev
+/**
+ * Writes several buffers to the serial device as one transfer. Used by
+ * PPPoS to send a frame straight out of its transmit ring (the frame is
+ * split in two segments where the ring wraps).
+ * 
+ * @param fd serial device handle
+ * @param iov segments to send, in order
+ * @param cnt number of segments
+ * @return number of bytes actually sent
+ * 
+ * @note The segments may be sent by DMA after this function returns, but
+ * the transfer must be complete by the time the next sio_writev() call on
+ * the same device returns.
+ */
+u32_t sio_writev(sio_fd_t fd, const struct sio_iovec *iov, u8_t cnt);
+#endif
+
 #ifndef sio_read_abort
 /**
  * Aborts a blocking sio_read() call.
@@ -73,6 +73,22 @@ extern "C" {
 #define SNMP_ASN1_PDU_GET_RESP 2
 #define SNMP_ASN1_PDU_SET_REQ 3
 #define SNMP_ASN1_PDU_TRAP 4
+#define SNMP_ASN1_PDU_GET_BULK_REQ 5
+
+/* context specific (SNMPv2) varbind exceptions, NULL contents */
+#define SNMP_ASN1_NO_SUCH_OBJECT 0
+#define SNMP_ASN1_NO_SUCH_INSTANCE 1
+#define SNMP_ASN1_END_OF_MIB_VIEW 2
+
+/** Write position in a pbuf chained ASN1 msg, advanced by the
+    snmp_asn1_stream_enc_*() functions (no search from the chain head) */
+struct snmp_asn1_stream
+{
+  /* pbuf the next octet goes to, NULL past the end of the chain */
+  struct pbuf *p;
+  /* offset of the next octet in p->payload */
+  u16_t ofs;
+};
 
 err_t snmp_asn1_dec_type(struct pbuf *p, u16_t ofs, u8_t *type);
 err_t snmp_asn1_dec_length(struct pbuf *p, u16_t ofs, u8_t *octets_used, u16_t *length);
@@ -92,6 +108,14 @@ err_t snmp_asn1_enc_s32t(struct pbuf *p, u16_t ofs, u16_t octets_needed, s32_t v
 err_t snmp_asn1_enc_oid(struct pbuf *p, u16_t ofs, u8_t ident_len, s32_t *ident);
 err_t snmp_asn1_enc_raw(struct pbuf *p, u16_t ofs, u16_t raw_len, u8_t *raw);
 
+err_t snmp_asn1_stream_init(struct snmp_asn1_stream *st, struct pbuf *p, u16_t ofs);
+err_t snmp_asn1_stream_enc_type(struct snmp_asn1_stream *st, u8_t type);
+err_t snmp_asn1_stream_enc_length(struct snmp_asn1_stream *st, u16_t length);
+err_t snmp_asn1_stream_enc_u32t(struct snmp_asn1_stream *st, u16_t octets_needed, u32_t value);
+err_t snmp_asn1_stream_enc_s32t(struct snmp_asn1_stream *st, u16_t octets_needed, s32_t value);
+err_t snmp_asn1_stream_enc_oid(struct snmp_asn1_stream *st, u8_t ident_len, s32_t *ident);
+err_t snmp_asn1_stream_enc_raw(struct snmp_asn1_stream *st, u16_t raw_len, u8_t *raw);
+
 #ifdef __cplusplus
 }
 #endif
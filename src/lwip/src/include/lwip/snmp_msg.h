@@ -217,6 +217,10 @@ struct snmp_trap_header_lengths
 #define SNMP_MSG_EXTERNAL_GET_OBJDEF_S 10
 #define SNMP_MSG_EXTERNAL_SET_VALUE    11
 
+/* SNMP message version field */
+#define SNMP_VERSION_1   0
+#define SNMP_VERSION_2c  1
+
 #define SNMP_COMMUNITY_STR_LEN 64
 struct snmp_msg_pstat
 {
@@ -228,6 +232,8 @@ struct snmp_msg_pstat
   u16_t sp;
   /* request type */
   u8_t rt;
+  /* message version (SNMP_VERSION_1 or SNMP_VERSION_2c) */
+  s32_t version;
   /* request ID */
   s32_t rid;
   /* error status */
@@ -245,6 +251,16 @@ struct snmp_msg_pstat
   struct snmp_name_ptr ext_name_ptr;
   struct obj_def ext_object_def;
   struct snmp_obj_id ext_oid;
+#if SNMP_V2C
+  /* GetBulk non-repeaters */
+  u8_t non_repeaters;
+  /* GetBulk repeaters (varbinds after the non-repeaters) */
+  u8_t repeaters;
+  /* number of trailing endOfMibView repeater results */
+  u8_t eom_cnt;
+#endif /* SNMP_V2C */
+  /* number of variable bindings to output */
+  u8_t vb_count;
   /* index into input variable binding list */
   u8_t vb_idx;
   /* ptr into input variable binding list */
@@ -303,6 +303,47 @@ typedef struct ip_mreq {
 
 #endif /* FD_SET */
 
+#if LWIP_SOCKET_POLL
+/* Events for lwip_poll */
+#ifndef POLLIN
+#define POLLIN     0x1
+#define POLLOUT    0x2
+#define POLLERR    0x4
+#define POLLNVAL   0x8
+
+typedef unsigned int nfds_t;
+struct pollfd {
+  int fd;
+  short events;
+  short revents;
+};
+#endif /* POLLIN */
+#endif /* LWIP_SOCKET_POLL */
+
+#if LWIP_SOCKET_EPOLL
+/* Events and operations for lwip_epoll_ctl/lwip_epoll_wait */
+#define LWIP_EPOLLIN        0x001
+#define LWIP_EPOLLOUT       0x004
+#define LWIP_EPOLLERR       0x008
+/** Report an event once when it happens instead of while it persists */
+#define LWIP_EPOLLET        0x80000000UL
+
+#define LWIP_EPOLL_CTL_ADD  1
+#define LWIP_EPOLL_CTL_DEL  2
+#define LWIP_EPOLL_CTL_MOD  3
+
+typedef union lwip_epoll_data {
+  void  *ptr;
+  int    fd;
+  u32_t  u32;
+} lwip_epoll_data_t;
+
+struct lwip_epoll_event {
+  u32_t events;
+  lwip_epoll_data_t data;
+};
+#endif /* LWIP_SOCKET_EPOLL */
+
 /** LWIP_TIMEVAL_PRIVATE: if you want to use the struct timeval provided
  * by your system, set this to 0 and include <sys/time.h> in cc.h */ 
 #ifndef LWIP_TIMEVAL_PRIVATE
@@ -342,6 +383,29 @@ int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptse
 int lwip_ioctl(int s, long cmd, void *argp);
 int lwip_fcntl(int s, int cmd, int val);
 
+#if LWIP_SOCKET_POLL
+int lwip_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+#endif /* LWIP_SOCKET_POLL */
+#if LWIP_SOCKET_EPOLL
+int lwip_epoll_create(void);
+int lwip_epoll_ctl(int epfd, int op, int s, struct lwip_epoll_event *event);
+int lwip_epoll_wait(int epfd, struct lwip_epoll_event *events, int maxevents, int timeout);
+int lwip_epoll_close(int epfd);
+#endif /* LWIP_SOCKET_EPOLL */
+
+#if LWIP_SOCKET_ZEROCOPY
+struct pbuf;
+/** Completion callback for lwip_send_zc(): 'dataptr' and 'size' describe the
+ * region that may be reused by the application again, 'err' is 0 or the
+ * errno that aborted the transfer. Called from tcpip_thread for TCP. */
+typedef void (*lwip_zc_sent_fn)(int s, const void *dataptr, size_t size, int err, void *arg);
+
+int lwip_send_zc(int s, const void *dataptr, size_t size, int flags,
+                 lwip_zc_sent_fn sent_fn, void *arg);
+int lwip_recv_zc(int s, struct pbuf **p, int flags);
+int lwip_recv_zc_release(int s, struct pbuf *p);
+#endif /* LWIP_SOCKET_ZEROCOPY */
+
 #if LWIP_COMPAT_SOCKETS
 #define accept(a,b,c)         lwip_accept(a,b,c)
 #define bind(a,b,c)           lwip_bind(a,b,c)
@@ -360,6 +424,9 @@ int lwip_fcntl(int s, int cmd, int val);
 #define socket(a,b,c)         lwip_socket(a,b,c)
 #define select(a,b,c,d,e)     lwip_select(a,b,c,d,e)
 #define ioctlsocket(a,b,c)    lwip_ioctl(a,b,c)
+#if LWIP_SOCKET_POLL
+#define poll(a,b,c)           lwip_poll(a,b,c)
+#endif /* LWIP_SOCKET_POLL */
 
 #if LWIP_POSIX_SOCKETS_IO_NAMES
 #define read(a,b,c)           lwip_read(a,b,c)
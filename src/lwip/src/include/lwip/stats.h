@@ -36,6 +36,11 @@
 
 #include "lwip/mem.h"
 #include "lwip/memp.h"
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+#if LWIP_STATS && (LWIP_STATS_SHARDS > 1)
+#include "lwip/sys.h" /* for what LWIP_STATS_SHARD() uses */
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +75,11 @@ struct stats_proto {
   STAT_COUNTER cachehit;
 };
 
+struct stats_octets {
+  u32_t recv;                    /* Received bytes. */
+  u32_t xmit;                    /* Transmitted bytes. */
+};
+
 struct stats_igmp {
   STAT_COUNTER xmit;             /* Transmitted packets. */
   STAT_COUNTER recv;             /* Received packets. */
@@ -110,9 +120,33 @@ struct stats_sys {
   struct stats_syselem mbox;
 };
 
+struct stats_dns {
+  STAT_COUNTER hit;              /* Lookups answered from the cache. */
+  STAT_COUNTER neghit;           /* Lookups answered from the negative cache. */
+  STAT_COUNTER miss;             /* Lookups that sent a new query. */
+  STAT_COUNTER coalesced;        /* Lookups that joined a pending query. */
+  STAT_COUNTER prefetch;         /* Entries refreshed before expiry. */
+  STAT_COUNTER expired;          /* Entries flushed when their TTL expired. */
+  STAT_COUNTER timeout;          /* Queries no server answered. */
+  STAT_COUNTER nxdomain;         /* Queries answered with "no such name". */
+  STAT_COUNTER answers;          /* Queries answered with an address. */
+  u32_t rtt_sum;                 /* Sum of answer round trip times (ms). */
+  u32_t rtt_max;                 /* Longest answer round trip time (ms). */
+};
+
+struct stats_lock {
+  STAT_COUNTER acquired;         /* Times the lock was taken. */
+  STAT_COUNTER contended;        /* Times the lock was held by someone else. */
+  u32_t hold_max;                /* Longest hold time (LOCK_STATS_NOW ticks). */
+  u32_t wait_max;                /* Longest wait time (LOCK_STATS_NOW ticks). */
+  STAT_COUNTER hold[LOCK_STATS_HIST_SIZE]; /* Hold time histogram. */
+  STAT_COUNTER wait[LOCK_STATS_HIST_SIZE]; /* Wait time histogram (contended only). */
+};
+
 struct stats_ {
 #if LINK_STATS
   struct stats_proto link;
+  struct stats_octets link_octets;
 #endif
 #if ETHARP_STATS
   struct stats_proto etharp;
@@ -135,6 +169,9 @@ struct stats_ {
 #if TCP_STATS
   struct stats_proto tcp;
 #endif
+#if DNS_STATS
+  struct stats_dns dns;
+#endif
 #if MEM_STATS
   struct stats_mem mem;
 #endif
@@ -144,19 +181,130 @@ struct stats_ {
 #if SYS_STATS
   struct stats_sys sys;
 #endif
+#if LOCK_STATS
+  struct stats_lock core_lock;
+#endif
 };
 
 extern struct stats_ lwip_stats;
 
 void stats_init(void);
 
+#if LWIP_STATS_SNAPSHOT
+/** Bumped before and after every sequenced update of lwip_stats: odd while
+ * an update is in progress, changed if a copy of lwip_stats raced with an
+ * update. */
+extern volatile u32_t lwip_stats_seq;
+
+/** Run an update of lwip_stats inside the sequence lock. Writers only nest
+ * (an interrupt preempting the main loop) and never run in parallel, so one
+ * load of lwip_stats_seq and two stores are enough: a nested update is over
+ * before the outer one stores its closing value.
+ * The lock only keeps snapshots from tearing, it does not make the updates
+ * atomic. That's why it is only used for the memory, sys and lock
+ * statistics, which are updated under SYS_ARCH_PROTECT or the core lock
+ * anyway; the packet counters go to shards (STATS_SHARD_ADD). */
+#define STATS_WRITE(x) do { u32_t stats_seq_ = lwip_stats_seq + 1; \
+                            lwip_stats_seq = stats_seq_; \
+                            x; \
+                            lwip_stats_seq = stats_seq_ + 1; \
+                         } while(0)
+/** Access a counter through a volatile lvalue, so the compiler keeps the
+ * update between the two bumps of lwip_stats_seq. */
+#define STATS_VAR(x) (((volatile struct stats_ *)&lwip_stats)->x)
+
+#define STATS_INC(x) STATS_WRITE(++STATS_VAR(x))
+#define STATS_DEC(x) STATS_WRITE(--STATS_VAR(x))
+
+#if LWIP_STATS_SHARDS > 1
+/** The packet counters of the contexts other than the main loop: shard 0 is
+ * lwip_stats itself, see LWIP_STATS_SHARD(). */
+extern struct stats_ lwip_stats_shards[LWIP_STATS_SHARDS - 1];
+
+/** Add to a packet counter in the shard of the calling context. A shard has
+ * a single writer, which nothing can interrupt with an update of the same
+ * shard: no count is lost and no lock is needed. */
+#define STATS_SHARD_ADD(x, n) do { u8_t stats_shard_ = (u8_t)(LWIP_STATS_SHARD()); \
+                                 if (stats_shard_ == 0) { \
+                                   lwip_stats.x += (n); \
+                                 } else { \
+                                   lwip_stats_shards[stats_shard_ - 1].x += (n); \
+                                 } \
+                              } while(0)
+#else /* LWIP_STATS_SHARDS > 1 */
+#define STATS_SHARD_ADD(x, n) do { lwip_stats.x += (n); } while(0)
+#endif /* LWIP_STATS_SHARDS > 1 */
+#define STATS_SHARD_INC(x) STATS_SHARD_ADD(x, 1)
+
+/** Maximum number of drop counters summed up by stats_sample(). */
+#define STATS_SAMPLER_DROPS 8
+
+/** Rates derived from two samples of lwip_stats, all per second. */
+struct stats_rate {
+  u32_t pps_recv;                /* Received link packets. */
+  u32_t pps_xmit;                /* Transmitted link packets. */
+  u32_t bps_recv;                /* Received link bits. */
+  u32_t bps_xmit;                /* Transmitted link bits. */
+  u32_t drops;                   /* Packets dropped by any layer. */
+};
+
+/** State of the rate sampler, see stats_sample(). */
+struct stats_sampler {
+  u32_t time;                    /* Time of the previous sample (ms). */
+  u8_t valid;                    /* The previous sample is set. */
+  STAT_COUNTER recv;
+  STAT_COUNTER xmit;
+  u32_t octets_recv;
+  u32_t octets_xmit;
+  STAT_COUNTER drop[STATS_SAMPLER_DROPS];
+  struct stats_rate rate;        /* Rates over the last interval. */
+};
+
+err_t stats_snapshot(struct stats_ *snap);
+err_t stats_sample(struct stats_sampler *sampler, u32_t now);
+#else /* LWIP_STATS_SNAPSHOT */
+#define STATS_WRITE(x) do { x; } while(0)
+#define STATS_VAR(x) lwip_stats.x
+
 #define STATS_INC(x) ++lwip_stats.x
 #define STATS_DEC(x) --lwip_stats.x
-#define STATS_INC_USED(x, y) do { lwip_stats.x.used += y; \
-                                if (lwip_stats.x.max < lwip_stats.x.used) { \
-                                    lwip_stats.x.max = lwip_stats.x.used; \
-                                } \
-                             } while(0)
+
+#define STATS_SHARD_ADD(x, n) lwip_stats.x += (n)
+#define STATS_SHARD_INC(x) ++lwip_stats.x
+#endif /* LWIP_STATS_SNAPSHOT */
+
+#define STATS_INC_USED(x, y) STATS_WRITE(STATS_VAR(x.used) += y; \
+                                if (STATS_VAR(x.max) < STATS_VAR(x.used)) { \
+                                    STATS_VAR(x.max) = STATS_VAR(x.used); \
+                                })
+
+#if LWIP_STATS_EXPORT
+/** Version of the stats_export() wire format. */
+#define STATS_EXPORT_VERSION 1
+
+/** Section ids of the stats_export() wire format. */
+#define STATS_EXPORT_LINK        1
+#define STATS_EXPORT_LINK_OCTETS 2
+#define STATS_EXPORT_ETHARP      3
+#define STATS_EXPORT_IPFRAG      4
+#define STATS_EXPORT_IP          5
+#define STATS_EXPORT_ICMP        6
+#define STATS_EXPORT_IGMP        7
+#define STATS_EXPORT_UDP         8
+#define STATS_EXPORT_TCP         9
+#define STATS_EXPORT_DNS         10
+#define STATS_EXPORT_MEM         11
+#define STATS_EXPORT_MEMP        12
+#define STATS_EXPORT_SYS         13
+#define STATS_EXPORT_LOCK        14
+
+struct udp_pcb;
+
+u16_t stats_export_encode(const struct stats_ *snap, u16_t seqno, u32_t now,
+                          u8_t *buf, u16_t len);
+err_t stats_export(struct udp_pcb *pcb, ip_addr_t *dst_ip, u16_t dst_port);
+#endif /* LWIP_STATS_EXPORT */
+
 #else /* LWIP_STATS */
 #define stats_init()
 #define STATS_INC(x)
@@ -165,7 +313,7 @@ void stats_init(void);
 #endif /* LWIP_STATS */
 
 #if TCP_STATS
-#define TCP_STATS_INC(x) STATS_INC(x)
+#define TCP_STATS_INC(x) STATS_SHARD_INC(x)
 #define TCP_STATS_DISPLAY() stats_display_proto(&lwip_stats.tcp, "TCP")
 #else
 #define TCP_STATS_INC(x)
@@ -173,7 +321,7 @@ void stats_init(void);
 #endif
 
 #if UDP_STATS
-#define UDP_STATS_INC(x) STATS_INC(x)
+#define UDP_STATS_INC(x) STATS_SHARD_INC(x)
 #define UDP_STATS_DISPLAY() stats_display_proto(&lwip_stats.udp, "UDP")
 #else
 #define UDP_STATS_INC(x)
@@ -181,7 +329,7 @@ void stats_init(void);
 #endif
 
 #if ICMP_STATS
-#define ICMP_STATS_INC(x) STATS_INC(x)
+#define ICMP_STATS_INC(x) STATS_SHARD_INC(x)
 #define ICMP_STATS_DISPLAY() stats_display_proto(&lwip_stats.icmp, "ICMP")
 #else
 #define ICMP_STATS_INC(x)
@@ -189,7 +337,7 @@ void stats_init(void);
 #endif
 
 #if IGMP_STATS
-#define IGMP_STATS_INC(x) STATS_INC(x)
+#define IGMP_STATS_INC(x) STATS_SHARD_INC(x)
 #define IGMP_STATS_DISPLAY() stats_display_igmp(&lwip_stats.igmp)
 #else
 #define IGMP_STATS_INC(x)
@@ -197,7 +345,7 @@ void stats_init(void);
 #endif
 
 #if IP_STATS
-#define IP_STATS_INC(x) STATS_INC(x)
+#define IP_STATS_INC(x) STATS_SHARD_INC(x)
 #define IP_STATS_DISPLAY() stats_display_proto(&lwip_stats.ip, "IP")
 #else
 #define IP_STATS_INC(x)
@@ -205,7 +353,7 @@ void stats_init(void);
 #endif
 
 #if IPFRAG_STATS
-#define IPFRAG_STATS_INC(x) STATS_INC(x)
+#define IPFRAG_STATS_INC(x) STATS_SHARD_INC(x)
 #define IPFRAG_STATS_DISPLAY() stats_display_proto(&lwip_stats.ip_frag, "IP_FRAG")
 #else
 #define IPFRAG_STATS_INC(x)
@@ -213,7 +361,7 @@ void stats_init(void);
 #endif
 
 #if ETHARP_STATS
-#define ETHARP_STATS_INC(x) STATS_INC(x)
+#define ETHARP_STATS_INC(x) STATS_SHARD_INC(x)
 #define ETHARP_STATS_DISPLAY() stats_display_proto(&lwip_stats.etharp, "ETHARP")
 #else
 #define ETHARP_STATS_INC(x)
@@ -221,18 +369,38 @@ void stats_init(void);
 #endif
 
 #if LINK_STATS
-#define LINK_STATS_INC(x) STATS_INC(x)
-#define LINK_STATS_DISPLAY() stats_display_proto(&lwip_stats.link, "LINK")
+#define LINK_STATS_INC(x) STATS_SHARD_INC(x)
+#define LINK_STATS_OCTETS(x, len) STATS_SHARD_ADD(link_octets.x, len)
+#define LINK_STATS_DISPLAY() do { stats_display_proto(&lwip_stats.link, "LINK"); \
+                                stats_display_octets(&lwip_stats.link_octets, "LINK"); \
+                             } while(0)
 #else
 #define LINK_STATS_INC(x)
+#define LINK_STATS_OCTETS(x, len)
 #define LINK_STATS_DISPLAY()
 #endif
 
+#if DNS_STATS
+#define DNS_STATS_INC(x) STATS_SHARD_INC(x)
+#define DNS_STATS_RTT(ms) do { u32_t rtt_ = (ms); \
+                                STATS_WRITE(++STATS_VAR(dns.answers); \
+                                  STATS_VAR(dns.rtt_sum) += rtt_; \
+                                  if (STATS_VAR(dns.rtt_max) < rtt_) { \
+                                      STATS_VAR(dns.rtt_max) = rtt_; \
+                                  }); \
+                             } while(0)
+#define DNS_STATS_DISPLAY() stats_display_dns(&lwip_stats.dns)
+#else
+#define DNS_STATS_INC(x)
+#define DNS_STATS_RTT(ms)
+#define DNS_STATS_DISPLAY()
+#endif
+
 #if MEM_STATS
-#define MEM_STATS_AVAIL(x, y) lwip_stats.mem.x = y
+#define MEM_STATS_AVAIL(x, y) STATS_WRITE(STATS_VAR(mem.x) = y)
 #define MEM_STATS_INC(x) STATS_INC(mem.x)
 #define MEM_STATS_INC_USED(x, y) STATS_INC_USED(mem, y)
-#define MEM_STATS_DEC_USED(x, y) lwip_stats.mem.x -= y
+#define MEM_STATS_DEC_USED(x, y) STATS_WRITE(STATS_VAR(mem.x) -= y)
 #define MEM_STATS_DISPLAY() stats_display_mem(&lwip_stats.mem, "HEAP")
 #else
 #define MEM_STATS_AVAIL(x, y)
@@ -243,7 +411,7 @@ void stats_init(void);
 #endif
 
 #if MEMP_STATS
-#define MEMP_STATS_AVAIL(x, i, y) lwip_stats.memp[i].x = y
+#define MEMP_STATS_AVAIL(x, i, y) STATS_WRITE(STATS_VAR(memp[i].x) = y)
 #define MEMP_STATS_INC(x, i) STATS_INC(memp[i].x)
 #define MEMP_STATS_DEC(x, i) STATS_DEC(memp[i].x)
 #define MEMP_STATS_INC_USED(x, i) STATS_INC_USED(memp[i], 1)
@@ -268,21 +436,42 @@ void stats_init(void);
 #define SYS_STATS_DISPLAY()
 #endif
 
+#if LOCK_STATS
+void stats_lock_hist(STAT_COUNTER *hist, u32_t ticks);
+#define LOCK_STATS_INC(x) STATS_INC(x)
+#define LOCK_STATS_TIME(x, ticks) STATS_WRITE( \
+                                stats_lock_hist(lwip_stats.x, ticks); \
+                                if (STATS_VAR(x##_max) < (ticks)) { \
+                                    STATS_VAR(x##_max) = (ticks); \
+                                })
+#define LOCK_STATS_DISPLAY() stats_display_lock(&lwip_stats.core_lock, "CORE_LOCK")
+#else
+#define LOCK_STATS_INC(x)
+#define LOCK_STATS_TIME(x, ticks)
+#define LOCK_STATS_DISPLAY()
+#endif
+
 /* Display of statistics */
 #if LWIP_STATS_DISPLAY
 void stats_display(void);
 void stats_display_proto(struct stats_proto *proto, const char *name);
+void stats_display_octets(struct stats_octets *octets, const char *name);
 void stats_display_igmp(struct stats_igmp *igmp);
+void stats_display_dns(struct stats_dns *dns);
 void stats_display_mem(struct stats_mem *mem, const char *name);
 void stats_display_memp(struct stats_mem *mem, int index);
 void stats_display_sys(struct stats_sys *sys);
+void stats_display_lock(struct stats_lock *lock, const char *name);
 #else /* LWIP_STATS_DISPLAY */
 #define stats_display()
 #define stats_display_proto(proto, name)
+#define stats_display_octets(octets, name)
 #define stats_display_igmp(igmp)
+#define stats_display_dns(dns)
 #define stats_display_mem(mem, name)
 #define stats_display_memp(mem, index)
 #define stats_display_sys(sys)
+#define stats_display_lock(lock, name)
 #endif /* LWIP_STATS_DISPLAY */
 
 #ifdef __cplusplus
@@ -334,10 +334,22 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
 #define TCP_DEBUG_PCB_LISTS 0
 #endif
 
+#if TCP_RANDOM_LOCAL_PORTS
+/* Keep the bitmap of local ports in use in step with the PCB lists */
+void tcp_port_ref(u16_t port);
+void tcp_port_unref(u16_t port);
+#define TCP_PORT_REF(npcb)    tcp_port_ref((npcb)->local_port)
+#define TCP_PORT_UNREF(npcb)  tcp_port_unref((npcb)->local_port)
+#else /* TCP_RANDOM_LOCAL_PORTS */
+#define TCP_PORT_REF(npcb)
+#define TCP_PORT_UNREF(npcb)
+#endif /* TCP_RANDOM_LOCAL_PORTS */
+
 #define TCP_REG(pcbs, npcb)                        \
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_PORT_REF(npcb);                            \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -345,6 +357,7 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
   do {                                             \
     if(*(pcbs) == (npcb)) {                        \
       (*(pcbs)) = (*pcbs)->next;                   \
+      TCP_PORT_UNREF(npcb);                        \
     }                                              \
     else {                                         \
       for(tcp_tmp_pcb = *pcbs;                     \
@@ -352,6 +365,7 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
           tcp_tmp_pcb = tcp_tmp_pcb->next) {       \
         if(tcp_tmp_pcb->next == (npcb)) {          \
           tcp_tmp_pcb->next = (npcb)->next;        \
+          TCP_PORT_UNREF(npcb);                    \
           break;                                   \
         }                                          \
       }                                            \
@@ -415,7 +429,11 @@ void tcp_rst(u32_t seqno, u32_t ackno,
        ip_addr_t *local_ip, ip_addr_t *remote_ip,
        u16_t local_port, u16_t remote_port);
 
-u32_t tcp_next_iss(void);
+u32_t tcp_next_iss(struct tcp_pcb *pcb);
+#if LWIP_RNG
+u32_t tcp_isn_rfc6528(ip_addr_t *local_ip, u16_t local_port,
+       ip_addr_t *remote_ip, u16_t remote_port);
+#endif /* LWIP_RNG */
 
 void tcp_keepalive(struct tcp_pcb *pcb);
 void tcp_zero_window_probe(struct tcp_pcb *pcb);
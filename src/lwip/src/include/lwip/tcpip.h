@@ -57,8 +57,15 @@ extern "C" {
 #if LWIP_TCPIP_CORE_LOCKING
 /** The global semaphore to lock the stack. */
 extern sys_mutex_t lock_tcpip_core;
+#if LOCK_STATS
+void tcpip_core_lock(void);
+void tcpip_core_unlock(void);
+#define LOCK_TCPIP_CORE()     tcpip_core_lock()
+#define UNLOCK_TCPIP_CORE()   tcpip_core_unlock()
+#else /* LOCK_STATS */
 #define LOCK_TCPIP_CORE()     sys_mutex_lock(&lock_tcpip_core)
 #define UNLOCK_TCPIP_CORE()   sys_mutex_unlock(&lock_tcpip_core)
+#endif /* LOCK_STATS */
 #define TCPIP_APIMSG(m)       tcpip_apimsg_lock(m)
 #define TCPIP_APIMSG_ACK(m)
 #define TCPIP_NETIFAPI(m)     tcpip_netifapi_lock(m)
@@ -67,7 +74,11 @@ extern sys_mutex_t lock_tcpip_core;
 #define LOCK_TCPIP_CORE()
 #define UNLOCK_TCPIP_CORE()
 #define TCPIP_APIMSG(m)       tcpip_apimsg(m)
+#if LWIP_NETCONN_ASYNC
+#define TCPIP_APIMSG_ACK(m)   netconn_op_completed(m)
+#else /* LWIP_NETCONN_ASYNC */
 #define TCPIP_APIMSG_ACK(m)   sys_sem_signal(&m->conn->op_completed)
+#endif /* LWIP_NETCONN_ASYNC */
 #define TCPIP_NETIFAPI(m)     tcpip_netifapi(m)
 #define TCPIP_NETIFAPI_ACK(m) sys_sem_signal(&m->sem)
 #endif /* LWIP_TCPIP_CORE_LOCKING */
@@ -81,15 +92,24 @@ typedef void (*tcpip_callback_fn)(void *ctx);
 struct tcpip_callback_msg;
 
 void tcpip_init(tcpip_init_done_fn tcpip_init_done, void *arg);
+#ifdef TCPIP_THREAD_TEST
+int  tcpip_thread_poll_one(void);
+#endif /* TCPIP_THREAD_TEST */
 
 #if LWIP_NETCONN
 err_t tcpip_apimsg(struct api_msg *apimsg);
 #if LWIP_TCPIP_CORE_LOCKING
 err_t tcpip_apimsg_lock(struct api_msg *apimsg);
 #endif /* LWIP_TCPIP_CORE_LOCKING */
+#if LWIP_NETCONN_BATCH
+err_t tcpip_apimsg_batch(struct api_msg *apimsgs, u8_t num);
+#endif /* LWIP_NETCONN_BATCH */
 #endif /* LWIP_NETCONN */
 
 err_t tcpip_input(struct pbuf *p, struct netif *inp);
+#if LWIP_TCPIP_INPUT_BATCH
+err_t tcpip_input_batch(struct pbuf **p, u8_t num, struct netif *inp);
+#endif /* LWIP_TCPIP_INPUT_BATCH */
 
 #if LWIP_NETIF_API
 err_t tcpip_netifapi(struct netifapi_msg *netifapimsg);
@@ -117,8 +137,14 @@ err_t tcpip_untimeout(sys_timeout_handler h, void *arg);
 enum tcpip_msg_type {
 #if LWIP_NETCONN
   TCPIP_MSG_API,
+#if LWIP_NETCONN_BATCH
+  TCPIP_MSG_API_BATCH,
+#endif /* LWIP_NETCONN_BATCH */
 #endif /* LWIP_NETCONN */
   TCPIP_MSG_INPKT,
+#if LWIP_TCPIP_INPUT_BATCH
+  TCPIP_MSG_INPKT_BATCH,
+#endif /* LWIP_TCPIP_INPUT_BATCH */
 #if LWIP_NETIF_API
   TCPIP_MSG_NETIFAPI,
 #endif /* LWIP_NETIF_API */
@@ -136,6 +162,12 @@ struct tcpip_msg {
   union {
 #if LWIP_NETCONN
     struct api_msg *apimsg;
+#if LWIP_NETCONN_BATCH
+    struct {
+      struct api_msg *apimsgs;
+      u8_t num;
+    } apibatch;
+#endif /* LWIP_NETCONN_BATCH */
 #endif /* LWIP_NETCONN */
 #if LWIP_NETIF_API
     struct netifapi_msg *netifapimsg;
@@ -158,6 +190,19 @@ struct tcpip_msg {
   } msg;
 };
 
+#if LWIP_TCPIP_INPUT_BATCH
+/** Message used by tcpip_input_batch(): several packets received on the
+ * same netif, processed by tcpip_thread in one go */
+struct tcpip_inpkt_batch {
+  /** must be the first member: tcpip_thread only sees this */
+  struct tcpip_msg msg;
+  /** number of valid entries in p */
+  u8_t num;
+  /** the packets, in the order they were received */
+  struct pbuf *p[TCPIP_INPUT_BATCH_SIZE];
+};
+#endif /* LWIP_TCPIP_INPUT_BATCH */
+
 #ifdef __cplusplus
 }
 #endif
@@ -61,6 +61,15 @@
 #define SLIP_RX_QUEUE SLIP_RX_FROM_ISR
 #endif
 
+/** Set this to the size of a per-netif buffer slipif_output() escapes packets
+ * into, to send them with sio_write() instead of sio_send() per byte. The
+ * buffer is sent whenever it fills: 2 * SLIP_MAX_SIZE + 2 sends any packet
+ * with one sio_write(). If 0, only sio_send() is needed.
+ */
+#ifndef SLIP_TX_BUFSIZE
+#define SLIP_TX_BUFSIZE 0
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -70,7 +79,7 @@ void slipif_poll(struct netif *netif);
 #if SLIP_RX_FROM_ISR
 void slipif_process_rxqueue(struct netif *netif);
 void slipif_received_byte(struct netif *netif, u8_t data);
-void slipif_received_bytes(struct netif *netif, u8_t *data, u8_t len);
+void slipif_received_bytes(struct netif *netif, u8_t *data, u16_t len);
 #endif /* SLIP_RX_FROM_ISR */
 
 #ifdef __cplusplus
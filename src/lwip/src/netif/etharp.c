@@ -55,6 +55,7 @@
 #include "lwip/dhcp.h"
 #include "lwip/autoip.h"
 #include "netif/etharp.h"
+#include "lwip/bpf.h"
 
 #if PPPOE_SUPPORT
 #include "netif/ppp_oe.h"
@@ -70,6 +71,33 @@ const struct eth_addr ethzero = {{0,0,0,0,0,0}};
 #define LL_MULTICAST_ADDR_1 0x00
 #define LL_MULTICAST_ADDR_2 0x5e
 
+#if LWIP_BPF
+/** Record a frame in the netif's capture ring, without the padding word */
+static void
+ethernet_capture(struct netif *netif, struct pbuf *p, u32_t dir)
+{
+#if ETH_PAD_SIZE
+  pbuf_header(p, -ETH_PAD_SIZE);
+#endif
+  bpf_ring_add(netif->capture, p, dir);
+#if ETH_PAD_SIZE
+  pbuf_header(p, ETH_PAD_SIZE);
+#endif
+}
+
+/** Pass a frame to the driver, recording it first if the netif captures */
+static err_t
+ethernet_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  if (netif->capture != NULL) {
+    ethernet_capture(netif, p, BPF_RING_OUT);
+  }
+  return netif->linkoutput(netif, p);
+}
+#else /* LWIP_BPF */
+#define ethernet_linkoutput(netif, p) (netif)->linkoutput(netif, p)
+#endif /* LWIP_BPF */
+
 #if LWIP_ARP /* don't build if not configured for use in lwipopts.h */
 
 /** the time an ARP entry stays valid after its last update,
@@ -423,7 +451,7 @@ etharp_send_ip(struct netif *netif, struct pbuf *p, struct eth_addr *src, struct
   ethhdr->type = PP_HTONS(ETHTYPE_IP);
   LWIP_DEBUGF(ETHARP_DEBUG | LWIP_DBG_TRACE, ("etharp_send_ip: sending packet %p\n", (void *)p));
   /* send the packet */
-  return netif->linkoutput(netif, p);
+  return ethernet_linkoutput(netif, p);
 }
 
 /**
@@ -804,7 +832,7 @@ etharp_arp_input(struct netif *netif, struct eth_addr *ethaddr, struct pbuf *p)
          are already correct, we tested that before */
 
       /* return ARP reply */
-      netif->linkoutput(netif, p);
+      ethernet_linkoutput(netif, p);
     /* we are not configured? */
     } else if (ip_addr_isany(&netif->ip_addr)) {
       /* { for_us == 0 and netif->ip_addr.addr == 0 } */
@@ -1213,7 +1241,7 @@ etharp_raw(struct netif *netif, const struct eth_addr *ethsrc_addr,
 
   ethhdr->type = PP_HTONS(ETHTYPE_ARP);
   /* send ARP query */
-  result = netif->linkoutput(netif, p);
+  result = ethernet_linkoutput(netif, p);
   ETHARP_STATS_INC(etharp.xmit);
   /* free ARP query packet */
   pbuf_free(p);
@@ -1251,6 +1279,14 @@ err_t ethernet_input(struct pbuf *p, struct netif *netif)
     struct eth_hdr *ethhdr;
     s16_t ip_hdr_offset = SIZEOF_ETH_HDR;
 
+#if LWIP_BPF
+    //抓包:在处理之前把帧记录到环形缓冲区
+    if (netif->capture != NULL)
+    {
+        ethernet_capture(netif, p, BPF_RING_IN);
+    }
+#endif /* LWIP_BPF */
+
     if (p->len <= SIZEOF_ETH_HDR)
     {
         /* 仅具有以太网头(或更少)的数据包无效 */
@@ -52,6 +52,7 @@
 #include <lwip/snmp.h>
 #include "netif/etharp.h"
 #include "netif/ppp_oe.h"
+#include "lwip/igmp.h"
 
 #include "stm32f4x7_eth.h"
 #include "lan8720.h"
@@ -74,6 +75,40 @@ struct ethernetif {
 /* Forward declarations. */
 static void  ethernetif_input(struct netif *netif);
 
+#if LWIP_IGMP
+/**
+ * netif->igmp_mac_filter: 组播组地址映射为01:00:5e加低23位的MAC地址,
+ * 并在MAC的组播哈希表中添加或删除,使未加入的组播在硬件中就被丢弃.
+ *
+ * @param netif the lwip network interface structure for this ethernetif
+ * @param group the multicast group address
+ * @param action IGMP_ADD_MAC_FILTER or IGMP_DEL_MAC_FILTER
+ * @return ERR_OK
+ */
+static err_t
+low_level_igmp_mac_filter(struct netif *netif, ip_addr_t *group, u8_t action)
+{
+    u8_t mac[ETHARP_HWADDR_LEN];
+
+    LWIP_UNUSED_ARG(netif);
+    mac[0] = 0x01;
+    mac[1] = 0x00;
+    mac[2] = 0x5e;
+    mac[3] = ip4_addr2(group) & 0x7f;
+    mac[4] = ip4_addr3(group);
+    mac[5] = ip4_addr4(group);
+    if (action == IGMP_ADD_MAC_FILTER)
+    {
+        ETH_MulticastHashAdd(mac);
+    }
+    else
+    {
+        ETH_MulticastHashDel(mac);
+    }
+    return ERR_OK;
+}
+#endif /* LWIP_IGMP */
+
 /**
  * In this function, the hardware should be initialized.
  * Called from ethernetif_init().
@@ -103,6 +138,11 @@ static void low_level_init(struct netif *netif)
     /* device capabilities */
     /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+#if LWIP_IGMP
+    /* 组播过滤由MAC哈希表完成,netif_add()中igmp_start()加入224.0.0.1 */
+    netif->flags |= NETIF_FLAG_IGMP;
+    netif_set_igmp_mac_filter(netif, low_level_igmp_mac_filter);
+#endif /* LWIP_IGMP */
 
     /* Do whatever else is needed to initialize interface. */
     //硬件的实际初始化.当前STM32F407,STM32F407内置了以太网控制器?ZHENXIAOBO.
@@ -164,6 +204,7 @@ low_level_output(struct netif *netif, struct pbuf *p)
 #endif
   
   LINK_STATS_INC(link.xmit);
+  LINK_STATS_OCTETS(xmit, p->tot_len - ETH_PAD_SIZE);
 
   return ERR_OK;
 }
@@ -194,6 +235,13 @@ static struct pbuf *low_level_input(struct netif *netif)
             memcpy((u8_t *)q->payload, (u8_t *)frame.buffer+i, q->len);
             i += q->len;
         }
+        LINK_STATS_INC(link.recv);
+        LINK_STATS_OCTETS(recv, len);
+    }
+    else
+    {
+        LINK_STATS_INC(link.memerr);
+        LINK_STATS_INC(link.drop);
     }
 
     frame.descriptor->Status = ETH_DMARxDesc_OWN;   //设置Rx描述符OWN位,buffer重归DMA
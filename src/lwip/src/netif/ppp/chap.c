@@ -78,7 +78,7 @@
 #include "magic.h"
 #include "randm.h"
 #include "auth.h"
-#include "md5.h"
+#include "digest.h"
 #include "chap.h"
 #include "chpms.h"
 
@@ -427,7 +427,7 @@ ChapReceiveChallenge(chap_state *cstate, u_char *inp, u_char id, int len)
   int secret_len;
   char secret[MAXSECRETLEN];
   char rhostname[256];
-  MD5_CTX mdContext;
+  struct digest_ctx mdContext;
   u_char hash[MD5_SIGNATURE_SIZE];
 
   CHAPDEBUG(LOG_INFO, ("ChapReceiveChallenge: Rcvd id %d.\n", id));
@@ -489,11 +489,13 @@ ChapReceiveChallenge(chap_state *cstate, u_char *inp, u_char id, int len)
   switch (cstate->resp_type) { 
 
   case CHAP_DIGEST_MD5:
-    MD5Init(&mdContext);
-    MD5Update(&mdContext, &cstate->resp_id, 1);
-    MD5Update(&mdContext, (u_char*)secret, secret_len);
-    MD5Update(&mdContext, rchallenge, rchallenge_len);
-    MD5Final(hash, &mdContext);
+    digest_init(&mdContext, DIGEST_MD5);
+    digest_update(&mdContext, &cstate->resp_id, 1);
+    digest_update(&mdContext, (u_char*)secret, secret_len);
+    digest_update(&mdContext, rchallenge, rchallenge_len);
+    if (digest_final(&mdContext, hash) != ERR_OK) {
+      return;
+    }
     BCOPY(hash, cstate->response, MD5_SIGNATURE_SIZE);
     cstate->resp_length = MD5_SIGNATURE_SIZE;
     break;
@@ -524,7 +526,7 @@ ChapReceiveResponse(chap_state *cstate, u_char *inp, int id, int len)
   int secret_len, old_state;
   int code;
   char rhostname[256];
-  MD5_CTX mdContext;
+  struct digest_ctx mdContext;
   char secret[MAXSECRETLEN];
   u_char hash[MD5_SIGNATURE_SIZE];
 
@@ -597,14 +599,14 @@ ChapReceiveResponse(chap_state *cstate, u_char *inp, int id, int len)
         if (remmd_len != MD5_SIGNATURE_SIZE) {
           break;      /* it's not even the right length */
         }
-        MD5Init(&mdContext);
-        MD5Update(&mdContext, &cstate->chal_id, 1);
-        MD5Update(&mdContext, (u_char*)secret, secret_len);
-        MD5Update(&mdContext, cstate->challenge, cstate->chal_len);
-        MD5Final(hash, &mdContext); 
+        digest_init(&mdContext, DIGEST_MD5);
+        digest_update(&mdContext, &cstate->chal_id, 1);
+        digest_update(&mdContext, (u_char*)secret, secret_len);
+        digest_update(&mdContext, cstate->challenge, cstate->chal_len);
         
         /* compare local and remote MDs and send the appropriate status */
-        if (memcmp (hash, remmd, MD5_SIGNATURE_SIZE) == 0) {
+        if (digest_final(&mdContext, hash) == ERR_OK &&
+            memcmp (hash, remmd, MD5_SIGNATURE_SIZE) == 0) {
           code = CHAP_SUCCESS;  /* they are the same! */
         }
         break;
@@ -0,0 +1,123 @@
+/*****************************************************************************
+* digest.c - Message digest providers for the PPP authentication code.
+*
+* Contexts are bound to a provider by digest_init(): the one selected with
+* digest_set_provider() if it can take the context, md5.c otherwise.
+*****************************************************************************/
+
+#include "lwip/opt.h"
+
+#if PPP_SUPPORT /* don't build if not configured for use in lwipopts.h */
+
+#if CHAP_SUPPORT || MD5_SUPPORT
+
+#include "ppp_impl.h"
+#include "pppdebug.h"
+
+#include "digest.h"
+
+
+/***********************************/
+/*** LOCAL FUNCTION DECLARATIONS ***/
+/***********************************/
+static err_t digest_sw_init(struct digest_ctx *ctx, u8_t alg);
+static void  digest_sw_update(struct digest_ctx *ctx, const u8_t *data, u32_t len);
+static err_t digest_sw_final(struct digest_ctx *ctx, u8_t *out);
+
+
+/******************************/
+/*** PUBLIC DATA STRUCTURES ***/
+/******************************/
+const struct digest_provider digest_sw = {
+  "md5.c",
+  digest_sw_init,
+  digest_sw_update,
+  digest_sw_final
+};
+
+
+/*****************************/
+/*** LOCAL DATA STRUCTURES ***/
+/*****************************/
+static const struct digest_provider *digest_provider = &digest_sw;
+
+
+/***********************************/
+/*** PUBLIC FUNCTION DEFINITIONS ***/
+/***********************************/
+void
+digest_set_provider(const struct digest_provider *prov)
+{
+  digest_provider = (prov != NULL) ? prov : &digest_sw;
+  PPPDEBUG(LOG_INFO, ("digest_set_provider: %s\n", digest_provider->name));
+}
+
+/*
+ * digest_init - Start a digest of 'alg' on the selected provider.  Falls
+ * back to software if the provider is busy or lacks the algorithm.
+ */
+err_t
+digest_init(struct digest_ctx *ctx, u8_t alg)
+{
+  const struct digest_provider *prov = digest_provider;
+
+  if (prov != &digest_sw) {
+    ctx->prov = prov;
+    if (prov->init(ctx, alg) == ERR_OK) {
+      return ERR_OK;
+    }
+  }
+  ctx->prov = &digest_sw;
+  return digest_sw_init(ctx, alg);
+}
+
+void
+digest_update(struct digest_ctx *ctx, const u8_t *data, u32_t len)
+{
+  ctx->prov->update(ctx, data, len);
+}
+
+/*
+ * digest_final - Write the digest to 'out' and release the context.
+ */
+err_t
+digest_final(struct digest_ctx *ctx, u8_t *out)
+{
+  err_t err = ctx->prov->final(ctx, out);
+
+  if (err != ERR_OK) {
+    PPPDEBUG(LOG_ERR, ("digest_final: %s failed %d\n", ctx->prov->name, err));
+  }
+  return err;
+}
+
+
+/**********************************/
+/*** LOCAL FUNCTION DEFINITIONS ***/
+/**********************************/
+static err_t
+digest_sw_init(struct digest_ctx *ctx, u8_t alg)
+{
+  if (alg != DIGEST_MD5) {
+    return ERR_VAL;
+  }
+  MD5Init(&ctx->u.md5);
+  return ERR_OK;
+}
+
+static void
+digest_sw_update(struct digest_ctx *ctx, const u8_t *data, u32_t len)
+{
+  MD5Update(&ctx->u.md5, (unsigned char *)data, len);
+}
+
+static err_t
+digest_sw_final(struct digest_ctx *ctx, u8_t *out)
+{
+  MD5Final(out, &ctx->u.md5);
+  return ERR_OK;
+}
+
+#endif /* CHAP_SUPPORT || MD5_SUPPORT */
+
+#endif /* PPP_SUPPORT */
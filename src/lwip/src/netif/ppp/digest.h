@@ -0,0 +1,55 @@
+/*****************************************************************************
+* digest.h - Message digest providers for the PPP authentication code.
+*
+* CHAP and anything else that needs MD5 goes through a digest context
+* instead of calling md5.c directly, so a crypto peripheral can take the
+* work over.  The software provider (md5.c) is always there and is used
+* whenever the selected provider cannot take a context.
+*****************************************************************************/
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include "lwip/err.h"
+#include "md5.h"
+
+/* Digest algorithms */
+#define DIGEST_MD5       0
+#define DIGEST_MD5_SIZE  16
+
+struct digest_ctx;
+
+/*
+ * A digest implementation.  init() returns ERR_VAL for an algorithm it
+ * does not have and ERR_INPROGRESS if the engine is busy with another
+ * context.  Every context that was initialized must be finalized.
+ */
+struct digest_provider {
+  const char *name;
+  err_t (* init)(struct digest_ctx *ctx, u8_t alg);
+  void  (* update)(struct digest_ctx *ctx, const u8_t *data, u32_t len);
+  err_t (* final)(struct digest_ctx *ctx, u8_t *out);
+};
+
+struct digest_ctx {
+  const struct digest_provider *prov;
+  union {
+    MD5_CTX md5;        /* software provider */
+    struct {
+      u32_t word;       /* bytes not yet making up a word */
+      u8_t  nbytes;
+      u8_t  err;
+    } fifo;             /* providers fed with 32-bit words */
+  } u;
+};
+
+extern const struct digest_provider digest_sw;
+
+/* Select the provider for new contexts, NULL for software */
+void  digest_set_provider(const struct digest_provider *prov);
+
+err_t digest_init  (struct digest_ctx *ctx, u8_t alg);
+void  digest_update(struct digest_ctx *ctx, const u8_t *data, u32_t len);
+err_t digest_final (struct digest_ctx *ctx, u8_t *out);
+
+#endif /* DIGEST_H */
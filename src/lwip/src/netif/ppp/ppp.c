@@ -157,6 +157,9 @@ typedef enum {
 
 #define ESCAPE_P(accm, c) ((accm)[(c) >> 3] & pppACCMMask[c & 0x07])
 
+/* The run scanner and block FCS serve both bulk receive and the TX ring. */
+#define PPPOS_SCAN_RUNS   (PPPOS_RX_BULK || PPPOS_TX_RING_SIZE)
+
 /************************/
 /*** LOCAL DATA TYPES ***/
 /************************/
@@ -208,6 +211,10 @@ typedef struct PPPControl_s {
   int  accomp;                  /* Does peer accept addr/ctl compression? */
   u_long lastXMit;              /* Time of last transmission. */
   ext_accm outACCM;             /* Async-Ctl-Char-Map for output. */
+#if PPPOS_SUPPORT && PPPOS_TX_RING_SIZE
+  u16_t txHead;                 /* Where the next frame starts in txRing. */
+  u_char txRing[PPPOS_TX_RING_SIZE]; /* Escaped frames being sent. */
+#endif /* PPPOS_SUPPORT && PPPOS_TX_RING_SIZE */
 #if PPPOS_SUPPORT && VJ_SUPPORT
   int  vjEnabled;               /* Flag indicating VJ compression enabled. */
   struct vjcompress vjComp;     /* Van Jacobson compression header. */
@@ -222,6 +229,20 @@ typedef struct PPPControl_s {
 
 } PPPControl;
 
+#if PPPOS_SUPPORT && PPPOS_TX_RING_SIZE
+/*
+ * A frame being escaped into the transmit ring.
+ */
+typedef struct PPPTxFrame_s {
+  PPPControl *pc;
+  u32_t len;                    /* Octets in the frame so far. */
+  u16_t pos;                    /* Next free octet in the ring. */
+  u16_t fcs;                    /* FCS over the unescaped octets. */
+  u8_t mode;                    /* pppScanMode() of accm. */
+  ext_accm accm;                /* Output ACCM for this frame. */
+} PPPTxFrame;
+#endif /* PPPOS_SUPPORT && PPPOS_TX_RING_SIZE */
+
 
 /*
  * Ioctl definitions.
@@ -243,7 +264,13 @@ static void pppInputThread(void *arg);
 #endif /* PPP_INPROC_OWNTHREAD */
 static void pppDrop(PPPControlRx *pcrx);
 static void pppInProc(PPPControlRx *pcrx, u_char *s, int l);
+static int pppInAlloc(PPPControlRx *pcrx);
 static void pppFreeCurrentInputPacket(PPPControlRx *pcrx);
+#if PPPOS_SCAN_RUNS
+static u8_t pppScanMode(const ext_accm accm);
+static int pppScanRun(const ext_accm accm, u8_t mode, const u_char *s, int l);
+static u16_t pppFcsBlock(u16_t fcs, const u_char *s, int n);
+#endif /* PPPOS_SCAN_RUNS */
 #endif /* PPPOS_SUPPORT */
 
 
@@ -329,6 +356,117 @@ static const u_short fcstab[256] = {
   0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 };
 
+#if PPPOS_SCAN_RUNS
+/*
+ * Slicing-by-4 FCS tables: fcstab4[k][b] is fcstab[b] advanced over k more
+ * zero octets, so pppFcsBlock() folds four octets with four lookups.
+ */
+static const u_short fcstab4[3][256] = {
+  {
+    0x0000, 0x19d8, 0x33b0, 0x2a68, 0x6760, 0x7eb8, 0x54d0, 0x4d08,
+    0xcec0, 0xd718, 0xfd70, 0xe4a8, 0xa9a0, 0xb078, 0x9a10, 0x83c8,
+    0x9591, 0x8c49, 0xa621, 0xbff9, 0xf2f1, 0xeb29, 0xc141, 0xd899,
+    0x5b51, 0x4289, 0x68e1, 0x7139, 0x3c31, 0x25e9, 0x0f81, 0x1659,
+    0x2333, 0x3aeb, 0x1083, 0x095b, 0x4453, 0x5d8b, 0x77e3, 0x6e3b,
+    0xedf3, 0xf42b, 0xde43, 0xc79b, 0x8a93, 0x934b, 0xb923, 0xa0fb,
+    0xb6a2, 0xaf7a, 0x8512, 0x9cca, 0xd1c2, 0xc81a, 0xe272, 0xfbaa,
+    0x7862, 0x61ba, 0x4bd2, 0x520a, 0x1f02, 0x06da, 0x2cb2, 0x356a,
+    0x4666, 0x5fbe, 0x75d6, 0x6c0e, 0x2106, 0x38de, 0x12b6, 0x0b6e,
+    0x88a6, 0x917e, 0xbb16, 0xa2ce, 0xefc6, 0xf61e, 0xdc76, 0xc5ae,
+    0xd3f7, 0xca2f, 0xe047, 0xf99f, 0xb497, 0xad4f, 0x8727, 0x9eff,
+    0x1d37, 0x04ef, 0x2e87, 0x375f, 0x7a57, 0x638f, 0x49e7, 0x503f,
+    0x6555, 0x7c8d, 0x56e5, 0x4f3d, 0x0235, 0x1bed, 0x3185, 0x285d,
+    0xab95, 0xb24d, 0x9825, 0x81fd, 0xccf5, 0xd52d, 0xff45, 0xe69d,
+    0xf0c4, 0xe91c, 0xc374, 0xdaac, 0x97a4, 0x8e7c, 0xa414, 0xbdcc,
+    0x3e04, 0x27dc, 0x0db4, 0x146c, 0x5964, 0x40bc, 0x6ad4, 0x730c,
+    0x8ccc, 0x9514, 0xbf7c, 0xa6a4, 0xebac, 0xf274, 0xd81c, 0xc1c4,
+    0x420c, 0x5bd4, 0x71bc, 0x6864, 0x256c, 0x3cb4, 0x16dc, 0x0f04,
+    0x195d, 0x0085, 0x2aed, 0x3335, 0x7e3d, 0x67e5, 0x4d8d, 0x5455,
+    0xd79d, 0xce45, 0xe42d, 0xfdf5, 0xb0fd, 0xa925, 0x834d, 0x9a95,
+    0xafff, 0xb627, 0x9c4f, 0x8597, 0xc89f, 0xd147, 0xfb2f, 0xe2f7,
+    0x613f, 0x78e7, 0x528f, 0x4b57, 0x065f, 0x1f87, 0x35ef, 0x2c37,
+    0x3a6e, 0x23b6, 0x09de, 0x1006, 0x5d0e, 0x44d6, 0x6ebe, 0x7766,
+    0xf4ae, 0xed76, 0xc71e, 0xdec6, 0x93ce, 0x8a16, 0xa07e, 0xb9a6,
+    0xcaaa, 0xd372, 0xf91a, 0xe0c2, 0xadca, 0xb412, 0x9e7a, 0x87a2,
+    0x046a, 0x1db2, 0x37da, 0x2e02, 0x630a, 0x7ad2, 0x50ba, 0x4962,
+    0x5f3b, 0x46e3, 0x6c8b, 0x7553, 0x385b, 0x2183, 0x0beb, 0x1233,
+    0x91fb, 0x8823, 0xa24b, 0xbb93, 0xf69b, 0xef43, 0xc52b, 0xdcf3,
+    0xe999, 0xf041, 0xda29, 0xc3f1, 0x8ef9, 0x9721, 0xbd49, 0xa491,
+    0x2759, 0x3e81, 0x14e9, 0x0d31, 0x4039, 0x59e1, 0x7389, 0x6a51,
+    0x7c08, 0x65d0, 0x4fb8, 0x5660, 0x1b68, 0x02b0, 0x28d8, 0x3100,
+    0xb2c8, 0xab10, 0x8178, 0x98a0, 0xd5a8, 0xcc70, 0xe618, 0xffc0
+  },
+  {
+    0x0000, 0x5adc, 0xb5b8, 0xef64, 0x6361, 0x39bd, 0xd6d9, 0x8c05,
+    0xc6c2, 0x9c1e, 0x737a, 0x29a6, 0xa5a3, 0xff7f, 0x101b, 0x4ac7,
+    0x8595, 0xdf49, 0x302d, 0x6af1, 0xe6f4, 0xbc28, 0x534c, 0x0990,
+    0x4357, 0x198b, 0xf6ef, 0xac33, 0x2036, 0x7aea, 0x958e, 0xcf52,
+    0x033b, 0x59e7, 0xb683, 0xec5f, 0x605a, 0x3a86, 0xd5e2, 0x8f3e,
+    0xc5f9, 0x9f25, 0x7041, 0x2a9d, 0xa698, 0xfc44, 0x1320, 0x49fc,
+    0x86ae, 0xdc72, 0x3316, 0x69ca, 0xe5cf, 0xbf13, 0x5077, 0x0aab,
+    0x406c, 0x1ab0, 0xf5d4, 0xaf08, 0x230d, 0x79d1, 0x96b5, 0xcc69,
+    0x0676, 0x5caa, 0xb3ce, 0xe912, 0x6517, 0x3fcb, 0xd0af, 0x8a73,
+    0xc0b4, 0x9a68, 0x750c, 0x2fd0, 0xa3d5, 0xf909, 0x166d, 0x4cb1,
+    0x83e3, 0xd93f, 0x365b, 0x6c87, 0xe082, 0xba5e, 0x553a, 0x0fe6,
+    0x4521, 0x1ffd, 0xf099, 0xaa45, 0x2640, 0x7c9c, 0x93f8, 0xc924,
+    0x054d, 0x5f91, 0xb0f5, 0xea29, 0x662c, 0x3cf0, 0xd394, 0x8948,
+    0xc38f, 0x9953, 0x7637, 0x2ceb, 0xa0ee, 0xfa32, 0x1556, 0x4f8a,
+    0x80d8, 0xda04, 0x3560, 0x6fbc, 0xe3b9, 0xb965, 0x5601, 0x0cdd,
+    0x461a, 0x1cc6, 0xf3a2, 0xa97e, 0x257b, 0x7fa7, 0x90c3, 0xca1f,
+    0x0cec, 0x5630, 0xb954, 0xe388, 0x6f8d, 0x3551, 0xda35, 0x80e9,
+    0xca2e, 0x90f2, 0x7f96, 0x254a, 0xa94f, 0xf393, 0x1cf7, 0x462b,
+    0x8979, 0xd3a5, 0x3cc1, 0x661d, 0xea18, 0xb0c4, 0x5fa0, 0x057c,
+    0x4fbb, 0x1567, 0xfa03, 0xa0df, 0x2cda, 0x7606, 0x9962, 0xc3be,
+    0x0fd7, 0x550b, 0xba6f, 0xe0b3, 0x6cb6, 0x366a, 0xd90e, 0x83d2,
+    0xc915, 0x93c9, 0x7cad, 0x2671, 0xaa74, 0xf0a8, 0x1fcc, 0x4510,
+    0x8a42, 0xd09e, 0x3ffa, 0x6526, 0xe923, 0xb3ff, 0x5c9b, 0x0647,
+    0x4c80, 0x165c, 0xf938, 0xa3e4, 0x2fe1, 0x753d, 0x9a59, 0xc085,
+    0x0a9a, 0x5046, 0xbf22, 0xe5fe, 0x69fb, 0x3327, 0xdc43, 0x869f,
+    0xcc58, 0x9684, 0x79e0, 0x233c, 0xaf39, 0xf5e5, 0x1a81, 0x405d,
+    0x8f0f, 0xd5d3, 0x3ab7, 0x606b, 0xec6e, 0xb6b2, 0x59d6, 0x030a,
+    0x49cd, 0x1311, 0xfc75, 0xa6a9, 0x2aac, 0x7070, 0x9f14, 0xc5c8,
+    0x09a1, 0x537d, 0xbc19, 0xe6c5, 0x6ac0, 0x301c, 0xdf78, 0x85a4,
+    0xcf63, 0x95bf, 0x7adb, 0x2007, 0xac02, 0xf6de, 0x19ba, 0x4366,
+    0x8c34, 0xd6e8, 0x398c, 0x6350, 0xef55, 0xb589, 0x5aed, 0x0031,
+    0x4af6, 0x102a, 0xff4e, 0xa592, 0x2997, 0x734b, 0x9c2f, 0xc6f3
+  },
+  {
+    0x0000, 0x1cbb, 0x3976, 0x25cd, 0x72ec, 0x6e57, 0x4b9a, 0x5721,
+    0xe5d8, 0xf963, 0xdcae, 0xc015, 0x9734, 0x8b8f, 0xae42, 0xb2f9,
+    0xc3a1, 0xdf1a, 0xfad7, 0xe66c, 0xb14d, 0xadf6, 0x883b, 0x9480,
+    0x2679, 0x3ac2, 0x1f0f, 0x03b4, 0x5495, 0x482e, 0x6de3, 0x7158,
+    0x8f53, 0x93e8, 0xb625, 0xaa9e, 0xfdbf, 0xe104, 0xc4c9, 0xd872,
+    0x6a8b, 0x7630, 0x53fd, 0x4f46, 0x1867, 0x04dc, 0x2111, 0x3daa,
+    0x4cf2, 0x5049, 0x7584, 0x693f, 0x3e1e, 0x22a5, 0x0768, 0x1bd3,
+    0xa92a, 0xb591, 0x905c, 0x8ce7, 0xdbc6, 0xc77d, 0xe2b0, 0xfe0b,
+    0x16b7, 0x0a0c, 0x2fc1, 0x337a, 0x645b, 0x78e0, 0x5d2d, 0x4196,
+    0xf36f, 0xefd4, 0xca19, 0xd6a2, 0x8183, 0x9d38, 0xb8f5, 0xa44e,
+    0xd516, 0xc9ad, 0xec60, 0xf0db, 0xa7fa, 0xbb41, 0x9e8c, 0x8237,
+    0x30ce, 0x2c75, 0x09b8, 0x1503, 0x4222, 0x5e99, 0x7b54, 0x67ef,
+    0x99e4, 0x855f, 0xa092, 0xbc29, 0xeb08, 0xf7b3, 0xd27e, 0xcec5,
+    0x7c3c, 0x6087, 0x454a, 0x59f1, 0x0ed0, 0x126b, 0x37a6, 0x2b1d,
+    0x5a45, 0x46fe, 0x6333, 0x7f88, 0x28a9, 0x3412, 0x11df, 0x0d64,
+    0xbf9d, 0xa326, 0x86eb, 0x9a50, 0xcd71, 0xd1ca, 0xf407, 0xe8bc,
+    0x2d6e, 0x31d5, 0x1418, 0x08a3, 0x5f82, 0x4339, 0x66f4, 0x7a4f,
+    0xc8b6, 0xd40d, 0xf1c0, 0xed7b, 0xba5a, 0xa6e1, 0x832c, 0x9f97,
+    0xeecf, 0xf274, 0xd7b9, 0xcb02, 0x9c23, 0x8098, 0xa555, 0xb9ee,
+    0x0b17, 0x17ac, 0x3261, 0x2eda, 0x79fb, 0x6540, 0x408d, 0x5c36,
+    0xa23d, 0xbe86, 0x9b4b, 0x87f0, 0xd0d1, 0xcc6a, 0xe9a7, 0xf51c,
+    0x47e5, 0x5b5e, 0x7e93, 0x6228, 0x3509, 0x29b2, 0x0c7f, 0x10c4,
+    0x619c, 0x7d27, 0x58ea, 0x4451, 0x1370, 0x0fcb, 0x2a06, 0x36bd,
+    0x8444, 0x98ff, 0xbd32, 0xa189, 0xf6a8, 0xea13, 0xcfde, 0xd365,
+    0x3bd9, 0x2762, 0x02af, 0x1e14, 0x4935, 0x558e, 0x7043, 0x6cf8,
+    0xde01, 0xc2ba, 0xe777, 0xfbcc, 0xaced, 0xb056, 0x959b, 0x8920,
+    0xf878, 0xe4c3, 0xc10e, 0xddb5, 0x8a94, 0x962f, 0xb3e2, 0xaf59,
+    0x1da0, 0x011b, 0x24d6, 0x386d, 0x6f4c, 0x73f7, 0x563a, 0x4a81,
+    0xb48a, 0xa831, 0x8dfc, 0x9147, 0xc666, 0xdadd, 0xff10, 0xe3ab,
+    0x5152, 0x4de9, 0x6824, 0x749f, 0x23be, 0x3f05, 0x1ac8, 0x0673,
+    0x772b, 0x6b90, 0x4e5d, 0x52e6, 0x05c7, 0x197c, 0x3cb1, 0x200a,
+    0x92f3, 0x8e48, 0xab85, 0xb73e, 0xe01f, 0xfca4, 0xd969, 0xc5d2
+  }
+};
+#endif /* PPPOS_SCAN_RUNS */
+
 /* PPP's Asynchronous-Control-Character-Map.  The mask array is used
  * to select the specific bit for a character. */
 static u_char pppACCMMask[] = {
@@ -699,6 +837,157 @@ pppSigHUP(int pd)
 }
 
 #if PPPOS_SUPPORT
+#if PPPOS_TX_RING_SIZE
+/*
+ * pppTxPut - copy n octets into the transmit ring as they are.  A frame
+ * growing past the ring size is marked too long and not copied further.
+ */
+static void
+pppTxPut(PPPTxFrame *tx, const u_char *s, int n)
+{
+  u_char *ring = tx->pc->txRing;
+  int chunk;
+
+  if (tx->len + n > PPPOS_TX_RING_SIZE) {
+    tx->len = PPPOS_TX_RING_SIZE + 1;
+    return;
+  }
+  tx->len += n;
+  if (n <= 2) {
+    /* flags and escape pairs */
+    while (n-- > 0) {
+      ring[tx->pos++] = *s++;
+      if (tx->pos == PPPOS_TX_RING_SIZE) {
+        tx->pos = 0;
+      }
+    }
+    return;
+  }
+  while (n > 0) {
+    chunk = LWIP_MIN(n, PPPOS_TX_RING_SIZE - tx->pos);
+    MEMCPY(ring + tx->pos, s, chunk);
+    tx->pos += chunk;
+    if (tx->pos == PPPOS_TX_RING_SIZE) {
+      tx->pos = 0;
+    }
+    s += chunk;
+    n -= chunk;
+  }
+}
+
+/*
+ * pppTxEscape - copy n octets into the transmit ring, escaping those in
+ * the ACCM.  Runs needing no escape are found a word at a time and block
+ * copied.
+ */
+static void
+pppTxEscape(PPPTxFrame *tx, const u_char *s, int n)
+{
+  u_char esc[2];
+  int run;
+
+  while (n > 0) {
+    run = pppScanRun(tx->accm, tx->mode, s, n);
+    if (run > 0) {
+      pppTxPut(tx, s, run);
+      s += run;
+      n -= run;
+    } else {
+      esc[0] = PPP_ESCAPE;
+      esc[1] = *s++ ^ PPP_TRANS;
+      pppTxPut(tx, esc, 2);
+      n--;
+    }
+  }
+}
+
+/*
+ * pppTxData - add n octets of frame content: update the FCS and escape
+ * them into the transmit ring.
+ */
+static void
+pppTxData(PPPTxFrame *tx, const u_char *s, int n)
+{
+  tx->fcs = pppFcsBlock(tx->fcs, s, n);
+  pppTxEscape(tx, s, n);
+}
+
+/*
+ * pppTxBegin - start a frame at the head of the transmit ring.  If the
+ * link has been idle, lead with a fresh flag character to flush any noise.
+ */
+static void
+pppTxBegin(PPPControl *pc, PPPTxFrame *tx)
+{
+  u_char flag = PPP_FLAG;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  tx->pc = pc;
+  tx->len = 0;
+  tx->pos = pc->txHead;
+  tx->fcs = PPP_INITFCS;
+  /* ppp_send_config() may change the ACCM: take a copy for this frame */
+  SYS_ARCH_PROTECT(lev);
+  MEMCPY(tx->accm, pc->outACCM, sizeof(tx->accm));
+  SYS_ARCH_UNPROTECT(lev);
+  tx->mode = pppScanMode(tx->accm);
+
+  if ((sys_jiffies() - pc->lastXMit) >= PPP_MAXIDLEFLAG) {
+    pppTxPut(tx, &flag, 1);
+  }
+  pc->lastXMit = sys_jiffies();
+}
+
+/*
+ * pppTxEnd - add the FCS and trailing flag and hand the frame to the
+ * serial layer in one vectored write: one segment, or two where the frame
+ * wraps around the end of the ring.
+ * Returns ERR_MEM if the frame did not fit in the ring and was dropped.
+ */
+static err_t
+pppTxEnd(PPPTxFrame *tx)
+{
+  PPPControl *pc = tx->pc;
+  struct sio_iovec iov[2];
+  u_char c[2];
+  u16_t fcs;
+  u8_t cnt = 1;
+  u32_t sent;
+
+  fcs = ~tx->fcs;
+  c[0] = fcs & 0xFF;
+  c[1] = (fcs >> 8) & 0xFF;
+  pppTxEscape(tx, c, 2);
+  c[0] = PPP_FLAG;
+  pppTxPut(tx, c, 1);
+  if (tx->len > PPPOS_TX_RING_SIZE) {
+    return ERR_MEM;
+  }
+
+  iov[0].data = pc->txRing + pc->txHead;
+  iov[0].len = LWIP_MIN(tx->len, (u32_t)(PPPOS_TX_RING_SIZE - pc->txHead));
+  if (iov[0].len < tx->len) {
+    iov[1].data = pc->txRing;
+    iov[1].len = tx->len - iov[0].len;
+    cnt = 2;
+  }
+  pc->txHead = tx->pos;
+
+  if ((sent = sio_writev(pc->fd, iov, cnt)) != tx->len) {
+    PPPDEBUG(LOG_WARNING,
+             ("PPP pppTxEnd: incomplete sio_writev(fd:%"SZT_F", len:%"U32_F") c = %"U32_F"\n", (size_t)pc->fd, tx->len, sent));
+    LINK_STATS_INC(link.err);
+    pc->lastXMit = 0; /* prepend PPP_FLAG to next packet */
+    snmp_inc_ifoutdiscards(&pc->netif);
+    return ERR_OK;
+  }
+
+  snmp_add_ifoutoctets(&pc->netif, tx->len);
+  snmp_inc_ifoutucastpkts(&pc->netif);
+  LINK_STATS_INC(link.xmit);
+  return ERR_OK;
+}
+#else /* PPPOS_TX_RING_SIZE */
 static void
 nPut(PPPControl *pc, struct pbuf *nb)
 {
@@ -759,6 +1048,7 @@ pppAppend(u_char c, struct pbuf *nb, ext_accm *outACCM)
 
   return tb;
 }
+#endif /* PPPOS_TX_RING_SIZE */
 #endif /* PPPOS_SUPPORT */
 
 #if PPPOE_SUPPORT
@@ -813,9 +1103,16 @@ pppifOutput(struct netif *netif, struct pbuf *pb, ip_addr_t *ipaddr)
   PPPControl *pc = &pppControl[pd];
 #if PPPOS_SUPPORT
   u_short protocol = PPP_IP;
+  struct pbuf *p;
+#if PPPOS_TX_RING_SIZE
+  PPPTxFrame tx;
+  u_char hdr[PPP_HDRLEN];
+  int i = 0;
+#else /* PPPOS_TX_RING_SIZE */
   u_int fcsOut = PPP_INITFCS;
-  struct pbuf *headMB = NULL, *tailMB = NULL, *p;
+  struct pbuf *headMB = NULL, *tailMB = NULL;
   u_char c;
+#endif /* PPPOS_TX_RING_SIZE */
 #endif /* PPPOS_SUPPORT */
 
   LWIP_UNUSED_ARG(ipaddr);
@@ -848,6 +1145,7 @@ pppifOutput(struct netif *netif, struct pbuf *pb, ip_addr_t *ipaddr)
 #endif /* PPPOE_SUPPORT */
 
 #if PPPOS_SUPPORT
+#if !PPPOS_TX_RING_SIZE
   /* Grab an output buffer. */
   headMB = pbuf_alloc(PBUF_RAW, 0, PBUF_POOL);
   if (headMB == NULL) {
@@ -857,6 +1155,7 @@ pppifOutput(struct netif *netif, struct pbuf *pb, ip_addr_t *ipaddr)
     snmp_inc_ifoutdiscards(netif);
     return ERR_MEM;
   }
+#endif /* !PPPOS_TX_RING_SIZE */
 
 #if VJ_SUPPORT
   /* 
@@ -880,12 +1179,41 @@ pppifOutput(struct netif *netif, struct pbuf *pb, ip_addr_t *ipaddr)
         LINK_STATS_INC(link.proterr);
         LINK_STATS_INC(link.drop);
         snmp_inc_ifoutdiscards(netif);
+#if !PPPOS_TX_RING_SIZE
         pbuf_free(headMB);
+#endif /* !PPPOS_TX_RING_SIZE */
         return ERR_VAL;
     }
   }
 #endif /* VJ_SUPPORT */
 
+#if PPPOS_TX_RING_SIZE
+  /* Escape header and packet straight into the transmit ring. */
+  pppTxBegin(pc, &tx);
+  if (!pc->accomp) {
+    hdr[i++] = PPP_ALLSTATIONS;
+    hdr[i++] = PPP_UI;
+  }
+  if (!pc->pcomp || protocol > 0xFF) {
+    hdr[i++] = (protocol >> 8) & 0xFF;
+  }
+  hdr[i++] = protocol & 0xFF;
+  pppTxData(&tx, hdr, i);
+  for(p = pb; p; p = p->next) {
+    pppTxData(&tx, (u_char*)p->payload, p->len);
+  }
+
+  PPPDEBUG(LOG_INFO, ("pppifOutput[%d]: proto=0x%"X16_F"\n", pd, protocol));
+  if (pppTxEnd(&tx) != ERR_OK) {
+    PPPDEBUG(LOG_WARNING,
+             ("pppifOutput[%d]: frame too long - dropping proto=%d\n", 
+              pd, protocol));
+    LINK_STATS_INC(link.memerr);
+    LINK_STATS_INC(link.drop);
+    snmp_inc_ifoutdiscards(netif);
+    return ERR_MEM;
+  }
+#else /* PPPOS_TX_RING_SIZE */
   tailMB = headMB;
 
   /* Build the PPP header. */
@@ -950,6 +1278,7 @@ pppifOutput(struct netif *netif, struct pbuf *pb, ip_addr_t *ipaddr)
   PPPDEBUG(LOG_INFO, ("pppifOutput[%d]: proto=0x%"X16_F"\n", pd, protocol));
 
   nPut(pc, headMB);
+#endif /* PPPOS_TX_RING_SIZE */
 #endif /* PPPOS_SUPPORT */
 
   return ERR_OK;
@@ -997,6 +1326,15 @@ pppIOCtl(int pd, int cmd, void *arg)
       }
       break;
 #endif /* PPPOS_SUPPORT */
+#if PPPOS_SUPPORT && VJ_SUPPORT && LINK_STATS
+    case PPPCTLG_VJSTATS:       /* Get the VJ compression counters */
+      if (arg) {
+        *(struct vjstat *)arg = pc->vjComp.stats;
+      } else {
+        st = PPPERR_PARAM;
+      }
+      break;
+#endif /* PPPOS_SUPPORT && VJ_SUPPORT && LINK_STATS */
     default:
       st = PPPERR_PARAM;
       break;
@@ -1074,9 +1412,13 @@ pppWrite(int pd, const u_char *s, int n)
 {
   PPPControl *pc = &pppControl[pd];
 #if PPPOS_SUPPORT
+#if PPPOS_TX_RING_SIZE
+  PPPTxFrame tx;
+#else /* PPPOS_TX_RING_SIZE */
   u_char c;
   u_int fcsOut;
   struct pbuf *headMB, *tailMB;
+#endif /* PPPOS_TX_RING_SIZE */
 #endif /* PPPOS_SUPPORT */
 
 #if PPPOE_SUPPORT
@@ -1086,6 +1428,20 @@ pppWrite(int pd, const u_char *s, int n)
 #endif /* PPPOE_SUPPORT */
 
 #if PPPOS_SUPPORT
+#if PPPOS_TX_RING_SIZE
+  pppTxBegin(pc, &tx);
+  pppTxData(&tx, s, n);
+
+  PPPDEBUG(LOG_INFO, ("pppWrite[%d]: len=%d\n", pd, n));
+  if (pppTxEnd(&tx) != ERR_OK) {
+    PPPDEBUG(LOG_WARNING,
+             ("pppWrite[%d]: frame too long - dropping len=%d\n", pd, n));
+    LINK_STATS_INC(link.memerr);
+    LINK_STATS_INC(link.proterr);
+    snmp_inc_ifoutdiscards(&pc->netif);
+    return PPPERR_ALLOC;
+  }
+#else /* PPPOS_TX_RING_SIZE */
   headMB = pbuf_alloc(PBUF_RAW, 0, PBUF_POOL);
   if (headMB == NULL) {
     LINK_STATS_INC(link.memerr);
@@ -1138,6 +1494,7 @@ pppWrite(int pd, const u_char *s, int n)
   PPPDEBUG(LOG_INFO, ("pppWrite[%d]: len=%d\n", pd, headMB->len));
                    /* "pppWrite[%d]: %d:%.*H", pd, headMB->len, LWIP_MIN(headMB->len * 2, 40), headMB->payload)); */
   nPut(pc, headMB);
+#endif /* PPPOS_TX_RING_SIZE */
 #endif /* PPPOS_SUPPORT */
 
   return PPPERR_NONE;
@@ -1302,8 +1659,7 @@ sifvjcomp(int pd, int vjcomp, u8_t cidcomp, u8_t maxcid)
   PPPControl *pc = &pppControl[pd];
   
   pc->vjEnabled = vjcomp;
-  pc->vjComp.compressSlot = cidcomp;
-  pc->vjComp.maxSlotIndex = maxcid;
+  vj_compress_config(&pc->vjComp, cidcomp, maxcid);
   PPPDEBUG(LOG_INFO, ("sifvjcomp: VJ compress enable=%d slot=%d max slot=%d\n",
             vjcomp, cidcomp, maxcid));
 #else /* PPPOS_SUPPORT && VJ_SUPPORT */
@@ -1774,24 +2130,212 @@ pppos_input(int pd, u_char* data, int len)
 }
 #endif
 
+/*
+ * Make room for more data of the input packet: append a new pbuf to the
+ * chain, starting the packet with a pppInputHeader if needed.
+ * Returns 0 on success, -1 if out of pbufs (the packet is dropped).
+ */
+static int
+pppInAlloc(PPPControlRx *pcrx)
+{
+  struct pbuf *nextNBuf;
+
+  if (pcrx->inTail != NULL) {
+    pcrx->inTail->tot_len = pcrx->inTail->len;
+    if (pcrx->inTail != pcrx->inHead) {
+      pbuf_cat(pcrx->inHead, pcrx->inTail);
+      /* give up the inTail reference now */
+      pcrx->inTail = NULL;
+    }
+  }
+  /* If we haven't started a packet, we need a packet header. */
+  nextNBuf = pbuf_alloc(PBUF_RAW, 0, PBUF_POOL);
+  if (nextNBuf == NULL) {
+    /* No free buffers.  Drop the input packet and let the
+     * higher layers deal with it.  Continue processing
+     * the received pbuf chain in case a new packet starts. */
+    PPPDEBUG(LOG_ERR, ("pppInProc[%d]: NO FREE MBUFS!\n", pcrx->pd));
+    LINK_STATS_INC(link.memerr);
+    pppDrop(pcrx);
+    pcrx->inState = PDSTART;  /* Wait for flag sequence. */
+    return -1;
+  }
+  if (pcrx->inHead == NULL) {
+    struct pppInputHeader *pih = nextNBuf->payload;
+
+    pih->unit = pcrx->pd;
+    pih->proto = pcrx->inProtocol;
+
+    nextNBuf->len += sizeof(*pih);
+
+    pcrx->inHead = nextNBuf;
+  }
+  pcrx->inTail = nextNBuf;
+  return 0;
+}
+
+#if PPPOS_SCAN_RUNS
+/* Ways pppScanRun() can look for octets needing attention. */
+#define PPP_SCAN_BYTES  0   /* unusual ACCM: test every octet */
+#define PPP_SCAN_FLAGS  1   /* only flag and escape are special */
+#define PPP_SCAN_CTRL   2   /* flag, escape and (some) control characters */
+
+/* Nonzero if any octet of the word is zero / below n (n <= 128). */
+#define PPP_HASZERO(v)    (((v) - 0x01010101UL) & ~(v) & 0x80808080UL)
+#define PPP_HASLESS(v, n) (((v) - 0x01010101UL * (n)) & ~(v) & 0x80808080UL)
+
+/*
+ * Choose how pppScanRun() scans for the given ACCM. The word-wise tests are
+ * only exact for the ACCMs LCP negotiates: flag and escape plus any set of
+ * the 32 control characters.
+ */
+static u8_t
+pppScanMode(const ext_accm accm)
+{
+  int i;
+
+  for (i = 4; i < 32; i++) {
+    if (accm[i] != ((i == 15) ? 0x60 : 0)) {
+      return PPP_SCAN_BYTES;
+    }
+  }
+  if (accm[0] | accm[1] | accm[2] | accm[3]) {
+    return PPP_SCAN_CTRL;
+  }
+  return PPP_SCAN_FLAGS;
+}
+
+/*
+ * Return the number of octets at s needing no special handling, i.e. the
+ * length of the run up to the next flag, escape or ACCM character.
+ */
+static int
+pppScanRun(const ext_accm accm, u8_t mode, const u_char *s, int l)
+{
+  const u_char *p = s;
+  const u_char *end = s + l;
+  u32_t v;
+  int i;
+
+  if (mode != PPP_SCAN_BYTES) {
+    /* align, then test four octets at a time */
+    while ((p < end) && ((mem_ptr_t)p & 3)) {
+      if (ESCAPE_P(accm, *p)) {
+        return (int)(p - s);
+      }
+      p++;
+    }
+    while (end - p >= 4) {
+      v = *(const u32_t *)p;
+      if (PPP_HASZERO(v ^ 0x7e7e7e7eUL) || PPP_HASZERO(v ^ 0x7d7d7d7dUL) ||
+          ((mode == PPP_SCAN_CTRL) && PPP_HASLESS(v, 0x20))) {
+        /* a control character need not be in the ACCM: check each octet */
+        for (i = 0; i < 4; i++) {
+          if (ESCAPE_P(accm, p[i])) {
+            return (int)(p - s) + i;
+          }
+        }
+      }
+      p += 4;
+    }
+  }
+  while ((p < end) && !ESCAPE_P(accm, *p)) {
+    p++;
+  }
+  return (int)(p - s);
+}
+
+/*
+ * Update the FCS over n octets, four at a time (slicing-by-4).
+ */
+static u16_t
+pppFcsBlock(u16_t fcs, const u_char *s, int n)
+{
+  while (n >= 4) {
+    fcs ^= (u16_t)(s[0] | (s[1] << 8));
+    fcs = fcstab4[2][fcs & 0xff] ^ fcstab4[1][fcs >> 8] ^ fcstab4[0][s[2]] ^ fcstab[s[3]];
+    s += 4;
+    n -= 4;
+  }
+  while (n-- > 0) {
+    fcs = PPP_FCS(fcs, *s);
+    s++;
+  }
+  return fcs;
+}
+#endif /* PPPOS_SCAN_RUNS */
+
+#if PPPOS_RX_BULK
+/*
+ * Append a run of n plain data octets to the input packet.
+ * Returns -1 if the packet had to be dropped (out of pbufs).
+ */
+static int
+pppInRun(PPPControlRx *pcrx, const u_char *s, int n)
+{
+  int chunk;
+
+  pcrx->inFCS = pppFcsBlock(pcrx->inFCS, s, n);
+  while (n > 0) {
+    if (pcrx->inTail == NULL || pcrx->inTail->len == PBUF_POOL_BUFSIZE) {
+      if (pppInAlloc(pcrx) < 0) {
+        return -1;
+      }
+    }
+    chunk = LWIP_MIN(n, PBUF_POOL_BUFSIZE - pcrx->inTail->len);
+    MEMCPY((u_char*)pcrx->inTail->payload + pcrx->inTail->len, s, chunk);
+    pcrx->inTail->len += chunk;
+    s += chunk;
+    n -= chunk;
+  }
+  return 0;
+}
+#endif /* PPPOS_RX_BULK */
+
 /**
  * Process a received octet string.
  */
 static void
 pppInProc(PPPControlRx *pcrx, u_char *s, int l)
 {
-  struct pbuf *nextNBuf;
   u_char curChar;
   u_char escaped;
+  ext_accm accm;
+#if PPPOS_RX_BULK
+  u8_t mode;
+  int run;
+#endif /* PPPOS_RX_BULK */
   SYS_ARCH_DECL_PROTECT(lev);
 
   PPPDEBUG(LOG_DEBUG, ("pppInProc[%d]: got %d bytes\n", pcrx->pd, l));
-  while (l-- > 0) {
+  /* ppp_recv_config() may change the ACCM: take a copy for this call */
+  SYS_ARCH_PROTECT(lev);
+  MEMCPY(accm, pcrx->inACCM, sizeof(accm));
+  SYS_ARCH_UNPROTECT(lev);
+#if PPPOS_RX_BULK
+  mode = pppScanMode(accm);
+#endif /* PPPOS_RX_BULK */
+
+  while (l > 0) {
+#if PPPOS_RX_BULK
+    /* Packet data up to the next special octet goes in as a block. */
+    if ((pcrx->inState == PDDATA) && !pcrx->inEscaped) {
+      run = pppScanRun(accm, mode, s, l);
+      if (run > 0) {
+        if (pppInRun(pcrx, s, run) < 0) {
+          /* out of pbufs: skip the rest of the packet */
+          pcrx->inState = PDSTART;
+        }
+        s += run;
+        l -= run;
+        continue;
+      }
+    }
+#endif /* PPPOS_RX_BULK */
     curChar = *s++;
+    l--;
 
-    SYS_ARCH_PROTECT(lev);
-    escaped = ESCAPE_P(pcrx->inACCM, curChar);
-    SYS_ARCH_UNPROTECT(lev);
+    escaped = ESCAPE_P(accm, curChar);
     /* Handle special characters. */
     if (escaped) {
       /* Check for escape sequences. */
@@ -1929,37 +2473,9 @@ pppInProc(PPPControlRx *pcrx, u_char *s, int l)
         case PDDATA:                    /* Process data byte. */
           /* Make space to receive processed data. */
           if (pcrx->inTail == NULL || pcrx->inTail->len == PBUF_POOL_BUFSIZE) {
-            if (pcrx->inTail != NULL) {
-              pcrx->inTail->tot_len = pcrx->inTail->len;
-              if (pcrx->inTail != pcrx->inHead) {
-                pbuf_cat(pcrx->inHead, pcrx->inTail);
-                /* give up the inTail reference now */
-                pcrx->inTail = NULL;
-              }
-            }
-            /* If we haven't started a packet, we need a packet header. */
-            nextNBuf = pbuf_alloc(PBUF_RAW, 0, PBUF_POOL);
-            if (nextNBuf == NULL) {
-              /* No free buffers.  Drop the input packet and let the
-               * higher layers deal with it.  Continue processing
-               * the received pbuf chain in case a new packet starts. */
-              PPPDEBUG(LOG_ERR, ("pppInProc[%d]: NO FREE MBUFS!\n", pcrx->pd));
-              LINK_STATS_INC(link.memerr);
-              pppDrop(pcrx);
-              pcrx->inState = PDSTART;  /* Wait for flag sequence. */
+            if (pppInAlloc(pcrx) < 0) {
               break;
             }
-            if (pcrx->inHead == NULL) {
-              struct pppInputHeader *pih = nextNBuf->payload;
-
-              pih->unit = pcrx->pd;
-              pih->proto = pcrx->inProtocol;
-
-              nextNBuf->len += sizeof(*pih);
-
-              pcrx->inHead = nextNBuf;
-            }
-            pcrx->inTail = nextNBuf;
           }
           /* Load character into buffer. */
           ((u_char*)pcrx->inTail->payload)[pcrx->inTail->len++] = curChar;
@@ -1969,7 +2485,7 @@ pppInProc(PPPControlRx *pcrx, u_char *s, int l)
       /* update the frame check sequence number. */
       pcrx->inFCS = PPP_FCS(pcrx->inFCS, curChar);
     }
-  } /* while (l-- > 0), all bytes processed */
+  } /* while (l > 0), all bytes processed */
 
   avRandomize();
 }
@@ -84,6 +84,7 @@ typedef unsigned char  u_char;
 #define PPPCTLS_ERRCODE  101 /* Set the error code */
 #define PPPCTLG_ERRCODE  102 /* Get the error code */
 #define PPPCTLG_FD       103 /* Get the fd associated with the ppp */
+#define PPPCTLG_VJSTATS  104 /* Get the VJ compression counters (struct vjstat) */
 
 /************************
 *** PUBLIC DATA TYPES ***
@@ -47,29 +47,114 @@
 #define INCR(counter)
 #endif
 
+/* Hash bucket of a connection: addresses and the TCP ports word. */
+#define VJ_HASH(src, dest, ports) \
+  vj_hash_fold((src) ^ (dest) ^ ((ports) * 0x9E3779B1UL))
+
+static u_int
+vj_hash_fold(u32_t h)
+{
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return (u_int)(h & (VJ_HASH_SIZE - 1));
+}
+
+/*
+ * Set up the transmit states for slots 0..maxSlotIndex: an lru ring
+ * (doubly linked, last_cs is the oldest and last_cs->cs_next the newest)
+ * and an empty connection hash.
+ */
+static void
+vj_compress_slots(struct vjcompress *comp, u_char maxSlotIndex)
+{
+  register u_int i;
+  register struct cstate *tstate = comp->tstate;
+
+  for (i = 0; i <= maxSlotIndex; i++) {
+    tstate[i].cs_id = (u_char)i;
+    tstate[i].cs_next = &tstate[(i == 0) ? maxSlotIndex : i - 1];
+    tstate[i].cs_prev = &tstate[(i == maxSlotIndex) ? 0 : i + 1];
+    tstate[i].cs_hnext = NULL;
+    tstate[i].cs_hashed = 0;
+  }
+  memset(comp->hash, 0, sizeof(comp->hash));
+  comp->last_cs = &tstate[0];
+  comp->last_xmit = 255;
+}
+
 void
 vj_compress_init(struct vjcompress *comp)
 {
-  register u_char i;
-  register struct cstate *tstate = comp->tstate;
-  
 #if MAX_SLOTS == 0
   memset((char *)comp, 0, sizeof(*comp));
 #endif
   comp->maxSlotIndex = MAX_SLOTS - 1;
   comp->compressSlot = 0;    /* Disable slot ID compression by default. */
-  for (i = MAX_SLOTS - 1; i > 0; --i) {
-    tstate[i].cs_id = i;
-    tstate[i].cs_next = &tstate[i - 1];
-  }
-  tstate[0].cs_next = &tstate[MAX_SLOTS - 1];
-  tstate[0].cs_id = 0;
-  comp->last_cs = &tstate[0];
+  vj_compress_slots(comp, comp->maxSlotIndex);
   comp->last_recv = 255;
-  comp->last_xmit = 255;
   comp->flags = VJF_TOSS;
 }
 
+/*
+ * vj_compress_config - Apply what IPCP negotiated for the peer's
+ * decompressor: whether it accepts compressed slot IDs and the highest
+ * slot it has.  Restarts the transmit side on the usable slots.
+ */
+void
+vj_compress_config(struct vjcompress *comp, u_char compressSlot, u_char maxSlotIndex)
+{
+  comp->compressSlot = compressSlot;
+  comp->maxSlotIndex = LWIP_MIN(maxSlotIndex, MAX_SLOTS - 1);
+  if (comp->maxSlotIndex < 2) {
+    /* the lru logic needs at least 3 states (RFC 1332 allows 1) */
+    comp->maxSlotIndex = 2;
+  }
+  vj_compress_slots(comp, comp->maxSlotIndex);
+}
+
+/*
+ * Move a transmit state to the newest end of the lru ring.
+ */
+static void
+vj_lru_touch(struct vjcompress *comp, struct cstate *cs)
+{
+  struct cstate *lastcs = comp->last_cs;
+
+  if (cs == lastcs) {
+    /* the oldest: rotating the ring makes it the newest */
+    comp->last_cs = cs->cs_prev;
+  } else if (cs != lastcs->cs_next) {
+    cs->cs_prev->cs_next = cs->cs_next;
+    cs->cs_next->cs_prev = cs->cs_prev;
+    cs->cs_next = lastcs->cs_next;
+    cs->cs_prev = lastcs;
+    lastcs->cs_next->cs_prev = cs;
+    lastcs->cs_next = cs;
+  }
+}
+
+/*
+ * Take a transmit state out of its hash bucket.
+ */
+static void
+vj_hash_remove(struct vjcompress *comp, struct cstate *cs)
+{
+  struct cstate **pp;
+
+  if (!cs->cs_hashed) {
+    return;
+  }
+  pp = &comp->hash[VJ_HASH(cs->cs_ip.src.addr, cs->cs_ip.dest.addr,
+                           ((u32_t *)&cs->cs_ip)[IPH_HL(&cs->cs_ip)])];
+  for (; *pp != NULL; pp = &(*pp)->cs_hnext) {
+    if (*pp == cs) {
+      *pp = cs->cs_hnext;
+      break;
+    }
+  }
+  cs->cs_hashed = 0;
+}
+
 
 /* ENCODE encodes a number that is known to be non-zero.  ENCODEZ
  * checks for zero (since zero has to be encoded in the long, 3 byte
@@ -147,6 +232,7 @@ vj_compress_tcp(struct vjcompress *comp, struct pbuf *pb)
   register u_int changes = 0;
   u_char new_seq[16];
   register u_char *cp = new_seq;
+  u_int bucket;
 
   /*  
    * Check that the packet is IP proto TCP.
@@ -163,7 +249,7 @@ vj_compress_tcp(struct vjcompress *comp, struct pbuf *pb)
   if ((IPH_OFFSET(ip) & PP_HTONS(0x3fff)) || pb->tot_len < 40) {
     return (TYPE_IP);
   }
-  th = (struct tcp_hdr *)&((long *)ip)[hlen];
+  th = (struct tcp_hdr *)&((u32_t *)ip)[hlen];
   if ((TCPH_FLAGS(th) & (TCP_SYN|TCP_FIN|TCP_RST|TCP_ACK)) != TCP_ACK) {
     return (TYPE_IP);
   }
@@ -177,64 +263,52 @@ vj_compress_tcp(struct vjcompress *comp, struct pbuf *pb)
   INCR(vjs_packets);
   if (!ip_addr_cmp(&ip->src, &cs->cs_ip.src)
       || !ip_addr_cmp(&ip->dest, &cs->cs_ip.dest)
-      || *(long *)th != ((long *)&cs->cs_ip)[IPH_HL(&cs->cs_ip)]) {
+      || *(u32_t *)th != ((u32_t *)&cs->cs_ip)[IPH_HL(&cs->cs_ip)]) {
     /*
-     * Wasn't the first -- search for it.
-     *
-     * States are kept in a circularly linked list with
-     * last_cs pointing to the end of the list.  The
-     * list is kept in lru order by moving a state to the
-     * head of the list whenever it is referenced.  Since
-     * the list is short and, empirically, the connection
-     * we want is almost always near the front, we locate
-     * states via linear search.  If we don't find a state
+     * Wasn't the first -- look it up in the connection hash (the
+     * original code searched the lru list linearly, which stops
+     * scaling beyond a handful of slots).  If we don't find a state
      * for the datagram, the oldest state is (re-)used.
      */
-    register struct cstate *lcs;
-    register struct cstate *lastcs = comp->last_cs;
-    
-    do {
-      lcs = cs; cs = cs->cs_next;
+    bucket = VJ_HASH(ip->src.addr, ip->dest.addr, *(u32_t *)th);
+    for (cs = comp->hash[bucket]; cs != NULL; cs = cs->cs_hnext) {
       INCR(vjs_searches);
       if (ip_addr_cmp(&ip->src, &cs->cs_ip.src)
           && ip_addr_cmp(&ip->dest, &cs->cs_ip.dest)
-          && *(long *)th == ((long *)&cs->cs_ip)[IPH_HL(&cs->cs_ip)]) {
-        goto found;
+          && *(u32_t *)th == ((u32_t *)&cs->cs_ip)[IPH_HL(&cs->cs_ip)]) {
+        break;
       }
-    } while (cs != lastcs);
+    }
 
-    /*
-     * Didn't find it -- re-use oldest cstate.  Send an
-     * uncompressed packet that tells the other side what
-     * connection number we're using for this conversation.
-     * Note that since the state list is circular, the oldest
-     * state points to the newest and we only need to set
-     * last_cs to update the lru linkage.
-     */
-    INCR(vjs_misses);
-    comp->last_cs = lcs;
-    hlen += TCPH_HDRLEN(th);
-    hlen <<= 2;
-    /* Check that the IP/TCP headers are contained in the first buffer. */
-    if (hlen > pb->len) {
-      return (TYPE_IP);
+    if (cs == NULL) {
+      /*
+       * Didn't find it -- re-use oldest cstate.  Send an
+       * uncompressed packet that tells the other side what
+       * connection number we're using for this conversation.
+       */
+      INCR(vjs_misses);
+      hlen += TCPH_HDRLEN(th);
+      hlen <<= 2;
+      /* Check that the IP/TCP headers are contained in the first buffer. */
+      if (hlen > pb->len) {
+        return (TYPE_IP);
+      }
+      cs = comp->last_cs;
+      vj_hash_remove(comp, cs);
+      vj_lru_touch(comp, cs);
+      cs->cs_hnext = comp->hash[bucket];
+      comp->hash[bucket] = cs;
+      cs->cs_hashed = 1;
+      goto uncompressed;
     }
-    goto uncompressed;
 
-    found:
     /*
      * Found it -- move to the front on the connection list.
      */
-    if (cs == lastcs) {
-      comp->last_cs = lcs;
-    } else {
-      lcs->cs_next = cs->cs_next;
-      cs->cs_next = lastcs->cs_next;
-      lastcs->cs_next = cs;
-    }
+    vj_lru_touch(comp, cs);
   }
 
-  oth = (struct tcp_hdr *)&((long *)&cs->cs_ip)[hlen];
+  oth = (struct tcp_hdr *)&((u32_t *)&cs->cs_ip)[hlen];
   deltaS = hlen;
   hlen += TCPH_HDRLEN(th);
   hlen <<= 2;
@@ -395,6 +469,10 @@ vj_compress_tcp(struct vjcompress *comp, struct pbuf *pb)
   *cp++ = (u_char)deltaA;
   BCOPY(new_seq, cp, deltaS);
   INCR(vjs_compressed);
+#if LINK_STATS
+  comp->stats.vjs_hdrin += hlen + (cp - (u_char *)pb->payload) + deltaS;
+  comp->stats.vjs_hdrout += (cp - (u_char *)pb->payload) + deltaS;
+#endif /* LINK_STATS */
   return (TYPE_COMPRESSED_TCP);
 
   /*
@@ -406,6 +484,10 @@ uncompressed:
   BCOPY(ip, &cs->cs_ip, hlen);
   IPH_PROTO_SET(ip, cs->cs_id);
   comp->last_xmit = cs->cs_id;
+#if LINK_STATS
+  comp->stats.vjs_hdrin += hlen;
+  comp->stats.vjs_hdrout += hlen;
+#endif /* LINK_STATS */
   return (TYPE_UNCOMPRESSED_TCP);
 }
 
@@ -28,9 +28,18 @@
 #include "lwip/ip.h"
 #include "lwip/tcp_impl.h"
 
-#define MAX_SLOTS 16 /* must be > 2 and < 256 */
+#define MAX_SLOTS VJ_MAX_SLOTS /* must be > 2 and <= 256 */
 #define MAX_HDR   128
 
+/* Buckets of the transmit connection hash: a power of two >= MAX_SLOTS */
+#if MAX_SLOTS <= 16
+#define VJ_HASH_SIZE 16
+#elif MAX_SLOTS <= 64
+#define VJ_HASH_SIZE 64
+#else
+#define VJ_HASH_SIZE 256
+#endif
+
 /*
  * Compressed packet format:
  *
@@ -104,9 +113,11 @@
  */
 struct cstate {
   struct cstate *cs_next; /* next most recently used state (xmit only) */
+  struct cstate *cs_prev; /* previous in lru order (xmit only) */
+  struct cstate *cs_hnext; /* next in hash bucket (xmit only) */
   u_short cs_hlen;        /* size of hdr (receive only) */
   u_char cs_id;           /* connection # associated with this state */
-  u_char cs_filler;
+  u_char cs_hashed;       /* in a hash bucket (xmit only) */
   union {
     char csu_hdr[MAX_HDR];
     struct ip_hdr csu_ip;     /* ip/tcp hdr from most recent packet */
@@ -125,13 +136,15 @@ struct vjstat {
   unsigned long vjs_compressedin;   /* inbound compressed packets */
   unsigned long vjs_errorin;        /* inbound unknown type packets */
   unsigned long vjs_tossed;         /* inbound packets tossed because of error */
+  unsigned long vjs_hdrin;          /* outbound TCP/IP header octets before compression */
+  unsigned long vjs_hdrout;         /* ... and after: vjs_hdrout / vjs_hdrin is the ratio */
 };
 
 /*
  * all the state data for one serial line (we need one of these per line).
  */
 struct vjcompress {
-  struct cstate *last_cs;          /* most recently used tstate */
+  struct cstate *last_cs;          /* least recently used tstate */
   u_char last_recv;                /* last rcvd conn. id */
   u_char last_xmit;                /* last sent conn. id */
   u_short flags;
@@ -140,6 +153,7 @@ struct vjcompress {
 #if LINK_STATS
   struct vjstat stats;
 #endif
+  struct cstate *hash[VJ_HASH_SIZE]; /* xmit states by address & ports */
   struct cstate tstate[MAX_SLOTS]; /* xmit connection states */
   struct cstate rstate[MAX_SLOTS]; /* receive connection states */
 };
@@ -148,6 +162,7 @@ struct vjcompress {
 #define VJF_TOSS 1U /* tossing rcvd frames because of input err */
 
 extern void  vj_compress_init    (struct vjcompress *comp);
+extern void  vj_compress_config  (struct vjcompress *comp, u_char compressSlot, u_char maxSlotIndex);
 extern u_int vj_compress_tcp     (struct vjcompress *comp, struct pbuf *pb);
 extern void  vj_uncompress_err   (struct vjcompress *comp);
 extern int   vj_uncompress_uncomp(struct pbuf *nb, struct vjcompress *comp);
@@ -85,6 +85,14 @@
 #define SLIP_SIO_SPEED(sio_fd) 0
 #endif
 
+/** Number of bytes slipif_poll() asks sio_tryread() for at once */
+#ifndef SLIP_POLL_CHUNK
+#define SLIP_POLL_CHUNK 32
+#endif
+
+/* Nonzero if any byte of the word is zero */
+#define SLIP_HASZERO(v) (((v) - 0x01010101UL) & ~(v) & 0x80808080UL)
+
 enum slipif_recv_state {
     SLIP_RECV_NORMAL,
     SLIP_RECV_ESCAPE,
@@ -99,17 +107,98 @@ struct slipif_priv {
 #if SLIP_RX_FROM_ISR
   struct pbuf *rxpackets;
 #endif
+#if SLIP_TX_BUFSIZE
+  u16_t txlen;
+  u8_t txbuf[SLIP_TX_BUFSIZE];
+#endif
 };
 
+/**
+ * Return the number of bytes at s before the next SLIP_END or SLIP_ESC,
+ * looking at a word at a time where possible.
+ */
+static u16_t
+slipif_scan(const u8_t *s, u16_t len)
+{
+  const u8_t *p = s;
+  const u8_t *end = s + len;
+  u32_t v;
+
+  while ((p < end) && ((mem_ptr_t)p & 3)) {
+    if ((*p == SLIP_END) || (*p == SLIP_ESC)) {
+      return (u16_t)(p - s);
+    }
+    p++;
+  }
+  while (end - p >= 4) {
+    v = *(const u32_t *)p;
+    if (SLIP_HASZERO(v ^ 0xC0C0C0C0UL) || SLIP_HASZERO(v ^ 0xDBDBDBDBUL)) {
+      break;
+    }
+    p += 4;
+  }
+  while ((p < end) && (*p != SLIP_END) && (*p != SLIP_ESC)) {
+    p++;
+  }
+  return (u16_t)(p - s);
+}
+
+#if SLIP_TX_BUFSIZE
+/**
+ * Pass the bytes staged by slipif_output() on to the serial layer
+ *
+ * @return ERR_OK, or ERR_IF if sio_write() did not take them all
+ */
+static err_t
+slipif_txflush(struct slipif_priv *priv)
+{
+  u16_t len = priv->txlen;
+
+  priv->txlen = 0;
+  if ((len > 0) && (sio_write(priv->sd, priv->txbuf, len) != len)) {
+    LINK_STATS_INC(link.err);
+    return ERR_IF;
+  }
+  return ERR_OK;
+}
+
+/**
+ * Stage bytes for sending, flushing the buffer whenever it fills
+ */
+static err_t
+slipif_txput(struct slipif_priv *priv, const u8_t *data, u16_t len)
+{
+  err_t err = ERR_OK;
+  u16_t chunk;
+
+  while (len > 0) {
+    chunk = LWIP_MIN(len, SLIP_TX_BUFSIZE - priv->txlen);
+    MEMCPY(priv->txbuf + priv->txlen, data, chunk);
+    priv->txlen += chunk;
+    data += chunk;
+    len -= chunk;
+    if (priv->txlen == SLIP_TX_BUFSIZE) {
+      if (slipif_txflush(priv) != ERR_OK) {
+        err = ERR_IF;
+      }
+    }
+  }
+  return err;
+}
+#endif /* SLIP_TX_BUFSIZE */
+
 /**
  * Send a pbuf doing the necessary SLIP encapsulation
  *
- * Uses the serial layer's sio_send()
+ * Uses the serial layer's sio_send(), or sio_write() if SLIP_TX_BUFSIZE
+ * is set: runs of bytes needing no escape are then block copied into the
+ * staging buffer.
  *
  * @param netif the lwip network interface structure for this slipif
  * @param p the pbuf chaing packet to send
  * @param ipaddr the ip address to send the packet to (not used for slipif)
- * @return always returns ERR_OK since the serial layer does not provide return values
+ * @return ERR_OK, or ERR_IF if sio_write() could not send all bytes
+ *         (sio_send() does not provide return values)
  */
 err_t
 slipif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
@@ -118,6 +207,11 @@ slipif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
   struct pbuf *q;
   u16_t i;
   u8_t c;
+#if SLIP_TX_BUFSIZE
+  u8_t esc[2];
+  u16_t run;
+  err_t err;
+#endif /* SLIP_TX_BUFSIZE */
 
   LWIP_ASSERT("netif != NULL", (netif != NULL));
   LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
@@ -128,6 +222,34 @@ slipif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
   LWIP_DEBUGF(SLIP_DEBUG, ("slipif_output(%"U16_F"): sending %"U16_F" bytes\n", (u16_t)netif->num, p->tot_len));
   priv = netif->state;
 
+#if SLIP_TX_BUFSIZE
+  /* Start with packet delimiter. */
+  esc[0] = SLIP_END;
+  err = slipif_txput(priv, esc, 1);
+  for (q = p; q != NULL; q = q->next) {
+    for (i = 0; i < q->len; i += run) {
+      run = slipif_scan((u8_t *)q->payload + i, q->len - i);
+      if (run == 0) {
+        /* need to escape this byte (0xC0 -> 0xDB, 0xDC or 0xDB -> 0xDB, 0xDD) */
+        c = ((u8_t *)q->payload)[i];
+        esc[0] = SLIP_ESC;
+        esc[1] = (c == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+        run = 1;
+        if (slipif_txput(priv, esc, 2) != ERR_OK) {
+          err = ERR_IF;
+        }
+      } else if (slipif_txput(priv, (u8_t *)q->payload + i, run) != ERR_OK) {
+        err = ERR_IF;
+      }
+    }
+  }
+  /* End with packet delimiter, then send it all. */
+  esc[0] = SLIP_END;
+  if ((slipif_txput(priv, esc, 1) != ERR_OK) || (slipif_txflush(priv) != ERR_OK)) {
+    err = ERR_IF;
+  }
+  return err;
+#else /* SLIP_TX_BUFSIZE */
   /* Send pbuf out on the serial I/O device. */
   /* Start with packet delimiter. */
   sio_send(SLIP_END, priv->sd);
@@ -156,6 +278,68 @@ slipif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
   /* End with packet delimiter. */
   sio_send(SLIP_END, priv->sd);
   return ERR_OK;
+#endif /* SLIP_TX_BUFSIZE */
+}
+
+/**
+ * Append received bytes to the packet being assembled, allocating pbufs
+ * as needed. Bytes beyond SLIP_MAX_SIZE are dropped.
+ *
+ * @param priv the slipif private data
+ * @param data unescaped packet bytes
+ * @param len number of bytes
+ */
+static void
+slipif_rxrun(struct slipif_priv *priv, const u8_t *data, u16_t len)
+{
+  u16_t chunk;
+
+  while (len > 0) {
+    if (priv->p == NULL) {
+      /* allocate a new pbuf */
+      LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: alloc\n"));
+      priv->p = pbuf_alloc(PBUF_LINK, (PBUF_POOL_BUFSIZE - PBUF_LINK_HLEN), PBUF_POOL);
+
+      if (priv->p == NULL) {
+        LINK_STATS_INC(link.drop);
+        LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: no new pbuf! (DROP)\n"));
+        /* don't process any further since we got no pbuf to receive to */
+        return;
+      }
+
+      if (priv->q != NULL) {
+        /* 'chain' the pbuf to the existing chain */
+        pbuf_cat(priv->q, priv->p);
+      } else {
+        /* p is the first pbuf in the chain */
+        priv->q = priv->p;
+      }
+    }
+
+    /* this automatically drops bytes if > SLIP_MAX_SIZE */
+    if (priv->recved > SLIP_MAX_SIZE) {
+      return;
+    }
+    chunk = LWIP_MIN(len, priv->p->len - priv->i);
+    chunk = LWIP_MIN(chunk, SLIP_MAX_SIZE + 1 - priv->recved);
+    MEMCPY((u8_t *)priv->p->payload + priv->i, data, chunk);
+    priv->recved += chunk;
+    priv->i += chunk;
+    data += chunk;
+    len -= chunk;
+    if (priv->i >= priv->p->len) {
+      /* on to the next pbuf */
+      priv->i = 0;
+      if (priv->p->next != NULL && priv->p->next->len > 0) {
+        /* p is a chain, on to the next in the chain */
+          priv->p = priv->p->next;
+      } else {
+        /* p is a single pbuf, set it to NULL so next time a new
+         * pbuf is allocated */
+          priv->p = NULL;
+      }
+    }
+  }
 }
 
 /**
@@ -216,48 +400,48 @@ slipif_rxbyte(struct netif *netif, u8_t c)
   } /* end switch (priv->state) */
 
   /* byte received, packet not yet completely received */
-  if (priv->p == NULL) {
-    /* allocate a new pbuf */
-    LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: alloc\n"));
-    priv->p = pbuf_alloc(PBUF_LINK, (PBUF_POOL_BUFSIZE - PBUF_LINK_HLEN), PBUF_POOL);
-
-    if (priv->p == NULL) {
-      LINK_STATS_INC(link.drop);
-      LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: no new pbuf! (DROP)\n"));
-      /* don't process any further since we got no pbuf to receive to */
-      return NULL;
-    }
-
-    if (priv->q != NULL) {
-      /* 'chain' the pbuf to the existing chain */
-      pbuf_cat(priv->q, priv->p);
-    } else {
-      /* p is the first pbuf in the chain */
-      priv->q = priv->p;
-    }
-  }
+  slipif_rxrun(priv, &c, 1);
+  return NULL;
+}
 
-  /* this automatically drops bytes if > SLIP_MAX_SIZE */
-  if ((priv->p != NULL) && (priv->recved <= SLIP_MAX_SIZE)) {
-    ((u8_t *)priv->p->payload)[priv->i] = c;
-    priv->recved++;
-    priv->i++;
-    if (priv->i >= priv->p->len) {
-      /* on to the next pbuf */
-      priv->i = 0;
-      if (priv->p->next != NULL && priv->p->next->len > 0) {
-        /* p is a chain, on to the next in the chain */
-          priv->p = priv->p->next;
-      } else {
-        /* p is a single pbuf, set it to NULL so next time a new
-         * pbuf is allocated */
-          priv->p = NULL;
+/**
+ * Handle a block of the incoming SLIP stream: runs of bytes needing no
+ * unescaping are copied into the packet in bulk, the others go through
+ * slipif_rxbyte().
+ *
+ * @param netif the lwip network interface structure for this slipif
+ * @param data received bytes
+ * @param len in: number of received bytes; out: number of bytes consumed
+ *        if a packet is returned
+ * @return The IP packet when SLIP_END is received, NULL if all bytes were
+ *         consumed without completing a packet
+ */
+static struct pbuf*
+slipif_rxblock(struct netif *netif, const u8_t *data, u16_t *len)
+{
+  struct slipif_priv *priv = (struct slipif_priv *)netif->state;
+  struct pbuf *p;
+  u16_t i, run;
+
+  for (i = 0; i < *len; ) {
+    if (priv->state == SLIP_RECV_NORMAL) {
+      run = slipif_scan(data + i, *len - i);
+      if (run > 0) {
+        slipif_rxrun(priv, data + i, run);
+        i += run;
+        continue;
       }
     }
+    p = slipif_rxbyte(netif, data[i++]);
+    if (p != NULL) {
+      *len = i;
+      return p;
+    }
   }
   return NULL;
 }
 
+#if SLIP_USE_RX_THREAD
 /** Like slipif_rxbyte, but passes completed packets to netif->input
  *
  * @param netif The lwip network interface structure for this slipif
@@ -274,6 +458,32 @@ slipif_rxbyte_input(struct netif *netif, u8_t c)
     }
   }
 }
+#endif /* SLIP_USE_RX_THREAD */
+
+/** Like slipif_rxblock, but passes completed packets to netif->input
+ *
+ * @param netif The lwip network interface structure for this slipif
+ * @param data received bytes
+ * @param len number of received bytes
+ */
+static void
+slipif_rxblock_input(struct netif *netif, const u8_t *data, u16_t len)
+{
+  struct pbuf *p;
+  u16_t n;
+
+  while (len > 0) {
+    n = len;
+    p = slipif_rxblock(netif, data, &n);
+    if (p != NULL) {
+      if (netif->input(p, netif) != ERR_OK) {
+        pbuf_free(p);
+      }
+    }
+    data += n;
+    len -= n;
+  }
+}
 
 #if SLIP_USE_RX_THREAD
 /**
@@ -357,6 +567,9 @@ slipif_init(struct netif *netif)
 #if SLIP_RX_FROM_ISR
   priv->rxpackets = NULL;
 #endif
+#if SLIP_TX_BUFSIZE
+  priv->txlen = 0;
+#endif
 
   netif->state = priv;
 
@@ -379,7 +592,8 @@ slipif_init(struct netif *netif)
 void
 slipif_poll(struct netif *netif)
 {
-  u8_t c;
+  u8_t buf[SLIP_POLL_CHUNK];
+  u32_t len;
   struct slipif_priv *priv;
 
   LWIP_ASSERT("netif != NULL", (netif != NULL));
@@ -387,8 +601,8 @@ slipif_poll(struct netif *netif)
 
   priv = (struct slipif_priv *)netif->state;
 
-  while (sio_tryread(priv->sd, &c, 1) > 0) {
-    slipif_rxbyte_input(netif, c);
+  while ((len = sio_tryread(priv->sd, buf, sizeof(buf))) > 0) {
+    slipif_rxblock_input(netif, buf, (u16_t)len);
   }
 }
 
@@ -431,25 +645,23 @@ slipif_process_rxqueue(struct netif *netif)
   }
 }
 
-/** Like slipif_rxbyte, but queues completed packets.
+/** Queues a completed packet for slipif_process_rxqueue().
  *
  * @param netif The lwip network interface structure for this slipif
- * @param data Received serial byte
+ * @param p Received packet (may be NULL)
  */
 static void
-slipif_rxbyte_enqueue(struct netif *netif, u8_t data)
+slipif_rxpacket_enqueue(struct netif *netif, struct pbuf *p)
 {
-  struct pbuf *p;
   struct slipif_priv *priv = (struct slipif_priv *)netif->state;
   SYS_ARCH_DECL_PROTECT(old_level);
 
-  p = slipif_rxbyte(netif, data);
   if (p != NULL) {
     SYS_ARCH_PROTECT(old_level);
     if (priv->rxpackets != NULL) {
 #if SLIP_RX_QUEUE
-      /* queue multiple pbufs */
-      struct pbuf *q = p;
+      /* queue multiple pbufs behind the last queued one */
+      struct pbuf *q = priv->rxpackets;
       while(q->next != NULL) {
         q = q->next;
       }
@@ -480,7 +692,7 @@ slipif_received_byte(struct netif *netif, u8_t data)
 {
   LWIP_ASSERT("netif != NULL", (netif != NULL));
   LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
-  slipif_rxbyte_enqueue(netif, data);
+  slipif_rxpacket_enqueue(netif, slipif_rxbyte(netif, data));
 }
 
 /**
@@ -488,21 +700,27 @@ slipif_received_byte(struct netif *netif, u8_t data)
  * fed into IP through slipif_process_rxqueue().
  *
  * This function can be called from ISR if SYS_LIGHTWEIGHT_PROT is enabled.
+ * Blocks of any size can be passed, e.g. a UART DMA circular buffer up to
+ * its current write position.
  *
  * @param netif The lwip network interface structure for this slipif
  * @param data received character
  * @param len Number of received characters
  */
 void
-slipif_received_bytes(struct netif *netif, u8_t *data, u8_t len)
+slipif_received_bytes(struct netif *netif, u8_t *data, u16_t len)
 {
-  u8_t i;
-  u8_t *rxdata = data;
+  struct pbuf *p;
+  u16_t n;
   LWIP_ASSERT("netif != NULL", (netif != NULL));
   LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
 
-  for (i = 0; i < len; i++, rxdata++) {
-    slipif_rxbyte_enqueue(netif, *rxdata);
+  while (len > 0) {
+    n = len;
+    p = slipif_rxblock(netif, data, &n);
+    slipif_rxpacket_enqueue(netif, p);
+    data += n;
+    len -= n;
   }
 }
 #endif /* SLIP_RX_FROM_ISR */
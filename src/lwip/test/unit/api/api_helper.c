@@ -0,0 +1,125 @@
+#include "api_helper.h"
+
+#include "lwip/tcpip.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/sockets.h"
+
+#include <string.h>
+
+#if !defined(TCPIP_THREAD_TEST)
+#error "This tests needs TCPIP_THREAD_TEST"
+#endif
+
+/** Everything the netif sends comes back in through tcpip_thread,
+ * packets to other hosts are lost there */
+static err_t
+test_api_netif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  struct pbuf *q;
+  LWIP_UNUSED_ARG(ipaddr);
+
+  q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+  EXPECT_RETX(q != NULL, ERR_MEM);
+  pbuf_copy(q, p);
+  if (tcpip_input(q, netif) != ERR_OK) {
+    pbuf_free(q);
+    return ERR_MEM;
+  }
+  return ERR_OK;
+}
+
+static err_t
+test_api_netif_init(struct netif *netif)
+{
+  netif->output = test_api_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_UP | NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/** A blocking call waits for tcpip_thread: run its messages meanwhile */
+int
+test_api_wait(sys_sem_t *sem, sys_mbox_t *mbox)
+{
+  LWIP_UNUSED_ARG(sem);
+  LWIP_UNUSED_ARG(mbox);
+  return tcpip_thread_poll_one();
+}
+
+/** Let tcpip_thread work until there is nothing left, delayed ACKs included */
+void
+test_api_run(void)
+{
+  do {
+    while (tcpip_thread_poll_one() != 0) {
+    }
+    tcp_fasttmr();
+  } while (tcpip_thread_poll_one() != 0);
+}
+
+/** Add a netif that loops its output back and let blocking calls run
+ * tcpip_thread's messages (call from the suite's setup) */
+void
+test_api_add_netif(struct netif *netif, ip_addr_t *ip_addr,
+                   ip_addr_t *netmask, ip_addr_t *gw)
+{
+  fail_unless(netif_add(netif, ip_addr, netmask, gw,
+    NULL, test_api_netif_init, tcpip_input) != NULL);
+  netif_set_up(netif);
+  test_sys_arch_wait_callback(test_api_wait);
+}
+
+/** Undo test_api_add_netif() after running what is left (call from the
+ * suite's teardown) */
+void
+test_api_remove_netif(struct netif *netif)
+{
+  test_api_run();
+  test_sys_arch_wait_callback(NULL);
+  netif_remove(netif);
+}
+
+#if LWIP_NETCONN
+/** Open a TCP connection to ourselves */
+void
+test_api_connect_netconns(ip_addr_t *ip_addr, u16_t port,
+                          struct netconn **client, struct netconn **server)
+{
+  struct netconn *l;
+
+  l = netconn_new(NETCONN_TCP);
+  EXPECT_RET(l != NULL);
+  EXPECT(netconn_bind(l, ip_addr, port) == ERR_OK);
+  EXPECT(netconn_listen(l) == ERR_OK);
+  *client = netconn_new(NETCONN_TCP);
+  EXPECT_RET(*client != NULL);
+  EXPECT(netconn_connect(*client, ip_addr, port) == ERR_OK);
+  EXPECT(netconn_accept(l, server) == ERR_OK);
+  EXPECT(netconn_delete(l) == ERR_OK);
+}
+#endif /* LWIP_NETCONN */
+
+#if LWIP_SOCKET
+/** Open a TCP connection to ourselves */
+void
+test_api_connect_sockets(ip_addr_t *ip_addr, u16_t port, int *client, int *server)
+{
+  struct sockaddr_in addr;
+  int l;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = ip_addr->addr;
+  l = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  EXPECT_RET(l >= 0);
+  EXPECT(lwip_bind(l, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  EXPECT(lwip_listen(l, 1) == 0);
+  *client = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  EXPECT_RET(*client >= 0);
+  EXPECT(lwip_connect(*client, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  *server = lwip_accept(l, NULL, NULL);
+  EXPECT(*server >= 0);
+  EXPECT(lwip_close(l) == 0);
+}
+#endif /* LWIP_SOCKET */
@@ -0,0 +1,27 @@
+#ifndef __API_HELPER_H__
+#define __API_HELPER_H__
+
+#include "../lwip_check.h"
+#include "lwip/arch.h"
+#include "lwip/api.h"
+#include "lwip/netif.h"
+
+/* Helper functions for the API layer tests: these run without threads on
+ * the sys_arch in arch/sys_arch.c, tcpip_thread's messages are processed
+ * by tcpip_thread_poll_one() */
+int test_api_wait(sys_sem_t *sem, sys_mbox_t *mbox);
+void test_api_run(void);
+
+void test_api_add_netif(struct netif *netif, ip_addr_t *ip_addr,
+                        ip_addr_t *netmask, ip_addr_t *gw);
+void test_api_remove_netif(struct netif *netif);
+
+#if LWIP_NETCONN
+void test_api_connect_netconns(ip_addr_t *ip_addr, u16_t port,
+                               struct netconn **client, struct netconn **server);
+#endif /* LWIP_NETCONN */
+#if LWIP_SOCKET
+void test_api_connect_sockets(ip_addr_t *ip_addr, u16_t port, int *client, int *server);
+#endif /* LWIP_SOCKET */
+
+#endif
@@ -0,0 +1,257 @@
+#include "test_netconn.h"
+#include "api_helper.h"
+
+#include "lwip/api.h"
+#include "lwip/tcpip.h"
+#include "lwip/tcp_impl.h"
+
+#include <string.h>
+
+#if !LWIP_NETCONN || !defined(TCPIP_THREAD_TEST)
+#error "This tests needs LWIP_NETCONN and TCPIP_THREAD_TEST"
+#endif
+
+/* LWIP_NETCONN_ASYNC is off when building with LWIP_TCPIP_CORE_LOCKING:
+   there is nothing to test then (lwip_unittests.c leaves the suite out) */
+#if LWIP_NETCONN_ASYNC
+
+#define TEST_NETCONN_PORT   4092
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw;
+
+/* async operations completed, in order */
+static struct netconn_async *done[4];
+static int done_ctr;
+
+/* Helper functions */
+
+static void
+test_netconn_done(struct netconn_async *op, void *arg)
+{
+  EXPECT(arg == &done_ctr);
+  EXPECT_RET(done_ctr < (int)(sizeof(done) / sizeof(done[0])));
+  done[done_ctr++] = op;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+netconn_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192, 168, 1, 20);
+  IP4_ADDR(&test_netmask, 255, 255, 255, 0);
+  IP4_ADDR(&test_gw, 192, 168, 1, 1);
+  test_api_add_netif(&test_netif, &test_ipaddr, &test_netmask, &test_gw);
+  done_ctr = 0;
+}
+
+static void
+netconn_teardown(void)
+{
+  test_api_remove_netif(&test_netif);
+}
+
+
+/* Test functions */
+
+/** Deleting a netconn completes its pending connect with ERR_ABRT */
+START_TEST(test_netconn_delete_connecting)
+{
+  struct netconn *conn;
+  struct netconn_async op;
+  ip_addr_t addr;
+  LWIP_UNUSED_ARG(_i);
+
+  /* nobody answers the SYN */
+  IP4_ADDR(&addr, 192, 168, 1, 77);
+  conn = netconn_new(NETCONN_TCP);
+  EXPECT_RET(conn != NULL);
+  netconn_async_init(&op, test_netconn_done, &done_ctr);
+  EXPECT(netconn_connect_async(conn, &addr, TEST_NETCONN_PORT, &op) == ERR_OK);
+  test_api_run();
+  EXPECT(netconn_async_poll(&op) == ERR_INPROGRESS);
+  EXPECT(done_ctr == 0);
+
+  EXPECT(netconn_delete(conn) == ERR_OK);
+  EXPECT(done_ctr == 1);
+  EXPECT(done[0] == &op);
+  EXPECT(netconn_async_poll(&op) == ERR_ABRT);
+  EXPECT(tcp_active_pcbs == NULL);
+}
+END_TEST
+
+/** Deleting a netconn completes its pending write and receive with ERR_ABRT,
+ * the data already enqueued is still sent */
+START_TEST(test_netconn_delete_writing)
+{
+  static u8_t data[2 * TCP_SND_BUF];
+  struct netconn *c = NULL, *s;
+  struct netconn_async wr, rd;
+  struct netbuf *buf;
+  u16_t len;
+  u32_t rxed = 0;
+  LWIP_UNUSED_ARG(_i);
+
+  test_api_connect_netconns(&test_ipaddr, TEST_NETCONN_PORT, &c, &s);
+  netconn_async_init(&rd, test_netconn_done, &done_ctr);
+  EXPECT(netconn_recv_async(c, &rd) == ERR_OK);
+  test_api_run();
+  EXPECT(netconn_async_poll(&rd) == ERR_INPROGRESS);
+
+  /* started right before the delete: too much to be enqueued at once */
+  netconn_async_init(&wr, test_netconn_done, &done_ctr);
+  EXPECT(netconn_write_async(c, data, sizeof(data), NETCONN_COPY, &wr) == ERR_OK);
+  EXPECT(netconn_delete(c) == ERR_OK);
+  EXPECT(done_ctr == 2);
+  EXPECT((done[0] == &wr) && (done[1] == &rd));
+  EXPECT(netconn_async_poll(&wr) == ERR_ABRT);
+  EXPECT(netconn_async_poll(&rd) == ERR_ABRT);
+  EXPECT(rd.buf == NULL);
+
+  while (netconn_recv(s, &buf) == ERR_OK) {
+    do {
+      void *dataptr;
+      netbuf_data(buf, &dataptr, &len);
+      rxed += len;
+    } while (netbuf_next(buf) >= 0);
+    netbuf_delete(buf);
+  }
+  EXPECT((rxed > 0) && (rxed < sizeof(data)));
+  EXPECT(netconn_delete(s) == ERR_OK);
+}
+END_TEST
+
+/** A connect completes with ERR_OK once the connection is established */
+START_TEST(test_netconn_async_connect)
+{
+  struct netconn *l, *c, *s;
+  struct netconn_async op;
+  LWIP_UNUSED_ARG(_i);
+
+  l = netconn_new(NETCONN_TCP);
+  EXPECT_RET(l != NULL);
+  EXPECT(netconn_bind(l, &test_ipaddr, TEST_NETCONN_PORT) == ERR_OK);
+  EXPECT(netconn_listen(l) == ERR_OK);
+  c = netconn_new(NETCONN_TCP);
+  EXPECT_RET(c != NULL);
+
+  netconn_async_init(&op, test_netconn_done, &done_ctr);
+  EXPECT(netconn_connect_async(c, &test_ipaddr, TEST_NETCONN_PORT, &op) == ERR_OK);
+  /* nothing happens before tcpip_thread runs */
+  EXPECT(netconn_async_poll(&op) == ERR_INPROGRESS);
+  EXPECT(!netconn_async_done(&op));
+  EXPECT(done_ctr == 0);
+
+  test_api_run();
+  EXPECT(done_ctr == 1);
+  EXPECT(done[0] == &op);
+  EXPECT(netconn_async_done(&op));
+  EXPECT(netconn_async_poll(&op) == ERR_OK);
+
+  EXPECT(netconn_accept(l, &s) == ERR_OK);
+  EXPECT(netconn_delete(l) == ERR_OK);
+  EXPECT(netconn_delete(c) == ERR_OK);
+  EXPECT(netconn_delete(s) == ERR_OK);
+}
+END_TEST
+
+/** A write completes with ERR_OK when all data is enqueued, a receive
+ * with ERR_OK and the data */
+START_TEST(test_netconn_async_write_recv)
+{
+  static u8_t data[2000], rx[2000];
+  struct netconn *c, *s;
+  struct netconn_async wr, rd;
+  struct pbuf *p;
+  u32_t rxed = 0;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(data); i++) {
+    data[i] = (u8_t)(i * 13);
+  }
+  test_api_connect_netconns(&test_ipaddr, TEST_NETCONN_PORT, &c, &s);
+
+  /* the receive is waiting before the data is sent */
+  netconn_async_init(&rd, test_netconn_done, &done_ctr);
+  EXPECT(netconn_recv_async(s, &rd) == ERR_OK);
+  netconn_async_init(&wr, test_netconn_done, &done_ctr);
+  EXPECT(netconn_write_async(c, data, sizeof(data), NETCONN_COPY, &wr) == ERR_OK);
+  EXPECT(netconn_async_poll(&wr) == ERR_INPROGRESS);
+  EXPECT(netconn_async_poll(&rd) == ERR_INPROGRESS);
+
+  /* the write is done when enqueued, before the data arrives */
+  test_api_run();
+  EXPECT(done_ctr == 2);
+  EXPECT((done[0] == &wr) && (done[1] == &rd));
+  EXPECT(netconn_async_poll(&wr) == ERR_OK);
+  EXPECT(netconn_async_written(&wr) == sizeof(data));
+
+  /* the rest is already queued: each further receive completes at once */
+  while (netconn_async_poll(&rd) == ERR_OK) {
+    p = (struct pbuf *)rd.buf;
+    EXPECT_RET(p != NULL);
+    EXPECT_RET(rxed + p->tot_len <= sizeof(rx));
+    pbuf_copy_partial(p, rx + rxed, p->tot_len, 0);
+    rxed += p->tot_len;
+    pbuf_free(p);
+    if (rxed == sizeof(data)) {
+      break;
+    }
+    done_ctr = 0;
+    EXPECT(netconn_recv_async(s, &rd) == ERR_OK);
+    test_api_run();
+    EXPECT((done_ctr == 1) && (done[0] == &rd));
+  }
+  EXPECT(rxed == sizeof(data));
+  EXPECT(memcmp(rx, data, sizeof(data)) == 0);
+
+  EXPECT(netconn_delete(c) == ERR_OK);
+  EXPECT(netconn_delete(s) == ERR_OK);
+}
+END_TEST
+
+/** A close completes with ERR_OK, the remote side then receives ERR_CLSD */
+START_TEST(test_netconn_async_close)
+{
+  struct netconn *c, *s;
+  struct netconn_async cl, rd;
+  LWIP_UNUSED_ARG(_i);
+
+  test_api_connect_netconns(&test_ipaddr, TEST_NETCONN_PORT, &c, &s);
+  netconn_async_init(&rd, test_netconn_done, &done_ctr);
+  EXPECT(netconn_recv_async(s, &rd) == ERR_OK);
+  netconn_async_init(&cl, test_netconn_done, &done_ctr);
+  EXPECT(netconn_close_async(c, &cl) == ERR_OK);
+  EXPECT(netconn_async_poll(&cl) == ERR_INPROGRESS);
+
+  test_api_run();
+  EXPECT(done_ctr == 2);
+  EXPECT((done[0] == &cl) && (done[1] == &rd));
+  EXPECT(netconn_async_poll(&cl) == ERR_OK);
+  EXPECT(netconn_async_poll(&rd) == ERR_CLSD);
+  EXPECT(rd.buf == NULL);
+
+  EXPECT(netconn_delete(c) == ERR_OK);
+  EXPECT(netconn_delete(s) == ERR_OK);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+netconn_suite(void)
+{
+  TFun tests[] = {
+    test_netconn_delete_connecting,
+    test_netconn_delete_writing,
+    test_netconn_async_connect,
+    test_netconn_async_write_recv,
+    test_netconn_async_close
+  };
+  return create_suite("NETCONN", tests, sizeof(tests)/sizeof(TFun), netconn_setup, netconn_teardown);
+}
+
+#endif /* LWIP_NETCONN_ASYNC */
@@ -0,0 +1,8 @@
+#ifndef __TEST_NETCONN_H__
+#define __TEST_NETCONN_H__
+
+#include "../lwip_check.h"
+
+Suite *netconn_suite(void);
+
+#endif
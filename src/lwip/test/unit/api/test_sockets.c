@@ -0,0 +1,556 @@
+#include "test_sockets.h"
+#include "api_helper.h"
+
+#include "lwip/sockets.h"
+#include "lwip/tcpip.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/netif.h"
+#include "lwip/ip.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_SOCKET || !LWIP_SOCKET_ZEROCOPY || !LWIP_SOCKET_POLL || !LWIP_SOCKET_EPOLL || !defined(TCPIP_THREAD_TEST)
+#error "This tests needs LWIP_SOCKET, LWIP_SOCKET_ZEROCOPY, LWIP_SOCKET_POLL, LWIP_SOCKET_EPOLL and TCPIP_THREAD_TEST"
+#endif
+
+#define TEST_SOCKETS_PORT   4090
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw;
+
+/* zero-copy sends reported as done */
+static struct {
+  const void *dataptr;
+  size_t size;
+  int err;
+} zc_sent[8];
+static int zc_sent_ctr;
+/* zero-copy sends done in test_sockets_transfer() */
+static int zc_done_ctr;
+
+/* Helper functions */
+
+/** The error of the last call on socket s */
+static int
+test_sockets_err(int s)
+{
+  int err = -1;
+  socklen_t len = sizeof(err);
+
+  EXPECT(lwip_getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len) == 0);
+  return err;
+}
+
+/** The pcb behind a connected TCP socket */
+static struct tcp_pcb *
+test_sockets_pcb(int s)
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  struct tcp_pcb *pcb;
+
+  EXPECT_RETNULL(lwip_getsockname(s, (struct sockaddr *)&addr, &len) == 0);
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    if ((pcb->local_port == ntohs(addr.sin_port)) && (pcb->state == ESTABLISHED)) {
+      return pcb;
+    }
+  }
+  return NULL;
+}
+
+static void
+test_sockets_zc_sent(int s, const void *dataptr, size_t size, int err, void *arg)
+{
+  LWIP_UNUSED_ARG(s);
+  LWIP_UNUSED_ARG(arg);
+  EXPECT_RET(zc_sent_ctr < (int)(sizeof(zc_sent) / sizeof(zc_sent[0])));
+  zc_sent[zc_sent_ctr].dataptr = dataptr;
+  zc_sent[zc_sent_ctr].size = size;
+  zc_sent[zc_sent_ctr].err = err;
+  zc_sent_ctr++;
+}
+
+static void
+test_sockets_zc_done(int s, const void *dataptr, size_t size, int err, void *arg)
+{
+  LWIP_UNUSED_ARG(s);
+  LWIP_UNUSED_ARG(dataptr);
+  LWIP_UNUSED_ARG(size);
+  LWIP_UNUSED_ARG(arg);
+  EXPECT(err == 0);
+  zc_done_ctr++;
+}
+
+/** Move 'total' bytes in messages of 'size' bytes from socket c to socket s,
+ * with lwip_send()/lwip_recv() or, if 'zc' is set, lwip_send_zc()/
+ * lwip_recv_zc() (the data is released right away)
+ * @return the CPU time taken (s) */
+static double
+test_sockets_transfer(int c, int s, const u8_t *data, u8_t *buf, int size, long total, int zc)
+{
+  clock_t start = clock();
+  struct pbuf *p;
+  long moved;
+  int got, n;
+
+  zc_done_ctr = 0;
+  for (moved = 0; moved < total; moved += size) {
+    if (zc) {
+      n = lwip_send_zc(c, data, size, 0, test_sockets_zc_done, NULL);
+    } else {
+      n = lwip_send(c, data, size, 0);
+    }
+    EXPECT_RETX(n == size, 0);
+    test_api_run();
+    for (got = 0; got < size; got += n) {
+      if (zc) {
+        n = lwip_recv_zc(s, &p, 0);
+        EXPECT_RETX(n > 0, 0);
+        EXPECT(lwip_recv_zc_release(s, p) == 0);
+      } else {
+        n = lwip_recv(s, buf, size - got, 0);
+        EXPECT_RETX(n > 0, 0);
+      }
+    }
+  }
+  test_api_run();
+  if (zc) {
+    EXPECT(zc_done_ctr == (total + size - 1) / size);
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+sockets_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192, 168, 1, 18);
+  IP4_ADDR(&test_netmask, 255, 255, 255, 0);
+  IP4_ADDR(&test_gw, 192, 168, 1, 1);
+  test_api_add_netif(&test_netif, &test_ipaddr, &test_netmask, &test_gw);
+  zc_sent_ctr = 0;
+}
+
+static void
+sockets_teardown(void)
+{
+  test_api_remove_netif(&test_netif);
+}
+
+
+/* Test functions */
+
+/** Sent data stays lent until its ACK arrives (and the socket can't be
+ * closed before), received data keeps the window closed until released */
+START_TEST(test_sockets_zc_lend)
+{
+  static u8_t data[3000];
+  u8_t buf[10];
+  struct pbuf *p[20];
+  struct tcp_pcb *pcb;
+  int c, s, i, n, got;
+  u32_t wnd;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(data); i++) {
+    data[i] = (u8_t)(i * 7);
+  }
+  test_api_connect_sockets(&test_ipaddr, TEST_SOCKETS_PORT, &c, &s);
+
+  /* the ACK is still in the mailbox when this returns */
+  EXPECT(lwip_send_zc(c, data, 1000, 0, test_sockets_zc_sent, NULL) == 1000);
+  EXPECT(zc_sent_ctr == 0);
+  EXPECT(lwip_close(c) == -1);
+  EXPECT(test_sockets_err(c) == EBUSY);
+  EXPECT(lwip_send_zc(c, data + 1000, 2000, 0, test_sockets_zc_sent, NULL) == 2000);
+
+  test_api_run();
+  EXPECT(zc_sent_ctr == 2);
+  EXPECT((zc_sent[0].dataptr == data) && (zc_sent[0].size == 1000) && (zc_sent[0].err == 0));
+  EXPECT((zc_sent[1].dataptr == data + 1000) && (zc_sent[1].size == 2000) && (zc_sent[1].err == 0));
+
+  /* lwip_recv() takes the start of a pbuf, lwip_recv_zc() lends the rest */
+  pcb = test_sockets_pcb(s);
+  EXPECT_RET(pcb != NULL);
+  EXPECT(pcb->rcv_wnd == TCP_WND - sizeof(data));
+  EXPECT(lwip_recv(s, buf, sizeof(buf), 0) == sizeof(buf));
+  EXPECT(memcmp(buf, data, sizeof(buf)) == 0);
+  EXPECT(pcb->rcv_wnd == TCP_WND - sizeof(data) + sizeof(buf));
+  got = sizeof(buf);
+  for (i = 0; got < (int)sizeof(data); i++) {
+    EXPECT_RET(i < (int)(sizeof(p) / sizeof(p[0])));
+    n = lwip_recv_zc(s, &p[i], 0);
+    EXPECT_RET((n > 0) && (p[i]->tot_len == n));
+    EXPECT(pbuf_memcmp(p[i], 0, data + got, (u16_t)n) == 0);
+    got += n;
+  }
+  EXPECT(got == sizeof(data));
+  EXPECT(lwip_recv_zc(s, &p[i], MSG_DONTWAIT) == -1);
+  EXPECT(test_sockets_err(s) == EWOULDBLOCK);
+  /* lent data does not count as read */
+  EXPECT(pcb->rcv_wnd == TCP_WND - sizeof(data) + sizeof(buf));
+  wnd = pcb->rcv_wnd;
+  for (n = 0; n < i; n++) {
+    wnd += p[n]->tot_len;
+    EXPECT(lwip_recv_zc_release(s, p[n]) == 0);
+    EXPECT(pcb->rcv_wnd == wnd);
+  }
+  EXPECT(pcb->rcv_wnd == TCP_WND);
+
+  EXPECT(lwip_close(c) == 0);
+  EXPECT(lwip_close(s) == 0);
+}
+END_TEST
+
+/** Sends still referenced when the connection dies are handed back with
+ * the error, and no more than LWIP_SOCKET_ZEROCOPY_PENDING are accepted */
+START_TEST(test_sockets_zc_abort)
+{
+  static u8_t data[LWIP_SOCKET_ZEROCOPY_PENDING + 1][100];
+  struct tcp_pcb *pcb;
+  int c, s, i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_api_connect_sockets(&test_ipaddr, TEST_SOCKETS_PORT, &c, &s);
+  pcb = test_sockets_pcb(c);
+  EXPECT_RET(pcb != NULL);
+
+  for (i = 0; i < LWIP_SOCKET_ZEROCOPY_PENDING; i++) {
+    EXPECT(lwip_send_zc(c, data[i], sizeof(data[i]), 0, test_sockets_zc_sent, NULL) == sizeof(data[i]));
+  }
+  EXPECT(lwip_send_zc(c, data[i], sizeof(data[i]), 0, test_sockets_zc_sent, NULL) == -1);
+  EXPECT(test_sockets_err(c) == ENOBUFS);
+  EXPECT(zc_sent_ctr == 0);
+
+  /* in tcpip_thread: nothing else runs in between */
+  tcp_abort(pcb);
+  EXPECT(zc_sent_ctr == LWIP_SOCKET_ZEROCOPY_PENDING);
+  for (i = 0; i < zc_sent_ctr; i++) {
+    EXPECT(zc_sent[i].dataptr == data[i]);
+    EXPECT(zc_sent[i].size == sizeof(data[i]));
+    EXPECT(zc_sent[i].err == ECONNABORTED);
+  }
+  EXPECT(lwip_close(c) == 0);
+  test_api_run();
+  EXPECT(lwip_close(s) == 0);
+}
+END_TEST
+
+/** Registrations are added, changed and removed, the ready queue reports
+ * sockets in the order they became ready and rotates level-triggered ones */
+START_TEST(test_sockets_epoll)
+{
+  struct lwip_epoll_event ev, events[4];
+  struct tcp_pcb *pcb;
+  u8_t buf[10];
+  int ep, c, s;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(buf, 0, sizeof(buf));
+  test_api_connect_sockets(&test_ipaddr, TEST_SOCKETS_PORT, &c, &s);
+  ep = lwip_epoll_create();
+  EXPECT_RET(ep >= 0);
+
+  ev.events = LWIP_EPOLLIN;
+  ev.data.fd = s;
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_ADD, s, &ev) == 0);
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_ADD, s, &ev) == -1);
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_MOD, c, &ev) == -1);
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_DEL, c, NULL) == -1);
+  ev.events = LWIP_EPOLLOUT | LWIP_EPOLLET;
+  ev.data.fd = c;
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_ADD, c, &ev) == 0);
+
+  /* edge-triggered: a connected socket is writable once */
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == 1);
+  EXPECT((events[0].data.fd == c) && (events[0].events == LWIP_EPOLLOUT));
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == 0);
+
+  /* the data is still on its way when the wait starts */
+  ev.events = LWIP_EPOLLIN;
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_MOD, c, &ev) == 0);
+  EXPECT(lwip_send(c, buf, sizeof(buf), 0) == sizeof(buf));
+  EXPECT(lwip_epoll_wait(ep, events, 4, 100) == 1);
+  EXPECT((events[0].data.fd == s) && (events[0].events == LWIP_EPOLLIN));
+  EXPECT(lwip_send(s, buf, sizeof(buf), 0) == sizeof(buf));
+  test_api_run();
+
+  /* level-triggered: both stay ready and take turns */
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == 2);
+  EXPECT((events[0].data.fd == s) && (events[1].data.fd == c));
+  EXPECT(lwip_epoll_wait(ep, events, 1, 0) == 1);
+  EXPECT(events[0].data.fd == s);
+  EXPECT(lwip_epoll_wait(ep, events, 1, 0) == 1);
+  EXPECT(events[0].data.fd == c);
+  EXPECT(lwip_epoll_wait(ep, events, 1, 0) == 1);
+  EXPECT(events[0].data.fd == s);
+
+  /* removed or read empty: not reported any more */
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_DEL, s, NULL) == 0);
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == 1);
+  EXPECT(events[0].data.fd == c);
+  EXPECT(lwip_recv(c, buf, sizeof(buf), 0) == sizeof(buf));
+  EXPECT(lwip_epoll_wait(ep, events, 4, 10) == 0);
+
+  /* errors are reported without being asked for */
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_DEL, c, NULL) == 0);
+  ev.events = 0;
+  ev.data.fd = s;
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_ADD, s, &ev) == 0);
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == 0);
+  pcb = test_sockets_pcb(c);
+  EXPECT_RET(pcb != NULL);
+  tcp_abort(pcb);
+  EXPECT(lwip_epoll_wait(ep, events, 4, 100) == 1);
+  EXPECT((events[0].data.fd == s) && (events[0].events == LWIP_EPOLLERR));
+
+  /* closing a socket removes its registration */
+  EXPECT(lwip_close(s) == 0);
+  EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_DEL, s, NULL) == -1);
+  EXPECT(lwip_close(c) == 0);
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == 0);
+  EXPECT(lwip_epoll_close(ep) == 0);
+  EXPECT(lwip_epoll_wait(ep, events, 4, 0) == -1);
+}
+END_TEST
+
+/** lwip_poll() only looks at the sockets passed in, waits for them and
+ * times out */
+START_TEST(test_sockets_poll)
+{
+  struct pollfd fds[4];
+  struct tcp_pcb *pcb;
+  u8_t buf[10];
+  int c, s;
+  u32_t t;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(buf, 0, sizeof(buf));
+  test_api_connect_sockets(&test_ipaddr, TEST_SOCKETS_PORT, &c, &s);
+
+  fds[0].fd = s;
+  fds[0].events = POLLIN;
+  fds[1].fd = c;
+  fds[1].events = POLLIN | POLLOUT;
+  fds[2].fd = MEMP_NUM_NETCONN;
+  fds[2].events = POLLIN;
+  fds[3].fd = -1;
+  fds[3].events = POLLIN;
+  EXPECT(lwip_poll(fds, 4, 0) == 2);
+  EXPECT(fds[0].revents == 0);
+  EXPECT(fds[1].revents == POLLOUT);
+  EXPECT(fds[2].revents == POLLNVAL);
+  EXPECT(fds[3].revents == 0);
+
+  t = sys_now();
+  EXPECT(lwip_poll(fds, 1, 10) == 0);
+  EXPECT(sys_now() - t >= 10);
+
+  /* the data is still on its way when the wait starts */
+  EXPECT(lwip_send(c, buf, sizeof(buf), 0) == sizeof(buf));
+  t = sys_now();
+  EXPECT(lwip_poll(fds, 1, 100) == 1);
+  EXPECT(fds[0].revents == POLLIN);
+  EXPECT(sys_now() - t < 100);
+  EXPECT(lwip_recv(s, buf, sizeof(buf), 0) == sizeof(buf));
+  EXPECT(lwip_poll(fds, 1, 0) == 0);
+
+  pcb = test_sockets_pcb(c);
+  EXPECT_RET(pcb != NULL);
+  tcp_abort(pcb);
+  EXPECT(lwip_poll(fds, 1, 100) == 1);
+  EXPECT(fds[0].revents == (POLLIN | POLLERR));
+
+  EXPECT(lwip_close(c) == 0);
+  EXPECT(lwip_close(s) == 0);
+}
+END_TEST
+
+/** Per-call time of lwip_send()/lwip_recv() with small messages: through
+ * the tcpip_thread mailbox or, built with LWIP_TCPIP_CORE_LOCKING, under
+ * the (priority-inheriting) core mutex in the caller. Without threads, a
+ * message costs no context switch here: the difference is the message
+ * handling alone. The mutex itself is timed separately. */
+START_TEST(test_sockets_latency)
+{
+  u8_t buf[64];
+  clock_t start;
+  double secs[2] = {0, 0};
+  double mutex_secs[2];
+  sys_mutex_t mutex[2];
+  int c, s, k, m, reps = 20000;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(buf, 0, sizeof(buf));
+  test_api_connect_sockets(&test_ipaddr, TEST_SOCKETS_PORT, &c, &s);
+  for (k = 0; k < reps; k++) {
+    /* the time to send includes the input of the looped-back segment */
+    start = clock();
+    EXPECT(lwip_send(c, buf, sizeof(buf), 0) == sizeof(buf));
+    test_api_run();
+    secs[0] += (double)(clock() - start);
+    start = clock();
+    EXPECT(lwip_recv(s, buf, sizeof(buf), 0) == sizeof(buf));
+    secs[1] += (double)(clock() - start);
+  }
+  printf("sockets, %d byte messages (%s): lwip_send %.2f us, lwip_recv %.2f us per call\n",
+    (int)sizeof(buf), LWIP_TCPIP_CORE_LOCKING ? "core locking" : "tcpip_thread mailbox",
+    secs[0] * 1e6 / CLOCKS_PER_SEC / reps, secs[1] * 1e6 / CLOCKS_PER_SEC / reps);
+  EXPECT(lwip_close(c) == 0);
+  EXPECT(lwip_close(s) == 0);
+
+  /* what each core-locked call pays for LOCK_TCPIP_CORE/UNLOCK_TCPIP_CORE */
+  EXPECT(sys_mutex_new(&mutex[0]) == ERR_OK);
+  EXPECT(test_sys_mutex_new_pi(&mutex[1]) == ERR_OK);
+  for (m = 0; m < 2; m++) {
+    start = clock();
+    for (k = 0; k < 100 * reps; k++) {
+      sys_mutex_lock(&mutex[m]);
+      sys_mutex_unlock(&mutex[m]);
+    }
+    mutex_secs[m] = (double)(clock() - start);
+    sys_mutex_free(&mutex[m]);
+  }
+  printf("sys_mutex lock+unlock: %.1f ns plain, %.1f ns priority-inheriting (core mutex)\n",
+    mutex_secs[0] * 1e9 / CLOCKS_PER_SEC / (100 * reps),
+    mutex_secs[1] * 1e9 / CLOCKS_PER_SEC / (100 * reps));
+}
+END_TEST
+
+/** Cost of waking up a task waiting in lwip_select(), lwip_poll() or
+ * lwip_epoll_wait() on 8 to 64 UDP sockets when one of them receives a
+ * datagram. The datagram is still in the mailbox when the wait starts, so
+ * its input (timed separately) and the event callback are part of it. */
+START_TEST(test_sockets_wakeup)
+{
+  static const int nsocks[] = {8, 16, 32, 64};
+  static int socks[64];
+  static struct pollfd fds[64];
+  static struct lwip_epoll_event events[64];
+  struct lwip_epoll_event ev;
+  struct sockaddr_in addr;
+  struct timeval tv;
+  fd_set set, rset;
+  u8_t buf[16];
+  clock_t start;
+  double secs[4];
+  int ep, i, k, m, n, maxfd, ret, reps = 20000;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(buf, 0, sizeof(buf));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_len = sizeof(addr);
+  addr.sin_family = AF_INET;
+  inet_addr_from_ipaddr(&addr.sin_addr, &test_ipaddr);
+
+  for (i = 0; i < (int)(sizeof(nsocks) / sizeof(nsocks[0])); i++) {
+    n = nsocks[i];
+    ep = lwip_epoll_create();
+    EXPECT_RET(ep >= 0);
+    FD_ZERO(&set);
+    maxfd = -1;
+    for (k = 0; k < n; k++) {
+      socks[k] = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+      EXPECT_RET(socks[k] >= 0);
+      addr.sin_port = PP_HTONS(TEST_SOCKETS_PORT + 1 + k);
+      EXPECT(lwip_bind(socks[k], (struct sockaddr *)&addr, sizeof(addr)) == 0);
+      FD_SET(socks[k], &set);
+      maxfd = LWIP_MAX(maxfd, socks[k]);
+      fds[k].fd = socks[k];
+      fds[k].events = POLLIN;
+      ev.events = LWIP_EPOLLIN;
+      ev.data.fd = socks[k];
+      EXPECT(lwip_epoll_ctl(ep, LWIP_EPOLL_CTL_ADD, socks[k], &ev) == 0);
+    }
+
+    /* m == 0: input alone, then select, poll and epoll */
+    for (m = 0; m < 4; m++) {
+      secs[m] = 0;
+      for (k = 0; k < reps; k++) {
+        addr.sin_port = PP_HTONS(TEST_SOCKETS_PORT + 1 + (k % n));
+        ret = lwip_sendto(socks[0], buf, sizeof(buf), 0, (struct sockaddr *)&addr, sizeof(addr));
+        EXPECT_RET(ret == sizeof(buf));
+        start = clock();
+        if (m == 0) {
+          test_api_run();
+          ret = 1;
+        } else if (m == 1) {
+          rset = set;
+          tv.tv_sec = 1;
+          tv.tv_usec = 0;
+          ret = lwip_select(maxfd + 1, &rset, NULL, NULL, &tv);
+        } else if (m == 2) {
+          ret = lwip_poll(fds, (nfds_t)n, 1000);
+        } else {
+          ret = lwip_epoll_wait(ep, events, n, 1000);
+        }
+        secs[m] += (double)(clock() - start);
+        EXPECT_RET(ret == 1);
+        ret = lwip_recv(socks[k % n], buf, sizeof(buf), MSG_DONTWAIT);
+        EXPECT_RET(ret == sizeof(buf));
+      }
+    }
+    printf("sockets, %d UDP sockets, one ready: select %.2f us, poll %.2f us, "
+      "epoll %.2f us per wake-up (%.2f us of it input)\n", n,
+      secs[1] * 1e6 / CLOCKS_PER_SEC / reps, secs[2] * 1e6 / CLOCKS_PER_SEC / reps,
+      secs[3] * 1e6 / CLOCKS_PER_SEC / reps, secs[0] * 1e6 / CLOCKS_PER_SEC / reps);
+
+    for (k = 0; k < n; k++) {
+      EXPECT(lwip_close(socks[k]) == 0);
+    }
+    EXPECT(lwip_epoll_close(ep) == 0);
+  }
+}
+END_TEST
+
+/** Throughput of a connection with and without zero-copy, for several
+ * message sizes. The time is the CPU time of both ends (and of the netif,
+ * which copies every segment to loop it back). */
+START_TEST(test_sockets_zc_throughput)
+{
+  static const int sizes[] = {64, 536, 1460, 4096};
+  static u8_t data[4096];
+  static u8_t buf[4096];
+  const long total = 2L * 1024 * 1024;
+  double secs[2];
+  int c, s, i, zc;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(data); i++) {
+    data[i] = (u8_t)i;
+  }
+  test_api_connect_sockets(&test_ipaddr, TEST_SOCKETS_PORT, &c, &s);
+  for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+    for (zc = 0; zc < 2; zc++) {
+      secs[zc] = test_sockets_transfer(c, s, data, buf, sizes[i], total, zc);
+    }
+    printf("sockets, %d byte messages: lwip_send/lwip_recv %.1f MB/s (%.0f us CPU per MB), "
+      "lwip_send_zc/lwip_recv_zc %.1f MB/s (%.0f us CPU per MB)\n", sizes[i],
+      total / 1048576.0 / secs[0], secs[0] * 1e6 * 1048576.0 / total,
+      total / 1048576.0 / secs[1], secs[1] * 1e6 * 1048576.0 / total);
+  }
+  EXPECT(lwip_close(c) == 0);
+  EXPECT(lwip_close(s) == 0);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+sockets_suite(void)
+{
+  TFun tests[] = {
+    test_sockets_zc_lend,
+    test_sockets_zc_abort,
+    test_sockets_epoll,
+    test_sockets_poll,
+    test_sockets_latency,
+    test_sockets_wakeup,
+    test_sockets_zc_throughput
+  };
+  return create_suite("SOCKETS", tests, sizeof(tests)/sizeof(TFun), sockets_setup, sockets_teardown);
+}
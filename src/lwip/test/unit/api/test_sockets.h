@@ -0,0 +1,8 @@
+#ifndef __TEST_SOCKETS_H__
+#define __TEST_SOCKETS_H__
+
+#include "../lwip_check.h"
+
+Suite *sockets_suite(void);
+
+#endif
@@ -0,0 +1,352 @@
+#include "test_tcpip.h"
+#include "api_helper.h"
+
+#include "lwip/tcpip.h"
+#include "lwip/api.h"
+#include "lwip/udp.h"
+#include "lwip/netif.h"
+#include "lwip/stats.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_TCPIP_INPUT_BATCH || !LWIP_NETCONN_BATCH || !defined(TCPIP_THREAD_TEST)
+#error "This tests needs LWIP_TCPIP_INPUT_BATCH, LWIP_NETCONN_BATCH and TCPIP_THREAD_TEST"
+#endif
+#if TCPIP_MBOX_BATCH < 2
+#error "This tests needs TCPIP_MBOX_BATCH > 1"
+#endif
+#if (2 * TCPIP_MBOX_BATCH + 1) > MEMP_NUM_TCPIP_MSG_API
+#error "This tests needs MEMP_NUM_TCPIP_MSG_API > 2 * TCPIP_MBOX_BATCH"
+#endif
+
+#define TEST_TCPIP_PORT   4091
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw;
+
+/** Sent packets are kept here instead of being passed on */
+static struct pbuf *tx_pkts[TCPIP_INPUT_BATCH_SIZE + 1];
+static int tx_ctr;
+
+static struct udp_pcb *rx_pcb;
+/* first payload byte of the datagrams received by rx_pcb, in order */
+static u8_t rx_data[TCPIP_INPUT_BATCH_SIZE + NETCONN_BATCH_MAX];
+static int rx_ctr;
+
+static int callback_ctr;
+
+/* Helper functions */
+
+static err_t
+test_tcpip_netif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  if (tx_ctr < (int)(sizeof(tx_pkts) / sizeof(tx_pkts[0]))) {
+    tx_pkts[tx_ctr] = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+    EXPECT_RETX(tx_pkts[tx_ctr] != NULL, ERR_MEM);
+    pbuf_copy(tx_pkts[tx_ctr], p);
+    tx_ctr++;
+  }
+  return ERR_OK;
+}
+
+static err_t
+test_tcpip_netif_init(struct netif *netif)
+{
+  netif->output = test_tcpip_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_UP | NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+static void
+test_tcpip_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+
+  if (rx_ctr < (int)sizeof(rx_data)) {
+    rx_data[rx_ctr] = *(u8_t *)p->payload;
+  }
+  rx_ctr++;
+  pbuf_free(p);
+}
+
+static void
+test_tcpip_callback(void *ctx)
+{
+  LWIP_UNUSED_ARG(ctx);
+  callback_ctr++;
+}
+
+/** Free the packets kept from test_netif */
+static void
+test_tcpip_free_pkts(void)
+{
+  int i;
+
+  for (i = 0; i < tx_ctr; i++) {
+    pbuf_free(tx_pkts[i]);
+  }
+  tx_ctr = 0;
+}
+
+/** Let test_netif send 'num' datagrams to rx_pcb, each starting with its
+ * index, and keep them in tx_pkts */
+static void
+test_tcpip_make_pkts(int num)
+{
+  struct udp_pcb *pcb;
+  struct pbuf *p;
+  int i;
+
+  test_tcpip_free_pkts();
+  pcb = udp_new();
+  EXPECT_RET(pcb != NULL);
+  for (i = 0; i < num; i++) {
+    p = pbuf_alloc(PBUF_TRANSPORT, 16, PBUF_RAM);
+    EXPECT_RET(p != NULL);
+    memset(p->payload, i, p->len);
+    EXPECT(udp_sendto(pcb, p, &test_ipaddr, TEST_TCPIP_PORT) == ERR_OK);
+    pbuf_free(p);
+  }
+  udp_remove(pcb);
+  EXPECT(tx_ctr == num);
+}
+
+
+/* Setups/teardown functions */
+
+static void
+tcpip_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192, 168, 1, 19);
+  IP4_ADDR(&test_netmask, 255, 255, 255, 0);
+  IP4_ADDR(&test_gw, 192, 168, 1, 1);
+  fail_unless(netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw,
+    NULL, test_tcpip_netif_init, tcpip_input) != NULL);
+  netif_set_up(&test_netif);
+  rx_pcb = udp_new();
+  fail_unless(rx_pcb != NULL);
+  fail_unless(udp_bind(rx_pcb, IP_ADDR_ANY, TEST_TCPIP_PORT) == ERR_OK);
+  udp_recv(rx_pcb, test_tcpip_recv, NULL);
+  rx_ctr = 0;
+  tx_ctr = 0;
+  callback_ctr = 0;
+  test_sys_arch_wait_callback(test_api_wait);
+}
+
+static void
+tcpip_teardown(void)
+{
+  while (tcpip_thread_poll_one() != 0) {
+  }
+  test_sys_arch_wait_callback(NULL);
+  test_tcpip_free_pkts();
+  udp_remove(rx_pcb);
+  netif_remove(&test_netif);
+}
+
+
+/* Test functions */
+
+/** tcpip_input_batch() passes its packets on with one message, in order,
+ * and leaves them to the caller when there is no message left */
+START_TEST(test_tcpip_input_batch)
+{
+  struct pbuf *p[TCPIP_INPUT_BATCH_SIZE];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcpip_make_pkts(TCPIP_INPUT_BATCH_SIZE);
+  memcpy(p, tx_pkts, sizeof(p));
+  tx_ctr = 0;
+  EXPECT(tcpip_input_batch(p, TCPIP_INPUT_BATCH_SIZE, &test_netif) == ERR_OK);
+  /* the array may be reused at once */
+  memset(p, 0, sizeof(p));
+  EXPECT(rx_ctr == 0);
+  EXPECT(tcpip_thread_poll_one() == 1);
+  EXPECT(rx_ctr == TCPIP_INPUT_BATCH_SIZE);
+  for (i = 0; i < TCPIP_INPUT_BATCH_SIZE; i++) {
+    EXPECT(rx_data[i] == i);
+  }
+  EXPECT(lwip_stats.memp[MEMP_TCPIP_MSG_INPKT_BATCH].used == 0);
+
+  /* out of batch messages: the caller keeps the packets */
+  rx_ctr = 0;
+  test_tcpip_make_pkts(MEMP_NUM_TCPIP_MSG_INPKT_BATCH + 1);
+  for (i = 0; i < MEMP_NUM_TCPIP_MSG_INPKT_BATCH; i++) {
+    EXPECT(tcpip_input_batch(&tx_pkts[i], 1, &test_netif) == ERR_OK);
+  }
+  EXPECT(tcpip_input_batch(&tx_pkts[i], 1, &test_netif) == ERR_MEM);
+  EXPECT(tx_pkts[i]->ref == 1);
+  pbuf_free(tx_pkts[i]);
+  tx_ctr = 0;
+  EXPECT(tcpip_thread_poll_one() == MEMP_NUM_TCPIP_MSG_INPKT_BATCH);
+  EXPECT(rx_ctr == MEMP_NUM_TCPIP_MSG_INPKT_BATCH);
+  EXPECT(lwip_stats.memp[MEMP_TCPIP_MSG_INPKT_BATCH].used == 0);
+}
+END_TEST
+
+/** One wakeup of tcpip_thread processes at most TCPIP_MBOX_BATCH messages,
+ * the rest is left for the next one */
+START_TEST(test_tcpip_mbox_batch)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(tcpip_thread_poll_one() == 0);
+  for (i = 0; i < 2 * TCPIP_MBOX_BATCH + 1; i++) {
+    EXPECT(tcpip_callback_with_block(test_tcpip_callback, NULL, 0) == ERR_OK);
+  }
+  EXPECT(tcpip_thread_poll_one() == TCPIP_MBOX_BATCH);
+  EXPECT(callback_ctr == TCPIP_MBOX_BATCH);
+  EXPECT(tcpip_thread_poll_one() == TCPIP_MBOX_BATCH);
+  EXPECT(callback_ctr == 2 * TCPIP_MBOX_BATCH);
+  EXPECT(tcpip_thread_poll_one() == 1);
+  EXPECT(callback_ctr == 2 * TCPIP_MBOX_BATCH + 1);
+  EXPECT(tcpip_thread_poll_one() == 0);
+}
+END_TEST
+
+/** A committed batch runs all its operations, a netconn can't be in a
+ * batch twice */
+START_TEST(test_tcpip_netconn_batch)
+{
+  struct netconn *conn[NETCONN_BATCH_MAX];
+  struct netbuf *buf[NETCONN_BATCH_MAX];
+  struct netconn_batch b;
+  u8_t data[NETCONN_BATCH_MAX];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+    data[i] = (u8_t)i;
+    conn[i] = netconn_new(NETCONN_UDP);
+    EXPECT_RET(conn[i] != NULL);
+    buf[i] = netbuf_new();
+    EXPECT_RET(buf[i] != NULL);
+    EXPECT(netbuf_ref(buf[i], &data[i], 1) == ERR_OK);
+    ip_addr_copy(buf[i]->addr, test_ipaddr);
+    buf[i]->port = TEST_TCPIP_PORT;
+  }
+
+  netconn_batch_init(&b);
+  for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+    EXPECT(netconn_batch_send(&b, conn[i], buf[i]) == ERR_OK);
+    EXPECT(netconn_batch_send(&b, conn[i], buf[i]) == ERR_ARG);
+  }
+  EXPECT(netconn_batch_send(&b, conn[0], buf[0]) == ERR_ARG);
+  EXPECT(tx_ctr == 0);
+  EXPECT(netconn_batch_commit(&b) == ERR_OK);
+  EXPECT(tx_ctr == NETCONN_BATCH_MAX);
+  for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+    EXPECT(netconn_batch_err(&b, i) == ERR_OK);
+  }
+  EXPECT(netconn_batch_commit(&b) == ERR_OK);
+
+  /* loop them back */
+  EXPECT(tcpip_input_batch(tx_pkts, (u8_t)tx_ctr, &test_netif) == ERR_OK);
+  tx_ctr = 0;
+  EXPECT(tcpip_thread_poll_one() == 1);
+  EXPECT(rx_ctr == NETCONN_BATCH_MAX);
+  for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+    EXPECT(rx_data[i] == i);
+    netbuf_delete(buf[i]);
+    EXPECT(netconn_delete(conn[i]) == ERR_OK);
+  }
+}
+END_TEST
+
+/** Messages per second through tcpip_thread, one operation or packet per
+ * message and batched. Without threads this leaves out the context switch
+ * a message costs on a target, only the message handling is measured. */
+START_TEST(test_tcpip_batch_rate)
+{
+  struct netconn *conn[NETCONN_BATCH_MAX];
+  struct netbuf *buf[NETCONN_BATCH_MAX];
+  struct netconn_batch b;
+  struct pbuf *p[TCPIP_INPUT_BATCH_SIZE];
+  u8_t data = 0;
+  clock_t start;
+  double secs[2];
+  int i, k, batched, reps = 20000;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+    conn[i] = netconn_new(NETCONN_UDP);
+    EXPECT_RET(conn[i] != NULL);
+    buf[i] = netbuf_new();
+    EXPECT_RET(buf[i] != NULL);
+    EXPECT(netbuf_ref(buf[i], &data, 1) == ERR_OK);
+    ip_addr_copy(buf[i]->addr, test_ipaddr);
+    buf[i]->port = TEST_TCPIP_PORT;
+  }
+  for (batched = 0; batched < 2; batched++) {
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      netconn_batch_init(&b);
+      for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+        if (batched) {
+          netconn_batch_send(&b, conn[i], buf[i]);
+        } else {
+          netconn_send(conn[i], buf[i]);
+        }
+      }
+      netconn_batch_commit(&b);
+    }
+    secs[batched] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+  for (i = 0; i < NETCONN_BATCH_MAX; i++) {
+    netbuf_delete(buf[i]);
+    EXPECT(netconn_delete(conn[i]) == ERR_OK);
+  }
+  printf("tcpip_thread, UDP netconn_send: %.0f sends/s, in batches of %d: %.0f sends/s\n",
+    reps * NETCONN_BATCH_MAX / secs[0], NETCONN_BATCH_MAX, reps * NETCONN_BATCH_MAX / secs[1]);
+
+  test_tcpip_make_pkts(TCPIP_INPUT_BATCH_SIZE);
+  for (batched = 0; batched < 2; batched++) {
+    rx_ctr = 0;
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      for (i = 0; i < TCPIP_INPUT_BATCH_SIZE; i++) {
+        /* input moves the payload pointer: feed in a copy */
+        p[i] = pbuf_alloc(PBUF_RAW, tx_pkts[i]->tot_len, PBUF_RAM);
+        pbuf_copy(p[i], tx_pkts[i]);
+        if (!batched) {
+          tcpip_input(p[i], &test_netif);
+        }
+      }
+      if (batched) {
+        tcpip_input_batch(p, TCPIP_INPUT_BATCH_SIZE, &test_netif);
+      }
+      while (tcpip_thread_poll_one() != 0) {
+      }
+    }
+    secs[batched] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    EXPECT(rx_ctr == reps * TCPIP_INPUT_BATCH_SIZE);
+  }
+  printf("tcpip_thread, UDP input: %.0f packets/s with tcpip_input, %.0f packets/s with tcpip_input_batch\n",
+    reps * TCPIP_INPUT_BATCH_SIZE / secs[0], reps * TCPIP_INPUT_BATCH_SIZE / secs[1]);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+tcpip_suite(void)
+{
+  TFun tests[] = {
+    test_tcpip_input_batch,
+    test_tcpip_mbox_batch,
+    test_tcpip_netconn_batch,
+    test_tcpip_batch_rate
+  };
+  return create_suite("TCPIP", tests, sizeof(tests)/sizeof(TFun), tcpip_setup, tcpip_teardown);
+}
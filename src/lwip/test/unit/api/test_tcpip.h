@@ -0,0 +1,8 @@
+#ifndef __TEST_TCPIP_H__
+#define __TEST_TCPIP_H__
+
+#include "../lwip_check.h"
+
+Suite *tcpip_suite(void);
+
+#endif
@@ -0,0 +1,221 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/debug.h"
+
+#include <string.h>
+
+/* See sys_arch.h: a single-threaded sys_arch for the unit tests */
+
+static test_sys_arch_waiting_fn the_waiting_fn;
+/** Emulated clock, only moves when a wait times out */
+static u32_t the_time;
+/** Priority of the only thread (never changes, nobody can wait on a mutex) */
+static u8_t the_prio;
+
+/** Set while a test plays an interrupt (LWIP_STATS_SHARD() of the tests) */
+volatile u8_t test_sys_arch_in_isr;
+
+/**
+ * Register the function that is called while waiting on an empty
+ * semaphore or mailbox, e.g. one that runs tcpip_thread_poll_one().
+ *
+ * @param waiting_fn the function (NULL: waits never end by waiting)
+ */
+void
+test_sys_arch_wait_callback(test_sys_arch_waiting_fn waiting_fn)
+{
+  the_waiting_fn = waiting_fn;
+}
+
+/**
+ * Let the waiting function work until it can't or the wait is satisfied.
+ *
+ * @param timeout the timeout of the wait (0: forever)
+ * @return 1 if the wait has timed out
+ */
+static int
+test_sys_arch_wait(sys_sem_t *sem, sys_mbox_t *mbox, u32_t timeout)
+{
+  if ((the_waiting_fn != NULL) && the_waiting_fn(sem, mbox)) {
+    return 0;
+  }
+  /* nobody else can signal or post */
+  LWIP_ASSERT("sys_arch: waiting forever in a single thread", timeout != 0);
+  the_time += timeout;
+  return 1;
+}
+
+void
+sys_init(void)
+{
+}
+
+u32_t
+sys_now(void)
+{
+  return the_time;
+}
+
+u32_t
+sys_jiffies(void)
+{
+  return the_time;
+}
+
+sys_thread_t
+sys_thread_new(const char *name, lwip_thread_fn thread, void *arg, int stacksize, int prio)
+{
+  /* threads never run here (tcpip_thread: see tcpip_thread_poll_one) */
+  LWIP_UNUSED_ARG(name);
+  LWIP_UNUSED_ARG(thread);
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(stacksize);
+  LWIP_UNUSED_ARG(prio);
+  return 0;
+}
+
+err_t
+sys_sem_new(sys_sem_t *sem, u8_t count)
+{
+  sem->count = count;
+  sem->valid = 1;
+  return ERR_OK;
+}
+
+void
+sys_sem_signal(sys_sem_t *sem)
+{
+  LWIP_ASSERT("invalid sem", sem->valid);
+  sem->count++;
+}
+
+u32_t
+sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout)
+{
+  LWIP_ASSERT("invalid sem", sem->valid);
+  while (sem->count == 0) {
+    if (test_sys_arch_wait(sem, NULL, timeout)) {
+      return SYS_ARCH_TIMEOUT;
+    }
+  }
+  sem->count--;
+  return 0;
+}
+
+void
+sys_sem_free(sys_sem_t *sem)
+{
+  LWIP_ASSERT("invalid sem", sem->valid);
+  sem->valid = 0;
+}
+
+err_t
+sys_mutex_new(sys_mutex_t *mutex)
+{
+  memset(mutex, 0, sizeof(*mutex));
+  mutex->valid = 1;
+  return ERR_OK;
+}
+
+err_t
+test_sys_mutex_new_pi(sys_mutex_t *mutex)
+{
+  sys_mutex_new(mutex);
+  mutex->inherit = 1;
+  return ERR_OK;
+}
+
+void
+sys_mutex_lock(sys_mutex_t *mutex)
+{
+  LWIP_ASSERT("invalid mutex", mutex->valid);
+  /* there is no other thread that could unlock it */
+  LWIP_ASSERT("mutex already locked", !mutex->locked);
+  mutex->locked = 1;
+  if (mutex->inherit) {
+    mutex->owner_prio = the_prio;
+  }
+}
+
+void
+sys_mutex_unlock(sys_mutex_t *mutex)
+{
+  LWIP_ASSERT("mutex not locked", mutex->locked);
+  if (mutex->inherit) {
+    /* drop what waiters lent the owner while it held the mutex */
+    the_prio = mutex->owner_prio;
+  }
+  mutex->locked = 0;
+}
+
+void
+sys_mutex_free(sys_mutex_t *mutex)
+{
+  LWIP_ASSERT("freeing a locked mutex", !mutex->locked);
+  mutex->valid = 0;
+}
+
+err_t
+sys_mbox_new(sys_mbox_t *mbox, int size)
+{
+  LWIP_ASSERT("mbox too big", size <= TEST_SYS_MBOX_SIZE);
+  memset(mbox, 0, sizeof(*mbox));
+  mbox->size = (u16_t)((size > 0) ? size : TEST_SYS_MBOX_SIZE);
+  mbox->valid = 1;
+  return ERR_OK;
+}
+
+err_t
+sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
+{
+  LWIP_ASSERT("invalid mbox", mbox->valid);
+  if (mbox->used == mbox->size) {
+    return ERR_MEM;
+  }
+  mbox->q[(mbox->head + mbox->used) % mbox->size] = msg;
+  mbox->used++;
+  return ERR_OK;
+}
+
+void
+sys_mbox_post(sys_mbox_t *mbox, void *msg)
+{
+  while (sys_mbox_trypost(mbox, msg) != ERR_OK) {
+    test_sys_arch_wait(NULL, mbox, 0);
+  }
+}
+
+u32_t
+sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
+{
+  LWIP_ASSERT("invalid mbox", mbox->valid);
+  if (mbox->used == 0) {
+    return SYS_MBOX_EMPTY;
+  }
+  if (msg != NULL) {
+    *msg = mbox->q[mbox->head];
+  }
+  mbox->head = (u16_t)((mbox->head + 1) % mbox->size);
+  mbox->used--;
+  return 0;
+}
+
+u32_t
+sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
+{
+  LWIP_ASSERT("invalid mbox", mbox->valid);
+  while (mbox->used == 0) {
+    if (test_sys_arch_wait(NULL, mbox, timeout)) {
+      return SYS_ARCH_TIMEOUT;
+    }
+  }
+  return sys_arch_mbox_tryfetch(mbox, msg);
+}
+
+void
+sys_mbox_free(sys_mbox_t *mbox)
+{
+  LWIP_ASSERT("invalid mbox", mbox->valid);
+  LWIP_ASSERT("mbox not empty", mbox->used == 0);
+  mbox->valid = 0;
+}
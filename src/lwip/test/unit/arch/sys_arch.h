@@ -0,0 +1,69 @@
+#ifndef __TEST_SYS_ARCH_H__
+#define __TEST_SYS_ARCH_H__
+
+/* sys_arch emulation for the unit tests (NO_SYS==0 without threads).
+ * There is only the test's own thread: tcpip_thread is not started, its
+ * messages are processed by tcpip_thread_poll_one(). A wait on an empty
+ * semaphore or mailbox calls the function registered with
+ * test_sys_arch_wait_callback() until the wait is satisfied; when that
+ * does not help, a wait with a timeout times out at once (the emulated
+ * clock jumps ahead) and a wait without timeout is a deadlock. */
+
+#define SYS_MBOX_NULL   NULL
+#define SYS_SEM_NULL    NULL
+
+/** Upper limit for the size of a mailbox (also used for size 0) */
+#define TEST_SYS_MBOX_SIZE  128
+
+typedef u32_t sys_prot_t;
+
+struct test_sys_sem {
+  u32_t count;
+  u8_t valid;
+};
+typedef struct test_sys_sem sys_sem_t;
+#define sys_sem_valid(sem)        ((sem)->valid)
+#define sys_sem_set_invalid(sem)  ((sem)->valid = 0)
+
+struct test_sys_mutex {
+  u8_t locked;
+  u8_t valid;
+  /** created by test_sys_mutex_new_pi() */
+  u8_t inherit;
+  /** priority of the owner when it took the mutex */
+  u8_t owner_prio;
+};
+typedef struct test_sys_mutex sys_mutex_t;
+#define sys_mutex_valid(mutex)        ((mutex)->valid)
+#define sys_mutex_set_invalid(mutex)  ((mutex)->valid = 0)
+
+struct test_sys_mbox {
+  void *q[TEST_SYS_MBOX_SIZE];
+  u16_t size;
+  u16_t head;
+  u16_t used;
+  u8_t valid;
+};
+typedef struct test_sys_mbox sys_mbox_t;
+#define sys_mbox_valid(mbox)        ((mbox)->valid)
+#define sys_mbox_set_invalid(mbox)  ((mbox)->valid = 0)
+
+typedef int sys_thread_t;
+
+/** Called while waiting on an empty semaphore or mailbox (one of them is
+ * NULL). Returns 0 if it could not do anything that might end the wait. */
+typedef int (*test_sys_arch_waiting_fn)(sys_sem_t *sem, sys_mbox_t *mbox);
+
+void test_sys_arch_wait_callback(test_sys_arch_waiting_fn waiting_fn);
+
+/** Nonzero while a test runs code as if from an interrupt, e.g. to see its
+ * packet counters go to another shard (LWIP_STATS_SHARDS) */
+extern volatile u8_t test_sys_arch_in_isr;
+
+/** Priority-inheriting mutex, the core mutex with LWIP_TCPIP_CORE_LOCKING
+ * (see LWIP_TCPIP_CORE_MUTEX_NEW). Nobody can wait for it here, so its
+ * owner is never boosted: this does what such a mutex does uncontended,
+ * i.e. remember the owner's priority on lock and restore it on unlock. */
+err_t test_sys_mutex_new_pi(sys_mutex_t *mutex);
+
+#endif /* __TEST_SYS_ARCH_H__ */
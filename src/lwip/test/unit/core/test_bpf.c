@@ -0,0 +1,581 @@
+#include "test_bpf.h"
+
+#include "lwip/bpf.h"
+#include "lwip/raw.h"
+#include "lwip/ip.h"
+#include "lwip/icmp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/netif.h"
+#include "netif/etharp.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !LWIP_BPF || !LWIP_RAW
+#error "This tests needs LWIP_BPF and LWIP_RAW"
+#endif
+
+/* "tcpdump -dd ip and udp dst port 53", pasted as printed */
+static const struct bpf_insn test_bpf_dns[] = {
+  { 0x28, 0, 0, 0x0000000c },
+  { 0x15, 0, 8, 0x00000800 },
+  { 0x30, 0, 0, 0x00000017 },
+  { 0x15, 0, 6, 0x00000011 },
+  { 0x28, 0, 0, 0x00000014 },
+  { 0x45, 4, 0, 0x00001fff },
+  { 0xb1, 0, 0, 0x0000000e },
+  { 0x48, 0, 0, 0x00000010 },
+  { 0x15, 0, 1, 0x00000035 },
+  { 0x6, 0, 0, 0x00040000 },
+  { 0x6, 0, 0, 0x00000000 },
+};
+static const struct bpf_program test_bpf_dns_prog = BPF_PROGRAM(test_bpf_dns);
+
+/* IPv4 frames only, all of them */
+static const struct bpf_insn test_bpf_ip[] = {
+  BPF_STMT(BPF_LD|BPF_H|BPF_ABS, 12),
+  BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, ETHTYPE_IP, 0, 1),
+  BPF_STMT(BPF_RET|BPF_K, 0xffff),
+  BPF_STMT(BPF_RET|BPF_K, 0),
+};
+static const struct bpf_program test_bpf_ip_prog = BPF_PROGRAM(test_bpf_ip);
+
+/* On an IP packet (raw pcb): ICMP echo requests only */
+static const struct bpf_insn test_bpf_echo[] = {
+  BPF_STMT(BPF_LDX|BPF_MSH|BPF_B, 0),
+  BPF_STMT(BPF_LD|BPF_B|BPF_IND, 0),
+  BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, ICMP_ECHO, 0, 1),
+  BPF_STMT(BPF_RET|BPF_K, 0xffff),
+  BPF_STMT(BPF_RET|BPF_K, 0),
+};
+static const struct bpf_program test_bpf_echo_prog = BPF_PROGRAM(test_bpf_echo);
+
+/* Every ALU operation once: returns 0xffffffef */
+static const struct bpf_insn test_bpf_alu[] = {
+  BPF_STMT(BPF_LD|BPF_IMM, 100),
+  BPF_STMT(BPF_ALU|BPF_ADD|BPF_K, 5),
+  BPF_STMT(BPF_ALU|BPF_MUL|BPF_K, 3),
+  BPF_STMT(BPF_ALU|BPF_SUB|BPF_K, 15),
+  BPF_STMT(BPF_ALU|BPF_DIV|BPF_K, 7),
+  BPF_STMT(BPF_ALU|BPF_MOD|BPF_K, 10),
+  BPF_STMT(BPF_ALU|BPF_LSH|BPF_K, 4),
+  BPF_STMT(BPF_ALU|BPF_OR|BPF_K, 1),
+  BPF_STMT(BPF_ALU|BPF_XOR|BPF_K, 3),
+  BPF_STMT(BPF_ALU|BPF_AND|BPF_K, 0xfe),
+  BPF_STMT(BPF_ALU|BPF_RSH|BPF_K, 1),
+  BPF_STMT(BPF_ST, 3),
+  BPF_STMT(BPF_LD|BPF_IMM, 0),
+  BPF_STMT(BPF_LDX|BPF_MEM, 3),
+  BPF_STMT(BPF_MISC|BPF_TXA, 0),
+  BPF_STMT(BPF_ALU|BPF_NEG, 0),
+  BPF_STMT(BPF_RET|BPF_A, 0),
+};
+static const struct bpf_program test_bpf_alu_prog = BPF_PROGRAM(test_bpf_alu);
+
+/* Division by X == 0 rejects the packet */
+static const struct bpf_insn test_bpf_div0[] = {
+  BPF_STMT(BPF_LDX|BPF_IMM, 0),
+  BPF_STMT(BPF_LD|BPF_IMM, 5),
+  BPF_STMT(BPF_ALU|BPF_DIV|BPF_X, 0),
+  BPF_STMT(BPF_RET|BPF_K, 1),
+};
+static const struct bpf_program test_bpf_div0_prog = BPF_PROGRAM(test_bpf_div0);
+
+static struct netif test_netif;
+static u32_t test_bpf_sent;
+
+
+/* Helper functions */
+
+/** An Ethernet frame carrying a UDP datagram, 'len' bytes in all */
+static u16_t
+test_bpf_udp_frame(u8_t *f, u16_t len, u16_t dport, u16_t frag)
+{
+  struct ip_hdr *iphdr;
+
+  memset(f, 0, len);
+  f[12] = 0x08; /* ETHTYPE_IP */
+  iphdr = (struct ip_hdr *)(f + SIZEOF_ETH_HDR);
+  IPH_VHL_SET(iphdr, 4, 5);
+  IPH_LEN_SET(iphdr, htons(len - SIZEOF_ETH_HDR));
+  IPH_OFFSET_SET(iphdr, htons(frag));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  f[SIZEOF_ETH_HDR + IP_HLEN + 2] = (u8_t)(dport >> 8);
+  f[SIZEOF_ETH_HDR + IP_HLEN + 3] = (u8_t)dport;
+  return len;
+}
+
+/** Copy 'len' bytes into a chain split at random points, with an empty pbuf now and then */
+static struct pbuf *
+test_bpf_chain(const u8_t *data, u16_t len)
+{
+  struct pbuf *p = NULL, *q;
+  u16_t off = 0, n;
+
+  while (off < len) {
+    n = (u16_t)(rand() % 8 == 0 ? 0 : 1 + rand() % (len - off));
+    q = pbuf_alloc(PBUF_RAW, n, PBUF_RAM);
+    fail_unless(q != NULL);
+    if (n != 0) {
+      memcpy(q->payload, data + off, n);
+    }
+    off += n;
+    if (p == NULL) {
+      p = q;
+    } else {
+      pbuf_cat(p, q);
+    }
+  }
+  return p;
+}
+
+/** A program of 30 random loads (absolute and indexed, 1, 2 and 4 bytes)
+ * from a packet of 'len' bytes, mixed through scratch memory. Returns
+ * what it must compute. */
+static u32_t
+test_bpf_loads(struct bpf_insn *insns, u16_t *n, const u8_t *f, u16_t len)
+{
+  static const u16_t sizes[3] = {BPF_B, BPF_H, BPF_W};
+  u32_t want = 0, v;
+  u16_t i = 0, off, half;
+  int j, s, k;
+
+  insns[i].code = BPF_LD|BPF_IMM; insns[i++].k = 0;
+  insns[i].code = BPF_ST; insns[i++].k = 0;
+  for (j = 0; j < 30; j++) {
+    s = rand() % 3;
+    off = (u16_t)(rand() % (len - (1 << s) + 1));
+    if (j & 1) {
+      insns[i].code = BPF_LD|sizes[s]|BPF_ABS; insns[i++].k = off;
+    } else {
+      half = off / 2;
+      insns[i].code = BPF_LDX|BPF_IMM; insns[i++].k = half;
+      insns[i].code = BPF_LD|sizes[s]|BPF_IND; insns[i++].k = off - half;
+    }
+    insns[i].code = BPF_LDX|BPF_MEM; insns[i++].k = 0;
+    insns[i].code = BPF_ALU|BPF_XOR|BPF_X; insns[i++].k = 0;
+    insns[i].code = BPF_ALU|BPF_MUL|BPF_K; insns[i++].k = 31;
+    insns[i].code = BPF_ST; insns[i++].k = 0;
+    v = 0;
+    for (k = 0; k < (1 << s); k++) {
+      v = (v << 8) | f[off + k];
+    }
+    want = (v ^ want) * 31;
+  }
+  insns[i].code = BPF_LD|BPF_MEM; insns[i++].k = 0;
+  insns[i].code = BPF_ALU|BPF_OR|BPF_K; insns[i++].k = 1;
+  insns[i].code = BPF_RET|BPF_A; insns[i++].k = 0;
+  for (k = 0; k < i; k++) {
+    insns[k].jt = insns[k].jf = 0;
+  }
+  *n = i;
+  return want | 1;
+}
+
+static struct pbuf *
+test_bpf_pbuf(const u8_t *data, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+
+  fail_unless(p != NULL);
+  memcpy(p->payload, data, len);
+  return p;
+}
+
+/** An ICMP message of type 'type' from 192.168.1.2 to us, as ip_input() gets it */
+static struct pbuf *
+test_bpf_icmp(u8_t type)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, IP_HLEN + 8, PBUF_RAM);
+  struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+  u8_t *icmp = (u8_t *)p->payload + IP_HLEN;
+  ip_addr_t src;
+
+  memset(p->payload, 0, p->len);
+  IP4_ADDR(&src, 192, 168, 1, 2);
+  IPH_VHL_SET(iphdr, 4, 5);
+  IPH_LEN_SET(iphdr, htons(p->len));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_ICMP);
+  ip_addr_copy(iphdr->src, src);
+  ip_addr_copy(iphdr->dest, test_netif.ip_addr);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  icmp[0] = type;
+  return p;
+}
+
+static err_t
+test_bpf_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  LWIP_UNUSED_ARG(ipaddr);
+  test_bpf_sent++;
+  return ERR_OK;
+}
+
+static err_t
+test_bpf_netif_init(struct netif *netif)
+{
+  netif->output = test_bpf_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+static u32_t test_bpf_rx[2];
+
+/** arg 0 only counts the packet, arg 1 eats it */
+static u8_t
+test_bpf_recv(void *arg, struct raw_pcb *pcb, struct pbuf *p, ip_addr_t *addr)
+{
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  test_bpf_rx[(mem_ptr_t)arg]++;
+  if (arg == NULL) {
+    return 0;
+  }
+  pbuf_free(p);
+  return 1;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+bpf_setup(void)
+{
+  ip_addr_t addr, mask, gw;
+
+  IP4_ADDR(&addr, 192, 168, 1, 1);
+  IP4_ADDR(&mask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 192, 168, 1, 254);
+  fail_unless(netif_add(&test_netif, &addr, &mask, &gw, NULL, test_bpf_netif_init, ip_input) != NULL);
+  netif_set_up(&test_netif);
+  test_bpf_sent = 0;
+  memset(test_bpf_rx, 0, sizeof(test_bpf_rx));
+  srand(49);
+}
+
+static void
+bpf_teardown(void)
+{
+  netif_remove(&test_netif);
+}
+
+
+/* Test functions */
+
+/** Programs that could run off the end, loop or fault are refused */
+START_TEST(test_bpf_validate)
+{
+  static const struct bpf_insn no_ret[] = {
+    BPF_STMT(BPF_LD|BPF_IMM, 1),
+  };
+  static const struct bpf_insn jt_out[] = {
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 1, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn jf_out[] = {
+    BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, 2),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn ja_out[] = {
+    BPF_STMT(BPF_JMP|BPF_JA, 1),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn ja_wrap[] = {
+    BPF_STMT(BPF_JMP|BPF_JA, 0xffffffffUL),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn mem_out[] = {
+    BPF_STMT(BPF_ST, BPF_MEMWORDS),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn div0[] = {
+    BPF_STMT(BPF_ALU|BPF_DIV|BPF_K, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn mod0[] = {
+    BPF_STMT(BPF_ALU|BPF_MOD|BPF_K, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn bad_op[] = {
+    BPF_STMT(BPF_LD|BPF_W|BPF_MSH, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  static const struct bpf_insn ext[] = {
+    BPF_STMT(BPF_RET|BPF_X, 0),
+  };
+  static const struct bpf_insn ja_last[] = {
+    BPF_STMT(BPF_JMP|BPF_JA, 0),
+    BPF_STMT(BPF_RET|BPF_K, 0),
+  };
+  const struct bpf_program bad[] = {
+    BPF_PROGRAM(no_ret), BPF_PROGRAM(jt_out), BPF_PROGRAM(jf_out),
+    BPF_PROGRAM(ja_out), BPF_PROGRAM(ja_wrap), BPF_PROGRAM(mem_out),
+    BPF_PROGRAM(div0), BPF_PROGRAM(mod0), BPF_PROGRAM(bad_op), BPF_PROGRAM(ext),
+    { 0, ja_last }, { BPF_MAXINSNS + 1, ja_last }
+  };
+  const struct bpf_program ok = BPF_PROGRAM(ja_last);
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    fail_unless(bpf_validate(&bad[i]) == ERR_VAL);
+  }
+  fail_unless(bpf_validate(NULL) == ERR_VAL);
+  fail_unless(bpf_validate(&ok) == ERR_OK);
+  fail_unless(bpf_validate(&test_bpf_dns_prog) == ERR_OK);
+  fail_unless(bpf_validate(&test_bpf_ip_prog) == ERR_OK);
+  fail_unless(bpf_validate(&test_bpf_echo_prog) == ERR_OK);
+  fail_unless(bpf_validate(&test_bpf_alu_prog) == ERR_OK);
+  fail_unless(bpf_validate(&test_bpf_div0_prog) == ERR_OK);
+}
+END_TEST
+
+/** Results on known packets, the same however the packet is split into pbufs */
+START_TEST(test_bpf_filter)
+{
+  struct bpf_insn insns[200];
+  struct bpf_program loads;
+  u8_t f[200];
+  struct pbuf *p;
+  u32_t want;
+  int i, k;
+  LWIP_UNUSED_ARG(_i);
+
+  /* DNS query, other port, a fragment and a frame cut short */
+  test_bpf_udp_frame(f, 100, 53, 0);
+  p = test_bpf_pbuf(f, 100);
+  fail_unless(bpf_filter(&test_bpf_dns_prog, p) == 0x40000);
+  fail_unless(bpf_filter(&test_bpf_ip_prog, p) == 0xffff);
+  fail_unless(bpf_filter(&test_bpf_alu_prog, p) == 0xffffffefUL);
+  fail_unless(bpf_filter(&test_bpf_div0_prog, p) == 0);
+  pbuf_free(p);
+  test_bpf_udp_frame(f, 100, 54, 0);
+  p = test_bpf_pbuf(f, 100);
+  fail_unless(bpf_filter(&test_bpf_dns_prog, p) == 0);
+  pbuf_free(p);
+  test_bpf_udp_frame(f, 100, 53, 0x20 /* offset 256 */);
+  p = test_bpf_pbuf(f, 100);
+  fail_unless(bpf_filter(&test_bpf_dns_prog, p) == 0);
+  pbuf_free(p);
+  test_bpf_udp_frame(f, 100, 53, 0);
+  p = test_bpf_pbuf(f, SIZEOF_ETH_HDR + IP_HLEN + 3);
+  fail_unless(bpf_filter(&test_bpf_dns_prog, p) == 0);
+  pbuf_free(p);
+
+  for (i = 0; i < 200; i++) {
+    u16_t len = (u16_t)(20 + rand() % 150);
+    test_bpf_udp_frame(f, len, (u16_t)(50 + rand() % 8), (u16_t)(rand() % 4 == 0 ? 0x2000 : 0));
+    for (k = SIZEOF_ETH_HDR + IP_HLEN + 4; k < len; k++) {
+      f[k] = (u8_t)rand();
+    }
+    want = test_bpf_loads(insns, &loads.bf_len, f, len);
+    loads.bf_insns = insns;
+    fail_unless(bpf_validate(&loads) == ERR_OK);
+    p = test_bpf_pbuf(f, len);
+    fail_unless(bpf_filter(&loads, p) == want);
+    for (k = 0; k < 4; k++) {
+      struct pbuf *q = test_bpf_chain(f, len);
+      fail_unless(bpf_filter(&test_bpf_dns_prog, q) == bpf_filter(&test_bpf_dns_prog, p));
+      fail_unless(bpf_filter(&test_bpf_ip_prog, q) == 0xffff);
+      fail_unless(bpf_filter(&loads, q) == want);
+      pbuf_free(q);
+    }
+    pbuf_free(p);
+  }
+}
+END_TEST
+
+/** A filtered raw pcb only gets what its program accepts, the rest goes on to other pcbs */
+START_TEST(test_bpf_raw)
+{
+  static const struct bpf_insn bad[] = {
+    BPF_STMT(BPF_LD|BPF_IMM, 0),
+  };
+  const struct bpf_program bad_prog = BPF_PROGRAM(bad);
+  struct raw_pcb *all, *echo;
+  LWIP_UNUSED_ARG(_i);
+
+  all = raw_new(IP_PROTO_ICMP);
+  echo = raw_new(IP_PROTO_ICMP);
+  fail_unless((all != NULL) && (echo != NULL));
+  raw_recv(all, test_bpf_recv, (void *)0);
+  raw_recv(echo, test_bpf_recv, (void *)1);
+  fail_unless(raw_filter(echo, &test_bpf_echo_prog) == ERR_OK);
+  fail_unless(raw_filter(echo, &bad_prog) == ERR_VAL);
+  fail_unless(echo->filter == &test_bpf_echo_prog);
+
+  /* the filtered pcb is first in the list: it eats the requests, the
+     rest is seen by the catch-all pcb and then handled by ICMP */
+  ip_input(test_bpf_icmp(ICMP_ECHO), &test_netif);
+  ip_input(test_bpf_icmp(ICMP_ER), &test_netif);
+  ip_input(test_bpf_icmp(ICMP_ECHO), &test_netif);
+  ip_input(test_bpf_icmp(ICMP_DUR), &test_netif);
+  fail_unless(test_bpf_rx[1] == 2);
+  fail_unless(test_bpf_rx[0] == 2);
+
+  /* removing the filter passes everything again */
+  raw_remove(all);
+  ip_input(test_bpf_icmp(ICMP_ER), &test_netif);
+  fail_unless(test_bpf_rx[1] == 2);
+  fail_unless(raw_filter(echo, NULL) == ERR_OK);
+  ip_input(test_bpf_icmp(ICMP_ER), &test_netif);
+  fail_unless(test_bpf_rx[1] == 3);
+  fail_unless(test_bpf_sent == 0);
+  raw_remove(echo);
+}
+END_TEST
+
+/** Frames received on a netif land in its capture ring, cut to snaplen, oldest overwritten */
+START_TEST(test_bpf_ring)
+{
+  static const struct bpf_insn bad[] = {
+    BPF_STMT(BPF_RET|BPF_X, 0),
+  };
+  const struct bpf_program bad_prog = BPF_PROGRAM(bad);
+  static u32_t buf[64 + 1];
+  struct bpf_ring ring;
+  struct bpf_ring_hdr hdr;
+  u8_t f[100], out[100];
+  struct pbuf *p;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* a 64 byte snapshot takes 76 bytes: three fit */
+  fail_unless(bpf_ring_init(&ring, (u8_t *)buf + 1, 256, &test_bpf_ip_prog, 64) == ERR_OK);
+  fail_unless(ring.size == 252);
+  fail_unless(bpf_ring_init(&ring, buf, 256, &test_bpf_ip_prog, 250) == ERR_VAL);
+  fail_unless(bpf_ring_init(&ring, buf, 256, &bad_prog, 64) == ERR_VAL);
+  fail_unless(bpf_ring_init(&ring, (u8_t *)buf + 1, 256, &test_bpf_ip_prog, 64) == ERR_OK);
+  netif_set_capture(&test_netif, &ring);
+
+  for (i = 0; i < 5; i++) {
+    test_bpf_udp_frame(f, sizeof(f), 53, 0);
+    f[SIZEOF_ETH_HDR + IP_HLEN + 8] = (u8_t)i;
+    ethernet_input(test_bpf_pbuf(f, sizeof(f)), &test_netif);
+  }
+  /* ARP is not wanted */
+  f[13] = 0x06;
+  ethernet_input(test_bpf_pbuf(f, sizeof(f)), &test_netif);
+  fail_unless(ring.captured == 5);
+  fail_unless(ring.rejected == 1);
+  fail_unless(ring.overwritten == 2);
+  fail_unless(ring.count == 3);
+
+  for (i = 2; i < 5; i++) {
+    memset(out, 0xee, sizeof(out));
+    fail_unless(bpf_ring_read(&ring, &hdr, out, sizeof(out)) == ERR_OK);
+    fail_unless(hdr.len == sizeof(f));
+    fail_unless(hdr.caplen == 64);
+    fail_unless(hdr.flags == BPF_RING_IN);
+    fail_unless(out[SIZEOF_ETH_HDR + IP_HLEN + 8] == i);
+    fail_unless(out[64] == 0xee);
+  }
+  fail_unless(bpf_ring_read(&ring, &hdr, out, sizeof(out)) == ERR_BUF);
+  netif_set_capture(&test_netif, NULL);
+  ethernet_input(test_bpf_pbuf(f, sizeof(f)), &test_netif);
+  fail_unless(ring.rejected == 1);
+
+  /* records of any size wrap around, reads always return the oldest one intact */
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), NULL, 200) == ERR_OK);
+  for (i = 0; i < 5000; i++) {
+    u16_t len = (u16_t)(1 + rand() % 250);
+    int k;
+    u32_t seq = ring.captured;
+    u8_t tmp[250];
+
+    for (k = 0; k < len; k++) {
+      tmp[k] = (u8_t)(seq * 7 + k);
+    }
+    p = test_bpf_chain(tmp, len);
+    bpf_ring_add(&ring, p, BPF_RING_IN);
+    pbuf_free(p);
+    fail_unless(ring.captured == seq + 1);
+    fail_unless(ring.count <= ring.captured);
+    if (rand() % 3 == 0) {
+      u8_t rd[200];
+      /* the oldest record neither read nor overwritten */
+      u32_t oldest = ring.captured - ring.count;
+      fail_unless(bpf_ring_read(&ring, &hdr, rd, sizeof(rd)) == ERR_OK);
+      fail_unless(hdr.caplen == LWIP_MIN(hdr.len, 200));
+      for (k = 0; k < hdr.caplen; k++) {
+        fail_unless(rd[k] == (u8_t)(oldest * 7 + k));
+      }
+    }
+  }
+}
+END_TEST
+
+/** Cost of running a filter per packet */
+START_TEST(test_bpf_speed)
+{
+  static u32_t buf[1024];
+  struct bpf_ring ring;
+  struct pbuf *p, *q;
+  u8_t f[128];
+  volatile u32_t sink = 0;
+  clock_t start;
+  double secs[4];
+  int k, reps = 2000000;
+  LWIP_UNUSED_ARG(_i);
+
+  test_bpf_udp_frame(f, sizeof(f), 53, 0);
+  p = test_bpf_pbuf(f, sizeof(f));
+  /* UDP header in the second pbuf, as after a split DMA buffer */
+  q = pbuf_alloc(PBUF_RAW, SIZEOF_ETH_HDR + IP_HLEN + 1, PBUF_RAM);
+  memcpy(q->payload, f, q->len);
+  pbuf_cat(q, test_bpf_pbuf(f + q->len, (u16_t)(sizeof(f) - q->len)));
+  fail_unless(bpf_filter(&test_bpf_dns_prog, q) == 0x40000);
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), &test_bpf_dns_prog, 64) == ERR_OK);
+
+  start = clock();
+  for (k = 0; k < reps; k++) {
+    sink += bpf_filter(&test_bpf_ip_prog, p);
+  }
+  secs[0] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  start = clock();
+  for (k = 0; k < reps; k++) {
+    sink += bpf_filter(&test_bpf_dns_prog, p);
+  }
+  secs[1] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  start = clock();
+  for (k = 0; k < reps; k++) {
+    sink += bpf_filter(&test_bpf_dns_prog, q);
+  }
+  secs[2] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  start = clock();
+  for (k = 0; k < reps; k++) {
+    bpf_ring_add(&ring, p, BPF_RING_IN);
+  }
+  secs[3] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  printf("BPF filter per packet: ip %.1f ns, \"udp dst port 53\" %.1f ns (split pbuf %.1f ns), ring capture of 64 bytes %.1f ns\n",
+    secs[0] * 1e9 / reps, secs[1] * 1e9 / reps, secs[2] * 1e9 / reps, secs[3] * 1e9 / reps);
+  fail_unless(ring.captured == (u32_t)reps);
+  pbuf_free(p);
+  pbuf_free(q);
+  LWIP_UNUSED_ARG(sink);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+bpf_suite(void)
+{
+  TFun tests[] = {
+    test_bpf_validate,
+    test_bpf_filter,
+    test_bpf_raw,
+    test_bpf_ring,
+    test_bpf_speed
+  };
+  return create_suite("BPF", tests, sizeof(tests)/sizeof(TFun), bpf_setup, bpf_teardown);
+}
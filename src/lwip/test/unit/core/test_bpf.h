@@ -0,0 +1,8 @@
+#ifndef __TEST_BPF_H__
+#define __TEST_BPF_H__
+
+#include "../lwip_check.h"
+
+Suite *bpf_suite(void);
+
+#endif
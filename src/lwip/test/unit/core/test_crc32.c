@@ -0,0 +1,309 @@
+#include "test_crc32.h"
+
+#include "lwip/crc32.h"
+#include "lwip/pbuf.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !LWIP_CRC32
+#error "This tests needs LWIP_CRC32"
+#endif
+
+/* Register model of the STM32F4 CRC unit that the engine from ports/crc
+ * is built against on the host: 32-bit words, MSB first, polynomial
+ * 0x04C11DB7, reset value 0xFFFFFFFF, no reflection. */
+
+#define CRC_CR_RESET        0x01
+
+struct test_crc_model {
+  u32_t dr;
+  /* words written as data (including the one that loads the state) */
+  u32_t words, resets;
+};
+
+static struct test_crc_model model;
+
+static void
+test_crc_wr_CR(u32_t val)
+{
+  if (val & CRC_CR_RESET) {
+    model.dr = 0xFFFFFFFFUL;
+    model.resets++;
+  }
+}
+
+static void
+test_crc_wr_DR(u32_t val)
+{
+  u32_t r = model.dr ^ val;
+  int i;
+
+  for (i = 0; i < 32; i++) {
+    r = (r & 0x80000000UL) ? ((r << 1) ^ 0x04C11DB7UL) : (r << 1);
+  }
+  model.dr = r;
+  model.words++;
+}
+
+static u32_t
+test_crc_rd_DR(void)
+{
+  return model.dr;
+}
+
+static u32_t
+test_crc_rbit(u32_t x)
+{
+  u32_t r = 0;
+  int i;
+
+  for (i = 0; i < 32; i++, x >>= 1) {
+    r = (r << 1) | (x & 1);
+  }
+  return r;
+}
+
+#define CRC_REG_MODEL               1
+#define CRC_REG_WR(reg, val)        test_crc_wr_##reg(val)
+#define CRC_REG_RD(reg)             test_crc_rd_##reg()
+#define CRC_RBIT(x)                 test_crc_rbit(x)
+
+#include "../../../ports/crc/crc32_hw.c"
+
+static u8_t data[65536 + 8];
+
+/* Helper functions */
+
+/** Bit at a time, straight from the definition */
+static u32_t
+test_crc32_ref(u32_t crc, const u8_t *p, u32_t len)
+{
+  int i;
+
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+    }
+  }
+  return ~crc;
+}
+
+/** crc32() over 'len' bytes in chunks of random size (1..maxchunk) */
+static u32_t
+test_crc32_chunks(const u8_t *p, u32_t len, u32_t maxchunk)
+{
+  u32_t crc = 0, n;
+
+  while (len > 0) {
+    n = 1 + (u32_t)rand() % maxchunk;
+    if (n > len) {
+      n = len;
+    }
+    crc = crc32(crc, p, n);
+    p += n;
+    len -= n;
+  }
+  return crc;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+crc32_setup(void)
+{
+  srand(802);
+  memset(&model, 0, sizeof(model));
+  CRC32_HW_Init();
+}
+
+static void
+crc32_teardown(void)
+{
+  EXPECT(CRC_Busy == 0);
+  crc32_set_engine(NULL, 0);
+}
+
+
+/* Test functions */
+
+/** Known values, in software and through the CRC unit */
+START_TEST(test_crc32_vectors)
+{
+  static const char *const msgs[] = {
+    "",
+    "a",
+    "123456789",
+    "The quick brown fox jumps over the lazy dog",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+  };
+  static const u32_t crcs[] = {
+    0x00000000UL, 0xe8b7be43UL, 0xcbf43926UL, 0x414fa339UL, 0xea064a40UL
+  };
+  u32_t len, words;
+  int pass, i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (pass = 0; pass < 2; pass++) {
+    crc32_set_engine(pass ? CRC32_HW_Update : NULL, 0);
+    for (i = 0; i < (int)(sizeof(msgs) / sizeof(msgs[0])); i++) {
+      len = (u32_t)strlen(msgs[i]);
+      memcpy(data + 1, msgs[i], len);
+      EXPECT(test_crc32_ref(0, data + 1, len) == crcs[i]);
+      EXPECT(crc32_sw(0, data + 1, len) == crcs[i]);
+      words = model.words;
+      EXPECT(crc32(0, data + 1, len) == crcs[i]);
+      if (pass && (len >= 8)) {
+        EXPECT(model.words > words);
+      }
+      EXPECT(test_crc32_chunks(data + 1, len, 5) == crcs[i]);
+    }
+  }
+}
+END_TEST
+
+/** Random lengths, chunking and alignment: software and the CRC unit
+ * agree with the bitwise definition */
+START_TEST(test_crc32_stream)
+{
+  u32_t len, off, ref, i;
+  int r;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (u8_t)rand();
+  }
+  for (r = 0; r < 300; r++) {
+    len = (u32_t)rand() % 3000;
+    off = (u32_t)rand() & 7;
+    ref = test_crc32_ref(0, data + off, len);
+
+    crc32_set_engine(NULL, 0);
+    EXPECT(crc32(0, data + off, len) == ref);
+    EXPECT(test_crc32_chunks(data + off, len, 1 + (u32_t)rand() % 700) == ref);
+    crc32_set_engine(CRC32_HW_Update, (u32_t)rand() % 64);
+    EXPECT(crc32(0, data + off, len) == ref);
+    EXPECT(test_crc32_chunks(data + off, len, 1 + (u32_t)rand() % 700) == ref);
+  }
+  EXPECT(model.words > 0);
+}
+END_TEST
+
+/** Chains of pbufs of odd sizes, from any offset */
+START_TEST(test_crc32_pbuf)
+{
+  struct pbuf *p, *q;
+  u16_t len, n, off, done;
+  int r;
+  LWIP_UNUSED_ARG(_i);
+
+  for (r = 0; r < 100; r++) {
+    len = (u16_t)(1 + rand() % 4000);
+    p = NULL;
+    for (done = 0; done < len; done += n) {
+      n = (u16_t)(1 + rand() % 333);
+      if (n > len - done) {
+        n = (u16_t)(len - done);
+      }
+      q = pbuf_alloc(PBUF_RAW, n, PBUF_RAM);
+      EXPECT_RET(q != NULL);
+      memcpy(q->payload, data + done, n);
+      if (p == NULL) {
+        p = q;
+      } else {
+        pbuf_cat(p, q);
+      }
+    }
+    off = (u16_t)(rand() % len);
+    crc32_set_engine((r & 1) ? CRC32_HW_Update : NULL, CRC32_HW_MIN);
+    EXPECT(crc32_pbuf(0, p, 0, len) == test_crc32_ref(0, data, len));
+    EXPECT(crc32_pbuf(0, p, off, (u16_t)(len - off)) == test_crc32_ref(0, data + off, len - off));
+    /* continued over a split, and a length past the end of the chain */
+    EXPECT(crc32_pbuf(crc32_pbuf(0, p, 0, off), p, off, 0xffff) == test_crc32_ref(0, data, len));
+    pbuf_free(p);
+  }
+}
+END_TEST
+
+/** While the CRC unit is taken the engine computes in software */
+START_TEST(test_crc32_busy)
+{
+  u32_t words, ref;
+  LWIP_UNUSED_ARG(_i);
+
+  ref = test_crc32_ref(0, data + 3, 1000);
+  CRC_Busy = 1;
+  words = model.words;
+  EXPECT(crc32(0, data + 3, 1000) == ref);
+  EXPECT(model.words == words);
+  CRC_Busy = 0;
+  EXPECT(crc32(0, data + 3, 1000) == ref);
+  /* 1 word loads the state, 249 words of data, 1 + 0 bytes in software */
+  EXPECT(model.words == words + 250);
+
+  /* short runs stay in software */
+  words = model.words;
+  EXPECT(crc32(0, data, CRC32_HW_MIN - 1) == test_crc32_ref(0, data, CRC32_HW_MIN - 1));
+  EXPECT(model.words == words);
+}
+END_TEST
+
+/** Software throughput per buffer size (slicing-by-8 against the bitwise
+ * loop), and how much of each buffer the CRC unit takes */
+START_TEST(test_crc32_speed)
+{
+  static const u32_t sizes[] = {64, 256, 1500, 4096, 65536};
+  volatile u32_t sink = 0;
+  clock_t start;
+  double secs, secs_ref;
+  u32_t words;
+  int s, r, reps;
+  LWIP_UNUSED_ARG(_i);
+
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    reps = (int)(64000000 / (sizes[s] + 64));
+    start = clock();
+    for (r = 0; r < reps; r++) {
+      sink += crc32_sw(0, data + 1, sizes[s]);
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    reps /= 16;
+    start = clock();
+    for (r = 0; r < reps; r++) {
+      sink += test_crc32_ref(0, data + 1, sizes[s]);
+    }
+    secs_ref = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    words = model.words;
+    EXPECT(crc32(0, data + 1, sizes[s]) == crc32_sw(0, data + 1, sizes[s]));
+    printf("CRC-32 %5d bytes: software %.1f MB/s, bitwise %.1f MB/s; CRC unit: %d words, %d bytes in software\n",
+      (int)sizes[s],
+      secs > 0 ? (double)sizes[s] * reps * 16 / secs / 1e6 : 0.0,
+      secs_ref > 0 ? (double)sizes[s] * reps / secs_ref / 1e6 : 0.0,
+      (int)(model.words - words), (int)(sizes[s] - 4 * (model.words - words - 1)));
+  }
+  LWIP_UNUSED_ARG(sink);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+crc32_suite(void)
+{
+  TFun tests[] = {
+    test_crc32_vectors,
+    test_crc32_stream,
+    test_crc32_pbuf,
+    test_crc32_busy,
+    test_crc32_speed
+  };
+  return create_suite("CRC32", tests, sizeof(tests)/sizeof(TFun), crc32_setup, crc32_teardown);
+}
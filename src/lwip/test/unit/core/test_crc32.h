@@ -0,0 +1,8 @@
+#ifndef __TEST_CRC32_H__
+#define __TEST_CRC32_H__
+
+#include "../lwip_check.h"
+
+Suite *crc32_suite(void);
+
+#endif
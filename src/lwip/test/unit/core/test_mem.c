@@ -6,8 +6,8 @@
 #if !LWIP_STATS || !MEM_STATS
 #error "This tests needs MEM-statistics enabled"
 #endif
-#if LWIP_DNS
-#error "This test needs DNS turned off (as it mallocs on init)"
+#if LWIP_DNS && MEMP_MEM_MALLOC
+#error "This test needs DNS turned off (its pcb is malloced on init with MEMP_MEM_MALLOC)"
 #endif
 
 /* Setups/teardown functions */
@@ -35,8 +35,8 @@ START_TEST(test_mem_one)
   mem_size_t s1, s2;
   LWIP_UNUSED_ARG(_i);
 
-#if LWIP_DNS
-  fail("This test needs DNS turned off (as it mallocs on init)");
+#if LWIP_DNS && MEMP_MEM_MALLOC
+  fail("This test needs DNS turned off (its pcb is malloced on init with MEMP_MEM_MALLOC)");
 #endif
 
   fail_unless(lwip_stats.mem.used == 0);
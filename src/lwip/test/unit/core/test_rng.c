@@ -0,0 +1,546 @@
+#include "test_rng.h"
+
+#include "lwip/rng.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/sys.h"
+#include "../tcp/tcp_helper.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !LWIP_RNG || !LWIP_TCP || !TCP_RANDOM_LOCAL_PORTS
+#error "This tests needs LWIP_RNG, LWIP_TCP and TCP_RANDOM_LOCAL_PORTS"
+#endif
+
+/* Register model of the STM32F4 RNG that the source from ports/rng is
+ * built against on the host. DR delivers an LCG sequence; seed errors,
+ * clock errors and repeated words can be injected. */
+
+#define RNG_CR_RNGEN        0x04
+#define RNG_SR_DRDY         0x01
+#define RNG_SR_CECS         0x02
+#define RNG_SR_SECS         0x04
+#define RNG_SR_CEIS         0x20
+#define RNG_SR_SEIS         0x40
+
+struct test_rng_model {
+  u32_t cr, sr_is, dr;
+  u32_t reads, restarts;
+  /* injected faults */
+  u8_t seed_err, clock_err, repeat;
+};
+
+static struct test_rng_model model;
+
+static void
+test_rng_wr_CR(u32_t val)
+{
+  if ((val & RNG_CR_RNGEN) && !(model.cr & RNG_CR_RNGEN)) {
+    /* a restart clears a seed error */
+    model.seed_err = 0;
+    model.restarts++;
+  }
+  model.cr = val;
+}
+
+static void
+test_rng_wr_SR(u32_t val)
+{
+  /* SEIS and CEIS are cleared by writing 0 */
+  model.sr_is &= val;
+}
+
+static u32_t
+test_rng_rd_SR(void)
+{
+  u32_t sr = model.sr_is;
+
+  if (model.seed_err) {
+    sr |= RNG_SR_SECS | RNG_SR_SEIS;
+  }
+  if (model.clock_err) {
+    sr |= RNG_SR_CECS | RNG_SR_CEIS;
+  }
+  if ((model.cr & RNG_CR_RNGEN) && !model.seed_err && !model.clock_err) {
+    sr |= RNG_SR_DRDY;
+  }
+  return sr;
+}
+
+static u32_t
+test_rng_rd_DR(void)
+{
+  model.reads++;
+  if (model.repeat) {
+    model.repeat--;
+  } else {
+    model.dr = model.dr * 1664525UL + 1013904223UL;
+  }
+  return model.dr;
+}
+
+#define RNG_REG_MODEL               1
+#define RNG_REG_WR(reg, val)        test_rng_wr_##reg(val)
+#define RNG_REG_RD(reg)             test_rng_rd_##reg()
+
+#include "../../../ports/rng/rng_hw.c"
+
+#define TEST_PORT_RANGE     (0x10000 - 0xc000)
+
+/* Helper functions */
+
+static u32_t test_src_next;
+static u32_t test_src_fail_after;
+
+/** Entropy source for the pool tests: counts up, fails after a while */
+static err_t
+test_rng_source(u32_t *word)
+{
+  if (test_src_fail_after == 0) {
+    return ERR_IF;
+  }
+  test_src_fail_after--;
+  *word = test_src_next++;
+  return ERR_OK;
+}
+
+/** ISN of a 4-tuple minus the 4 us clock, i.e. the keyed hash alone */
+static u32_t
+test_rng_isn_offset(u32_t local, u16_t lport, u32_t remote, u16_t rport)
+{
+  ip_addr_t l, r;
+  u32_t now, isn;
+
+  l.addr = local;
+  r.addr = remote;
+  do {
+    now = sys_now();
+    isn = tcp_isn_rfc6528(&l, lport, &r, rport);
+  } while (sys_now() != now);
+  return isn - now * 250;
+}
+
+/** A pcb outside of memp, for putting thousands of them on the lists */
+static struct tcp_pcb *
+test_rng_pcb(void)
+{
+  struct tcp_pcb *pcb = (struct tcp_pcb *)calloc(1, sizeof(struct tcp_pcb));
+  fail_unless(pcb != NULL);
+  return pcb;
+}
+
+/** Take all (calloc'ed) pcbs off the bound list */
+static void
+test_rng_unbind_all(void)
+{
+  struct tcp_pcb *pcb;
+
+  while (tcp_bound_pcbs != NULL) {
+    pcb = tcp_bound_pcbs;
+    TCP_RMV(&tcp_bound_pcbs, pcb);
+    free(pcb);
+  }
+}
+
+/** Bind pcbs with port 0 until the range is exhausted, return how many */
+static u32_t
+test_rng_fill_range(void)
+{
+  struct tcp_pcb *pcb;
+  u32_t n = 0;
+
+  for (;;) {
+    pcb = test_rng_pcb();
+    if (tcp_bind(pcb, IP_ADDR_ANY, 0) != ERR_OK) {
+      free(pcb);
+      return n;
+    }
+    n++;
+  }
+}
+
+/** Find the bound pcb using 'port' */
+static struct tcp_pcb *
+test_rng_find_bound(u16_t port)
+{
+  struct tcp_pcb *pcb;
+
+  for (pcb = tcp_bound_pcbs; pcb != NULL; pcb = pcb->next) {
+    if (pcb->local_port == port) {
+      return pcb;
+    }
+  }
+  return NULL;
+}
+
+/** The allocator tcp.c had before the bitmap: next port, walk all lists */
+static u16_t
+test_rng_legacy_port(void)
+{
+  static u16_t port = 0xc000;
+  struct tcp_pcb ** const lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs,
+                                     &tcp_active_pcbs, &tcp_tw_pcbs};
+  struct tcp_pcb *pcb;
+  u16_t n = 0;
+  u8_t i;
+
+again:
+  if (port++ == 0xffff) {
+    port = 0xc000;
+  }
+  for (i = 0; i < 4; i++) {
+    for (pcb = *lists[i]; pcb != NULL; pcb = pcb->next) {
+      if (pcb->local_port == port) {
+        if (++n > 0x3fff) {
+          return 0;
+        }
+        goto again;
+      }
+    }
+  }
+  return port;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+rng_setup(void)
+{
+  rng_set_source(NULL);
+  rng_seed(6528);
+  memset(&rng_stats, 0, sizeof(rng_stats));
+  memset(&model, 0, sizeof(model));
+  tcp_remove_all();
+}
+
+static void
+rng_teardown(void)
+{
+  test_rng_unbind_all();
+  tcp_remove_all();
+  rng_set_source(NULL);
+}
+
+
+/* Test functions */
+
+/** The pool hands out source words, the generator steps in without one */
+START_TEST(test_rng_pool)
+{
+  u32_t a[8], b[8];
+  u8_t bytes[7];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* no source: deterministic for a given seed */
+  for (i = 0; i < 8; i++) {
+    a[i] = rng_u32();
+  }
+  rng_seed(6528);
+  for (i = 0; i < 8; i++) {
+    b[i] = rng_u32();
+  }
+  fail_unless(memcmp(a, b, sizeof(a)) == 0);
+  fail_unless(a[0] != a[1]);
+  fail_unless(rng_stats.fallback == 16);
+  rng_seed(6529);
+  fail_unless(rng_u32() != a[0]);
+
+  /* a source fills the pool right away */
+  test_src_next = 1000;
+  test_src_fail_after = 0xffffffffUL;
+  rng_set_source(test_rng_source);
+  fail_unless(rng_stats.refills == RNG_POOL_SIZE);
+  fail_unless(rng_refill() == RNG_POOL_SIZE);
+  for (i = RNG_POOL_SIZE - 1; i >= 0; i--) {
+    fail_unless(rng_u32() == 1000 + (u32_t)i);
+  }
+  /* empty: refilled on demand */
+  fail_unless(rng_u32() == 1000 + 2 * RNG_POOL_SIZE - 1);
+  fail_unless(rng_stats.refills == 2 * RNG_POOL_SIZE);
+
+  /* a failing source leaves the rest to the generator */
+  rng_seed(1);
+  rng_stats.fallback = 0;
+  test_src_fail_after = 3;
+  for (i = 0; i < 3; i++) {
+    fail_unless(rng_u32() >= 1000);
+  }
+  fail_unless(rng_stats.errors == 1);
+  fail_unless(rng_stats.fallback == 0);
+  rng_u32();
+  fail_unless(rng_stats.fallback == 1);
+  fail_unless(rng_stats.errors == 2);
+
+  /* bytes come out of whole words, little end first */
+  test_src_next = 0x04030201UL;
+  test_src_fail_after = 2;
+  rng_bytes(bytes, sizeof(bytes));
+  fail_unless((bytes[0] == 0x02) && (bytes[1] == 0x02) && (bytes[2] == 0x03) && (bytes[3] == 0x04));
+  fail_unless((bytes[4] == 0x01) && (bytes[5] == 0x02) && (bytes[6] == 0x03));
+}
+END_TEST
+
+/** HalfSipHash-2-4 against the reference vectors */
+START_TEST(test_rng_hash)
+{
+  static const u32_t key[2] = {0x03020100UL, 0x07060504UL};
+  static const u32_t vectors[] = {0x5b9f35a9UL, 0xb85a4727UL, 0x03a662faUL};
+  u8_t msg[16];
+  u32_t h;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(msg); i++) {
+    msg[i] = (u8_t)i;
+  }
+  for (i = 0; i < (int)(sizeof(vectors) / sizeof(vectors[0])); i++) {
+    fail_unless(rng_hash(key, msg, (u16_t)i) == vectors[i]);
+  }
+  /* every length and every input byte matters */
+  for (i = 4; i < (int)sizeof(msg); i++) {
+    fail_unless(rng_hash(key, msg, (u16_t)i) != rng_hash(key, msg, (u16_t)(i - 1)));
+  }
+  h = rng_hash(key, msg, 12);
+  msg[11] ^= 1;
+  fail_unless(rng_hash(key, msg, 12) != h);
+}
+END_TEST
+
+/** The STM32 RNG source: first word discarded, repeats and errors rejected */
+START_TEST(test_rng_hw)
+{
+  u32_t expect, r;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  model.dr = 42;
+  RNG_HW_Init();
+  fail_unless(model.cr == RNG_CR_RNGEN);
+  fail_unless(model.restarts == 1);
+  /* one word for the continuous test, then a full pool */
+  fail_unless(model.reads == 1 + RNG_POOL_SIZE);
+  fail_unless(rng_stats.refills == RNG_POOL_SIZE);
+
+  /* the pool gives the newest word first */
+  expect = model.dr;
+  r = rng_u32();
+  fail_unless(r == expect);
+
+  /* a repeated word is dropped, the rest of the pool is still good */
+  for (i = 1; i < RNG_POOL_SIZE; i++) {
+    rng_u32();
+  }
+  model.repeat = 1;
+  rng_refill();
+  fail_unless(rng_stats.errors == 1);
+  fail_unless(rng_refill() == RNG_POOL_SIZE);
+  fail_unless(rng_stats.fallback == 0);
+
+  /* a seed error restarts the RNG, the generator fills in meanwhile */
+  for (i = 0; i < RNG_POOL_SIZE; i++) {
+    rng_u32();
+  }
+  model.seed_err = 1;
+  rng_u32();
+  fail_unless(model.restarts == 2);
+  fail_unless(rng_stats.fallback == 1);
+  fail_unless(rng_refill() == RNG_POOL_SIZE);
+
+  /* a clock error makes the pool fall back until the clock is back */
+  for (i = 0; i < RNG_POOL_SIZE; i++) {
+    rng_u32();
+  }
+  model.clock_err = 1;
+  rng_u32();
+  fail_unless(rng_stats.fallback == 2);
+  fail_unless(model.restarts == 2);
+  model.clock_err = 0;
+  fail_unless(rng_refill() == RNG_POOL_SIZE);
+}
+END_TEST
+
+/** RFC 6528 ISNs: a keyed hash per 4-tuple on top of the clock */
+START_TEST(test_rng_isn)
+{
+  u32_t l = PP_HTONL(0xc0a80101UL), r = PP_HTONL(0xc0a80102UL);
+  u32_t base, isn[4];
+  int i, j;
+  LWIP_UNUSED_ARG(_i);
+
+  base = test_rng_isn_offset(l, 0xc000, r, 80);
+  /* stable for one tuple, so a reconnect only moves with the clock */
+  fail_unless(test_rng_isn_offset(l, 0xc000, r, 80) == base);
+  /* every part of the tuple changes it */
+  isn[0] = test_rng_isn_offset(l, 0xc001, r, 80);
+  isn[1] = test_rng_isn_offset(l, 0xc000, r, 81);
+  isn[2] = test_rng_isn_offset(r, 0xc000, r, 80);
+  isn[3] = test_rng_isn_offset(l, 0xc000, l, 80);
+  for (i = 0; i < 4; i++) {
+    fail_unless(isn[i] != base);
+    for (j = 0; j < i; j++) {
+      fail_unless(isn[i] != isn[j]);
+    }
+  }
+  /* and neighbouring ports don't give neighbouring ISNs */
+  fail_unless((u32_t)(isn[0] - base) > 0x10000UL);
+  fail_unless((u32_t)(base - isn[0]) > 0x10000UL);
+}
+END_TEST
+
+/** Ephemeral ports: unique, random and tracked exactly by the bitmap */
+START_TEST(test_rng_ports)
+{
+  struct tcp_pcb *pcb, *pcb2, *tw;
+  u16_t first, next;
+  u32_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  /* consecutive allocations don't step through the range */
+  pcb = test_rng_pcb();
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_OK);
+  first = pcb->local_port;
+  pcb = test_rng_pcb();
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_OK);
+  next = pcb->local_port;
+  fail_unless((first >= 0xc000) && (next >= 0xc000));
+  fail_unless((u16_t)(next - first) != 1);
+  test_rng_unbind_all();
+
+  /* the whole range can be handed out, each port once */
+  n = test_rng_fill_range();
+  fail_unless(n == TEST_PORT_RANGE);
+  /* explicit binds into the range see the collisions */
+  pcb = test_rng_pcb();
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0xd000) == ERR_USE);
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_BUF);
+
+  /* a released port is the only one to get */
+  pcb2 = test_rng_find_bound(0xd000);
+  fail_unless(pcb2 != NULL);
+  TCP_RMV(&tcp_bound_pcbs, pcb2);
+  free(pcb2);
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_OK);
+  fail_unless(pcb->local_port == 0xd000);
+
+  /* a port shared with a listener stays in use until both are gone */
+  pcb2 = test_rng_find_bound(0xe123);
+  fail_unless(pcb2 != NULL);
+  TCP_RMV(&tcp_bound_pcbs, pcb2);
+  pcb2->state = LISTEN;
+  TCP_REG(&tcp_listen_pcbs.pcbs, pcb2);
+  pcb = test_rng_pcb();
+  pcb->local_port = 0xe123;
+  TCP_REG_ACTIVE(pcb);
+  TCP_RMV(&tcp_listen_pcbs.pcbs, pcb2);
+  free(pcb2);
+  pcb2 = test_rng_pcb();
+  fail_unless(tcp_bind(pcb2, IP_ADDR_ANY, 0) == ERR_BUF);
+  TCP_RMV_ACTIVE(pcb);
+  free(pcb);
+  fail_unless(tcp_bind(pcb2, IP_ADDR_ANY, 0) == ERR_OK);
+  fail_unless(pcb2->local_port == 0xe123);
+
+  /* tcp_slowtmr() releases the ports of the TIME-WAIT pcbs it frees */
+  pcb2 = test_rng_find_bound(0xc042);
+  TCP_RMV(&tcp_bound_pcbs, pcb2);
+  free(pcb2);
+  tw = tcp_new();
+  fail_unless(tw != NULL);
+  tw->local_port = 0xc042;
+  tw->state = TIME_WAIT;
+  TCP_REG(&tcp_tw_pcbs, tw);
+  pcb = test_rng_pcb();
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_BUF);
+  tw->tmr = tcp_ticks - 2 * TCP_MSL / TCP_SLOW_INTERVAL - 1;
+  tcp_slowtmr();
+  fail_unless(tcp_tw_pcbs == NULL);
+  fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_OK);
+  fail_unless(pcb->local_port == 0xc042);
+
+  /* everything released: the range is free again */
+  test_rng_unbind_all();
+  n = test_rng_fill_range();
+  fail_unless(n == TEST_PORT_RANGE);
+}
+END_TEST
+
+/** Cost of a connect (port + ISN) with many connections open */
+START_TEST(test_rng_speed)
+{
+  static const u32_t open[] = {16, 256, 4096, 12288};
+  struct tcp_pcb *pcb;
+  volatile u32_t sink = 0;
+  ip_addr_t l, r;
+  clock_t start;
+  double secs, secs_old, secs_isn;
+  int s, reps, k;
+  u32_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  l.addr = PP_HTONL(0xc0a80101UL);
+  r.addr = PP_HTONL(0xc0a80102UL);
+  test_src_next = 1;
+  test_src_fail_after = 0xffffffffUL;
+  rng_set_source(test_rng_source);
+
+  start = clock();
+  for (k = 0; k < 1000000; k++) {
+    sink += tcp_isn_rfc6528(&l, (u16_t)k, &r, 80);
+  }
+  secs_isn = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  for (s = 0; s < (int)(sizeof(open) / sizeof(open[0])); s++) {
+    for (i = 0; i < open[s]; i++) {
+      pcb = test_rng_pcb();
+      fail_unless(tcp_bind(pcb, IP_ADDR_ANY, 0) == ERR_OK);
+    }
+    pcb = test_rng_pcb();
+
+    reps = 200000;
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      tcp_bind(pcb, IP_ADDR_ANY, 0);
+      TCP_RMV(&tcp_bound_pcbs, pcb);
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    reps = (int)(20000000 / (open[s] + 100));
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      pcb->local_port = test_rng_legacy_port();
+      TCP_REG(&tcp_bound_pcbs, pcb);
+      TCP_RMV(&tcp_bound_pcbs, pcb);
+    }
+    secs_old = (double)(clock() - start) / CLOCKS_PER_SEC;
+    free(pcb);
+
+    printf("TCP connect with %5d open: random port %.2f M/s, sequential port + list walk %.3f M/s, RFC 6528 ISN %.1f M/s\n",
+      (int)open[s],
+      secs > 0 ? 200000 / secs / 1e6 : 0.0,
+      secs_old > 0 ? reps / secs_old / 1e6 : 0.0,
+      secs_isn > 0 ? 1000000 / secs_isn / 1e6 : 0.0);
+    test_rng_unbind_all();
+  }
+  LWIP_UNUSED_ARG(sink);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+rng_suite(void)
+{
+  TFun tests[] = {
+    test_rng_pool,
+    test_rng_hash,
+    test_rng_hw,
+    test_rng_isn,
+    test_rng_ports,
+    test_rng_speed
+  };
+  return create_suite("RNG", tests, sizeof(tests)/sizeof(TFun), rng_setup, rng_teardown);
+}
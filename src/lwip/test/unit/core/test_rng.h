@@ -0,0 +1,8 @@
+#ifndef __TEST_RNG_H__
+#define __TEST_RNG_H__
+
+#include "../lwip_check.h"
+
+Suite *rng_suite(void);
+
+#endif
@@ -0,0 +1,475 @@
+#include "test_stats.h"
+
+#include "lwip/stats.h"
+#include "lwip/udp.h"
+#include "lwip/ip.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/netif.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_STATS || !LWIP_STATS_SNAPSHOT || !LWIP_STATS_EXPORT || !LINK_STATS || !UDP_STATS || \
+    (LWIP_STATS_SHARDS < 2)
+#error "This tests needs LWIP_STATS_SNAPSHOT, LWIP_STATS_EXPORT, LINK_STATS, UDP_STATS and LWIP_STATS_SHARDS >= 2"
+#endif
+
+#define TEST_STATS_PORT      7000
+#define TEST_STATS_COLLECTOR 7001
+#define TEST_STATS_MAX_LEN   1500
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw, test_src;
+static struct udp_pcb *test_pcb;
+static int recv_ctr;
+
+/* received frame as it sits in the MAC's DMA buffer */
+static u8_t dma_buf[TEST_STATS_MAX_LEN];
+
+/* last datagram sent through test_netif */
+static u8_t out_buf[512];
+static u16_t out_len;
+static int out_ctr;
+
+/* Helper functions */
+
+static err_t
+test_stats_netif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+  out_len = pbuf_copy_partial(p, out_buf, sizeof(out_buf), 0);
+  out_ctr++;
+  return ERR_OK;
+}
+
+static err_t
+test_stats_netif_init(struct netif *netif)
+{
+  netif->output = test_stats_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_UP | NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+static void
+test_stats_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+  recv_ctr++;
+  pbuf_free(p);
+}
+
+/** Put an IP + UDP datagram to test_pcb with 'payload' bytes into dma_buf */
+static u16_t
+test_stats_dma_frame(u16_t payload)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)dma_buf;
+  struct udp_hdr *udphdr = (struct udp_hdr *)(dma_buf + IP_HLEN);
+  u16_t len = IP_HLEN + UDP_HLEN + payload;
+
+  fail_unless(len <= sizeof(dma_buf));
+  memset(dma_buf, 0x5a, len);
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, htons(len));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip_addr_copy(iphdr->src, test_src);
+  ip_addr_copy(iphdr->dest, test_ipaddr);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  udphdr->src = PP_HTONS(TEST_STATS_COLLECTOR);
+  udphdr->dest = PP_HTONS(TEST_STATS_PORT);
+  udphdr->len = htons(UDP_HLEN + payload);
+  udphdr->chksum = 0;
+  return len;
+}
+
+/** Copy the frame out of dma_buf like low_level_input() does */
+static struct pbuf *
+test_stats_rx(u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+
+  fail_unless(p != NULL);
+  memcpy(p->payload, dma_buf, len);
+  return p;
+}
+
+/** Read one LEB128 varint of a stats_export() datagram */
+static u32_t
+test_stats_varint(const u8_t *buf, u16_t len, u16_t *pos)
+{
+  u32_t v = 0;
+  u8_t shift = 0;
+
+  for (;;) {
+    u8_t b;
+    fail_unless(*pos < len);
+    b = buf[(*pos)++];
+    v |= (u32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return v;
+    }
+    shift += 7;
+  }
+}
+
+/** Find a section of a stats_export() datagram and decode up to 'max' values
+ * @return the section's value count, -1 if not found */
+static int
+test_stats_section(const u8_t *buf, u16_t len, u8_t id, u32_t *values, int max)
+{
+  u16_t pos = 8;
+  u8_t s;
+
+  for (s = 0; s < buf[1]; s++) {
+    u8_t sid = buf[pos++];
+    u32_t count = test_stats_varint(buf, len, &pos);
+    u32_t i;
+    for (i = 0; i < count; i++) {
+      u32_t v = test_stats_varint(buf, len, &pos);
+      if ((sid == id) && ((int)i < max)) {
+        values[i] = v;
+      }
+    }
+    if (sid == id) {
+      return (int)count;
+    }
+  }
+  fail_unless(pos == len);
+  return -1;
+}
+
+/** Sum up the differences of the STAT_COUNTERs in 'size' bytes at 'a' and 'b' */
+static u32_t
+test_stats_diff(const void *a, const void *b, u16_t size)
+{
+  const STAT_COUNTER *ca = (const STAT_COUNTER *)a;
+  const STAT_COUNTER *cb = (const STAT_COUNTER *)b;
+  u32_t sum = 0;
+  u16_t i;
+
+  for (i = 0; i < size / sizeof(STAT_COUNTER); i++) {
+    sum += (STAT_COUNTER)(cb[i] - ca[i]);
+  }
+  return sum;
+}
+
+/** Number of packet counter updates (the sharded ones) from 'a' to 'b' */
+static u32_t
+test_stats_packet_updates(const struct stats_ *a, const struct stats_ *b)
+{
+  u32_t sum = test_stats_diff(&a->link, &b->link, sizeof(a->link));
+  sum += (a->link_octets.recv != b->link_octets.recv) ? 1 : 0;
+  sum += (a->link_octets.xmit != b->link_octets.xmit) ? 1 : 0;
+#if ETHARP_STATS
+  sum += test_stats_diff(&a->etharp, &b->etharp, sizeof(a->etharp));
+#endif
+#if IPFRAG_STATS
+  sum += test_stats_diff(&a->ip_frag, &b->ip_frag, sizeof(a->ip_frag));
+#endif
+#if IP_STATS
+  sum += test_stats_diff(&a->ip, &b->ip, sizeof(a->ip));
+#endif
+#if ICMP_STATS
+  sum += test_stats_diff(&a->icmp, &b->icmp, sizeof(a->icmp));
+#endif
+  sum += test_stats_diff(&a->udp, &b->udp, sizeof(a->udp));
+#if TCP_STATS
+  sum += test_stats_diff(&a->tcp, &b->tcp, sizeof(a->tcp));
+#endif
+  return sum;
+}
+
+/* Setups/teardown functions */
+
+static void
+stats_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192, 168, 1, 18);
+  IP4_ADDR(&test_netmask, 255, 255, 255, 0);
+  IP4_ADDR(&test_gw, 192, 168, 1, 1);
+  IP4_ADDR(&test_src, 192, 168, 1, 2);
+  fail_unless(netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw,
+    NULL, test_stats_netif_init, ip_input) != NULL);
+  netif_set_up(&test_netif);
+  test_pcb = udp_new();
+  fail_unless(test_pcb != NULL);
+  fail_unless(udp_bind(test_pcb, IP_ADDR_ANY, TEST_STATS_PORT) == ERR_OK);
+  udp_recv(test_pcb, test_stats_recv, NULL);
+  recv_ctr = 0;
+  out_ctr = 0;
+  memset(&lwip_stats.link, 0, sizeof(lwip_stats.link));
+  memset(&lwip_stats.link_octets, 0, sizeof(lwip_stats.link_octets));
+  memset(lwip_stats_shards, 0, sizeof(lwip_stats_shards));
+  test_sys_arch_in_isr = 0;
+}
+
+static void
+stats_teardown(void)
+{
+  udp_remove(test_pcb);
+  netif_remove(&test_netif);
+}
+
+
+/* Test functions */
+
+/** Packet counters go to the shard of the updating context and are added up
+ * by a snapshot, the other updates are sequenced; a snapshot is a consistent
+ * copy and a sequenced update in progress is never copied */
+START_TEST(test_stats_snapshot)
+{
+  static struct stats_ snap;
+  u32_t seq;
+  STAT_COUNTER udp_drop;
+  LWIP_UNUSED_ARG(_i);
+
+  seq = lwip_stats_seq;
+  EXPECT((seq & 1) == 0);
+  udp_drop = lwip_stats.udp.drop;
+  LINK_STATS_INC(link.recv);
+  LINK_STATS_OCTETS(recv, 60);
+  UDP_STATS_INC(udp.drop);
+  EXPECT(lwip_stats_seq == seq);
+  EXPECT(lwip_stats.link.recv == 1);
+  EXPECT(lwip_stats.link_octets.recv == 60);
+  MEMP_STATS_INC(err, MEMP_PBUF);
+  MEMP_STATS_DEC(err, MEMP_PBUF);
+  EXPECT(lwip_stats_seq == seq + 4);
+
+  EXPECT(stats_snapshot(&snap) == ERR_OK);
+  EXPECT(memcmp(&snap, &lwip_stats, sizeof(snap)) == 0);
+
+  /* the same from an interrupt: only a snapshot sees it */
+  test_sys_arch_in_isr = 1;
+  LINK_STATS_INC(link.recv);
+  LINK_STATS_OCTETS(recv, 40);
+  UDP_STATS_INC(udp.drop);
+  test_sys_arch_in_isr = 0;
+  EXPECT(lwip_stats_seq == seq + 4);
+  EXPECT(lwip_stats.link.recv == 1);
+  EXPECT(lwip_stats_shards[0].link.recv == 1);
+  EXPECT(stats_snapshot(&snap) == ERR_OK);
+  EXPECT(snap.link.recv == 2);
+  EXPECT(snap.link_octets.recv == 100);
+  EXPECT(snap.udp.drop == (STAT_COUNTER)(udp_drop + 2));
+  EXPECT(memcmp(&snap.memp, &lwip_stats.memp, sizeof(snap.memp)) == 0);
+
+  /* interrupted in the middle of an update: give up instead of spinning */
+  lwip_stats_seq++;
+  EXPECT(stats_snapshot(&snap) == ERR_WOULDBLOCK);
+  lwip_stats_seq++;
+  EXPECT(stats_snapshot(&snap) == ERR_OK);
+}
+END_TEST
+
+/** Encode a snapshot, decode it again and send one over UDP */
+START_TEST(test_stats_export)
+{
+  static struct stats_ snap;
+  static u8_t buf[512];
+  u32_t v[16];
+  u16_t len, udp_xmit;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  lwip_stats.link.recv = 300;
+  lwip_stats.link.drop = 5;
+  lwip_stats.link_octets.recv = 0x12345678UL;
+  lwip_stats.link_octets.xmit = 127;
+  EXPECT_RET(stats_snapshot(&snap) == ERR_OK);
+
+  len = stats_export_encode(&snap, 0x1234, 0xa0b0c0d0UL, NULL, 0);
+  EXPECT_RET(len > 8);
+  EXPECT_RET(len <= sizeof(buf));
+  EXPECT(stats_export_encode(&snap, 0x1234, 0xa0b0c0d0UL, buf, len - 1) == 0);
+  EXPECT(stats_export_encode(&snap, 0x1234, 0xa0b0c0d0UL, buf, sizeof(buf)) == len);
+  printf("STATS export: %d bytes for a %d byte struct stats_\n", len, (int)sizeof(struct stats_));
+
+  EXPECT(buf[0] == STATS_EXPORT_VERSION);
+  EXPECT(buf[2] == 0x12 && buf[3] == 0x34);
+  EXPECT(buf[4] == 0xa0 && buf[5] == 0xb0 && buf[6] == 0xc0 && buf[7] == 0xd0);
+  EXPECT(test_stats_section(buf, len, STATS_EXPORT_LINK, v, 16) ==
+    (int)(sizeof(struct stats_proto) / sizeof(STAT_COUNTER)));
+  EXPECT(v[0] == lwip_stats.link.xmit);
+  EXPECT(v[1] == 300);
+  EXPECT(v[3] == 5);
+  EXPECT(test_stats_section(buf, len, STATS_EXPORT_LINK_OCTETS, v, 16) == 2);
+  EXPECT(v[0] == 0x12345678UL);
+  EXPECT(v[1] == 127);
+  EXPECT(test_stats_section(buf, len, STATS_EXPORT_UDP, v, 16) ==
+    (int)(sizeof(struct stats_proto) / sizeof(STAT_COUNTER)));
+  EXPECT(v[0] == snap.udp.xmit);
+  EXPECT(test_stats_section(buf, len, STATS_EXPORT_MEMP, v, 16) == MEMP_MAX * 5);
+  EXPECT(test_stats_section(buf, len, 0xff, v, 16) == -1);
+
+  /* the real thing: one datagram to the collector */
+  udp_xmit = lwip_stats.udp.xmit;
+  err = stats_export(test_pcb, &test_src, TEST_STATS_COLLECTOR);
+  EXPECT(err == ERR_OK);
+  EXPECT(out_ctr == 1);
+  EXPECT(lwip_stats.udp.xmit == udp_xmit + 1);
+  EXPECT_RET(out_len > IP_HLEN + UDP_HLEN + 8);
+  len = out_len - IP_HLEN - UDP_HLEN;
+  memmove(buf, out_buf + IP_HLEN + UDP_HLEN, len);
+  EXPECT(buf[0] == STATS_EXPORT_VERSION);
+  EXPECT(test_stats_section(buf, len, STATS_EXPORT_LINK_OCTETS, v, 16) == 2);
+  EXPECT(v[0] == 0x12345678UL);
+  EXPECT(test_stats_section(buf, len, STATS_EXPORT_UDP, v, 16) > 0);
+  EXPECT(v[0] == udp_xmit);
+
+  /* the sequence number counts the datagrams sent */
+  EXPECT(stats_export(test_pcb, &test_src, TEST_STATS_COLLECTOR) == ERR_OK);
+  EXPECT(out_ctr == 2);
+  EXPECT(out_buf[IP_HLEN + UDP_HLEN + 3] == (u8_t)(buf[3] + 1));
+}
+END_TEST
+
+/** Rates over one interval, including counter wrap-around */
+START_TEST(test_stats_sample)
+{
+  struct stats_sampler sampler;
+  int k;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&sampler, 0, sizeof(sampler));
+  lwip_stats.link.recv = (STAT_COUNTER)(0 - 100);
+  lwip_stats.link_octets.recv = 0xffffff00UL;
+  EXPECT(stats_sample(&sampler, 5000) == ERR_INPROGRESS);
+  EXPECT(stats_sample(&sampler, 5000) == ERR_INPROGRESS);
+
+  /* half of them counted in the interrupt's shard */
+  for (k = 0; k < 500; k++) {
+    test_sys_arch_in_isr = (u8_t)(k & 1);
+    LINK_STATS_INC(link.recv);
+    LINK_STATS_OCTETS(recv, 1000);
+  }
+  test_sys_arch_in_isr = 0;
+  for (k = 0; k < 250; k++) {
+    LINK_STATS_INC(link.xmit);
+    LINK_STATS_OCTETS(xmit, 100);
+  }
+  test_sys_arch_in_isr = 1;
+  for (k = 0; k < 20; k++) {
+    IP_STATS_INC(ip.drop);
+    UDP_STATS_INC(udp.drop);
+  }
+  test_sys_arch_in_isr = 0;
+
+  EXPECT(stats_sample(&sampler, 7000) == ERR_OK);
+  EXPECT(sampler.rate.pps_recv == 250);
+  EXPECT(sampler.rate.pps_xmit == 125);
+  EXPECT(sampler.rate.bps_recv == 2000000);
+  EXPECT(sampler.rate.bps_xmit == 100000);
+  EXPECT(sampler.rate.drops == 20);
+
+  /* an idle interval */
+  EXPECT(stats_sample(&sampler, 8000) == ERR_OK);
+  EXPECT(sampler.rate.pps_recv == 0);
+  EXPECT(sampler.rate.bps_recv == 0);
+  EXPECT(sampler.rate.drops == 0);
+}
+END_TEST
+
+/** Time per datagram (us) of 'packets' datagrams of 'len' bytes through
+ * ip_input() and udp_input(), each followed by 'extra' additional counter
+ * updates: plain ones ('mode' 0), packet counter updates (1) or sequenced
+ * updates (2); best of a few runs */
+static double
+test_stats_packet_time(u16_t len, int packets, int extra, int mode)
+{
+  clock_t start, best = 0;
+  int run, k, e;
+
+  for (run = 0; run < 5; run++) {
+    start = clock();
+    for (k = 0; k < packets; k++) {
+      test_netif.input(test_stats_rx(len), &test_netif);
+      if (mode == 1) {
+        for (e = 0; e < extra; e++) {
+          LINK_STATS_INC(link.err);
+        }
+      } else if (mode == 2) {
+        for (e = 0; e < extra; e++) {
+          STATS_INC(link.err);
+        }
+      } else {
+        for (e = 0; e < extra; e++) {
+          ++*(volatile STAT_COUNTER *)&lwip_stats.link.err;
+        }
+      }
+    }
+    start = clock() - start;
+    if ((run == 0) || (start < best)) {
+      best = start;
+    }
+  }
+  return (double)best * 1e6 / CLOCKS_PER_SEC / packets;
+}
+
+/** Cost of the statistics compared to the time of a received datagram: the
+ * difference between packet counter (sharded) or sequenced updates and plain
+ * ones added to the receive path is what they cost per update. The target is
+ * under 1% of the datagram time. */
+START_TEST(test_stats_overhead)
+{
+  static const u16_t payloads[] = {18, 1472};
+  static struct stats_ before, after;
+  const int packets = 20000;
+  const int extra = 64;
+  double t_packet, t_shard, t_seq, t_plain;
+  u32_t seq;
+  u16_t len;
+  int n_shard, n_seq, i, k;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)(sizeof(payloads) / sizeof(payloads[0])); i++) {
+    len = test_stats_dma_frame(payloads[i]);
+
+    /* count the updates of one datagram */
+    recv_ctr = 0;
+    seq = lwip_stats_seq;
+    EXPECT(stats_snapshot(&before) == ERR_OK);
+    for (k = 0; k < 1000; k++) {
+      test_netif.input(test_stats_rx(len), &test_netif);
+    }
+    EXPECT(stats_snapshot(&after) == ERR_OK);
+    EXPECT(recv_ctr == 1000);
+    n_shard = (int)(test_stats_packet_updates(&before, &after) / 1000);
+    n_seq = (int)((lwip_stats_seq - seq) / 2 / 1000);
+    EXPECT(n_shard > 0);
+
+    t_packet = test_stats_packet_time(len, packets, 0, 0);
+    t_plain = test_stats_packet_time(len, packets, extra, 0);
+    t_shard = test_stats_packet_time(len, packets, extra, 1);
+    t_seq = test_stats_packet_time(len, packets, extra, 2);
+    t_shard = (t_shard > t_plain) ? (t_shard - t_plain) / extra : 0.0;
+    t_seq = (t_seq > t_plain) ? (t_seq - t_plain) / extra : 0.0;
+
+    printf("STATS %d byte datagram in %.3f us: %d packet counter updates "
+      "%.4f us, %d sequenced updates %.4f us each: %.3f%% (target 1%%)\n",
+      len, t_packet, n_shard, t_shard, n_seq, t_seq,
+      100.0 * (n_shard * t_shard + n_seq * t_seq) / t_packet);
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+stats_suite(void)
+{
+  TFun tests[] = {
+    test_stats_snapshot,
+    test_stats_export,
+    test_stats_sample,
+    test_stats_overhead
+  };
+  return create_suite("STATS", tests, sizeof(tests)/sizeof(TFun), stats_setup, stats_teardown);
+}
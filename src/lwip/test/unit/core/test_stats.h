@@ -0,0 +1,8 @@
+#ifndef __TEST_STATS_H__
+#define __TEST_STATS_H__
+
+#include "../lwip_check.h"
+
+Suite *stats_suite(void);
+
+#endif
@@ -0,0 +1,746 @@
+#include "test_aes_gcm.h"
+
+#include "lwip/pbuf.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* The AES-GCM record layer from ports/cryp is built on the host together
+ * with a register model of the STM32 CRYP block: AES-CTR over DMA, the
+ * counter block in IV0LR..IV1RR, keys right-aligned in K0LR..K3RR. */
+
+#include "../../../ports/cryp/aes_gcm.c"
+#include "../../../ports/cryp/aes_rec.c"
+
+/* CRYP register bits as in stm32f4xx.h */
+#define CRYP_CR_ALGODIR             0x00000004UL
+#define CRYP_CR_ALGOMODE            0x00080038UL
+#define CRYP_CR_ALGOMODE_AES_CTR    0x00000030UL
+#define CRYP_CR_DATATYPE            0x000000C0UL
+#define CRYP_CR_DATATYPE_1          0x00000080UL
+#define CRYP_CR_KEYSIZE             0x00000300UL
+#define CRYP_CR_KEYSIZE_0           0x00000100UL
+#define CRYP_CR_KEYSIZE_1           0x00000200UL
+#define CRYP_CR_FFLUSH              0x00004000UL
+#define CRYP_CR_CRYPEN              0x00008000UL
+#define CRYP_DMACR_DIEN             0x00000001UL
+#define CRYP_DMACR_DOEN             0x00000002UL
+
+struct test_cryp_model {
+  u32_t cr, dmacr;
+  u32_t key[8], iv[4];
+  int flushed;
+  /* the transfer in flight */
+  const u8_t *in;
+  u8_t *out;
+  u32_t words;
+  int running;
+  /* DMA polls until the transfer is done, fail it instead; write the
+   * output as soon as the transfer starts */
+  int dma_polls, dma_delay, dma_fail, early;
+  /* transfers, words moved, protocol errors */
+  u32_t starts, dma_words;
+  int bad;
+};
+
+static struct test_cryp_model cmodel;
+
+static void
+test_cryp_wr_CR(u32_t val)
+{
+  if (val & CRYP_CR_FFLUSH) {
+    if (val & CRYP_CR_CRYPEN) {
+      /* FFLUSH only works with the core disabled */
+      cmodel.bad++;
+    }
+    cmodel.flushed = 1;
+  }
+  cmodel.cr = val & ~CRYP_CR_FFLUSH;
+}
+
+static u32_t
+test_cryp_rd_CR(void)
+{
+  return cmodel.cr;
+}
+
+static void
+test_cryp_wr_DMACR(u32_t val)
+{
+  cmodel.dmacr = val;
+}
+
+/** AES-CTR the way the peripheral does it, with the key and counter
+ * taken from the registers */
+static void
+test_cryp_run(void)
+{
+  struct aes_gcm_key k;
+  u8_t key[32], ctr[16], ks[16];
+  u32_t nk, i, j;
+
+  nk = (cmodel.cr & CRYP_CR_KEYSIZE_1) ? 8 : ((cmodel.cr & CRYP_CR_KEYSIZE_0) ? 6 : 4);
+  for (i = 0; i < nk; i++) {
+    AES_PUT32(key + 4 * i, cmodel.key[8 - nk + i]);
+  }
+  aes_gcm_setkey(&k, key, (u8_t)(4 * nk));
+  for (i = 0; i < cmodel.words / 4; i++) {
+    for (j = 0; j < 4; j++) {
+      AES_PUT32(ctr + 4 * j, cmodel.iv[j]);
+    }
+    aes_encrypt_block(&k, ctr, ks);
+    cmodel.iv[3]++;
+    for (j = 0; j < 16; j++) {
+      cmodel.out[16 * i + j] = cmodel.in[16 * i + j] ^ ks[j];
+    }
+  }
+  cmodel.running = 0;
+}
+
+static void
+test_cryp_dma_start(const u8_t *in, u8_t *out, u32_t words)
+{
+  if ((cmodel.cr & (CRYP_CR_ALGOMODE | CRYP_CR_DATATYPE | CRYP_CR_ALGODIR)) != (CRYP_CR_ALGOMODE_AES_CTR | CRYP_CR_DATATYPE_1) ||
+      (cmodel.cr & CRYP_CR_CRYPEN) || !cmodel.flushed || (cmodel.dmacr != (CRYP_DMACR_DIEN | CRYP_DMACR_DOEN)) ||
+      (words == 0) || (words & 3) || cmodel.running) {
+    cmodel.bad++;
+  }
+  cmodel.flushed = 0;
+  cmodel.in = in;
+  cmodel.out = out;
+  cmodel.words = words;
+  cmodel.running = 1;
+  cmodel.starts++;
+  cmodel.dma_words += words;
+  cmodel.dma_polls = cmodel.dma_delay;
+  if (cmodel.early) {
+    /* the CPU must not look at this chunk until the transfer is over */
+    cmodel.cr |= CRYP_CR_CRYPEN;
+    test_cryp_run();
+    cmodel.cr &= ~CRYP_CR_CRYPEN;
+    cmodel.running = 1;
+  }
+}
+
+static int
+test_cryp_dma_poll(void)
+{
+  if (!(cmodel.cr & CRYP_CR_CRYPEN)) {
+    cmodel.bad++;
+  }
+  if (cmodel.dma_fail) {
+    cmodel.running = 0;
+    return -1;
+  }
+  if (cmodel.dma_polls-- > 0) {
+    return 0;
+  }
+  if (cmodel.running && !cmodel.early) {
+    test_cryp_run();
+  }
+  cmodel.running = 0;
+  return 1;
+}
+
+static void
+test_cryp_dma_stop(void)
+{
+  cmodel.running = 0;
+}
+
+#define CRYP_REG_MODEL                  1
+#define CRYP_REG_WR(reg, val)           test_cryp_wr_##reg(val)
+#define CRYP_REG_RD(reg)                test_cryp_rd_##reg()
+#define CRYP_KEY_WR(i, val)             (cmodel.key[i] = (val))
+#define CRYP_IV_WR(i, val)              (cmodel.iv[i] = (val))
+#define CRYP_DMA_START(in, out, words)  test_cryp_dma_start((in), (out), (words))
+#define CRYP_DMA_POLL()                 test_cryp_dma_poll()
+#define CRYP_DMA_STOP()                 test_cryp_dma_stop()
+
+#include "../../../ports/cryp/cryp_ctr.c"
+
+/* A CTR engine that does no work: what the CPU still has to do when the
+ * peripheral takes the AES part */
+static err_t
+test_null_start(const u8_t *key, u8_t keylen, const u8_t *ctr, const u8_t *in, u8_t *out, u32_t len)
+{
+  LWIP_UNUSED_ARG(key);
+  LWIP_UNUSED_ARG(keylen);
+  LWIP_UNUSED_ARG(ctr);
+  LWIP_UNUSED_ARG(in);
+  LWIP_UNUSED_ARG(out);
+  LWIP_UNUSED_ARG(len);
+  return ERR_OK;
+}
+
+static err_t
+test_null_wait(void)
+{
+  return ERR_OK;
+}
+
+static const struct aes_ctr_engine test_null_engine = {
+  "null", test_null_start, test_null_wait
+};
+
+/* GCM test cases from the GCM specification (McGrew/Viega), 1-4 and 13-14 */
+struct test_gcm_vector {
+  const char *k, *iv, *p, *a, *c, *t;
+};
+
+static const struct test_gcm_vector test_gcm_vectors[] = {
+  {"00000000000000000000000000000000", "000000000000000000000000", "", "", "",
+   "58e2fccefa7e3061367f1d57a4e7455a"},
+  {"00000000000000000000000000000000", "000000000000000000000000",
+   "00000000000000000000000000000000", "",
+   "0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf"},
+  {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+   "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+   "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255", "",
+   "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+   "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+   "4d5c2af327cd64a62cf35abd2ba6fab4"},
+  {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+   "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+   "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+   "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+   "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+   "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+   "5bc94fbc3221a5db94fae95ae7121a47"},
+  {"0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+   "", "", "", "530f8afbc74536b9a963b4f1c4cb738b"},
+  {"0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+   "00000000000000000000000000000000", "",
+   "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919"}
+};
+
+static u8_t data[16384 + 64];
+static u8_t ref[16384 + 64];
+static u8_t buf[16384 + 64];
+
+/* Helper functions */
+
+static u32_t
+test_unhex(u8_t *out, const char *hex)
+{
+  u32_t n = 0;
+  unsigned int b;
+
+  while (hex[0] && hex[1]) {
+    sscanf(hex, "%2x", &b);
+    out[n++] = (u8_t)b;
+    hex += 2;
+  }
+  return n;
+}
+
+/** GCM over 'len' bytes in chunks of random size (1..maxchunk) */
+static err_t
+test_gcm_chunks(const struct aes_gcm_key *k, u8_t enc, const u8_t *iv, const u8_t *aad, u32_t aad_len,
+                const u8_t *in, u8_t *out, u32_t len, u32_t maxchunk, u8_t *tag)
+{
+  struct aes_gcm ctx;
+  u32_t n;
+  err_t err;
+
+  aes_gcm_start(&ctx, k, enc, iv, aad, aad_len);
+  while (len > 0) {
+    n = 1 + (u32_t)rand() % maxchunk;
+    if (n > len) {
+      n = len;
+    }
+    err = aes_gcm_update(&ctx, in, out, n);
+    if (err != ERR_OK) {
+      return err;
+    }
+    in += n;
+    out += n;
+    len -= n;
+  }
+  return enc ? aes_gcm_finish(&ctx, tag) : aes_gcm_check(&ctx, tag);
+}
+
+/** A chain of PBUF_RAM pbufs of random size holding 'p' */
+static struct pbuf *
+test_gcm_chain(const u8_t *p, u16_t len)
+{
+  struct pbuf *head = NULL, *q;
+  u16_t n;
+
+  do {
+    n = (u16_t)(1 + rand() % 700);
+    if (n > len) {
+      n = len;
+    }
+    q = pbuf_alloc(PBUF_RAW, n, PBUF_RAM);
+    EXPECT_RETNULL(q != NULL);
+    /* random payload alignment */
+    if (n > 3) {
+      pbuf_header(q, (s16_t)-(rand() & 3));
+    }
+    n = q->len;
+    memcpy(q->payload, p, n);
+    if (head == NULL) {
+      head = q;
+    } else {
+      pbuf_cat(head, q);
+    }
+    p += n;
+    len -= n;
+  } while (len > 0);
+  return head;
+}
+
+static u8_t rec_out[4096];
+static u16_t rec_got;
+static int rec_count;
+
+static void
+test_rec_deliver(void *arg, u8_t *p, u16_t len)
+{
+  LWIP_UNUSED_ARG(arg);
+  memcpy(rec_out + rec_got, p, len);
+  rec_got += len;
+  rec_count++;
+}
+
+/** Seal one record the way app_tcp_send() does into 'out', return its size */
+static u16_t
+test_rec_seal(struct aes_rec *r, const u8_t *p, u16_t len, u8_t *out)
+{
+  u16_t n, off = AES_REC_HDR_SIZE;
+
+  EXPECT(aes_rec_seal_start(r, len, out) == ERR_OK);
+  while (len > 0) {
+    n = (u16_t)LWIP_MIN(len, 100);
+    EXPECT(aes_rec_seal(r, p, out + off, n) == ERR_OK);
+    p += n;
+    off += n;
+    len -= n;
+  }
+  EXPECT(aes_rec_seal_finish(r, out + off) == ERR_OK);
+  return (u16_t)(off + AES_GCM_TAG_SIZE);
+}
+
+/** Feed 'len' bytes of a record stream to the receiver in random pbuf chains */
+static err_t
+test_rec_feed(struct aes_rec *r, u8_t *stage, u16_t size, const u8_t *p, u16_t len)
+{
+  struct pbuf *q;
+  u16_t n;
+  err_t err = ERR_OK;
+
+  while ((len > 0) && (err == ERR_OK)) {
+    n = (u16_t)(1 + rand() % 1500);
+    if (n > len) {
+      n = len;
+    }
+    q = test_gcm_chain(p, n);
+    EXPECT_RETX(q != NULL, ERR_MEM);
+    err = aes_rec_input(r, q, stage, size, test_rec_deliver, NULL);
+    pbuf_free(q);
+    p += n;
+    len -= n;
+  }
+  return err;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+aes_gcm_setup(void)
+{
+  srand(38);
+  memset(&cmodel, 0, sizeof(cmodel));
+  memset(&aes_gcm_stats, 0, sizeof(aes_gcm_stats));
+  aes_gcm_set_engine(NULL);
+}
+
+static void
+aes_gcm_teardown(void)
+{
+  EXPECT(CRYP_Busy == 0);
+  EXPECT(cmodel.running == 0);
+  EXPECT(cmodel.bad == 0);
+  aes_gcm_set_engine(NULL);
+}
+
+
+/* Test functions */
+
+/** FIPS-197 block vectors and the GCM spec test cases, in software and
+ * through the CRYP model, in one piece and byte by byte */
+START_TEST(test_aes_gcm_vectors)
+{
+  static const char *const aes_ct[3] = {
+    "69c4e0d86a7b0430d8cdb78070b4c55a",
+    "dda97ca4864cdfe06eaf70a0ec0d7191",
+    "8ea2b7ca516745bfeafc49904b496089"
+  };
+  struct aes_gcm_key k;
+  u8_t key[32], iv[12], aad[32], tag[16], t[16], block[16];
+  u32_t klen, plen, alen, clen;
+  int pass, i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* FIPS-197 appendix C */
+  for (i = 0; i < 3; i++) {
+    for (klen = 0; klen < 16 + 8 * (u32_t)i; klen++) {
+      key[klen] = (u8_t)klen;
+    }
+    EXPECT(aes_gcm_setkey(&k, key, (u8_t)klen) == ERR_OK);
+    test_unhex(block, "00112233445566778899aabbccddeeff");
+    aes_encrypt_block(&k, block, block);
+    test_unhex(t, aes_ct[i]);
+    EXPECT(memcmp(block, t, 16) == 0);
+  }
+  EXPECT(aes_gcm_setkey(&k, key, 20) == ERR_VAL);
+
+  for (pass = 0; pass < 2; pass++) {
+    aes_gcm_set_engine(pass ? &cryp_ctr_engine : NULL);
+    for (i = 0; i < (int)(sizeof(test_gcm_vectors) / sizeof(test_gcm_vectors[0])); i++) {
+      klen = test_unhex(key, test_gcm_vectors[i].k);
+      test_unhex(iv, test_gcm_vectors[i].iv);
+      plen = test_unhex(data, test_gcm_vectors[i].p);
+      alen = test_unhex(aad, test_gcm_vectors[i].a);
+      clen = test_unhex(ref, test_gcm_vectors[i].c);
+      test_unhex(t, test_gcm_vectors[i].t);
+      EXPECT(clen == plen);
+      EXPECT(aes_gcm_setkey(&k, key, (u8_t)klen) == ERR_OK);
+
+      EXPECT(test_gcm_chunks(&k, 1, iv, aad, alen, data, buf, plen, plen + 1, tag) == ERR_OK);
+      EXPECT(memcmp(buf, ref, clen) == 0);
+      EXPECT(memcmp(tag, t, 16) == 0);
+      EXPECT(test_gcm_chunks(&k, 1, iv, aad, alen, data, buf, plen, 1, tag) == ERR_OK);
+      EXPECT(memcmp(buf, ref, clen) == 0);
+      EXPECT(memcmp(tag, t, 16) == 0);
+
+      /* in place */
+      EXPECT(test_gcm_chunks(&k, 0, iv, aad, alen, buf, buf, clen, clen + 1, t) == ERR_OK);
+      EXPECT(memcmp(buf, data, plen) == 0);
+      t[15] ^= 1;
+      EXPECT(test_gcm_chunks(&k, 0, iv, aad, alen, ref, buf, clen, 7, t) == ERR_VAL);
+    }
+  }
+  EXPECT(cmodel.starts > 0);
+}
+END_TEST
+
+/** Random keys, lengths, chunking, alignment and pbuf chains: the CRYP
+ * path gives the same ciphertext and tag as software, also when the
+ * peripheral writes its output ahead of the GHASH */
+START_TEST(test_aes_gcm_stream)
+{
+  struct aes_gcm_key k;
+  struct aes_gcm ctx;
+  struct pbuf *p;
+  u8_t key[32], iv[12], aad[40], tag_sw[16], tag_hw[16];
+  u32_t len, alen, off, i;
+  u16_t plen;
+  int r;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (u8_t)rand();
+  }
+  for (r = 0; r < 300; r++) {
+    for (i = 0; i < sizeof(key); i++) {
+      key[i] = (u8_t)rand();
+    }
+    for (i = 0; i < sizeof(iv); i++) {
+      iv[i] = (u8_t)rand();
+    }
+    for (i = 0; i < sizeof(aad); i++) {
+      aad[i] = (u8_t)rand();
+    }
+    /* also cross the 32-bit counter wrap */
+    if (r % 10 == 0) {
+      iv[8] = iv[9] = iv[10] = iv[11] = 0xff;
+    }
+    EXPECT(aes_gcm_setkey(&k, key, (u8_t)(16 + 8 * (r % 3))) == ERR_OK);
+    len = (u32_t)rand() % 5000;
+    alen = (u32_t)rand() % sizeof(aad);
+    off = (u32_t)rand() & 7;
+    cmodel.early = r & 1;
+    cmodel.dma_delay = rand() % 3;
+
+    aes_gcm_set_engine(NULL);
+    EXPECT(test_gcm_chunks(&k, 1, iv, aad, alen, data + off, ref, len, len + 1, tag_sw) == ERR_OK);
+    aes_gcm_set_engine(&cryp_ctr_engine);
+    EXPECT(test_gcm_chunks(&k, 1, iv, aad, alen, data + off, buf + (off ^ 5), len, 1 + (u32_t)rand() % 2000, tag_hw) == ERR_OK);
+    EXPECT(memcmp(ref, buf + (off ^ 5), len) == 0);
+    EXPECT(memcmp(tag_sw, tag_hw, 16) == 0);
+
+    /* decrypt in place through the peripheral */
+    memcpy(buf + off, ref, len);
+    EXPECT(test_gcm_chunks(&k, 0, iv, aad, alen, buf + off, buf + off, len, 1 + (u32_t)rand() % 2000, tag_sw) == ERR_OK);
+    EXPECT(memcmp(buf + off, data + off, len) == 0);
+
+    /* and over a pbuf chain */
+    plen = (u16_t)len;
+    p = test_gcm_chain(ref, plen);
+    if (p != NULL) {
+      aes_gcm_start(&ctx, &k, 0, iv, aad, alen);
+      EXPECT(aes_gcm_update_pbuf(&ctx, p, 0, plen) == ERR_OK);
+      EXPECT(aes_gcm_check(&ctx, tag_sw) == ERR_OK);
+      EXPECT(pbuf_copy_partial(p, buf, plen, 0) == plen);
+      EXPECT(memcmp(buf, data + off, plen) == 0);
+      if (plen > 10) {
+        aes_gcm_start(&ctx, &k, 1, iv, aad, alen);
+        EXPECT(aes_gcm_update_pbuf(&ctx, p, 5, (u16_t)(plen - 5)) == ERR_OK);
+        EXPECT(aes_gcm_update_pbuf(&ctx, p, 0, (u16_t)(plen + 1)) == ERR_BUF);
+      }
+      pbuf_free(p);
+    }
+  }
+  EXPECT(aes_gcm_stats.engine_bytes > 0);
+  EXPECT(aes_gcm_stats.soft_bytes > 0);
+  EXPECT(aes_gcm_stats.fallback == 0);
+}
+END_TEST
+
+/** A busy peripheral sends the chunk to software; DMA errors and timeouts
+ * spoil the message and free the peripheral */
+START_TEST(test_aes_gcm_engine)
+{
+  struct aes_gcm_key k;
+  struct aes_gcm ctx;
+  u8_t key[16], iv[12], tag[16], tag2[16];
+  LWIP_UNUSED_ARG(_i);
+
+  memset(key, 0x5a, sizeof(key));
+  memset(iv, 0xa5, sizeof(iv));
+  memset(data, 0x33, 1024);
+  EXPECT(aes_gcm_setkey(&k, key, sizeof(key)) == ERR_OK);
+  EXPECT(test_gcm_chunks(&k, 1, iv, NULL, 0, data, ref, 1024, 1024, tag) == ERR_OK);
+
+  aes_gcm_set_engine(&cryp_ctr_engine);
+  CRYP_Busy = 1;
+  EXPECT(test_gcm_chunks(&k, 1, iv, NULL, 0, data, buf, 1024, 1024, tag2) == ERR_OK);
+  EXPECT(aes_gcm_stats.fallback == 1024 / AES_GCM_CHUNK);
+  EXPECT(aes_gcm_stats.engine_bytes == 0);
+  EXPECT(memcmp(ref, buf, 1024) == 0);
+  EXPECT(memcmp(tag, tag2, 16) == 0);
+  CRYP_Busy = 0;
+
+  cmodel.dma_fail = 1;
+  aes_gcm_start(&ctx, &k, 1, iv, NULL, 0);
+  EXPECT(aes_gcm_update(&ctx, data, buf, 1024) == ERR_IF);
+  EXPECT(aes_gcm_update(&ctx, data, buf, 16) == ERR_IF);
+  EXPECT(aes_gcm_finish(&ctx, tag2) == ERR_IF);
+  EXPECT(CRYP_Busy == 0);
+  cmodel.dma_fail = 0;
+
+  cmodel.dma_delay = CRYP_CTR_TIMEOUT + 10;
+  aes_gcm_start(&ctx, &k, 0, iv, NULL, 0);
+  EXPECT(aes_gcm_update(&ctx, ref, buf, 1024) == ERR_TIMEOUT);
+  EXPECT(aes_gcm_check(&ctx, tag) == ERR_IF);
+  EXPECT(CRYP_Busy == 0);
+  EXPECT(cmodel.running == 0);
+  cmodel.dma_delay = 0;
+  EXPECT(CRYP_REG_RD(CR) == (CRYP_CR_ALGOMODE_AES_CTR | CRYP_CR_DATATYPE_1));
+}
+END_TEST
+
+/** Records round-trip through the receiver however TCP splits them;
+ * a changed byte, a record out of order or one too long for the stage
+ * buffer is refused before anything is delivered */
+START_TEST(test_aes_rec)
+{
+  static u8_t stream[8192];
+  struct aes_gcm_key k;
+  struct aes_rec tx, rx;
+  u8_t key[16], salt[AES_REC_SALT_SIZE], stage[300];
+  u16_t len, lens[12], off, total, first;
+  int r, i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(key); i++) {
+    key[i] = (u8_t)rand();
+  }
+  for (i = 0; i < 4096; i++) {
+    data[i] = (u8_t)rand();
+  }
+  EXPECT(aes_gcm_setkey(&k, key, sizeof(key)) == ERR_OK);
+  aes_gcm_set_engine(&cryp_ctr_engine);
+
+  for (r = 0; r < 50; r++) {
+    for (i = 0; i < (int)sizeof(salt); i++) {
+      salt[i] = (u8_t)rand();
+    }
+    aes_rec_init(&tx, &k, salt, NULL);
+    aes_rec_init(&rx, &k, NULL, NULL);
+    memcpy(stream, salt, sizeof(salt));
+    off = sizeof(salt);
+    total = 0;
+    for (i = 0; i < 12; i++) {
+      lens[i] = (u16_t)(rand() % 301);
+      off = (u16_t)(off + test_rec_seal(&tx, data + total, lens[i], stream + off));
+      total = (u16_t)(total + lens[i]);
+    }
+    rec_got = 0;
+    rec_count = 0;
+    EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, off) == ERR_OK);
+    EXPECT(rec_count == 12);
+    EXPECT(rec_got == total);
+    EXPECT(memcmp(rec_out, data, total) == 0);
+    EXPECT(rx.seq == 12);
+
+    /* flip one bit in the body or tag of the first record */
+    first = (u16_t)(sizeof(salt) + AES_REC_OVERHEAD + lens[0]);
+    aes_rec_init(&rx, &k, NULL, NULL);
+    rec_got = 0;
+    rec_count = 0;
+    i = (int)(sizeof(salt) + AES_REC_HDR_SIZE + (u32_t)rand() % (lens[0] + AES_GCM_TAG_SIZE));
+    stream[i] ^= (u8_t)(1 << (rand() & 7));
+    memset(stage, 0x77, sizeof(stage));
+    EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, off) == ERR_VAL);
+    EXPECT(rec_count == 0);
+    /* the unauthenticated plaintext is wiped */
+    for (len = 0; len < lens[0]; len++) {
+      EXPECT(stage[len] == 0);
+    }
+  }
+
+  /* the second record alone: wrong sequence number */
+  aes_rec_init(&tx, &k, salt, NULL);
+  aes_rec_init(&rx, &k, NULL, NULL);
+  memcpy(stream, salt, sizeof(salt));
+  off = sizeof(salt);
+  first = test_rec_seal(&tx, data, 10, stream + off);
+  len = test_rec_seal(&tx, data, 10, stream + off + first);
+  memmove(stream + off, stream + off + first, len);
+  rec_count = 0;
+  EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, (u16_t)(off + len)) == ERR_VAL);
+  EXPECT(rec_count == 0);
+
+  /* longer than the stage buffer */
+  aes_rec_init(&tx, &k, salt, NULL);
+  aes_rec_init(&rx, &k, NULL, NULL);
+  len = test_rec_seal(&tx, data, sizeof(stage) + 1, stream + off);
+  EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, (u16_t)(off + len)) == ERR_VAL);
+  EXPECT(rec_count == 0);
+}
+END_TEST
+
+/** A session recorded from the client replays into a new connection: the
+ * records are bound to the salt the device sent, which has changed since */
+START_TEST(test_aes_rec_replay)
+{
+  static u8_t stream[2048];
+  struct aes_gcm_key k;
+  struct aes_rec tx, rx;
+  u8_t key[16], salt[AES_REC_SALT_SIZE], dev_salt[AES_REC_SALT_SIZE], stage[300];
+  u16_t off;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(key); i++) {
+    key[i] = (u8_t)rand();
+  }
+  for (i = 0; i < (int)sizeof(salt); i++) {
+    salt[i] = (u8_t)rand();
+    dev_salt[i] = (u8_t)rand();
+  }
+  EXPECT(aes_gcm_setkey(&k, key, sizeof(key)) == ERR_OK);
+
+  /* the client binds its records to the device's salt */
+  aes_rec_init(&tx, &k, salt, dev_salt);
+  aes_rec_init(&rx, &k, NULL, dev_salt);
+  memcpy(stream, salt, sizeof(salt));
+  off = sizeof(salt);
+  for (i = 0; i < 4; i++) {
+    off = (u16_t)(off + test_rec_seal(&tx, data + 100 * i, 100, stream + off));
+  }
+  rec_count = 0;
+  EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, off) == ERR_OK);
+  EXPECT(rec_count == 4);
+
+  /* the recorded bytes against the next connection's salt */
+  dev_salt[rand() % sizeof(dev_salt)] ^= 0x10;
+  aes_rec_init(&rx, &k, NULL, dev_salt);
+  rec_count = 0;
+  EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, off) == ERR_VAL);
+  EXPECT(rec_count == 0);
+
+  /* and against a receiver that binds nothing */
+  aes_rec_init(&rx, &k, NULL, NULL);
+  EXPECT(test_rec_feed(&rx, stage, sizeof(stage), stream, off) == ERR_VAL);
+  EXPECT(rec_count == 0);
+}
+END_TEST
+
+/** Software AES-GCM throughput per record size, what is left for the CPU
+ * (GHASH) when CRYP does the AES, and how the peripheral is fed */
+START_TEST(test_aes_gcm_speed)
+{
+  static const u32_t sizes[] = {64, 256, 1500, 4096, 16384};
+  struct aes_gcm_key k;
+  struct aes_gcm ctx;
+  u8_t key[16], iv[12], tag[16];
+  clock_t start;
+  double secs_sw, secs_gh;
+  u32_t starts, words;
+  int s, r, reps;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(key, 0x42, sizeof(key));
+  memset(iv, 0x24, sizeof(iv));
+  EXPECT(aes_gcm_setkey(&k, key, sizeof(key)) == ERR_OK);
+
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    reps = (int)(8000000 / (sizes[s] + 64));
+
+    aes_gcm_set_engine(NULL);
+    start = clock();
+    for (r = 0; r < reps; r++) {
+      aes_gcm_start(&ctx, &k, 1, iv, iv, AES_REC_HDR_SIZE);
+      aes_gcm_update(&ctx, data, buf, sizes[s]);
+      aes_gcm_finish(&ctx, tag);
+    }
+    secs_sw = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    aes_gcm_set_engine(&test_null_engine);
+    start = clock();
+    for (r = 0; r < reps; r++) {
+      aes_gcm_start(&ctx, &k, 1, iv, iv, AES_REC_HDR_SIZE);
+      aes_gcm_update(&ctx, data, buf, sizes[s]);
+      aes_gcm_finish(&ctx, tag);
+    }
+    secs_gh = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    aes_gcm_set_engine(&cryp_ctr_engine);
+    starts = cmodel.starts;
+    words = cmodel.dma_words;
+    aes_gcm_start(&ctx, &k, 1, iv, iv, AES_REC_HDR_SIZE);
+    EXPECT(aes_gcm_update(&ctx, data, buf, sizes[s]) == ERR_OK);
+    EXPECT(aes_gcm_finish(&ctx, tag) == ERR_OK);
+    printf("AES-128-GCM %5d byte records: software %.1f MB/s, %.0f records/s; "
+      "GHASH only %.1f MB/s; CRYP: %d transfers, %d words by DMA\n",
+      (int)sizes[s],
+      secs_sw > 0 ? (double)sizes[s] * reps / secs_sw / 1e6 : 0.0,
+      secs_sw > 0 ? reps / secs_sw : 0.0,
+      secs_gh > 0 ? (double)sizes[s] * reps / secs_gh / 1e6 : 0.0,
+      (int)(cmodel.starts - starts), (int)(cmodel.dma_words - words));
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+aes_gcm_suite(void)
+{
+  TFun tests[] = {
+    test_aes_gcm_vectors,
+    test_aes_gcm_stream,
+    test_aes_gcm_engine,
+    test_aes_rec,
+    test_aes_rec_replay,
+    test_aes_gcm_speed
+  };
+  return create_suite("AES_GCM", tests, sizeof(tests)/sizeof(TFun), aes_gcm_setup, aes_gcm_teardown);
+}
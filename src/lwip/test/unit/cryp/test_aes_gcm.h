@@ -0,0 +1,8 @@
+#ifndef __TEST_AES_GCM_H__
+#define __TEST_AES_GCM_H__
+
+#include "../lwip_check.h"
+
+Suite *aes_gcm_suite(void);
+
+#endif
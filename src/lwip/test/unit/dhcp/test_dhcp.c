@@ -0,0 +1,562 @@
+#include "test_dhcp.h"
+
+#include "lwip/udp.h"
+#include "lwip/ip.h"
+#include "lwip/dhcp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/netif.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !LWIP_DHCP || !LWIP_DHCP_RAPID_COMMIT || !LWIP_DHCP_LEASE_STORE || !LWIP_DHCP_OPTION_CALLBACK
+#error "This tests needs LWIP_DHCP with rapid commit, the lease store and the option callback enabled"
+#endif
+
+/** lease time granted by the test server */
+#define TEST_DHCP_LEASE_TIME 3600
+
+static struct netif test_netif;
+static ip_addr_t test_server, test_lease;
+static u8_t test_hwaddr[6] = {0x00, 0x23, 0xc1, 0xde, 0xd0, 0x0d};
+
+/* last message sent by the dhcp client */
+static int msg_ctr;
+static u8_t msg_type;
+static u32_t msg_xid;
+static u8_t msg_rapid_commit;
+static u32_t msg_requested_ip;
+
+/* test server behaviour */
+static u8_t server_rapid_commit;
+static u8_t server_nak;
+/* options appended to the replies */
+static const u8_t *reply_extra;
+static u16_t reply_extra_len;
+
+/* options passed to the application */
+static int option_cb_ctr;
+static u8_t option_cb_code;
+static u8_t option_cb_data[255];
+static u8_t option_cb_len;
+
+/* lease store, file backed like a flash sector would be */
+static FILE *lease_file;
+static int lease_save_ctr;
+
+/* Helper functions */
+
+/** netif->output: parse the DHCP message sent by the client */
+static err_t
+test_dhcp_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  u8_t buf[IP_HLEN + UDP_HLEN + 576];
+  u8_t *msg = &buf[IP_HLEN + UDP_HLEN];
+  u16_t len, i;
+
+  fail_unless(netif == &test_netif);
+  EXPECT(ip_addr_isbroadcast(ipaddr, netif));
+  len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+  EXPECT_RETX(len > IP_HLEN + UDP_HLEN + DHCP_OPTIONS_OFS, ERR_OK);
+  EXPECT_RETX(IPH_PROTO((struct ip_hdr *)buf) == IP_PROTO_UDP, ERR_OK);
+  EXPECT(((buf[IP_HLEN + 2] << 8) | buf[IP_HLEN + 3]) == DHCP_SERVER_PORT);
+  EXPECT(msg[0] == DHCP_BOOTREQUEST);
+  EXPECT(memcmp(&msg[28], test_hwaddr, sizeof(test_hwaddr)) == 0);
+
+  msg_xid = ((u32_t)msg[4] << 24) | ((u32_t)msg[5] << 16) | ((u32_t)msg[6] << 8) | msg[7];
+  msg_type = 0;
+  msg_rapid_commit = 0;
+  msg_requested_ip = 0;
+  len = (u16_t)(len - IP_HLEN - UDP_HLEN);
+  for (i = DHCP_OPTIONS_OFS; (i + 1 < len) && (msg[i] != DHCP_OPTION_END); ) {
+    if (msg[i] == DHCP_OPTION_PAD) {
+      i++;
+      continue;
+    }
+    switch (msg[i]) {
+      case DHCP_OPTION_MESSAGE_TYPE:
+        msg_type = msg[i + 2];
+        break;
+      case DHCP_OPTION_RAPID_COMMIT:
+        EXPECT(msg[i + 1] == 0);
+        msg_rapid_commit = 1;
+        break;
+      case DHCP_OPTION_REQUESTED_IP:
+        msg_requested_ip = ((u32_t)msg[i + 2] << 24) | ((u32_t)msg[i + 3] << 16) |
+                           ((u32_t)msg[i + 4] << 8) | msg[i + 5];
+        break;
+      default:
+        break;
+    }
+    i = (u16_t)(i + 2 + msg[i + 1]);
+  }
+  EXPECT(msg_type != 0);
+  msg_ctr++;
+  return ERR_OK;
+}
+
+/** netif->linkoutput: ARP probes of the address check are not answered */
+static err_t
+test_dhcp_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  fail_unless(netif == &test_netif);
+  fail_unless(p != NULL);
+  return ERR_OK;
+}
+
+static err_t
+test_dhcp_netif_init(struct netif *netif)
+{
+  fail_unless(netif != NULL);
+  netif->output = test_dhcp_output;
+  netif->linkoutput = test_dhcp_linkoutput;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+  netif->hwaddr_len = sizeof(test_hwaddr);
+  memcpy(netif->hwaddr, test_hwaddr, sizeof(test_hwaddr));
+  return ERR_OK;
+}
+
+/** Build a reply of type 'type' to the last client message from the server
+ * (IP header included) in 'buf' and return its length */
+static u16_t
+test_dhcp_build_reply(u8_t *buf, u8_t type, u8_t rapid_commit)
+{
+  struct ip_hdr *iphdr;
+  u8_t *data;
+  u16_t msglen, totlen;
+  u32_t val;
+  int i;
+
+  data = buf + IP_HLEN + UDP_HLEN;
+  memset(data, 0, DHCP_OPTIONS_OFS);
+  data[0] = DHCP_BOOTREPLY;
+  data[1] = DHCP_HTYPE_ETH;
+  data[2] = sizeof(test_hwaddr);
+  for (i = 0; i < 4; i++) {
+    data[4 + i] = (u8_t)(msg_xid >> (24 - 8 * i));
+  }
+  if (type != DHCP_NAK) {
+    memcpy(&data[16], &test_lease, 4);  /* yiaddr */
+  }
+  memcpy(&data[28], test_hwaddr, sizeof(test_hwaddr));
+  data[DHCP_MSG_LEN]     = 0x63;
+  data[DHCP_MSG_LEN + 1] = 0x82;
+  data[DHCP_MSG_LEN + 2] = 0x53;
+  data[DHCP_MSG_LEN + 3] = 0x63;
+  msglen = DHCP_OPTIONS_OFS;
+  data[msglen++] = DHCP_OPTION_MESSAGE_TYPE;
+  data[msglen++] = 1;
+  data[msglen++] = type;
+  data[msglen++] = DHCP_OPTION_SERVER_ID;
+  data[msglen++] = 4;
+  memcpy(&data[msglen], &test_server, 4);
+  msglen += 4;
+  if (type != DHCP_NAK) {
+    data[msglen++] = DHCP_OPTION_LEASE_TIME;
+    data[msglen++] = 4;
+    val = TEST_DHCP_LEASE_TIME;
+    for (i = 0; i < 4; i++) {
+      data[msglen++] = (u8_t)(val >> (24 - 8 * i));
+    }
+    data[msglen++] = DHCP_OPTION_SUBNET_MASK;
+    data[msglen++] = 4;
+    data[msglen++] = 255; data[msglen++] = 255; data[msglen++] = 255; data[msglen++] = 0;
+    data[msglen++] = DHCP_OPTION_ROUTER;
+    data[msglen++] = 4;
+    memcpy(&data[msglen], &test_server, 4);
+    msglen += 4;
+  }
+  if (rapid_commit) {
+    data[msglen++] = DHCP_OPTION_RAPID_COMMIT;
+    data[msglen++] = 0;
+  }
+  memcpy(&data[msglen], reply_extra, reply_extra_len);
+  msglen = (u16_t)(msglen + reply_extra_len);
+  data[msglen++] = DHCP_OPTION_END;
+
+  /* UDP header without checksum */
+  data = buf + IP_HLEN;
+  data[0] = 0; data[1] = DHCP_SERVER_PORT;
+  data[2] = 0; data[3] = DHCP_CLIENT_PORT;
+  data[4] = (u8_t)((UDP_HLEN + msglen) >> 8); data[5] = (u8_t)(UDP_HLEN + msglen);
+  data[6] = 0; data[7] = 0;
+
+  totlen = (u16_t)(IP_HLEN + UDP_HLEN + msglen);
+  iphdr = (struct ip_hdr *)buf;
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_TOS_SET(iphdr, 0);
+  IPH_LEN_SET(iphdr, htons(totlen));
+  IPH_ID_SET(iphdr, 0);
+  IPH_OFFSET_SET(iphdr, 0);
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip_addr_copy(iphdr->src, test_server);
+  ip_addr_copy(iphdr->dest, *IP_ADDR_BROADCAST);
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  return totlen;
+}
+
+/** Pass a message to ip_input, split into a chain of two pbufs after 'split'
+ * bytes (0: a single pbuf) */
+static void
+test_dhcp_input(const u8_t *buf, u16_t len, u16_t split)
+{
+  struct pbuf *p, *q;
+
+  if ((split == 0) || (split >= len)) {
+    split = len;
+  }
+  p = pbuf_alloc(PBUF_RAW, split, PBUF_RAM);
+  EXPECT_RET(p != NULL);
+  memcpy(p->payload, buf, split);
+  if (split < len) {
+    q = pbuf_alloc(PBUF_RAW, (u16_t)(len - split), PBUF_RAM);
+    EXPECT_RET(q != NULL);
+    memcpy(q->payload, buf + split, len - split);
+    pbuf_cat(p, q);
+  }
+  ip_input(p, &test_netif);
+}
+
+/** Send a reply of type 'type' to the last client message from the server */
+static void
+test_dhcp_reply(u8_t type, u8_t rapid_commit)
+{
+  u8_t buf[IP_HLEN + UDP_HLEN + 576];
+  u16_t len = test_dhcp_build_reply(buf, type, rapid_commit);
+  test_dhcp_input(buf, len, 0);
+}
+
+/** Answer the last client message like a server would */
+static void
+test_dhcp_serve(void)
+{
+  u8_t type = msg_type;
+
+  /* the reply may make the client send the next message right away */
+  msg_type = 0;
+  switch (type) {
+    case DHCP_DISCOVER:
+      if (server_rapid_commit && msg_rapid_commit) {
+        test_dhcp_reply(DHCP_ACK, 1);
+      } else {
+        test_dhcp_reply(DHCP_OFFER, 0);
+      }
+      break;
+    case DHCP_REQUEST:
+      test_dhcp_reply(server_nak ? DHCP_NAK : DHCP_ACK, 0);
+      break;
+    default:
+      break;
+  }
+}
+
+/** Run the client against the test server until it is bound (or gives up)
+ * and return the number of round trips that took, including the message
+ * still waiting for an answer */
+static int
+test_dhcp_run(void)
+{
+  int ticks;
+  int start = msg_ctr - ((msg_type != 0) ? 1 : 0);
+
+  for (ticks = 0; ticks < 100; ticks++) {
+    if (msg_type != 0) {
+      test_dhcp_serve();
+    }
+    if (test_netif.dhcp->state == DHCP_BOUND) {
+      break;
+    }
+    /* address check, retransmissions */
+    dhcp_fine_tmr();
+  }
+  EXPECT(test_netif.dhcp->state == DHCP_BOUND);
+  EXPECT(ip_addr_cmp(&test_netif.ip_addr, &test_lease));
+  return msg_ctr - start;
+}
+
+static err_t
+test_dhcp_lease_load(struct netif *netif, struct dhcp_lease *lease)
+{
+  fail_unless(netif == &test_netif);
+  rewind(lease_file);
+  if (fread(lease, sizeof(*lease), 1, lease_file) != 1) {
+    return ERR_VAL;
+  }
+  return ERR_OK;
+}
+
+static void
+test_dhcp_lease_save(struct netif *netif, const struct dhcp_lease *lease)
+{
+  struct dhcp_lease none;
+
+  fail_unless(netif == &test_netif);
+  if (lease == NULL) {
+    memset(&none, 0, sizeof(none));
+    lease = &none;
+  }
+  rewind(lease_file);
+  fail_unless(fwrite(lease, sizeof(*lease), 1, lease_file) == 1);
+  fflush(lease_file);
+  lease_save_ctr++;
+}
+
+/** dhcp_option_fn: remember the last option passed */
+static void
+test_dhcp_option_cb(struct netif *netif, u8_t code, u8_t len, struct pbuf *p, u16_t offset)
+{
+  fail_unless(netif == &test_netif);
+  option_cb_ctr++;
+  option_cb_code = code;
+  option_cb_len = len;
+  EXPECT(pbuf_copy_partial(p, option_cb_data, len, offset) == len);
+}
+
+/* Setups/teardown functions */
+
+static void
+dhcp_setup(void)
+{
+  IP4_ADDR(&test_server, 192,168,0,254);
+  IP4_ADDR(&test_lease, 192,168,0,23);
+
+  fail_unless(netif_default == NULL);
+  netif_set_default(netif_add(&test_netif, IP_ADDR_ANY, IP_ADDR_ANY, IP_ADDR_ANY,
+                              NULL, test_dhcp_netif_init, NULL));
+  netif_set_up(&test_netif);
+
+  lease_file = tmpfile();
+  fail_unless(lease_file != NULL);
+  dhcp_set_lease_store(test_dhcp_lease_load, test_dhcp_lease_save);
+  msg_ctr = 0;
+  msg_type = 0;
+  lease_save_ctr = 0;
+  server_rapid_commit = 0;
+  server_nak = 0;
+  reply_extra = NULL;
+  reply_extra_len = 0;
+  option_cb_ctr = 0;
+  dhcp_set_option_callback(test_dhcp_option_cb);
+}
+
+static void
+dhcp_teardown(void)
+{
+  dhcp_set_lease_store(NULL, NULL);
+  dhcp_set_option_callback(NULL);
+  fclose(lease_file);
+  dhcp_stop(&test_netif);
+  dhcp_cleanup(&test_netif);
+  fail_unless(netif_default == &test_netif);
+  netif_remove(&test_netif);
+}
+
+
+/* Test functions */
+
+/** Time to bound: DORA takes 2 round trips, rapid commit 1, INIT-REBOOT of a
+ * stored lease 1 */
+START_TEST(test_dhcp_time_to_bound)
+{
+  int rtt_dora, rtt_rapid, rtt_reboot;
+  LWIP_UNUSED_ARG(_i);
+
+  /* server without rapid commit: the client falls back to DORA */
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  EXPECT(msg_type == DHCP_DISCOVER);
+  EXPECT(msg_rapid_commit);
+  rtt_dora = test_dhcp_run();
+  EXPECT(rtt_dora == 2);
+  EXPECT(lease_save_ctr == 1);
+
+  /* rapid commit: DISCOVER/ACK */
+  dhcp_release(&test_netif);
+  EXPECT(lease_save_ctr == 2);
+  server_rapid_commit = 1;
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  EXPECT(msg_type == DHCP_DISCOVER);
+  rtt_rapid = test_dhcp_run();
+  EXPECT(rtt_rapid == 1);
+  EXPECT(lease_save_ctr == 3);
+
+  /* reboot: the stored lease is verified with a single REQUEST */
+  dhcp_stop(&test_netif);
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  EXPECT(msg_type == DHCP_REQUEST);
+  EXPECT(msg_requested_ip == ntohl(ip4_addr_get_u32(&test_lease)));
+  rtt_reboot = test_dhcp_run();
+  EXPECT(rtt_reboot == 1);
+
+  printf("DHCP round trips to bound: DORA %d, rapid commit %d, INIT-REBOOT %d\n",
+    rtt_dora, rtt_rapid, rtt_reboot);
+}
+END_TEST
+
+/** Link-up verifies the stored lease, a NAK invalidates it */
+START_TEST(test_dhcp_link_up_reboot)
+{
+  struct dhcp_lease lease;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  EXPECT(test_dhcp_run() == 2);
+
+  /* link down/up: INIT-REBOOT */
+  netif_set_link_down(&test_netif);
+  netif_set_link_up(&test_netif);
+  EXPECT(msg_type == DHCP_REQUEST);
+  EXPECT(test_netif.dhcp->state == DHCP_REBOOTING);
+  EXPECT(test_dhcp_run() == 1);
+
+  /* moved to another network: the server refuses the stored lease */
+  netif_set_link_down(&test_netif);
+  netif_set_link_up(&test_netif);
+  EXPECT(msg_type == DHCP_REQUEST);
+  server_nak = 1;
+  test_dhcp_serve();
+  EXPECT(test_dhcp_lease_load(&test_netif, &lease) == ERR_OK);
+  EXPECT(ip_addr_isany(&lease.ipaddr));
+
+  /* the client starts over with DISCOVER */
+  EXPECT(msg_type == DHCP_DISCOVER);
+  server_nak = 0;
+  EXPECT(test_dhcp_run() == 2);
+}
+END_TEST
+
+/** Options are decoded wherever the message is split into pbufs, options
+ * the client does not use are passed to the application */
+START_TEST(test_dhcp_options_split)
+{
+  static const u8_t extra[] = {
+    DHCP_OPTION_PAD, DHCP_OPTION_PAD,
+    DHCP_OPTION_DNS_SERVER, 8, 10, 0, 0, 1, 10, 0, 0, 2,
+    DHCP_OPTION_VENDOR_SPECIFIC, 6, 1, 4, 'l', 'w', 'i', 'p',
+    /* a later copy of an option does not override the first one */
+    DHCP_OPTION_LEASE_TIME, 4, 0, 0, 0, 1
+  };
+  u8_t buf[IP_HLEN + UDP_HLEN + 576];
+  u16_t len, split;
+  LWIP_UNUSED_ARG(_i);
+
+  reply_extra = extra;
+  reply_extra_len = sizeof(extra);
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  EXPECT(msg_type == DHCP_DISCOVER);
+  len = test_dhcp_build_reply(buf, DHCP_OFFER, 0);
+  /* udp_input and dhcp_recv need the headers and the fixed part in the first pbuf */
+  for (split = IP_HLEN + UDP_HLEN + DHCP_SNAME_OFS; split < len; split++) {
+    len = test_dhcp_build_reply(buf, DHCP_OFFER, 0);
+    option_cb_ctr = 0;
+    msg_type = 0;
+    test_dhcp_input(buf, len, split);
+    EXPECT(msg_type == DHCP_REQUEST);
+    EXPECT(msg_requested_ip == ntohl(ip4_addr_get_u32(&test_lease)));
+    EXPECT(option_cb_ctr == 1);
+    EXPECT(option_cb_code == DHCP_OPTION_VENDOR_SPECIFIC);
+    EXPECT((option_cb_len == 6) && (memcmp(option_cb_data, &extra[14], 6) == 0));
+    /* back to selecting for the next round */
+    dhcp_stop(&test_netif);
+    EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  }
+  EXPECT(test_dhcp_run() == 2);
+  EXPECT(test_netif.dhcp->offered_t0_lease == TEST_DHCP_LEASE_TIME);
+  EXPECT(ip4_addr_get_u32(&test_netif.gw) == ip4_addr_get_u32(&test_server));
+}
+END_TEST
+
+/** Malformed and truncated options: the reply is dropped or decoded, but
+ * never read out of bounds (run with a memory checker) */
+START_TEST(test_dhcp_options_fuzz)
+{
+  u8_t extra[64];
+  u8_t buf[IP_HLEN + UDP_HLEN + 576];
+  u16_t len, i, cut;
+  int round;
+  LWIP_UNUSED_ARG(_i);
+
+  srand(4711);
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  for (round = 0; round < 5000; round++) {
+    for (i = 0; i < sizeof(extra); i++) {
+      extra[i] = (u8_t)rand();
+    }
+    reply_extra = extra;
+    reply_extra_len = (u16_t)(rand() % sizeof(extra));
+    len = test_dhcp_build_reply(buf, (u8_t)(rand() & 1 ? DHCP_OFFER : DHCP_ACK), 0);
+    /* flip some bytes in the options, then truncate (fixing the headers) */
+    for (i = 0; i < 4; i++) {
+      buf[IP_HLEN + UDP_HLEN + DHCP_OPTIONS_OFS + rand() % (len - IP_HLEN - UDP_HLEN - DHCP_OPTIONS_OFS)] = (u8_t)rand();
+    }
+    cut = (u16_t)(rand() % (len - IP_HLEN - UDP_HLEN - DHCP_SNAME_OFS));
+    len = (u16_t)(len - cut);
+    IPH_LEN_SET((struct ip_hdr *)buf, htons(len));
+    IPH_CHKSUM_SET((struct ip_hdr *)buf, 0);
+    IPH_CHKSUM_SET((struct ip_hdr *)buf, inet_chksum(buf, IP_HLEN));
+    buf[IP_HLEN + 4] = (u8_t)((len - IP_HLEN) >> 8);
+    buf[IP_HLEN + 5] = (u8_t)(len - IP_HLEN);
+    test_dhcp_input(buf, len, (u16_t)(IP_HLEN + UDP_HLEN + DHCP_SNAME_OFS + rand() % 64));
+    if (test_netif.dhcp->state != DHCP_SELECTING) {
+      dhcp_stop(&test_netif);
+      EXPECT(dhcp_start(&test_netif) == ERR_OK);
+    }
+  }
+  /* the client still works */
+  reply_extra_len = 0;
+  EXPECT(test_netif.dhcp->state == DHCP_SELECTING);
+  msg_type = DHCP_DISCOVER;
+  EXPECT(test_dhcp_run() == 2);
+}
+END_TEST
+
+/** Parse time per ACK (received in bound state, including IP/UDP input) */
+START_TEST(test_dhcp_parse_time)
+{
+  static const u8_t extra[] = {
+    DHCP_OPTION_DNS_SERVER, 8, 10, 0, 0, 1, 10, 0, 0, 2,
+    DHCP_OPTION_T1, 4, 0, 0, 0x07, 0x08,
+    DHCP_OPTION_T2, 4, 0, 0, 0x0c, 0x4e,
+    DHCP_OPTION_VENDOR_SPECIFIC, 6, 1, 4, 'l', 'w', 'i', 'p'
+  };
+  u8_t buf[IP_HLEN + UDP_HLEN + 576];
+  u16_t len;
+  clock_t start;
+  int n;
+  const int num = 100000;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(dhcp_start(&test_netif) == ERR_OK);
+  EXPECT(test_dhcp_run() == 2);
+  reply_extra = extra;
+  reply_extra_len = sizeof(extra);
+  len = test_dhcp_build_reply(buf, DHCP_ACK, 0);
+  dhcp_set_option_callback(NULL);
+  start = clock();
+  for (n = 0; n < num; n++) {
+    test_dhcp_input(buf, len, (u16_t)(len - 40));
+  }
+  printf("DHCP parse time per ACK: %.0f ns\n",
+    (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / num);
+  EXPECT(test_netif.dhcp->state == DHCP_BOUND);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+dhcp_suite(void)
+{
+  TFun tests[] = {
+    test_dhcp_time_to_bound,
+    test_dhcp_link_up_reboot,
+    test_dhcp_options_split,
+    test_dhcp_options_fuzz,
+    test_dhcp_parse_time
+  };
+  return create_suite("DHCP", tests, sizeof(tests)/sizeof(TFun), dhcp_setup, dhcp_teardown);
+}
@@ -0,0 +1,530 @@
+#include "test_dns.h"
+
+#include "lwip/udp.h"
+#include "lwip/ip.h"
+#include "lwip/dns.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/stats.h"
+#include "lwip/netif.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_STATS || !DNS_STATS
+#error "This tests needs DNS-statistics enabled"
+#endif
+#if !LWIP_DNS || (DNS_TABLE_SIZE < 8) || (DNS_MAX_REQUESTS < 4)
+#error "This tests needs LWIP_DNS enabled with at least 8 entries and 4 requests"
+#endif
+#if (DNS_NEG_TTL == 0) || !DNS_PREFETCH_TIME || !DNS_RACE_SERVERS || (DNS_MAX_SERVERS < 2)
+#error "This tests needs negative caching, prefetching and racing 2 servers enabled"
+#endif
+
+/* defaults of dns.c */
+#ifndef DNS_SERVER_PORT
+#define DNS_SERVER_PORT 53
+#endif
+#ifndef DNS_MAX_RETRIES
+#define DNS_MAX_RETRIES 4
+#endif
+
+/** TTL of the answers sent by the test server, all entries expire after the
+ * teardown ticked that long */
+#define TEST_DNS_TTL 30
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw, test_server, test_server2;
+
+/* last query sent by the dns client */
+static int query_ctr;
+static u16_t query_id;
+static u16_t query_port;
+static ip_addr_t query_dest;
+
+/* callback results */
+static int found_ctr;
+static int found_fail_ctr;
+static u32_t found_addr;
+
+/* Helper functions */
+
+/** netif->output: remember the DNS query */
+static err_t
+test_dns_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  u8_t buf[IP_HLEN + UDP_HLEN + 2];
+  u16_t hlen;
+
+  fail_unless(netif == &test_netif);
+  ip_addr_copy(query_dest, *ipaddr);
+  EXPECT_RETX(pbuf_copy_partial(p, buf, sizeof(buf), 0) == sizeof(buf), ERR_OK);
+  hlen = (u16_t)(IPH_HL((struct ip_hdr *)buf) * 4);
+  EXPECT_RETX(hlen == IP_HLEN, ERR_OK);
+  EXPECT_RETX(IPH_PROTO((struct ip_hdr *)buf) == IP_PROTO_UDP, ERR_OK);
+  query_port = (u16_t)((buf[IP_HLEN] << 8) | buf[IP_HLEN + 1]);
+  EXPECT(((buf[IP_HLEN + 2] << 8) | buf[IP_HLEN + 3]) == DNS_SERVER_PORT);
+  query_id = (u16_t)((buf[IP_HLEN + UDP_HLEN] << 8) | buf[IP_HLEN + UDP_HLEN + 1]);
+  query_ctr++;
+  return ERR_OK;
+}
+
+static err_t
+test_dns_netif_init(struct netif *netif)
+{
+  fail_unless(netif != NULL);
+  netif->output = test_dns_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/** Answer the last query for 'name' from 'server': rcode 0 with address
+ * 'addr' or an error */
+static void
+test_dns_answer(ip_addr_t *server, const char *name, u8_t rcode, u32_t ttl, u32_t addr)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  u8_t *data, *len;
+  u16_t dnslen = 0;
+  u16_t totlen;
+  u16_t i;
+
+  p = pbuf_alloc(PBUF_RAW, 512, PBUF_RAM);
+  EXPECT_RET(p != NULL);
+  data = (u8_t *)p->payload + IP_HLEN + UDP_HLEN;
+  memset(data, 0, 12);
+  data[0] = (u8_t)(query_id >> 8);
+  data[1] = (u8_t)query_id;
+  data[2] = 0x81;  /* response, recursion desired */
+  data[3] = (u8_t)(0x80 | rcode);
+  data[5] = 1;     /* one question */
+  data[7] = (rcode == 0) ? 1 : 0;
+  dnslen = 12;
+  /* question: the name in label encoding, type A, class IN */
+  do {
+    len = &data[dnslen++];
+    for (*len = 0; (*name != '.') && (*name != 0); name++) {
+      data[dnslen++] = (u8_t)*name;
+      (*len)++;
+    }
+  } while (*name++ != 0);
+  data[dnslen++] = 0;
+  data[dnslen++] = 0; data[dnslen++] = 1;
+  data[dnslen++] = 0; data[dnslen++] = 1;
+  if (rcode == 0) {
+    /* answer: pointer to the question name, type A, class IN, ttl, address */
+    data[dnslen++] = 0xc0; data[dnslen++] = 12;
+    data[dnslen++] = 0; data[dnslen++] = 1;
+    data[dnslen++] = 0; data[dnslen++] = 1;
+    for (i = 0; i < 4; i++) {
+      data[dnslen++] = (u8_t)(ttl >> (24 - 8 * i));
+    }
+    data[dnslen++] = 0; data[dnslen++] = 4;
+    for (i = 0; i < 4; i++) {
+      data[dnslen++] = (u8_t)(addr >> (24 - 8 * i));
+    }
+  }
+
+  /* UDP header without checksum */
+  data = (u8_t *)p->payload + IP_HLEN;
+  data[0] = DNS_SERVER_PORT >> 8; data[1] = (u8_t)DNS_SERVER_PORT;
+  data[2] = (u8_t)(query_port >> 8); data[3] = (u8_t)query_port;
+  data[4] = (u8_t)((UDP_HLEN + dnslen) >> 8); data[5] = (u8_t)(UDP_HLEN + dnslen);
+  data[6] = 0; data[7] = 0;
+
+  totlen = (u16_t)(IP_HLEN + UDP_HLEN + dnslen);
+  pbuf_realloc(p, totlen);
+  iphdr = (struct ip_hdr *)p->payload;
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_TOS_SET(iphdr, 0);
+  IPH_LEN_SET(iphdr, htons(totlen));
+  IPH_ID_SET(iphdr, 0);
+  IPH_OFFSET_SET(iphdr, 0);
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip_addr_copy(iphdr->src, *server);
+  ip_addr_copy(iphdr->dest, test_ipaddr);
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  ip_input(p, &test_netif);
+}
+
+/** dns_found_callback: count the results */
+static void
+test_dns_found(const char *name, ip_addr_t *ipaddr, void *arg)
+{
+  LWIP_UNUSED_ARG(name);
+  LWIP_UNUSED_ARG(arg);
+  if (ipaddr != NULL) {
+    found_ctr++;
+    found_addr = ntohl(ip4_addr_get_u32(ipaddr));
+  } else {
+    found_fail_ctr++;
+  }
+}
+
+/** Let 'secs' seconds pass */
+static void
+test_dns_tick(int secs)
+{
+  while (secs-- > 0) {
+    dns_tmr();
+  }
+}
+
+/** A dns_table entry as the lookup before the hash table walked them */
+struct test_dns_linear_entry {
+  u8_t state;
+  u32_t ttl;
+  char name[DNS_MAX_NAME_LENGTH];
+  ip_addr_t ipaddr;
+};
+static struct test_dns_linear_entry test_dns_linear[DNS_TABLE_SIZE];
+
+/** The old dns_lookup(): compare the name with every entry in turn */
+static u32_t
+test_dns_linear_lookup(const char *name)
+{
+  u8_t i;
+
+  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
+    if ((test_dns_linear[i].state != 0) &&
+        (strcmp(name, test_dns_linear[i].name) == 0)) {
+      return ip4_addr_get_u32(&test_dns_linear[i].ipaddr);
+    }
+  }
+  return IPADDR_NONE;
+}
+
+/** The part of the old dns_gethostbyname() that answers a hit */
+static err_t
+test_dns_linear_gethostbyname(const char *hostname, ip_addr_t *addr)
+{
+  u32_t ipaddr;
+
+  if ((addr == NULL) || (!hostname) || (!hostname[0]) ||
+      (strlen(hostname) >= DNS_MAX_NAME_LENGTH)) {
+    return ERR_ARG;
+  }
+  ipaddr = ipaddr_addr(hostname);
+  if (ipaddr == IPADDR_NONE) {
+    ipaddr = test_dns_linear_lookup(hostname);
+  }
+  if (ipaddr != IPADDR_NONE) {
+    ip4_addr_set_u32(addr, ipaddr);
+    return ERR_OK;
+  }
+  return ERR_INPROGRESS;
+}
+
+/* Setups/teardown functions */
+
+static void
+dns_setup(void)
+{
+  IP4_ADDR(&test_gw, 192,168,0,254);
+  IP4_ADDR(&test_ipaddr, 192,168,0,1);
+  IP4_ADDR(&test_netmask, 255,255,255,0);
+  IP4_ADDR(&test_server, 192,168,0,53);
+  IP4_ADDR(&test_server2, 192,168,0,54);
+
+  fail_unless(netif_default == NULL);
+  netif_set_default(netif_add(&test_netif, &test_ipaddr, &test_netmask,
+                              &test_gw, NULL, test_dns_netif_init, NULL));
+  netif_set_up(&test_netif);
+
+  dns_init();
+  dns_setserver(0, &test_server);
+  dns_setserver(1, NULL);
+  query_ctr = 0;
+  found_ctr = 0;
+  found_fail_ctr = 0;
+  found_addr = 0;
+}
+
+static void
+dns_teardown(void)
+{
+  /* let all entries time out and expire */
+  test_dns_tick(2 * LWIP_MAX(TEST_DNS_TTL, LWIP_MAX(DNS_NEG_TTL, DNS_TIMEOUT_NEG_TTL)));
+  fail_unless(netif_default == &test_netif);
+  netif_remove(&test_netif);
+}
+
+
+/* Test functions */
+
+/** Concurrent lookups of one name share a single query */
+START_TEST(test_dns_coalesce)
+{
+  ip_addr_t addr;
+  struct stats_dns old = lwip_stats.dns;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(dns_gethostbyname("www.coalesce.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 1);
+  EXPECT(dns_gethostbyname("www.coalesce.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(dns_gethostbyname("www.coalesce.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 1);
+  EXPECT(lwip_stats.dns.miss == old.miss + 1);
+  EXPECT(lwip_stats.dns.coalesced == old.coalesced + 2);
+
+  test_dns_answer(&test_server, "www.coalesce.test", 0, TEST_DNS_TTL, 0x0a000001);
+  EXPECT(found_ctr == 3);
+  EXPECT(found_addr == 0x0a000001);
+  EXPECT(lwip_stats.dns.answers == old.answers + 1);
+
+  /* now cached */
+  EXPECT(dns_gethostbyname("www.coalesce.test", &addr, test_dns_found, NULL) == ERR_OK);
+  EXPECT(ntohl(ip4_addr_get_u32(&addr)) == 0x0a000001);
+  EXPECT(lwip_stats.dns.hit == old.hit + 1);
+  EXPECT(query_ctr == 1);
+}
+END_TEST
+
+/** NXDOMAIN answers and timeouts are cached for a while */
+START_TEST(test_dns_negative)
+{
+  ip_addr_t addr;
+  int i;
+  struct stats_dns old = lwip_stats.dns;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(dns_gethostbyname("nx.negative.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 1);
+  test_dns_answer(&test_server, "nx.negative.test", 3, 0, 0);
+  EXPECT(found_fail_ctr == 1);
+  EXPECT(lwip_stats.dns.nxdomain == old.nxdomain + 1);
+
+  /* no query while the failure is cached */
+  test_dns_tick(DNS_NEG_TTL - 1);
+  EXPECT(dns_gethostbyname("nx.negative.test", &addr, test_dns_found, NULL) == ERR_VAL);
+  EXPECT(lwip_stats.dns.neghit == old.neghit + 1);
+  EXPECT(query_ctr == 1);
+
+  /* asked again after DNS_NEG_TTL */
+  test_dns_tick(1);
+  EXPECT(dns_gethostbyname("nx.negative.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 2);
+  test_dns_answer(&test_server, "nx.negative.test", 0, TEST_DNS_TTL, 0x0a000002);
+  EXPECT(found_ctr == 1);
+
+  /* a server that does not answer */
+  EXPECT(dns_gethostbyname("mute.negative.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  for (i = 0; (i < 100) && (found_fail_ctr < 2); i++) {
+    test_dns_tick(1);
+  }
+  EXPECT(found_fail_ctr == 2);
+  EXPECT(lwip_stats.dns.timeout == old.timeout + 1);
+  EXPECT(query_ctr == 2 + DNS_MAX_RETRIES);
+#if DNS_TIMEOUT_NEG_TTL
+  EXPECT(dns_gethostbyname("mute.negative.test", &addr, test_dns_found, NULL) == ERR_VAL);
+  EXPECT(query_ctr == 2 + DNS_MAX_RETRIES);
+#endif /* DNS_TIMEOUT_NEG_TTL */
+}
+END_TEST
+
+/** Entries expire after their TTL, hot entries are refreshed before */
+START_TEST(test_dns_ttl_prefetch)
+{
+  ip_addr_t addr;
+  int i;
+  struct stats_dns old = lwip_stats.dns;
+  LWIP_UNUSED_ARG(_i);
+
+  /* cold entry: expires */
+  EXPECT(dns_gethostbyname("cold.ttl.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  test_dns_answer(&test_server, "cold.ttl.test", 0, TEST_DNS_TTL, 0x0a000003);
+  EXPECT(found_ctr == 1);
+  test_dns_tick(TEST_DNS_TTL - 1);
+  EXPECT(query_ctr == 1);
+  EXPECT(dns_gethostbyname("cold.ttl.test", &addr, test_dns_found, NULL) == ERR_OK);
+  test_dns_tick(1);
+  EXPECT(lwip_stats.dns.expired == old.expired + 1);
+  EXPECT(dns_gethostbyname("cold.ttl.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 2);
+  test_dns_answer(&test_server, "cold.ttl.test", 0, TEST_DNS_TTL, 0x0a000003);
+
+  /* hot entry: refreshed while still answered from the cache */
+  EXPECT(dns_gethostbyname("hot.ttl.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 3);
+  test_dns_answer(&test_server, "hot.ttl.test", 0, TEST_DNS_TTL, 0x0a000004);
+  for (i = 0; i < DNS_PREFETCH_MIN_HITS; i++) {
+    EXPECT(dns_gethostbyname("hot.ttl.test", &addr, test_dns_found, NULL) == ERR_OK);
+  }
+  test_dns_tick(TEST_DNS_TTL - DNS_PREFETCH_TIME);
+  EXPECT(lwip_stats.dns.prefetch == old.prefetch + 1);
+  EXPECT(query_ctr == 4);
+  EXPECT(dns_gethostbyname("hot.ttl.test", &addr, test_dns_found, NULL) == ERR_OK);
+  EXPECT(ntohl(ip4_addr_get_u32(&addr)) == 0x0a000004);
+  test_dns_answer(&test_server, "hot.ttl.test", 0, TEST_DNS_TTL, 0x0a000005);
+  EXPECT(found_ctr == 3);
+
+  /* the refreshed entry lives for another TTL with the new address */
+  test_dns_tick(TEST_DNS_TTL - 1);
+  EXPECT(dns_gethostbyname("hot.ttl.test", &addr, test_dns_found, NULL) == ERR_OK);
+  EXPECT(ntohl(ip4_addr_get_u32(&addr)) == 0x0a000005);
+  EXPECT(lwip_stats.dns.expired == old.expired + 2);
+}
+END_TEST
+
+/** Skewed workload over more names than dns_table entries: check the hit
+ * ratio and that every lookup returns the right address, then time a hit
+ * in the full table against the old linear lookup */
+START_TEST(test_dns_hit_ratio)
+{
+  static char names[DNS_TABLE_SIZE][24];
+  ip_addr_t addr;
+  char name[24];
+  u32_t rnd = 12345;
+  u32_t lookups = 0, hits = 0;
+  int ok;
+  const int reps = 200000;
+  double t_hash, t_linear;
+  clock_t start;
+  int i, n, cached;
+  err_t err;
+  struct stats_dns old = lwip_stats.dns;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 2000; i++) {
+    rnd = rnd * 1103515245UL + 12345;
+    /* name n is looked up about twice as often as name n+1 */
+    for (n = 0; (n < 15) && ((rnd >> (16 + n)) & 1); n++);
+    sprintf(name, "host%d.ratio.test", n);
+    found_ctr = 0;
+    err = dns_gethostbyname(name, &addr, test_dns_found, NULL);
+    lookups++;
+    if (err == ERR_OK) {
+      hits++;
+    } else {
+      EXPECT(err == ERR_INPROGRESS);
+      test_dns_answer(&test_server, name, 0, TEST_DNS_TTL, 0x0a010000 + n);
+      EXPECT(found_ctr == 1);
+      addr.addr = htonl(found_addr);
+    }
+    EXPECT(ntohl(ip4_addr_get_u32(&addr)) == 0x0a010000UL + n);
+  }
+  EXPECT(lwip_stats.dns.hit - old.hit == hits);
+  EXPECT(lwip_stats.dns.miss - old.miss == lookups - hits);
+  EXPECT(hits * 100 / lookups >= 90);
+
+  /* fill the table with DNS_TABLE_SIZE names, the old one with the same */
+  for (n = 0; n < DNS_TABLE_SIZE; n++) {
+    sprintf(names[n], "host%d.ratio.test", n);
+    if (dns_gethostbyname(names[n], &addr, test_dns_found, NULL) == ERR_INPROGRESS) {
+      test_dns_answer(&test_server, names[n], 0, TEST_DNS_TTL, 0x0a010000 + n);
+    }
+    test_dns_linear[n].state = 1;
+    strcpy(test_dns_linear[n].name, names[n]);
+    IP4_ADDR(&test_dns_linear[n].ipaddr, 10, 1, 0, n);
+  }
+  cached = 0;
+  for (n = 0; n < DNS_TABLE_SIZE; n++) {
+    if (dns_gethostbyname(names[n], &addr, test_dns_found, NULL) == ERR_OK) {
+      cached++;
+    }
+  }
+  EXPECT_RET(cached == DNS_TABLE_SIZE);
+
+  ok = 0;
+  start = clock();
+  for (i = 0; i < reps; i++) {
+    ok += (dns_gethostbyname(names[i % DNS_TABLE_SIZE], &addr, test_dns_found, NULL) == ERR_OK);
+  }
+  t_hash = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / reps;
+  EXPECT(ok == reps);
+  ok = 0;
+  start = clock();
+  for (i = 0; i < reps; i++) {
+    ok += (test_dns_linear_gethostbyname(names[i % DNS_TABLE_SIZE], &addr) == ERR_OK);
+  }
+  t_linear = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / reps;
+  EXPECT(ok == reps);
+
+  printf("DNS hit ratio %"U32_F"/%"U32_F" (%.1f%%), hit in a full table of %d: "
+    "dns_gethostbyname() %.1f ns, with the old linear lookup %.1f ns\n", hits, lookups,
+    100.0 * hits / lookups, DNS_TABLE_SIZE, t_hash, t_linear);
+}
+END_TEST
+
+
+/** Servers are raced, the fastest one is asked first */
+START_TEST(test_dns_race)
+{
+  ip_addr_t addr, other;
+  const struct dns_server_stats *st0, *st1;
+  LWIP_UNUSED_ARG(_i);
+
+  IP4_ADDR(&other, 192,168,0,99);
+  dns_setserver(1, &test_server2);
+  st0 = dns_getserver_stats(0);
+  st1 = dns_getserver_stats(1);
+  EXPECT_RET((st0 != NULL) && (st1 != NULL));
+  EXPECT(dns_getserver_stats(DNS_MAX_SERVERS) == NULL);
+
+  /* no statistics yet: the primary server is asked first */
+  EXPECT(dns_gethostbyname("a.race.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 1);
+  EXPECT(ip_addr_cmp(&query_dest, &test_server));
+  /* no answer in time: the secondary is asked too and answers first */
+  test_dns_tick(1);
+  EXPECT(query_ctr == 2);
+  EXPECT(ip_addr_cmp(&query_dest, &test_server2));
+  test_dns_answer(&test_server2, "a.race.test", 0, TEST_DNS_TTL, 0x0a000006);
+  EXPECT(found_ctr == 1);
+  EXPECT(found_addr == 0x0a000006);
+  EXPECT(st1->answers == 1);
+  EXPECT(st0->lost == 1);
+  EXPECT(st0->srtt > st1->srtt);
+  /* the late answer of the primary changes nothing */
+  test_dns_answer(&test_server, "a.race.test", 0, TEST_DNS_TTL, 0x0a000007);
+  EXPECT(found_ctr == 1);
+  EXPECT(st0->answers == 0);
+  EXPECT(dns_gethostbyname("a.race.test", &addr, test_dns_found, NULL) == ERR_OK);
+  EXPECT(ntohl(ip4_addr_get_u32(&addr)) == 0x0a000006);
+
+  /* the faster secondary is asked first now; an error answer of one server
+     does not end the race */
+  EXPECT(dns_gethostbyname("b.race.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  EXPECT(query_ctr == 3);
+  EXPECT(ip_addr_cmp(&query_dest, &test_server2));
+  test_dns_tick(1);
+  EXPECT(query_ctr == 4);
+  EXPECT(ip_addr_cmp(&query_dest, &test_server));
+  test_dns_answer(&test_server2, "b.race.test", 2, 0, 0);
+  EXPECT(found_ctr == 1);
+  EXPECT(found_fail_ctr == 0);
+  test_dns_answer(&test_server, "b.race.test", 0, TEST_DNS_TTL, 0x0a000008);
+  EXPECT(found_ctr == 2);
+  EXPECT(found_addr == 0x0a000008);
+  EXPECT(st0->answers == 1);
+  EXPECT(st1->answers == 2);
+
+  /* answers from hosts that were not asked are dropped */
+  EXPECT(dns_gethostbyname("c.race.test", &addr, test_dns_found, NULL) == ERR_INPROGRESS);
+  test_dns_answer(&other, "c.race.test", 0, TEST_DNS_TTL, 0x0a000009);
+  EXPECT(found_ctr == 2);
+  test_dns_tick(1);
+  test_dns_answer(&test_server2, "c.race.test", 0, TEST_DNS_TTL, 0x0a00000a);
+  EXPECT(found_ctr == 3);
+  EXPECT(found_addr == 0x0a00000a);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+dns_suite(void)
+{
+  TFun tests[] = {
+    test_dns_coalesce,
+    test_dns_negative,
+    test_dns_ttl_prefetch,
+    test_dns_hit_ratio,
+    test_dns_race
+  };
+  return create_suite("DNS", tests, sizeof(tests)/sizeof(TFun), dns_setup, dns_teardown);
+}
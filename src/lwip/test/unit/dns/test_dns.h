@@ -0,0 +1,8 @@
+#ifndef __TEST_DNS_H__
+#define __TEST_DNS_H__
+
+#include "../lwip_check.h"
+
+Suite* dns_suite(void);
+
+#endif
@@ -0,0 +1,445 @@
+#include "test_igmp.h"
+
+#include "lwip/udp.h"
+#include "lwip/ip.h"
+#include "lwip/igmp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/netif.h"
+#include "netif/etharp.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_IGMP || (IGMP_GROUP_HASH_SIZE < 16)
+#error "This tests needs LWIP_IGMP with 16 group hash buckets"
+#endif
+#if (MEMP_NUM_IGMP_GROUP < 130)
+#error "This tests needs 130 IGMP groups"
+#endif
+
+#define TEST_IGMP_PORT       5004
+#define TEST_IGMP_FRAME_LEN  (SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN + 4)
+/** STM32 MAC: additional perfect filter addresses (MAC address 1..3) */
+#define TEST_IGMP_PERFECT    3
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw, test_src;
+static u8_t test_hwaddr[6] = {0x00, 0x23, 0xc1, 0xde, 0xd0, 0x0d};
+static struct udp_pcb *test_pcb;
+
+/* model of the MAC's 64 bit multicast hash filter */
+static u8_t mac_hash_cnt[64];
+static int mac_add_ctr, mac_del_ctr;
+static int mac_dropped, mac_passed;
+
+/* what the stack did */
+static int report_ctr;
+static ip_addr_t report_group;
+static int recv_ctr;
+
+/* Helper functions */
+
+/** Hash index of a destination MAC as the STM32 MAC computes it: upper 6 bits
+ * of the bit reversed ethernet CRC32 (same as ETH_MulticastHashIndex()) */
+static u8_t
+test_igmp_mac_hash(const u8_t *mac)
+{
+  u32_t crc = 0xffffffffUL;
+  u8_t i, j, index = 0;
+
+  for (i = 0; i < 6; i++) {
+    crc ^= mac[i];
+    for (j = 0; j < 8; j++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320UL : 0);
+    }
+  }
+  crc = ~crc;
+  for (i = 0; i < 6; i++) {
+    index = (u8_t)((index << 1) | (crc & 1));
+    crc >>= 1;
+  }
+  return index;
+}
+
+static void
+test_igmp_group_mac(ip_addr_t *group, u8_t *mac)
+{
+  mac[0] = 0x01;
+  mac[1] = 0x00;
+  mac[2] = 0x5e;
+  mac[3] = ip4_addr2(group) & 0x7f;
+  mac[4] = ip4_addr3(group);
+  mac[5] = ip4_addr4(group);
+}
+
+/** netif->igmp_mac_filter: reference counted hash bits like the driver */
+static err_t
+test_igmp_mac_filter(struct netif *netif, ip_addr_t *group, u8_t action)
+{
+  u8_t mac[6];
+  u8_t index;
+
+  fail_unless(netif == &test_netif);
+  test_igmp_group_mac(group, mac);
+  index = test_igmp_mac_hash(mac);
+  if (action == IGMP_ADD_MAC_FILTER) {
+    mac_hash_cnt[index]++;
+    mac_add_ctr++;
+  } else {
+    EXPECT(mac_hash_cnt[index] > 0);
+    mac_hash_cnt[index]--;
+    mac_del_ctr++;
+  }
+  return ERR_OK;
+}
+
+/** Receive a frame through the MAC model: multicast not in the hash table is
+ * dropped like the hardware does, everything else goes to ethernet_input() */
+static void
+test_igmp_mac_rx(struct pbuf *p)
+{
+  u8_t *dst = (u8_t *)p->payload;
+
+  if ((dst[0] & 0x01) && (mac_hash_cnt[test_igmp_mac_hash(dst)] == 0)) {
+    mac_dropped++;
+    pbuf_free(p);
+    return;
+  }
+  mac_passed++;
+  test_netif.input(p, &test_netif);
+}
+
+/** Ethernet + IP header for a multicast datagram to 'dest' */
+static struct pbuf *
+test_igmp_frame(ip_addr_t *dest, u8_t proto, u16_t payload_len)
+{
+  struct pbuf *p;
+  struct eth_hdr *ethhdr;
+  struct ip_hdr *iphdr;
+  u16_t len = SIZEOF_ETH_HDR + IP_HLEN + payload_len;
+
+  p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+  fail_unless(p != NULL);
+  memset(p->payload, 0, len);
+  ethhdr = (struct eth_hdr *)p->payload;
+  test_igmp_group_mac(dest, ethhdr->dest.addr);
+  memcpy(ethhdr->src.addr, test_hwaddr, 6);
+  ethhdr->src.addr[5]++;
+  ethhdr->type = PP_HTONS(ETHTYPE_IP);
+
+  iphdr = (struct ip_hdr *)((u8_t *)p->payload + SIZEOF_ETH_HDR);
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, htons(IP_HLEN + payload_len));
+  IPH_TTL_SET(iphdr, 1);
+  IPH_PROTO_SET(iphdr, proto);
+  ip_addr_copy(iphdr->src, test_src);
+  ip_addr_copy(iphdr->dest, *dest);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  return p;
+}
+
+/** UDP datagram to a multicast group */
+static struct pbuf *
+test_igmp_udp_frame(ip_addr_t *dest)
+{
+  struct pbuf *p = test_igmp_frame(dest, IP_PROTO_UDP, UDP_HLEN + 4);
+  struct udp_hdr *udphdr = (struct udp_hdr *)((u8_t *)p->payload + SIZEOF_ETH_HDR + IP_HLEN);
+
+  udphdr->src = PP_HTONS(TEST_IGMP_PORT);
+  udphdr->dest = PP_HTONS(TEST_IGMP_PORT);
+  udphdr->len = PP_HTONS(UDP_HLEN + 4);
+  return p;
+}
+
+/** General membership query to 224.0.0.1 */
+static struct pbuf *
+test_igmp_query_frame(u8_t maxresp)
+{
+  ip_addr_t allsystems;
+  struct pbuf *p;
+  u8_t *igmp;
+
+  IP4_ADDR(&allsystems, 224, 0, 0, 1);
+  p = test_igmp_frame(&allsystems, IP_PROTO_IGMP, 8);
+  igmp = (u8_t *)p->payload + SIZEOF_ETH_HDR + IP_HLEN;
+  igmp[0] = 0x11;
+  igmp[1] = maxresp;
+  *(u16_t *)&igmp[2] = inet_chksum(igmp, 8);
+  return p;
+}
+
+/** netif->output: count the IGMP reports sent */
+static err_t
+test_igmp_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+  u8_t *igmp = (u8_t *)p->payload + IPH_HL(iphdr) * 4;
+
+  fail_unless(netif == &test_netif);
+  EXPECT(IPH_PROTO(iphdr) == IP_PROTO_IGMP);
+  if (igmp[0] == 0x16) {
+    report_ctr++;
+    ip_addr_copy(report_group, *ipaddr);
+  }
+  return ERR_OK;
+}
+
+static err_t
+test_igmp_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  return ERR_OK;
+}
+
+static err_t
+test_igmp_netif_init(struct netif *netif)
+{
+  fail_unless(netif != NULL);
+  netif->output = test_igmp_output;
+  netif->linkoutput = test_igmp_linkoutput;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP | NETIF_FLAG_IGMP;
+  netif->hwaddr_len = sizeof(test_hwaddr);
+  memcpy(netif->hwaddr, test_hwaddr, sizeof(test_hwaddr));
+  netif_set_igmp_mac_filter(netif, test_igmp_mac_filter);
+  return ERR_OK;
+}
+
+static void
+test_igmp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+  recv_ctr++;
+  pbuf_free(p);
+}
+
+static void
+test_igmp_group(ip_addr_t *group, u8_t b, int k)
+{
+  IP4_ADDR(group, 239, b, (u8_t)(k >> 8), (u8_t)k);
+}
+
+static int
+test_igmp_join(u8_t b, int n)
+{
+  ip_addr_t group;
+  int k, joined = 0;
+
+  for (k = 0; k < n; k++) {
+    test_igmp_group(&group, b, k);
+    if (igmp_joingroup(IP_ADDR_ANY, &group) == ERR_OK) {
+      joined++;
+    }
+  }
+  return joined;
+}
+
+static void
+test_igmp_leave(u8_t b, int n)
+{
+  ip_addr_t group;
+  int k;
+
+  for (k = 0; k < n; k++) {
+    test_igmp_group(&group, b, k);
+    EXPECT(igmp_leavegroup(IP_ADDR_ANY, &group) == ERR_OK);
+  }
+}
+
+
+/* Setups/teardown functions */
+
+static void
+igmp_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192,168,0,1);
+  IP4_ADDR(&test_netmask, 255,255,255,0);
+  IP4_ADDR(&test_gw, 192,168,0,254);
+  IP4_ADDR(&test_src, 192,168,0,2);
+
+  memset(mac_hash_cnt, 0, sizeof(mac_hash_cnt));
+  mac_add_ctr = mac_del_ctr = 0;
+  mac_dropped = mac_passed = 0;
+  report_ctr = 0;
+  recv_ctr = 0;
+
+  fail_unless(netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw,
+                        NULL, test_igmp_netif_init, ethernet_input) != NULL);
+  netif_set_up(&test_netif);
+  /* igmp_start() joined 224.0.0.1 */
+  fail_unless(mac_add_ctr == 1);
+
+  test_pcb = udp_new();
+  fail_unless(test_pcb != NULL);
+  fail_unless(udp_bind(test_pcb, IP_ADDR_ANY, TEST_IGMP_PORT) == ERR_OK);
+  udp_recv(test_pcb, test_igmp_recv, NULL);
+}
+
+static void
+igmp_teardown(void)
+{
+  udp_remove(test_pcb);
+  netif_remove(&test_netif);
+  /* igmp_stop() deleted every group from the MAC filter */
+  fail_unless(mac_add_ctr == mac_del_ctr);
+}
+
+
+/* Test functions */
+
+/** Joined groups are found in the netif's table and programmed into the MAC
+ * filter once, leaving removes them again */
+START_TEST(test_igmp_join_leave)
+{
+  ip_addr_t group;
+  int k, i, bits, joined;
+  const int n = 128;
+  LWIP_UNUSED_ARG(_i);
+
+  joined = test_igmp_join(1, n);
+  EXPECT_RET(joined == n);
+  EXPECT(mac_add_ctr == 1 + n);
+  EXPECT(report_ctr == n);
+  for (k = 0; k < n; k++) {
+    test_igmp_group(&group, 1, k);
+    EXPECT(igmp_lookfor_group(&test_netif, &group) != NULL);
+  }
+  test_igmp_group(&group, 1, n);
+  EXPECT(igmp_lookfor_group(&test_netif, &group) == NULL);
+
+  /* the groups are spread over the buckets */
+  for (i = 0; i < IGMP_GROUP_HASH_SIZE; i++) {
+    EXPECT(test_netif.igmp_groups[i] != NULL);
+  }
+
+  /* a second join only counts the use */
+  test_igmp_group(&group, 1, 0);
+  EXPECT(igmp_joingroup(IP_ADDR_ANY, &group) == ERR_OK);
+  EXPECT(mac_add_ctr == 1 + n);
+  EXPECT(igmp_leavegroup(IP_ADDR_ANY, &group) == ERR_OK);
+  EXPECT(mac_del_ctr == 0);
+  EXPECT(igmp_lookfor_group(&test_netif, &group) != NULL);
+
+  test_igmp_leave(1, n);
+  EXPECT(mac_del_ctr == n);
+  for (k = 0; k < n; k++) {
+    test_igmp_group(&group, 1, k);
+    EXPECT(igmp_lookfor_group(&test_netif, &group) == NULL);
+  }
+  /* only 224.0.0.1 is left in the MAC filter */
+  bits = 0;
+  for (i = 0; i < 64; i++) {
+    bits += mac_hash_cnt[i];
+  }
+  EXPECT(bits == 1);
+}
+END_TEST
+
+/** A general query received through the MAC is answered with one report per
+ * group from all buckets */
+START_TEST(test_igmp_query)
+{
+  int t, joined;
+  const int n = 40;
+  LWIP_UNUSED_ARG(_i);
+
+  joined = test_igmp_join(1, n);
+  EXPECT_RET(joined == n);
+  /* let the unsolicited reports go out */
+  for (t = 0; t < IGMP_JOIN_DELAYING_MEMBER_TMR; t++) {
+    igmp_tmr();
+  }
+  report_ctr = 0;
+
+  test_igmp_mac_rx(test_igmp_query_frame(10));
+  EXPECT(mac_passed == 1);
+  for (t = 0; t < 10; t++) {
+    igmp_tmr();
+  }
+  EXPECT(report_ctr == n);
+
+  test_igmp_leave(1, n);
+}
+END_TEST
+
+/** Unwanted multicast at high group counts: the hash filter drops most of it
+ * in the MAC, the rest is dropped by ip_input() with one bucket lookup */
+START_TEST(test_igmp_mcast_filter)
+{
+  static const int counts[] = {4, 32, 128};
+  ip_addr_t group;
+  struct pbuf *p;
+  clock_t start;
+  double t_drop;
+  int c, k, n, joined, passed_unwanted, wanted;
+  const int frames = 4000;
+  LWIP_UNUSED_ARG(_i);
+
+  for (c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++) {
+    n = counts[c];
+    joined = test_igmp_join(2, n);
+    EXPECT_RET(joined == n);
+
+    /* traffic to the joined groups is all received */
+    mac_dropped = mac_passed = 0;
+    recv_ctr = 0;
+    for (k = 0; k < n; k++) {
+      test_igmp_group(&group, 2, k);
+      test_igmp_mac_rx(test_igmp_udp_frame(&group));
+    }
+    EXPECT(mac_dropped == 0);
+    EXPECT(recv_ctr == n);
+    wanted = recv_ctr;
+
+    /* traffic to other groups never reaches the application */
+    mac_dropped = mac_passed = 0;
+    recv_ctr = 0;
+    for (k = 0; k < frames; k++) {
+      test_igmp_group(&group, 3, k);
+      test_igmp_mac_rx(test_igmp_udp_frame(&group));
+    }
+    EXPECT(recv_ctr == 0);
+    EXPECT(mac_dropped + mac_passed == frames);
+    if (n <= 32) {
+      /* most of the 64 hash bits are still clear */
+      EXPECT(mac_dropped > frames / 2);
+    }
+    passed_unwanted = mac_passed;
+
+    /* cost of dropping an unwanted datagram that passed the MAC */
+    test_igmp_group(&group, 3, 0);
+    start = clock();
+    for (k = 0; k < frames; k++) {
+      p = test_igmp_udp_frame(&group);
+      test_netif.input(p, &test_netif);
+    }
+    t_drop = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / frames;
+    EXPECT(recv_ctr == 0);
+
+    printf("IGMP %d groups: %d/%d received, unwanted rejected by MAC hash %.1f%% (perfect filter: %d%%), "
+      "%d reached ip_input, drop there %.2f us\n", n, wanted, n,
+      100.0 * (frames - passed_unwanted) / frames, (n + 1 <= TEST_IGMP_PERFECT) ? 100 : 0,
+      passed_unwanted, t_drop);
+
+    test_igmp_leave(2, n);
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+igmp_suite(void)
+{
+  TFun tests[] = {
+    test_igmp_join_leave,
+    test_igmp_query,
+    test_igmp_mcast_filter
+  };
+  return create_suite("IGMP", tests, sizeof(tests)/sizeof(TFun), igmp_setup, igmp_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef __TEST_IGMP_H__
+#define __TEST_IGMP_H__
+
+#include "../lwip_check.h"
+
+Suite* igmp_suite(void);
+
+#endif
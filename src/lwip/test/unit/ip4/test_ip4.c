@@ -0,0 +1,681 @@
+#include "test_ip4.h"
+
+#include "lwip/ip.h"
+#include "lwip/ip_frag.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/stats.h"
+#include "lwip/netif.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_STATS || !MEMP_STATS || !IPFRAG_STATS
+#error "This tests needs MEMP- and IPFRAG-statistics enabled"
+#endif
+#if !IP_REASSEMBLY || !IP_FRAG
+#error "This tests needs IP_REASSEMBLY and IP_FRAG enabled"
+#endif
+
+/* Memory held by fragments being sent */
+#if LWIP_NETIF_TX_SINGLE_PBUF
+#define TEST_IP4_FRAG_USED()  (lwip_stats.mem.used)
+#else /* LWIP_NETIF_TX_SINGLE_PBUF */
+#define TEST_IP4_FRAG_USED()  (lwip_stats.memp[MEMP_FRAG_PBUF].used)
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
+
+/* Helper functions */
+
+/** Payload byte at datagram offset 'off' of datagram 'id' */
+#define TEST_DATA(id, off) ((u8_t)((id) + (off)))
+
+/** Create an IP fragment of datagram 'id' from 'src' */
+static struct pbuf *
+test_ip4_frag(u32_t src, u16_t id, u16_t offset, u16_t len, u8_t more, u8_t optlen)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  ip_addr_t addr;
+  u8_t *data;
+  u16_t hlen = (u16_t)(IP_HLEN + optlen);
+  u16_t i;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(hlen + len), PBUF_RAM);
+  EXPECT_RETNULL(p != NULL);
+  EXPECT_RETNULL(p->next == NULL);
+  iphdr = (struct ip_hdr *)p->payload;
+  IPH_VHL_SET(iphdr, 4, hlen / 4);
+  IPH_TOS_SET(iphdr, 0);
+  IPH_LEN_SET(iphdr, htons(hlen + len));
+  IPH_ID_SET(iphdr, htons(id));
+  IPH_OFFSET_SET(iphdr, htons((u16_t)((offset / 8) | (more ? IP_MF : 0))));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip4_addr_set_u32(&addr, htonl(src));
+  ip_addr_copy(iphdr->src, addr);
+  IP4_ADDR(&addr, 192, 168, 0, 1);
+  ip_addr_copy(iphdr->dest, addr);
+  data = (u8_t *)p->payload + IP_HLEN;
+  for (i = 0; i < optlen; i++) {
+    /* NOP options, followed by a recognizable pattern */
+    data[i] = (i < 4) ? 1 : (u8_t)(0xA0 + i);
+  }
+  data += optlen;
+  for (i = 0; i < len; i++) {
+    data[i] = TEST_DATA(id, offset + i);
+  }
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, hlen));
+  return p;
+}
+
+/** Check a reassembled datagram and free it */
+static void
+test_ip4_check_datagram(struct pbuf *p, u16_t id, u16_t len, u8_t optlen)
+{
+  struct ip_hdr *iphdr;
+  u16_t hlen = (u16_t)(IP_HLEN + optlen);
+  u16_t i;
+  u8_t b;
+
+  EXPECT_RET(p != NULL);
+  iphdr = (struct ip_hdr *)p->payload;
+  EXPECT(p->tot_len == hlen + len);
+  EXPECT(IPH_HL(iphdr) * 4 == hlen);
+  EXPECT(ntohs(IPH_LEN(iphdr)) == hlen + len);
+  EXPECT(IPH_OFFSET(iphdr) == 0);
+  EXPECT(ntohs(IPH_ID(iphdr)) == id);
+  EXPECT(inet_chksum(iphdr, hlen) == 0);
+  for (i = 0; i < optlen; i++) {
+    pbuf_copy_partial(p, &b, 1, (u16_t)(IP_HLEN + i));
+    EXPECT(b == ((i < 4) ? 1 : (u8_t)(0xA0 + i)));
+  }
+  for (i = 0; i < len; i++) {
+    pbuf_copy_partial(p, &b, 1, (u16_t)(hlen + i));
+    if (b != TEST_DATA(id, i)) {
+      EXPECT(b == TEST_DATA(id, i));
+      break;
+    }
+  }
+  pbuf_free(p);
+}
+
+/** Let all pending datagrams time out */
+static void
+ip4_reass_flush(void)
+{
+  int i;
+  for (i = 0; i <= IP_REASS_MAXAGE; i++) {
+    ip_reass_tmr();
+  }
+  fail_unless(lwip_stats.memp[MEMP_REASSDATA].used == 0);
+  fail_unless(lwip_stats.memp[MEMP_PBUF].used == 0);
+}
+
+/** One round of a fragment storm: the fragments 'order[0..nsend-1]' of
+ * 'ndg' interleaved datagrams of 'nfrag' 64 byte fragments each. They are
+ * passed to ip_reass() or, if 'reass' is 0, only allocated and freed. */
+static void
+test_ip4_storm_round(u16_t id, u16_t ndg, const u8_t *order, u16_t nsend, u16_t nfrag, u8_t reass)
+{
+  struct pbuf *p;
+  u16_t i, d;
+
+  for (i = 0; i < nsend; i++) {
+    for (d = 0; d < ndg; d++) {
+      p = test_ip4_frag(0x0a000000 + d, id, (u16_t)(order[i] * 64), 64, order[i] != nfrag - 1, 0);
+      if (reass) {
+        p = ip_reass(p);
+      }
+      if (p != NULL) {
+        pbuf_free(p);
+      }
+    }
+  }
+}
+
+/** Payload of the datagrams fragmented by ip_frag */
+static u8_t test_ip4_txdata[32 * 1024];
+/** Payload as put together from the fragments */
+static u8_t test_ip4_rxdata[sizeof(test_ip4_txdata)];
+static struct {
+  u16_t frags;
+  u16_t next_offset;
+  u16_t first_hlen;
+  u16_t hlen;
+  u8_t last_seen;
+} test_ip4_txstate;
+
+/** netif->output: check a fragment and copy its data */
+static err_t
+test_ip4_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  u8_t hdr[60];
+  u16_t hlen, offset, len;
+
+  LWIP_UNUSED_ARG(ipaddr);
+  EXPECT_RETX(p->tot_len <= netif->mtu, ERR_OK);
+#if LWIP_NETIF_TX_SINGLE_PBUF
+  /* one pbuf, with room for the link header */
+  EXPECT((p->next == NULL) && (p->type == PBUF_RAM));
+  EXPECT(pbuf_header(p, PBUF_LINK_HLEN) == 0);
+  pbuf_header(p, -PBUF_LINK_HLEN);
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, IP_HLEN, 0) == IP_HLEN, ERR_OK);
+  hlen = IPH_HL(&iphdr) * 4;
+  EXPECT_RETX(pbuf_copy_partial(p, hdr, hlen, 0) == hlen, ERR_OK);
+  EXPECT(inet_chksum(hdr, hlen) == 0);
+  EXPECT(ntohs(IPH_LEN(&iphdr)) == p->tot_len);
+  offset = (ntohs(IPH_OFFSET(&iphdr)) & IP_OFFMASK) * 8;
+  len = p->tot_len - hlen;
+  EXPECT(!test_ip4_txstate.last_seen);
+  EXPECT(offset == test_ip4_txstate.next_offset);
+  EXPECT_RETX(offset + len <= sizeof(test_ip4_rxdata), ERR_OK);
+  if ((ntohs(IPH_OFFSET(&iphdr)) & IP_MF) == 0) {
+    test_ip4_txstate.last_seen = 1;
+  } else {
+    EXPECT((len & 7) == 0);
+  }
+  if (test_ip4_txstate.frags == 0) {
+    test_ip4_txstate.first_hlen = hlen;
+  } else {
+    test_ip4_txstate.hlen = hlen;
+  }
+  pbuf_copy_partial(p, test_ip4_rxdata + offset, len, hlen);
+  test_ip4_txstate.next_offset = offset + len;
+  test_ip4_txstate.frags++;
+  return ERR_OK;
+}
+
+/** Number of fragments seen by test_ip4_output_count */
+static u32_t test_ip4_output_frags;
+
+/** netif->output: only count the fragments */
+static err_t
+test_ip4_output_count(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  LWIP_UNUSED_ARG(ipaddr);
+  test_ip4_output_frags++;
+  return ERR_OK;
+}
+
+/** Calls of and fragments passed to test_ip4_output_batch */
+static u32_t test_ip4_batch_calls, test_ip4_batch_frags;
+
+/** netif->output_batch: check the fragments one by one */
+static err_t
+test_ip4_output_batch(struct netif *netif, struct pbuf **p, u8_t num, ip_addr_t *ipaddr)
+{
+  u8_t i;
+
+  test_ip4_batch_calls++;
+  for (i = 0; i < num; i++) {
+    test_ip4_output(netif, p[i], ipaddr);
+    test_ip4_batch_frags++;
+  }
+  return ERR_OK;
+}
+
+/** Create a UDP datagram of 'len' bytes (taken from test_ip4_txdata),
+ * its payload in chunks of 'chunk' bytes */
+static struct pbuf *
+test_ip4_datagram(u16_t len, u16_t chunk, const u8_t *opts, u8_t optlen)
+{
+  struct pbuf *p, *q;
+  struct ip_hdr *iphdr;
+  ip_addr_t dest;
+  u16_t hlen = (u16_t)(IP_HLEN + optlen);
+  u16_t i, n;
+
+  for (i = 0; i < len; i++) {
+    test_ip4_txdata[i] = (u8_t)(i + (i >> 8));
+  }
+  IP4_ADDR(&dest, 192, 168, 0, 2);
+
+  p = pbuf_alloc(PBUF_IP, hlen, PBUF_RAM);
+  EXPECT_RETNULL(p != NULL);
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, hlen);
+  IPH_VHL_SET(iphdr, 4, hlen / 4);
+  IPH_LEN_SET(iphdr, htons(hlen + len));
+  IPH_ID_SET(iphdr, htons(0x1234));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip_addr_copy(iphdr->dest, dest);
+  if (optlen > 0) {
+    MEMCPY((u8_t *)iphdr + IP_HLEN, opts, optlen);
+  }
+  for (i = 0; i < len; i += n) {
+    n = LWIP_MIN(chunk, len - i);
+    q = pbuf_alloc(PBUF_RAW, n, PBUF_REF);
+    if (q == NULL) {
+      EXPECT(q != NULL);
+      pbuf_free(p);
+      return NULL;
+    }
+    q->payload = test_ip4_txdata + i;
+    pbuf_cat(p, q);
+  }
+  return p;
+}
+
+/** Fragment a datagram of 'len' bytes, its payload in chunks of 'chunk'
+ * bytes, expecting ip_frag to return 'err'. Returns 1 if all memory used
+ * for fragmenting was released. */
+static int
+test_ip4_frag_send(u16_t len, u16_t chunk, const u8_t *opts, u8_t optlen, err_t err)
+{
+  struct netif netif;
+  struct pbuf *p;
+  ip_addr_t dest;
+  u32_t frag_used = TEST_IP4_FRAG_USED();
+
+  memset(&netif, 0, sizeof(netif));
+  netif.mtu = 1500;
+  netif.output = test_ip4_output;
+  memset(&test_ip4_txstate, 0, sizeof(test_ip4_txstate));
+  memset(test_ip4_rxdata, 0, sizeof(test_ip4_rxdata));
+  IP4_ADDR(&dest, 192, 168, 0, 2);
+
+  p = test_ip4_datagram(len, chunk, opts, optlen);
+  EXPECT_RETX(p != NULL, 0);
+  EXPECT(ip_frag(p, &netif, &dest) == err);
+  pbuf_free(p);
+  return (TEST_IP4_FRAG_USED() == frag_used) &&
+         (lwip_stats.memp[MEMP_PBUF].used == 0);
+}
+
+/** Fragment a datagram of 'len' bytes, its payload in chunks of 'chunk'
+ * bytes, and check that the fragments put together give the datagram */
+static void
+test_ip4_frag_datagram(u16_t len, u16_t chunk, const u8_t *opts, u8_t optlen)
+{
+  u16_t hlen = (u16_t)(IP_HLEN + optlen);
+
+  fail_unless(test_ip4_frag_send(len, chunk, opts, optlen, ERR_OK));
+  EXPECT(test_ip4_txstate.last_seen);
+  EXPECT(test_ip4_txstate.next_offset == len);
+  EXPECT(memcmp(test_ip4_txdata, test_ip4_rxdata, len) == 0);
+  EXPECT(test_ip4_txstate.first_hlen == hlen);
+}
+
+/* Setups/teardown functions */
+
+static void
+ip4_setup(void)
+{
+  ip4_reass_flush();
+}
+
+static void
+ip4_teardown(void)
+{
+  ip4_reass_flush();
+}
+
+
+/* Test functions */
+
+/** Reassemble a datagram from fragments received in and out of order */
+START_TEST(test_ip4_reass_order)
+{
+  static const u8_t orders[][4] = {
+    {0, 1, 2, 3}, {3, 2, 1, 0}, {2, 0, 3, 1}, {1, 3, 0, 2}
+  };
+  struct pbuf *p;
+  u16_t o, i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (o = 0; o < sizeof(orders)/sizeof(orders[0]); o++) {
+    u16_t id = (u16_t)(0x100 + o);
+    for (i = 0; i < 4; i++) {
+      u8_t f = orders[o][i];
+      p = ip_reass(test_ip4_frag(0x0a000001, id, (u16_t)(f * 64), 64, f != 3, 0));
+      if (i < 3) {
+        EXPECT(p == NULL);
+      } else {
+        test_ip4_check_datagram(p, id, 4 * 64, 0);
+      }
+    }
+    fail_unless(lwip_stats.memp[MEMP_REASSDATA].used == 0);
+  }
+}
+END_TEST
+
+/** Duplicate and overlapping fragments are dropped */
+START_TEST(test_ip4_reass_overlap)
+{
+  struct pbuf *p;
+  u16_t drop;
+  LWIP_UNUSED_ARG(_i);
+
+  drop = lwip_stats.ip_frag.drop;
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 1, 0, 64, 1, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 1, 128, 64, 1, 0)) == NULL);
+  /* duplicate of the first and overlap of both */
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 1, 0, 64, 1, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 1, 56, 80, 1, 0)) == NULL);
+  /* last fragment, then a fragment behind it */
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 1, 192, 8, 0, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 1, 200, 8, 1, 0)) == NULL);
+  EXPECT(lwip_stats.ip_frag.drop == drop + 1);
+  p = ip_reass(test_ip4_frag(0x0a000001, 1, 64, 64, 1, 0));
+  test_ip4_check_datagram(p, 1, 200, 0);
+}
+END_TEST
+
+/** Options of the first fragment are kept, those of the others removed */
+START_TEST(test_ip4_reass_options)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 2, 64, 64, 0, 4)) == NULL);
+  p = ip_reass(test_ip4_frag(0x0a000001, 2, 0, 64, 1, 12));
+  test_ip4_check_datagram(p, 2, 128, 12);
+}
+END_TEST
+
+/** Many interleaved datagrams, more than can be reassembled at once */
+START_TEST(test_ip4_reass_storm)
+{
+  struct pbuf *p;
+  u16_t round, i, done = 0;
+  LWIP_UNUSED_ARG(_i);
+
+  for (round = 0; round < 200; round++) {
+    /* first halves of MEMP_NUM_REASSDATA datagrams from different hosts */
+    for (i = 0; i < MEMP_NUM_REASSDATA; i++) {
+      EXPECT(ip_reass(test_ip4_frag(0x0a000000 + i, round, 0, 32, 1, 0)) == NULL);
+    }
+    /* second halves in reverse order */
+    for (i = MEMP_NUM_REASSDATA; i > 0; i--) {
+      p = ip_reass(test_ip4_frag(0x0a000000 + i - 1, round, 32, 32, 0, 0));
+      if (p != NULL) {
+        test_ip4_check_datagram(p, round, 64, 0);
+        done++;
+      }
+    }
+    fail_unless(lwip_stats.memp[MEMP_REASSDATA].used == 0);
+  }
+  /* with IP_REASS_MAX_PBUFS >= 2 * MEMP_NUM_REASSDATA, all datagrams fit */
+  if (IP_REASS_MAX_PBUFS >= 2 * MEMP_NUM_REASSDATA) {
+    EXPECT(done == 200 * MEMP_NUM_REASSDATA);
+  }
+
+  /* more incomplete datagrams than fit: the oldest are thrown away */
+  for (i = 0; i < 4 * MEMP_NUM_REASSDATA; i++) {
+    EXPECT(ip_reass(test_ip4_frag(0x0b000000 + i, 1, 0, 32, 1, 0)) == NULL);
+    fail_unless(lwip_stats.memp[MEMP_REASSDATA].used <= MEMP_NUM_REASSDATA);
+  }
+  /* the newest one can still be completed */
+  p = ip_reass(test_ip4_frag(0x0b000000 + i - 1, 1, 32, 32, 0, 0));
+  test_ip4_check_datagram(p, 1, 64, 0);
+}
+END_TEST
+
+
+/** A dropped fragment must not change the datagram's header or length */
+START_TEST(test_ip4_reass_dropped_state)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+
+  /* an overlapping first fragment is dropped, the next first fragment
+   * carries options: its header must be the one used */
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 3, 8, 8, 1, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 3, 0, 24, 1, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 3, 0, 8, 1, 4)) == NULL);
+  p = ip_reass(test_ip4_frag(0x0a000001, 3, 16, 8, 0, 0));
+  test_ip4_check_datagram(p, 3, 24, 4);
+
+  /* a dropped last fragment must not set the datagram length */
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 4, 8, 8, 1, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 4, 0, 40, 0, 0)) == NULL);
+  EXPECT(ip_reass(test_ip4_frag(0x0a000001, 4, 0, 8, 1, 0)) == NULL);
+  p = ip_reass(test_ip4_frag(0x0a000001, 4, 16, 8, 0, 0));
+  test_ip4_check_datagram(p, 4, 24, 0);
+  fail_unless(lwip_stats.memp[MEMP_REASSDATA].used == 0);
+}
+END_TEST
+
+/** Time ip_reass() per fragment for different fragment storms. The cost of
+ * creating and freeing the fragments is measured separately and subtracted.
+ * Datagrams of 8 and of IP_REASS_MAX_PBUFS fragments show how the cost of
+ * out-of-order insertion grows with the number of fragments. */
+START_TEST(test_ip4_reass_speed)
+{
+  static const char *names[] = {
+    "in order", "in reverse order", "shuffled"
+  };
+  u8_t order[IP_REASS_MAX_PBUFS < 256 ? IP_REASS_MAX_PBUFS : 256];
+  u16_t ndg, nsend, nfrag, i, j;
+  u32_t rnd = 1;
+  u8_t tmp;
+  clock_t start;
+  double secs[2];
+  int c, k, reps;
+  u8_t reass;
+  LWIP_UNUSED_ARG(_i);
+
+  for (c = 0; c < 8; c++) {
+    ndg = 1;
+    nsend = nfrag = (u16_t)((c < 3) ? 8 : sizeof(order));
+    for (i = 0; i < nfrag; i++) {
+      order[i] = (u8_t)(((c % 3) == 1) ? nfrag - 1 - i : i);
+    }
+    if ((c % 3) == 2) {
+      for (i = nfrag - 1; i > 0; i--) {
+        rnd = rnd * 1103515245 + 12345;
+        j = (u16_t)((rnd >> 16) % (i + 1));
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+      }
+    }
+    if (c == 6) {
+      /* every fragment needs a hash lookup among MEMP_NUM_REASSDATA datagrams */
+      ndg = MEMP_NUM_REASSDATA;
+      nsend = nfrag = 2;
+    } else if (c == 7) {
+      /* first fragments only: every new datagram throws out the oldest */
+      ndg = 4 * MEMP_NUM_REASSDATA;
+      nsend = 1;
+      nfrag = 2;
+    }
+    reps = 160000 / (ndg * nsend);
+    for (reass = 0; reass < 2; reass++) {
+      start = clock();
+      for (k = 0; k < reps; k++) {
+        test_ip4_storm_round((u16_t)k, ndg, order, nsend, nfrag, reass);
+      }
+      secs[reass] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+    ip4_reass_flush();
+    if (c < 6) {
+      printf("ip_reass, 1 datagram, %"U16_F" fragments %s: %.1f ns per fragment\n",
+        nfrag, names[c % 3], (secs[1] - secs[0]) * 1e9 / ((double)reps * nsend));
+    } else {
+      printf("ip_reass, %s: %.1f ns per fragment\n",
+        (c == 6) ? "interleaved datagrams, 2 fragments each" : "flood of incomplete datagrams",
+        (secs[1] - secs[0]) * 1e9 / ((double)reps * ndg * nsend));
+    }
+  }
+}
+END_TEST
+
+
+/** Fragment 8 KB and 32 KB datagrams, their payload chained in pieces not
+ * matching the fragment size */
+START_TEST(test_ip4_frag_sizes)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_ip4_frag_datagram(8 * 1024, 8 * 1024, NULL, 0);
+  EXPECT(test_ip4_txstate.frags == 6);
+  test_ip4_frag_datagram(8 * 1024, 1000, NULL, 0);
+  EXPECT(test_ip4_txstate.frags == 6);
+  test_ip4_frag_datagram(32 * 1024, 3000, NULL, 0);
+  EXPECT(test_ip4_txstate.frags == 23);
+  test_ip4_frag_datagram(1481, 1481, NULL, 0);
+  EXPECT(test_ip4_txstate.frags == 2);
+}
+END_TEST
+
+/** Only options with the 'copied' flag are repeated in later fragments */
+START_TEST(test_ip4_frag_options)
+{
+  static const u8_t opts[] = {
+    0x94, 4, 0, 0,       /* router alert: copied */
+    0x07, 7, 4, 0, 0, 0, /* record route: not copied */
+    0, 0                 /* end of options, padding */
+  };
+  LWIP_UNUSED_ARG(_i);
+
+  test_ip4_frag_datagram(8 * 1024, 1000, opts, sizeof(opts));
+  EXPECT(test_ip4_txstate.hlen == IP_HLEN + 4);
+}
+END_TEST
+
+
+#if !LWIP_NETIF_TX_SINGLE_PBUF
+/** Fragments spanning several pbufs need several FRAG_PBUFs: a batch that
+ * runs out of them is sent early */
+START_TEST(test_ip4_frag_pool)
+{
+  void *held[MEMP_NUM_FRAG_PBUF];
+  u16_t i, n;
+  LWIP_UNUSED_ARG(_i);
+
+  /* leave a little more than one fragment spanning 4 pbufs can use */
+  for (n = 0; n < MEMP_NUM_FRAG_PBUF - 5; n++) {
+    held[n] = memp_malloc(MEMP_FRAG_PBUF);
+    EXPECT(held[n] != NULL);
+  }
+  test_ip4_frag_datagram(8 * 1024, 512, NULL, 0);
+  EXPECT(test_ip4_txstate.frags == 6);
+  /* not even one fragment fits: nothing is sent, nothing leaks */
+  for (; n < MEMP_NUM_FRAG_PBUF - 1; n++) {
+    held[n] = memp_malloc(MEMP_FRAG_PBUF);
+    EXPECT(held[n] != NULL);
+  }
+  fail_unless(test_ip4_frag_send(8 * 1024, 512, NULL, 0, ERR_MEM));
+  EXPECT(test_ip4_txstate.frags == 0);
+  for (i = 0; i < n; i++) {
+    memp_free(MEMP_FRAG_PBUF, held[i]);
+  }
+}
+END_TEST
+#endif /* !LWIP_NETIF_TX_SINGLE_PBUF */
+
+/** A netif with output_batch gets the fragments of a datagram in one call
+ * (up to IP_FRAG_BATCH_SIZE fragments), netif->output is not used */
+START_TEST(test_ip4_frag_batch)
+{
+  static const u16_t sizes[] = {1481, 8 * 1024, 16 * 1024, 32 * 1024};
+  struct netif netif;
+  struct pbuf *p;
+  ip_addr_t dest;
+  u32_t nfrags, ncalls;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&netif, 0, sizeof(netif));
+  netif.mtu = 1500;
+  netif.output = test_ip4_output_count;
+  netif.output_batch = test_ip4_output_batch;
+  IP4_ADDR(&dest, 192, 168, 0, 2);
+  for (i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++) {
+    nfrags = (sizes[i] + 1479) / 1480;
+    ncalls = (nfrags + IP_FRAG_BATCH_SIZE - 1) / IP_FRAG_BATCH_SIZE;
+    memset(&test_ip4_txstate, 0, sizeof(test_ip4_txstate));
+    memset(test_ip4_rxdata, 0, sizeof(test_ip4_rxdata));
+    test_ip4_output_frags = test_ip4_batch_calls = test_ip4_batch_frags = 0;
+    p = test_ip4_datagram(sizes[i], sizes[i], NULL, 0);
+    EXPECT_RET(p != NULL);
+    EXPECT(ip_frag(p, &netif, &dest) == ERR_OK);
+    pbuf_free(p);
+    EXPECT(test_ip4_output_frags == 0);
+    EXPECT(test_ip4_batch_frags == nfrags);
+#if LWIP_NETIF_TX_SINGLE_PBUF
+    /* the fragments are copies on the heap: a batch that does not fit in
+       MEM_SIZE is sent early */
+    EXPECT(test_ip4_batch_calls >= ncalls);
+#else /* LWIP_NETIF_TX_SINGLE_PBUF */
+    EXPECT(test_ip4_batch_calls == ncalls);
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
+    if (sizes[i] <= 8 * 1024) {
+      /* one call per datagram, with the default IP_FRAG_BATCH_SIZE, too */
+      EXPECT(test_ip4_batch_calls == 1);
+    }
+    EXPECT(test_ip4_txstate.last_seen && (test_ip4_txstate.next_offset == sizes[i]));
+    EXPECT(memcmp(test_ip4_txdata, test_ip4_rxdata, sizes[i]) == 0);
+  }
+}
+END_TEST
+
+/** Time ip_frag() on 8 KB and 32 KB UDP datagrams, their payload in one
+ * pbuf or in pieces not matching the fragment size */
+START_TEST(test_ip4_frag_speed)
+{
+  static const u16_t sizes[][2] = {
+    {8 * 1024, 8 * 1024}, {8 * 1024, 1000}, {32 * 1024, 32 * 1024}, {32 * 1024, 3000}
+  };
+  struct netif netif;
+  struct pbuf *p;
+  ip_addr_t dest;
+  clock_t start;
+  double secs;
+  int c, k, reps = 20000;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&netif, 0, sizeof(netif));
+  netif.mtu = 1500;
+  netif.output = test_ip4_output_count;
+  IP4_ADDR(&dest, 192, 168, 0, 2);
+  for (c = 0; c < (int)(sizeof(sizes)/sizeof(sizes[0])); c++) {
+    p = test_ip4_datagram(sizes[c][0], sizes[c][1], NULL, 0);
+    EXPECT_RET(p != NULL);
+    test_ip4_output_frags = 0;
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      ip_frag(p, &netif, &dest);
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    EXPECT(test_ip4_output_frags == (u32_t)reps * ((sizes[c][0] + 1479) / 1480));
+    printf("ip_frag, %u byte UDP datagram in %s: %.2f us per datagram, %.1f ns per fragment\n",
+      sizes[c][0], sizes[c][1] == sizes[c][0] ? "one pbuf" : "pieces",
+      secs * 1e6 / reps, secs * 1e9 / ((double)test_ip4_output_frags));
+    pbuf_free(p);
+  }
+  fail_unless(lwip_stats.memp[MEMP_PBUF].used == 0);
+#if !LWIP_NETIF_TX_SINGLE_PBUF
+  fail_unless(lwip_stats.memp[MEMP_FRAG_PBUF].used == 0);
+#endif /* !LWIP_NETIF_TX_SINGLE_PBUF */
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+ip4_suite(void)
+{
+  TFun tests[] = {
+    test_ip4_reass_order,
+    test_ip4_reass_overlap,
+    test_ip4_reass_options,
+    test_ip4_reass_storm,
+    test_ip4_reass_dropped_state,
+    test_ip4_reass_speed,
+    test_ip4_frag_sizes,
+    test_ip4_frag_options,
+    test_ip4_frag_batch,
+#if !LWIP_NETIF_TX_SINGLE_PBUF
+    test_ip4_frag_pool,
+#endif /* !LWIP_NETIF_TX_SINGLE_PBUF */
+    test_ip4_frag_speed
+  };
+  return create_suite("IP4", tests, sizeof(tests)/sizeof(TFun), ip4_setup, ip4_teardown);
+}
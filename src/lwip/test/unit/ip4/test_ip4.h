@@ -0,0 +1,8 @@
+#ifndef __TEST_IP4_H__
+#define __TEST_IP4_H__
+
+#include "../lwip_check.h"
+
+Suite* ip4_suite(void);
+
+#endif
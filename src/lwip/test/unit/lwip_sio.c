@@ -0,0 +1,64 @@
+#include "lwip_sio.h"
+
+#include "lwip/def.h"
+
+struct test_sio *test_sio_devs[TEST_SIO_DEVS];
+
+sio_fd_t
+sio_open(u8_t devnum)
+{
+  if (devnum >= TEST_SIO_DEVS) {
+    return NULL;
+  }
+  return test_sio_devs[devnum];
+}
+
+void
+sio_send(u8_t c, sio_fd_t fd)
+{
+  struct test_sio *sio = (struct test_sio *)fd;
+  sio->write(sio, &c, 1);
+}
+
+u32_t
+sio_read(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  return sio_tryread(fd, data, len);
+}
+
+u32_t
+sio_tryread(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  struct test_sio *sio = (struct test_sio *)fd;
+  if (sio->read == NULL) {
+    return 0;
+  }
+  return sio->read(sio, data, len);
+}
+
+u32_t
+sio_write(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  struct test_sio *sio = (struct test_sio *)fd;
+  return sio->write(sio, data, len);
+}
+
+u32_t
+sio_writev(sio_fd_t fd, const struct sio_iovec *iov, u8_t cnt)
+{
+  struct test_sio *sio = (struct test_sio *)fd;
+  u32_t len = 0;
+  u8_t i;
+
+  sio->max_segs = LWIP_MAX(sio->max_segs, cnt);
+  for (i = 0; i < cnt; i++) {
+    len += sio->write(sio, iov[i].data, iov[i].len);
+  }
+  return len;
+}
+
+void
+sio_read_abort(sio_fd_t fd)
+{
+  LWIP_UNUSED_ARG(fd);
+}
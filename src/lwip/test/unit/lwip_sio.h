@@ -0,0 +1,23 @@
+#ifndef __LWIP_SIO_TEST_H__
+#define __LWIP_SIO_TEST_H__
+
+/* Serial devices for the lwIP unit tests: the sio_*() functions of
+ * lwip/sio.h, implemented by dispatching to handlers set up by the tests */
+
+#include "lwip/sio.h"
+
+/** A test serial device: a sio_fd_t points to one of these */
+struct test_sio {
+  /** called for sio_send(), sio_write() and each segment of sio_writev() */
+  u32_t (*write)(struct test_sio *sio, const u8_t *data, u32_t len);
+  /** called for sio_read() and sio_tryread(), must not block (may be NULL) */
+  u32_t (*read)(struct test_sio *sio, u8_t *data, u32_t len);
+  /** most segments passed to one sio_writev() */
+  u8_t max_segs;
+};
+
+/** Devices returned by sio_open(devnum) */
+#define TEST_SIO_DEVS 4
+extern struct test_sio *test_sio_devs[TEST_SIO_DEVS];
+
+#endif /* __LWIP_SIO_TEST_H__ */
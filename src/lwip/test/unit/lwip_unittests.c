@@ -5,8 +5,27 @@
 #include "tcp/test_tcp_oos.h"
 #include "core/test_mem.h"
 #include "etharp/test_etharp.h"
+#include "ip4/test_ip4.h"
+#include "dns/test_dns.h"
+#include "dhcp/test_dhcp.h"
+#include "snmp/test_snmp.h"
+#include "igmp/test_igmp.h"
+#include "core/test_stats.h"
+#include "core/test_crc32.h"
+#include "core/test_rng.h"
+#include "core/test_bpf.h"
+#include "ppp/test_pppos.h"
+#include "ppp/test_vj.h"
+#include "ppp/test_digest.h"
+#include "cryp/test_aes_gcm.h"
+#include "slip/test_slipif.h"
+#include "pcapng/test_pcapng.h"
+#include "api/test_sockets.h"
+#include "api/test_tcpip.h"
+#include "api/test_netconn.h"
 
 #include "lwip/init.h"
+#include "lwip/tcpip.h"
 
 
 int main()
@@ -19,12 +38,34 @@ int main()
     tcp_suite,
     tcp_oos_suite,
     mem_suite,
-    etharp_suite
+    etharp_suite,
+    ip4_suite,
+    dns_suite,
+    dhcp_suite,
+    snmp_suite,
+    igmp_suite,
+    stats_suite,
+    crc32_suite,
+    pppos_suite,
+    vj_suite,
+    digest_suite,
+    aes_gcm_suite,
+    slipif_suite,
+    rng_suite,
+    bpf_suite,
+    pcapng_suite,
+    sockets_suite,
+#if LWIP_NETCONN_ASYNC
+    /* not available with LWIP_TCPIP_CORE_LOCKING */
+    netconn_suite,
+#endif /* LWIP_NETCONN_ASYNC */
+    tcpip_suite
   };
   size_t num = sizeof(suites)/sizeof(void*);
   LWIP_ASSERT("No suites defined", num > 0);
 
-  lwip_init();
+  /* without a thread: this only initializes the stack and the mailbox */
+  tcpip_init(NULL, NULL);
 
   sr = srunner_create((suites[0])());
   for(i = 1; i < num; i++) {
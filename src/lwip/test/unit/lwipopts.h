@@ -32,10 +32,15 @@
 #ifndef __LWIPOPTS_H__
 #define __LWIPOPTS_H__
 
-/* Prevent having to link sys_arch.c (we don't test the API layers in unit tests) */
-#define NO_SYS                          1
-#define LWIP_NETCONN                    0
-#define LWIP_SOCKET                     0
+/* The API layers run on the single-threaded sys_arch in arch/sys_arch.c:
+   tcpip_thread is not started, tests call tcpip_thread_poll_one() */
+#define NO_SYS                          0
+#define LWIP_NETCONN                    1
+#define LWIP_SOCKET                     1
+#define TCPIP_THREAD_TEST
+/* nothing runs in its own thread, input is fed in by the tests */
+#define SLIP_USE_RX_THREAD              0
+#define PPP_INPROC_MULTITHREADED        0
 
 /* Minimal changes to opt.h required for tcp unit tests: */
 #define MEM_SIZE                        16000
@@ -47,4 +52,89 @@
 /* Minimal changes to opt.h required for etharp unit tests: */
 #define ETHARP_SUPPORT_STATIC_ENTRIES   1
 
+/* Minimal changes to opt.h required for ip4 unit tests
+   (they also build with -DLWIP_NETIF_TX_SINGLE_PBUF=1): */
+#define LWIP_NETIF_OUTPUT_BATCH         1
+/* enough for datagrams of 64 fragments (test_ip4_reass_speed) */
+#define IP_REASS_MAX_PBUFS              64
+
+/* Minimal changes to opt.h required for dns unit tests: */
+#define LWIP_DNS                        1
+#define DNS_TABLE_SIZE                  8
+#define DNS_RACE_SERVERS                1
+
+/* Minimal changes to opt.h required for dhcp unit tests: */
+#define LWIP_DHCP                       1
+#define LWIP_DHCP_RAPID_COMMIT          1
+#define LWIP_DHCP_LEASE_STORE           1
+#define LWIP_DHCP_OPTION_CALLBACK       1
+
+/* Minimal changes to opt.h required for snmp unit tests: */
+#define LWIP_SNMP                       1
+#define SNMP_V2C                        1
+#define SNMP_GETNEXT_CACHE              2
+#define MEMP_NUM_UDP_PCB                128
+#define MEMP_NUM_SNMP_NODE              256
+#define MEMP_NUM_SNMP_ROOTNODE          64
+#define MEMP_NUM_SNMP_VARBIND           64
+#define MEMP_NUM_SNMP_VALUE             128
+
+/* Minimal changes to opt.h required for igmp unit tests: */
+#define LWIP_IGMP                       1
+#define IGMP_GROUP_HASH_SIZE            16
+#define MEMP_NUM_IGMP_GROUP             130
+
+/* Minimal changes to opt.h required for stats unit tests: */
+#define LWIP_STATS_SNAPSHOT             1
+#define LWIP_STATS_EXPORT               1
+/* packet counters bumped "from an interrupt" go to shard 1 */
+#define LWIP_STATS_SHARDS               2
+#define LWIP_STATS_SHARD()              test_sys_arch_in_isr
+
+/* Minimal changes to opt.h required for crc32 unit tests: */
+#define LWIP_CRC32                      1
+
+/* Minimal changes to opt.h required for pppos unit tests: */
+#define PPP_SUPPORT                     1
+#define PPPOS_TX_RING_SIZE              6100
+
+/* Minimal changes to opt.h required for vj unit tests: */
+#define VJ_SUPPORT                      1
+#define VJ_MAX_SLOTS                    64
+
+/* Minimal changes to opt.h required for digest unit tests: */
+#define CHAP_SUPPORT                    1
+
+/* Minimal changes to opt.h required for slipif unit tests: */
+#define LWIP_HAVE_SLIPIF                1
+#define SLIP_RX_FROM_ISR                1
+#define SLIP_TX_BUFSIZE                 (2 * 1500 + 2)
+
+/* Minimal changes to opt.h required for rng unit tests: */
+#define LWIP_RNG                        1
+#define TCP_RANDOM_LOCAL_PORTS          1
+/* TCP_ISN_RFC6528 stays 0: the tcp tests preset the ISN through tcp_ticks */
+
+/* Minimal changes to opt.h required for bpf unit tests: */
+#define LWIP_BPF                        1
+
+/* Minimal changes to opt.h required for sockets unit tests: */
+#define LWIP_SOCKET_ZEROCOPY            1
+#define LWIP_SOCKET_POLL                1
+#define LWIP_SOCKET_EPOLL               1
+/* test_sockets_wakeup waits on up to 64 sockets */
+#define MEMP_NUM_NETCONN                64
+
+/* Minimal changes to opt.h required for tcpip unit tests: */
+#define TCPIP_MBOX_BATCH                3
+#define LWIP_TCPIP_INPUT_BATCH          1
+#define LWIP_NETCONN_BATCH              1
+#define MEMP_NUM_NETBUF                 NETCONN_BATCH_MAX
+/* the core mutex with -DLWIP_TCPIP_CORE_LOCKING=1 */
+#define LWIP_TCPIP_CORE_MUTEX_NEW(m)    test_sys_mutex_new_pi(m)
+
+/* Minimal changes to opt.h required for netconn unit tests
+   (the other suites also build with -DLWIP_TCPIP_CORE_LOCKING=1): */
+#define LWIP_NETCONN_ASYNC              (!LWIP_TCPIP_CORE_LOCKING)
+
 #endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,649 @@
+#include "test_pcapng.h"
+
+#include "lwip/bpf.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/ip.h"
+#include "lwip/sys.h"
+#include "netif/etharp.h"
+#include "../tcp/tcp_helper.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !LWIP_BPF || !LWIP_TCP
+#error "This tests needs LWIP_BPF and LWIP_TCP"
+#endif
+
+/* The capture server from ports/pcapng is built on the host. Its output
+ * is checked by the pcap-ng reader below, and streamed over TCP to a
+ * client on the same stack through a netif that loops packets back. */
+#include "../../../ports/pcapng/pcapng.c"
+
+static struct netif test_netif;
+static const u8_t test_mac[ETHARP_HWADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static u32_t test_linkoutput_calls;
+
+/* packets sent by test_netif, fed to ip_input() by test_pcapng_run() */
+#define TEST_PCAPNG_QLEN 64
+static struct pbuf *test_q[TEST_PCAPNG_QLEN];
+static int test_qlen;
+
+
+/* A pcap-ng reader */
+
+struct test_pcapng_pkt {
+  u32_t ts_high, ts_low;
+  u32_t caplen, len;
+  u32_t flags;
+  const u8_t *data;
+};
+
+struct test_pcapng_file {
+  u32_t snaplen;
+  u16_t linktype;
+  u8_t tsresol;
+  int npkts;
+  struct test_pcapng_pkt pkts[64];
+};
+
+static u32_t
+test_get32(const u8_t *b)
+{
+  return b[0] | ((u32_t)b[1] << 8) | ((u32_t)b[2] << 16) | ((u32_t)b[3] << 24);
+}
+
+static u16_t
+test_get16(const u8_t *b)
+{
+  return (u16_t)(b[0] | (b[1] << 8));
+}
+
+/** Walk the options from 'b' to 'end', return the value of option 'code'
+ * (NULL if not there) or 'end' itself if the options are malformed */
+static const u8_t *
+test_pcapng_opt(const u8_t *b, const u8_t *end, u16_t code, u16_t *len)
+{
+  const u8_t *found = NULL;
+  u16_t c, l;
+
+  while (b + 4 <= end) {
+    c = test_get16(b);
+    l = test_get16(b + 2);
+    if (c == 0) {
+      return (b + 4 == end) ? found : end;
+    }
+    if (b + 4 + ((l + 3) & ~3) > end) {
+      return end;
+    }
+    if (c == code) {
+      found = b + 4;
+      *len = l;
+    }
+    b += 4 + ((l + 3) & ~3);
+  }
+  return (b == end) ? found : end;
+}
+
+/** Parse a little-endian section with one interface. Returns 0 if the
+ * stream is malformed, 1 otherwise. */
+static int
+test_pcapng_parse(const u8_t *b, u32_t n, struct test_pcapng_file *f)
+{
+  const u8_t *end = b + n, *opt;
+  u32_t type, blen;
+  u16_t olen = 0;
+  int nifs = 0;
+
+  memset(f, 0, sizeof(*f));
+  f->tsresol = 6; /* default: microseconds */
+  if ((n < 28) || (test_get32(b) != 0x0A0D0D0A) || (test_get32(b + 8) != 0x1A2B3C4D) ||
+      (test_get16(b + 12) != 1) || (test_get16(b + 14) != 0)) {
+    return 0;
+  }
+  while (b < end) {
+    if (end - b < 12) {
+      return 0;
+    }
+    type = test_get32(b);
+    blen = test_get32(b + 4);
+    if ((blen < 12) || (blen & 3) || (blen > (u32_t)(end - b)) || (test_get32(b + blen - 4) != blen)) {
+      return 0;
+    }
+    switch (type) {
+    case 0x0A0D0D0A:
+      if (blen < 28) {
+        return 0;
+      }
+      break;
+    case 1:
+      if (blen < 20) {
+        return 0;
+      }
+      f->linktype = test_get16(b + 8);
+      f->snaplen = test_get32(b + 12);
+      opt = test_pcapng_opt(b + 16, b + blen - 4, 9, &olen);
+      if (opt == b + blen - 4) {
+        return 0;
+      }
+      if (opt != NULL) {
+        if (olen != 1) {
+          return 0;
+        }
+        f->tsresol = opt[0];
+      }
+      nifs++;
+      break;
+    case 6: {
+      struct test_pcapng_pkt *pkt = &f->pkts[f->npkts];
+      if ((blen < 32) || (test_get32(b + 8) >= (u32_t)nifs) || (f->npkts == 64)) {
+        return 0;
+      }
+      pkt->ts_high = test_get32(b + 12);
+      pkt->ts_low = test_get32(b + 16);
+      pkt->caplen = test_get32(b + 20);
+      pkt->len = test_get32(b + 24);
+      pkt->data = b + 28;
+      if ((pkt->caplen > pkt->len) || (28 + ((pkt->caplen + 3) & ~3) + 4 > blen) ||
+          ((f->snaplen != 0) && (pkt->caplen > f->snaplen))) {
+        return 0;
+      }
+      opt = test_pcapng_opt(b + 28 + ((pkt->caplen + 3) & ~3), b + blen - 4, 2, &olen);
+      if (opt == b + blen - 4) {
+        return 0;
+      }
+      if (opt != NULL) {
+        if (olen != 4) {
+          return 0;
+        }
+        pkt->flags = test_get32(opt);
+      }
+      f->npkts++;
+      break;
+    }
+    default:
+      /* other blocks are skipped */
+      break;
+    }
+    b += blen;
+  }
+  return 1;
+}
+
+
+/* Helper functions */
+
+/** A frame of 'len' bytes whose contents follow from 'seed' */
+static void
+test_pcapng_frame(u8_t *f, u16_t len, u32_t seed)
+{
+  u16_t i;
+
+  for (i = 0; i < len; i++) {
+    f[i] = (u8_t)(seed * 13 + i * 7 + (i >> 8));
+  }
+}
+
+static struct pbuf *
+test_pcapng_pbuf(const u8_t *data, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+
+  fail_unless(p != NULL);
+  memcpy(p->payload, data, len);
+  return p;
+}
+
+/** An ARP packet from 'mac'/'ip' */
+static struct pbuf *
+test_pcapng_arp(u16_t opcode, const u8_t *mac, u8_t ip, const u8_t *dmac, u8_t dip)
+{
+  u8_t f[42];
+
+  memset(f, 0, sizeof(f));
+  memcpy(f, (opcode == ARP_REQUEST) ? ethbroadcast.addr : dmac, 6);
+  memcpy(f + 6, mac, 6);
+  f[12] = 0x08; f[13] = 0x06;
+  f[15] = 1;                      /* Ethernet */
+  f[16] = 0x08;                   /* IP */
+  f[18] = 6; f[19] = 4;
+  f[21] = (u8_t)opcode;
+  memcpy(f + 22, mac, 6);
+  f[28] = 192; f[29] = 168; f[30] = 1; f[31] = ip;
+  if (opcode == ARP_REPLY) {
+    memcpy(f + 32, dmac, 6);
+  }
+  f[38] = 192; f[39] = 168; f[40] = 1; f[41] = dip;
+  return test_pcapng_pbuf(f, sizeof(f));
+}
+
+static err_t
+test_pcapng_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  struct pbuf *q;
+
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+  fail_unless(test_qlen < TEST_PCAPNG_QLEN);
+  q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_POOL);
+  fail_unless(q != NULL);
+  fail_unless(pbuf_copy(q, p) == ERR_OK);
+  test_q[test_qlen++] = q;
+  return ERR_OK;
+}
+
+static err_t
+test_pcapng_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  test_linkoutput_calls++;
+  return ERR_OK;
+}
+
+static err_t
+test_pcapng_netif_init(struct netif *netif)
+{
+  netif->output = test_pcapng_output;
+  netif->linkoutput = test_pcapng_linkoutput;
+  netif->mtu = 1500;
+  netif->hwaddr_len = ETHARP_HWADDR_LEN;
+  memcpy(netif->hwaddr, test_mac, ETHARP_HWADDR_LEN);
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/** Deliver what test_netif sent and run the TCP timers 'ticks' times */
+static void
+test_pcapng_run(int ticks)
+{
+  struct pbuf *p;
+  int i;
+
+  for (i = 0; i <= ticks; i++) {
+    while (test_qlen > 0) {
+      p = test_q[0];
+      memmove(test_q, test_q + 1, --test_qlen * sizeof(test_q[0]));
+      ip_input(p, &test_netif);
+    }
+    if (i < ticks) {
+      tcp_tmr();
+    }
+  }
+}
+
+/* what the streaming client received */
+static u8_t test_rx[64 * 1600];
+static u32_t test_rx_len;
+static u32_t test_rx_err;
+static u8_t test_rx_closed;
+
+static err_t
+test_pcapng_client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  if (p == NULL) {
+    test_rx_closed = 1;
+    return ERR_OK;
+  }
+  fail_unless(test_rx_len + p->tot_len <= sizeof(test_rx));
+  pbuf_copy_partial(p, test_rx + test_rx_len, p->tot_len, 0);
+  test_rx_len += p->tot_len;
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static void
+test_pcapng_client_err(void *arg, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  test_rx_err++;
+}
+
+static struct tcp_pcb *
+test_pcapng_connect(void)
+{
+  struct tcp_pcb *pcb = tcp_new();
+
+  fail_unless(pcb != NULL);
+  tcp_recv(pcb, test_pcapng_client_recv);
+  tcp_err(pcb, test_pcapng_client_err);
+  fail_unless(tcp_connect(pcb, &test_netif.ip_addr, PCAPNG_PORT, NULL) == ERR_OK);
+  return pcb;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+pcapng_setup(void)
+{
+  ip_addr_t addr, mask, gw;
+
+  IP4_ADDR(&addr, 192, 168, 1, 1);
+  IP4_ADDR(&mask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 192, 168, 1, 254);
+  fail_unless(netif_add(&test_netif, &addr, &mask, &gw, NULL, test_pcapng_netif_init, ethernet_input) != NULL);
+  netif_set_up(&test_netif);
+  test_linkoutput_calls = 0;
+  test_qlen = 0;
+  test_rx_len = 0;
+  test_rx_err = 0;
+  test_rx_closed = 0;
+  srand(50);
+}
+
+static void
+pcapng_teardown(void)
+{
+  test_pcapng_run(0);
+  netif_set_capture(&test_netif, NULL);
+  netif_remove(&test_netif);
+  /* the server's listen pcb: tcp_remove_all() only aborts */
+  while (tcp_listen_pcbs.listen_pcbs != NULL) {
+    tcp_close((struct tcp_pcb *)tcp_listen_pcbs.listen_pcbs);
+  }
+  tcp_remove_all();
+  pcapng_client = NULL;
+}
+
+
+/* Test functions */
+
+/** A ring with snaplen 0 holds the pbufs, reads them as they are then and lets them go */
+START_TEST(test_pcapng_ref)
+{
+  static u32_t buf[(3 * BPF_RING_REF_SIZE) / 4];
+  struct bpf_ring ring;
+  struct bpf_ring_hdr hdr;
+  struct pbuf *p[4], *q;
+  u8_t f[600], out[600];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), NULL, 0) == ERR_OK);
+  for (i = 0; i < 4; i++) {
+    test_pcapng_frame(f, sizeof(f), i);
+    /* a chain of 100 + 500 bytes */
+    p[i] = test_pcapng_pbuf(f, 100);
+    pbuf_cat(p[i], test_pcapng_pbuf(f + 100, 500));
+    bpf_ring_add(&ring, p[i], BPF_RING_OUT);
+    fail_unless(p[i]->ref == 2);
+  }
+  /* three fit, the first was let go */
+  fail_unless(ring.count == 3);
+  fail_unless(ring.overwritten == 1);
+  fail_unless(p[0]->ref == 1);
+
+  /* the stack hides the Ethernet header: the record still starts with it */
+  pbuf_header(p[1], -SIZEOF_ETH_HDR);
+  fail_unless(bpf_ring_read(&ring, &hdr, out, sizeof(out)) == ERR_OK);
+  test_pcapng_frame(f, sizeof(f), 1);
+  fail_unless((hdr.len == 600) && (hdr.caplen == 600) && (hdr.flags == BPF_RING_OUT));
+  fail_unless(memcmp(out, f, 600) == 0);
+  fail_unless(p[1]->ref == 1);
+
+  /* trimmed by pbuf_realloc(): only what is left is read */
+  pbuf_realloc(p[2], 150);
+  memset(out, 0, sizeof(out));
+  fail_unless(bpf_ring_read(&ring, &hdr, out, 80) == ERR_OK);
+  test_pcapng_frame(f, sizeof(f), 2);
+  fail_unless((hdr.len == 600) && (hdr.caplen == 150));
+  fail_unless((memcmp(out, f, 80) == 0) && (out[80] == 0));
+
+  /* flushing releases the rest */
+  fail_unless(p[3]->ref == 2);
+  bpf_ring_flush(&ring);
+  fail_unless((ring.count == 0) && (p[3]->ref == 1));
+  fail_unless(bpf_ring_read(&ring, &hdr, out, sizeof(out)) == ERR_BUF);
+  for (i = 0; i < 4; i++) {
+    fail_unless(pbuf_free(p[i]) != 0);
+  }
+
+  /* a filter still cuts the length */
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), &pcapng_filter, 0) == ERR_OK);
+  q = test_pcapng_pbuf(f, 60);
+  bpf_ring_add(&ring, q, BPF_RING_IN);
+  fail_unless(bpf_ring_read(&ring, &hdr, out, sizeof(out)) == ERR_OK);
+  fail_unless((hdr.caplen == 60) && (q->ref == 1));
+  pbuf_free(q);
+}
+END_TEST
+
+/** Frames are recorded in both directions where etharp hands them over */
+START_TEST(test_pcapng_taps)
+{
+  static const u8_t mac2[6] = {0x02, 0, 0, 0, 0, 2};
+  static const u8_t mac3[6] = {0x02, 0, 0, 0, 0, 3};
+  static const u32_t want_flags[5] = {BPF_RING_OUT, BPF_RING_IN, BPF_RING_OUT, BPF_RING_IN, BPF_RING_OUT};
+  static const u16_t want_type[5] = {ETHTYPE_ARP, ETHTYPE_ARP, ETHTYPE_IP, ETHTYPE_ARP, ETHTYPE_ARP};
+  static u32_t buf[1024];
+  struct bpf_ring ring;
+  struct bpf_ring_hdr hdr;
+  ip_addr_t dst;
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  u8_t out[128];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), NULL, 64) == ERR_OK);
+  netif_set_capture(&test_netif, &ring);
+
+  /* an IP packet to an unknown host: ARP request out */
+  IP4_ADDR(&dst, 192, 168, 1, 2);
+  p = pbuf_alloc(PBUF_IP, 20, PBUF_RAM);
+  memset(p->payload, 0, p->len);
+  iphdr = (struct ip_hdr *)p->payload;
+  IPH_VHL_SET(iphdr, 4, 5);
+  fail_unless(etharp_output(&test_netif, p, &dst) == ERR_OK);
+  pbuf_free(p);
+  /* the reply comes in, the queued packet goes out */
+  ethernet_input(test_pcapng_arp(ARP_REPLY, mac2, 2, test_mac, 1), &test_netif);
+  /* a request for us comes in, the reply goes out */
+  ethernet_input(test_pcapng_arp(ARP_REQUEST, mac3, 3, NULL, 1), &test_netif);
+  fail_unless(test_linkoutput_calls == 3);
+  fail_unless(ring.count == 5);
+
+  for (i = 0; i < 5; i++) {
+    fail_unless(bpf_ring_read(&ring, &hdr, out, sizeof(out)) == ERR_OK);
+    fail_unless(hdr.flags == want_flags[i]);
+    fail_unless(((out[12] << 8) | out[13]) == want_type[i]);
+    if (hdr.flags == BPF_RING_OUT) {
+      fail_unless(memcmp(out + 6, test_mac, 6) == 0);
+    }
+  }
+
+  /* nothing is recorded once the capture is off */
+  netif_set_capture(&test_netif, NULL);
+  ethernet_input(test_pcapng_arp(ARP_REQUEST, mac3, 3, NULL, 1), &test_netif);
+  fail_unless((test_linkoutput_calls == 4) && (ring.count == 0));
+}
+END_TEST
+
+/** Blocks as a pcap-ng reader expects them, long frames cut to the block size */
+START_TEST(test_pcapng_format)
+{
+  static u32_t buf[4096];
+  static u8_t out[64 * 1600];
+  struct test_pcapng_file file;
+  struct bpf_ring ring;
+  struct pbuf *p;
+  u8_t f[1514];
+  u32_t n, t0, t1;
+  u16_t len[20], blk;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), NULL, 1514) == ERR_OK);
+  t0 = sys_now();
+  for (i = 0; i < 10; i++) {
+    len[i] = (u16_t)((i == 0) ? 1514 : 42 + rand() % 1400);
+    test_pcapng_frame(f, len[i], i);
+    p = test_pcapng_pbuf(f, len[i]);
+    bpf_ring_add(&ring, p, (i & 1) ? BPF_RING_OUT : BPF_RING_IN);
+    pbuf_free(p);
+  }
+  t1 = sys_now();
+
+  n = pcapng_shb(out);
+  n += pcapng_idb(out + n, PCAPNG_LINKTYPE_ETHERNET, 1000);
+  fail_unless(n == PCAPNG_SHB_SIZE + PCAPNG_IDB_SIZE);
+  /* 1000 bytes of data per block at most */
+  while ((blk = pcapng_next(&ring, out + n, 1000 + PCAPNG_EPB_OVERHEAD)) != 0) {
+    fail_unless((blk & 3) == 0);
+    n += blk;
+  }
+  fail_unless(ring.count == 0);
+
+  fail_unless(test_pcapng_parse(out, n, &file));
+  fail_unless((file.linktype == 1) && (file.snaplen == 1000) && (file.tsresol == 3));
+  fail_unless(file.npkts == 10);
+  for (i = 0; i < 10; i++) {
+    struct test_pcapng_pkt *pkt = &file.pkts[i];
+    test_pcapng_frame(f, len[i], i);
+    fail_unless(pkt->len == len[i]);
+    fail_unless(pkt->caplen == LWIP_MIN(len[i], 1000));
+    fail_unless(memcmp(pkt->data, f, pkt->caplen) == 0);
+    fail_unless(pkt->flags == ((i & 1) ? 2u : 1u));
+    fail_unless((pkt->ts_high == 0) && (pkt->ts_low - t0 <= t1 - t0));
+  }
+
+  /* the reader catches a damaged block */
+  out[PCAPNG_SHB_SIZE + PCAPNG_IDB_SIZE + 4]++;
+  fail_unless(!test_pcapng_parse(out, n, &file));
+  fail_unless(pcapng_next(&ring, out, sizeof(out)) == 0);
+
+  /* a buffer larger than 64 KB holds the whole frame */
+  p = test_pcapng_pbuf(f, 1514);
+  bpf_ring_add(&ring, p, BPF_RING_IN);
+  pbuf_free(p);
+  fail_unless(pcapng_next(&ring, out, sizeof(out)) == PCAPNG_EPB_OVERHEAD + 1516);
+}
+END_TEST
+
+/** A client gets the header, what was captured before it connected and what is captured after */
+START_TEST(test_pcapng_stream)
+{
+  static u32_t buf[4096];
+  struct test_pcapng_file file;
+  struct bpf_ring ring;
+  struct tcp_pcb *c = NULL, *c2;
+  struct pbuf *p;
+  u8_t f[1514];
+  u16_t len[40];
+  int i, k;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), &pcapng_filter, 1514) == ERR_OK);
+  fail_unless(pcapng_start(&test_netif, &ring, PCAPNG_PORT) == ERR_OK);
+  fail_unless(test_netif.capture == &ring);
+
+  for (k = 0; k < 40; k += 8) {
+    /* the first batch is in the ring before the client connects */
+    for (i = k; i < k + 8; i++) {
+      len[i] = (u16_t)(60 + rand() % 1454);
+      test_pcapng_frame(f, len[i], i);
+      p = test_pcapng_pbuf(f, len[i]);
+      bpf_ring_add(&ring, p, BPF_RING_IN);
+      pbuf_free(p);
+    }
+    if (k == 0) {
+      c = test_pcapng_connect();
+      test_pcapng_run(0);
+      fail_unless(pcapng_client != NULL);
+      /* a second client is turned away */
+      c2 = test_pcapng_connect();
+      test_pcapng_run(0);
+      fail_unless(test_rx_err == 1);
+      LWIP_UNUSED_ARG(c2);
+    }
+    /* new frames go out on the poll timer */
+    test_pcapng_run(20);
+    fail_unless(ring.count == 0);
+  }
+  fail_unless(ring.overwritten == 0);
+
+  fail_unless(test_pcapng_parse(test_rx, test_rx_len, &file));
+  fail_unless((file.linktype == 1) && (file.snaplen == 1514) && (file.tsresol == 3));
+  fail_unless(file.npkts == 40);
+  for (i = 0; i < 40; i++) {
+    test_pcapng_frame(f, len[i], i);
+    fail_unless((file.pkts[i].len == len[i]) && (file.pkts[i].caplen == len[i]));
+    fail_unless(memcmp(file.pkts[i].data, f, len[i]) == 0);
+  }
+
+  /* after the client closes, the next one starts a new section */
+  fail_unless(tcp_close(c) == ERR_OK);
+  test_pcapng_run(4);
+  fail_unless(pcapng_client == NULL);
+  test_rx_len = 0;
+  c = test_pcapng_connect();
+  test_pcapng_run(2);
+  fail_unless(test_rx_len == PCAPNG_SHB_SIZE + PCAPNG_IDB_SIZE);
+  fail_unless(test_pcapng_parse(test_rx, test_rx_len, &file) && (file.npkts == 0));
+  tcp_abort(c);
+}
+END_TEST
+
+/** Cost of recording a frame: copies of different lengths against a reference */
+START_TEST(test_pcapng_speed)
+{
+  static u32_t buf[8192];
+  static const u16_t snaplen[3] = {128, 1514, 0};
+  static u8_t out[PCAPNG_BLOCK_SIZE];
+  struct bpf_ring ring;
+  struct pbuf *p;
+  u8_t f[1514];
+  volatile u32_t sink = 0;
+  clock_t start;
+  double secs, secs_enc;
+  int s, k, reps = 500000;
+  LWIP_UNUSED_ARG(_i);
+
+  test_pcapng_frame(f, sizeof(f), 0);
+  p = test_pcapng_pbuf(f, sizeof(f));
+  for (s = 0; s < 3; s++) {
+    fail_unless(bpf_ring_init(&ring, buf, sizeof(buf), NULL, snaplen[s]) == ERR_OK);
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      bpf_ring_add(&ring, p, BPF_RING_IN);
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (k = 0; k < reps; k++) {
+      if (ring.count == 0) {
+        bpf_ring_add(&ring, p, BPF_RING_IN);
+      }
+      sink += pcapng_next(&ring, out, sizeof(out));
+    }
+    secs_enc = (double)(clock() - start) / CLOCKS_PER_SEC;
+    bpf_ring_flush(&ring);
+    fail_unless(p->ref == 1);
+    printf("Capture of a 1514 byte frame, %s: %.1f ns, pcap-ng block %.1f ns\n",
+      snaplen[s] == 128 ? "first 128 bytes" : (snaplen[s] ? "full copy" : "pbuf reference"),
+      secs * 1e9 / reps, secs_enc * 1e9 / reps);
+  }
+  pbuf_free(p);
+  LWIP_UNUSED_ARG(sink);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+pcapng_suite(void)
+{
+  TFun tests[] = {
+    test_pcapng_ref,
+    test_pcapng_taps,
+    test_pcapng_format,
+    test_pcapng_stream,
+    test_pcapng_speed
+  };
+  return create_suite("PCAPNG", tests, sizeof(tests)/sizeof(TFun), pcapng_setup, pcapng_teardown);
+}
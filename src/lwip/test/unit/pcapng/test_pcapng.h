@@ -0,0 +1,8 @@
+#ifndef __TEST_PCAPNG_H__
+#define __TEST_PCAPNG_H__
+
+#include "../lwip_check.h"
+
+Suite *pcapng_suite(void);
+
+#endif
@@ -0,0 +1,440 @@
+#include "test_digest.h"
+
+#include "ppp_impl.h"
+#include "digest.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !PPP_SUPPORT || !(CHAP_SUPPORT || MD5_SUPPORT)
+#error "This tests needs PPP_SUPPORT and CHAP_SUPPORT or MD5_SUPPORT"
+#endif
+
+/* Register model of the STM32 HASH block (MD5, 8-bit data type) that the
+ * HASH provider from ports/hash is built against on the host. The model
+ * computes the digest with md5.c and checks how the registers are used. */
+
+/* HASH register bits as in stm32f4xx.h */
+#define HASH_CR_INIT        0x00000004UL
+#define HASH_CR_DMAE        0x00000008UL
+#define HASH_CR_DATATYPE    0x00000030UL
+#define HASH_CR_DATATYPE_1  0x00000020UL
+#define HASH_CR_MODE        0x00000040UL
+#define HASH_CR_ALGO        0x00040080UL
+#define HASH_CR_ALGO_0      0x00000080UL
+#define HASH_CR_MDMAT       0x00002000UL
+#define HASH_STR_NBW        0x0000001FUL
+#define HASH_STR_DCAL       0x00000100UL
+#define HASH_SR_DCIS        0x00000002UL
+#define HASH_SR_BUSY        0x00000008UL
+
+struct test_hash_model {
+  u32_t cr, str, sr;
+  u32_t hr[5];
+  MD5_CTX md5;
+  /* the last word written: how much of it counts is known at DCAL */
+  u32_t last;
+  int has_last;
+  /* SR polls until the digest is ready */
+  int busy;
+  /* DMA polls until the transfer is done, fail it instead */
+  int dma_polls, dma_fail;
+  /* words written by the CPU and by DMA, protocol errors */
+  u32_t din_cpu, din_dma;
+  int bad;
+};
+
+static struct test_hash_model model;
+
+static void
+test_hash_feed(u32_t word, int nbytes)
+{
+  u8_t b[4];
+
+  b[0] = (u8_t)word;
+  b[1] = (u8_t)(word >> 8);
+  b[2] = (u8_t)(word >> 16);
+  b[3] = (u8_t)(word >> 24);
+  MD5Update(&model.md5, b, nbytes);
+}
+
+static void
+test_hash_din(u32_t word)
+{
+  if (model.sr & HASH_SR_DCIS) {
+    /* data after DCAL without INIT */
+    model.bad++;
+  }
+  if (model.has_last) {
+    test_hash_feed(model.last, 4);
+  }
+  model.last = word;
+  model.has_last = 1;
+}
+
+static void
+test_hash_wr_CR(u32_t val)
+{
+  if (val & HASH_CR_INIT) {
+    if ((val & (HASH_CR_ALGO | HASH_CR_MODE | HASH_CR_DATATYPE)) != (HASH_CR_ALGO_0 | HASH_CR_DATATYPE_1)) {
+      /* the provider only asks for MD5 on byte data */
+      model.bad++;
+    }
+    MD5Init(&model.md5);
+    model.has_last = 0;
+    model.sr = 0;
+    model.str = 0;
+  }
+  model.cr = val & ~HASH_CR_INIT;
+}
+
+static u32_t
+test_hash_rd_CR(void)
+{
+  return model.cr;
+}
+
+static void
+test_hash_wr_DIN(u32_t val)
+{
+  model.din_cpu++;
+  test_hash_din(val);
+}
+
+static void
+test_hash_wr_STR(u32_t val)
+{
+  u8_t digest[16];
+  int i;
+
+  model.str = val & HASH_STR_NBW;
+  if (val & HASH_STR_DCAL) {
+    if ((model.str & 7) != 0) {
+      model.bad++;
+    }
+    if (model.has_last) {
+      test_hash_feed(model.last, model.str ? (int)(model.str / 8) : 4);
+      model.has_last = 0;
+    }
+    MD5Final(digest, &model.md5);
+    for (i = 0; i < 4; i++) {
+      model.hr[i] = ((u32_t)digest[4 * i] << 24) | ((u32_t)digest[4 * i + 1] << 16) |
+                    ((u32_t)digest[4 * i + 2] << 8) | digest[4 * i + 3];
+    }
+    if (model.busy == 0) {
+      model.busy = 3;
+    }
+  }
+}
+
+static u32_t
+test_hash_rd_SR(void)
+{
+  if (model.busy > 0) {
+    if (--model.busy == 0) {
+      model.sr |= HASH_SR_DCIS;
+    }
+    return model.sr | HASH_SR_BUSY;
+  }
+  return model.sr;
+}
+
+static u32_t
+test_hash_rd_HR(int i)
+{
+  if (!(model.sr & HASH_SR_DCIS)) {
+    model.bad++;
+  }
+  return model.hr[i];
+}
+
+static void
+test_hash_dma_start(const u8_t *src, u32_t words)
+{
+  u32_t i;
+
+  if (!(model.cr & HASH_CR_DMAE) || ((mem_ptr_t)src & 3)) {
+    model.bad++;
+  }
+  for (i = 0; i < words; i++, src += 4) {
+    test_hash_din((u32_t)src[0] | ((u32_t)src[1] << 8) | ((u32_t)src[2] << 16) | ((u32_t)src[3] << 24));
+  }
+  model.din_dma += words;
+  model.dma_polls = 2;
+  if (!(model.cr & HASH_CR_MDMAT)) {
+    /* without MDMAT the end of the transfer starts the calculation */
+    test_hash_wr_STR(model.str | HASH_STR_DCAL);
+  }
+}
+
+static int
+test_hash_dma_poll(void)
+{
+  if (model.dma_fail) {
+    return -1;
+  }
+  return (model.dma_polls-- > 0) ? 0 : 1;
+}
+
+#define HASH_REG_MODEL              1
+#define HASH_DIGEST_DMA             1
+#define HASH_REG_WR(reg, val)       test_hash_wr_##reg(val)
+#define HASH_REG_RD(reg)            test_hash_rd_##reg()
+#define HASH_HR_RD(i)               test_hash_rd_HR(i)
+#define HASH_DMA_START(src, words)  test_hash_dma_start((src), (words))
+#define HASH_DMA_POLL()             test_hash_dma_poll()
+
+#include "../../../ports/hash/hash_digest.c"
+
+/* RFC 1321, A.5 */
+static const char *const test_digest_msgs[] = {
+  "",
+  "a",
+  "abc",
+  "message digest",
+  "abcdefghijklmnopqrstuvwxyz",
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+  "12345678901234567890123456789012345678901234567890123456789012345678901234567890"
+};
+static const char *const test_digest_md5s[] = {
+  "d41d8cd98f00b204e9800998ecf8427e",
+  "0cc175b9c0f1b6a831c399e269772661",
+  "900150983cd24fb0d6963f7d28e17f72",
+  "f96b697d7cb7938d525a2f31aaf161d0",
+  "c3fcd3d76192e4007dfb496cca67e13b",
+  "d174ab98d277d9f5a5611c2c9f419d9f",
+  "57edf4a22be3c955ac49da2e2107b67a"
+};
+
+static u8_t data[16384 + 8];
+
+/* Helper functions */
+
+static void
+test_digest_hex(char *hex, const u8_t *md)
+{
+  int i;
+
+  for (i = 0; i < DIGEST_MD5_SIZE; i++) {
+    sprintf(hex + 2 * i, "%02x", md[i]);
+  }
+}
+
+/** Digest 'len' bytes in chunks of random size (1..maxchunk) */
+static err_t
+test_digest_chunks(const u8_t *p, u32_t len, u32_t maxchunk, u8_t *md, const struct digest_provider **prov)
+{
+  struct digest_ctx ctx;
+  u32_t n;
+  err_t err;
+
+  err = digest_init(&ctx, DIGEST_MD5);
+  EXPECT_RETX(err == ERR_OK, err);
+  *prov = ctx.prov;
+  while (len > 0) {
+    n = 1 + (u32_t)rand() % maxchunk;
+    if (n > len) {
+      n = len;
+    }
+    digest_update(&ctx, p, n);
+    p += n;
+    len -= n;
+  }
+  return digest_final(&ctx, md);
+}
+
+
+/* Setups/teardown functions */
+
+static void
+digest_setup(void)
+{
+  srand(1321);
+  memset(&model, 0, sizeof(model));
+  HASH_Digest_Init();
+}
+
+static void
+digest_teardown(void)
+{
+  EXPECT(HASH_Owner == NULL);
+  EXPECT(model.bad == 0);
+  digest_set_provider(NULL);
+}
+
+
+/* Test functions */
+
+/** The RFC 1321 test suite through both providers, in one piece and
+ * byte by byte */
+START_TEST(test_digest_vectors)
+{
+  const struct digest_provider *prov;
+  u8_t md[DIGEST_MD5_SIZE];
+  char hex[2 * DIGEST_MD5_SIZE + 1];
+  u32_t len;
+  int pass, i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (pass = 0; pass < 2; pass++) {
+    digest_set_provider(pass ? &hash_digest_provider : NULL);
+    for (i = 0; i < (int)(sizeof(test_digest_msgs) / sizeof(test_digest_msgs[0])); i++) {
+      len = (u32_t)strlen(test_digest_msgs[i]);
+      memcpy(data, test_digest_msgs[i], len);
+
+      EXPECT(test_digest_chunks(data, len, len + 1, md, &prov) == ERR_OK);
+      EXPECT(prov == (pass ? &hash_digest_provider : &digest_sw));
+      test_digest_hex(hex, md);
+      EXPECT(strcmp(hex, test_digest_md5s[i]) == 0);
+
+      EXPECT(test_digest_chunks(data, len, 1, md, &prov) == ERR_OK);
+      test_digest_hex(hex, md);
+      EXPECT(strcmp(hex, test_digest_md5s[i]) == 0);
+    }
+  }
+}
+END_TEST
+
+/** Random lengths, chunking and alignment: the peripheral gets the same
+ * byte stream as md5.c, large aligned chunks go by DMA */
+START_TEST(test_digest_stream)
+{
+  const struct digest_provider *prov;
+  u8_t md_sw[DIGEST_MD5_SIZE], md_hw[DIGEST_MD5_SIZE];
+  u32_t len, off, i;
+  int r;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (u8_t)rand();
+  }
+  for (r = 0; r < 300; r++) {
+    len = (u32_t)rand() % 6000;
+    off = (u32_t)rand() & 7;
+
+    digest_set_provider(NULL);
+    EXPECT(test_digest_chunks(data + off, len, 1 + (u32_t)rand() % 2000, md_sw, &prov) == ERR_OK);
+    digest_set_provider(&hash_digest_provider);
+    EXPECT(test_digest_chunks(data + off, len, 1 + (u32_t)rand() % 2000, md_hw, &prov) == ERR_OK);
+    EXPECT(prov == &hash_digest_provider);
+    EXPECT(memcmp(md_sw, md_hw, DIGEST_MD5_SIZE) == 0);
+  }
+  EXPECT(model.din_cpu > 0);
+  EXPECT(model.din_dma > 0);
+}
+END_TEST
+
+/** A second context while the peripheral is taken goes to md5.c */
+START_TEST(test_digest_busy)
+{
+  struct digest_ctx a, b, c;
+  u8_t md_a[DIGEST_MD5_SIZE], md_b[DIGEST_MD5_SIZE];
+  char hex[2 * DIGEST_MD5_SIZE + 1];
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(digest_init(&a, DIGEST_MD5) == ERR_OK);
+  EXPECT(a.prov == &hash_digest_provider);
+  EXPECT(digest_init(&b, DIGEST_MD5) == ERR_OK);
+  EXPECT(b.prov == &digest_sw);
+  digest_update(&a, (const u8_t *)"message ", 8);
+  digest_update(&b, (const u8_t *)"ab", 2);
+  digest_update(&a, (const u8_t *)"digest", 6);
+  digest_update(&b, (const u8_t *)"c", 1);
+  EXPECT(digest_final(&b, md_b) == ERR_OK);
+  EXPECT(digest_final(&a, md_a) == ERR_OK);
+  test_digest_hex(hex, md_a);
+  EXPECT(strcmp(hex, test_digest_md5s[3]) == 0);
+  test_digest_hex(hex, md_b);
+  EXPECT(strcmp(hex, test_digest_md5s[2]) == 0);
+
+  /* released by digest_final() */
+  EXPECT(digest_init(&c, DIGEST_MD5) == ERR_OK);
+  EXPECT(c.prov == &hash_digest_provider);
+  EXPECT(digest_final(&c, md_a) == ERR_OK);
+
+  /* unknown algorithms fail on both */
+  EXPECT(digest_init(&c, 99) == ERR_VAL);
+  EXPECT(HASH_Owner == NULL);
+}
+END_TEST
+
+/** A DMA error or a digest that never completes is reported by
+ * digest_final() and frees the peripheral */
+START_TEST(test_digest_errors)
+{
+  struct digest_ctx ctx;
+  u8_t md[DIGEST_MD5_SIZE];
+  LWIP_UNUSED_ARG(_i);
+
+  model.dma_fail = 1;
+  EXPECT(digest_init(&ctx, DIGEST_MD5) == ERR_OK);
+  digest_update(&ctx, data, 1024);
+  EXPECT(digest_final(&ctx, md) == ERR_IF);
+  EXPECT(HASH_Owner == NULL);
+  model.dma_fail = 0;
+
+  EXPECT(digest_init(&ctx, DIGEST_MD5) == ERR_OK);
+  digest_update(&ctx, data, 100);
+  model.busy = HASH_DIGEST_TIMEOUT + 10;
+  EXPECT(digest_final(&ctx, md) == ERR_TIMEOUT);
+  EXPECT(HASH_Owner == NULL);
+  model.busy = 0;
+}
+END_TEST
+
+/** Software MD5 throughput, and what the peripheral provider costs the
+ * CPU: register writes per digest with and without DMA */
+START_TEST(test_digest_speed)
+{
+  static const u32_t sizes[] = {16, 64, 1500, 16384};
+  u8_t md[DIGEST_MD5_SIZE];
+  struct digest_ctx ctx;
+  clock_t start;
+  double secs;
+  u32_t cpu, dma;
+  int s, r, reps;
+  LWIP_UNUSED_ARG(_i);
+
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    digest_set_provider(NULL);
+    reps = (int)(16000000 / (sizes[s] + 64));
+    start = clock();
+    for (r = 0; r < reps; r++) {
+      digest_init(&ctx, DIGEST_MD5);
+      digest_update(&ctx, data, sizes[s]);
+      digest_final(&ctx, md);
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    digest_set_provider(&hash_digest_provider);
+    cpu = model.din_cpu;
+    dma = model.din_dma;
+    EXPECT(digest_init(&ctx, DIGEST_MD5) == ERR_OK);
+    EXPECT(ctx.prov == &hash_digest_provider);
+    digest_update(&ctx, data, sizes[s]);
+    EXPECT(digest_final(&ctx, md) == ERR_OK);
+    printf("MD5 %5d bytes: md5.c %.1f MB/s, %.0f digests/s; HASH: %d words by CPU, %d by DMA\n",
+      (int)sizes[s],
+      secs > 0 ? (double)sizes[s] * reps / secs / 1e6 : 0.0,
+      secs > 0 ? reps / secs : 0.0,
+      (int)(model.din_cpu - cpu), (int)(model.din_dma - dma));
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+digest_suite(void)
+{
+  TFun tests[] = {
+    test_digest_vectors,
+    test_digest_stream,
+    test_digest_busy,
+    test_digest_errors,
+    test_digest_speed
+  };
+  return create_suite("DIGEST", tests, sizeof(tests)/sizeof(TFun), digest_setup, digest_teardown);
+}
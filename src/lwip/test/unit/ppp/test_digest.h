@@ -0,0 +1,8 @@
+#ifndef __TEST_DIGEST_H__
+#define __TEST_DIGEST_H__
+
+#include "../lwip_check.h"
+
+Suite *digest_suite(void);
+
+#endif
@@ -0,0 +1,511 @@
+#include "test_pppos.h"
+
+#include "../lwip_sio.h"
+#include "lwip/stats.h"
+#include "ppp.h"
+#include "ppp_impl.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !PPP_SUPPORT || !PPPOS_SUPPORT || !LINK_STATS || !PPPOS_TX_RING_SIZE
+#error "This tests needs PPPOS_SUPPORT, PPPOS_TX_RING_SIZE and LINK_STATS"
+#endif
+
+#define TEST_PPP_FLAG     0x7e
+#define TEST_PPP_ESCAPE   0x7d
+#define TEST_PPP_TRANS    0x20
+#define TEST_PPP_IP       0x0021
+#define TEST_PPP_LCP      0xc021
+#define TEST_PPP_MAX      (2 * (4 + 1500 + 2) + 2)
+
+static int pd = -1;
+static int link_status_ctr, link_status_err;
+
+/* everything PPP sent to the serial port */
+static u8_t sio_buf[4096];
+static int sio_len;
+/* only count what PPP sends (for the speed test) */
+static int sio_count_only;
+static u32_t sio_total;
+
+/* encoded receive stream */
+static u8_t stream[256 * 1024];
+
+/* Helper functions */
+
+/* the serial port PPPoS writes to */
+static u32_t
+test_pppos_sio_write(struct test_sio *sio, const u8_t *data, u32_t len)
+{
+  LWIP_UNUSED_ARG(sio);
+  if (!sio_count_only && (sio_len + len <= sizeof(sio_buf))) {
+    memcpy(sio_buf + sio_len, data, len);
+    sio_len += len;
+  }
+  sio_total += len;
+  return len;
+}
+
+static struct test_sio test_pppos_sio = { test_pppos_sio_write, NULL, 0 };
+
+static void
+test_pppos_link_status(void *ctx, int errCode, void *arg)
+{
+  LWIP_UNUSED_ARG(ctx);
+  LWIP_UNUSED_ARG(arg);
+  link_status_ctr++;
+  link_status_err = errCode;
+}
+
+/** FCS-16 octet by octet, bitwise: the reference for the table driven one */
+static u16_t
+test_pppos_fcs(u16_t fcs, const u8_t *p, int len)
+{
+  int i;
+
+  while (len-- > 0) {
+    fcs ^= *p++;
+    for (i = 0; i < 8; i++) {
+      fcs = (fcs & 1) ? (u16_t)((fcs >> 1) ^ 0x8408) : (u16_t)(fcs >> 1);
+    }
+  }
+  return fcs;
+}
+
+static int
+test_pppos_put(u8_t *out, u8_t c, u32_t asyncmap)
+{
+  if ((c == TEST_PPP_FLAG) || (c == TEST_PPP_ESCAPE) ||
+      ((c < 0x20) && (asyncmap & (1UL << c)))) {
+    out[0] = TEST_PPP_ESCAPE;
+    out[1] = c ^ TEST_PPP_TRANS;
+    return 2;
+  }
+  out[0] = c;
+  return 1;
+}
+
+/** HDLC-encode one frame to 'out', escaping the characters in 'asyncmap'.
+ * @return encoded length */
+static int
+test_pppos_frame(u8_t *out, u16_t proto, const u8_t *data, int len, u32_t asyncmap, int bad_fcs)
+{
+  u8_t hdr[4];
+  u16_t fcs;
+  int i, n = 0;
+
+  hdr[0] = 0xff;
+  hdr[1] = 0x03;
+  hdr[2] = (u8_t)(proto >> 8);
+  hdr[3] = (u8_t)proto;
+  fcs = test_pppos_fcs(0xffff, hdr, 4);
+  fcs = test_pppos_fcs(fcs, data, len);
+  fcs ^= 0xffff;
+  if (bad_fcs) {
+    fcs ^= 0x0100;
+  }
+
+  out[n++] = TEST_PPP_FLAG;
+  for (i = 0; i < 4; i++) {
+    n += test_pppos_put(out + n, hdr[i], asyncmap);
+  }
+  for (i = 0; i < len; i++) {
+    n += test_pppos_put(out + n, data[i], asyncmap);
+  }
+  n += test_pppos_put(out + n, (u8_t)fcs, asyncmap);
+  n += test_pppos_put(out + n, (u8_t)(fcs >> 8), asyncmap);
+  out[n++] = TEST_PPP_FLAG;
+  return n;
+}
+
+/** Payload that looks like IP traffic: mostly printable, some binary */
+static void
+test_pppos_payload(u8_t *data, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++) {
+    data[i] = (u8_t)((rand() & 3) ? (0x20 + rand() % 0x5f) : rand());
+  }
+}
+
+/** Feed a stream to pppos_input() in chunks of random size (1..max) */
+static void
+test_pppos_feed(u8_t *s, int len, int max)
+{
+  int chunk;
+
+  while (len > 0) {
+    chunk = 1 + rand() % max;
+    if (chunk > len) {
+      chunk = len;
+    }
+    pppos_input(pd, s, chunk);
+    s += chunk;
+    len -= chunk;
+  }
+}
+
+/** Decode the first frame PPP sent (bitwise reference decoder).
+ * @return payload length after the protocol field, -1 if none or bad FCS */
+static int
+test_pppos_sent_frame(u16_t *proto, u8_t *data, int max)
+{
+  static u8_t frame[TEST_PPP_MAX];
+  int i, n = 0, esc = 0;
+
+  for (i = 0; (i < sio_len) && (sio_buf[i] == TEST_PPP_FLAG); i++);
+  for (; (i < sio_len) && (sio_buf[i] != TEST_PPP_FLAG); i++) {
+    if (sio_buf[i] == TEST_PPP_ESCAPE) {
+      esc = 1;
+    } else if (n < (int)sizeof(frame)) {
+      frame[n++] = esc ? (sio_buf[i] ^ TEST_PPP_TRANS) : sio_buf[i];
+      esc = 0;
+    }
+  }
+  if ((n < 6) || (test_pppos_fcs(0xffff, frame, n) != 0xf0b8) || (n - 6 > max)) {
+    return -1;
+  }
+  *proto = (u16_t)((frame[2] << 8) | frame[3]);
+  memcpy(data, frame + 4, n - 6);
+  return n - 6;
+}
+
+/** Bring the PPP netif up as IPCP would, for sending IP packets */
+static struct netif *
+test_pppos_netif_up(void)
+{
+  struct netif *netif;
+
+  fail_unless(sifup(pd));
+  /* netif_add() puts it first in the list */
+  netif = netif_list;
+  fail_unless((netif != NULL) && (netif->name[0] == 'p'));
+  link_status_ctr = 0;
+  return netif;
+}
+
+static void
+test_pppos_netif_down(void)
+{
+  fail_unless(sifdown(pd));
+  link_status_ctr = 0;
+}
+
+/** Split data over a chain of PBUF_REFs of random sizes */
+static struct pbuf *
+test_pppos_chain(u8_t *data, int len)
+{
+  struct pbuf *p = NULL, *q;
+  int chunk;
+
+  while (len > 0) {
+    chunk = 1 + rand() % 300;
+    if (chunk > len) {
+      chunk = len;
+    }
+    q = pbuf_alloc(PBUF_RAW, (u16_t)chunk, PBUF_REF);
+    fail_unless(q != NULL);
+    q->payload = data;
+    if (p == NULL) {
+      p = q;
+    } else {
+      pbuf_cat(p, q);
+    }
+    data += chunk;
+    len -= chunk;
+  }
+  return p;
+}
+
+/* Setups/teardown functions */
+
+static void
+pppos_setup(void)
+{
+  pppInit();
+  link_status_ctr = 0;
+  sio_len = 0;
+  pd = pppOpen((sio_fd_t)&test_pppos_sio, test_pppos_link_status, NULL);
+  fail_unless(pd >= 0);
+  /* LCP sent its Configure-Request */
+  fail_unless(sio_len > 0);
+  sio_len = 0;
+  srand(1234);
+}
+
+static void
+pppos_teardown(void)
+{
+  static const u8_t termack[] = {6, 0, 0, 4};
+  u8_t frame[32];
+  int len;
+
+  /* close and let the peer acknowledge the Terminate-Request */
+  pppClose(pd);
+  len = test_pppos_frame(frame, TEST_PPP_LCP, termack, sizeof(termack), 0xffffffffUL, 0);
+  pppos_input(pd, frame, len);
+  fail_unless(link_status_ctr == 1);
+  fail_unless(link_status_err == PPPERR_USER);
+  pd = -1;
+}
+
+
+/* Test functions */
+
+/** Frames of all sizes, split at random points, with the default ACCM (flag
+ * and escape only) and with all control characters escaped */
+START_TEST(test_pppos_rx_frames)
+{
+  static u8_t data[1500];
+  u32_t asyncmap;
+  STAT_COUNTER recv, chkerr, lenerr;
+  int pass, k, len, n, frames;
+  LWIP_UNUSED_ARG(_i);
+
+  for (pass = 0; pass < 2; pass++) {
+    asyncmap = pass ? 0xffffffffUL : 0;
+    ppp_recv_config(pd, 1500, asyncmap, 0, 0);
+    recv = lwip_stats.link.recv;
+    chkerr = lwip_stats.link.chkerr;
+    lenerr = lwip_stats.link.lenerr;
+
+    n = 0;
+    frames = 0;
+    for (k = 0; (k < 1500) && (n + TEST_PPP_MAX <= (int)sizeof(stream)); k += 1 + k / 8) {
+      len = k;
+      test_pppos_payload(data, len);
+      if ((k % 5) == 0) {
+        /* a run of octets that all need escaping */
+        memset(data, (k & 1) ? TEST_PPP_FLAG : TEST_PPP_ESCAPE, len / 2);
+      }
+      n += test_pppos_frame(stream + n, TEST_PPP_IP, data, len, 0xffffffffUL, 0);
+      frames++;
+    }
+    test_pppos_feed(stream, n, 97);
+    EXPECT(lwip_stats.link.recv == (STAT_COUNTER)(recv + frames));
+    EXPECT(lwip_stats.link.chkerr == chkerr);
+    EXPECT(lwip_stats.link.lenerr == lenerr);
+
+    /* corrupted frames are all caught by the FCS */
+    recv = lwip_stats.link.recv;
+    n = 0;
+    for (k = 0; k < 20; k++) {
+      len = 1 + rand() % 1500;
+      test_pppos_payload(data, len);
+      n += test_pppos_frame(stream + n, TEST_PPP_IP, data, len, 0xffffffffUL, 1);
+    }
+    test_pppos_feed(stream, n, 300);
+    EXPECT(lwip_stats.link.recv == recv);
+    EXPECT(lwip_stats.link.chkerr == (STAT_COUNTER)(chkerr + 20));
+
+    /* line noise: unescaped control characters are dropped if in the ACCM */
+    if (asyncmap) {
+      test_pppos_payload(data, 1000);
+      n = test_pppos_frame(stream, TEST_PPP_IP, data, 1000, 0xffffffffUL, 0);
+      memmove(stream + 501, stream + 500, n - 500);
+      stream[500] = 0x11; /* XON */
+      test_pppos_feed(stream, n + 1, 64);
+      EXPECT(lwip_stats.link.recv == (STAT_COUNTER)(recv + 1));
+    }
+  }
+}
+END_TEST
+
+/** The decoded packet content: LCP rejects unknown options by sending them
+ * back, so the Configure-Reject must carry exactly the octets we sent */
+START_TEST(test_pppos_rx_content)
+{
+  static u8_t req[1400];
+  static u8_t rej[1500];
+  u16_t proto;
+  int n, len, opt;
+  LWIP_UNUSED_ARG(_i);
+
+  /* Configure-Request with unknown options of up to 255 octets of random
+   * data: spans several pbufs of the chain */
+  req[0] = 1;
+  req[1] = 42;
+  len = 4;
+  while (len + 255 <= (int)sizeof(req)) {
+    opt = 2 + rand() % 254;
+    req[len] = 0xfe;
+    req[len + 1] = (u8_t)opt;
+    test_pppos_payload(req + len + 2, opt - 2);
+    len += opt;
+  }
+  req[2] = (u8_t)(len >> 8);
+  req[3] = (u8_t)len;
+
+  n = test_pppos_frame(stream, TEST_PPP_LCP, req, len, 0, 0);
+  test_pppos_feed(stream, n, 200);
+
+  EXPECT_RET(test_pppos_sent_frame(&proto, rej, sizeof(rej)) == len);
+  EXPECT(proto == TEST_PPP_LCP);
+  EXPECT(rej[0] == 4); /* Configure-Reject */
+  EXPECT(rej[1] == 42);
+  EXPECT(memcmp(rej + 4, req + 4, len - 4) == 0);
+}
+END_TEST
+
+/** Frames sent from pbuf chains must be encoded exactly like the reference
+ * encoder does it, including frames wrapping around the end of the ring */
+START_TEST(test_pppos_tx_frames)
+{
+  static u8_t data[1500];
+  static u8_t frame[TEST_PPP_MAX];
+  struct netif *netif;
+  struct pbuf *p;
+  u32_t asyncmap;
+  STAT_COUNTER xmit;
+  int pass, k, len, n, frames;
+  LWIP_UNUSED_ARG(_i);
+
+  netif = test_pppos_netif_up();
+  for (pass = 0; pass < 2; pass++) {
+    asyncmap = pass ? 0xffffffffUL : 0;
+    ppp_send_config(pd, 1500, asyncmap, 0, 0);
+    xmit = lwip_stats.link.xmit;
+    test_pppos_sio.max_segs = 0;
+    frames = 0;
+
+    for (k = 0; k <= 1500; k += 1 + k / 8) {
+      len = k;
+      test_pppos_payload(data, len);
+      if ((k % 5) == 0) {
+        /* a run of octets that all need escaping */
+        memset(data, (k & 1) ? TEST_PPP_FLAG : TEST_PPP_ESCAPE, len / 2);
+      }
+      p = test_pppos_chain(data, len);
+      sio_len = 0;
+      if (p != NULL) {
+        EXPECT(netif->output(netif, p, NULL) == ERR_OK);
+        pbuf_free(p);
+        frames++;
+      }
+      if (len > 0) {
+        /* skip the flag sent after idle time */
+        n = test_pppos_frame(frame, TEST_PPP_IP, data, len, asyncmap, 0);
+        EXPECT(sio_len >= n - 1);
+        EXPECT(memcmp(sio_buf + sio_len - (n - 1), frame + 1, n - 1) == 0);
+      }
+    }
+    EXPECT(lwip_stats.link.xmit == (STAT_COUNTER)(xmit + frames));
+    /* some frames were split where the ring wraps */
+    EXPECT(test_pppos_sio.max_segs == 2);
+  }
+  test_pppos_netif_down();
+}
+END_TEST
+
+/** Transmit throughput for small and full sized packets */
+START_TEST(test_pppos_tx_speed)
+{
+  static const int sizes[] = {64, 1500};
+  static u8_t data[1500];
+  struct netif *netif;
+  struct pbuf *p;
+  STAT_COUNTER xmit;
+  clock_t start;
+  double secs;
+  int pass, s, r, reps;
+  LWIP_UNUSED_ARG(_i);
+
+  netif = test_pppos_netif_up();
+  sio_count_only = 1;
+  for (pass = 0; pass < 2; pass++) {
+    u32_t asyncmap = pass ? 0xffffffffUL : 0;
+    ppp_send_config(pd, 1500, asyncmap, 0, 0);
+
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+      p = pbuf_alloc(PBUF_RAW, (u16_t)sizes[s], PBUF_RAM);
+      fail_unless(p != NULL);
+      test_pppos_payload(data, sizes[s]);
+      pbuf_take(p, data, (u16_t)sizes[s]);
+
+      reps = 2000000 / sizes[s];
+      xmit = lwip_stats.link.xmit;
+      sio_total = 0;
+      start = clock();
+      for (r = 0; r < reps; r++) {
+        netif->output(netif, p, NULL);
+      }
+      secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+      pbuf_free(p);
+      EXPECT(lwip_stats.link.xmit == (STAT_COUNTER)(xmit + reps));
+
+      printf("PPPoS tx (asyncmap %08lx) %4d byte packets: %.0f frames/s, %.1f MB/s of packets, %.1f MB/s of line data\n",
+        (unsigned long)asyncmap, sizes[s],
+        secs > 0 ? reps / secs : 0.0,
+        secs > 0 ? (double)sizes[s] * reps / secs / 1e6 : 0.0,
+        secs > 0 ? (double)sio_total / secs / 1e6 : 0.0);
+    }
+  }
+  sio_count_only = 0;
+  test_pppos_netif_down();
+}
+END_TEST
+
+/** Receive throughput in a stream modelled on a captured cellular session:
+ * TCP ACKs, small requests and full sized data frames */
+START_TEST(test_pppos_rx_speed)
+{
+  static const int sizes[] = {40, 40, 52, 576, 1500, 1500, 1500, 1500};
+  static u8_t data[1500];
+  STAT_COUNTER recv;
+  clock_t start;
+  double secs;
+  int pass, n, frames, bytes, reps, r, chunk;
+  LWIP_UNUSED_ARG(_i);
+
+  for (pass = 0; pass < 2; pass++) {
+    u32_t asyncmap = pass ? 0xffffffffUL : 0;
+    ppp_recv_config(pd, 1500, asyncmap, 0, 0);
+
+    n = 0;
+    frames = 0;
+    bytes = 0;
+    while (n + TEST_PPP_MAX <= (int)sizeof(stream)) {
+      int len = sizes[frames % (sizeof(sizes) / sizeof(sizes[0]))];
+      test_pppos_payload(data, len);
+      n += test_pppos_frame(stream + n, TEST_PPP_IP, data, len, asyncmap, 0);
+      bytes += len;
+      frames++;
+    }
+
+    reps = 20;
+    recv = lwip_stats.link.recv;
+    start = clock();
+    for (r = 0; r < reps; r++) {
+      /* as handed over by the UART DMA, 256 octets at a time */
+      for (chunk = 0; chunk < n; chunk += 256) {
+        pppos_input(pd, stream + chunk, LWIP_MIN(256, n - chunk));
+      }
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    EXPECT(lwip_stats.link.recv == (STAT_COUNTER)(recv + reps * frames));
+
+    printf("PPPoS rx (asyncmap %08lx): %d frames, %.1f%% escaped, %.1f MB/s of line data\n",
+      (unsigned long)asyncmap, frames, 100.0 * (n - bytes) / n,
+      secs > 0 ? (double)n * reps / secs / 1e6 : 0.0);
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+pppos_suite(void)
+{
+  TFun tests[] = {
+    test_pppos_rx_frames,
+    test_pppos_rx_content,
+    test_pppos_rx_speed,
+    test_pppos_tx_frames,
+    test_pppos_tx_speed
+  };
+  return create_suite("PPPOS", tests, sizeof(tests)/sizeof(TFun), pppos_setup, pppos_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef __TEST_PPPOS_H__
+#define __TEST_PPPOS_H__
+
+#include "../lwip_check.h"
+
+Suite *pppos_suite(void);
+
+#endif
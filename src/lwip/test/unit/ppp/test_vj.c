@@ -0,0 +1,283 @@
+#include "test_vj.h"
+
+#include "lwip/inet_chksum.h"
+#include "ppp_impl.h"
+#include "vj.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if !PPP_SUPPORT || !VJ_SUPPORT || !LINK_STATS || (VJ_MAX_SLOTS < 32)
+#error "This tests needs VJ_SUPPORT, LINK_STATS and at least 32 VJ_MAX_SLOTS"
+#endif
+
+#define TEST_VJ_HLEN      40
+#define TEST_VJ_MAX_FLOWS 128
+
+/** One TCP connection of a replayed trace */
+struct test_vj_flow {
+  u32_t src, dest;
+  u16_t sport, dport;
+  u32_t seq, ack;
+  u16_t wnd;
+  /* sends data (1) or only acknowledges (0) */
+  u8_t sender;
+};
+
+static struct test_vj_flow flows[TEST_VJ_MAX_FLOWS];
+static u16_t ip_id;
+
+static struct vjcompress tx, rx;
+
+/* Helper functions */
+
+static void
+test_vj_flows_init(int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    flows[i].src = PP_HTONL(0x0a000001UL);
+    flows[i].dest = htonl(0xc0a80000UL + 10 + (i % 7));
+    flows[i].sport = (u16_t)(49152 + i);
+    flows[i].dport = (u16_t)((i & 1) ? 80 : 443);
+    flows[i].seq = 1000000UL * (u32_t)i;
+    flows[i].ack = 77777UL * (u32_t)i;
+    flows[i].wnd = 8192;
+    flows[i].sender = (u8_t)((i % 3) != 0);
+  }
+}
+
+/** Write the IP/TCP header of the next packet of 'f' to 'hdr'
+ * @return TCP payload length of the packet */
+static u16_t
+test_vj_next(struct test_vj_flow *f, u8_t *hdr)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)hdr;
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)(hdr + IP_HLEN);
+  u16_t len = 0;
+
+  memset(hdr, 0, TEST_VJ_HLEN);
+  if (f->sender) {
+    len = (rand() & 7) ? 536 : (u16_t)(1 + rand() % 536);
+  }
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, htons((u16_t)(TEST_VJ_HLEN + len)));
+  IPH_ID_SET(iphdr, htons(ip_id));
+  ip_id++;
+  IPH_OFFSET_SET(iphdr, PP_HTONS(IP_DF));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_TCP);
+  iphdr->src.addr = f->src;
+  iphdr->dest.addr = f->dest;
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  tcphdr->src = htons(f->sport);
+  tcphdr->dest = htons(f->dport);
+  tcphdr->seqno = htonl(f->seq);
+  tcphdr->ackno = htonl(f->ack);
+  TCPH_HDRLEN_FLAGS_SET(tcphdr, 5, TCP_ACK | (len ? TCP_PSH : 0));
+  tcphdr->wnd = htons(f->wnd);
+  tcphdr->chksum = (u16_t)rand();
+
+  if (len) {
+    f->seq += len;
+  } else {
+    f->ack += 2 * 536;
+    if ((rand() & 15) == 0) {
+      f->wnd = (u16_t)(f->wnd ^ 0x0200);
+    }
+  }
+  return len;
+}
+
+/** Compress a packet, "send" it and uncompress it on the receive side:
+ * the header that comes out must be the one that went in */
+static u_int
+test_vj_roundtrip(struct test_vj_flow *f)
+{
+  u8_t hdr[TEST_VJ_HLEN];
+  struct pbuf *p;
+  u16_t len;
+  u_int type;
+
+  len = test_vj_next(f, hdr);
+  p = pbuf_alloc(PBUF_IP, (u16_t)(TEST_VJ_HLEN + len), PBUF_RAM);
+  fail_unless(p != NULL);
+  memset(p->payload, 0xa5, p->len);
+  memcpy(p->payload, hdr, TEST_VJ_HLEN);
+
+  type = vj_compress_tcp(&tx, p);
+  switch (type) {
+    case TYPE_UNCOMPRESSED_TCP:
+      EXPECT(IPH_PROTO((struct ip_hdr *)p->payload) <= tx.maxSlotIndex);
+      EXPECT(vj_uncompress_uncomp(p, &rx) == 0);
+      break;
+    case TYPE_COMPRESSED_TCP:
+      EXPECT(p->len < TEST_VJ_HLEN + len);
+      EXPECT(vj_uncompress_tcp(&p, &rx) >= 0);
+      break;
+    default:
+      fail_unless(0);
+      break;
+  }
+  EXPECT(p->tot_len == TEST_VJ_HLEN + len);
+  fail_unless(p->len >= TEST_VJ_HLEN);
+  EXPECT(memcmp(p->payload, hdr, TEST_VJ_HLEN) == 0);
+  if (len) {
+    EXPECT(pbuf_get_at(p, TEST_VJ_HLEN) == 0xa5);
+  }
+  pbuf_free(p);
+  return type;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+vj_setup(void)
+{
+  srand(0x1332);
+  ip_id = 1;
+  memset(&tx, 0, sizeof(tx));
+  memset(&rx, 0, sizeof(rx));
+  vj_compress_init(&tx);
+  vj_compress_init(&rx);
+}
+
+static void
+vj_teardown(void)
+{
+}
+
+
+/* Test functions */
+
+/** As many connections as slots, interleaved at random: after each has
+ * been announced once, every packet goes out compressed */
+START_TEST(test_vj_flows)
+{
+  int i, n = VJ_MAX_SLOTS;
+  u_int type;
+  LWIP_UNUSED_ARG(_i);
+
+  vj_compress_config(&tx, 1, VJ_MAX_SLOTS - 1);
+  test_vj_flows_init(n);
+  for (i = 0; i < n; i++) {
+    type = test_vj_roundtrip(&flows[i]);
+    EXPECT(type == TYPE_UNCOMPRESSED_TCP);
+  }
+  for (i = 0; i < 20000; i++) {
+    type = test_vj_roundtrip(&flows[rand() % n]);
+    EXPECT(type == TYPE_COMPRESSED_TCP);
+  }
+  EXPECT(tx.stats.vjs_misses == (unsigned long)n);
+  EXPECT(tx.stats.vjs_compressed == 20000UL);
+  EXPECT(rx.stats.vjs_errorin == 0);
+  EXPECT(tx.stats.vjs_hdrout < tx.stats.vjs_hdrin / 4);
+}
+END_TEST
+
+/** The peer's decompressor only has 4 slots: connection IDs above that
+ * must never be used, even with more connections than slots */
+START_TEST(test_vj_slots)
+{
+  int i, j, n = 6;
+  u_int type;
+  LWIP_UNUSED_ARG(_i);
+
+  vj_compress_config(&tx, 0, 3);
+  EXPECT(tx.maxSlotIndex == 3);
+  test_vj_flows_init(n);
+  for (i = 0; i < 4; i++) {
+    /* 4 connections take turns: all of them stay in the table */
+    for (j = 0; j < 4; j++) {
+      type = test_vj_roundtrip(&flows[j]);
+      EXPECT(type == ((i == 0) ? TYPE_UNCOMPRESSED_TCP : TYPE_COMPRESSED_TCP));
+    }
+  }
+  for (i = 0; i < 4; i++) {
+    /* 6 of them in turn: each evicts the least recently used one */
+    for (j = 0; j < n; j++) {
+      type = test_vj_roundtrip(&flows[j]);
+      EXPECT(type == ((i == 0 && j < 4) ? TYPE_COMPRESSED_TCP : TYPE_UNCOMPRESSED_TCP));
+    }
+  }
+  /* the lru order survives the evictions */
+  type = test_vj_roundtrip(&flows[n - 1]);
+  EXPECT(type == TYPE_COMPRESSED_TCP);
+  type = test_vj_roundtrip(&flows[n - 4]);
+  EXPECT(type == TYPE_COMPRESSED_TCP);
+  EXPECT(rx.stats.vjs_errorin == 0);
+
+  /* smaller than RFC 1144 allows: clamped to 3 states */
+  vj_compress_config(&tx, 0, 0);
+  EXPECT(tx.maxSlotIndex == 2);
+  vj_compress_config(&tx, 1, 255);
+  EXPECT(tx.maxSlotIndex == VJ_MAX_SLOTS - 1);
+}
+END_TEST
+
+/** Replay multi-connection traces: header bytes saved and the cost of
+ * compressing per packet */
+START_TEST(test_vj_speed)
+{
+  static const int nflows[] = {1, 8, 32, VJ_MAX_SLOTS, TEST_VJ_MAX_FLOWS};
+  const int reps = 1000000;
+  u8_t hdr[TEST_VJ_HLEN];
+  struct pbuf *p;
+  clock_t start;
+  double secs, base;
+  int pass, s, r;
+  u16_t len;
+  LWIP_UNUSED_ARG(_i);
+
+  p = pbuf_alloc(PBUF_IP, TEST_VJ_HLEN + 536, PBUF_RAM);
+  fail_unless(p != NULL);
+  for (s = 0; s < (int)(sizeof(nflows) / sizeof(nflows[0])); s++) {
+    base = 0;
+    for (pass = 0; pass < 2; pass++) {
+      /* pass 0 only builds the packets, pass 1 also compresses them */
+      srand(0x1332);
+      memset(&tx, 0, sizeof(tx));
+      vj_compress_init(&tx);
+      vj_compress_config(&tx, 1, VJ_MAX_SLOTS - 1);
+      test_vj_flows_init(nflows[s]);
+      start = clock();
+      for (r = 0; r < reps; r++) {
+        len = test_vj_next(&flows[rand() % nflows[s]], hdr);
+        pbuf_header(p, (s16_t)(TEST_VJ_HLEN + len - p->len));
+        memcpy(p->payload, hdr, TEST_VJ_HLEN);
+        if (pass) {
+          vj_compress_tcp(&tx, p);
+        }
+      }
+      secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+      if (!pass) {
+        base = secs;
+      }
+    }
+    printf("VJ %3d connections: %5.1f%% compressed, %lu header bytes -> %lu (%.1f%% saved), %.0f ns/packet\n",
+      nflows[s], 100.0 * tx.stats.vjs_compressed / reps,
+      tx.stats.vjs_hdrin, tx.stats.vjs_hdrout,
+      100.0 - 100.0 * tx.stats.vjs_hdrout / tx.stats.vjs_hdrin,
+      secs > base ? (secs - base) * 1e9 / reps : 0.0);
+  }
+  pbuf_free(p);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+vj_suite(void)
+{
+  TFun tests[] = {
+    test_vj_flows,
+    test_vj_slots,
+    test_vj_speed
+  };
+  return create_suite("VJ", tests, sizeof(tests)/sizeof(TFun), vj_setup, vj_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef __TEST_VJ_H__
+#define __TEST_VJ_H__
+
+#include "../lwip_check.h"
+
+Suite *vj_suite(void);
+
+#endif
@@ -0,0 +1,299 @@
+#include "test_slipif.h"
+
+#include "../lwip_sio.h"
+#include "netif/slipif.h"
+#include "lwip/stats.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_HAVE_SLIPIF || !SLIP_RX_FROM_ISR || !SLIP_TX_BUFSIZE
+#error "This tests needs LWIP_HAVE_SLIPIF, SLIP_RX_FROM_ISR and SLIP_TX_BUFSIZE"
+#endif
+
+#define TEST_SLIP_END     0xC0
+#define TEST_SLIP_ESC     0xDB
+#define TEST_SLIP_MAX     (2 * 1500 + 2)
+
+/* A pseudo-serial pair: what one end writes, the other end reads */
+struct test_slip_line {
+  struct test_sio sio;
+  struct test_slip_line *peer;
+  u32_t len, rd;
+  u8_t buf[256 * 1024];
+};
+
+static struct test_slip_line line_a, line_b;
+static struct netif netif_a, netif_b;
+static u8_t sio_num_a = 0, sio_num_b = 1;
+
+/* everything netif_b received */
+static u8_t rx_stream[128 * 1024];
+static int rx_len, rx_packets;
+
+/* Helper functions */
+
+static u32_t
+test_slipif_write(struct test_sio *sio, const u8_t *data, u32_t len)
+{
+  struct test_slip_line *line = (struct test_slip_line *)sio;
+
+  if (line->len + len > sizeof(line->buf)) {
+    len = sizeof(line->buf) - line->len;
+  }
+  memcpy(line->buf + line->len, data, len);
+  line->len += len;
+  return len;
+}
+
+static u32_t
+test_slipif_read(struct test_sio *sio, u8_t *data, u32_t len)
+{
+  struct test_slip_line *line = ((struct test_slip_line *)sio)->peer;
+
+  len = LWIP_MIN(len, line->len - line->rd);
+  memcpy(data, line->buf + line->rd, len);
+  line->rd += len;
+  if (line->rd == line->len) {
+    line->rd = line->len = 0;
+  }
+  return len;
+}
+
+static err_t
+test_slipif_input(struct pbuf *p, struct netif *inp)
+{
+  LWIP_UNUSED_ARG(inp);
+  if (rx_len + p->tot_len <= (int)sizeof(rx_stream)) {
+    pbuf_copy_partial(p, rx_stream + rx_len, p->tot_len, 0);
+    rx_len += p->tot_len;
+  }
+  rx_packets++;
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+/** SLIP-encode one packet to 'out' (reference encoder)
+ * @return encoded length */
+static int
+test_slipif_encode(u8_t *out, const u8_t *data, int len)
+{
+  int i, n = 0;
+
+  out[n++] = TEST_SLIP_END;
+  for (i = 0; i < len; i++) {
+    if (data[i] == TEST_SLIP_END) {
+      out[n++] = TEST_SLIP_ESC;
+      out[n++] = 0xDC;
+    } else if (data[i] == TEST_SLIP_ESC) {
+      out[n++] = TEST_SLIP_ESC;
+      out[n++] = 0xDD;
+    } else {
+      out[n++] = data[i];
+    }
+  }
+  out[n++] = TEST_SLIP_END;
+  return n;
+}
+
+/** Payload that looks like IP traffic: mostly printable, some binary */
+static void
+test_slipif_payload(u8_t *data, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++) {
+    data[i] = (u8_t)((rand() & 3) ? (0x20 + rand() % 0x5f) : rand());
+  }
+}
+
+/** Split data over a chain of PBUF_REFs of random sizes */
+static struct pbuf *
+test_slipif_chain(u8_t *data, int len)
+{
+  struct pbuf *p = NULL, *q;
+  int chunk;
+
+  while (len > 0) {
+    chunk = 1 + rand() % 300;
+    if (chunk > len) {
+      chunk = len;
+    }
+    q = pbuf_alloc(PBUF_RAW, (u16_t)chunk, PBUF_REF);
+    fail_unless(q != NULL);
+    q->payload = data;
+    if (p == NULL) {
+      p = q;
+    } else {
+      pbuf_cat(p, q);
+    }
+    data += chunk;
+    len -= chunk;
+  }
+  return p;
+}
+
+/** Pass what netif_a sent to netif_b in blocks of at most 'max' bytes,
+ * as a UART DMA would hand them over */
+static void
+test_slipif_deliver(u32_t max)
+{
+  u32_t chunk;
+
+  while (line_a.rd < line_a.len) {
+    chunk = LWIP_MIN(max, line_a.len - line_a.rd);
+    slipif_received_bytes(&netif_b, line_a.buf + line_a.rd, (u16_t)chunk);
+    slipif_process_rxqueue(&netif_b);
+    line_a.rd += chunk;
+  }
+  line_a.rd = line_a.len = 0;
+}
+
+/* Setups/teardown functions */
+
+static void
+slipif_setup(void)
+{
+  ip_addr_t addr, mask;
+
+  line_a.sio.write = line_b.sio.write = test_slipif_write;
+  line_a.sio.read = line_b.sio.read = test_slipif_read;
+  line_a.peer = &line_b;
+  line_b.peer = &line_a;
+  line_a.len = line_a.rd = line_b.len = line_b.rd = 0;
+  test_sio_devs[sio_num_a] = &line_a.sio;
+  test_sio_devs[sio_num_b] = &line_b.sio;
+
+  IP4_ADDR(&mask, 255, 255, 255, 255);
+  IP4_ADDR(&addr, 10, 0, 0, 1);
+  fail_unless(netif_add(&netif_a, &addr, &mask, &addr, &sio_num_a, slipif_init, test_slipif_input) != NULL);
+  IP4_ADDR(&addr, 10, 0, 0, 2);
+  fail_unless(netif_add(&netif_b, &addr, &mask, &addr, &sio_num_b, slipif_init, test_slipif_input) != NULL);
+  rx_len = rx_packets = 0;
+  srand(4321);
+}
+
+static void
+slipif_teardown(void)
+{
+  netif_remove(&netif_a);
+  netif_remove(&netif_b);
+  /* slipif has no deinit function */
+  mem_free(netif_a.state);
+  mem_free(netif_b.state);
+  test_sio_devs[sio_num_a] = test_sio_devs[sio_num_b] = NULL;
+}
+
+
+/* Test functions */
+
+/** Packets sent from pbuf chains are encoded exactly like the reference
+ * encoder does it and arrive unchanged, received through slipif_poll() and
+ * in blocks of more than 255 bytes through slipif_received_bytes() */
+START_TEST(test_slipif_frames)
+{
+  static u8_t data[1500];
+  static u8_t frame[TEST_SLIP_MAX];
+  static u8_t tx_stream[128 * 1024];
+  struct pbuf *p;
+  int pass, k, len, n, tx_len, packets;
+  LWIP_UNUSED_ARG(_i);
+
+  for (pass = 0; pass < 2; pass++) {
+    tx_len = 0;
+    packets = 0;
+    rx_len = rx_packets = 0;
+    for (k = 1; k <= 1500; k += 1 + k / 8) {
+      /* blocks handed to slipif_received_bytes() hold a few packets at
+         most, so they fit in the PBUF_POOL until processed */
+      len = pass ? 200 + rand() % 1301 : k;
+      test_slipif_payload(data, len);
+      if ((k % 5) == 0) {
+        /* a run of bytes that all need escaping */
+        memset(data, (k & 1) ? TEST_SLIP_END : TEST_SLIP_ESC, len / 2);
+      }
+      p = test_slipif_chain(data, len);
+      n = (int)line_a.len;
+      EXPECT(netif_a.output(&netif_a, p, NULL) == ERR_OK);
+      pbuf_free(p);
+      EXPECT((int)line_a.len - n == test_slipif_encode(frame, data, len));
+      EXPECT(memcmp(line_a.buf + n, frame, line_a.len - n) == 0);
+      memcpy(tx_stream + tx_len, data, len);
+      tx_len += len;
+      packets++;
+    }
+
+    if (pass == 0) {
+      slipif_poll(&netif_b);
+    } else {
+      test_slipif_deliver(1 + rand() % 1000);
+    }
+    EXPECT(line_a.len == 0);
+    EXPECT(rx_packets == packets);
+    EXPECT(rx_len == tx_len);
+    EXPECT(memcmp(rx_stream, tx_stream, tx_len) == 0);
+  }
+}
+END_TEST
+
+/** Packets per second through the pseudo-serial pair, for small and full
+ * sized packets */
+START_TEST(test_slipif_speed)
+{
+  static const int sizes[] = {64, 1500};
+  static u8_t data[1500];
+  struct pbuf *p;
+  clock_t start, tx_clk, rx_clk;
+  int s, r, batch, batches, frames;
+  LWIP_UNUSED_ARG(_i);
+
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    p = pbuf_alloc(PBUF_RAW, (u16_t)sizes[s], PBUF_RAM);
+    fail_unless(p != NULL);
+    test_slipif_payload(data, sizes[s]);
+    pbuf_take(p, data, (u16_t)sizes[s]);
+
+    /* batches filling the line buffer, received in DMA sized blocks */
+    batch = (int)(sizeof(line_a.buf) / (2 * sizes[s] + 2));
+    batches = 4000000 / (batch * sizes[s]) + 1;
+    tx_clk = rx_clk = 0;
+    rx_packets = 0;
+    frames = 0;
+    for (r = 0; r < batches; r++) {
+      int f;
+      start = clock();
+      for (f = 0; f < batch; f++) {
+        netif_a.output(&netif_a, p, NULL);
+      }
+      tx_clk += clock() - start;
+      start = clock();
+      rx_len = 0;
+      test_slipif_deliver(512);
+      rx_clk += clock() - start;
+      frames += batch;
+    }
+    pbuf_free(p);
+    EXPECT(rx_packets == frames);
+
+    printf("SLIP %4d byte packets: tx %.0f frames/s (%.1f MB/s), rx %.0f frames/s (%.1f MB/s)\n",
+      sizes[s],
+      tx_clk > 0 ? (double)frames * CLOCKS_PER_SEC / tx_clk : 0.0,
+      tx_clk > 0 ? (double)frames * sizes[s] * CLOCKS_PER_SEC / tx_clk / 1e6 : 0.0,
+      rx_clk > 0 ? (double)frames * CLOCKS_PER_SEC / rx_clk : 0.0,
+      rx_clk > 0 ? (double)frames * sizes[s] * CLOCKS_PER_SEC / rx_clk / 1e6 : 0.0);
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+slipif_suite(void)
+{
+  TFun tests[] = {
+    test_slipif_frames,
+    test_slipif_speed
+  };
+  return create_suite("SLIPIF", tests, sizeof(tests)/sizeof(TFun), slipif_setup, slipif_teardown);
+}
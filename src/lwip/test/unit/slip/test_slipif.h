@@ -0,0 +1,8 @@
+#ifndef __TEST_SLIPIF_H__
+#define __TEST_SLIPIF_H__
+
+#include "../lwip_check.h"
+
+Suite *slipif_suite(void);
+
+#endif
@@ -0,0 +1,774 @@
+#include "test_snmp.h"
+
+#include "lwip/udp.h"
+#include "lwip/ip.h"
+#include "lwip/snmp.h"
+#include "lwip/snmp_asn1.h"
+#include "lwip/snmp_msg.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/netif.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !LWIP_SNMP || !SNMP_V2C || (SNMP_GETNEXT_CACHE < 2)
+#error "This tests needs LWIP_SNMP with SNMPv2c and 2 cached GetNext positions enabled"
+#endif
+#if (MEMP_NUM_UDP_PCB < 110) || (MEMP_NUM_SNMP_VARBIND < 32) || (MEMP_NUM_SNMP_VALUE < 64)
+#error "This tests needs 110 UDP pcbs and room for GetBulk responses"
+#endif
+
+/** number of udpTable entries the tests add */
+#define TEST_SNMP_UDP_ENTRIES 100
+#define TEST_SNMP_UDP_PORT    10000
+#define TEST_SNMP_MGR_PORT    5000
+#define TEST_SNMP_MAX_VBS     256
+
+#define TEST_SNMP_LEN(a) ((u8_t)(sizeof(a) / sizeof((a)[0])))
+
+/* pcb of the agent, not exported by snmp_msg.h */
+extern struct udp_pcb *snmp1_pcb;
+
+struct test_snmp_vb {
+  s32_t id[LWIP_SNMP_OBJ_ID_LEN];
+  u8_t len;
+  u8_t type;
+};
+
+static struct netif test_netif;
+static ip_addr_t test_ipaddr, test_netmask, test_gw, test_mgr;
+static struct udp_pcb *test_pcbs[TEST_SNMP_UDP_ENTRIES];
+
+/* last response sent by the agent */
+static int resp_ctr;
+static s32_t resp_version;
+static s32_t resp_rid;
+static s32_t resp_err;
+static s32_t resp_idx;
+static int resp_vb_cnt;
+static struct test_snmp_vb resp_vb[TEST_SNMP_MAX_VBS];
+
+static s32_t request_id;
+
+/* .iso.org.dod.internet.mgmt.mib-2.system.sysDescr */
+static const s32_t oid_sysdescr[] = {1, 3, 6, 1, 2, 1, 1, 1};
+/* .iso.org.dod.internet.mgmt.mib-2.udp.udpTable.udpEntry.udpLocalAddress */
+static const s32_t oid_udp_addr[] = {1, 3, 6, 1, 2, 1, 7, 5, 1, 1};
+/* .iso.org.dod.internet.mgmt.mib-2.udp.udpTable.udpEntry.udpLocalPort */
+static const s32_t oid_udp_port[] = {1, 3, 6, 1, 2, 1, 7, 5, 1, 2};
+/* beyond everything implemented */
+static const s32_t oid_end[] = {1, 3, 6, 1, 9};
+
+/* Helper functions */
+
+static u16_t
+test_snmp_enc_len(u8_t *out, u16_t len)
+{
+  if (len < 0x80) {
+    out[0] = (u8_t)len;
+    return 1;
+  }
+  out[0] = 0x82;
+  out[1] = (u8_t)(len >> 8);
+  out[2] = (u8_t)len;
+  return 3;
+}
+
+/** Encode type, length and contents, val may point to out */
+static u16_t
+test_snmp_enc_tlv(u8_t *out, u8_t type, const u8_t *val, u16_t len)
+{
+  u8_t hdr[4];
+  u16_t hlen;
+
+  hdr[0] = type;
+  hlen = (u16_t)(1 + test_snmp_enc_len(&hdr[1], len));
+  memmove(out + hlen, val, len);
+  memcpy(out, hdr, hlen);
+  return (u16_t)(hlen + len);
+}
+
+static u16_t
+test_snmp_enc_int(u8_t *out, s32_t v)
+{
+  u8_t val[5];
+  u16_t len = 4;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    val[i] = (u8_t)(v >> (24 - 8 * i));
+  }
+  /* strip redundant leading octets */
+  i = 0;
+  while ((len > 1) && (((val[i] == 0) && !(val[i + 1] & 0x80)) ||
+                       ((val[i] == 0xff) && (val[i + 1] & 0x80)))) {
+    i++;
+    len--;
+  }
+  return test_snmp_enc_tlv(out, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG, &val[i], len);
+}
+
+static u16_t
+test_snmp_enc_oid(u8_t *out, const s32_t *id, u8_t id_len)
+{
+  u8_t val[5 * LWIP_SNMP_OBJ_ID_LEN];
+  u16_t len = 0;
+  u8_t i;
+
+  val[len++] = (u8_t)(id[0] * 40 + id[1]);
+  for (i = 2; i < id_len; i++) {
+    u32_t sub = (u32_t)id[i];
+    int shift;
+    for (shift = 28; shift > 0; shift -= 7) {
+      if ((sub >> shift) != 0) {
+        val[len++] = (u8_t)(0x80 | ((sub >> shift) & 0x7f));
+      }
+    }
+    val[len++] = (u8_t)(sub & 0x7f);
+  }
+  return test_snmp_enc_tlv(out, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID, val, len);
+}
+
+/** Decode type and length at *pos, returns the length, *pos points to the contents */
+static u16_t
+test_snmp_dec_tl(const u8_t *buf, u16_t *pos, u8_t *type)
+{
+  u16_t len;
+
+  *type = buf[(*pos)++];
+  len = buf[(*pos)++];
+  if (len == 0x81) {
+    len = buf[(*pos)++];
+  } else if (len == 0x82) {
+    len = (u16_t)((buf[*pos] << 8) | buf[*pos + 1]);
+    *pos = (u16_t)(*pos + 2);
+  }
+  return len;
+}
+
+static s32_t
+test_snmp_dec_int(const u8_t *buf, u16_t *pos)
+{
+  u8_t type;
+  u16_t len = test_snmp_dec_tl(buf, pos, &type);
+  s32_t v = (buf[*pos] & 0x80) ? -1 : 0;
+
+  EXPECT(type == (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG));
+  while (len-- > 0) {
+    v = (s32_t)(((u32_t)v << 8) | buf[(*pos)++]);
+  }
+  return v;
+}
+
+/** netif->output: parse the response sent by the agent */
+static err_t
+test_snmp_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  static u8_t buf[IP_HLEN + UDP_HLEN + 1600];
+  u16_t pos, end, len, vb_end;
+  u8_t type;
+
+  fail_unless(netif == &test_netif);
+  EXPECT(ip_addr_cmp(ipaddr, &test_mgr));
+  len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+  EXPECT_RETX(len == p->tot_len, ERR_OK);
+  EXPECT_RETX(IPH_PROTO((struct ip_hdr *)buf) == IP_PROTO_UDP, ERR_OK);
+  EXPECT(((buf[IP_HLEN + 2] << 8) | buf[IP_HLEN + 3]) == TEST_SNMP_MGR_PORT);
+
+  pos = IP_HLEN + UDP_HLEN;
+  len = test_snmp_dec_tl(buf, &pos, &type);
+  EXPECT_RETX(type == (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ), ERR_OK);
+  EXPECT_RETX(pos + len == p->tot_len, ERR_OK);
+  resp_version = test_snmp_dec_int(buf, &pos);
+  len = test_snmp_dec_tl(buf, &pos, &type);
+  EXPECT(type == (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR));
+  pos = (u16_t)(pos + len);
+  test_snmp_dec_tl(buf, &pos, &type);
+  EXPECT_RETX(type == (SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | SNMP_ASN1_PDU_GET_RESP), ERR_OK);
+  resp_rid = test_snmp_dec_int(buf, &pos);
+  resp_err = test_snmp_dec_int(buf, &pos);
+  resp_idx = test_snmp_dec_int(buf, &pos);
+  len = test_snmp_dec_tl(buf, &pos, &type);
+  EXPECT_RETX(type == (SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ), ERR_OK);
+  end = (u16_t)(pos + len);
+  resp_vb_cnt = 0;
+  while ((pos < end) && (resp_vb_cnt < TEST_SNMP_MAX_VBS)) {
+    struct test_snmp_vb *vb = &resp_vb[resp_vb_cnt++];
+
+    len = test_snmp_dec_tl(buf, &pos, &type);
+    vb_end = (u16_t)(pos + len);
+    len = test_snmp_dec_tl(buf, &pos, &type);
+    EXPECT_RETX(type == (SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID), ERR_OK);
+    vb->id[0] = buf[pos] / 40;
+    vb->id[1] = buf[pos] % 40;
+    vb->len = 2;
+    for (pos++, len--; len > 0; vb->len++) {
+      s32_t sub = 0;
+      do {
+        sub = (sub << 7) | (buf[pos] & 0x7f);
+        len--;
+      } while (buf[pos++] & 0x80);
+      vb->id[vb->len] = sub;
+    }
+    vb->type = buf[pos];
+    pos = vb_end;
+  }
+  resp_ctr++;
+  return ERR_OK;
+}
+
+static err_t
+test_snmp_netif_init(struct netif *netif)
+{
+  fail_unless(netif != NULL);
+  netif->output = test_snmp_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/** Send a request from the manager, a and b are error-status and error-index
+ * (non-repeaters and max-repetitions for GetBulk) */
+static void
+test_snmp_request(s32_t version, u8_t pdu, s32_t a, s32_t b, const struct test_snmp_vb *vbs, int n)
+{
+  static u8_t buf[IP_HLEN + UDP_HLEN + 1600];
+  u8_t *msg = buf + IP_HLEN + UDP_HLEN;
+  u8_t vbl[1400];
+  u16_t vbl_len = 0, len, vb_len, totlen;
+  struct ip_hdr *iphdr;
+  struct pbuf *p;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    u8_t *vb = &vbl[vbl_len];
+    vb_len = test_snmp_enc_oid(vb, vbs[i].id, vbs[i].len);
+    vb[vb_len++] = SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_NUL;
+    vb[vb_len++] = 0;
+    vbl_len = (u16_t)(vbl_len + test_snmp_enc_tlv(vb, SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ, vb, vb_len));
+  }
+  /* PDU */
+  request_id++;
+  len = test_snmp_enc_int(msg, request_id);
+  len = (u16_t)(len + test_snmp_enc_int(msg + len, a));
+  len = (u16_t)(len + test_snmp_enc_int(msg + len, b));
+  len = (u16_t)(len + test_snmp_enc_tlv(msg + len, SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ, vbl, vbl_len));
+  len = test_snmp_enc_tlv(msg, SNMP_ASN1_CONTXT | SNMP_ASN1_CONSTR | pdu, msg, len);
+  /* message header */
+  memmove(msg + 32, msg, len);
+  vb_len = test_snmp_enc_int(msg, version);
+  vb_len = (u16_t)(vb_len + test_snmp_enc_tlv(msg + vb_len, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OC_STR,
+    (const u8_t *)"public", 6));
+  memmove(msg + vb_len, msg + 32, len);
+  len = test_snmp_enc_tlv(msg, SNMP_ASN1_UNIV | SNMP_ASN1_CONSTR | SNMP_ASN1_SEQ, msg, (u16_t)(vb_len + len));
+
+  /* UDP header without checksum */
+  msg = buf + IP_HLEN;
+  msg[0] = (u8_t)(TEST_SNMP_MGR_PORT >> 8); msg[1] = (u8_t)TEST_SNMP_MGR_PORT;
+  msg[2] = 0; msg[3] = SNMP_IN_PORT;
+  msg[4] = (u8_t)((UDP_HLEN + len) >> 8); msg[5] = (u8_t)(UDP_HLEN + len);
+  msg[6] = 0; msg[7] = 0;
+
+  totlen = (u16_t)(IP_HLEN + UDP_HLEN + len);
+  iphdr = (struct ip_hdr *)buf;
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_TOS_SET(iphdr, 0);
+  IPH_LEN_SET(iphdr, htons(totlen));
+  IPH_ID_SET(iphdr, 0);
+  IPH_OFFSET_SET(iphdr, 0);
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip_addr_copy(iphdr->src, test_mgr);
+  ip_addr_copy(iphdr->dest, test_ipaddr);
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  p = pbuf_alloc(PBUF_RAW, totlen, PBUF_RAM);
+  EXPECT_RET(p != NULL);
+  memcpy(p->payload, buf, totlen);
+  resp_vb_cnt = -1;
+  ip_input(p, &test_netif);
+}
+
+static void
+test_snmp_vb_set(struct test_snmp_vb *vb, const s32_t *id, u8_t len)
+{
+  memcpy(vb->id, id, len * sizeof(s32_t));
+  vb->len = len;
+  vb->type = 0;
+}
+
+/** Single varbind GetNext, returns the number of varbinds in the response */
+static int
+test_snmp_getnext(s32_t version, const struct test_snmp_vb *vb)
+{
+  test_snmp_request(version, SNMP_ASN1_PDU_GET_NEXT_REQ, 0, 0, vb, 1);
+  return resp_vb_cnt;
+}
+
+static int
+test_snmp_vb_in(const struct test_snmp_vb *vb, const s32_t *prefix, u8_t len)
+{
+  return (vb->len > len) && (memcmp(vb->id, prefix, len * sizeof(s32_t)) == 0);
+}
+
+/** Walk a column with GetNext, store the names in 'names' (up to 'max'),
+ * return the number of entries (-1 on error) */
+static int
+test_snmp_walk_getnext(const s32_t *column, u8_t len, struct test_snmp_vb *names, int max)
+{
+  struct test_snmp_vb vb;
+  int n = 0;
+
+  test_snmp_vb_set(&vb, column, len);
+  for (;;) {
+    if (test_snmp_getnext(SNMP_VERSION_2c, &vb) != 1) {
+      return -1;
+    }
+    if ((resp_err != SNMP_ES_NOERROR) || !test_snmp_vb_in(&resp_vb[0], column, len)) {
+      return n;
+    }
+    vb = resp_vb[0];
+    if (n < max) {
+      names[n] = vb;
+    }
+    n++;
+  }
+}
+
+/** Walk a column with GetBulk (max-repetitions 'reps'), count requests in *reqs */
+static int
+test_snmp_walk_getbulk(const s32_t *column, u8_t len, struct test_snmp_vb *names, int max, s32_t reps, int *reqs)
+{
+  struct test_snmp_vb vb;
+  int n = 0, i;
+
+  test_snmp_vb_set(&vb, column, len);
+  *reqs = 0;
+  for (;;) {
+    test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, 0, reps, &vb, 1);
+    (*reqs)++;
+    if ((resp_vb_cnt <= 0) || (resp_err != SNMP_ES_NOERROR)) {
+      return -1;
+    }
+    for (i = 0; i < resp_vb_cnt; i++) {
+      if (!test_snmp_vb_in(&resp_vb[i], column, len)) {
+        return n;
+      }
+      if (n < max) {
+        names[n] = resp_vb[i];
+      }
+      n++;
+    }
+    vb = resp_vb[resp_vb_cnt - 1];
+  }
+}
+
+static void
+test_snmp_add_udp_entries(void)
+{
+  int i;
+
+  for (i = 0; i < TEST_SNMP_UDP_ENTRIES; i++) {
+    test_pcbs[i] = udp_new();
+    fail_unless(test_pcbs[i] != NULL);
+    fail_unless(udp_bind(test_pcbs[i], &test_ipaddr, (u16_t)(TEST_SNMP_UDP_PORT + i)) == ERR_OK);
+  }
+}
+
+/* Setups/teardown functions */
+
+static void
+snmp_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192,168,0,1);
+  IP4_ADDR(&test_netmask, 255,255,255,0);
+  IP4_ADDR(&test_gw, 192,168,0,254);
+  IP4_ADDR(&test_mgr, 192,168,0,100);
+
+  fail_unless(netif_default == NULL);
+  netif_set_default(netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw,
+                              NULL, test_snmp_netif_init, NULL));
+  netif_set_up(&test_netif);
+  memset(test_pcbs, 0, sizeof(test_pcbs));
+  snmp_init();
+  fail_unless(snmp1_pcb != NULL);
+  resp_ctr = 0;
+}
+
+static void
+snmp_teardown(void)
+{
+  int i;
+
+  for (i = 0; i < TEST_SNMP_UDP_ENTRIES; i++) {
+    if (test_pcbs[i] != NULL) {
+      udp_remove(test_pcbs[i]);
+    }
+  }
+  udp_remove(snmp1_pcb);
+  snmp1_pcb = NULL;
+  fail_unless(netif_default == &test_netif);
+  netif_remove(&test_netif);
+  netif_set_default(NULL);
+}
+
+
+/* Test functions */
+
+/** GetNext past the end of the MIB: noSuchName for v1, endOfMibView for v2c */
+START_TEST(test_snmp_getnext_end_of_mib)
+{
+  struct test_snmp_vb vb;
+  LWIP_UNUSED_ARG(_i);
+
+  test_snmp_vb_set(&vb, oid_sysdescr, TEST_SNMP_LEN(oid_sysdescr));
+  EXPECT(test_snmp_getnext(SNMP_VERSION_1, &vb) == 1);
+  EXPECT(resp_version == SNMP_VERSION_1);
+  EXPECT(resp_rid == request_id);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT(resp_vb[0].len == 9);
+  EXPECT(resp_vb[0].id[8] == 0);
+
+  test_snmp_vb_set(&vb, oid_end, TEST_SNMP_LEN(oid_end));
+  EXPECT(test_snmp_getnext(SNMP_VERSION_1, &vb) == 1);
+  EXPECT(resp_err == SNMP_ES_NOSUCHNAME);
+  EXPECT(resp_idx == 1);
+
+  EXPECT(test_snmp_getnext(SNMP_VERSION_2c, &vb) == 1);
+  EXPECT(resp_version == SNMP_VERSION_2c);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT(resp_vb[0].type == (SNMP_ASN1_CONTXT | SNMP_ASN1_PRIMIT | SNMP_ASN1_END_OF_MIB_VIEW));
+  EXPECT(resp_vb[0].len == vb.len);
+  EXPECT(memcmp(resp_vb[0].id, vb.id, vb.len * sizeof(s32_t)) == 0);
+
+  /* GetBulk is not part of SNMPv1 */
+  test_snmp_request(SNMP_VERSION_1, SNMP_ASN1_PDU_GET_BULK_REQ, 0, 10, &vb, 1);
+  EXPECT(resp_vb_cnt == -1);
+}
+END_TEST
+
+/** GetBulk: non-repeaters once, repeaters max-repetitions times */
+START_TEST(test_snmp_getbulk)
+{
+  struct test_snmp_vb vbs[2];
+  struct test_snmp_vb names[TEST_SNMP_UDP_ENTRIES + 8];
+  int n, i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_snmp_add_udp_entries();
+  n = test_snmp_walk_getnext(oid_udp_port, TEST_SNMP_LEN(oid_udp_port), names, TEST_SNMP_LEN(names));
+  EXPECT(n >= TEST_SNMP_UDP_ENTRIES);
+
+  test_snmp_vb_set(&vbs[0], oid_sysdescr, TEST_SNMP_LEN(oid_sysdescr));
+  test_snmp_vb_set(&vbs[1], oid_udp_port, TEST_SNMP_LEN(oid_udp_port));
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, 1, 10, vbs, 2);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT_RET(resp_vb_cnt == 11);
+  EXPECT(resp_vb[0].len == 9);
+  EXPECT(memcmp(resp_vb[0].id, oid_sysdescr, sizeof(oid_sysdescr)) == 0);
+  for (i = 0; i < 10; i++) {
+    EXPECT(resp_vb[1 + i].len == names[i].len);
+    EXPECT(memcmp(resp_vb[1 + i].id, names[i].id, names[i].len * sizeof(s32_t)) == 0);
+  }
+
+  /* two repeaters, rows interleaved */
+  test_snmp_vb_set(&vbs[0], oid_udp_addr, TEST_SNMP_LEN(oid_udp_addr));
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, 0, 5, vbs, 2);
+  EXPECT_RET(resp_vb_cnt == 10);
+  for (i = 0; i < 5; i++) {
+    EXPECT(resp_vb[2 * i].id[9] == 1);
+    EXPECT(memcmp(&resp_vb[2 * i + 1].id[10], &names[i].id[10], 5 * sizeof(s32_t)) == 0);
+  }
+
+  /* running off the end stops after the first row of endOfMibView */
+  test_snmp_vb_set(&vbs[0], oid_end, TEST_SNMP_LEN(oid_end));
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, 0, 10, vbs, 1);
+  EXPECT_RET(resp_vb_cnt == 1);
+  EXPECT(resp_vb[0].type == (SNMP_ASN1_CONTXT | SNMP_ASN1_PRIMIT | SNMP_ASN1_END_OF_MIB_VIEW));
+
+  /* negative non-repeaters and max-repetitions count as 0 */
+  test_snmp_vb_set(&vbs[0], oid_sysdescr, TEST_SNMP_LEN(oid_sysdescr));
+  test_snmp_vb_set(&vbs[1], oid_udp_port, TEST_SNMP_LEN(oid_udp_port));
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, -1, 3, vbs, 2);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT_RET(resp_vb_cnt == 6);
+  EXPECT(resp_vb[0].len == 9);
+  EXPECT(memcmp(resp_vb[1].id, names[0].id, names[0].len * sizeof(s32_t)) == 0);
+  EXPECT(memcmp(resp_vb[5].id, names[2].id, names[2].len * sizeof(s32_t)) == 0);
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, 1, -5, vbs, 2);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT_RET(resp_vb_cnt == 1);
+  EXPECT(resp_vb[0].len == 9);
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, -1, -1, vbs, 2);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT(resp_vb_cnt == 0);
+
+  /* responses are truncated to fit */
+  test_snmp_vb_set(&vbs[0], oid_udp_port, TEST_SNMP_LEN(oid_udp_port));
+  test_snmp_request(SNMP_VERSION_2c, SNMP_ASN1_PDU_GET_BULK_REQ, 0, 200, vbs, 1);
+  EXPECT(resp_err == SNMP_ES_NOERROR);
+  EXPECT(resp_vb_cnt > 10);
+  EXPECT(resp_vb_cnt < MEMP_NUM_SNMP_VARBIND);
+}
+END_TEST
+
+/** A walk resuming at the cached position sees table changes */
+START_TEST(test_snmp_walk_table_change)
+{
+  struct test_snmp_vb vb, names[TEST_SNMP_UDP_ENTRIES + 8];
+  int n, first, i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_snmp_add_udp_entries();
+  n = test_snmp_walk_getnext(oid_udp_port, TEST_SNMP_LEN(oid_udp_port), names, TEST_SNMP_LEN(names));
+  EXPECT_RET(n >= TEST_SNMP_UDP_ENTRIES);
+  /* our entries are the last ones (192.168.0.1 > 0.0.0.0) */
+  first = n - TEST_SNMP_UDP_ENTRIES;
+  EXPECT(names[first].id[14] == TEST_SNMP_UDP_PORT);
+
+  /* walk to port 50, the cache now points there */
+  vb = names[first + 49];
+  EXPECT(test_snmp_getnext(SNMP_VERSION_2c, &vb) == 1);
+  EXPECT(resp_vb[0].id[14] == TEST_SNMP_UDP_PORT + 50);
+
+  /* remove the next entry */
+  vb = resp_vb[0];
+  udp_remove(test_pcbs[51]);
+  test_pcbs[51] = NULL;
+  EXPECT(test_snmp_getnext(SNMP_VERSION_2c, &vb) == 1);
+  EXPECT(resp_vb[0].id[14] == TEST_SNMP_UDP_PORT + 52);
+
+  /* insert an entry, the walk finds it in order */
+  vb = resp_vb[0];
+  test_pcbs[51] = udp_new();
+  fail_unless(test_pcbs[51] != NULL);
+  fail_unless(udp_bind(test_pcbs[51], &test_ipaddr, TEST_SNMP_UDP_PORT + 52 + 1000) == ERR_OK);
+  for (i = 53; i < TEST_SNMP_UDP_ENTRIES; i++) {
+    EXPECT(test_snmp_getnext(SNMP_VERSION_2c, &vb) == 1);
+    EXPECT(resp_vb[0].id[14] == TEST_SNMP_UDP_PORT + i);
+    vb = resp_vb[0];
+  }
+  EXPECT(test_snmp_getnext(SNMP_VERSION_2c, &vb) == 1);
+  EXPECT(resp_vb[0].id[14] == TEST_SNMP_UDP_PORT + 52 + 1000);
+  vb = resp_vb[0];
+  /* off the column, into the next table */
+  EXPECT(test_snmp_getnext(SNMP_VERSION_2c, &vb) == 1);
+  EXPECT(!test_snmp_vb_in(&resp_vb[0], oid_udp_port, TEST_SNMP_LEN(oid_udp_port)));
+}
+END_TEST
+
+/** Table walk time: udpTable with 100 entries (tcpConnTable is not
+ * implemented by this agent) walked with GetNext and GetBulk */
+START_TEST(test_snmp_walk_time)
+{
+  static struct test_snmp_vb names_next[TEST_SNMP_UDP_ENTRIES + 8];
+  static struct test_snmp_vb names_bulk[TEST_SNMP_UDP_ENTRIES + 8];
+  struct test_snmp_vb vb;
+  clock_t start;
+  double t_next, t_bulk, t_root, t_resume;
+  int n_next, n_bulk, reqs, k;
+  const int walks = 200;
+  LWIP_UNUSED_ARG(_i);
+
+  test_snmp_add_udp_entries();
+
+  start = clock();
+  for (k = 0; k < walks; k++) {
+    n_next = test_snmp_walk_getnext(oid_udp_port, TEST_SNMP_LEN(oid_udp_port), names_next, TEST_SNMP_LEN(names_next));
+  }
+  t_next = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / walks;
+  start = clock();
+  for (k = 0; k < walks; k++) {
+    n_bulk = test_snmp_walk_getbulk(oid_udp_port, TEST_SNMP_LEN(oid_udp_port), names_bulk, TEST_SNMP_LEN(names_bulk), 25, &reqs);
+  }
+  t_bulk = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / walks;
+  EXPECT(n_next >= TEST_SNMP_UDP_ENTRIES);
+  EXPECT_RET(n_bulk == n_next);
+  for (k = 0; k < n_next; k++) {
+    EXPECT(names_bulk[k].len == names_next[k].len);
+    EXPECT(memcmp(names_bulk[k].id, names_next[k].id, names_next[k].len * sizeof(s32_t)) == 0);
+  }
+
+  /* single GetNext in the middle of the table: descent from the root
+     (the same request again never hits the cache) vs. a walk step */
+  vb = names_next[n_next - TEST_SNMP_UDP_ENTRIES / 2];
+  start = clock();
+  for (k = 0; k < walks * 10; k++) {
+    test_snmp_getnext(SNMP_VERSION_2c, &vb);
+  }
+  t_root = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / (walks * 10);
+  t_resume = t_next / (n_next + 1);
+
+  printf("SNMP udpTable walk (%d entries): GetNext %d requests %.1f us, GetBulk %d requests %.1f us\n",
+    n_next, n_next + 1, t_next, reqs, t_bulk);
+  printf("SNMP GetNext: single request %.2f us, per walk step %.2f us\n", t_root, t_resume);
+}
+END_TEST
+
+
+#define TEST_SNMP_BER_ITEMS 200
+#define TEST_SNMP_BER_CHUNK 64
+
+/** BER item as in a varbind: OID name and integer value */
+static void
+test_snmp_ber_item(int k, s32_t *id, s32_t *value)
+{
+  memcpy(id, oid_udp_port, sizeof(oid_udp_port));
+  id[TEST_SNMP_LEN(oid_udp_port) - 1] = k;
+  /* some sub ids >= 2^31 and negative integers in between */
+  id[TEST_SNMP_LEN(oid_udp_port) - 2] = (k & 1) ? (s32_t)0xfffffff0UL : 1;
+  *value = (k & 2) ? -k * 1000 : k * 100000;
+}
+
+/** pbuf chain of small PBUF_RAM pieces, like a response spread over pool pbufs */
+static struct pbuf *
+test_snmp_ber_chain(u16_t tot_len)
+{
+  struct pbuf *p = NULL, *q;
+  u16_t len;
+
+  while (tot_len > 0) {
+    len = LWIP_MIN(tot_len, TEST_SNMP_BER_CHUNK);
+    q = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    fail_unless(q != NULL);
+    if (p == NULL) {
+      p = q;
+    } else {
+      pbuf_cat(p, q);
+    }
+    tot_len -= len;
+  }
+  return p;
+}
+
+/** BER encode/decode throughput: offset based vs. streaming writes
+ * into a pbuf chain, and decoding back what was written */
+START_TEST(test_snmp_ber_time)
+{
+  s32_t id[TEST_SNMP_LEN(oid_udp_port)];
+  s32_t value;
+  u16_t olen[TEST_SNMP_BER_ITEMS], vlen[TEST_SNMP_BER_ITEMS];
+  u16_t tot_len, ofs, len;
+  u8_t olenlen, vlenlen, type, used;
+  struct pbuf *p_ofs, *p_st;
+  struct snmp_asn1_stream st;
+  struct snmp_obj_id oid;
+  s32_t dec;
+  clock_t start;
+  double t_ofs, t_st, t_dec;
+  static u8_t a[TEST_SNMP_BER_ITEMS * 24], b[TEST_SNMP_BER_ITEMS * 24];
+  int k, r;
+  const int rounds = 50;
+  LWIP_UNUSED_ARG(_i);
+
+  /* length pass */
+  tot_len = 0;
+  for (k = 0; k < TEST_SNMP_BER_ITEMS; k++) {
+    test_snmp_ber_item(k, id, &value);
+    snmp_asn1_enc_oid_cnt(TEST_SNMP_LEN(id), id, &olen[k]);
+    snmp_asn1_enc_length_cnt(olen[k], &olenlen);
+    snmp_asn1_enc_s32t_cnt(value, &vlen[k]);
+    snmp_asn1_enc_length_cnt(vlen[k], &vlenlen);
+    tot_len += 1 + olenlen + olen[k] + 1 + vlenlen + vlen[k];
+  }
+  p_ofs = test_snmp_ber_chain(tot_len);
+  p_st = test_snmp_ber_chain(tot_len);
+
+  start = clock();
+  for (r = 0; r < rounds; r++) {
+    ofs = 0;
+    for (k = 0; k < TEST_SNMP_BER_ITEMS; k++) {
+      test_snmp_ber_item(k, id, &value);
+      snmp_asn1_enc_length_cnt(olen[k], &olenlen);
+      snmp_asn1_enc_length_cnt(vlen[k], &vlenlen);
+      snmp_asn1_enc_type(p_ofs, ofs, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID);
+      ofs += 1;
+      snmp_asn1_enc_length(p_ofs, ofs, olen[k]);
+      ofs += olenlen;
+      snmp_asn1_enc_oid(p_ofs, ofs, TEST_SNMP_LEN(id), id);
+      ofs += olen[k];
+      snmp_asn1_enc_type(p_ofs, ofs, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG);
+      ofs += 1;
+      snmp_asn1_enc_length(p_ofs, ofs, vlen[k]);
+      ofs += vlenlen;
+      snmp_asn1_enc_s32t(p_ofs, ofs, vlen[k], value);
+      ofs += vlen[k];
+    }
+  }
+  t_ofs = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds;
+  EXPECT(ofs == tot_len);
+
+  start = clock();
+  for (r = 0; r < rounds; r++) {
+    EXPECT(snmp_asn1_stream_init(&st, p_st, 0) == ERR_OK);
+    for (k = 0; k < TEST_SNMP_BER_ITEMS; k++) {
+      test_snmp_ber_item(k, id, &value);
+      snmp_asn1_stream_enc_type(&st, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_OBJ_ID);
+      snmp_asn1_stream_enc_length(&st, olen[k]);
+      snmp_asn1_stream_enc_oid(&st, TEST_SNMP_LEN(id), id);
+      snmp_asn1_stream_enc_type(&st, SNMP_ASN1_UNIV | SNMP_ASN1_PRIMIT | SNMP_ASN1_INTEG);
+      snmp_asn1_stream_enc_length(&st, vlen[k]);
+      snmp_asn1_stream_enc_s32t(&st, vlen[k], value);
+    }
+  }
+  t_st = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds;
+  /* chain is full, nothing more fits */
+  EXPECT(snmp_asn1_stream_enc_type(&st, 0) == ERR_ARG);
+
+  /* both encoders produce the same octets */
+  EXPECT_RET(tot_len <= sizeof(a));
+  EXPECT(pbuf_copy_partial(p_ofs, a, tot_len, 0) == tot_len);
+  EXPECT(pbuf_copy_partial(p_st, b, tot_len, 0) == tot_len);
+  EXPECT(memcmp(a, b, tot_len) == 0);
+
+  start = clock();
+  for (r = 0; r < rounds; r++) {
+    ofs = 0;
+    for (k = 0; k < TEST_SNMP_BER_ITEMS; k++) {
+      snmp_asn1_dec_type(p_st, ofs, &type);
+      ofs += 1;
+      snmp_asn1_dec_length(p_st, ofs, &used, &len);
+      ofs += used;
+      snmp_asn1_dec_oid(p_st, ofs, len, &oid);
+      ofs += len;
+      snmp_asn1_dec_type(p_st, ofs, &type);
+      ofs += 1;
+      snmp_asn1_dec_length(p_st, ofs, &used, &len);
+      ofs += used;
+      snmp_asn1_dec_s32t(p_st, ofs, len, &dec);
+      ofs += len;
+    }
+  }
+  t_dec = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds;
+  EXPECT(ofs == tot_len);
+
+  /* the decoder gives back the last item */
+  test_snmp_ber_item(TEST_SNMP_BER_ITEMS - 1, id, &value);
+  EXPECT(oid.len == TEST_SNMP_LEN(id));
+  EXPECT(memcmp(oid.id, id, sizeof(id)) == 0);
+  EXPECT(dec == value);
+
+  printf("SNMP BER %d varbinds (%d octets, %d octet pbufs): encode by offset %.1f us, streaming %.1f us, decode %.1f us\n",
+    TEST_SNMP_BER_ITEMS, tot_len, TEST_SNMP_BER_CHUNK, t_ofs, t_st, t_dec);
+
+  pbuf_free(p_ofs);
+  pbuf_free(p_st);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+snmp_suite(void)
+{
+  TFun tests[] = {
+    test_snmp_getnext_end_of_mib,
+    test_snmp_getbulk,
+    test_snmp_walk_table_change,
+    test_snmp_walk_time,
+    test_snmp_ber_time
+  };
+  return create_suite("SNMP", tests, sizeof(tests)/sizeof(TFun), snmp_setup, snmp_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef __TEST_SNMP_H__
+#define __TEST_SNMP_H__
+
+#include "../lwip_check.h"
+
+Suite* snmp_suite(void);
+
+#endif